@@ -0,0 +1,292 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/resource.h>
+
+#include "alloc-util.h"
+#include "analyze-bench.h"
+#include "bus-error.h"
+#include "fd-util.h"
+#include "fdset.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "log.h"
+#include "logs-show.h"
+#include "manager.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "strv.h"
+#include "unit-name.h"
+
+/* Runs the unit loading, transaction building and (de)serialization machinery of the manager in test mode on the
+ * unit files in the specified directory, and reports how long each step took, so that slow reloads and similar can
+ * be reproduced outside of PID 1. */
+
+typedef struct BenchResults {
+        usec_t startup_usec;
+
+        unsigned load_units;
+        usec_t load_usec;
+        unsigned load_type_units[_UNIT_TYPE_MAX];
+        usec_t load_type_usec[_UNIT_TYPE_MAX];
+
+        const char *target;
+        unsigned transaction_jobs;
+        usec_t transaction_usec;
+
+        uint64_t serialize_bytes;
+        usec_t serialize_usec;
+        usec_t deserialize_usec;
+
+        uint64_t peak_memory_bytes;
+} BenchResults;
+
+static int bench_load(Manager *m, const char *directory, BenchResults *b) {
+        _cleanup_strv_free_ char **files = NULL;
+        UnitType type;
+        usec_t n;
+        char **f;
+        int r;
+
+        r = get_files_in_directory(directory, &files);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enumerate %s: %m", directory);
+
+        strv_sort(files);
+
+        STRV_FOREACH(f, files) {
+                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+                Unit *u;
+
+                /* Templates can't be loaded without an instance, skip them */
+                if (!unit_name_is_valid(*f, UNIT_NAME_PLAIN|UNIT_NAME_INSTANCE))
+                        continue;
+
+                type = unit_name_to_type(*f);
+                if (type < 0)
+                        continue;
+
+                n = now(CLOCK_MONOTONIC);
+                r = manager_load_unit(m, *f, NULL, &error, &u);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to load %s: %s", *f, bus_error_message(&error, r));
+
+                n = now(CLOCK_MONOTONIC) - n;
+                b->load_type_usec[type] += n;
+                b->load_type_units[type]++;
+
+                b->load_usec += n;
+                b->load_units++;
+        }
+
+        return 0;
+}
+
+static int bench_transaction(Manager *m, const char *target, BenchResults *b) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        usec_t n;
+        int r;
+
+        n = now(CLOCK_MONOTONIC);
+        r = manager_add_job_by_name(m, JOB_START, target, JOB_REPLACE, &error, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to start %s: %s", target, bus_error_message(&error, r));
+
+        b->transaction_usec = now(CLOCK_MONOTONIC) - n;
+        b->transaction_jobs = hashmap_size(m->jobs);
+        b->target = target;
+
+        manager_clear_jobs(m);
+
+        return 0;
+}
+
+static int bench_serialize(Manager *m, BenchResults *b) {
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        usec_t n;
+        int r;
+
+        fds = fdset_new();
+        if (!fds)
+                return log_oom();
+
+        r = manager_open_serialization(m, &f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create serialization file: %m");
+
+        n = now(CLOCK_MONOTONIC);
+        r = manager_serialize(m, f, fds, false);
+        if (r < 0)
+                return log_error_errno(r, "Failed to serialize: %m");
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write serialization: %m");
+        b->serialize_usec = now(CLOCK_MONOTONIC) - n;
+
+        b->serialize_bytes = (uint64_t) ftello(f);
+
+        if (fseeko(f, 0, SEEK_SET) < 0)
+                return log_error_errno(errno, "Failed to rewind serialization file: %m");
+
+        n = now(CLOCK_MONOTONIC);
+        r = manager_deserialize(m, f, fds);
+        if (r < 0)
+                return log_error_errno(r, "Failed to deserialize: %m");
+        b->deserialize_usec = now(CLOCK_MONOTONIC) - n;
+
+        return 0;
+}
+
+static void bench_print_text(const BenchResults *b) {
+        char bytes[FORMAT_BYTES_MAX];
+        UnitType type;
+
+        printf("Started manager in %.2fms.\n", b->startup_usec / 1e3);
+
+        printf("Loaded %u units in %.2fms.\n", b->load_units, b->load_usec / 1e3);
+
+        for (type = 0; type < _UNIT_TYPE_MAX; type++) {
+                if (b->load_type_units[type] == 0)
+                        continue;
+
+                printf("  %-10s %6u units %10.2fms %8.1fus/unit\n",
+                       unit_type_to_string(type),
+                       b->load_type_units[type],
+                       b->load_type_usec[type] / 1e3,
+                       (double) b->load_type_usec[type] / b->load_type_units[type]);
+        }
+
+        if (b->target)
+                printf("Built transaction for %s with %u jobs in %.2fms.\n",
+                       b->target, b->transaction_jobs, b->transaction_usec / 1e3);
+
+        printf("Serialized %" PRIu64 " bytes in %.2fms, deserialized in %.2fms.\n",
+               b->serialize_bytes, b->serialize_usec / 1e3, b->deserialize_usec / 1e3);
+
+        if (b->peak_memory_bytes != UINT64_MAX)
+                printf("Peak memory use %s.\n", format_bytes(bytes, sizeof(bytes), b->peak_memory_bytes));
+}
+
+static void bench_print_json(const BenchResults *b) {
+        bool first = true;
+        UnitType type;
+
+        /* One object on a single line, with all times in µs, so that scripts comparing runs don't need to parse
+         * the human readable output */
+
+        printf("{ \"startup_usec\" : " USEC_FMT ", "
+               "\"load\" : { \"units\" : %u, \"usec\" : " USEC_FMT ", \"types\" : {",
+               b->startup_usec, b->load_units, b->load_usec);
+
+        for (type = 0; type < _UNIT_TYPE_MAX; type++) {
+                if (b->load_type_units[type] == 0)
+                        continue;
+
+                printf("%s \"%s\" : { \"units\" : %u, \"usec\" : " USEC_FMT " }",
+                       first ? "" : ",",
+                       unit_type_to_string(type),
+                       b->load_type_units[type],
+                       b->load_type_usec[type]);
+                first = false;
+        }
+
+        fputs(" } }, \"transaction\" : ", stdout);
+
+        if (b->target) {
+                fputs("{ \"unit\" : ", stdout);
+                json_escape(stdout, b->target, strlen(b->target), OUTPUT_SHOW_ALL);
+                printf(", \"jobs\" : %u, \"usec\" : " USEC_FMT " }", b->transaction_jobs, b->transaction_usec);
+        } else
+                fputs("null", stdout);
+
+        printf(", \"serialize\" : { \"bytes\" : %" PRIu64 ", \"usec\" : " USEC_FMT ", \"deserialize_usec\" : " USEC_FMT " }, "
+               "\"peak_memory_bytes\" : ",
+               b->serialize_bytes, b->serialize_usec, b->deserialize_usec);
+
+        if (b->peak_memory_bytes != UINT64_MAX)
+                printf("%" PRIu64 " }\n", b->peak_memory_bytes);
+        else
+                fputs("null }\n", stdout);
+}
+
+int bench_units(const char *directory, const char *target, UnitFileScope scope, bool json) {
+        BenchResults b = {
+                .peak_memory_bytes = UINT64_MAX,
+        };
+        _cleanup_free_ char *p = NULL;
+        struct rusage ru;
+        Manager *m = NULL;
+        usec_t n;
+        int r;
+
+        assert(directory);
+
+        r = path_make_absolute_cwd(directory, &p);
+        if (r < 0)
+                return log_error_errno(r, "Failed to make path %s absolute: %m", directory);
+
+        r = set_unit_path(p);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set unit load path: %m");
+
+        n = now(CLOCK_MONOTONIC);
+
+        r = manager_new(scope, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (r < 0)
+                return log_error_errno(r, "Failed to initialize manager: %m");
+
+        r = manager_startup(m, NULL, NULL);
+        if (r < 0) {
+                log_error_errno(r, "Failed to start manager: %m");
+                goto finish;
+        }
+
+        b.startup_usec = now(CLOCK_MONOTONIC) - n;
+
+        manager_clear_jobs(m);
+
+        r = bench_load(m, p, &b);
+        if (r < 0)
+                goto finish;
+
+        if (target) {
+                r = bench_transaction(m, target, &b);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = bench_serialize(m, &b);
+        if (r < 0)
+                goto finish;
+
+        if (getrusage(RUSAGE_SELF, &ru) >= 0)
+                b.peak_memory_bytes = (uint64_t) ru.ru_maxrss * 1024;
+
+        if (json)
+                bench_print_json(&b);
+        else
+                bench_print_text(&b);
+
+        r = 0;
+
+finish:
+        manager_free(m);
+
+        return r;
+}
@@ -22,10 +22,12 @@
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include "sd-bus.h"
 
 #include "alloc-util.h"
+#include "analyze-bench.h"
 #include "analyze-verify.h"
 #include "bus-error.h"
 #include "bus-unit-util.h"
@@ -34,6 +36,7 @@
 #include "hashmap.h"
 #include "locale-util.h"
 #include "log.h"
+#include "memfd-util.h"
 #include "pager.h"
 #include "parse-util.h"
 #ifdef HAVE_SECCOMP
@@ -80,6 +83,7 @@ static char *arg_host = NULL;
 static bool arg_user = false;
 static bool arg_man = true;
 static bool arg_generators = false;
+static bool arg_json = false;
 
 struct boot_times {
         usec_t firmware_time;
@@ -1194,12 +1198,41 @@ static int dot(sd_bus *bus, char* patterns[]) {
         return 0;
 }
 
-static int dump(sd_bus *bus, char **args) {
+static int dump_fallback(sd_bus *bus) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         const char *text = NULL;
         int r;
 
+        assert(bus);
+
+        r = sd_bus_call_method(
+                        bus,
+                       "org.freedesktop.systemd1",
+                       "/org/freedesktop/systemd1",
+                       "org.freedesktop.systemd1.Manager",
+                       "Dump",
+                       &error,
+                       &reply,
+                       "");
+        if (r < 0)
+                return log_error_errno(r, "Failed issue method call: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_read(reply, "s", &text);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        fputs(text, stdout);
+        return 0;
+}
+
+static int dump(sd_bus *bus, char **args) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        uint64_t size;
+        void *p;
+        int fd, r;
+
         if (!strv_isempty(args)) {
                 log_error("Too many arguments.");
                 return -E2BIG;
@@ -1207,23 +1240,55 @@ static int dump(sd_bus *bus, char **args) {
 
         pager_open(arg_no_pager, false);
 
+        /* Prefer getting the dump as a memfd, so that it doesn't need to be copied through the bus */
+        if (sd_bus_can_send(bus, SD_BUS_TYPE_UNIX_FD) <= 0)
+                return dump_fallback(bus);
+
         r = sd_bus_call_method(
                         bus,
                        "org.freedesktop.systemd1",
                        "/org/freedesktop/systemd1",
                        "org.freedesktop.systemd1.Manager",
-                       "Dump",
+                       "DumpByFileDescriptor",
                        &error,
                        &reply,
                        "");
-        if (r < 0)
+        if (r < 0) {
+                /* Older managers don't know about this yet */
+                if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+                        return dump_fallback(bus);
+
                 return log_error_errno(r, "Failed issue method call: %s", bus_error_message(&error, r));
+        }
 
-        r = sd_bus_message_read(reply, "s", &text);
+        r = sd_bus_message_read(reply, "h", &fd);
         if (r < 0)
                 return bus_log_parse_error(r);
 
-        fputs(text, stdout);
+        /* Only map the memfd if nobody can shrink it under our feet anymore */
+        r = memfd_get_sealed(fd);
+        if (r < 0)
+                return log_error_errno(r, "Failed to query seals of dump memfd: %m");
+        if (r == 0) {
+                log_error("Dump memfd is not sealed, refusing.");
+                return -EPERM;
+        }
+
+        r = memfd_get_size(fd, &size);
+        if (r < 0)
+                return log_error_errno(r, "Failed to determine size of dump: %m");
+        if (size == 0)
+                return 0;
+        if (size > SIZE_MAX)
+                return log_error_errno(EFBIG, "Dump too large to map.");
+
+        r = memfd_map(fd, 0, size, &p);
+        if (r < 0)
+                return log_error_errno(r, "Failed to map dump: %m");
+
+        fwrite(p, 1, size, stdout);
+        (void) munmap(p, size);
+
         return 0;
 }
 
@@ -1414,7 +1479,8 @@ static void help(void) {
                "     --fuzz=SECONDS        Also print also services which finished SECONDS\n"
                "                           earlier than the latest in the branch\n"
                "     --man[=BOOL]          Do [not] check for existence of man pages\n\n"
-               "     --generators[=BOOL]   Do [not] run unit generators (requires privileges)\n\n"
+               "     --generators[=BOOL]   Do [not] run unit generators (requires privileges)\n"
+               "     --json                Output the results of 'bench' as JSON\n\n"
                "Commands:\n"
                "  time                     Print time spent in the kernel\n"
                "  blame                    Print list of running units ordered by time to init\n"
@@ -1428,6 +1494,7 @@ static void help(void) {
                "  dump                     Output state serialization of service manager\n"
                "  syscall-filter [NAME...] Print list of syscalls in seccomp filter\n"
                "  verify FILE...           Check unit files for correctness\n"
+               "  bench DIRECTORY [UNIT]   Benchmark service manager operations on unit files\n"
                , program_invocation_short_name);
 
         /* When updating this list, including descriptions, apply
@@ -1448,6 +1515,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_NO_PAGER,
                 ARG_MAN,
                 ARG_GENERATORS,
+                ARG_JSON,
         };
 
         static const struct option options[] = {
@@ -1463,6 +1531,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "no-pager",     no_argument,       NULL, ARG_NO_PAGER         },
                 { "man",          optional_argument, NULL, ARG_MAN              },
                 { "generators",   optional_argument, NULL, ARG_GENERATORS       },
+                { "json",         no_argument,       NULL, ARG_JSON             },
                 { "host",         required_argument, NULL, 'H'                  },
                 { "machine",      required_argument, NULL, 'M'                  },
                 {}
@@ -1559,6 +1628,10 @@ static int parse_argv(int argc, char *argv[]) {
 
                         break;
 
+                case ARG_JSON:
+                        arg_json = true;
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -1586,7 +1659,15 @@ int main(int argc, char *argv[]) {
                                  arg_user ? UNIT_FILE_USER : UNIT_FILE_SYSTEM,
                                  arg_man,
                                  arg_generators);
-        else {
+        else if (streq_ptr(argv[optind], "bench")) {
+                if (!argv[optind+1] || (argv[optind+2] && argv[optind+3])) {
+                        log_error("Expecting a directory and optionally a unit name.");
+                        r = -EINVAL;
+                } else
+                        r = bench_units(argv[optind+1], argv[optind+2],
+                                        arg_user ? UNIT_FILE_USER : UNIT_FILE_SYSTEM,
+                                        arg_json);
+        } else {
                 _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
 
                 r = bus_connect_transport_systemd(arg_transport, arg_host, arg_user, &bus);
@@ -297,6 +297,40 @@ int btrfs_clone_range(int infd, uint64_t in_offset, int outfd, uint64_t out_offs
         return 0;
 }
 
+int btrfs_dedupe_range(int infd, uint64_t in_offset, int outfd, uint64_t out_offset, uint64_t sz) {
+        _cleanup_free_ struct btrfs_ioctl_same_args *args = NULL;
+        int r;
+
+        assert(infd >= 0);
+        assert(outfd >= 0);
+        assert(sz > 0);
+
+        /* Makes the specified range of outfd share the extents of the same range of infd, but only if the data
+         * in both is identical, which the kernel checks for us. Returns > 0 if the range is shared now, 0 if the
+         * data differs. */
+
+        args = malloc0(offsetof(struct btrfs_ioctl_same_args, info) + sizeof(struct btrfs_ioctl_same_extent_info));
+        if (!args)
+                return -ENOMEM;
+
+        args->logical_offset = in_offset;
+        args->length = sz;
+        args->dest_count = 1;
+        args->info[0].fd = outfd;
+        args->info[0].logical_offset = out_offset;
+
+        r = ioctl(infd, BTRFS_IOC_FILE_EXTENT_SAME, args);
+        if (r < 0)
+                return -errno;
+
+        if (args->info[0].status < 0)
+                return args->info[0].status;
+        if (args->info[0].status == BTRFS_SAME_DATA_DIFFERS)
+                return 0;
+
+        return args->info[0].bytes_deduped > 0;
+}
+
 int btrfs_get_block_device_fd(int fd, dev_t *dev) {
         struct btrfs_ioctl_fs_info_args fsi = {};
         uint64_t id;
@@ -1737,7 +1771,7 @@ int btrfs_subvol_snapshot_fd(int old_fd, const char *new_path, BtrfsSnapshotFlag
                 } else if (r < 0)
                         return r;
 
-                r = copy_directory_fd(old_fd, new_path, COPY_MERGE|COPY_REFLINK);
+                r = copy_directory_fd(old_fd, new_path, COPY_MERGE|COPY_REFLINK|COPY_HOLES);
                 if (r < 0)
                         goto fallback_fail;
 
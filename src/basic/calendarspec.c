@@ -1342,6 +1342,29 @@ static int calendar_spec_next_usec_impl(const CalendarSpec *spec, usec_t usec, u
         return 0;
 }
 
+static bool timezone_is_current(const char *tz) {
+        _cleanup_free_ char *local = NULL;
+        const char *e;
+
+        assert(tz);
+
+        /* Checks whether the specified timezone is the one localtime() and mktime() already operate in, in
+         * which case there's no need to switch to it first */
+
+        e = getenv("TZ");
+        if (e) {
+                if (*e == ':')
+                        e++;
+
+                return streq(e, tz);
+        }
+
+        if (get_timezone(&local) < 0)
+                return false;
+
+        return streq(local, tz);
+}
+
 typedef struct SpecNextResult {
         usec_t next;
         int return_value;
@@ -1353,7 +1376,7 @@ int calendar_spec_next_usec(const CalendarSpec *spec, usec_t usec, usec_t *next)
         SpecNextResult tmp;
         int r;
 
-        if (isempty(spec->timezone))
+        if (isempty(spec->timezone) || timezone_is_current(spec->timezone))
                 return calendar_spec_next_usec_impl(spec, usec, next);
 
         shared = mmap(NULL, sizeof *shared, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
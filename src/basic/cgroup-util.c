@@ -324,6 +324,54 @@ int cg_kill(
         return ret;
 }
 
+int cg_kill_kernel_sigkill(const char *controller, const char *path, CGroupFlags flags) {
+        _cleanup_free_ char *fs = NULL;
+        int r;
+
+        assert(path);
+
+        /* Kills the cgroup and everything below it in one go, by writing to cgroup.kill. Returns -EOPNOTSUPP if
+         * the kernel doesn't provide that, if this isn't the unified hierarchy, or if CGROUP_IGNORE_SELF is set and
+         * we are part of the subtree, in which case the caller should fall back to killing the processes one by
+         * one. Like cg_kill_recursive() returns > 0 if there was anything to kill, 0 otherwise. */
+
+        r = cg_all_unified();
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EOPNOTSUPP;
+
+        r = cg_get_path(controller, path, "cgroup.kill", &fs);
+        if (r < 0)
+                return r;
+
+        if (access(fs, F_OK) < 0)
+                return -EOPNOTSUPP; /* Let the slow path figure out whether the cgroup is simply gone */
+
+        if (flags & CGROUP_IGNORE_SELF) {
+                _cleanup_free_ char *own = NULL;
+
+                r = cg_pid_get_path(controller, 0, &own);
+                if (r < 0)
+                        return r;
+
+                if (path_startswith(own, path))
+                        return -EOPNOTSUPP;
+        }
+
+        r = cg_is_empty_recursive(controller, path);
+        if (r < 0)
+                return r;
+        if (r > 0)
+                return 0;
+
+        r = write_string_file(fs, "1", 0);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
 int cg_kill_recursive(
                 const char *controller,
                 const char *path,
@@ -341,6 +389,14 @@ int cg_kill_recursive(
         assert(path);
         assert(sig >= 0);
 
+        /* If all processes should get SIGKILL, nobody is to be spared and no per-process logging is requested, let
+         * the kernel do the work, instead of racing against forking processes from userspace. */
+        if (sig == SIGKILL && !s && !log_kill && !(flags & CGROUP_REMOVE)) {
+                r = cg_kill_kernel_sigkill(controller, path, flags);
+                if (r != -EOPNOTSUPP)
+                        return r;
+        }
+
         if (!s) {
                 s = allocated_set = set_new(NULL);
                 if (!s)
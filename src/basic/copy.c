@@ -69,8 +69,24 @@ static ssize_t try_copy_file_range(int fd_in, loff_t *off_in,
                 return -errno;
 }
 
+static int create_hole(int fd, off_t size) {
+        off_t offset;
+
+        /* Skip over size bytes in the target, and make sure the file is extended accordingly if this was the
+         * last hole of the source. Any data written later on will go after the hole. */
+
+        offset = lseek(fd, size, SEEK_CUR);
+        if (offset < 0)
+                return -errno;
+
+        if (ftruncate(fd, offset) < 0)
+                return -errno;
+
+        return 0;
+}
+
 int copy_bytes(int fdf, int fdt, uint64_t max_bytes, CopyFlags copy_flags) {
-        bool try_cfr = true, try_sendfile = true, try_splice = true;
+        bool try_cfr = true, try_sendfile = true, try_splice = true, try_holes;
         int r;
         size_t m = SSIZE_MAX; /* that is the maximum that sendfile and c_f_r accept */
 
@@ -88,9 +104,15 @@ int copy_bytes(int fdf, int fdt, uint64_t max_bytes, CopyFlags copy_flags) {
                         return 0; /* we copied the whole thing, hence hit EOF, return 0 */
         }
 
+        try_holes = copy_flags & COPY_HOLES;
+
         for (;;) {
                 ssize_t n;
 
+                /* Below we limit a chunk to the end of the current data segment, don't let that stick */
+                if (try_holes)
+                        m = SSIZE_MAX;
+
                 if (max_bytes != (uint64_t) -1) {
                         if (max_bytes <= 0)
                                 return 1; /* return > 0 if we hit the max_bytes limit */
@@ -99,6 +121,69 @@ int copy_bytes(int fdf, int fdt, uint64_t max_bytes, CopyFlags copy_flags) {
                                 m = max_bytes;
                 }
 
+                /* If requested, look for the next data segment in the source, turn everything before it into a
+                 * hole in the target and copy no further than its end in one go. */
+                if (try_holes) {
+                        off_t c, e;
+
+                        c = lseek(fdf, 0, SEEK_CUR);
+                        if (c < 0)
+                                return -errno;
+
+                        e = lseek(fdf, c, SEEK_DATA);
+                        if (e < 0) {
+                                if (IN_SET(errno, EINVAL, ESPIPE, EOPNOTSUPP)) {
+                                        /* Not supported by this file (system), copy everything then */
+                                        try_holes = false;
+                                        goto copy;
+                                }
+                                if (errno != ENXIO)
+                                        return -errno;
+
+                                /* Only a hole is left until EOF, if anything */
+                                e = lseek(fdf, 0, SEEK_END);
+                                if (e < 0)
+                                        return -errno;
+                                if (e <= c) /* EOF */
+                                        break;
+                        }
+
+                        if (e > c) {
+                                uint64_t h = e - c;
+
+                                if (max_bytes != (uint64_t) -1 && h > max_bytes)
+                                        h = max_bytes;
+
+                                r = create_hole(fdt, h);
+                                if (r < 0)
+                                        return r;
+
+                                if (max_bytes != (uint64_t) -1)
+                                        max_bytes -= h;
+
+                                c += h;
+                                if (lseek(fdf, c, SEEK_SET) < 0)
+                                        return -errno;
+
+                                continue;
+                        }
+
+                        /* Find the end of this data segment; there's always an implicit hole at EOF */
+                        e = lseek(fdf, c, SEEK_HOLE);
+                        if (e < 0) {
+                                if (errno == ENXIO) /* file was truncated under our feet */
+                                        break;
+                                return -errno;
+                        }
+
+                        if (lseek(fdf, c, SEEK_SET) < 0)
+                                return -errno;
+
+                        if ((uint64_t) (e - c) < m)
+                                m = e - c;
+                }
+
+        copy:
                 /* First try copy_file_range(), unless we already tried */
                 if (try_cfr) {
                         n = try_copy_file_range(fdf, NULL, fdt, NULL, m, 0u);
@@ -28,6 +28,7 @@ typedef enum CopyFlags {
         COPY_REFLINK    = 0x1,      /* try to reflink */
         COPY_MERGE      = 0x2,      /* merge existing trees with our new one to copy */
         COPY_REPLACE    = 0x4,      /* replace an existing file if there's one */
+        COPY_HOLES      = 0x8,      /* copy holes in the source as holes instead of zeroes */
 } CopyFlags;
 
 int copy_file_fd(const char *from, int to, CopyFlags copy_flags);
@@ -28,8 +28,10 @@
 #include "env-util.h"
 #include "escape.h"
 #include "extract-word.h"
+#include "hashmap.h"
 #include "macro.h"
 #include "parse-util.h"
+#include "set.h"
 #include "string-util.h"
 #include "strv.h"
 #include "utf8.h"
@@ -42,6 +44,34 @@
 #define ARG_MAX ((size_t) sysconf(_SC_ARG_MAX))
 #endif
 
+/* Above this many entries, find duplicate variables through a hash table instead of by scanning the
+ * list for each entry */
+#define ENV_HASH_THRESHOLD 64U
+
+/* Hashes and compares environment assignments by their variable name only */
+static void env_name_hash_func(const void *p, struct siphash *state) {
+        const char *s = p;
+
+        siphash24_compress(s, strcspn(s, "="), state);
+}
+
+static int env_name_compare_func(const void *a, const void *b) {
+        const char *x = a, *y = b;
+        size_t n, m;
+
+        n = strcspn(x, "=");
+        m = strcspn(y, "=");
+        if (n != m)
+                return n < m ? -1 : 1;
+
+        return memcmp(x, y, n);
+}
+
+static const struct hash_ops env_name_hash_ops = {
+        .hash = env_name_hash_func,
+        .compare = env_name_compare_func
+};
+
 static bool env_name_is_valid_n(const char *e, size_t n) {
         const char *p;
 
@@ -171,7 +201,7 @@ bool strv_env_name_or_assignment_is_valid(char **l) {
         return true;
 }
 
-static int env_append(char **r, char ***k, char **a) {
+static int env_append(char **r, char ***k, char **a, Hashmap *index) {
         assert(r);
         assert(k);
 
@@ -180,7 +210,9 @@ static int env_append(char **r, char ***k, char **a) {
 
         /* Add the entries of a to *k unless they already exist in *r
          * in which case they are overridden instead. This assumes
-         * there is enough space in the r array. */
+         * there is enough space in the r array. If index is passed,
+         * it maps the entries of r by variable name to their
+         * position. */
 
         for (; *a; a++) {
                 char **j;
@@ -188,27 +220,50 @@ static int env_append(char **r, char ***k, char **a) {
 
                 n = strcspn(*a, "=");
 
-                if ((*a)[n] == '=')
+                if ((*a)[n] == '=') {
                         n++;
 
+                        if (index) {
+                                j = hashmap_remove(index, *a);
+                                if (!j)
+                                        j = *k;
+                                goto found;
+                        }
+                }
+
                 for (j = r; j < *k; j++)
                         if (strneq(*j, *a, n))
                                 break;
 
+        found:
                 if (j >= *k)
                         (*k)++;
-                else
+                else {
+                        /* Don't leave the index with the string we free as key */
+                        if (index && hashmap_get(index, *j) == j)
+                                (void) hashmap_remove(index, *j);
+
                         free(*j);
+                }
 
                 *j = strdup(*a);
                 if (!*j)
                         return -ENOMEM;
+
+                if (index && strchr(*j, '=')) {
+                        int q;
+
+                        q = hashmap_put(index, *j, j);
+                        if (q < 0)
+                                return q;
+                }
         }
 
         return 0;
 }
 
 char **strv_env_merge(unsigned n_lists, ...) {
+        _cleanup_hashmap_free_ Hashmap *index = NULL;
         size_t n = 0;
         char **l, **k, **r;
         va_list ap;
@@ -229,10 +284,16 @@ char **strv_env_merge(unsigned n_lists, ...) {
 
         k = r;
 
+        if (n > ENV_HASH_THRESHOLD) {
+                index = hashmap_new(&env_name_hash_ops);
+                if (!index)
+                        goto fail_nolist;
+        }
+
         va_start(ap, n_lists);
         for (i = 0; i < n_lists; i++) {
                 l = va_arg(ap, char**);
-                if (env_append(r, &k, l) < 0)
+                if (env_append(r, &k, l, index) < 0)
                         goto fail;
         }
         va_end(ap);
@@ -243,6 +304,8 @@ char **strv_env_merge(unsigned n_lists, ...) {
 
 fail:
         va_end(ap);
+fail_nolist:
+        *k = NULL;
         strv_free(r);
 
         return NULL;
@@ -439,10 +502,10 @@ char **strv_env_set(char **x, const char *p) {
                 return NULL;
 
         k = r;
-        if (env_append(r, &k, x) < 0)
+        if (env_append(r, &k, x, NULL) < 0)
                 goto fail;
 
-        if (env_append(r, &k, m) < 0)
+        if (env_append(r, &k, m, NULL) < 0)
                 goto fail;
 
         *k = NULL;
@@ -484,13 +547,12 @@ char *strv_env_get(char **l, const char *name) {
 }
 
 char **strv_env_clean_with_callback(char **e, void (*invalid_callback)(const char *p, void *userdata), void *userdata) {
+        _cleanup_set_free_ Set *later = NULL;
         char **p, **q;
+        size_t i;
         int k = 0;
 
         STRV_FOREACH(p, e) {
-                size_t n;
-                bool duplicate = false;
-
                 if (!env_assignment_is_valid(*p)) {
                         if (invalid_callback)
                                 invalid_callback(*p, userdata);
@@ -498,23 +560,46 @@ char **strv_env_clean_with_callback(char **e, void (*invalid_callback)(const cha
                         continue;
                 }
 
-                n = strcspn(*p, "=");
-                STRV_FOREACH(q, p + 1)
-                        if (strneq(*p, *q, n) && (*q)[n] == '=') {
-                                duplicate = true;
-                                break;
-                        }
+                e[k++] = *p;
+        }
 
-                if (duplicate) {
-                        free(*p);
-                        continue;
-                }
+        if (!e)
+                return e;
 
-                e[k++] = *p;
+        e[k] = NULL;
+
+        /* Only the last assignment of each variable is kept. For long lists, find the later assignments
+         * through a hash table, filled walking backwards, instead of scanning the rest of the list for each
+         * entry. With the space reserved in advance, adding entries to the table cannot fail. */
+        if ((size_t) k > ENV_HASH_THRESHOLD) {
+                later = set_new(&env_name_hash_ops);
+                if (later && set_reserve(later, k) < 0)
+                        later = set_free(later);
         }
 
-        if (e)
-                e[k] = NULL;
+        if (later) {
+                for (i = k; i > 0; i--)
+                        if (set_put(later, e[i-1]) == 0)
+                                e[i-1] = mfree(e[i-1]);
+
+                set_clear(later);
+        } else
+                for (i = 0; i < (size_t) k; i++) {
+                        size_t n;
+
+                        n = strcspn(e[i], "=");
+                        STRV_FOREACH(q, e + i + 1)
+                                if (strneq(e[i], *q, n) && (*q)[n] == '=') {
+                                        e[i] = mfree(e[i]);
+                                        break;
+                                }
+                }
+
+        for (p = e, i = 0; i < (size_t) k; i++)
+                if (e[i])
+                        *(p++) = e[i];
+
+        *p = NULL;
 
         return e;
 }
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <sys/prctl.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <stdio.h>
 
@@ -98,6 +99,7 @@ static int do_execute(
         _cleanup_hashmap_free_free_ Hashmap *pids = NULL;
         _cleanup_strv_free_ char **paths = NULL;
         char **path;
+        usec_t start;
         int r;
 
         /* We fork this all off from a child process so that we can somewhat cleanly make
@@ -127,6 +129,8 @@ static int do_execute(
         if (timeout != USEC_INFINITY)
                 alarm((timeout + USEC_PER_SEC - 1) / USEC_PER_SEC);
 
+        start = now(CLOCK_MONOTONIC);
+
         STRV_FOREACH(path, paths) {
                 _cleanup_free_ char *t = NULL;
                 _cleanup_close_ int fd = -1;
@@ -174,15 +178,32 @@ static int do_execute(
 
         while (!hashmap_isempty(pids)) {
                 _cleanup_free_ char *t = NULL;
+                char ts[FORMAT_TIMESPAN_MAX];
+                siginfo_t si = {};
                 pid_t pid;
 
-                pid = PTR_TO_PID(hashmap_first_key(pids));
+                /* Collect the programs in the order they finish, so that we can tell how long each one took. We
+                 * only peek here, the actual reaping (and complaining about failures) is left to
+                 * wait_for_terminate_and_warn(). */
+                if (waitid(P_ALL, 0, &si, WEXITED|WNOWAIT) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return log_error_errno(errno, "Failed to wait for children: %m");
+                }
+
+                pid = si.si_pid;
                 assert(pid > 0);
 
                 t = hashmap_remove(pids, PID_TO_PTR(pid));
-                assert(t);
+                if (!t) {
+                        /* Not one of ours, but we are the only ones who'd reap it */
+                        (void) waitpid(pid, NULL, 0);
+                        continue;
+                }
 
                 wait_for_terminate_and_warn(t, pid, true);
+                log_debug("%s finished after %s.", t, format_timespan(ts, sizeof(ts), now(CLOCK_MONOTONIC) - start, USEC_PER_MSEC));
         }
 
         return 0;
@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
@@ -194,25 +195,62 @@ void stdio_unset_cloexec(void) {
         fd_cloexec(STDERR_FILENO, false);
 }
 
-_pure_ static bool fd_in_set(int fd, const int fdset[], unsigned n_fdset) {
-        unsigned i;
+static int fd_compare(const void *a, const void *b) {
+        const int *x = a, *y = b;
+
+        return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
 
+_pure_ static bool fd_in_set(int fd, const int fdset[], unsigned n_fdset) {
         assert(n_fdset == 0 || fdset);
 
-        for (i = 0; i < n_fdset; i++)
-                if (fdset[i] == fd)
-                        return true;
+        /* fdset must be sorted */
+        return n_fdset > 0 && bsearch(&fd, fdset, n_fdset, sizeof(int), fd_compare);
+}
+
+static int close_all_fds_by_range(const int sorted[], unsigned n_sorted) {
+        unsigned first = 3, i;
+
+        /* Closes everything from fd 3 upwards in as few close_range() calls as possible, keeping the fds
+         * listed in the sorted array. */
+
+        for (i = 0; i < n_sorted; i++) {
+                if (sorted[i] < (int) first)
+                        continue;
+
+                if ((unsigned) sorted[i] > first)
+                        if (close_range(first, sorted[i] - 1, 0) < 0)
+                                return -errno;
 
-        return false;
+                first = sorted[i] + 1;
+        }
+
+        if (close_range(first, ~0U, 0) < 0)
+                return -errno;
+
+        return 0;
 }
 
 int close_all_fds(const int except[], unsigned n_except) {
         _cleanup_closedir_ DIR *d = NULL;
         struct dirent *de;
-        int r = 0;
+        int *sorted, r = 0;
 
         assert(n_except == 0 || except);
 
+        /* This is typically called in a freshly forked child, hence avoid allocating from the heap */
+        sorted = newa(int, n_except + 1);
+        memcpy_safe(sorted, except, n_except * sizeof(int));
+        qsort_safe(sorted, n_except, sizeof(int), fd_compare);
+
+        r = close_all_fds_by_range(sorted, n_except);
+        if (r >= 0)
+                return r;
+        if (!IN_SET(r, -ENOSYS, -EINVAL, -EPERM)) /* EPERM: blocked by seccomp */
+                return r;
+
+        r = 0;
+
         d = opendir("/proc/self/fd");
         if (!d) {
                 int fd;
@@ -225,7 +263,7 @@ int close_all_fds(const int except[], unsigned n_except) {
                 assert_se(getrlimit(RLIMIT_NOFILE, &rl) >= 0);
                 for (fd = 3; fd < (int) rl.rlim_max; fd ++) {
 
-                        if (fd_in_set(fd, except, n_except))
+                        if (fd_in_set(fd, sorted, n_except))
                                 continue;
 
                         if (close_nointr(fd) < 0)
@@ -249,7 +287,7 @@ int close_all_fds(const int except[], unsigned n_except) {
                 if (fd == dirfd(d))
                         continue;
 
-                if (fd_in_set(fd, except, n_except))
+                if (fd_in_set(fd, sorted, n_except))
                         continue;
 
                 if (close_nointr(fd) < 0) {
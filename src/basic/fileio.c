@@ -1581,7 +1581,9 @@ int read_line(FILE *f, size_t limit, char **ret) {
                                 break;
 
                         if (ret) {
-                                if (!GREEDY_REALLOC(buffer, allocated, n + 2))
+                                /* Check inline first, so that we don't call into greedy_realloc() for each
+                                 * character */
+                                if (n + 2 > allocated && !GREEDY_REALLOC(buffer, allocated, n + 2))
                                         return -ENOMEM;
 
                                 buffer[n] = (char) c;
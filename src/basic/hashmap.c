@@ -131,6 +131,7 @@ assert_cc(IDX_FIRST == _IDX_ITERATOR_FIRST);
  * All entry types can fit into a ordered_hashmap_entry. */
 struct swap_entries {
         struct ordered_hashmap_entry e[_IDX_SWAP_END - _IDX_SWAP_BEGIN];
+        uint8_t tags[_IDX_SWAP_END - _IDX_SWAP_BEGIN];
 };
 
 /* Distance from Initial Bucket */
@@ -142,6 +143,16 @@ typedef uint8_t dib_raw_t;
 
 #define DIB_FREE UINT_MAX
 
+/*
+ * Indirect storage keeps one more byte per bucket after the DIB array: a tag
+ * made of the top bits of the hash of the entry's key. Scans compare tags
+ * first, which saves most calls to the compare function on collisions, and
+ * the cache misses of dereferencing the keys. The hash key only changes during
+ * resize, and all entries are rehashed then anyway, so tags are simply
+ * recomputed along.
+ */
+#define INDIRECT_BUCKET_SIZE(hi) ((hi)->entry_size + sizeof(dib_raw_t) + sizeof(uint8_t))
+
 #ifdef ENABLE_DEBUG_HASHMAP
 struct hashmap_debug_info {
         LIST_FIELDS(struct hashmap_debug_info, debug_list);
@@ -312,19 +323,25 @@ static uint8_t *hash_key(HashmapBase *h) {
                                : shared_hash_key;
 }
 
-static unsigned base_bucket_hash(HashmapBase *h, const void *p) {
+static uint64_t base_bucket_hash(HashmapBase *h, const void *p) {
         struct siphash state;
-        uint64_t hash;
 
         siphash24_init(&state, hash_key(h));
 
         h->hash_ops->hash(p, &state);
 
-        hash = siphash24_finalize(&state);
+        return siphash24_finalize(&state);
+}
+#define bucket_hash(h, p) base_bucket_hash(HASHMAP_BASE(h), p)
 
+static unsigned base_bucket_index(HashmapBase *h, uint64_t hash) {
         return (unsigned) (hash % n_buckets(h));
 }
-#define bucket_hash(h, p) base_bucket_hash(HASHMAP_BASE(h), p)
+#define bucket_index(h, hash) base_bucket_index(HASHMAP_BASE(h), hash)
+
+static uint8_t hash_tag(uint64_t hash) {
+        return (uint8_t) (hash >> 56);
+}
 
 static void get_hash_key(uint8_t hash_key[HASH_KEY_SIZE], bool reuse_is_ok) {
         static uint8_t current[HASH_KEY_SIZE];
@@ -384,6 +401,21 @@ static dib_raw_t *dib_raw_ptr(HashmapBase *h) {
                 ((uint8_t*) storage_ptr(h) + hashmap_type_info[h->type].entry_size * n_buckets(h));
 }
 
+static uint8_t *tag_ptr(HashmapBase *h) {
+        assert(h->has_indirect);
+
+        return (uint8_t*) (dib_raw_ptr(h) + n_buckets(h));
+}
+
+static uint8_t *tag_at_virtual(HashmapBase *h, struct swap_entries *swap, unsigned idx) {
+        if (idx < _IDX_SWAP_BEGIN)
+                return tag_ptr(h) + idx;
+
+        assert(swap);
+        assert(idx < _IDX_SWAP_END);
+        return &swap->tags[idx - _IDX_SWAP_BEGIN];
+}
+
 static unsigned bucket_distance(HashmapBase *h, unsigned idx, unsigned from) {
         return idx >= from ? idx - from
                            : n_buckets(h) + idx - from;
@@ -408,7 +440,7 @@ static unsigned bucket_calculate_dib(HashmapBase *h, unsigned idx, dib_raw_t raw
          * This returns the correct DIB value by recomputing the hash value in
          * the unlikely case. XXX Hitting this case could be a hint to rehash.
          */
-        initial_bucket = bucket_hash(h, bucket_at(h, idx)->key);
+        initial_bucket = bucket_index(h, bucket_hash(h, bucket_at(h, idx)->key));
         return bucket_distance(h, idx, initial_bucket);
 }
 
@@ -444,6 +476,9 @@ static void bucket_move_entry(HashmapBase *h, struct swap_entries *swap,
 
         memcpy(e_to, e_from, hashmap_type_info[h->type].entry_size);
 
+        if (h->has_indirect)
+                *tag_at_virtual(h, swap, to) = *tag_at_virtual(h, swap, from);
+
         if (h->type == HASHMAP_TYPE_ORDERED) {
                 OrderedHashmap *lh = (OrderedHashmap*) h;
                 struct ordered_hashmap_entry *le, *le_to;
@@ -964,21 +999,20 @@ static bool hashmap_put_robin_hood(HashmapBase *h, unsigned idx,
 
 /*
  * Puts an entry into a hashmap, boldly - no check whether key already exists.
- * The caller must place the entry (only its key and value, not link indexes)
- * in swap slot IDX_PUT.
+ * The caller must place the entry (only its key and value, not link indexes
+ * or tag) in swap slot IDX_PUT, and pass the hash of the key.
  * Caller must ensure: the key does not exist yet in the hashmap.
  *                     that resize is not needed if !may_resize.
  * Returns: 1 if entry was put successfully.
  *          -ENOMEM if may_resize==true and resize failed with -ENOMEM.
  *          Cannot return -ENOMEM if !may_resize.
  */
-static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
+static int hashmap_base_put_boldly(HashmapBase *h, uint64_t hash,
                                    struct swap_entries *swap, bool may_resize) {
         struct ordered_hashmap_entry *new_entry;
+        unsigned idx;
         int r;
 
-        assert(idx < n_buckets(h));
-
         new_entry = bucket_at_swap(swap, IDX_PUT);
 
         if (may_resize) {
@@ -986,10 +1020,14 @@ static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
                 if (r < 0)
                         return r;
                 if (r > 0)
-                        idx = bucket_hash(h, new_entry->p.b.key);
+                        hash = bucket_hash(h, new_entry->p.b.key);
         }
         assert(n_entries(h) < n_buckets(h));
 
+        idx = bucket_index(h, hash);
+        if (h->has_indirect)
+                swap->tags[IDX_PUT - _IDX_SWAP_BEGIN] = hash_tag(hash);
+
         if (h->type == HASHMAP_TYPE_ORDERED) {
                 OrderedHashmap *lh = (OrderedHashmap*) h;
 
@@ -1018,8 +1056,8 @@ static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
 
         return 1;
 }
-#define hashmap_put_boldly(h, idx, swap, may_resize) \
-        hashmap_base_put_boldly(HASHMAP_BASE(h), idx, swap, may_resize)
+#define hashmap_put_boldly(h, hash, swap, may_resize) \
+        hashmap_base_put_boldly(HASHMAP_BASE(h), hash, swap, may_resize)
 
 /*
  * Returns 0 if resize is not needed.
@@ -1033,6 +1071,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
         const struct hashmap_type_info *hi;
         unsigned idx, optimal_idx;
         unsigned old_n_buckets, new_n_buckets, n_rehashed, new_n_entries;
+        uint64_t hash;
         uint8_t new_shift;
         bool rehash_next;
 
@@ -1058,7 +1097,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
         if (_unlikely_(new_n_buckets < new_n_entries))
                 return -ENOMEM;
 
-        if (_unlikely_(new_n_buckets > UINT_MAX / (hi->entry_size + sizeof(dib_raw_t))))
+        if (_unlikely_(new_n_buckets > UINT_MAX / INDIRECT_BUCKET_SIZE(hi)))
                 return -ENOMEM;
 
         old_n_buckets = n_buckets(h);
@@ -1067,7 +1106,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                 return 0;
 
         new_shift = log2u_round_up(MAX(
-                        new_n_buckets * (hi->entry_size + sizeof(dib_raw_t)),
+                        new_n_buckets * INDIRECT_BUCKET_SIZE(hi),
                         2 * sizeof(struct direct_storage)));
 
         /* Realloc storage (buckets and DIB array). */
@@ -1092,8 +1131,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
 
         h->has_indirect = true;
         h->indirect.storage = new_storage;
-        h->indirect.n_buckets = (1U << new_shift) /
-                                (hi->entry_size + sizeof(dib_raw_t));
+        h->indirect.n_buckets = (1U << new_shift) / INDIRECT_BUCKET_SIZE(hi);
 
         old_dibs = (dib_raw_t*)((uint8_t*) new_storage + hi->entry_size * old_n_buckets);
         new_dibs = dib_raw_ptr(h);
@@ -1124,20 +1162,23 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                 if (new_dibs[idx] != DIB_RAW_REHASH)
                         continue;
 
-                optimal_idx = bucket_hash(h, bucket_at(h, idx)->key);
+                hash = bucket_hash(h, bucket_at(h, idx)->key);
+                optimal_idx = bucket_index(h, hash);
 
                 /*
                  * Not much to do if by luck the entry hashes to its current
-                 * location. Just set its DIB.
+                 * location. Just set its DIB and tag.
                  */
                 if (optimal_idx == idx) {
                         new_dibs[idx] = 0;
+                        tag_ptr(h)[idx] = hash_tag(hash);
                         n_rehashed++;
                         continue;
                 }
 
                 new_dibs[idx] = DIB_RAW_FREE;
                 bucket_move_entry(h, &swap, idx, IDX_PUT);
+                swap.tags[IDX_PUT - _IDX_SWAP_BEGIN] = hash_tag(hash);
                 /* bucket_move_entry does not clear the source */
                 memzero(bucket_at(h, idx), hi->entry_size);
 
@@ -1150,8 +1191,11 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                         n_rehashed++;
 
                         /* Did the current entry displace another one? */
-                        if (rehash_next)
-                                optimal_idx = bucket_hash(h, bucket_at_swap(&swap, IDX_PUT)->p.b.key);
+                        if (rehash_next) {
+                                hash = bucket_hash(h, bucket_at_swap(&swap, IDX_PUT)->p.b.key);
+                                optimal_idx = bucket_index(h, hash);
+                                swap.tags[IDX_PUT - _IDX_SWAP_BEGIN] = hash_tag(hash);
+                        }
                 } while (rehash_next);
         }
 
@@ -1164,12 +1208,15 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
  * Finds an entry with a matching key
  * Returns: index of the found entry, or IDX_NIL if not found.
  */
-static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key) {
+static unsigned base_bucket_scan(HashmapBase *h, uint64_t hash, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned dib, distance;
+        unsigned idx, dib, distance;
         dib_raw_t *dibs = dib_raw_ptr(h);
+        uint8_t *tags, tag;
 
-        assert(idx < n_buckets(h));
+        idx = base_bucket_index(h, hash);
+        tags = h->has_indirect ? tag_ptr(h) : NULL;
+        tag = hash_tag(hash);
 
         for (distance = 0; ; distance++) {
                 if (dibs[idx] == DIB_RAW_FREE)
@@ -1179,7 +1226,7 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
 
                 if (dib < distance)
                         return IDX_NIL;
-                if (dib == distance) {
+                if (dib == distance && (!tags || tags[idx] == tag)) {
                         e = bucket_at(h, idx);
                         if (h->hash_ops->compare(e->key, key) == 0)
                                 return idx;
@@ -1188,12 +1235,13 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
                 idx = next_idx(h, idx);
         }
 }
-#define bucket_scan(h, idx, key) base_bucket_scan(HASHMAP_BASE(h), idx, key)
+#define bucket_scan(h, hash, key) base_bucket_scan(HASHMAP_BASE(h), hash, key)
 
 int hashmap_put(Hashmap *h, const void *key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1215,7 +1263,8 @@ int hashmap_put(Hashmap *h, const void *key, void *value) {
 int set_put(Set *s, const void *key) {
         struct swap_entries swap;
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(s);
 
@@ -1232,7 +1281,8 @@ int set_put(Set *s, const void *key) {
 int hashmap_replace(Hashmap *h, const void *key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1263,7 +1313,8 @@ int hashmap_replace(Hashmap *h, const void *key, void *value) {
 
 int hashmap_update(Hashmap *h, const void *key, void *value) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1279,7 +1330,8 @@ int hashmap_update(Hashmap *h, const void *key, void *value) {
 
 void *internal_hashmap_get(HashmapBase *h, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1295,7 +1347,8 @@ void *internal_hashmap_get(HashmapBase *h, const void *key) {
 
 void *hashmap_get2(Hashmap *h, const void *key, void **key2) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1313,7 +1366,7 @@ void *hashmap_get2(Hashmap *h, const void *key, void **key2) {
 }
 
 bool internal_hashmap_contains(HashmapBase *h, const void *key) {
-        unsigned hash;
+        uint64_t hash;
 
         if (!h)
                 return false;
@@ -1324,7 +1377,8 @@ bool internal_hashmap_contains(HashmapBase *h, const void *key) {
 
 void *internal_hashmap_remove(HashmapBase *h, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
         void *data;
 
         if (!h)
@@ -1344,7 +1398,8 @@ void *internal_hashmap_remove(HashmapBase *h, const void *key) {
 
 void *hashmap_remove2(Hashmap *h, const void *key, void **rkey) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
         void *data;
 
         if (!h) {
@@ -1374,7 +1429,8 @@ void *hashmap_remove2(Hashmap *h, const void *key, void **rkey) {
 int hashmap_remove_and_put(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned old_hash, new_hash, idx;
+        uint64_t old_hash, new_hash;
+        unsigned idx;
 
         if (!h)
                 return -ENOENT;
@@ -1401,7 +1457,8 @@ int hashmap_remove_and_put(Hashmap *h, const void *old_key, const void *new_key,
 int set_remove_and_put(Set *s, const void *old_key, const void *new_key) {
         struct swap_entries swap;
         struct hashmap_base_entry *e;
-        unsigned old_hash, new_hash, idx;
+        uint64_t old_hash, new_hash;
+        unsigned idx;
 
         if (!s)
                 return -ENOENT;
@@ -1427,7 +1484,8 @@ int set_remove_and_put(Set *s, const void *old_key, const void *new_key) {
 int hashmap_remove_and_replace(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned old_hash, new_hash, idx_old, idx_new;
+        uint64_t old_hash, new_hash;
+        unsigned idx_old, idx_new;
 
         if (!h)
                 return -ENOENT;
@@ -1462,7 +1520,8 @@ int hashmap_remove_and_replace(Hashmap *h, const void *old_key, const void *new_
 
 void *hashmap_remove_value(Hashmap *h, const void *key, void *value) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1560,6 +1619,24 @@ unsigned internal_hashmap_buckets(HashmapBase *h) {
         return n_buckets(h);
 }
 
+size_t internal_hashmap_memory_usage(HashmapBase *h) {
+        const struct hashmap_type_info *hi;
+        size_t sz;
+
+        if (!h)
+                return 0;
+
+        hi = &hashmap_type_info[h->type];
+
+        /* Small hashmaps keep their entries in the head itself, only larger ones allocate storage for
+         * buckets and DIBs separately */
+        sz = hi->head_size;
+        if (h->has_indirect)
+                sz += n_buckets(h) * INDIRECT_BUCKET_SIZE(hi);
+
+        return sz;
+}
+
 int internal_hashmap_merge(Hashmap *h, Hashmap *other) {
         Iterator i;
         unsigned idx;
@@ -1639,7 +1716,7 @@ int internal_hashmap_move(HashmapBase *h, HashmapBase *other) {
                 return r;
 
         HASHMAP_FOREACH_IDX(idx, other, i) {
-                unsigned h_hash;
+                uint64_t h_hash;
 
                 e = bucket_at(other, idx);
                 h_hash = bucket_hash(h, e->key);
@@ -1661,7 +1738,8 @@ int internal_hashmap_move(HashmapBase *h, HashmapBase *other) {
 
 int internal_hashmap_move_one(HashmapBase *h, HashmapBase *other, const void *key) {
         struct swap_entries swap;
-        unsigned h_hash, other_hash, idx;
+        uint64_t h_hash, other_hash;
+        unsigned idx;
         struct hashmap_base_entry *e, *n;
         int r;
 
@@ -1745,7 +1823,8 @@ char **internal_hashmap_get_strv(HashmapBase *h) {
 
 void *ordered_hashmap_next(OrderedHashmap *h, const void *key) {
         struct ordered_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -256,6 +256,14 @@ static inline unsigned ordered_hashmap_buckets(OrderedHashmap *h) {
         return internal_hashmap_buckets(HASHMAP_BASE(h));
 }
 
+size_t internal_hashmap_memory_usage(HashmapBase *h) _pure_;
+static inline size_t hashmap_memory_usage(Hashmap *h) {
+        return internal_hashmap_memory_usage(HASHMAP_BASE(h));
+}
+static inline size_t ordered_hashmap_memory_usage(OrderedHashmap *h) {
+        return internal_hashmap_memory_usage(HASHMAP_BASE(h));
+}
+
 bool internal_hashmap_iterate(HashmapBase *h, Iterator *i, void **value, const void **key);
 static inline bool hashmap_iterate(Hashmap *h, Iterator *i, void **value, const void **key) {
         return internal_hashmap_iterate(HASHMAP_BASE(h), i, value, key);
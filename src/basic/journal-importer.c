@@ -119,10 +119,13 @@ static int get_line(JournalImporter *imp, char **line, size_t *size) {
                         return -EAGAIN;
 
                 /* We know that imp->filled is at most DATA_SIZE_MAX, so if
-                   we reallocate it, we'll increase the size at least a bit. */
+                   we reallocate it, we'll increase the size at least a bit.
+                   Make room for a larger read than a single line needs, so
+                   that we don't have to go back to the kernel for every
+                   couple of entries. */
                 assert_cc(DATA_SIZE_MAX < ENTRY_SIZE_MAX);
                 if (imp->size - imp->filled < LINE_CHUNK &&
-                    !realloc_buffer(imp, MIN(imp->filled + LINE_CHUNK, ENTRY_SIZE_MAX)))
+                    !realloc_buffer(imp, MIN(imp->filled + READ_CHUNK, ENTRY_SIZE_MAX)))
                                 return log_oom();
 
                 assert(imp->buf);
@@ -261,6 +264,10 @@ static int process_dunder(JournalImporter *imp, char *line, size_t n) {
         /* XXX: is it worth to support timestamps in extended format?
          * We don't produce them, but who knows... */
 
+        /* Most lines are regular fields, don't bother comparing them with all the prefixes below */
+        if (!startswith(line, "__"))
+                return 0;
+
         timestamp = startswith(line, "__CURSOR=");
         if (timestamp)
                 /* ignore __CURSOR */
@@ -290,14 +297,8 @@ static int process_dunder(JournalImporter *imp, char *line, size_t n) {
                 return r < 0 ? r : 1;
         }
 
-        timestamp = startswith(line, "__");
-        if (timestamp) {
-                log_notice("Unknown dunder line %s", line);
-                return 1;
-        }
-
-        /* no dunder */
-        return 0;
+        log_notice("Unknown dunder line %s", line);
+        return 1;
 }
 
 int journal_importer_process_data(JournalImporter *imp) {
@@ -442,17 +443,20 @@ int journal_importer_push_data(JournalImporter *imp, const char *data, size_t si
 void journal_importer_drop_iovw(JournalImporter *imp) {
         size_t remain, target;
 
-        /* This function drops processed data that along with the iovw that points at it */
+        /* This function drops processed data that along with the iovw that points at it. The iovec array itself is
+         * kept around for the next entry, which usually has about the same number of fields. */
 
-        iovw_free_contents(&imp->iovw);
+        imp->iovw.count = 0;
 
         /* possibly reset buffer position */
         remain = imp->filled - imp->offset;
 
         if (remain == 0) /* no brainer */
                 imp->offset = imp->scanned = imp->filled = 0;
-        else if (imp->offset > imp->size - imp->filled &&
+        else if (imp->size - imp->filled < LINE_CHUNK &&
                  imp->offset > remain) {
+                /* Only move the remaining data to the front once we run out of space for reading, not after
+                 * every entry, since with read-ahead there's usually quite a bit of it. */
                 memcpy(imp->buf, imp->buf + imp->offset, remain);
                 imp->offset = imp->scanned = 0;
                 imp->filled = remain;
@@ -30,6 +30,7 @@
 #define ENTRY_SIZE_MAX (1024*1024*770u)
 #define DATA_SIZE_MAX (1024*1024*768u)
 #define LINE_CHUNK 8*1024u
+#define READ_CHUNK 64*1024u
 
 struct iovec_wrapper {
         struct iovec *iovec;
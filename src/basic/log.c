@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
@@ -76,6 +77,20 @@ static bool upgrade_syslog_to_journal = false;
 static bool always_reopen_console = false;
 static bool open_when_needed = false;
 
+/* In asynchronous mode, messages the journal socket doesn't take right away are queued up here, to be
+ * sent with the next message or log_flush_async(). Like the rest of this file, this is not thread-safe. */
+#define LOG_QUEUE_MAX 256U
+#define LOG_QUEUE_BYTES_MAX (1024U*1024U)
+
+static bool log_async = false;
+static struct iovec log_queue[LOG_QUEUE_MAX];
+static unsigned log_queue_first = 0, log_queue_n = 0;
+static size_t log_queue_bytes = 0;
+static unsigned log_queue_dropped = 0;
+static pid_t log_queue_pid = 0;
+
+static int log_queue_flush(int flags);
+
 /* Akin to glibc's __abort_msg; which is private and we hence cannot
  * use here. */
 static char *log_abort_msg = NULL;
@@ -197,6 +212,11 @@ fail:
 }
 
 void log_close_journal(void) {
+        /* Don't lose what is still queued up in asynchronous mode. This blocks at most for the send
+         * timeout of the socket. */
+        if (journal_fd >= 0)
+                (void) log_queue_flush(0);
+
         journal_fd = safe_close(journal_fd);
 }
 
@@ -527,6 +547,146 @@ static int log_do_header(
         return 0;
 }
 
+static void log_queue_pop(void) {
+        assert(log_queue_n > 0);
+
+        log_queue_bytes -= log_queue[log_queue_first].iov_len;
+        log_queue[log_queue_first] = IOVEC_MAKE(mfree(log_queue[log_queue_first].iov_base), 0);
+
+        log_queue_first = (log_queue_first + 1) % LOG_QUEUE_MAX;
+        log_queue_n--;
+}
+
+static void log_queue_forget_inherited(void) {
+
+        /* A child forked off while messages were queued inherits a copy of the queue. Those messages are
+         * the parent's to send, hence drop them in the child rather than sending them twice. */
+
+        if (log_queue_pid == getpid_cached())
+                return;
+
+        while (log_queue_n > 0)
+                log_queue_pop();
+
+        log_queue_first = 0;
+        log_queue_dropped = 0;
+        log_queue_pid = getpid_cached();
+}
+
+static void log_queue_push(const struct msghdr *mh) {
+        struct iovec *q;
+        size_t l = 0, i;
+        uint8_t *p;
+
+        log_queue_forget_inherited();
+
+        for (i = 0; i < mh->msg_iovlen; i++)
+                l += mh->msg_iov[i].iov_len;
+
+        if (log_queue_n >= LOG_QUEUE_MAX || log_queue_bytes + l > LOG_QUEUE_BYTES_MAX)
+                goto drop;
+
+        p = malloc(l);
+        if (!p)
+                goto drop;
+
+        q = log_queue + (log_queue_first + log_queue_n) % LOG_QUEUE_MAX;
+        *q = IOVEC_MAKE(p, l);
+
+        for (i = 0; i < mh->msg_iovlen; i++)
+                p = mempcpy(p, mh->msg_iov[i].iov_base, mh->msg_iov[i].iov_len);
+
+        log_queue_n++;
+        log_queue_bytes += l;
+        return;
+
+drop:
+        log_queue_dropped++;
+}
+
+static int log_queue_flush(int flags) {
+        char header[LINE_MAX], message[sizeof("MESSAGE=Dropped  log messages while the journal was busy.\n") + DECIMAL_STR_MAX(unsigned)];
+        struct iovec iovec[2];
+        struct msghdr mh = {
+                .msg_iov = iovec,
+                .msg_iovlen = ELEMENTSOF(iovec),
+        };
+
+        if (log_queue_n == 0 && log_queue_dropped == 0)
+                return 0;
+
+        log_queue_forget_inherited();
+
+        while (log_queue_n > 0) {
+                if (journal_fd < 0)
+                        return log_queue_n;
+
+                if (send(journal_fd, log_queue[log_queue_first].iov_base, log_queue[log_queue_first].iov_len, MSG_NOSIGNAL|flags) < 0) {
+                        if (errno == EAGAIN)
+                                return log_queue_n;
+                        if (errno != EMSGSIZE)
+                                return -errno;
+
+                        /* The message will never fit, count it as dropped and go on */
+                        log_queue_dropped++;
+                }
+
+                log_queue_pop();
+        }
+
+        if (log_queue_dropped == 0 || journal_fd < 0)
+                return 0;
+
+        log_do_header(header, sizeof(header), log_facility|LOG_WARNING, 0, NULL, 0, NULL, NULL, NULL, NULL, NULL);
+        xsprintf(message, "MESSAGE=Dropped %u log messages while the journal was busy.\n", log_queue_dropped);
+        iovec[0] = IOVEC_MAKE_STRING(header);
+        iovec[1] = IOVEC_MAKE_STRING(message);
+
+        if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL|flags) >= 0)
+                log_queue_dropped = 0;
+
+        return 0;
+}
+
+int log_flush_async(void) {
+
+        /* Sends out what is queued up without blocking, and returns the number of messages still queued,
+         * or a negative errno if the journal socket doesn't take them. */
+
+        return log_queue_flush(MSG_DONTWAIT);
+}
+
+static int journal_sendmsg(const struct msghdr *mh) {
+        int r;
+
+        if (!log_async) {
+                /* Asynchronous mode was turned off in the meantime? Then wait for the rest of the queue first */
+                r = log_queue_flush(0);
+                if (r < 0)
+                        return r;
+
+                if (sendmsg(journal_fd, mh, MSG_NOSIGNAL) < 0)
+                        return -errno;
+
+                return 1;
+        }
+
+        /* Keep the order, only send directly if nothing older is still waiting */
+        r = log_flush_async();
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                if (sendmsg(journal_fd, mh, MSG_NOSIGNAL|MSG_DONTWAIT) >= 0)
+                        return 1;
+                if (errno != EAGAIN)
+                        return -errno;
+        }
+
+        /* Queued or dropped, either way don't block and don't fall back to the (slow) console */
+        log_queue_push(mh);
+        return 1;
+}
+
 static int write_to_journal(
                 int level,
                 int error,
@@ -556,10 +716,7 @@ static int write_to_journal(
         mh.msg_iov = iovec;
         mh.msg_iovlen = ELEMENTSOF(iovec);
 
-        if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) < 0)
-                return -errno;
-
-        return 1;
+        return journal_sendmsg(&mh);
 }
 
 int log_dispatch_internal(
@@ -945,7 +1102,7 @@ int log_struct_internal(
                                 fallback = true;
                         else {
                                 mh.msg_iovlen = n;
-                                (void) sendmsg(journal_fd, &mh, MSG_NOSIGNAL);
+                                (void) journal_sendmsg(&mh);
                         }
 
                         va_end(ap);
@@ -1041,7 +1198,7 @@ int log_struct_iovec_internal(
                         iovec[1+i*2+1] = IOVEC_MAKE_STRING("\n");
                 }
 
-                if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) >= 0)
+                if (journal_sendmsg(&mh) >= 0)
                         return -error;
         }
 
@@ -1153,6 +1310,17 @@ void log_parse_environment_realm(LogRealm realm) {
         e = getenv("SYSTEMD_LOG_LOCATION");
         if (e && log_show_location_from_string(e) < 0)
                 log_warning("Failed to parse bool '%s'. Ignoring.", e);
+
+        e = getenv("SYSTEMD_LOG_ASYNC");
+        if (e) {
+                int r;
+
+                r = parse_boolean(e);
+                if (r < 0)
+                        log_warning("Failed to parse bool '%s'. Ignoring.", e);
+                else
+                        log_set_async(r);
+        }
 }
 
 LogTarget log_get_target(void) {
@@ -1299,3 +1467,17 @@ void log_set_always_reopen_console(bool b) {
 void log_set_open_when_needed(bool b) {
         open_when_needed = b;
 }
+
+static void log_flush_at_exit(void) {
+        (void) log_queue_flush(0);
+}
+
+void log_set_async(bool b) {
+        static bool registered = false;
+
+        /* Make sure the queue is sent out when the process exits without closing the log first */
+        if (b && !registered)
+                registered = atexit(log_flush_at_exit) == 0;
+
+        log_async = b;
+}
@@ -305,6 +305,9 @@ void log_set_upgrade_syslog_to_journal(bool b);
 void log_set_always_reopen_console(bool b);
 void log_set_open_when_needed(bool b);
 
+void log_set_async(bool b);
+int log_flush_async(void);
+
 int log_syntax_internal(
                 const char *unit,
                 int level,
@@ -21,14 +21,20 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "alloc-util.h"
 #include "macro.h"
 #include "mempool.h"
 #include "util.h"
 
+/* Pools double in size as they are added, but only up to this size, so that they have a chance to become
+ * entirely unused again, and may be released by mempool_trim() */
+#define POOL_SIZE_MAX (1024U*1024U)
+
 struct pool {
         struct pool *next;
         unsigned n_tiles;
         unsigned n_used;
+        unsigned n_free; /* only used during mempool_trim() */
 };
 
 void* mempool_alloc_tile(struct mempool *mp) {
@@ -45,6 +51,7 @@ void* mempool_alloc_tile(struct mempool *mp) {
 
                 r = mp->freelist;
                 mp->freelist = * (void**) mp->freelist;
+                mp->n_used++;
                 return r;
         }
 
@@ -55,7 +62,7 @@ void* mempool_alloc_tile(struct mempool *mp) {
                 struct pool *p;
 
                 n = mp->first_pool ? mp->first_pool->n_tiles : 0;
-                n = MAX(mp->at_least, n * 2);
+                n = MAX(mp->at_least, MIN(n * 2, (unsigned) (POOL_SIZE_MAX / mp->tile_size)));
                 size = PAGE_ALIGN(ALIGN(sizeof(struct pool)) + n*mp->tile_size);
                 n = (size - ALIGN(sizeof(struct pool))) / mp->tile_size;
 
@@ -71,6 +78,7 @@ void* mempool_alloc_tile(struct mempool *mp) {
         }
 
         i = mp->first_pool->n_used++;
+        mp->n_used++;
 
         return ((uint8_t*) mp->first_pool) + ALIGN(sizeof(struct pool)) + i*mp->tile_size;
 }
@@ -87,18 +95,123 @@ void* mempool_alloc0_tile(struct mempool *mp) {
 void mempool_free_tile(struct mempool *mp, void *p) {
         * (void**) p = mp->freelist;
         mp->freelist = p;
+
+        assert(mp->n_used > 0);
+        mp->n_used--;
+        mp->n_freed++;
+}
+
+static int pool_compare(const void *a, const void *b) {
+        const struct pool *x = *(const struct pool**) a, *y = *(const struct pool**) b;
+
+        return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static struct pool *pool_of_tile(struct mempool *mp, struct pool **pools, unsigned n_pools, void *t) {
+        unsigned l = 0, r = n_pools;
+
+        /* Finds the pool with the highest address not above the tile, in the array sorted by address */
+
+        while (r - l > 1) {
+                unsigned m = l + (r - l) / 2;
+
+                if ((uint8_t*) pools[m] <= (uint8_t*) t)
+                        l = m;
+                else
+                        r = m;
+        }
+
+        assert(n_pools > 0);
+        assert((uint8_t*) t >= (uint8_t*) pools[l] + ALIGN(sizeof(struct pool)));
+        assert((uint8_t*) t < (uint8_t*) pools[l] + ALIGN(sizeof(struct pool)) + pools[l]->n_used * mp->tile_size);
+
+        return pools[l];
+}
+
+void mempool_trim(struct mempool *mp) {
+        _cleanup_free_ struct pool **pools = NULL;
+        struct pool *p, **q;
+        unsigned n_pools = 0;
+        void **t;
+
+        /* Releases all pools none of which tiles are in use anymore. Unused tiles are only tracked on the
+         * free list, hence count for each pool how many of its tiles are on it, then unlink the tiles of the
+         * pools that are entirely unused, and free those. To find the pool of a tile quickly, the pools are
+         * sorted by address first, and looked up by binary search. */
+
+        mp->n_freed = 0;
+
+        if (mp->n_used == 0) {
+                mempool_drop(mp);
+                return;
+        }
+
+        for (p = mp->first_pool; p; p = p->next)
+                n_pools++;
+
+        pools = new(struct pool*, n_pools);
+        if (!pools)
+                return;
+
+        n_pools = 0;
+        for (p = mp->first_pool; p; p = p->next) {
+                p->n_free = 0;
+                pools[n_pools++] = p;
+        }
+
+        qsort_safe(pools, n_pools, sizeof(struct pool*), pool_compare);
+
+        for (t = mp->freelist; t; t = *t)
+                pool_of_tile(mp, pools, n_pools, t)->n_free++;
+
+        for (t = &mp->freelist; *t; ) {
+                p = pool_of_tile(mp, pools, n_pools, *t);
+                if (p->n_free == p->n_used)
+                        *t = * (void**) *t;
+                else
+                        t = *t;
+        }
+
+        for (q = &mp->first_pool; *q; ) {
+                p = *q;
+                if (p->n_free == p->n_used) {
+                        *q = p->next;
+                        free(p);
+                } else
+                        q = &p->next;
+        }
 }
 
-#ifdef VALGRIND
+size_t mempool_allocated(const struct mempool *mp, unsigned *ret_n_tiles) {
+        struct pool *p;
+        unsigned n = 0;
+        size_t sz = 0;
+
+        for (p = mp->first_pool; p; p = p->next) {
+                n += p->n_tiles;
+                sz += PAGE_ALIGN(ALIGN(sizeof(struct pool)) + p->n_tiles * mp->tile_size);
+        }
+
+        if (ret_n_tiles)
+                *ret_n_tiles = n;
+
+        return sz;
+}
 
 void mempool_drop(struct mempool *mp) {
         struct pool *p = mp->first_pool;
+
+        /* Releases all pools. The caller has to make sure none of the tiles is in use anymore. */
+
         while (p) {
                 struct pool *n;
                 n = p->next;
                 free(p);
                 p = n;
         }
-}
 
-#endif
+        mp->first_pool = NULL;
+        mp->freelist = NULL;
+        mp->n_used = 0;
+        mp->n_freed = 0;
+}
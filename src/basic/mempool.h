@@ -29,11 +29,16 @@ struct mempool {
         void *freelist;
         size_t tile_size;
         unsigned at_least;
+        unsigned n_used; /* tiles currently handed out */
+        unsigned n_freed; /* tiles given back since mempool_trim() last ran */
 };
 
 void* mempool_alloc_tile(struct mempool *mp);
 void* mempool_alloc0_tile(struct mempool *mp);
 void mempool_free_tile(struct mempool *mp, void *p);
+void mempool_trim(struct mempool *mp);
+size_t mempool_allocated(const struct mempool *mp, unsigned *ret_n_tiles);
+void mempool_drop(struct mempool *mp);
 
 #define DEFINE_MEMPOOL(pool_name, tile_type, alloc_at_least) \
 static struct mempool pool_name = { \
@@ -41,7 +46,3 @@ static struct mempool pool_name = { \
         .at_least = alloc_at_least, \
 }
 
-
-#ifdef VALGRIND
-void mempool_drop(struct mempool *mp);
-#endif
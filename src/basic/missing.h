@@ -324,6 +324,23 @@ struct btrfs_ioctl_clone_range_args {
         __u64 dest_offset;
 };
 
+struct btrfs_ioctl_same_extent_info {
+        __s64 fd;
+        __u64 logical_offset;
+        __u64 bytes_deduped;
+        __s32 status;
+        __u32 reserved;
+};
+
+struct btrfs_ioctl_same_args {
+        __u64 logical_offset;
+        __u64 length;
+        __u16 dest_count;
+        __u16 reserved1;
+        __u32 reserved2;
+        struct btrfs_ioctl_same_extent_info info[];
+};
+
 #define BTRFS_QUOTA_CTL_ENABLE  1
 #define BTRFS_QUOTA_CTL_DISABLE 2
 #define BTRFS_QUOTA_CTL_RESCAN__NOTUSED 3
@@ -352,6 +369,15 @@ struct btrfs_ioctl_quota_ctl_args {
                                  struct btrfs_ioctl_clone_range_args)
 #endif
 
+#ifndef BTRFS_IOC_FILE_EXTENT_SAME
+#define BTRFS_IOC_FILE_EXTENT_SAME _IOWR(BTRFS_IOCTL_MAGIC, 54, \
+                                 struct btrfs_ioctl_same_args)
+#endif
+
+#ifndef BTRFS_SAME_DATA_DIFFERS
+#define BTRFS_SAME_DATA_DIFFERS 1
+#endif
+
 #ifndef BTRFS_IOC_SUBVOL_CREATE
 #define BTRFS_IOC_SUBVOL_CREATE _IOW(BTRFS_IOCTL_MAGIC, 14, \
                                  struct btrfs_ioctl_vol_args)
@@ -348,3 +348,65 @@ static inline int bpf(int cmd, union bpf_attr *attr, size_t size) {
 }
 
 #endif
+
+/* ======================================================================= */
+
+#ifndef __NR_pidfd_open
+#  if defined __alpha__
+#    define __NR_pidfd_open 544
+#  elif defined __ia64__
+#    define __NR_pidfd_open 1458
+#  elif defined _MIPS_SIM
+#    if _MIPS_SIM == _MIPS_SIM_ABI32
+#      define __NR_pidfd_open 4434
+#    elif _MIPS_SIM == _MIPS_SIM_NABI32
+#      define __NR_pidfd_open 6434
+#    elif _MIPS_SIM == _MIPS_SIM_ABI64
+#      define __NR_pidfd_open 5434
+#    endif
+#  else
+#    define __NR_pidfd_open 434
+#  endif
+#endif
+
+/* Always go through the system call directly, the libc wrapper lives in a header of its own and might not
+ * exist at all. Callers have to handle ENOSYS, as the running kernel might be older than the headers. */
+static inline int missing_pidfd_open(pid_t pid, unsigned flags) {
+#ifdef __NR_pidfd_open
+        return (int) syscall(__NR_pidfd_open, pid, flags);
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+}
+
+/* ======================================================================= */
+
+#if !HAVE_DECL_CLOSE_RANGE
+#  ifndef __NR_close_range
+#    if defined __alpha__
+#      define __NR_close_range 546
+#    elif defined __ia64__
+#      define __NR_close_range 1460
+#    elif defined _MIPS_SIM
+#      if _MIPS_SIM == _MIPS_SIM_ABI32
+#        define __NR_close_range 4436
+#      elif _MIPS_SIM == _MIPS_SIM_NABI32
+#        define __NR_close_range 6436
+#      elif _MIPS_SIM == _MIPS_SIM_ABI64
+#        define __NR_close_range 5436
+#      endif
+#    else
+#      define __NR_close_range 436
+#    endif
+#  endif
+
+static inline int close_range(unsigned first_fd, unsigned end_fd, int flags) {
+#  ifdef __NR_close_range
+        return (int) syscall(__NR_close_range, first_fd, end_fd, flags);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+#endif
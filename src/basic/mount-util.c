@@ -323,6 +323,7 @@ static int get_mount_flags(const char *path, unsigned long *flags) {
 int bind_remount_recursive_with_mountinfo(const char *prefix, bool ro, char **blacklist, FILE *proc_self_mountinfo) {
         _cleanup_set_free_free_ Set *done = NULL;
         _cleanup_free_ char *cleaned = NULL;
+        bool escaped;
         int r;
 
         assert(proc_self_mountinfo);
@@ -344,6 +345,10 @@ int bind_remount_recursive_with_mountinfo(const char *prefix, bool ro, char **bl
 
         path_kill_slashes(cleaned);
 
+        /* The kernel escapes these characters in /proc/self/mountinfo. If the prefix contains none of them, we
+         * can compare it against the escaped mount point, and skip unescaping all the unrelated mounts. */
+        escaped = strpbrk(cleaned, " \t\n\\");
+
         done = set_new(&string_hash_ops);
         if (!done)
                 return -ENOMEM;
@@ -386,6 +391,9 @@ int bind_remount_recursive_with_mountinfo(const char *prefix, bool ro, char **bl
                                 continue;
                         }
 
+                        if (!escaped && !path_startswith(path, cleaned))
+                                continue;
+
                         r = cunescape(path, UNESCAPE_RELAX, &p);
                         if (r < 0)
                                 return r;
@@ -1052,6 +1052,39 @@ pid_t getpid_cached(void) {
         }
 }
 
+int pid_trylock(pid_t *owner) {
+        pid_t pid, previous;
+
+        assert(owner);
+
+        /* Tries to take a lock that records the PID of its holder in *owner. The lock is only ever tried, never
+         * waited for, as a normal mutex held by some other thread at the time of fork() would stay locked forever in
+         * the child. Hence, if the lock is held by a thread of the process we were forked from, we take it over.
+         *
+         * Returns 0 if the lock was free and is ours now, > 0 if we took it over, in which case its previous holder
+         * might have left the data it guards in an inconsistent state, and -EBUSY if another thread of ours holds
+         * it. */
+
+        pid = getpid_cached();
+
+        previous = __sync_val_compare_and_swap(owner, 0, pid);
+        if (previous == 0)
+                return 0;
+        if (previous == pid)
+                return -EBUSY;
+
+        if (!__sync_bool_compare_and_swap(owner, previous, pid))
+                return -EBUSY;
+
+        return 1;
+}
+
+void pid_unlock(pid_t *owner) {
+        assert(owner);
+
+        assert_se(__sync_bool_compare_and_swap(owner, getpid_cached(), 0));
+}
+
 static const char *const ioprio_class_table[] = {
         [IOPRIO_CLASS_NONE] = "none",
         [IOPRIO_CLASS_RT] = "realtime",
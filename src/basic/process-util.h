@@ -137,3 +137,6 @@ static inline bool pid_is_valid(pid_t p) {
 int ioprio_parse_priority(const char *s, int *ret);
 
 pid_t getpid_cached(void);
+
+int pid_trylock(pid_t *owner);
+void pid_unlock(pid_t *owner);
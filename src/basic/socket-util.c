@@ -488,9 +488,18 @@ const char* socket_address_get_path(const SocketAddress *a) {
 }
 
 bool socket_ipv6_is_supported(void) {
-        if (access("/proc/net/if_inet6", F_OK) != 0)
+        static bool cached = false;
+
+        /* This is called for every configured socket address, hence cache the result. Only the positive one is
+         * cached though, as IPv6 support might show up later on, when the ipv6 module is loaded. */
+
+        if (cached)
+                return true;
+
+        if (access("/proc/net/if_inet6", F_OK) < 0)
                 return false;
 
+        cached = true;
         return true;
 }
 
@@ -0,0 +1,172 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "hashmap.h"
+#include "string-pool.h"
+#include "string-util.h"
+
+/* Like strbuf, the string is stored right behind its header in a single allocation, and the
+ * hashmap is keyed by the inline copy. Thus, the header of any interned string may be found
+ * without a lookup. */
+typedef struct StringPoolEntry {
+        unsigned n_ref;
+        char s[];
+} StringPoolEntry;
+
+struct StringPool {
+        Hashmap *strings;
+};
+
+static StringPoolEntry *entry_of(const char *s) {
+        return (StringPoolEntry*) (s - offsetof(StringPoolEntry, s));
+}
+
+StringPool *string_pool_new(void) {
+        StringPool *p;
+
+        p = new0(StringPool, 1);
+        if (!p)
+                return NULL;
+
+        p->strings = hashmap_new(&string_hash_ops);
+        if (!p->strings)
+                return mfree(p);
+
+        return p;
+}
+
+StringPool *string_pool_free(StringPool *p) {
+        if (!p)
+                return NULL;
+
+        /* References may still be out there if the owner tears down everything at once, they
+         * become invalid here. */
+        hashmap_free_free(p->strings);
+
+        return mfree(p);
+}
+
+const char *string_pool_ref(StringPool *p, const char *s) {
+        StringPoolEntry *e;
+        size_t l;
+
+        assert(p);
+
+        if (!s)
+                return NULL;
+
+        e = hashmap_get(p->strings, s);
+        if (e) {
+                e->n_ref++;
+                return e->s;
+        }
+
+        l = strlen(s);
+        e = malloc(offsetof(StringPoolEntry, s) + l + 1);
+        if (!e)
+                return NULL;
+
+        e->n_ref = 1;
+        memcpy(e->s, s, l + 1);
+
+        if (hashmap_put(p->strings, e->s, e) < 0) {
+                free(e);
+                return NULL;
+        }
+
+        return e->s;
+}
+
+const char *string_pool_ref_interned(const char *s) {
+
+        /* Takes another reference to a string already interned, which doesn't need the pool */
+
+        if (!s)
+                return NULL;
+
+        entry_of(s)->n_ref++;
+        return s;
+}
+
+const char *string_pool_unref(StringPool *p, const char *s) {
+        StringPoolEntry *e;
+
+        if (!s)
+                return NULL;
+
+        assert(p);
+
+        e = entry_of(s);
+        assert(e->n_ref > 0);
+
+        e->n_ref--;
+        if (e->n_ref > 0)
+                return NULL;
+
+        assert_se(hashmap_remove(p->strings, e->s) == e);
+        free(e);
+
+        return NULL;
+}
+
+int string_pool_set(StringPool *p, const char **field, const char *s) {
+        const char *n;
+
+        assert(p);
+        assert(field);
+
+        /* Like free_and_strdup(), but for interned strings */
+
+        if (streq_ptr(*field, s))
+                return 0;
+
+        if (s) {
+                n = string_pool_ref(p, s);
+                if (!n)
+                        return -ENOMEM;
+        } else
+                n = NULL;
+
+        string_pool_unref(p, *field);
+        *field = n;
+
+        return 1;
+}
+
+int string_pool_set_interned(StringPool *p, const char **field, const char *s) {
+        assert(p);
+        assert(field);
+
+        /* Same as string_pool_set(), but s is from the same pool already, hence this boils down to
+         * a pointer comparison and a refcount bump, and can't fail. */
+
+        if (*field == s)
+                return 0;
+
+        string_pool_unref(p, *field);
+        *field = string_pool_ref_interned(s);
+
+        return 1;
+}
+
+unsigned string_pool_size(StringPool *p) {
+        return p ? hashmap_size(p->strings) : 0;
+}
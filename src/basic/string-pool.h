@@ -0,0 +1,38 @@
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "macro.h"
+
+/* A pool of refcounted, immutable strings. Each distinct string is stored once, hence two strings
+ * interned in the same pool are equal exactly if their pointers are. */
+
+typedef struct StringPool StringPool;
+
+StringPool *string_pool_new(void);
+StringPool *string_pool_free(StringPool *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(StringPool*, string_pool_free);
+
+const char *string_pool_ref(StringPool *p, const char *s);
+const char *string_pool_ref_interned(const char *s);
+const char *string_pool_unref(StringPool *p, const char *s);
+
+int string_pool_set(StringPool *p, const char **field, const char *s);
+int string_pool_set_interned(StringPool *p, const char **field, const char *s);
+
+unsigned string_pool_size(StringPool *p);
@@ -50,6 +50,14 @@
         VALID_CHARS_WITH_AT                     \
         "[]!-*?"
 
+static bool char_is_valid_with_at(char c) {
+        /* Equivalent to strchr(VALID_CHARS_WITH_AT, c), but without scanning the string for each character checked */
+        return (c >= '0' && c <= '9') ||
+                (c >= 'a' && c <= 'z') ||
+                (c >= 'A' && c <= 'Z') ||
+                IN_SET(c, ':', '-', '_', '.', '\\', '@');
+}
+
 bool unit_name_is_valid(const char *n, UnitNameFlags flags) {
         const char *e, *i, *at;
 
@@ -76,7 +84,7 @@ bool unit_name_is_valid(const char *n, UnitNameFlags flags) {
                 if (*i == '@' && !at)
                         at = i;
 
-                if (!strchr("@" VALID_CHARS, *i))
+                if (!char_is_valid_with_at(*i))
                         return false;
         }
 
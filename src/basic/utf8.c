@@ -144,6 +144,27 @@ int utf8_encoded_to_unichar(const char *str, char32_t *ret_unichar) {
         return 0;
 }
 
+/* Checks 8 bytes at once whether they are all printable ASCII, i.e. in the range ' '…'~'. Adapted from the "determine
+ * if a word has a byte less than/greater than n" bit twiddling hacks. */
+#define BYTES_ONES UINT64_C(0x0101010101010101)
+#define BYTES_HIGH UINT64_C(0x8080808080808080)
+
+static bool ascii_word_is_printable(const char *p) {
+        uint64_t x;
+
+        memcpy(&x, p, sizeof(x));
+
+        /* Any byte below ' '? */
+        if ((x - BYTES_ONES * ' ') & ~x & BYTES_HIGH)
+                return false;
+
+        /* Any byte at or above DEL? */
+        if ((((x & ~BYTES_HIGH) + BYTES_ONES) | x) & BYTES_HIGH)
+                return false;
+
+        return true;
+}
+
 bool utf8_is_printable_newline(const char* str, size_t length, bool newline) {
         const char *p;
 
@@ -153,6 +174,13 @@ bool utf8_is_printable_newline(const char* str, size_t length, bool newline) {
                 int encoded_len, r;
                 char32_t val;
 
+                /* Most strings we are asked about are plain ASCII, skip over them quickly */
+                if (length >= sizeof(uint64_t) && ascii_word_is_printable(p)) {
+                        length -= sizeof(uint64_t);
+                        p += sizeof(uint64_t);
+                        continue;
+                }
+
                 encoded_len = utf8_encoded_valid_unichar(p);
                 if (encoded_len < 0 ||
                     (size_t) encoded_len > length)
@@ -179,6 +207,11 @@ const char *utf8_is_valid(const char *str) {
         for (p = (const uint8_t*) str; *p; ) {
                 int len;
 
+                if (*p < 0x80) {
+                        p++;
+                        continue;
+                }
+
                 len = utf8_encoded_valid_unichar((const char *)p);
                 if (len < 0)
                         return NULL;
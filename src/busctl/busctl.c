@@ -25,6 +25,7 @@
 #include "bus-dump.h"
 #include "bus-internal.h"
 #include "bus-signature.h"
+#include "bus-stats.h"
 #include "bus-type.h"
 #include "bus-util.h"
 #include "busctl-introspect.h"
@@ -62,6 +63,9 @@ static bool arg_allow_interactive_authorization = true;
 static bool arg_augment_creds = true;
 static usec_t arg_timeout = 0;
 
+/* Output buffer for captures, so that busy buses don't result in one write() per message */
+#define CAPTURE_BUFFER_SIZE (1024U*1024U)
+
 #define NAME_IS_ACQUIRED INT_TO_PTR(1)
 #define NAME_IS_ACTIVATABLE INT_TO_PTR(2)
 
@@ -1174,9 +1178,9 @@ static int monitor(sd_bus *bus, char *argv[], int (*dump)(sd_bus_message *m, FIL
 
                 if (m) {
                         dump(m, stdout);
-                        fflush(stdout);
 
                         if (sd_bus_message_is_signal(m, "org.freedesktop.DBus.Local", "Disconnected") > 0) {
+                                fflush(stdout);
                                 log_info("Connection terminated, exiting.");
                                 return 0;
                         }
@@ -1187,6 +1191,10 @@ static int monitor(sd_bus *bus, char *argv[], int (*dump)(sd_bus_message *m, FIL
                 if (r > 0)
                         continue;
 
+                /* Only flush once all queued messages have been written out, so that we keep up with busy
+                 * buses instead of doing a write() for each message. */
+                fflush(stdout);
+
                 r = sd_bus_wait(bus, (uint64_t) -1);
                 if (r < 0)
                         return log_error_errno(r, "Failed to wait for bus: %m");
@@ -1201,6 +1209,9 @@ static int capture(sd_bus *bus, char *argv[]) {
                 return -EINVAL;
         }
 
+        if (setvbuf(stdout, NULL, _IOFBF, CAPTURE_BUFFER_SIZE) != 0)
+                log_debug("Failed to enlarge output buffer, ignoring.");
+
         bus_pcap_header(arg_snaplen, stdout);
 
         r = monitor(bus, argv, message_pcap);
@@ -1717,6 +1728,178 @@ static int set_property(sd_bus *bus, char *argv[]) {
         return 0;
 }
 
+typedef struct MethodStats {
+        const char *interface;
+        const char *member;
+        uint64_t n[_BUS_STATS_PHASE_MAX];
+        usec_t total[_BUS_STATS_PHASE_MAX];
+        usec_t p99[_BUS_STATS_PHASE_MAX];
+} MethodStats;
+
+static int method_stats_compare(const void *a, const void *b) {
+        const MethodStats *x = a, *y = b;
+        int r;
+
+        r = strcmp(x->interface, y->interface);
+        if (r != 0)
+                return r;
+
+        return strcmp(x->member, y->member);
+}
+
+static usec_t histogram_percentile(const uint64_t *buckets, size_t n_buckets, uint64_t n, unsigned percent) {
+        uint64_t sum = 0, need;
+        size_t i;
+
+        /* Returns the upper bound of the bucket the percentile falls into, which is 2^i µs for bucket i,
+         * and infinity for the last one */
+
+        need = (n * percent + 99) / 100;
+
+        for (i = 0; i < n_buckets; i++) {
+                sum += buckets[i];
+                if (sum >= need)
+                        break;
+        }
+
+        if (i >= n_buckets - 1)
+                return USEC_INFINITY;
+
+        return UINT64_C(1) << i;
+}
+
+static const char *format_latency(char *buf, size_t l, usec_t t) {
+        if (t == USEC_INFINITY)
+                return "-";
+        if (t == 0)
+                return "0";
+
+        return format_timespan(buf, l, t, 1);
+}
+
+static int stats(sd_bus *bus, char *argv[]) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ MethodStats *entries = NULL;
+        size_t n_entries = 0, n_allocated = 0, i;
+        uint32_t n_buckets;
+        int r;
+
+        assert(bus);
+
+        if (strv_length(argv) != 2) {
+                log_error("Expects one argument.");
+                return -EINVAL;
+        }
+
+        r = sd_bus_call_method(bus, argv[1], "/", BUS_STATS_INTERFACE, "GetMethodStats", &error, &reply, NULL);
+        if (r < 0) {
+                if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD) ||
+                    sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_OBJECT) ||
+                    sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_INTERFACE))
+                        log_error("Service %s does not collect call statistics. Set $SYSTEMD_BUS_STATS=1 in its environment to enable them.", argv[1]);
+                else
+                        log_error("Failed to get call statistics: %s", bus_error_message(&error, r));
+                return r;
+        }
+
+        r = sd_bus_message_read(reply, "u", &n_buckets);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_enter_container(reply, 'a', "(ssa(ttat))");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_enter_container(reply, 'r', "ssa(ttat)")) > 0) {
+                MethodStats *e;
+                unsigned p = 0;
+
+                if (!GREEDY_REALLOC0(entries, n_allocated, n_entries + 1))
+                        return log_oom();
+
+                e = entries + n_entries++;
+
+                r = sd_bus_message_read(reply, "ss", &e->interface, &e->member);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_enter_container(reply, 'a', "(ttat)");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                while ((r = sd_bus_message_enter_container(reply, 'r', "ttat")) > 0) {
+                        const uint64_t *buckets;
+                        uint64_t n;
+                        usec_t total;
+                        size_t sz;
+
+                        r = sd_bus_message_read(reply, "tt", &n, &total);
+                        if (r < 0)
+                                return bus_log_parse_error(r);
+
+                        r = sd_bus_message_read_array(reply, 't', (const void**) &buckets, &sz);
+                        if (r < 0)
+                                return bus_log_parse_error(r);
+
+                        if (p < _BUS_STATS_PHASE_MAX) {
+                                e->n[p] = n;
+                                e->total[p] = total;
+                                e->p99[p] = n > 0 && sz > 0 ? histogram_percentile(buckets, sz / sizeof(uint64_t), n, 99) : 0;
+                        }
+                        p++;
+
+                        r = sd_bus_message_exit_container(reply);
+                        if (r < 0)
+                                return bus_log_parse_error(r);
+                }
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        qsort_safe(entries, n_entries, sizeof(MethodStats), method_stats_compare);
+
+        pager_open(arg_no_pager, false);
+
+        if (arg_legend)
+                printf("%-40s %-32s %8s %10s %10s %10s %10s %10s %10s\n",
+                       "INTERFACE", "MEMBER", "CALLS",
+                       "QUEUED", "p99", "HANDLED", "p99", "REPLIED", "p99");
+
+        for (i = 0; i < n_entries; i++) {
+                char buf[_BUS_STATS_PHASE_MAX * 2][FORMAT_TIMESPAN_MAX];
+                const char *c[_BUS_STATS_PHASE_MAX * 2];
+                BusStatsPhase p;
+
+                for (p = 0; p < _BUS_STATS_PHASE_MAX; p++) {
+                        c[p * 2] = format_latency(buf[p * 2], sizeof(buf[p * 2]), entries[i].n[p] > 0 ? entries[i].total[p] / entries[i].n[p] : 0);
+                        c[p * 2 + 1] = format_latency(buf[p * 2 + 1], sizeof(buf[p * 2 + 1]), entries[i].p99[p]);
+                }
+
+                /* Calls to methods not found in any vtable are all counted under empty names */
+                printf("%-40s %-32s %8" PRIu64 " %10s %10s %10s %10s %10s %10s\n",
+                       isempty(entries[i].interface) ? "-" : entries[i].interface,
+                       isempty(entries[i].member) ? "(other)" : entries[i].member,
+                       entries[i].n[BUS_STATS_HANDLED],
+                       c[0], c[1], c[2], c[3], c[4], c[5]);
+        }
+
+        if (arg_legend)
+                printf("\nLatencies are averages, p99 columns show upper bounds of the 99th percentile.\n");
+
+        return 0;
+}
+
 static int help(void) {
         printf("%s [OPTIONS...] {COMMAND} ...\n\n"
                "Introspect the bus.\n\n"
@@ -1757,6 +1940,7 @@ static int help(void) {
                "                          Get property value\n"
                "  set-property SERVICE OBJECT INTERFACE PROPERTY SIGNATURE ARGUMENT...\n"
                "                          Set property value\n"
+               "  stats SERVICE           Show method call statistics of service\n"
                "  help                    Show this help\n"
                , program_invocation_short_name);
 
@@ -2002,6 +2186,9 @@ static int busctl_main(sd_bus *bus, int argc, char *argv[]) {
         if (streq(argv[optind], "set-property"))
                 return set_property(bus, argv + optind);
 
+        if (streq(argv[optind], "stats"))
+                return stats(bus, argv + optind);
+
         if (streq(argv[optind], "help"))
                 return help();
 
@@ -420,6 +420,10 @@ static int refresh_one(
         if (r < 0)
                 return r;
 
+        /* Children below the maximum depth are neither shown nor accounted, don't bother enumerating them */
+        if (depth == arg_depth)
+                goto finish;
+
         r = cg_enumerate_subgroups(controller, path, &d);
         if (r == -ENOENT)
                 return 0;
@@ -463,6 +467,7 @@ static int refresh_one(
                 }
         }
 
+finish:
         if (ret)
                 *ret = ours;
 
@@ -470,31 +475,35 @@ static int refresh_one(
 }
 
 static int refresh(const char *root, Hashmap *a, Hashmap *b, unsigned iteration) {
-        int r;
+        int r, all_unified;
 
         assert(a);
 
+        all_unified = cg_all_unified();
+        if (all_unified < 0)
+                return all_unified;
+
+        /* Each of these walks the whole tree, hence skip the controllers process() would ignore anyway: on the
+         * unified hierarchy "cpuacct" and "blkio" map to the very same tree as "cpu" and "io", and on the legacy
+         * hierarchy it's the other way round. */
+
         r = refresh_one(SYSTEMD_CGROUP_CONTROLLER, root, a, b, iteration, 0, NULL);
         if (r < 0)
                 return r;
-        r = refresh_one("cpu", root, a, b, iteration, 0, NULL);
-        if (r < 0)
-                return r;
-        r = refresh_one("cpuacct", root, a, b, iteration, 0, NULL);
+        r = refresh_one(all_unified ? "cpu" : "cpuacct", root, a, b, iteration, 0, NULL);
         if (r < 0)
                 return r;
         r = refresh_one("memory", root, a, b, iteration, 0, NULL);
         if (r < 0)
                 return r;
-        r = refresh_one("io", root, a, b, iteration, 0, NULL);
-        if (r < 0)
-                return r;
-        r = refresh_one("blkio", root, a, b, iteration, 0, NULL);
-        if (r < 0)
-                return r;
-        r = refresh_one("pids", root, a, b, iteration, 0, NULL);
+        r = refresh_one(all_unified ? "io" : "blkio", root, a, b, iteration, 0, NULL);
         if (r < 0)
                 return r;
+        if (arg_count == COUNT_PIDS) {
+                r = refresh_one("pids", root, a, b, iteration, 0, NULL);
+                if (r < 0)
+                        return r;
+        }
 
         return 0;
 }
@@ -949,6 +958,9 @@ int main(int argc, char *argv[]) {
                                 goto finish;
                         }
 
+                        log_debug("Refreshing %u control groups took %s.", hashmap_size(a),
+                                  format_timespan(h, sizeof(h), now(CLOCK_MONOTONIC) - t, USEC_PER_MSEC));
+
                         group_hashmap_clear(b);
 
                         c = a;
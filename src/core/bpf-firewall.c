@@ -36,7 +36,9 @@
 #include "bpf-firewall.h"
 #include "bpf-program.h"
 #include "fd-util.h"
+#include "in-addr-util.h"
 #include "ip-address-access.h"
+#include "siphash24.h"
 #include "unit.h"
 
 enum {
@@ -483,8 +485,54 @@ static int bpf_firewall_prepare_accounting_maps(bool enabled, int *fd_ingress, i
         return 0;
 }
 
+static void bpf_firewall_hash_access_items(IPAddressAccessItem *list, struct siphash *state) {
+        IPAddressAccessItem *a;
+
+        assert(state);
+
+        LIST_FOREACH(items, a, list) {
+                siphash24_compress(&a->family, sizeof(a->family), state);
+                siphash24_compress(&a->prefixlen, sizeof(a->prefixlen), state);
+                siphash24_compress(&a->address, FAMILY_ADDRESS_SIZE(a->family), state);
+        }
+
+        /* Terminate the list, so that items can't move between lists without changing the hash */
+        siphash24_compress_byte(0, state);
+}
+
+static uint64_t bpf_firewall_hash_config(Unit *u, bool accounting) {
+        static const uint8_t hash_key[16] = {
+                0x5c, 0x2a, 0x9e, 0x13, 0xd4, 0x71, 0x48, 0xb6,
+                0x8f, 0x03, 0xe7, 0x6a, 0x29, 0xc5, 0x90, 0x1d
+        };
+        struct siphash state;
+        Unit *p;
+
+        assert(u);
+
+        /* Hashes everything the compiled programs are derived from: the allow and deny lists of the unit and all
+         * slices it is contained in, and whether accounting is on. */
+
+        siphash24_init(&state, hash_key);
+        siphash24_compress_byte(accounting, &state);
+
+        for (p = u; p; p = UNIT_DEREF(p->slice)) {
+                CGroupContext *cc;
+
+                cc = unit_get_cgroup_context(p);
+                if (!cc)
+                        continue;
+
+                bpf_firewall_hash_access_items(cc->ip_address_allow, &state);
+                bpf_firewall_hash_access_items(cc->ip_address_deny, &state);
+        }
+
+        return siphash24_finalize(&state);
+}
+
 int bpf_firewall_compile(Unit *u) {
         CGroupContext *cc;
+        uint64_t hash;
         int r;
 
         assert(u);
@@ -497,6 +545,19 @@ int bpf_firewall_compile(Unit *u) {
                 return -EOPNOTSUPP;
         }
 
+        cc = unit_get_cgroup_context(u);
+        if (!cc)
+                return -EINVAL;
+
+        /* This is called on every cgroup realization. If the configuration didn't change since the last time, keep
+         * the programs and maps we already have, so that they don't need to be rebuilt and loaded into the kernel
+         * again. */
+        hash = bpf_firewall_hash_config(u, cc->ip_accounting);
+        if (u->ip_bpf_hash_valid && u->ip_bpf_hash == hash)
+                return 0;
+
+        u->ip_bpf_hash_valid = false;
+
         /* Note that when we compile a new firewall we first flush out the access maps and the BPF programs themselves,
          * but we reuse the the accounting maps. That way the firewall in effect always maps to the actual
          * configuration, but we don't flush out the accounting unnecessarily */
@@ -510,10 +571,6 @@ int bpf_firewall_compile(Unit *u) {
         u->ipv6_allow_map_fd = safe_close(u->ipv6_allow_map_fd);
         u->ipv6_deny_map_fd = safe_close(u->ipv6_deny_map_fd);
 
-        cc = unit_get_cgroup_context(u);
-        if (!cc)
-                return -EINVAL;
-
         r = bpf_firewall_prepare_access_maps(u, ACCESS_ALLOWED, &u->ipv4_allow_map_fd, &u->ipv6_allow_map_fd);
         if (r < 0)
                 return log_error_errno(r, "Preparation of eBPF allow maps failed: %m");
@@ -534,6 +591,9 @@ int bpf_firewall_compile(Unit *u) {
         if (r < 0)
                 return log_error_errno(r, "Compilation for egress BPF program failed: %m");
 
+        u->ip_bpf_hash = hash;
+        u->ip_bpf_hash_valid = true;
+
         return 0;
 }
 
@@ -564,9 +624,12 @@ int bpf_firewall_install(Unit *u) {
                 return log_error_errno(r, "Failed to determine cgroup path: %m");
 
         if (u->ip_bpf_egress) {
-                r = bpf_program_load_kernel(u->ip_bpf_egress, NULL, 0);
-                if (r < 0)
-                        return log_error_errno(r, "Kernel upload of egress BPF program failed: %m");
+                /* The program might have been loaded already, if it was reused from the last realization */
+                if (u->ip_bpf_egress->kernel_fd < 0) {
+                        r = bpf_program_load_kernel(u->ip_bpf_egress, NULL, 0);
+                        if (r < 0)
+                                return log_error_errno(r, "Kernel upload of egress BPF program failed: %m");
+                }
 
                 r = bpf_program_cgroup_attach(u->ip_bpf_egress, BPF_CGROUP_INET_EGRESS, path, cc->delegate ? BPF_F_ALLOW_OVERRIDE : 0);
                 if (r < 0)
@@ -579,9 +642,11 @@ int bpf_firewall_install(Unit *u) {
         }
 
         if (u->ip_bpf_ingress) {
-                r = bpf_program_load_kernel(u->ip_bpf_ingress, NULL, 0);
-                if (r < 0)
-                        return log_error_errno(r, "Kernel upload of ingress BPF program failed: %m");
+                if (u->ip_bpf_ingress->kernel_fd < 0) {
+                        r = bpf_program_load_kernel(u->ip_bpf_ingress, NULL, 0);
+                        if (r < 0)
+                                return log_error_errno(r, "Kernel upload of ingress BPF program failed: %m");
+                }
 
                 r = bpf_program_cgroup_attach(u->ip_bpf_ingress, BPF_CGROUP_INET_INGRESS, path, cc->delegate ? BPF_F_ALLOW_OVERRIDE : 0);
                 if (r < 0)
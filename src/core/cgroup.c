@@ -452,12 +452,57 @@ static uint64_t cgroup_context_cpu_shares(CGroupContext *c, ManagerState state)
                 return CGROUP_CPU_SHARES_DEFAULT;
 }
 
+static int unit_set_cgroup_attribute(Unit *u, const char *controller, const char *attribute, const char *value) {
+        _cleanup_free_ char *k = NULL, *v = NULL;
+        int r;
+
+        assert(u);
+        assert(attribute);
+        assert(value);
+
+        /* Writes a single-valued attribute of the unit's cgroup, unless we wrote the very same value to it
+         * already. The effect of writing attributes that take lists (such as devices.allow or the
+         * per-device settings) depends on what else was written, those need to go through
+         * cg_set_attribute() directly. */
+
+        if (streq_ptr(hashmap_get(u->cgroup_attributes, attribute), value))
+                return 0;
+
+        free(hashmap_remove2(u->cgroup_attributes, attribute, (void**) &k));
+        k = mfree(k);
+
+        r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
+        if (r < 0)
+                return r;
+
+        /* If we fail to remember the value, we'll simply write it again next time */
+        if (hashmap_ensure_allocated(&u->cgroup_attributes, &string_hash_ops) < 0)
+                return 0;
+
+        k = strdup(attribute);
+        v = strdup(value);
+        if (!k || !v)
+                return 0;
+
+        if (hashmap_put(u->cgroup_attributes, k, v) >= 0)
+                k = v = NULL;
+
+        return 0;
+}
+
+void unit_forget_cgroup_attributes(Unit *u) {
+        assert(u);
+
+        u->cgroup_attributes = hashmap_free_free_free(u->cgroup_attributes);
+        u->cgroup_attributes_mask = 0;
+}
+
 static void cgroup_apply_unified_cpu_config(Unit *u, uint64_t weight, uint64_t quota) {
         char buf[MAX(DECIMAL_STR_MAX(uint64_t) + 1, (DECIMAL_STR_MAX(usec_t) + 1) * 2)];
         int r;
 
         xsprintf(buf, "%" PRIu64 "\n", weight);
-        r = cg_set_attribute("cpu", u->cgroup_path, "cpu.weight", buf);
+        r = unit_set_cgroup_attribute(u, "cpu", "cpu.weight", buf);
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                               "Failed to set cpu.weight: %m");
@@ -468,7 +513,7 @@ static void cgroup_apply_unified_cpu_config(Unit *u, uint64_t weight, uint64_t q
         else
                 xsprintf(buf, "max " USEC_FMT "\n", CGROUP_CPU_QUOTA_PERIOD_USEC);
 
-        r = cg_set_attribute("cpu", u->cgroup_path, "cpu.max", buf);
+        r = unit_set_cgroup_attribute(u, "cpu", "cpu.max", buf);
 
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
@@ -480,22 +525,22 @@ static void cgroup_apply_legacy_cpu_config(Unit *u, uint64_t shares, uint64_t qu
         int r;
 
         xsprintf(buf, "%" PRIu64 "\n", shares);
-        r = cg_set_attribute("cpu", u->cgroup_path, "cpu.shares", buf);
+        r = unit_set_cgroup_attribute(u, "cpu", "cpu.shares", buf);
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                               "Failed to set cpu.shares: %m");
 
         xsprintf(buf, USEC_FMT "\n", CGROUP_CPU_QUOTA_PERIOD_USEC);
-        r = cg_set_attribute("cpu", u->cgroup_path, "cpu.cfs_period_us", buf);
+        r = unit_set_cgroup_attribute(u, "cpu", "cpu.cfs_period_us", buf);
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                               "Failed to set cpu.cfs_period_us: %m");
 
         if (quota != USEC_INFINITY) {
                 xsprintf(buf, USEC_FMT "\n", quota * CGROUP_CPU_QUOTA_PERIOD_USEC / USEC_PER_SEC);
-                r = cg_set_attribute("cpu", u->cgroup_path, "cpu.cfs_quota_us", buf);
+                r = unit_set_cgroup_attribute(u, "cpu", "cpu.cfs_quota_us", buf);
         } else
-                r = cg_set_attribute("cpu", u->cgroup_path, "cpu.cfs_quota_us", "-1");
+                r = unit_set_cgroup_attribute(u, "cpu", "cpu.cfs_quota_us", "-1");
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                               "Failed to set cpu.cfs_quota_us: %m");
@@ -660,7 +705,7 @@ static void cgroup_apply_unified_memory_limit(Unit *u, const char *file, uint64_
         if (v != CGROUP_LIMIT_MAX)
                 xsprintf(buf, "%" PRIu64 "\n", v);
 
-        r = cg_set_attribute("memory", u->cgroup_path, file, buf);
+        r = unit_set_cgroup_attribute(u, "memory", file, buf);
         if (r < 0)
                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                               "Failed to set %s: %m", file);
@@ -704,6 +749,13 @@ static void cgroup_context_apply(
         if (apply_mask == 0 && !apply_bpf)
                 return;
 
+        /* When controllers are turned off and on again the kernel resets their attributes, hence don't
+         * trust what we remember to have written if the set of controllers changed in between. */
+        if (u->cgroup_attributes_mask != apply_mask) {
+                unit_forget_cgroup_attributes(u);
+                u->cgroup_attributes_mask = apply_mask;
+        }
+
         /* Some cgroup attributes are not supported on the root cgroup,
          * hence silently ignore */
         is_root = isempty(path) || path_equal(path, "/");
@@ -777,7 +829,7 @@ static void cgroup_context_apply(
                                 weight = CGROUP_WEIGHT_DEFAULT;
 
                         xsprintf(buf, "default %" PRIu64 "\n", weight);
-                        r = cg_set_attribute("io", path, "io.weight", buf);
+                        r = unit_set_cgroup_attribute(u, "io", "io.weight", buf);
                         if (r < 0)
                                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                                               "Failed to set io.weight: %m");
@@ -854,7 +906,7 @@ static void cgroup_context_apply(
                                 weight = CGROUP_BLKIO_WEIGHT_DEFAULT;
 
                         xsprintf(buf, "%" PRIu64 "\n", weight);
-                        r = cg_set_attribute("blkio", path, "blkio.weight", buf);
+                        r = unit_set_cgroup_attribute(u, "blkio", "blkio.weight", buf);
                         if (r < 0)
                                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                                               "Failed to set blkio.weight: %m");
@@ -933,7 +985,7 @@ static void cgroup_context_apply(
                         else
                                 xsprintf(buf, "%" PRIu64 "\n", val);
 
-                        r = cg_set_attribute("memory", path, "memory.limit_in_bytes", buf);
+                        r = unit_set_cgroup_attribute(u, "memory", "memory.limit_in_bytes", buf);
                         if (r < 0)
                                 log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
                                               "Failed to set memory.limit_in_bytes: %m");
@@ -1010,9 +1062,9 @@ static void cgroup_context_apply(
                         char buf[DECIMAL_STR_MAX(uint64_t) + 2];
 
                         sprintf(buf, "%" PRIu64 "\n", c->tasks_max);
-                        r = cg_set_attribute("pids", path, "pids.max", buf);
+                        r = unit_set_cgroup_attribute(u, "pids", "pids.max", buf);
                 } else
-                        r = cg_set_attribute("pids", path, "pids.max", "max");
+                        r = unit_set_cgroup_attribute(u, "pids", "pids.max", "max");
 
                 if (r < 0)
                         log_unit_full(u, IN_SET(r, -ENOENT, -EROFS, -EACCES) ? LOG_DEBUG : LOG_WARNING, r,
@@ -1635,6 +1687,8 @@ void unit_release_cgroup(Unit *u) {
 
         /* Forgets all cgroup details for this cgroup */
 
+        unit_forget_cgroup_attributes(u);
+
         if (u->cgroup_path) {
                 (void) hashmap_remove(u->manager->cgroup_unit, u->cgroup_path);
                 u->cgroup_path = mfree(u->cgroup_path);
@@ -1802,13 +1856,30 @@ static int on_cgroup_empty_event(sd_event_source *s, void *userdata) {
         assert(s);
         assert(m);
 
-        u = m->cgroup_empty_queue;
-        if (!u)
-                return 0;
+        /* Units are queued without checking whether their cgroup is empty, hence verify that now. Skipping the
+         * ones that turn out to be populated is cheap, so do that in one go, but dispatch only one unit that is
+         * actually empty per iteration, so that SIGCHLD may still come in between. */
+
+        for (;;) {
+                u = m->cgroup_empty_queue;
+                if (!u)
+                        return 0;
 
-        assert(u->in_cgroup_empty_queue);
-        u->in_cgroup_empty_queue = false;
-        LIST_REMOVE(cgroup_empty_queue, m->cgroup_empty_queue, u);
+                assert(u->in_cgroup_empty_queue);
+                u->in_cgroup_empty_queue = false;
+                LIST_REMOVE(cgroup_empty_queue, m->cgroup_empty_queue, u);
+
+                if (!u->cgroup_path)
+                        continue;
+
+                r = cg_is_empty_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path);
+                if (r < 0) {
+                        log_unit_debug_errno(u, r, "Failed to determine whether cgroup %s is empty: %m", u->cgroup_path);
+                        continue;
+                }
+                if (r > 0)
+                        break;
+        }
 
         if (m->cgroup_empty_queue) {
                 /* More stuff queued, let's make sure we remain enabled */
@@ -1841,25 +1912,18 @@ void unit_add_to_cgroup_empty_queue(Unit *u) {
          * 4. On the legacy hierarchy, in service units we start watching all processes of the cgroup for SIGCHLD as
          *    soon as we get one SIGCHLD, to deal with unreliable cgroup notifications.
          *
-         * Regardless which way we got the notification, we'll verify it here, and then add it to a separate
-         * queue. This queue will be dispatched at a lower priority than the SIGCHLD handler, so that we always use
-         * SIGCHLD if we can get it first, and only use the cgroup empty notifications if there's no SIGCHLD pending
-         * (which might happen if the cgroup doesn't contain processes that are our own child, which is typically the
-         * case for scope units). */
+         * Regardless which way we got the notification, we'll add it to a separate queue. This queue will be
+         * dispatched at a lower priority than the SIGCHLD handler, so that we always use SIGCHLD if we can get it
+         * first, and only use the cgroup empty notifications if there's no SIGCHLD pending (which might happen if
+         * the cgroup doesn't contain processes that are our own child, which is typically the case for scope
+         * units). Whether the cgroup is really empty is verified only when the queue is dispatched, so that any
+         * number of notifications for the same cgroup coming in until then cost us nothing. */
 
         if (u->in_cgroup_empty_queue)
                 return;
 
-        /* Let's verify that the cgroup is really empty */
         if (!u->cgroup_path)
                 return;
-        r = cg_is_empty_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path);
-        if (r < 0) {
-                log_unit_debug_errno(u, r, "Failed to determine whether cgroup %s is empty: %m", u->cgroup_path);
-                return;
-        }
-        if (r == 0)
-                return;
 
         LIST_PREPEND(cgroup_empty_queue, u->manager->cgroup_empty_queue, u);
         u->in_cgroup_empty_queue = true;
@@ -1893,8 +1957,20 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                 FOREACH_INOTIFY_EVENT(e, buffer, l) {
                         Unit *u;
 
+                        if (e->mask & IN_Q_OVERFLOW) {
+                                Iterator i;
+
+                                /* We lost events, hence any of the cgroups we watch might have become empty
+                                 * in the meantime. Queue all of them, the dispatching will sort it out. */
+                                log_debug("Control group inotify queue overflow, checking all cgroups.");
+
+                                HASHMAP_FOREACH(u, m->cgroup_inotify_wd_unit, i)
+                                        unit_add_to_cgroup_empty_queue(u);
+
+                                continue;
+                        }
+
                         if (e->wd < 0)
-                                /* Queue overflow has no watch descriptor */
                                 continue;
 
                         if (e->mask & IN_IGNORED)
@@ -169,6 +169,7 @@ int unit_set_cgroup_path(Unit *u, const char *path);
 
 int unit_realize_cgroup(Unit *u);
 void unit_release_cgroup(Unit *u);
+void unit_forget_cgroup_attributes(Unit *u);
 void unit_prune_cgroup(Unit *u);
 int unit_watch_cgroup(Unit *u);
 
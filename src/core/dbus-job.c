@@ -174,10 +174,20 @@ static int send_new_signal(sd_bus *bus, void *userdata) {
 static int send_changed_signal(sd_bus *bus, void *userdata) {
         _cleanup_free_ char *p = NULL;
         Job *j = userdata;
+        int r;
 
         assert(bus);
         assert(j);
 
+        /* See the unit's send_changed_signal() */
+        r = bus_check_congested(j->manager, bus);
+        if (r < 0)
+                return r;
+        if (r > 0) {
+                j->dbus_change_deferred = true;
+                return 0;
+        }
+
         p = job_dbus_path(j);
         if (!p)
                 return -ENOMEM;
@@ -195,6 +205,8 @@ void bus_job_send_change_signal(Job *j) {
                 j->in_dbus_queue = false;
         }
 
+        j->dbus_change_deferred = false;
+
         r = bus_foreach_bus(j->manager, j->bus_track, j->sent_dbus_new_signal ? send_changed_signal : send_new_signal, j);
         if (r < 0)
                 log_debug_errno(r, "Failed to send job change signal for %u: %m", j->id);
@@ -38,7 +38,9 @@
 #include "format-util.h"
 #include "fs-util.h"
 #include "install.h"
+#include "io-util.h"
 #include "log.h"
+#include "memfd-util.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "selinux-access.h"
@@ -991,6 +993,265 @@ static int method_start_transient_unit(sd_bus_message *message, void *userdata,
         return bus_unit_queue_job(message, u, JOB_START, mode, false, error);
 }
 
+static int transient_unit_check_name(Manager *m, Set *names, const char *name, sd_bus_error *error) {
+        UnitType t;
+        Unit *u;
+        int r;
+
+        assert(m);
+        assert(names);
+        assert(name);
+
+        t = unit_name_to_type(name);
+        if (t < 0)
+                return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Invalid unit name or type.");
+
+        if (!unit_vtable[t]->can_transient)
+                return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Unit type %s does not support transient units.", unit_type_to_string(t));
+
+        u = manager_get_unit(m, name);
+        if (u && !unit_is_pristine(u))
+                return sd_bus_error_setf(error, BUS_ERROR_UNIT_EXISTS, "Unit %s already exists.", name);
+
+        r = set_put(names, name);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Unit %s specified more than once.", name);
+
+        return 0;
+}
+
+static int transient_units_check_names(Manager *m, sd_bus_message *message, Set *names, sd_bus_error *error) {
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(names);
+
+        /* Goes through the array of units, without creating anything yet, and makes sure all names are valid, unique
+         * and not taken. The message is rewound to the beginning of the array afterwards. */
+
+        while ((r = sd_bus_message_enter_container(message, 'r', "sa(sv)a(sa(sv))")) > 0) {
+                const char *name;
+
+                r = sd_bus_message_read(message, "s", &name);
+                if (r < 0)
+                        return r;
+
+                r = transient_unit_check_name(m, names, name, error);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_skip(message, "a(sv)");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_enter_container(message, 'a', "(sa(sv))");
+                if (r < 0)
+                        return r;
+
+                while ((r = sd_bus_message_enter_container(message, 'r', "sa(sv)")) > 0) {
+
+                        r = sd_bus_message_read(message, "s", &name);
+                        if (r < 0)
+                                return r;
+
+                        r = transient_unit_check_name(m, names, name, error);
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_skip(message, "a(sv)");
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_exit_container(message);
+                        if (r < 0)
+                                return r;
+                }
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(message);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(message);
+                if (r < 0)
+                        return r;
+        }
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_rewind(message, false);
+}
+
+static void transient_units_rollback(Manager *m, Set *names) {
+        const char *name;
+        Iterator i;
+
+        assert(m);
+
+        /* Cancels the jobs enqueued for the units of a failed StartTransientUnits() call and drops the units again.
+         * Everything listed was checked not to exist or to be pristine before, hence any transient unit by that
+         * name is one we created. Nothing has been dispatched yet, so nothing has run either. */
+
+        SET_FOREACH(name, names, i) {
+                Unit *u;
+
+                u = manager_get_unit(m, name);
+                if (u && u->transient && u->job)
+                        job_finish_and_invalidate(u->job, JOB_CANCELED, true, false);
+        }
+
+        SET_FOREACH(name, names, i) {
+                Unit *u;
+
+                u = manager_get_unit(m, name);
+                if (u && u->transient)
+                        unit_free(u);
+        }
+}
+
+static int start_transient_units(Manager *m, sd_bus_message *message, JobMode mode, char ***ret, sd_bus_error *error) {
+        _cleanup_strv_free_ char **paths = NULL;
+        _cleanup_free_ Unit **units = NULL;
+        size_t n_units = 0, n_allocated = 0, i;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(ret);
+
+        while ((r = sd_bus_message_enter_container(message, 'r', "sa(sv)a(sa(sv))")) > 0) {
+                const char *name;
+                Unit *u;
+
+                r = sd_bus_message_read(message, "s", &name);
+                if (r < 0)
+                        return r;
+
+                r = transient_unit_from_message(m, message, name, &u, error);
+                if (r < 0)
+                        return r;
+
+                r = transient_aux_units_from_message(m, message, error);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(message);
+                if (r < 0)
+                        return r;
+
+                if (!GREEDY_REALLOC(units, n_allocated, n_units + 1))
+                        return -ENOMEM;
+
+                units[n_units++] = u;
+        }
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n_units; i++) {
+                Job *j;
+
+                r = bus_unit_queue_job_no_reply(message, units[i], JOB_START, mode, false, &j, error);
+                if (r < 0)
+                        return r;
+
+                /* Later jobs might replace this one, hence remember the path right away */
+                r = strv_consume(&paths, job_dbus_path(j));
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = paths;
+        paths = NULL;
+
+        return 0;
+}
+
+static int method_start_transient_units(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_set_free_ Set *names = NULL;
+        _cleanup_strv_free_ char **paths = NULL;
+        Manager *m = userdata;
+        const char *smode;
+        char **path;
+        JobMode mode;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Like StartTransientUnit(), but creates and starts any number of units in one go, so that clients
+         * spawning lots of short-lived units don't need a full bus round trip and authorization check for each. All
+         * units are created first, and only then the start jobs are enqueued for them, in the order specified.
+         * This is all or nothing: if any unit can't be created or started, the units created and the jobs
+         * enqueued so far are dropped again, and the call fails. */
+
+        r = mac_selinux_access_check(message, "start", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "s", &smode);
+        if (r < 0)
+                return r;
+
+        mode = job_mode_from_string(smode);
+        if (mode < 0)
+                return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Job mode %s is invalid.", smode);
+
+        r = bus_verify_manage_units_async(m, message, error);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return 1; /* No authorization for now, but the async polkit stuff will call us again when it has it */
+
+        names = set_new(&string_hash_ops);
+        if (!names)
+                return -ENOMEM;
+
+        r = sd_bus_message_enter_container(message, 'a', "(sa(sv)a(sa(sv)))");
+        if (r < 0)
+                return r;
+
+        r = transient_units_check_names(m, message, names, error);
+        if (r < 0)
+                return r;
+
+        r = start_transient_units(m, message, mode, &paths, error);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_exit_container(message);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_open_container(reply, 'a', "o");
+        if (r < 0)
+                goto fail;
+
+        STRV_FOREACH(path, paths) {
+                r = sd_bus_message_append(reply, "o", *path);
+                if (r < 0)
+                        goto fail;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                goto fail;
+
+        return sd_bus_send(NULL, reply, NULL);
+
+fail:
+        transient_units_rollback(m, names);
+        return r;
+}
+
 static int method_get_job(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_free_ char *path = NULL;
         Manager *m = userdata;
@@ -1086,7 +1347,14 @@ static int method_reset_failed(sd_bus_message *message, void *userdata, sd_bus_e
         return sd_bus_reply_method_return(message, NULL);
 }
 
-static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error, char **states, char **patterns) {
+static int list_units_filtered(
+                sd_bus_message *message,
+                void *userdata,
+                sd_bus_error *error,
+                char **states,
+                char **patterns,
+                const uint64_t *since) {
+
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
         const char *k;
@@ -1125,6 +1393,9 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
                     !strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
                         continue;
 
+                if (since && u->change_generation <= *since)
+                        continue;
+
                 r = reply_unit_info(reply, u);
                 if (r < 0)
                         return r;
@@ -1134,11 +1405,18 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
         if (r < 0)
                 return r;
 
+        /* Tell the caller where to continue from the next time */
+        if (since) {
+                r = sd_bus_message_append(reply, "t", m->unit_change_generation);
+                if (r < 0)
+                        return r;
+        }
+
         return sd_bus_send(NULL, reply, NULL);
 }
 
 static int method_list_units(sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        return list_units_filtered(message, userdata, error, NULL, NULL);
+        return list_units_filtered(message, userdata, error, NULL, NULL, NULL);
 }
 
 static int method_list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1149,7 +1427,7 @@ static int method_list_units_filtered(sd_bus_message *message, void *userdata, s
         if (r < 0)
                 return r;
 
-        return list_units_filtered(message, userdata, error, states, NULL);
+        return list_units_filtered(message, userdata, error, states, NULL, NULL);
 }
 
 static int method_list_units_by_patterns(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1165,7 +1443,287 @@ static int method_list_units_by_patterns(sd_bus_message *message, void *userdata
         if (r < 0)
                 return r;
 
-        return list_units_filtered(message, userdata, error, states, patterns);
+        return list_units_filtered(message, userdata, error, states, patterns, NULL);
+}
+
+static int method_list_units_changed_since(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_strv_free_ char **states = NULL;
+        _cleanup_strv_free_ char **patterns = NULL;
+        uint64_t since;
+        int r;
+
+        r = sd_bus_message_read(message, "t", &since);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &states);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        return list_units_filtered(message, userdata, error, states, patterns, &since);
+}
+
+static int reply_unit_accounting(sd_bus_message *reply, Unit *u) {
+        uint64_t memory = (uint64_t) -1, tasks = (uint64_t) -1;
+        uint64_t ip[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
+        CGroupIPAccountingMetric metric;
+        nsec_t cpu = (nsec_t) -1;
+        int r;
+
+        assert(reply);
+        assert(u);
+
+        r = unit_get_cpu_usage(u, &cpu);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get cpuacct.usage attribute: %m");
+
+        r = unit_get_memory_current(u, &memory);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get memory.usage_in_bytes attribute: %m");
+
+        r = unit_get_tasks_current(u, &tasks);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get pids.current attribute: %m");
+
+        for (metric = 0; metric < _CGROUP_IP_ACCOUNTING_METRIC_MAX; metric++) {
+                ip[metric] = (uint64_t) -1;
+                (void) unit_get_ip_accounting(u, metric, ip + metric);
+        }
+
+        return sd_bus_message_append(
+                        reply, "(sttttttt)",
+                        u->id,
+                        cpu,
+                        memory,
+                        tasks,
+                        ip[CGROUP_IP_INGRESS_BYTES],
+                        ip[CGROUP_IP_INGRESS_PACKETS],
+                        ip[CGROUP_IP_EGRESS_BYTES],
+                        ip[CGROUP_IP_EGRESS_PACKETS]);
+}
+
+static int method_list_units_accounting(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **patterns = NULL;
+        Manager *m = userdata;
+        const char *k;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        /* Returns the resource counters of all units with a cgroup in one go, so that monitoring doesn't have to
+         * query CPUUsageNSec, MemoryCurrent, TasksCurrent and the IP counters one unit at a time. Counters that
+         * aren't available are returned as (uint64_t) -1, the same way the unit properties do it. */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sttttttt)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                if (k != u->id)
+                        continue;
+
+                if (!UNIT_HAS_CGROUP_CONTEXT(u))
+                        continue;
+
+                if (!strv_isempty(patterns) &&
+                    !strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
+                        continue;
+
+                r = reply_unit_accounting(reply, u);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static bool list_unit_dependencies_expand(Unit *u, unsigned depth, uint32_t max_depth, bool all) {
+        assert(u);
+
+        if (max_depth > 0 && depth >= max_depth)
+                return false;
+
+        return all || depth == 0 || u->type == UNIT_TARGET;
+}
+
+static int method_list_unit_dependencies(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **types = NULL;
+        _cleanup_set_free_ Set *seen = NULL;
+        _cleanup_free_ unsigned *depths = NULL;
+        _cleanup_free_ Unit **queue = NULL;
+        size_t n_queue = 0, n_allocated = 0, n_depths_allocated = 0, k;
+        bool mask[_UNIT_DEPENDENCY_MAX] = {};
+        Manager *m = userdata;
+        const char *name;
+        uint32_t max_depth;
+        int all;
+        char **t;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        /* Returns the subgraph of the specified dependency types reachable from the specified unit, up to the
+         * specified depth (0 means unlimited), as list of nodes with their active state, and as list of typed
+         * edges. This way clients such as "systemctl list-dependencies" can render the tree locally instead of
+         * querying the dependencies of each unit separately. Unless "all" is set, only the dependencies of the
+         * specified unit itself and of targets are followed, like "systemctl list-dependencies" does without
+         * --all, so that the reply doesn't carry the whole graph below each service. */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "s", &name);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &types);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "ub", &max_depth, &all);
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(t, types) {
+                UnitDependency d;
+
+                d = unit_dependency_from_string(*t);
+                if (d < 0)
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Unknown dependency type: %s", *t);
+
+                mask[d] = true;
+        }
+
+        r = manager_load_unit(m, name, NULL, error, &u);
+        if (r < 0)
+                return r;
+
+        seen = set_new(NULL);
+        if (!seen)
+                return -ENOMEM;
+
+        if (!GREEDY_REALLOC(queue, n_allocated, 1) ||
+            !GREEDY_REALLOC(depths, n_depths_allocated, 1))
+                return -ENOMEM;
+
+        r = set_put(seen, u);
+        if (r < 0)
+                return r;
+
+        queue[n_queue] = u;
+        depths[n_queue++] = 0;
+
+        /* Breadth-first, so that each unit is reached with the minimal depth */
+        for (k = 0; k < n_queue; k++) {
+                UnitDependency d;
+
+                if (!list_unit_dependencies_expand(queue[k], depths[k], max_depth, all))
+                        continue;
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        Iterator i;
+                        Unit *other;
+
+                        if (!mask[d])
+                                continue;
+
+                        SET_FOREACH(other, queue[k]->dependencies[d], i) {
+                                r = set_put(seen, other);
+                                if (r < 0)
+                                        return r;
+                                if (r == 0)
+                                        continue;
+
+                                if (!GREEDY_REALLOC(queue, n_allocated, n_queue + 1) ||
+                                    !GREEDY_REALLOC(depths, n_depths_allocated, n_queue + 1))
+                                        return -ENOMEM;
+
+                                queue[n_queue] = other;
+                                depths[n_queue++] = depths[k] + 1;
+                        }
+                }
+        }
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ss)");
+        if (r < 0)
+                return r;
+
+        for (k = 0; k < n_queue; k++) {
+                r = sd_bus_message_append(reply, "(ss)", queue[k]->id, unit_active_state_to_string(unit_active_state(queue[k])));
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sss)");
+        if (r < 0)
+                return r;
+
+        for (k = 0; k < n_queue; k++) {
+                UnitDependency d;
+
+                if (!list_unit_dependencies_expand(queue[k], depths[k], max_depth, all))
+                        continue;
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        Iterator i;
+                        Unit *other;
+
+                        if (!mask[d])
+                                continue;
+
+                        SET_FOREACH(other, queue[k]->dependencies[d], i) {
+                                r = sd_bus_message_append(reply, "(sss)", queue[k]->id, unit_dependency_to_string(d), other->id);
+                                if (r < 0)
+                                        return r;
+                        }
+                }
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
 }
 
 static int method_list_jobs(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1280,7 +1838,7 @@ static int method_unsubscribe(sd_bus_message *message, void *userdata, sd_bus_er
         return sd_bus_reply_method_return(message, NULL);
 }
 
-static int method_dump(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+static int dump_impl(sd_bus_message *message, void *userdata, sd_bus_error *error, char **ret, size_t *ret_size) {
         _cleanup_free_ char *dump = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         Manager *m = userdata;
@@ -1289,6 +1847,8 @@ static int method_dump(sd_bus_message *message, void *userdata, sd_bus_error *er
 
         assert(message);
         assert(m);
+        assert(ret);
+        assert(ret_size);
 
         /* Anyone can call this method */
 
@@ -1302,14 +1862,65 @@ static int method_dump(sd_bus_message *message, void *userdata, sd_bus_error *er
 
         manager_dump_units(m, f, NULL);
         manager_dump_jobs(m, f, NULL);
+        manager_dump_memory_usage(m, f, NULL);
+        manager_dump_gc(m, f, NULL);
 
         r = fflush_and_check(f);
         if (r < 0)
                 return r;
 
+        f = safe_fclose(f);
+
+        *ret = dump;
+        *ret_size = size;
+        dump = NULL;
+
+        return 0;
+}
+
+static int method_dump(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_free_ char *dump = NULL;
+        size_t size;
+        int r;
+
+        r = dump_impl(message, userdata, error, &dump, &size);
+        if (r < 0)
+                return r;
+
         return sd_bus_reply_method_return(message, "s", dump);
 }
 
+static int method_dump_by_file_descriptor(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_free_ char *dump = NULL;
+        _cleanup_close_ int fd = -1;
+        size_t size;
+        int r;
+
+        /* The dump of a big system easily amounts to many megabytes. Instead of pushing it through the bus
+         * socket, hand out a sealed memfd with it, which the client may simply map. */
+
+        if (sd_bus_can_send(sd_bus_message_get_bus(message), SD_BUS_TYPE_UNIX_FD) <= 0)
+                return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Connection does not support file descriptor passing.");
+
+        r = dump_impl(message, userdata, error, &dump, &size);
+        if (r < 0)
+                return r;
+
+        fd = memfd_new("systemd-dump");
+        if (fd < 0)
+                return fd;
+
+        r = loop_write(fd, dump, size, false);
+        if (r < 0)
+                return r;
+
+        r = memfd_set_sealed(fd);
+        if (r < 0)
+                return r;
+
+        return sd_bus_reply_method_return(message, "h", fd);
+}
+
 static int method_refuse_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED, "Support for snapshots has been removed.");
 }
@@ -2444,6 +3055,7 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_PROPERTY("DefaultStartLimitIntervalSec", "t", bus_property_get_usec, offsetof(Manager, default_start_limit_interval), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultStartLimitInterval", "t", bus_property_get_usec, offsetof(Manager, default_start_limit_interval), SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_HIDDEN), /* obsolete alias name */
         SD_BUS_PROPERTY("DefaultStartLimitBurst", "u", bus_property_get_unsigned, offsetof(Manager, default_start_limit_burst), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("JobConcurrencyMax", "u", bus_property_get_unsigned, offsetof(Manager, job_concurrency_max), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultCPUAccounting", "b", bus_property_get_bool, offsetof(Manager, default_cpu_accounting), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultBlockIOAccounting", "b", bus_property_get_bool, offsetof(Manager, default_blockio_accounting), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultMemoryAccounting", "b", bus_property_get_bool, offsetof(Manager, default_memory_accounting), SD_BUS_VTABLE_PROPERTY_CONST),
@@ -2501,6 +3113,7 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("RefUnit", "s", NULL, method_ref_unit, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("UnrefUnit", "s", NULL, method_unref_unit, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("StartTransientUnit", "ssa(sv)a(sa(sv))", "o", method_start_transient_unit, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("StartTransientUnits", "sa(sa(sv)a(sa(sv)))", "ao", method_start_transient_units, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("GetUnitProcesses", "s", "a(sus)", method_get_unit_processes, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("GetJob", "u", "o", method_get_job, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("GetJobAfter", "u", "a(usssoo)", method_get_job_waiting, SD_BUS_VTABLE_UNPRIVILEGED),
@@ -2512,10 +3125,14 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("ListUnitsFiltered", "as", "a(ssssssouso)", method_list_units_filtered, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByPatterns", "asas", "a(ssssssouso)", method_list_units_by_patterns, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByNames", "as", "a(ssssssouso)", method_list_units_by_names, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitsChangedSince", "tasas", "a(ssssssouso)t", method_list_units_changed_since, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitsAccounting", "as", "a(sttttttt)", method_list_units_accounting, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitDependencies", "sasub", "a(ss)a(sss)", method_list_unit_dependencies, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListJobs", NULL, "a(usssoo)", method_list_jobs, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Subscribe", NULL, NULL, method_subscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Unsubscribe", NULL, NULL, method_unsubscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Dump", NULL, "s", method_dump, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("DumpByFileDescriptor", NULL, "h", method_dump_by_file_descriptor, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("CreateSnapshot", "sb", "o", method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("RemoveSnapshot", "s", NULL, method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Reload", NULL, NULL, method_reload, SD_BUS_VTABLE_UNPRIVILEGED),
@@ -1137,6 +1137,16 @@ static int send_changed_signal(sd_bus *bus, void *userdata) {
         assert(bus);
         assert(u);
 
+        /* The peer is far behind already. Rather than queuing even more, skip it for now, the signal is
+         * sent again once it caught up, see manager_dispatch_dbus_queue(). */
+        r = bus_check_congested(u->manager, bus);
+        if (r < 0)
+                return r;
+        if (r > 0) {
+                u->dbus_change_deferred = true;
+                return 0;
+        }
+
         p = unit_dbus_path(u);
         if (!p)
                 return -ENOMEM;
@@ -1170,6 +1180,8 @@ void bus_unit_send_change_signal(Unit *u) {
         if (!u->id)
                 return;
 
+        u->dbus_change_deferred = false;
+
         r = bus_foreach_bus(u->manager, u->bus_track, u->sent_dbus_new_signal ? send_changed_signal : send_new_signal, u);
         if (r < 0)
                 log_unit_debug_errno(u, r, "Failed to send unit change signal for %s: %m", u->id);
@@ -1221,15 +1233,15 @@ void bus_unit_send_removed_signal(Unit *u) {
                 log_unit_debug_errno(u, r, "Failed to send unit remove signal for %s: %m", u->id);
 }
 
-int bus_unit_queue_job(
+int bus_unit_queue_job_no_reply(
                 sd_bus_message *message,
                 Unit *u,
                 JobType type,
                 JobMode mode,
                 bool reload_if_possible,
+                Job **ret,
                 sd_bus_error *error) {
 
-        _cleanup_free_ char *path = NULL;
         Job *j;
         int r;
 
@@ -1271,6 +1283,28 @@ int bus_unit_queue_job(
         if (r < 0)
                 return r;
 
+        if (ret)
+                *ret = j;
+
+        return 0;
+}
+
+int bus_unit_queue_job(
+                sd_bus_message *message,
+                Unit *u,
+                JobType type,
+                JobMode mode,
+                bool reload_if_possible,
+                sd_bus_error *error) {
+
+        _cleanup_free_ char *path = NULL;
+        Job *j;
+        int r;
+
+        r = bus_unit_queue_job_no_reply(message, u, type, mode, reload_if_possible, &j, error);
+        if (r < 0)
+                return r;
+
         path = job_dbus_path(j);
         if (!path)
                 return -ENOMEM;
@@ -48,6 +48,9 @@
 
 #define CONNECTIONS_MAX 4096
 
+/* How many messages may be waiting in the write queue of a bus before we stop sending change signals to it */
+#define BUS_CONGESTED_WQUEUE 1024U
+
 static void destroy_bus(Manager *m, sd_bus **bus);
 
 int bus_send_queued_message(Manager *m) {
@@ -1069,6 +1072,8 @@ static void destroy_bus(Manager *m, sd_bus **bus) {
                 if (j->bus_track && sd_bus_track_get_bus(j->bus_track) == *bus)
                         j->bus_track = sd_bus_track_unref(j->bus_track);
 
+        set_remove(m->congested_buses, *bus);
+
         /* Get rid of queued message on this bus */
         if (m->queued_message && sd_bus_message_get_bus(m->queued_message) == *bus)
                 m->queued_message = sd_bus_message_unref(m->queued_message);
@@ -1096,6 +1101,7 @@ void bus_done(Manager *m) {
                 destroy_bus(m, &b);
 
         m->private_buses = set_free(m->private_buses);
+        m->congested_buses = set_free(m->congested_buses);
 
         m->subscribed = sd_bus_track_unref(m->subscribed);
         m->deserialized_subscribed = strv_free(m->deserialized_subscribed);
@@ -1148,6 +1154,82 @@ int bus_fdset_add_all(Manager *m, FDSet *fds) {
         return 0;
 }
 
+bool bus_is_congested(sd_bus *bus) {
+        assert(bus);
+
+        /* Returns true if the peer hasn't read so many of the messages we queued on the bus yet that we
+         * shouldn't enqueue change signals on top */
+
+        return bus->wqueue_size > BUS_CONGESTED_WQUEUE;
+}
+
+bool bus_all_congested(Manager *m) {
+        bool any = false;
+        Iterator i;
+        sd_bus *b;
+
+        assert(m);
+
+        SET_FOREACH(b, m->private_buses, i) {
+                if (!bus_is_congested(b))
+                        return false;
+
+                any = true;
+        }
+
+        if (m->api_bus) {
+                if (!bus_is_congested(m->api_bus))
+                        return false;
+
+                any = true;
+        }
+
+        return any;
+}
+
+int bus_check_congested(Manager *m, sd_bus *bus) {
+        int r;
+
+        assert(m);
+        assert(bus);
+
+        /* Like bus_is_congested(), but remembers the congested bus, so that the change signals skipped for it
+         * can be sent once it caught up, see bus_forget_drained() */
+
+        if (!bus_is_congested(bus))
+                return 0;
+
+        r = set_ensure_allocated(&m->congested_buses, NULL);
+        if (r < 0)
+                return r;
+
+        r = set_put(m->congested_buses, bus);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+bool bus_forget_drained(Manager *m) {
+        bool drained = false;
+        Iterator i;
+        sd_bus *b;
+
+        assert(m);
+
+        /* Returns true if any of the buses change signals were skipped for caught up since */
+
+        SET_FOREACH(b, m->congested_buses, i) {
+                if (bus_is_congested(b))
+                        continue;
+
+                set_remove(m->congested_buses, b);
+                drained = true;
+        }
+
+        return drained;
+}
+
 int bus_foreach_bus(
                 Manager *m,
                 sd_bus_track *subscribed2,
@@ -41,3 +41,8 @@ int bus_verify_reload_daemon_async(Manager *m, sd_bus_message *call, sd_bus_erro
 int bus_verify_set_environment_async(Manager *m, sd_bus_message *call, sd_bus_error *error);
 
 int bus_forward_agent_released(Manager *m, const char *path);
+
+bool bus_is_congested(sd_bus *bus);
+bool bus_all_congested(Manager *m);
+int bus_check_congested(Manager *m, sd_bus *bus);
+bool bus_forget_drained(Manager *m);
@@ -403,6 +403,18 @@ fail:
         return r;
 }
 
+static bool device_unit_exists(Manager *m, const char *path) {
+        _cleanup_free_ char *e = NULL;
+
+        assert(m);
+        assert(path);
+
+        if (unit_name_from_path(path, ".device", &e) < 0)
+                return false;
+
+        return !!manager_get_unit(m, e);
+}
+
 static int device_process_new(Manager *m, struct udev_device *dev) {
         const char *sysfs, *dn, *alias;
         struct udev_list_entry *item = NULL, *first = NULL;
@@ -437,6 +449,12 @@ static int device_process_new(Manager *m, struct udev_device *dev) {
                     path_startswith(p, "/dev/char/"))
                         continue;
 
+                /* Units for symlinks are only created when something references them, see
+                 * device_load_from_udev(). Otherwise hosts with many devices carry several units for each of
+                 * them. Units that already exist are kept up-to-date however. */
+                if (!device_unit_exists(m, p))
+                        continue;
+
                 /* Verify that the symlink in the FS actually belongs
                  * to this device. This is useful to deal with
                  * conflicting devices, e.g. when two disks want the
@@ -564,6 +582,75 @@ static bool device_is_ready(struct udev_device *dev) {
         return parse_boolean(ready) != 0;
 }
 
+static int device_load_from_udev(Unit *u) {
+        _cleanup_udev_device_unref_ struct udev_device *dev = NULL;
+        _cleanup_free_ char *path = NULL;
+        Device *d = DEVICE(u);
+        struct stat st;
+        int r;
+
+        assert(d);
+
+        /* Device units for symlinks in /dev are not created when the device shows up, but only once they are
+         * referenced. Hence, if the device behind such a unit is already around, pick it up now. */
+
+        if (!u->manager->udev_monitor) /* Device enumeration is not enabled */
+                return 0;
+
+        if (d->sysfs)
+                return 0;
+
+        r = unit_name_to_path(u->id, &path);
+        if (r < 0)
+                return r;
+
+        if (!path_startswith(path, "/dev/"))
+                return 0;
+
+        if (stat(path, &st) < 0)
+                return 0;
+
+        if (!S_ISBLK(st.st_mode) && !S_ISCHR(st.st_mode))
+                return 0;
+
+        dev = udev_device_new_from_devnum(u->manager->udev, S_ISBLK(st.st_mode) ? 'b' : 'c', st.st_rdev);
+        if (!dev)
+                return 0;
+
+        if (udev_device_get_is_initialized(dev) <= 0 ||
+            udev_device_has_tag(dev, "systemd") <= 0 ||
+            !device_is_ready(dev))
+                return 0;
+
+        r = device_setup_unit(u->manager, dev, path, false);
+        if (r < 0)
+                return r;
+
+        /* While starting up or reloading, the state is applied when the unit is coldplugged */
+        device_update_found_one(d, true, DEVICE_FOUND_UDEV, !MANAGER_IS_RELOADING(u->manager));
+
+        return 0;
+}
+
+static int device_load(Unit *u) {
+        int r;
+
+        assert(u);
+
+        r = unit_load_fragment_and_dropin_optional(u);
+        if (r < 0)
+                return r;
+
+        if (u->load_state == UNIT_MERGED)
+                return 0;
+
+        r = device_load_from_udev(u);
+        if (r < 0)
+                log_unit_debug_errno(u, r, "Failed to look up device, ignoring: %m");
+
+        return 0;
+}
+
 static Unit *device_following(Unit *u) {
         Device *d = DEVICE(u);
         Device *other, *first = NULL;
@@ -885,7 +972,7 @@ const UnitVTable device_vtable = {
 
         .init = device_init,
         .done = device_done,
-        .load = unit_load_fragment_and_dropin_optional,
+        .load = device_load,
 
         .coldplug = device_coldplug,
 
@@ -21,6 +21,8 @@
 #include <pwd.h>
 #include <sys/file.h>
 
+#include "bitmap.h"
+#include "dirent-util.h"
 #include "dynamic-user.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -35,6 +37,9 @@
 /* Takes a value generated randomly or by hashing and turns it into a UID in the right range */
 #define UID_CLAMP_INTO_RANGE(rnd) (((uid_t) (rnd) % (DYNAMIC_UID_MAX - DYNAMIC_UID_MIN + 1)) + DYNAMIC_UID_MIN)
 
+/* How many random UIDs to try before looking for one without a lock file more systematically */
+#define RANDOM_TRIES_MAX 16U
+
 static DynamicUser* dynamic_user_free(DynamicUser *d) {
         if (!d)
                 return NULL;
@@ -182,6 +187,46 @@ static int make_uid_symlinks(uid_t uid, const char *name, bool b) {
         return r;
 }
 
+static int dynamic_uid_lock_bitmap(Bitmap **ret) {
+        _cleanup_bitmap_free_ Bitmap *b = NULL;
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        int r;
+
+        assert(ret);
+
+        /* Returns a bitmap of all dynamic UIDs that currently have a lock file, indexed relative to
+         * DYNAMIC_UID_MIN. Allocated or not, these are the ones not worth trying when looking for a free UID. */
+
+        d = opendir("/run/systemd/dynamic-uid");
+        if (!d)
+                return -errno;
+
+        b = bitmap_new();
+        if (!b)
+                return -ENOMEM;
+
+        FOREACH_DIRENT(de, d, return -errno) {
+                uid_t uid;
+
+                /* Skips the "direct:" lookup symlinks too */
+                if (parse_uid(de->d_name, &uid) < 0)
+                        continue;
+
+                if (!uid_is_dynamic(uid))
+                        continue;
+
+                r = bitmap_set(b, uid - DYNAMIC_UID_MIN);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = b;
+        b = NULL;
+
+        return 0;
+}
+
 static int pick_uid(char **suggested_paths, const char *name, uid_t *ret_uid) {
 
         /* Find a suitable free UID. We use the following strategy to find a suitable UID:
@@ -195,14 +240,19 @@ static int pick_uid(char **suggested_paths, const char *name, uid_t *ret_uid) {
          *    pretty good, as the use ris by default derived from the unit name, and hence the same service and same
          *    user should usually get the same UID as long as our hashing doesn't clash.
          *
-         * 3. Finally, if that didn't work, we randomly pick UIDs, until we find one that is empty.
+         * 3. If that didn't work, we randomly pick UIDs, until we find one that is empty.
+         *
+         * 4. If the UID range is so crowded that a couple of random picks didn't find anything, we read the lock
+         *    directory once, and walk the UIDs without a lock file from a random starting point, rather than
+         *    continuing to pick UIDs that are most likely taken.
          *
          * Since the dynamic UID space is relatively small we'll stop trying after 100 iterations, giving up. */
 
         enum {
                 PHASE_SUGGESTED,  /* the first phase, reusing directory ownership UIDs */
                 PHASE_HASHED,     /* the second phase, deriving a UID from the username by hashing */
-                PHASE_RANDOM,     /* the last phase, randomly picking UIDs */
+                PHASE_RANDOM,     /* the third phase, randomly picking UIDs */
+                PHASE_SCAN,       /* the last phase, walking the UIDs without lock file */
         } phase = PHASE_SUGGESTED;
 
         static const uint8_t hash_key[] = {
@@ -210,7 +260,8 @@ static int pick_uid(char **suggested_paths, const char *name, uid_t *ret_uid) {
                 0x8a, 0xbb, 0x39, 0x57, 0x8d, 0xd9, 0xec, 0x59
         };
 
-        unsigned n_tries = 100, current_suggested = 0;
+        unsigned n_tries = 100, current_suggested = 0, n_random = 0, scan_index = 0, scan_left = 0;
+        _cleanup_bitmap_free_ Bitmap *locked = NULL;
         int r;
 
         (void) mkdir("/run/systemd/dynamic-uid", 0755);
@@ -253,11 +304,39 @@ static int pick_uid(char **suggested_paths, const char *name, uid_t *ret_uid) {
 
                 case PHASE_RANDOM:
 
+                        if (n_random++ >= RANDOM_TRIES_MAX) {
+                                r = dynamic_uid_lock_bitmap(&locked);
+                                if (r < 0)
+                                        return r;
+
+                                scan_left = DYNAMIC_UID_MAX - DYNAMIC_UID_MIN + 1;
+                                random_bytes(&scan_index, sizeof(scan_index));
+                                scan_index %= scan_left;
+
+                                phase = PHASE_SCAN;
+                                continue;
+                        }
+
                         /* Pick another random UID, and see if that works for us. */
                         random_bytes(&candidate, sizeof(candidate));
                         candidate = UID_CLAMP_INTO_RANGE(candidate);
                         break;
 
+                case PHASE_SCAN:
+
+                        /* Find the next UID that had no lock file when we looked */
+                        for (;;) {
+                                if (scan_left == 0)
+                                        return -EBUSY;
+
+                                candidate = UID_CLAMP_INTO_RANGE(scan_index++);
+                                scan_left--;
+
+                                if (!bitmap_isset(locked, candidate - DYNAMIC_UID_MIN))
+                                        break;
+                        }
+                        break;
+
                 default:
                         assert_not_reached("unknown phase");
                 }
@@ -1429,34 +1429,40 @@ static int apply_protect_sysctl(const Unit *u, const ExecContext *c) {
         return seccomp_protect_sysctl();
 }
 
-static int apply_protect_kernel_modules(const Unit *u, const ExecContext *c) {
+static int apply_protect_kernel(const Unit *u, const ExecContext *c) {
+        _cleanup_set_free_ Set *s = NULL;
+        int r;
+
         assert(u);
         assert(c);
 
-        /* Turn off module syscalls on ProtectKernelModules=yes */
+        /* ProtectKernelModules=yes turns off the module syscalls, and PrivateDevices=yes turns off iopl and all
+         * @raw-io syscalls. Both simply return EPERM for a fixed list of system calls, hence let's collect them into
+         * a single filter, instead of compiling and installing a separate one for each of them. */
 
-        if (!c->protect_kernel_modules)
+        if (!c->protect_kernel_modules && !c->private_devices)
                 return 0;
 
-        if (skip_seccomp_unavailable(u, "ProtectKernelModules="))
+        if (skip_seccomp_unavailable(u, "ProtectKernelModules=, PrivateDevices="))
                 return 0;
 
-        return seccomp_load_syscall_filter_set(SCMP_ACT_ALLOW, syscall_filter_sets + SYSCALL_FILTER_SET_MODULE, SCMP_ACT_ERRNO(EPERM));
-}
-
-static int apply_private_devices(const Unit *u, const ExecContext *c) {
-        assert(u);
-        assert(c);
-
-        /* If PrivateDevices= is set, also turn off iopl and all @raw-io syscalls. */
+        s = set_new(NULL);
+        if (!s)
+                return -ENOMEM;
 
-        if (!c->private_devices)
-                return 0;
+        if (c->protect_kernel_modules) {
+                r = seccomp_filter_set_add(s, true, syscall_filter_sets + SYSCALL_FILTER_SET_MODULE);
+                if (r < 0)
+                        return r;
+        }
 
-        if (skip_seccomp_unavailable(u, "PrivateDevices="))
-                return 0;
+        if (c->private_devices) {
+                r = seccomp_filter_set_add(s, true, syscall_filter_sets + SYSCALL_FILTER_SET_RAW_IO);
+                if (r < 0)
+                        return r;
+        }
 
-        return seccomp_load_syscall_filter_set(SCMP_ACT_ALLOW, syscall_filter_sets + SYSCALL_FILTER_SET_RAW_IO, SCMP_ACT_ERRNO(EPERM));
+        return seccomp_load_syscall_filter_set_raw(SCMP_ACT_ALLOW, s, SCMP_ACT_ERRNO(EPERM));
 }
 
 static int apply_restrict_namespaces(Unit *u, const ExecContext *c) {
@@ -2703,6 +2709,7 @@ static int exec_child(
         unsigned n_fds;
         ExecDirectoryType dt;
         int secure_bits;
+        usec_t start_usec, namespace_usec = 0, seccomp_usec = 0, n;
 
         assert(unit);
         assert(command);
@@ -2710,6 +2717,10 @@ static int exec_child(
         assert(params);
         assert(exit_status);
 
+        /* Keep track of where the time went while setting up the execution environment, for the debug message
+         * logged right before the execve() */
+        start_usec = now(CLOCK_MONOTONIC);
+
         rename_process_from_path(command->path);
 
         /* We reset exactly these signals, since they are the
@@ -3079,11 +3090,15 @@ static int exec_child(
 
         needs_mount_namespace = exec_needs_mount_namespace(context, params, runtime);
         if (needs_mount_namespace) {
+                n = now(CLOCK_MONOTONIC);
+
                 r = apply_mount_namespace(unit, command, context, params, runtime);
                 if (r < 0) {
                         *exit_status = EXIT_NAMESPACE;
                         return log_unit_error_errno(unit, r, "Failed to set up mount namespacing: %m");
                 }
+
+                namespace_usec = now(CLOCK_MONOTONIC) - n;
         }
 
         /* Apply just after mount namespace setup */
@@ -3272,6 +3287,8 @@ static int exec_child(
                         }
 
 #ifdef HAVE_SECCOMP
+                n = now(CLOCK_MONOTONIC);
+
                 r = apply_address_families(unit, context);
                 if (r < 0) {
                         *exit_status = EXIT_ADDRESS_FAMILIES;
@@ -3302,16 +3319,10 @@ static int exec_child(
                         return log_unit_error_errno(unit, r, "Failed to apply sysctl restrictions: %m");
                 }
 
-                r = apply_protect_kernel_modules(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply module loading restrictions: %m");
-                }
-
-                r = apply_private_devices(unit, context);
+                r = apply_protect_kernel(unit, context);
                 if (r < 0) {
                         *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to set up private devices: %m");
+                        return log_unit_error_errno(unit, r, "Failed to apply module loading and device access restrictions: %m");
                 }
 
                 r = apply_syscall_archs(unit, context);
@@ -3333,6 +3344,8 @@ static int exec_child(
                         *exit_status = EXIT_SECCOMP;
                         return log_unit_error_errno(unit, r, "Failed to apply system call filters: %m");
                 }
+
+                seccomp_usec = now(CLOCK_MONOTONIC) - n;
 #endif
         }
 
@@ -3362,6 +3375,9 @@ static int exec_child(
                 if (line) {
                         log_struct(LOG_DEBUG,
                                    "EXECUTABLE=%s", command->path,
+                                   "SETUP_USEC=" USEC_FMT, now(CLOCK_MONOTONIC) - start_usec,
+                                   "NAMESPACE_SETUP_USEC=" USEC_FMT, namespace_usec,
+                                   "SECCOMP_SETUP_USEC=" USEC_FMT, seccomp_usec,
                                    LOG_UNIT_MESSAGE(unit, "Executing: %s", line),
                                    LOG_UNIT_ID(unit),
                                    LOG_UNIT_INVOCATION_ID(unit),
@@ -3444,16 +3460,20 @@ int exec_spawn(Unit *unit,
                 return log_unit_error_errno(unit, r, "Failed to load environment files: %m");
 
         argv = params->argv ?: command->argv;
-        line = exec_command_line(argv);
-        if (!line)
-                return log_oom();
 
-        log_struct(LOG_DEBUG,
-                   LOG_UNIT_MESSAGE(unit, "About to execute: %s", line),
-                   "EXECUTABLE=%s", command->path,
-                   LOG_UNIT_ID(unit),
-                   LOG_UNIT_INVOCATION_ID(unit),
-                   NULL);
+        /* Don't bother formatting the command line on every spawn if nobody is going to see it */
+        if (log_get_max_level() >= LOG_DEBUG) {
+                line = exec_command_line(argv);
+                if (!line)
+                        return log_oom();
+
+                log_struct(LOG_DEBUG,
+                           LOG_UNIT_MESSAGE(unit, "About to execute: %s", line),
+                           "EXECUTABLE=%s", command->path,
+                           LOG_UNIT_ID(unit),
+                           LOG_UNIT_INVOCATION_ID(unit),
+                           NULL);
+        }
 
         pid = fork();
         if (pid < 0)
@@ -48,7 +48,7 @@ Job* job_new_raw(Unit *unit) {
 
         assert(unit);
 
-        j = new0(Job, 1);
+        j = mempool_alloc0_tile(&unit->manager->job_pool);
         if (!j)
                 return NULL;
 
@@ -85,7 +85,7 @@ void job_free(Job *j) {
         assert(!j->object_list);
 
         if (j->in_run_queue)
-                LIST_REMOVE(run_queue, j->manager->run_queue, j);
+                prioq_remove(j->manager->run_queue, j, &j->run_queue_idx);
 
         if (j->in_dbus_queue)
                 LIST_REMOVE(dbus_queue, j->manager->dbus_job_queue, j);
@@ -98,7 +98,7 @@ void job_free(Job *j) {
         sd_bus_track_unref(j->bus_track);
         strv_free(j->deserialized_clients);
 
-        free(j);
+        mempool_free_tile(&j->manager->job_pool, j);
 }
 
 static void job_set_state(Job *j, JobState state) {
@@ -124,6 +124,10 @@ static void job_set_state(Job *j, JobState state) {
 
                 if (j->unit->manager->n_running_jobs <= 0)
                         j->unit->manager->jobs_in_progress_event_source = sd_event_source_unref(j->unit->manager->jobs_in_progress_event_source);
+
+                /* If the run queue was held back because of JobConcurrencyMax=, there's room again now */
+                if (!prioq_isempty(j->unit->manager->run_queue))
+                        sd_event_source_set_enabled(j->unit->manager->run_queue_event_source, SD_EVENT_ONESHOT);
         }
 }
 
@@ -561,7 +565,7 @@ int job_run_and_invalidate(Job *j) {
         assert(j->type < _JOB_TYPE_MAX_IN_TRANSACTION);
         assert(j->in_run_queue);
 
-        LIST_REMOVE(run_queue, j->manager->run_queue, j);
+        prioq_remove(j->manager->run_queue, j, &j->run_queue_idx);
         j->in_run_queue = false;
 
         if (j->state != JOB_WAITING)
@@ -847,11 +851,30 @@ static void job_fail_dependencies(Unit *u, UnitDependency d) {
         }
 }
 
+static void job_requeue(Job *j) {
+        int r;
+
+        assert(j);
+
+        /* Lets the job run again if it can, or fails it right away if it can't be queued, as it would
+         * never run otherwise */
+
+        r = job_add_to_run_queue(j);
+        if (r < 0) {
+                log_unit_warning_errno(j->unit, r, "Failed to queue job %s/%s, failing it: %m", j->unit->id, job_type_to_string(j->type));
+                job_finish_and_invalidate(j, JOB_FAILED, true, false);
+                return;
+        }
+
+        job_add_to_gc_queue(j);
+}
+
 int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool already) {
         Unit *u;
         Unit *other;
         JobType t;
         Iterator i;
+        int r;
 
         assert(j);
         assert(j->installed);
@@ -876,7 +899,12 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
                 job_change_type(j, JOB_START);
                 job_set_state(j, JOB_WAITING);
 
-                job_add_to_run_queue(j);
+                r = job_add_to_run_queue(j);
+                if (r < 0) {
+                        log_unit_warning_errno(u, r, "Failed to queue job %s/%s, failing it: %m", u->id, job_type_to_string(j->type));
+                        return job_finish_and_invalidate(j, JOB_FAILED, true, false);
+                }
+
                 job_add_to_gc_queue(j);
 
                 goto finish;
@@ -921,15 +949,11 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
 finish:
         /* Try to start the next jobs that can be started */
         SET_FOREACH(other, u->dependencies[UNIT_AFTER], i)
-                if (other->job) {
-                        job_add_to_run_queue(other->job);
-                        job_add_to_gc_queue(other->job);
-                }
+                if (other->job)
+                        job_requeue(other->job);
         SET_FOREACH(other, u->dependencies[UNIT_BEFORE], i)
-                if (other->job) {
-                        job_add_to_run_queue(other->job);
-                        job_add_to_gc_queue(other->job);
-                }
+                if (other->job)
+                        job_requeue(other->job);
 
         manager_check_finished(u->manager);
 
@@ -1002,18 +1026,66 @@ int job_start_timer(Job *j, bool job_running) {
         return 0;
 }
 
-void job_add_to_run_queue(Job *j) {
+static unsigned job_n_blocked(Job *j) {
+        Iterator i;
+        Unit *other;
+        unsigned n = 0;
+
+        assert(j);
+
+        /* Returns the number of jobs that are ordered to wait for this one. Stop jobs are ordered the other
+         * way round. */
+        SET_FOREACH(other, j->unit->dependencies[j->type == JOB_STOP ? UNIT_AFTER : UNIT_BEFORE], i)
+                if (other->job)
+                        n++;
+
+        return n;
+}
+
+int job_run_queue_compare(const void *a, const void *b) {
+        const Job *x = a, *y = b;
+
+        /* Jobs that unblock the most others go first, so that they get the slots when JobConcurrencyMax= is
+         * reached. Otherwise, in the order they were enqueued. */
+
+        if (x->n_blocked > y->n_blocked)
+                return -1;
+        if (x->n_blocked < y->n_blocked)
+                return 1;
+
+        if (x->id < y->id)
+                return -1;
+        if (x->id > y->id)
+                return 1;
+
+        return 0;
+}
+
+int job_add_to_run_queue(Job *j) {
+        int r;
+
         assert(j);
         assert(j->installed);
 
+        /* A job that couldn't be queued would never run, hence callers should fail it if this fails */
+
         if (j->in_run_queue)
-                return;
+                return 0;
+
+        if (prioq_isempty(j->manager->run_queue)) {
+                r = sd_event_source_set_enabled(j->manager->run_queue_event_source, SD_EVENT_ONESHOT);
+                if (r < 0)
+                        return r;
+        }
 
-        if (!j->manager->run_queue)
-                sd_event_source_set_enabled(j->manager->run_queue_event_source, SD_EVENT_ONESHOT);
+        j->n_blocked = job_n_blocked(j);
+
+        r = prioq_put(j->manager->run_queue, j, &j->run_queue_idx);
+        if (r < 0)
+                return r;
 
-        LIST_PREPEND(run_queue, j->manager->run_queue, j);
         j->in_run_queue = true;
+        return 0;
 }
 
 void job_add_to_dbus_queue(Job *j) {
@@ -1180,8 +1252,13 @@ int job_coldplug(Job *j) {
          * set up again, let's start watching our subscribers again */
         (void) bus_job_coldplug_bus_track(j);
 
-        if (j->state == JOB_WAITING)
-                job_add_to_run_queue(j);
+        if (j->state == JOB_WAITING) {
+                r = job_add_to_run_queue(j);
+                if (r < 0) {
+                        log_unit_warning_errno(j->unit, r, "Failed to queue job %s/%s, failing it: %m", j->unit->id, job_type_to_string(j->type));
+                        return job_finish_and_invalidate(j, JOB_FAILED, true, false);
+                }
+        }
 
         /* Maybe due to new dependencies we don't actually need this job anymore? */
         job_add_to_gc_queue(j);
@@ -132,7 +132,6 @@ struct Job {
         Unit *unit;
 
         LIST_FIELDS(Job, transaction);
-        LIST_FIELDS(Job, run_queue);
         LIST_FIELDS(Job, dbus_queue);
         LIST_FIELDS(Job, gc_queue);
 
@@ -145,6 +144,10 @@ struct Job {
 
         uint32_t id;
 
+        /* The position in the run queue, and the number of jobs waiting for this one at the time it was queued */
+        unsigned run_queue_idx;
+        unsigned n_blocked;
+
         JobType type;
         JobState state;
 
@@ -169,6 +172,7 @@ struct Job {
         bool matters_to_anchor:1;
         bool in_dbus_queue:1;
         bool sent_dbus_new_signal:1;
+        bool dbus_change_deferred:1;
         bool ignore_order:1;
         bool irreversible:1;
         bool in_gc_queue:1;
@@ -218,7 +222,8 @@ JobType job_type_collapse(JobType t, Unit *u);
 
 int job_type_merge_and_collapse(JobType *a, JobType b, Unit *u);
 
-void job_add_to_run_queue(Job *j);
+int job_add_to_run_queue(Job *j);
+int job_run_queue_compare(const void *a, const void *b);
 void job_add_to_dbus_queue(Job *j);
 
 int job_start_timer(Job *j, bool job_running);
@@ -18,7 +18,9 @@
 ***/
 
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
+#include <sys/signalfd.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -28,6 +30,7 @@
 #include "fd-util.h"
 #include "format-util.h"
 #include "killall.h"
+#include "missing.h"
 #include "parse-util.h"
 #include "process-util.h"
 #include "set.h"
@@ -88,6 +91,83 @@ static bool ignore_proc(pid_t pid, bool warn_rootfs) {
         return true;
 }
 
+static int wait_for_pidfds(Set *pids, const sigset_t *mask, usec_t timeout) {
+        _cleanup_free_ struct pollfd *pollfds = NULL;
+        _cleanup_free_ pid_t *watched = NULL;
+        _cleanup_close_ int sfd = -1;
+        size_t n_pollfds = 0, k;
+        Iterator i;
+        void *p;
+        int r = 0;
+
+        assert(pids);
+        assert(mask);
+
+        /* Processes that are not our children don't cause a SIGCHLD when they exit, hence sigtimedwait()
+         * alone would notice them only on the next unrelated SIGCHLD or when the timeout is hit. If the
+         * kernel supports pidfds, wait for them directly, and for SIGCHLD through a signalfd. Returns
+         * -ENOSYS if pidfds are not available. */
+
+        pollfds = new(struct pollfd, set_size(pids) + 1);
+        watched = new(pid_t, set_size(pids));
+        if (!pollfds || !watched)
+                return -ENOMEM;
+
+        SET_FOREACH(p, pids, i) {
+                int fd;
+
+                fd = missing_pidfd_open(PTR_TO_PID(p), 0);
+                if (fd < 0) {
+                        if (errno == ESRCH) {
+                                set_remove(pids, p);
+                                continue;
+                        }
+
+                        r = -errno;
+                        goto finish;
+                }
+
+                watched[n_pollfds] = PTR_TO_PID(p);
+                pollfds[n_pollfds++] = (struct pollfd) { .fd = fd, .events = POLLIN };
+        }
+
+        if (n_pollfds == 0)
+                goto finish;
+
+        sfd = signalfd(-1, mask, SFD_NONBLOCK|SFD_CLOEXEC);
+        if (sfd < 0) {
+                r = -errno;
+                goto finish;
+        }
+
+        pollfds[n_pollfds] = (struct pollfd) { .fd = sfd, .events = POLLIN };
+
+        if (poll(pollfds, n_pollfds + 1, DIV_ROUND_UP(timeout, USEC_PER_MSEC)) < 0) {
+                r = -errno;
+                goto finish;
+        }
+
+        /* A readable pidfd means the process is dead. It might stay around as a zombie for a bit if it is not
+         * our child, but that's good enough for us. */
+        for (k = 0; k < n_pollfds; k++)
+                if (pollfds[k].revents & POLLIN)
+                        (void) set_remove(pids, PID_TO_PTR(watched[k]));
+
+        /* Consume the pending SIGCHLDs, so that they don't wake us up right away next time */
+        for (;;) {
+                struct signalfd_siginfo si;
+
+                if (read(sfd, &si, sizeof(si)) != sizeof(si))
+                        break;
+        }
+
+finish:
+        for (k = 0; k < n_pollfds; k++)
+                safe_close(pollfds[k].fd);
+
+        return r;
+}
+
 static void wait_for_children(Set *pids, sigset_t *mask) {
         usec_t until;
 
@@ -99,7 +179,7 @@ static void wait_for_children(Set *pids, sigset_t *mask) {
         until = now(CLOCK_MONOTONIC) + DEFAULT_TIMEOUT_USEC;
         for (;;) {
                 struct timespec ts;
-                int k;
+                int k, r;
                 usec_t n;
                 void *p;
                 Iterator i;
@@ -147,6 +227,12 @@ static void wait_for_children(Set *pids, sigset_t *mask) {
                 if (n >= until)
                         return;
 
+                r = wait_for_pidfds(pids, mask, until - n);
+                if (r >= 0)
+                        continue;
+                if (r != -ENOSYS)
+                        log_debug_errno(r, "Failed to wait for processes through pidfds, waiting for SIGCHLD instead: %m");
+
                 timespec_store(&ts, until - n);
                 k = sigtimedwait(mask, NULL, &ts);
                 if (k != SIGCHLD) {
@@ -39,6 +39,7 @@
 #include "sd-path.h"
 
 #include "alloc-util.h"
+#include "async.h"
 #include "audit-fd.h"
 #include "boot-timestamps.h"
 #include "bus-common-errors.h"
@@ -97,6 +98,12 @@
 #define JOBS_IN_PROGRESS_PERIOD_USEC (USEC_PER_SEC / 3)
 #define JOBS_IN_PROGRESS_PERIOD_DIVISOR 3
 
+/* Upper limit for the threads reading unit files ahead of the load queue */
+#define PREFETCH_THREADS_MAX 4U
+
+/* How many sd_notify() messages to process per event loop iteration */
+#define NOTIFY_MESSAGES_PER_ITERATION 16U
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_cgroups_agent_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
@@ -620,6 +627,11 @@ int manager_new(UnitFileScope scope, unsigned test_run_flags, Manager **_m) {
         m->default_timeout_stop_usec = DEFAULT_TIMEOUT_USEC;
         m->default_restart_usec = DEFAULT_RESTART_USEC;
 
+        m->job_pool = (struct mempool) {
+                .tile_size = sizeof(Job),
+                .at_least = 16,
+        };
+
 #ifdef ENABLE_EFI
         if (MANAGER_IS_SYSTEM(m) && detect_container() <= 0)
                 boot_timestamps(&m->userspace_timestamp, &m->firmware_timestamp, &m->loader_timestamp);
@@ -682,6 +694,10 @@ int manager_new(UnitFileScope scope, unsigned test_run_flags, Manager **_m) {
         if (r < 0)
                 goto fail;
 
+        r = prioq_ensure_allocated(&m->run_queue, job_run_queue_compare);
+        if (r < 0)
+                goto fail;
+
         r = sd_event_add_defer(m->event, &m->run_queue_event_source, manager_dispatch_run_queue, m);
         if (r < 0)
                 goto fail;
@@ -942,6 +958,37 @@ static int manager_connect_bus(Manager *m, bool reexecuting) {
         return bus_init(m, try_bus_connect);
 }
 
+static void manager_trim_pool(struct mempool *mp, bool all) {
+        unsigned n;
+
+        /* Releasing pools needs a walk over the free list, hence only try when the pool is less than half
+         * full, and not again before another quarter of its tiles was freed since the last try. During
+         * shutdown no unit or job is left, and everything is released. */
+
+        if (all)
+                assert(mp->n_used == 0);
+        else {
+                (void) mempool_allocated(mp, &n);
+                if (mp->n_used >= n / 2)
+                        return;
+                if (mp->n_freed < n / 4)
+                        return;
+        }
+
+        mempool_trim(mp);
+}
+
+static void manager_trim_pools(Manager *m, bool all) {
+        unsigned i;
+
+        assert(m);
+
+        for (i = 0; i < ELEMENTSOF(m->unit_pools); i++)
+                manager_trim_pool(m->unit_pools + i, all);
+
+        manager_trim_pool(&m->job_pool, all);
+}
+
 static unsigned manager_dispatch_cleanup_queue(Manager *m) {
         Unit *u;
         unsigned n = 0;
@@ -955,6 +1002,9 @@ static unsigned manager_dispatch_cleanup_queue(Manager *m) {
                 n++;
         }
 
+        if (n > 0)
+                manager_trim_pools(m, false);
+
         return n;
 }
 
@@ -978,12 +1028,13 @@ static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
                         unit_gc_mark_good(other, gc_marker);
 }
 
-static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
+static void unit_gc_sweep(Unit *u, unsigned gc_marker, uint64_t *n_swept) {
         Iterator i;
         Unit *other;
         bool is_bad;
 
         assert(u);
+        assert(n_swept);
 
         if (u->gc_marker == gc_marker + GC_OFFSET_GOOD ||
             u->gc_marker == gc_marker + GC_OFFSET_BAD ||
@@ -991,6 +1042,9 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
             u->gc_marker == gc_marker + GC_OFFSET_IN_PATH)
                 return;
 
+        /* Each unit is checked at most once per round, the marker above covers all outcomes */
+        (*n_swept)++;
+
         if (u->in_cleanup_queue)
                 goto bad;
 
@@ -1002,7 +1056,7 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
         is_bad = true;
 
         SET_FOREACH(other, u->dependencies[UNIT_REFERENCED_BY], i) {
-                unit_gc_sweep(other, gc_marker);
+                unit_gc_sweep(other, gc_marker, n_swept);
 
                 if (other->gc_marker == gc_marker + GC_OFFSET_GOOD)
                         goto good;
@@ -1032,13 +1086,22 @@ good:
 }
 
 static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
+        uint64_t n_swept = 0, n_collected = 0;
         unsigned n = 0, gc_marker;
+        usec_t start;
         Unit *u;
 
         assert(m);
 
+        /* This is called on every iteration of the main loop, don't even look at the clock if there's
+         * nothing to do */
+        if (!m->gc_unit_queue)
+                return 0;
+
         /* log_debug("Running GC..."); */
 
+        start = now(CLOCK_MONOTONIC);
+
         m->gc_marker += _GC_OFFSET_MAX;
         if (m->gc_marker + _GC_OFFSET_MAX <= _GC_OFFSET_MAX)
                 m->gc_marker = 1;
@@ -1048,7 +1111,7 @@ static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
         while ((u = m->gc_unit_queue)) {
                 assert(u->in_gc_queue);
 
-                unit_gc_sweep(u, gc_marker);
+                unit_gc_sweep(u, gc_marker, &n_swept);
 
                 LIST_REMOVE(gc_queue, m->gc_unit_queue, u);
                 u->in_gc_queue = false;
@@ -1061,9 +1124,15 @@ static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
                                 log_unit_debug(u, "Collecting.");
                         u->gc_marker = gc_marker + GC_OFFSET_BAD;
                         unit_add_to_cleanup_queue(u);
+                        n_collected++;
                 }
         }
 
+        m->n_gc_rounds++;
+        m->n_gc_units_swept += n_swept;
+        m->n_gc_units_collected += n_collected;
+        m->gc_usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), start);
+
         return n;
 }
 
@@ -1102,7 +1171,7 @@ static void manager_clear_jobs_and_units(Manager *m) {
         manager_dispatch_cleanup_queue(m);
 
         assert(!m->load_queue);
-        assert(!m->run_queue);
+        assert(prioq_isempty(m->run_queue));
         assert(!m->dbus_unit_queue);
         assert(!m->dbus_job_queue);
         assert(!m->cleanup_queue);
@@ -1116,6 +1185,32 @@ static void manager_clear_jobs_and_units(Manager *m) {
         m->n_running_jobs = 0;
 }
 
+typedef struct UnitPathCacheDir {
+        char *path;
+        usec_t mtime;
+        char **paths;
+} UnitPathCacheDir;
+
+static UnitPathCacheDir* unit_path_cache_dir_free(UnitPathCacheDir *d) {
+        if (!d)
+                return NULL;
+
+        free(d->path);
+        strv_free(d->paths);
+        return mfree(d);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitPathCacheDir*, unit_path_cache_dir_free);
+
+static Hashmap* unit_path_cache_dirs_free(Hashmap *h) {
+        UnitPathCacheDir *d;
+
+        while ((d = hashmap_steal_first(h)))
+                unit_path_cache_dir_free(d);
+
+        return hashmap_free(h);
+}
+
 Manager* manager_free(Manager *m) {
         UnitType c;
         int i;
@@ -1125,6 +1220,7 @@ Manager* manager_free(Manager *m) {
                 return NULL;
 
         manager_clear_jobs_and_units(m);
+        manager_trim_pools(m, true);
 
         for (c = 0; c < _UNIT_TYPE_MAX; c++)
                 if (unit_vtable[c]->shutdown)
@@ -1156,6 +1252,7 @@ Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->time_change_event_source);
         sd_event_source_unref(m->jobs_in_progress_event_source);
         sd_event_source_unref(m->run_queue_event_source);
+        prioq_free(m->run_queue);
         sd_event_source_unref(m->user_lookup_event_source);
 
         safe_close(m->signal_fd);
@@ -1177,7 +1274,9 @@ Manager* manager_free(Manager *m) {
         strv_free(m->environment);
 
         hashmap_free(m->cgroup_unit);
-        set_free_free(m->unit_path_cache);
+        hashmap_free_free_free(m->timer_calendar_cache);
+        set_free(m->unit_path_cache);
+        unit_path_cache_dirs_free(m->unit_path_cache_dirs);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -1240,54 +1339,265 @@ static void manager_coldplug(Manager *m) {
         }
 }
 
+typedef struct UnitPrefetch {
+        unsigned n_ref;
+        unsigned next;
+        char **paths;
+        unsigned n_paths;
+} UnitPrefetch;
+
+static void prefetch_file(int dir_fd, const char *path) {
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+
+        fd = openat(dir_fd, path, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+        if (fd < 0)
+                return;
+
+        if (fstat(fd, &st) < 0)
+                return;
+
+        if (S_ISDIR(st.st_mode)) {
+                _cleanup_closedir_ DIR *d = NULL;
+                struct dirent *de;
+
+                /* Drop-in and dependency directories: reading the directory itself gets the symlinks
+                 * of .wants/ and .requires/ into the dentry cache, the .conf files of .d/ are read too */
+                d = fdopendir(fd);
+                if (!d)
+                        return;
+                fd = -1;
+
+                FOREACH_DIRENT(de, d, return)
+                        if (endswith(de->d_name, ".conf"))
+                                prefetch_file(dirfd(d), de->d_name);
+
+                return;
+        }
+
+        if (!S_ISREG(st.st_mode))
+                return;
+
+        (void) posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+}
+
+static void *prefetch_thread(void *p) {
+        UnitPrefetch *u = p;
+
+        for (;;) {
+                unsigned i;
+
+                i = __sync_fetch_and_add(&u->next, 1);
+                if (i >= u->n_paths)
+                        break;
+
+                prefetch_file(AT_FDCWD, u->paths[i]);
+        }
+
+        if (__sync_sub_and_fetch(&u->n_ref, 1) == 0) {
+                strv_free(u->paths);
+                free(u);
+        }
+
+        return NULL;
+}
+
+static void manager_prefetch_unit_files(Manager *m) {
+        UnitPrefetch *u;
+        unsigned n_threads, i;
+        Iterator it;
+        char *path;
+        long ncpus;
+
+        assert(m);
+
+        /* Parsing unit files has to happen on the main thread, as it directly modifies the units and
+         * the manager. But reading them from disk does not, hence have a few threads open all unit
+         * files, drop-ins and dependency directories we know of, and schedule reading them into the
+         * page cache, ahead of the load queue getting there. */
+
+        if (set_isempty(m->unit_path_cache))
+                return;
+
+        u = new0(UnitPrefetch, 1);
+        if (!u) {
+                log_oom();
+                return;
+        }
+
+        u->paths = new(char*, set_size(m->unit_path_cache) + 1);
+        if (!u->paths) {
+                free(u);
+                log_oom();
+                return;
+        }
+
+        SET_FOREACH(path, m->unit_path_cache, it) {
+                u->paths[u->n_paths] = strdup(path);
+                if (!u->paths[u->n_paths])
+                        break;
+
+                u->n_paths++;
+        }
+        u->paths[u->n_paths] = NULL;
+
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = CLAMP(ncpus, 1, (long) PREFETCH_THREADS_MAX);
+
+        /* One reference for each thread and one for us, so that threads can't free it while we are still
+         * starting the others */
+        u->n_ref = n_threads + 1;
+
+        for (i = 0; i < n_threads; i++) {
+                int r;
+
+                r = asynchronous_job(prefetch_thread, u);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to start unit file prefetch thread, ignoring: %m");
+                        (void) __sync_sub_and_fetch(&u->n_ref, n_threads - i);
+                        break;
+                }
+        }
+
+        if (__sync_sub_and_fetch(&u->n_ref, 1) == 0) {
+                strv_free(u->paths);
+                free(u);
+        }
+}
+
+static int unit_path_cache_dir_scan(const char *path, const struct stat *st, usec_t scan_start, UnitPathCacheDir **ret) {
+        _cleanup_(unit_path_cache_dir_freep) UnitPathCacheDir *d = NULL;
+        _cleanup_closedir_ DIR *dir = NULL;
+        size_t n_allocated = 0, n = 0;
+        struct dirent *de;
+
+        assert(path);
+        assert(st);
+        assert(ret);
+
+        d = new0(UnitPathCacheDir, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->path = strdup(path);
+        if (!d->path)
+                return -ENOMEM;
+
+        /* The directory might be changed again within the granularity of its timestamp while we are reading
+         * it, in which case the timestamp wouldn't tell. Hence only trust timestamps sufficiently in the
+         * past, and always read the directory again next time otherwise. */
+        d->mtime = timespec_load(&st->st_mtim);
+        if (d->mtime == USEC_INFINITY || d->mtime + USEC_PER_SEC > scan_start)
+                d->mtime = USEC_INFINITY;
+
+        dir = opendir(path);
+        if (!dir)
+                return -errno;
+
+        FOREACH_DIRENT(de, dir, return -errno) {
+                char *p;
+
+                p = strjoin(streq(path, "/") ? "" : path, "/", de->d_name);
+                if (!p)
+                        return -ENOMEM;
+
+                if (!GREEDY_REALLOC(d->paths, n_allocated, n + 2)) {
+                        free(p);
+                        return -ENOMEM;
+                }
+
+                d->paths[n++] = p;
+                d->paths[n] = NULL;
+        }
+
+        *ret = d;
+        d = NULL;
+
+        return 0;
+}
+
 static void manager_build_unit_path_cache(Manager *m) {
+        Hashmap *dirs = NULL;
+        usec_t scan_start;
         char **i;
         int r;
 
         assert(m);
 
-        set_free_free(m->unit_path_cache);
+        /* This simply builds a list of files we know exist, so that we don't always have to go to disk. The
+         * listing of each directory is kept around until the next reload, and only read again if the
+         * directory was modified in the meantime, as most of them don't change between reloads. */
+
+        m->unit_path_cache = set_free(m->unit_path_cache);
 
         m->unit_path_cache = set_new(&string_hash_ops);
-        if (!m->unit_path_cache) {
+        dirs = hashmap_new(&string_hash_ops);
+        if (!m->unit_path_cache || !dirs) {
                 r = -ENOMEM;
                 goto fail;
         }
 
-        /* This simply builds a list of files we know exist, so that
-         * we don't always have to go to disk */
+        scan_start = now(CLOCK_REALTIME);
 
         STRV_FOREACH(i, m->lookup_paths.search_path) {
-                _cleanup_closedir_ DIR *d = NULL;
-                struct dirent *de;
+                _cleanup_(unit_path_cache_dir_freep) UnitPathCacheDir *d = NULL;
+                struct stat st;
+                char **p;
 
-                d = opendir(*i);
-                if (!d) {
+                if (hashmap_contains(dirs, *i))
+                        continue;
+
+                d = hashmap_remove(m->unit_path_cache_dirs, *i);
+
+                if (stat(*i, &st) < 0) {
                         if (errno != ENOENT)
-                                log_warning_errno(errno, "Failed to open directory %s, ignoring: %m", *i);
+                                log_warning_errno(errno, "Failed to stat directory %s, ignoring: %m", *i);
                         continue;
                 }
 
-                FOREACH_DIRENT(de, d, r = -errno; goto fail) {
-                        char *p;
+                if (d && (d->mtime == USEC_INFINITY || d->mtime != timespec_load(&st.st_mtim)))
+                        d = unit_path_cache_dir_free(d);
 
-                        p = strjoin(streq(*i, "/") ? "" : *i, "/", de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
-                                goto fail;
+                if (!d) {
+                        r = unit_path_cache_dir_scan(*i, &st, scan_start, &d);
+                        if (r == -ENOENT)
+                                continue;
+                        if (r < 0) {
+                                if (r == -ENOMEM)
+                                        goto fail;
+
+                                log_warning_errno(r, "Failed to read directory %s, ignoring: %m", *i);
+                                continue;
                         }
+                }
 
-                        r = set_consume(m->unit_path_cache, p);
-                        if (r < 0)
+                r = hashmap_put(dirs, d->path, d);
+                if (r < 0)
+                        goto fail;
+
+                STRV_FOREACH(p, d->paths) {
+                        r = set_put(m->unit_path_cache, *p);
+                        if (r < 0) {
+                                d = NULL;
                                 goto fail;
+                        }
                 }
+
+                d = NULL;
         }
 
+        /* Whatever is left over belongs to directories that are not part of the search path anymore */
+        unit_path_cache_dirs_free(m->unit_path_cache_dirs);
+        m->unit_path_cache_dirs = dirs;
+
+        manager_prefetch_unit_files(m);
         return;
 
 fail:
         log_warning_errno(r, "Failed to build unit path cache, proceeding without: %m");
-        m->unit_path_cache = set_free_free(m->unit_path_cache);
+        m->unit_path_cache = set_free(m->unit_path_cache);
+        m->unit_path_cache_dirs = unit_path_cache_dirs_free(m->unit_path_cache_dirs);
+        unit_path_cache_dirs_free(dirs);
 }
 
 static void manager_distribute_fds(Manager *m, FDSet *fds) {
@@ -1695,6 +2005,85 @@ void manager_dump_units(Manager *s, FILE *f, const char *prefix) {
                         unit_dump(u, f, prefix);
 }
 
+static void manager_dump_pool(const struct mempool *mp, const char *what, FILE *f, const char *prefix) {
+        char buf[FORMAT_BYTES_MAX];
+        unsigned n;
+        size_t sz;
+
+        sz = mempool_allocated(mp, &n);
+
+        fprintf(f,
+                "%s\t%s Pool (%zu bytes each): %u of %u allocated, %s\n",
+                strempty(prefix), what, mp->tile_size, mp->n_used, n, format_bytes(buf, sizeof(buf), sz));
+}
+
+void manager_dump_memory_usage(Manager *s, FILE *f, const char *prefix) {
+        unsigned n_units = 0, n_sets = 0, n_dependencies = 0, k;
+        char buf[FORMAT_BYTES_MAX];
+        size_t sz = 0;
+        Iterator i;
+        Unit *u;
+        const char *t;
+
+        assert(s);
+        assert(f);
+
+        /* Most dependency sets hold only one or two units, which the hashmap implementation stores
+         * directly in the set's head. Show how much that holds up on this system. */
+
+        HASHMAP_FOREACH_KEY(u, t, s->units, i) {
+                UnitDependency d;
+
+                if (u->id != t)
+                        continue;
+
+                n_units++;
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        if (!u->dependencies[d])
+                                continue;
+
+                        n_sets++;
+                        n_dependencies += set_size(u->dependencies[d]);
+                        sz += set_memory_usage(u->dependencies[d]);
+                }
+        }
+
+        fprintf(f,
+                "%s-> Units: %u\n"
+                "%s\tDependencies: %u in %u sets\n"
+                "%s\tDependency Memory: %s\n",
+                strempty(prefix), n_units,
+                strempty(prefix), n_dependencies, n_sets,
+                strempty(prefix), format_bytes(buf, sizeof(buf), sz));
+
+        for (k = 0; k < ELEMENTSOF(s->unit_pools); k++) {
+                if (s->unit_pools[k].tile_size == 0)
+                        break;
+
+                manager_dump_pool(s->unit_pools + k, "Unit", f, prefix);
+        }
+
+        manager_dump_pool(&s->job_pool, "Job", f, prefix);
+}
+
+void manager_dump_gc(Manager *s, FILE *f, const char *prefix) {
+        char buf[FORMAT_TIMESPAN_MAX];
+
+        assert(s);
+        assert(f);
+
+        fprintf(f,
+                "%s-> Garbage Collection Rounds: %u\n"
+                "%s\tUnits Checked: %" PRIu64 "\n"
+                "%s\tUnits Collected: %" PRIu64 "\n"
+                "%s\tTotal Time: %s\n",
+                strempty(prefix), s->n_gc_rounds,
+                strempty(prefix), s->n_gc_units_swept,
+                strempty(prefix), s->n_gc_units_collected,
+                strempty(prefix), format_timespan(buf, sizeof(buf), s->gc_usec, 1));
+}
+
 void manager_clear_jobs(Manager *m) {
         Job *j;
 
@@ -1712,10 +2101,15 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         assert(source);
         assert(m);
 
-        while ((j = m->run_queue)) {
+        while ((j = prioq_peek(m->run_queue))) {
                 assert(j->installed);
                 assert(j->in_run_queue);
 
+                /* Leave the rest queued if we are at the limit, job_set_state() will get us going again once
+                 * one of the running jobs is done */
+                if (m->job_concurrency_max > 0 && m->n_running_jobs >= m->job_concurrency_max)
+                        break;
+
                 job_run_and_invalidate(j);
         }
 
@@ -1728,6 +2122,26 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         return 1;
 }
 
+static void manager_requeue_deferred_dbus(Manager *m) {
+        const char *k;
+        Iterator i;
+        Unit *u;
+        Job *j;
+
+        assert(m);
+
+        /* Queue everything again that change signals were skipped for on some congested bus. The buses that
+         * got them already get them a second time, which is harmless, as they carry the current state only. */
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i)
+                if (k == u->id && u->dbus_change_deferred)
+                        unit_add_to_dbus_queue(u);
+
+        HASHMAP_FOREACH(j, m->jobs, i)
+                if (j->dbus_change_deferred)
+                        job_add_to_dbus_queue(j);
+}
+
 static unsigned manager_dispatch_dbus_queue(Manager *m) {
         Job *j;
         Unit *u;
@@ -1738,23 +2152,37 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
         if (m->dispatching_dbus_queue)
                 return 0;
 
-        m->dispatching_dbus_queue = true;
+        /* If none of the buses caught up with the signals we generated earlier, don't enqueue more on top,
+         * but leave the units and jobs queued. Further changes to them will then be merged into the one
+         * signal generated once a bus caught up. Buses that are still congested then are skipped by
+         * the change signals, see bus_check_congested(), so that one slow peer doesn't hold back everybody
+         * else, and are sent the skipped ones once they caught up, too. During a reload we want to be done
+         * quickly though, hence don't hold back then. */
+        if (MANAGER_IS_RELOADING(m) ||
+            m->send_reloading_done ||
+            !bus_all_congested(m)) {
 
-        while ((u = m->dbus_unit_queue)) {
-                assert(u->in_dbus_queue);
+                if (bus_forget_drained(m))
+                        manager_requeue_deferred_dbus(m);
 
-                bus_unit_send_change_signal(u);
-                n++;
-        }
+                m->dispatching_dbus_queue = true;
 
-        while ((j = m->dbus_job_queue)) {
-                assert(j->in_dbus_queue);
+                while ((u = m->dbus_unit_queue)) {
+                        assert(u->in_dbus_queue);
 
-                bus_job_send_change_signal(j);
-                n++;
-        }
+                        bus_unit_send_change_signal(u);
+                        n++;
+                }
 
-        m->dispatching_dbus_queue = false;
+                while ((j = m->dbus_job_queue)) {
+                        assert(j->in_dbus_queue);
+
+                        bus_job_send_change_signal(j);
+                        n++;
+                }
+
+                m->dispatching_dbus_queue = false;
+        }
 
         if (m->send_reloading_done) {
                 m->send_reloading_done = false;
@@ -1804,15 +2232,24 @@ static void manager_invoke_notify_message(Manager *m, Unit *u, pid_t pid, const
         assert(u);
         assert(buf);
 
-        tags = strv_split(buf, "\n\r");
-        if (!tags) {
-                log_oom();
-                return;
-        }
+        u->n_notify_messages++;
+
+        if (UNIT_VTABLE(u)->notify_message) {
+                char *single[2] = { (char*) buf, NULL };
 
-        if (UNIT_VTABLE(u)->notify_message)
-                UNIT_VTABLE(u)->notify_message(u, pid, tags, fds);
-        else if (_unlikely_(log_get_max_level() >= LOG_DEBUG)) {
+                /* Most messages carry a single assignment, such as WATCHDOG=1, don't bother splitting those */
+                if (!isempty(buf) && !strpbrk(buf, "\n\r"))
+                        UNIT_VTABLE(u)->notify_message(u, pid, single, fds);
+                else {
+                        tags = strv_split(buf, "\n\r");
+                        if (!tags) {
+                                log_oom();
+                                return;
+                        }
+
+                        UNIT_VTABLE(u)->notify_message(u, pid, tags, fds);
+                }
+        } else if (_unlikely_(log_get_max_level() >= LOG_DEBUG)) {
                 _cleanup_free_ char *x = NULL, *y = NULL;
 
                 x = cescape(buf);
@@ -1822,10 +2259,9 @@ static void manager_invoke_notify_message(Manager *m, Unit *u, pid_t pid, const
         }
 }
 
-static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+static int manager_receive_notify_message(Manager *m) {
 
         _cleanup_fdset_free_ FDSet *fds = NULL;
-        Manager *m = userdata;
         char buf[NOTIFY_BUFFER_MAX+1];
         struct iovec iovec = {
                 .iov_base = buf,
@@ -1851,17 +2287,11 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         ssize_t n;
 
         assert(m);
-        assert(m->notify_fd == fd);
-
-        if (revents != EPOLLIN) {
-                log_warning("Got unexpected poll event for notify fd.");
-                return 0;
-        }
 
         n = recvmsg(m->notify_fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC);
         if (n < 0) {
                 if (IN_SET(errno, EAGAIN, EINTR))
-                        return 0; /* Spurious wakeup, try again */
+                        return 0; /* Nothing (more) to read, try again */
 
                 /* If this is any other, real error, then let's stop processing this socket. This of course means we
                  * won't take notification messages anymore, but that's still better than busy looping around this:
@@ -1890,25 +2320,25 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 if (r < 0) {
                         close_many(fd_array, n_fds);
                         log_oom();
-                        return 0;
+                        return 1;
                 }
         }
 
         if (!ucred || ucred->pid <= 0) {
                 log_warning("Received notify message without valid credentials. Ignoring.");
-                return 0;
+                return 1;
         }
 
         if ((size_t) n >= sizeof(buf) || (msghdr.msg_flags & MSG_TRUNC)) {
                 log_warning("Received notify message exceeded maximum size. Ignoring.");
-                return 0;
+                return 1;
         }
 
         /* As extra safety check, let's make sure the string we get doesn't contain embedded NUL bytes. We permit one
          * trailing NUL byte in the message, but don't expect it. */
         if (n > 1 && memchr(buf, 0, n-1)) {
                 log_warning("Received notify message with embedded NUL bytes. Ignoring.");
-                return 0;
+                return 1;
         }
 
         /* Make sure it's NUL-terminated. */
@@ -1934,6 +2364,30 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         if (fdset_size(fds) > 0)
                 log_warning("Got extra auxiliary fds with notification message, closing them.");
 
+        return 1;
+}
+
+static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+        unsigned i;
+        int r;
+
+        assert(m);
+        assert(m->notify_fd == fd);
+
+        if (revents != EPOLLIN) {
+                log_warning("Got unexpected poll event for notify fd.");
+                return 0;
+        }
+
+        /* Process a couple of queued messages per wakeup, rather than going through the event loop for each
+         * one, but not so many that other event sources starve while a lot of services are chatty. */
+        for (i = 0; i < NOTIFY_MESSAGES_PER_ITERATION; i++) {
+                r = manager_receive_notify_message(m);
+                if (r <= 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -2154,6 +2608,8 @@ static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t
 
                         manager_dump_units(m, f, "\t");
                         manager_dump_jobs(m, f, "\t");
+                        manager_dump_memory_usage(m, f, "\t");
+                        manager_dump_gc(m, f, "\t");
 
                         r = fflush_and_check(f);
                         if (r < 0) {
@@ -2286,6 +2742,9 @@ static int manager_dispatch_time_change_fd(sd_event_source *source, int fd, uint
 
         manager_setup_time_change(m);
 
+        /* Don't trust calendar computations from before the change */
+        m->timer_calendar_cache = hashmap_free_free_free(m->timer_calendar_cache);
+
         HASHMAP_FOREACH(u, m->units, i)
                 if (UNIT_VTABLE(u)->time_change)
                         UNIT_VTABLE(u)->time_change(u);
@@ -2332,8 +2791,9 @@ int manager_loop(Manager *m) {
         assert(m);
         m->exit_code = MANAGER_OK;
 
-        /* Release the path cache */
-        m->unit_path_cache = set_free_free(m->unit_path_cache);
+        /* Release the path cache. The per-directory listings it was built from are kept, so that the next
+         * reload doesn't have to read directories again that haven't changed. */
+        m->unit_path_cache = set_free(m->unit_path_cache);
 
         manager_check_finished(m);
 
@@ -2381,6 +2841,10 @@ int manager_loop(Manager *m) {
                 } else
                         wait_usec = USEC_INFINITY;
 
+                /* Retry log messages that queued up while the journal was busy now and then */
+                if (log_flush_async() > 0)
+                        wait_usec = MIN(wait_usec, 100 * USEC_PER_MSEC);
+
                 r = sd_event_run(m->event, wait_usec);
                 if (r < 0)
                         return log_error_errno(r, "Failed to run event loop: %m");
@@ -2575,6 +3039,7 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
         m->n_reloading++;
 
         fprintf(f, "current-job-id=%"PRIu32"\n", m->current_job_id);
+        fprintf(f, "unit-change-generation=%"PRIu64"\n", m->unit_change_generation);
         fprintf(f, "taint-usr=%s\n", yes_no(m->taint_usr));
         fprintf(f, "n-installed-jobs=%u\n", m->n_installed_jobs);
         fprintf(f, "n-failed-jobs=%u\n", m->n_failed_jobs);
@@ -2672,6 +3137,16 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
         return 0;
 }
 
+static void manager_bump_unit_change_generations(Manager *m) {
+        Iterator i;
+        Unit *u;
+
+        assert(m);
+
+        HASHMAP_FOREACH(u, m->units, i)
+                u->change_generation = ++m->unit_change_generation;
+}
+
 int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
         int r = 0;
 
@@ -2709,6 +3184,14 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                         else
                                 m->current_job_id = MAX(m->current_job_id, id);
 
+                } else if ((val = startswith(l, "unit-change-generation="))) {
+                        uint64_t g;
+
+                        if (safe_atou64(val, &g) < 0)
+                                log_notice("Failed to parse unit change generation %s", val);
+                        else
+                                m->unit_change_generation = MAX(m->unit_change_generation, g);
+
                 } else if ((val = startswith(l, "n-installed-jobs="))) {
                         uint32_t n;
 
@@ -2826,6 +3309,10 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                         log_notice("Unknown serialization item '%s'", l);
         }
 
+        /* All units have been loaded anew, make sure clients polling for changes notice that. The generations
+         * they were assigned while loading are lower than the deserialized counter. */
+        manager_bump_unit_change_generations(m);
+
         for (;;) {
                 Unit *u;
                 char name[UNIT_NAME_MAX+2];
@@ -31,6 +31,8 @@
 #include "hashmap.h"
 #include "ip-address-access.h"
 #include "list.h"
+#include "mempool.h"
+#include "prioq.h"
 #include "ratelimit.h"
 
 /* Enforce upper limit how many names we allow */
@@ -101,8 +103,8 @@ struct Manager {
         /* Units that need to be loaded */
         LIST_HEAD(Unit, load_queue); /* this is actually more a stack than a queue, but uh. */
 
-        /* Jobs that need to be run */
-        LIST_HEAD(Job, run_queue);   /* more a stack than a queue, too */
+        /* Jobs that need to be run, those blocking the most other jobs first */
+        Prioq *run_queue;
 
         /* Units and jobs that have not yet been announced via
          * D-Bus. When something about a job changes it is added here
@@ -164,6 +166,7 @@ struct Manager {
         UnitFileScope unit_file_scope;
         LookupPaths lookup_paths;
         Set *unit_path_cache;
+        Hashmap *unit_path_cache_dirs;
 
         char **environment;
 
@@ -194,6 +197,8 @@ struct Manager {
         /* Data specific to the mount subsystem */
         struct libmnt_monitor *mount_monitor;
         sd_event_source *mount_event_source;
+        sd_event_source *mount_rescan_event_source;
+        RateLimit mount_rescan_ratelimit;
 
         /* Data specific to the swap filesystem */
         FILE *proc_swaps;
@@ -203,6 +208,7 @@ struct Manager {
         /* Data specific to the D-Bus subsystem */
         sd_bus *api_bus, *system_bus;
         Set *private_buses;
+        Set *congested_buses;
         int private_listen_fd;
         sd_event_source *private_listen_event_source;
 
@@ -224,6 +230,9 @@ struct Manager {
         uint32_t current_job_id;
         uint32_t default_unit_job_id;
 
+        /* Bumped whenever the state of some unit changes, so that clients can ask for what changed since */
+        uint64_t unit_change_generation;
+
         /* Data specific to the Automount subsystem */
         int dev_autofs_fd;
 
@@ -246,6 +255,17 @@ struct Manager {
 
         int gc_marker;
 
+        /* Garbage collection statistics, for the state dump */
+        unsigned n_gc_rounds;
+        uint64_t n_gc_units_swept;
+        uint64_t n_gc_units_collected;
+        usec_t gc_usec;
+
+        /* Units are allocated from one pool per object size, jobs from their own pool, so that the many
+         * objects of the same size stay packed together. The pools are trimmed after unit cleanup. */
+        struct mempool unit_pools[_UNIT_TYPE_MAX];
+        struct mempool job_pool;
+
         /* Flags */
         ManagerExitCode exit_code:5;
 
@@ -295,6 +315,9 @@ struct Manager {
         unsigned n_on_console;
         unsigned jobs_in_progress_iteration;
 
+        /* Don't run more than this many jobs at the same time, 0 if unlimited */
+        unsigned job_concurrency_max;
+
         /* Do we have any outstanding password prompts? */
         int have_ask_password;
         int ask_password_inotify_fd;
@@ -312,6 +335,10 @@ struct Manager {
          * value where Unit objects are contained. */
         Hashmap *units_requiring_mounts_for;
 
+        /* Maps the string form of calendar specifications used by timer units to the last elapse computed
+         * for them, see timer.c */
+        Hashmap *timer_calendar_cache;
+
         /* Used for processing polkit authorization responses */
         Hashmap *polkit_registry;
 
@@ -365,6 +392,8 @@ int manager_propagate_reload(Manager *m, Unit *unit, JobMode mode, sd_bus_error
 
 void manager_dump_units(Manager *s, FILE *f, const char *prefix);
 void manager_dump_jobs(Manager *s, FILE *f, const char *prefix);
+void manager_dump_memory_usage(Manager *s, FILE *f, const char *prefix);
+void manager_dump_gc(Manager *s, FILE *f, const char *prefix);
 
 void manager_clear_jobs(Manager *m);
 
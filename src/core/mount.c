@@ -48,6 +48,10 @@
 
 #define RETRY_UMOUNT_MAX 32
 
+/* Mount table changes beyond this rate are coalesced into one rescan per interval */
+#define MOUNT_RESCAN_INTERVAL_USEC (1 * USEC_PER_SEC)
+#define MOUNT_RESCAN_BURST 5
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct libmnt_table*, mnt_free_table);
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct libmnt_iter*, mnt_free_iter);
 
@@ -67,6 +71,8 @@ static const UnitActiveState state_translation_table[_MOUNT_STATE_MAX] = {
 
 static int mount_dispatch_timer(sd_event_source *source, usec_t usec, void *userdata);
 static int mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata);
+static int mount_dispatch_rescan(sd_event_source *source, usec_t usec, void *userdata);
+static int mount_flush_pending_rescan(Manager *m);
 
 static bool MOUNT_STATE_WITH_PROCESS(MountState state) {
         return IN_SET(state,
@@ -1268,6 +1274,10 @@ static void mount_sigchld_event(Unit *u, pid_t pid, int code, int status) {
         log_unit_full(u, f == MOUNT_SUCCESS ? LOG_DEBUG : LOG_NOTICE, 0,
                       "Mount process exited, code=%s status=%i", sigchld_code_to_string(code), status);
 
+        /* The checks below rely on /proc/self/mountinfo having been processed before the SIGCHLD. If the rescan
+         * was delayed by the rate limit, the io event priority logic doesn't cover us, hence do it right now. */
+        (void) mount_flush_pending_rescan(u->manager);
+
         /* Note that mount(8) returning and the kernel sending us a mount table change event might happen
          * out-of-order. If an operation succeed we assume the kernel will follow soon too and already change into the
          * resulting state.  If it fails we check if the kernel still knows about the mount. and change state
@@ -1641,6 +1651,7 @@ static void mount_shutdown(Manager *m) {
         assert(m);
 
         m->mount_event_source = sd_event_source_unref(m->mount_event_source);
+        m->mount_rescan_event_source = sd_event_source_unref(m->mount_rescan_event_source);
 
         mnt_unref_monitor(m->mount_monitor);
         m->mount_monitor = NULL;
@@ -1747,6 +1758,10 @@ static void mount_enumerate(Manager *m) {
                 }
 
                 (void) sd_event_source_set_description(m->mount_event_source, "mount-monitor-dispatch");
+
+                /* Every rescan re-parses the whole mount table, which is expensive on systems with a lot of
+                 * mounts and a lot of mount activity. Hence coalesce events beyond this rate. */
+                RATELIMIT_INIT(m->mount_rescan_ratelimit, MOUNT_RESCAN_INTERVAL_USEC, MOUNT_RESCAN_BURST);
         }
 
         r = mount_load_proc_self_mountinfo(m, false);
@@ -1759,40 +1774,45 @@ fail:
         mount_shutdown(m);
 }
 
-static int mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-        _cleanup_set_free_ Set *around = NULL, *gone = NULL;
-        Manager *m = userdata;
-        const char *what;
-        Iterator i;
-        Unit *u;
+static int mount_schedule_rescan(Manager *m) {
+        usec_t usec;
         int r;
 
         assert(m);
-        assert(revents & EPOLLIN);
 
-        if (fd == mnt_monitor_get_fd(m->mount_monitor)) {
-                bool rescan = false;
+        /* Rescan once the current rate limit interval is over */
+        usec = usec_add(m->mount_rescan_ratelimit.begin, m->mount_rescan_ratelimit.interval);
 
-                /* Drain all events and verify that the event is valid.
-                 *
-                 * Note that libmount also monitors /run/mount mkdir if the
-                 * directory does not exist yet. The mkdir may generate event
-                 * which is irrelevant for us.
-                 *
-                 * error: r < 0; valid: r == 0, false positive: rc == 1 */
-                do {
-                        r = mnt_monitor_next_change(m->mount_monitor, NULL, NULL);
-                        if (r == 0)
-                                rescan = true;
-                        else if (r < 0)
-                                return log_error_errno(r, "Failed to drain libmount events");
-                } while (r == 0);
+        if (m->mount_rescan_event_source) {
+                r = sd_event_source_set_time(m->mount_rescan_event_source, usec);
+                if (r < 0)
+                        return r;
 
-                log_debug("libmount event [rescan: %s]", yes_no(rescan));
-                if (!rescan)
-                        return 0;
+                return sd_event_source_set_enabled(m->mount_rescan_event_source, SD_EVENT_ONESHOT);
         }
 
+        r = sd_event_add_time(m->event, &m->mount_rescan_event_source, CLOCK_MONOTONIC, usec, 0, mount_dispatch_rescan, m);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_priority(m->mount_rescan_event_source, -10);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(m->mount_rescan_event_source, "mount-monitor-rescan");
+
+        return 0;
+}
+
+static int mount_process_proc_self_mountinfo(Manager *m) {
+        _cleanup_set_free_ Set *around = NULL, *gone = NULL;
+        const char *what;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(m);
+
         r = mount_load_proc_self_mountinfo(m, true);
         if (r < 0) {
                 /* Reset flags, just in case, for later calls */
@@ -1895,6 +1915,92 @@ static int mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents,
         return 0;
 }
 
+static int mount_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+        int r;
+
+        assert(m);
+        assert(revents & EPOLLIN);
+
+        if (fd == mnt_monitor_get_fd(m->mount_monitor)) {
+                bool rescan = false;
+
+                /* Drain all events and verify that the event is valid.
+                 *
+                 * Note that libmount also monitors /run/mount mkdir if the
+                 * directory does not exist yet. The mkdir may generate event
+                 * which is irrelevant for us.
+                 *
+                 * error: r < 0; valid: r == 0, false positive: rc == 1 */
+                do {
+                        r = mnt_monitor_next_change(m->mount_monitor, NULL, NULL);
+                        if (r == 0)
+                                rescan = true;
+                        else if (r < 0)
+                                return log_error_errno(r, "Failed to drain libmount events");
+                } while (r == 0);
+
+                log_debug("libmount event [rescan: %s]", yes_no(rescan));
+                if (!rescan)
+                        return 0;
+        }
+
+        /* If a rescan is already pending, it will pick up this change too */
+        if (m->mount_rescan_event_source) {
+                int enabled;
+
+                r = sd_event_source_get_enabled(m->mount_rescan_event_source, &enabled);
+                if (r >= 0 && enabled != SD_EVENT_OFF)
+                        return 0;
+        }
+
+        if (!ratelimit_test(&m->mount_rescan_ratelimit)) {
+                log_debug("Too many mount table changes, delaying rescan.");
+
+                r = mount_schedule_rescan(m);
+                if (r >= 0)
+                        return 0;
+
+                log_warning_errno(r, "Failed to schedule delayed rescan of mount table, rescanning immediately: %m");
+        }
+
+        return mount_process_proc_self_mountinfo(m);
+}
+
+static int mount_dispatch_rescan(sd_event_source *source, usec_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        /* Count this rescan against the new interval, too */
+        (void) ratelimit_test(&m->mount_rescan_ratelimit);
+
+        return mount_process_proc_self_mountinfo(m);
+}
+
+static int mount_flush_pending_rescan(Manager *m) {
+        int enabled, r;
+
+        assert(m);
+
+        if (!m->mount_rescan_event_source)
+                return 0;
+
+        r = sd_event_source_get_enabled(m->mount_rescan_event_source, &enabled);
+        if (r < 0)
+                return r;
+        if (enabled == SD_EVENT_OFF)
+                return 0;
+
+        r = sd_event_source_set_enabled(m->mount_rescan_event_source, SD_EVENT_OFF);
+        if (r < 0)
+                return r;
+
+        log_debug("Mount process exited while a mount table rescan was pending, rescanning now.");
+
+        return mount_process_proc_self_mountinfo(m);
+}
+
 static void mount_reset_failed(Unit *u) {
         Mount *m = MOUNT(u);
 
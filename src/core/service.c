@@ -2178,6 +2178,7 @@ static int service_start(Unit *u) {
         s->status_errno = 0;
 
         s->notify_state = NOTIFY_UNKNOWN;
+        s->ready_timestamp = DUAL_TIMESTAMP_NULL;
 
         s->watchdog_override_enable = false;
         s->watchdog_override_usec = 0;
@@ -2394,6 +2395,7 @@ static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
                 }
         }
 
+        dual_timestamp_serialize(f, "ready-timestamp", &s->ready_timestamp);
         dual_timestamp_serialize(f, "watchdog-timestamp", &s->watchdog_timestamp);
 
         unit_serialize_item(u, f, "forbid-restart", yes_no(s->forbid_restart));
@@ -2656,6 +2658,8 @@ static int service_deserialize_item(Unit *u, const char *key, const char *value,
                 dual_timestamp_deserialize(value, &s->main_exec_status.start_timestamp);
         else if (streq(key, "main-exec-status-exit"))
                 dual_timestamp_deserialize(value, &s->main_exec_status.exit_timestamp);
+        else if (streq(key, "ready-timestamp"))
+                dual_timestamp_deserialize(value, &s->ready_timestamp);
         else if (streq(key, "watchdog-timestamp"))
                 dual_timestamp_deserialize(value, &s->watchdog_timestamp);
         else if (streq(key, "forbid-restart")) {
@@ -3345,14 +3349,11 @@ static int service_dispatch_watchdog(sd_event_source *source, usec_t usec, void
 
 static void service_notify_message(Unit *u, pid_t pid, char **tags, FDSet *fds) {
         Service *s = SERVICE(u);
-        _cleanup_free_ char *cc = NULL;
         bool notify_dbus = false;
         const char *e;
 
         assert(u);
 
-        cc = strv_join(tags, ", ");
-
         if (s->notify_access == NOTIFY_NONE) {
                 log_unit_warning(u, "Got notification message from PID "PID_FMT", but reception is disabled.", pid);
                 return;
@@ -3373,8 +3374,12 @@ static void service_notify_message(Unit *u, pid_t pid, char **tags, FDSet *fds)
                 else
                         log_unit_warning(u, "Got notification message from PID "PID_FMT", but reception only permitted for main PID and control PID which are currently not known", pid);
                 return;
-        } else
+        } else if (_unlikely_(log_get_max_level() >= LOG_DEBUG)) {
+                _cleanup_free_ char *cc = NULL;
+
+                cc = strv_join(tags, ", ");
                 log_unit_debug(u, "Got notification message from PID "PID_FMT" (%s)", pid, isempty(cc) ? "n/a" : cc);
+        }
 
         /* Interpret MAINPID= */
         e = strv_find_startswith(tags, "MAINPID=");
@@ -3410,8 +3415,18 @@ static void service_notify_message(Unit *u, pid_t pid, char **tags, FDSet *fds)
 
                 /* Type=notify services inform us about completed
                  * initialization with READY=1 */
-                if (s->type == SERVICE_NOTIFY && s->state == SERVICE_START)
+                if (s->type == SERVICE_NOTIFY && s->state == SERVICE_START) {
+                        dual_timestamp_get(&s->ready_timestamp);
+
+                        if (dual_timestamp_is_set(&s->main_exec_status.start_timestamp)) {
+                                char t[FORMAT_TIMESPAN_MAX];
+
+                                log_unit_debug(u, "Main process reported readiness after %s.",
+                                               format_timespan(t, sizeof(t), s->ready_timestamp.monotonic - s->main_exec_status.start_timestamp.monotonic, USEC_PER_MSEC));
+                        }
+
                         service_enter_start_post(s);
+                }
 
                 /* Sending READY=1 while we are reloading informs us
                  * that the reloading is complete */
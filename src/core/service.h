@@ -113,6 +113,9 @@ struct Service {
         usec_t timeout_stop_usec;
         usec_t runtime_max_usec;
 
+        /* When a Type=notify service sent READY=1 */
+        dual_timestamp ready_timestamp;
+
         dual_timestamp watchdog_timestamp;
         usec_t watchdog_usec;
         usec_t watchdog_override_usec;
@@ -1553,7 +1553,7 @@ shortcut:
 
 static int socket_open_fds(Socket *s) {
         _cleanup_(mac_selinux_freep) char *label = NULL;
-        bool know_label = false;
+        bool know_label = false, need_symlink = false;
         SocketPort *p;
         int r;
 
@@ -1600,7 +1600,7 @@ static int socket_open_fds(Socket *s) {
 
                         p->fd = r;
                         socket_apply_socket_options(s, p->fd);
-                        socket_symlink(s);
+                        need_symlink = true;
                         break;
 
                 case SOCKET_SPECIAL:
@@ -1624,7 +1624,7 @@ static int socket_open_fds(Socket *s) {
                         }
 
                         socket_apply_fifo_options(s, p->fd);
-                        socket_symlink(s);
+                        need_symlink = true;
                         break;
 
                 case SOCKET_MQUEUE:
@@ -1666,6 +1666,10 @@ static int socket_open_fds(Socket *s) {
                 }
         }
 
+        /* Create the symlinks only once all ports are open, instead of once per port */
+        if (need_symlink)
+                (void) socket_symlink(s);
+
         return 0;
 
 rollback:
@@ -2287,7 +2291,7 @@ static void socket_enter_running(Socket *s, int cfd) {
 
                 socket_set_state(s, SOCKET_RUNNING);
         } else {
-                _cleanup_free_ char *prefix = NULL, *instance = NULL, *name = NULL;
+                _cleanup_free_ char *instance = NULL, *name = NULL;
                 _cleanup_(socket_peer_unrefp) SocketPeer *p = NULL;
                 Service *service;
 
@@ -2332,11 +2336,9 @@ static void socket_enter_running(Socket *s, int cfd) {
                         return;
                 }
 
-                r = unit_name_to_prefix(UNIT(s)->id, &prefix);
-                if (r < 0)
-                        goto fail;
-
-                r = unit_name_build(prefix, instance, ".service", &name);
+                /* The service was instantiated as "<prefix>@<n>.service" already, only swap in the real
+                 * instance name */
+                r = unit_name_replace_instance(UNIT_DEREF(s->service)->id, instance, &name);
                 if (r < 0)
                         goto fail;
 
@@ -511,9 +511,19 @@ static void swap_set_state(Swap *s, SwapState state) {
            now. This is necessary, since swap_start() refuses
            operation with EAGAIN if there's already another job for
            the same device node queued. */
-        LIST_FOREACH_OTHERS(same_devnode, other, s)
-                if (UNIT(other)->job)
-                        job_add_to_run_queue(UNIT(other)->job);
+        LIST_FOREACH_OTHERS(same_devnode, other, s) {
+                Job *j = UNIT(other)->job;
+                int r;
+
+                if (!j)
+                        continue;
+
+                r = job_add_to_run_queue(j);
+                if (r < 0) {
+                        log_unit_warning_errno(UNIT(other), r, "Failed to queue job %s/%s, failing it: %m", UNIT(other)->id, job_type_to_string(j->type));
+                        job_finish_and_invalidate(j, JOB_FAILED, true, false);
+                }
+        }
 }
 
 static int swap_coldplug(Unit *u) {
@@ -65,6 +65,7 @@ void timer_free_values(Timer *t) {
         while ((v = t->values)) {
                 LIST_REMOVE(value, t->values, v);
                 calendar_spec_free(v->calendar_spec);
+                free(v->calendar_key);
                 free(v);
         }
 }
@@ -341,6 +342,80 @@ static void add_random(Timer *t, usec_t *v) {
         log_unit_debug(UNIT(t), "Adding %s random time.", format_timespan(s, sizeof(s), add, 0));
 }
 
+typedef struct TimerCalendarCacheEntry {
+        usec_t base;
+        usec_t next;
+} TimerCalendarCacheEntry;
+
+static int timer_calendar_next_usec(Timer *t, TimerValue *v, usec_t base, usec_t *ret) {
+        _cleanup_free_ TimerCalendarCacheEntry *n = NULL;
+        _cleanup_free_ char *k = NULL;
+        TimerCalendarCacheEntry *e;
+        Manager *m;
+        usec_t next;
+        int r;
+
+        assert(t);
+        assert(v);
+        assert(v->calendar_spec);
+        assert(ret);
+
+        /* Evaluating a calendar specification is not cheap, and even forks if a timezone is specified. But lots of
+         * timer units usually share the same few specifications, and their bases are close together. The next
+         * elapse is the first match after the base, hence if we computed it for a base no later than ours, and it
+         * lies after ours, it is the answer for us too. */
+
+        m = UNIT(t)->manager;
+
+        /* The string form doesn't always tell whether daylight saving time was explicitly chosen, hence don't
+         * share results for those rare specifications */
+        if (!v->calendar_key && v->calendar_spec->dst < 0)
+                (void) calendar_spec_to_string(v->calendar_spec, &v->calendar_key);
+
+        e = v->calendar_key ? hashmap_get(m->timer_calendar_cache, v->calendar_key) : NULL;
+        if (e && e->base <= base && base < e->next) {
+                *ret = e->next;
+                return 0;
+        }
+
+        r = calendar_spec_next_usec(v->calendar_spec, base, &next);
+        if (r < 0)
+                return r;
+
+        *ret = next;
+
+        /* Failing to cache the result is not a problem, we'll simply compute it again */
+        if (!v->calendar_key)
+                return 0;
+
+        if (e) {
+                e->base = base;
+                e->next = next;
+                return 0;
+        }
+
+        if (hashmap_ensure_allocated(&m->timer_calendar_cache, &string_hash_ops) < 0)
+                return 0;
+
+        n = new(TimerCalendarCacheEntry, 1);
+        if (!n)
+                return 0;
+
+        n->base = base;
+        n->next = next;
+
+        k = strdup(v->calendar_key);
+        if (!k)
+                return 0;
+
+        if (hashmap_put(m->timer_calendar_cache, k, n) >= 0) {
+                k = NULL;
+                n = NULL;
+        }
+
+        return 0;
+}
+
 static void timer_enter_waiting(Timer *t, bool initial) {
         bool found_monotonic = false, found_realtime = false;
         bool leave_around = false;
@@ -377,7 +452,7 @@ static void timer_enter_waiting(Timer *t, bool initial) {
 
                         b = t->last_trigger.realtime > 0 ? t->last_trigger.realtime : ts.realtime;
 
-                        r = calendar_spec_next_usec(v->calendar_spec, b, &v->next_elapse);
+                        r = timer_calendar_next_usec(t, v, b, &v->next_elapse);
                         if (r < 0)
                                 continue;
 
@@ -40,6 +40,7 @@ typedef struct TimerValue {
 
         usec_t value; /* only for monotonic events */
         CalendarSpec *calendar_spec; /* only for calendar events */
+        char *calendar_key; /* string form of calendar_spec, generated when needed */
         usec_t next_elapse;
 
         LIST_FIELDS(struct TimerValue, value);
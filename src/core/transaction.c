@@ -305,8 +305,8 @@ static void transaction_drop_redundant(Transaction *tr) {
 
         assert(tr);
 
-rescan:
         HASHMAP_FOREACH(j, tr->jobs, i) {
+                Unit *u = j->unit;
                 Job *k;
 
                 LIST_FOREACH(transaction, k, j) {
@@ -317,9 +317,13 @@ rescan:
                                 goto next_unit;
                 }
 
+                /* Deleting a job without its dependencies doesn't change whether the jobs of any other
+                 * unit are redundant, hence there's no need to start over after each deletion. Only
+                 * the entry we are looking at goes away, which the iterator is fine with. */
+
                 /* log_debug("Found redundant job %s/%s, dropping.", j->unit->id, job_type_to_string(j->type)); */
-                transaction_delete_job(tr, j, false);
-                goto rescan;
+                while ((k = hashmap_get(tr->jobs, u)))
+                        transaction_delete_job(tr, k, false);
         next_unit:;
         }
 }
@@ -509,19 +513,29 @@ static void transaction_collect_garbage(Transaction *tr) {
 
         /* Drop jobs that are not required by any other job */
 
-rescan:
-        HASHMAP_FOREACH(j, tr->jobs, i) {
-                if (tr->anchor_job == j || j->object_list) {
-                        /* log_debug("Keeping job %s/%s because of %s/%s", */
-                        /*           j->unit->id, job_type_to_string(j->type), */
-                        /*           j->object_list->subject ? j->object_list->subject->unit->id : "root", */
-                        /*           j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root"); */
-                        continue;
+        /* Since nothing requires the jobs we delete here, deleting them never takes other jobs with
+         * them, and the iterator can simply continue. But each deletion might leave jobs unrequired
+         * that we already looked at, hence make more passes until nothing changes anymore. */
+
+        for (;;) {
+                bool again = false;
+
+                HASHMAP_FOREACH(j, tr->jobs, i) {
+                        if (tr->anchor_job == j || j->object_list) {
+                                /* log_debug("Keeping job %s/%s because of %s/%s", */
+                                /*           j->unit->id, job_type_to_string(j->type), */
+                                /*           j->object_list->subject ? j->object_list->subject->unit->id : "root", */
+                                /*           j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root"); */
+                                continue;
+                        }
+
+                        /* log_debug("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type)); */
+                        transaction_delete_job(tr, j, true);
+                        again = true;
                 }
 
-                /* log_debug("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type)); */
-                transaction_delete_job(tr, j, true);
-                goto rescan;
+                if (!again)
+                        break;
         }
 }
 
@@ -605,7 +619,7 @@ rescan:
 static int transaction_apply(Transaction *tr, Manager *m, JobMode mode) {
         Iterator i;
         Job *j;
-        int r;
+        int r, q = 0;
 
         /* Moves the transaction jobs to the set of active jobs */
 
@@ -655,13 +669,28 @@ static int transaction_apply(Transaction *tr, Manager *m, JobMode mode) {
                         j = installed_job;
                 }
 
-                job_add_to_run_queue(j);
+                r = job_add_to_run_queue(j);
+                if (r < 0) {
+                        log_unit_warning_errno(j->unit, r, "Failed to queue job %s/%s, failing it: %m", j->unit->id, job_type_to_string(j->type));
+
+                        /* The caller must not get to see the anchor job if it is gone already */
+                        if (tr->anchor_job == j) {
+                                tr->anchor_job = NULL;
+                                q = r;
+                        }
+
+                        /* Not invalidating recursively, so that none of the other jobs installed are
+                         * freed under us */
+                        job_finish_and_invalidate(j, JOB_FAILED, false, false);
+                        continue;
+                }
+
                 job_add_to_dbus_queue(j);
                 job_start_timer(j, false);
                 job_shutdown_magic(j);
         }
 
-        return 0;
+        return q;
 
 rollback:
 
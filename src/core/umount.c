@@ -43,8 +43,8 @@
 
 typedef struct MountPoint {
         char *path;
-        char *options;
-        char *type;
+        char *remount_options;
+        bool try_remount_ro;
         dev_t devnum;
         LIST_FIELDS(struct MountPoint, mount_point);
 } MountPoint;
@@ -56,6 +56,7 @@ static void mount_point_free(MountPoint **head, MountPoint *m) {
         LIST_REMOVE(mount_point, *head, m);
 
         free(m->path);
+        free(m->remount_options);
         free(m);
 }
 
@@ -132,10 +133,33 @@ static int mount_points_list_get(MountPoint **head) {
                 }
 
                 m->path = p;
-                m->options = options;
-                options = NULL;
-                m->type = type;
-                type = NULL;
+
+                /* If we are in a container, don't attempt to
+                   read-only mount anything as that brings no real
+                   benefits, but might confuse the host, as we remount
+                   the superblock here, not the bind mount.
+                   If the filesystem is a network fs, also skip the
+                   remount.  It brings no value (we cannot leave
+                   a "dirty fs") and could hang if the network is down.
+                   Virtual and memory backed file systems have nothing
+                   to flush, and file systems that are read-only
+                   already don't need it either. With thousands of
+                   mounts these remounts add up, hence figure this out
+                   once here rather than on every unmount attempt. */
+                m->try_remount_ro = detect_container() <= 0 &&
+                                    !fstype_is_network(type) &&
+                                    !fstype_is_api_vfs(type) &&
+                                    !fstype_is_ro(type) &&
+                                    !fstab_test_yes_no_option(options, "ro\0rw\0");
+
+                if (m->try_remount_ro) {
+                        /* MS_REMOUNT requires that the data parameter
+                         * should be the same from the original mount
+                         * except for the desired changes. Since we want
+                         * to remount read-only, we should filter out
+                         * rw (and ro too, because it confuses the kernel) */
+                        (void) fstab_filter_options(options, "rw\0ro\0", NULL, NULL, &m->remount_options);
+                }
 
                 LIST_PREPEND(mount_point, *head, m);
         }
@@ -389,23 +413,7 @@ static int mount_points_list_umount(MountPoint **head, bool *changed, bool log_e
 
         LIST_FOREACH_SAFE(mount_point, m, n, *head) {
 
-                /* If we are in a container, don't attempt to
-                   read-only mount anything as that brings no real
-                   benefits, but might confuse the host, as we remount
-                   the superblock here, not the bind mount.
-                   If the filesystem is a network fs, also skip the
-                   remount.  It brings no value (we cannot leave
-                   a "dirty fs") and could hang if the network is down.  */
-                if (detect_container() <= 0 &&
-                    !fstype_is_network(m->type)) {
-                        _cleanup_free_ char *options = NULL;
-                        /* MS_REMOUNT requires that the data parameter
-                         * should be the same from the original mount
-                         * except for the desired changes. Since we want
-                         * to remount read-only, we should filter out
-                         * rw (and ro too, because it confuses the kernel) */
-                        (void) fstab_filter_options(m->options, "rw\0ro\0", NULL, NULL, &options);
-
+                if (m->try_remount_ro) {
                         /* We always try to remount directories
                          * read-only first, before we go on and umount
                          * them.
@@ -422,8 +430,8 @@ static int mount_points_list_umount(MountPoint **head, bool *changed, bool log_e
                          * alias read-only we hence should be
                          * relatively safe regarding keeping dirty an fs
                          * we cannot otherwise see. */
-                        log_info("Remounting '%s' read-only with options '%s'.", m->path, options);
-                        if (mount(NULL, m->path, NULL, MS_REMOUNT|MS_RDONLY, options) < 0) {
+                        log_info("Remounting '%s' read-only with options '%s'.", m->path, m->remount_options);
+                        if (mount(NULL, m->path, NULL, MS_REMOUNT|MS_RDONLY, m->remount_options) < 0) {
                                 if (log_error)
                                         log_notice_errno(errno, "Failed to remount '%s' read-only: %m", m->path);
                                 if (nonunmountable_path(m->path))
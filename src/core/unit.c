@@ -78,19 +78,49 @@ const UnitVTable * const unit_vtable[_UNIT_TYPE_MAX] = {
 
 static void maybe_warn_about_dependency(Unit *u, const char *other, UnitDependency dependency);
 
+static struct mempool *unit_pool(Manager *m, size_t size) {
+        unsigned i;
+
+        /* There's one pool per distinct object size, hence there are never more than unit types */
+
+        for (i = 0; i < ELEMENTSOF(m->unit_pools); i++) {
+                struct mempool *mp = m->unit_pools + i;
+
+                if (mp->tile_size == size)
+                        return mp;
+
+                if (mp->tile_size == 0) {
+                        *mp = (struct mempool) {
+                                .tile_size = size,
+                                .at_least = 16,
+                        };
+                        return mp;
+                }
+        }
+
+        assert_not_reached("More unit object sizes than unit types?");
+}
+
 Unit *unit_new(Manager *m, size_t size) {
+        struct mempool *mp;
         Unit *u;
 
         assert(m);
         assert(size >= sizeof(Unit));
 
-        u = malloc0(size);
+        mp = unit_pool(m, size);
+
+        u = mempool_alloc0_tile(mp);
         if (!u)
                 return NULL;
 
+        u->mempool = mp;
+
         u->names = set_new(&string_hash_ops);
-        if (!u->names)
-                return mfree(u);
+        if (!u->names) {
+                mempool_free_tile(mp, u);
+                return NULL;
+        }
 
         u->manager = m;
         u->type = _UNIT_TYPE_INVALID;
@@ -104,6 +134,7 @@ Unit *unit_new(Manager *m, size_t size) {
         u->ref_uid = UID_INVALID;
         u->ref_gid = GID_INVALID;
         u->cpu_usage_last = NSEC_INFINITY;
+        u->change_generation = ++m->unit_change_generation;
 
         u->ip_accounting_ingress_map_fd = -1;
         u->ip_accounting_egress_map_fd = -1;
@@ -406,6 +437,10 @@ void unit_add_to_dbus_queue(Unit *u) {
         assert(u);
         assert(u->type != _UNIT_TYPE_INVALID);
 
+        /* Whatever makes us send out the change signals also counts as a change for clients polling with
+         * ListUnitsChangedSince() */
+        u->change_generation = ++u->manager->unit_change_generation;
+
         if (u->load_state == UNIT_STUB || u->in_dbus_queue)
                 return;
 
@@ -629,7 +664,7 @@ void unit_free(Unit *u) {
         bpf_program_unref(u->ip_bpf_ingress);
         bpf_program_unref(u->ip_bpf_egress);
 
-        free(u);
+        mempool_free_tile(u->mempool, u);
 }
 
 UnitActiveState unit_active_state(Unit *u) {
@@ -1015,6 +1050,9 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                 prefix, strna(u->cgroup_path),
                 prefix, yes_no(u->cgroup_realized));
 
+        if (u->n_notify_messages > 0)
+                fprintf(f, "%s\tNotify Messages: %" PRIu64 "\n", prefix, u->n_notify_messages);
+
         if (u->cgroup_realized_mask != 0) {
                 _cleanup_free_ char *s = NULL;
                 (void) cg_mask_to_string(u->cgroup_realized_mask, &s);
@@ -2186,13 +2224,6 @@ void unit_notify(Unit *u, UnitActiveState os, UnitActiveState ns, bool reload_su
         if (u->job) {
                 unexpected = false;
 
-                if (u->job->state == JOB_WAITING)
-
-                        /* So we reached a different state for this
-                         * job. Let's see if we can run it now if it
-                         * failed previously due to EAGAIN. */
-                        job_add_to_run_queue(u->job);
-
                 /* Let's check whether this state change constitutes a
                  * finished job, or maybe contradicts a running job and
                  * hence needs to invalidate jobs. */
@@ -2247,6 +2278,19 @@ void unit_notify(Unit *u, UnitActiveState os, UnitActiveState ns, bool reload_su
                         assert_not_reached("Job type unknown");
                 }
 
+                if (u->job && u->job->state == JOB_WAITING) {
+                        int r;
+
+                        /* So we reached a different state for this
+                         * job. Let's see if we can run it now if it
+                         * failed previously due to EAGAIN. */
+                        r = job_add_to_run_queue(u->job);
+                        if (r < 0) {
+                                log_unit_warning_errno(u, r, "Failed to queue job %s/%s, failing it: %m", u->id, job_type_to_string(u->job->type));
+                                job_finish_and_invalidate(u->job, JOB_FAILED, true, false);
+                        }
+                }
+
         } else
                 unexpected = true;
 
@@ -2949,16 +2993,21 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
 
         unit_serialize_item(u, f, "transient", yes_no(u->transient));
 
-        unit_serialize_item_format(u, f, "cpu-usage-base", "%" PRIu64, u->cpu_usage_base);
+        /* Most units on a big system are loaded but were never started, hence don't bother writing out the
+         * cgroup state of those, it matches what a freshly allocated unit is initialized to anyway. */
+        if (u->cpu_usage_base > 0)
+                unit_serialize_item_format(u, f, "cpu-usage-base", "%" PRIu64, u->cpu_usage_base);
         if (u->cpu_usage_last != NSEC_INFINITY)
                 unit_serialize_item_format(u, f, "cpu-usage-last", "%" PRIu64, u->cpu_usage_last);
 
         if (u->cgroup_path)
                 unit_serialize_item(u, f, "cgroup", u->cgroup_path);
-        unit_serialize_item(u, f, "cgroup-realized", yes_no(u->cgroup_realized));
+        if (u->cgroup_realized)
+                unit_serialize_item(u, f, "cgroup-realized", yes_no(u->cgroup_realized));
         (void) unit_serialize_cgroup_mask(f, "cgroup-realized-mask", u->cgroup_realized_mask);
         (void) unit_serialize_cgroup_mask(f, "cgroup-enabled-mask", u->cgroup_enabled_mask);
-        unit_serialize_item_format(u, f, "cgroup-bpf-realized", "%i", u->cgroup_bpf_state);
+        if (u->cgroup_bpf_state != UNIT_CGROUP_BPF_OFF)
+                unit_serialize_item_format(u, f, "cgroup-bpf-realized", "%i", u->cgroup_bpf_state);
 
         if (uid_is_valid(u->ref_uid))
                 unit_serialize_item_format(u, f, "ref-uid", UID_FMT, u->ref_uid);
@@ -3641,10 +3690,13 @@ int unit_kill_common(
                 _cleanup_set_free_ Set *pid_set = NULL;
                 int q;
 
-                /* Exclude the main/control pids from being killed via the cgroup */
-                pid_set = unit_pid_set(main_pid, control_pid);
-                if (!pid_set)
-                        return -ENOMEM;
+                /* Exclude the main/control pids from being killed via the cgroup. Don't bother if they got SIGKILL
+                 * above anyway, so that the kernel may kill the whole cgroup in one go. */
+                if (signo != SIGKILL) {
+                        pid_set = unit_pid_set(main_pid, control_pid);
+                        if (!pid_set)
+                                return -ENOMEM;
+                }
 
                 q = cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, signo, 0, pid_set, NULL, NULL);
                 if (q < 0 && q != -EAGAIN && q != -ESRCH && q != -ENOENT)
@@ -4168,16 +4220,28 @@ int unit_kill_context(
             (c->kill_mode == KILL_CONTROL_GROUP || (c->kill_mode == KILL_MIXED && k == KILL_KILL))) {
                 _cleanup_set_free_ Set *pid_set = NULL;
 
-                /* Exclude the main/control pids from being killed via the cgroup */
-                pid_set = unit_pid_set(main_pid, control_pid);
-                if (!pid_set)
-                        return -ENOMEM;
+                r = -EOPNOTSUPP;
 
-                r = cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path,
-                                      sig,
-                                      CGROUP_SIGCONT|CGROUP_IGNORE_SELF,
-                                      pid_set,
-                                      log_func, u);
+                /* The main/control pids got SIGKILL above already, hence nobody needs to be spared and the kernel may
+                 * kill the whole cgroup in one go. Instead of a line per process, log a summary then. */
+                if (sig == SIGKILL) {
+                        r = cg_kill_kernel_sigkill(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, CGROUP_IGNORE_SELF);
+                        if (r > 0 && log_func)
+                                log_unit_notice(u, "Killing remaining processes of control group %s with signal SIGKILL.", u->cgroup_path);
+                }
+
+                if (r == -EOPNOTSUPP) {
+                        /* Exclude the main/control pids from being killed via the cgroup */
+                        pid_set = unit_pid_set(main_pid, control_pid);
+                        if (!pid_set)
+                                return -ENOMEM;
+
+                        r = cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path,
+                                              sig,
+                                              CGROUP_SIGCONT|CGROUP_IGNORE_SELF,
+                                              pid_set,
+                                              log_func, u);
+                }
                 if (r < 0) {
                         if (r != -EAGAIN && r != -ESRCH && r != -ENOENT)
                                 log_unit_warning_errno(u, r, "Failed to kill control group %s, ignoring: %m", u->cgroup_path);
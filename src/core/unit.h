@@ -80,6 +80,7 @@ typedef enum UnitCGroupBPFState {
 
 struct Unit {
         Manager *manager;
+        struct mempool *mempool; /* the pool of Manager this object was allocated from */
 
         UnitType type;
         UnitLoadState load_state;
@@ -213,6 +214,10 @@ struct Unit {
         CGroupMask cgroup_members_mask;
         int cgroup_inotify_wd;
 
+        /* The values we last wrote to the cgroup's attribute files, and for which controllers */
+        Hashmap *cgroup_attributes;
+        CGroupMask cgroup_attributes_mask;
+
         /* IP BPF Firewalling/accounting */
         int ip_accounting_ingress_map_fd;
         int ip_accounting_egress_map_fd;
@@ -225,6 +230,10 @@ struct Unit {
         BPFProgram *ip_bpf_ingress;
         BPFProgram *ip_bpf_egress;
 
+        /* Hash of the configuration the above programs were compiled from, so that they can be reused */
+        uint64_t ip_bpf_hash;
+        bool ip_bpf_hash_valid;
+
         uint64_t ip_accounting_extra[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
 
         /* How to start OnFailure units */
@@ -262,6 +271,12 @@ struct Unit {
         /* Is this a unit that is always running and cannot be stopped? */
         bool perpetual;
 
+        /* The manager's unit_change_generation when this unit's state last changed */
+        uint64_t change_generation;
+
+        /* How many sd_notify() messages were delivered to this unit, to find the chatty ones */
+        uint64_t n_notify_messages;
+
         bool in_load_queue:1;
         bool in_dbus_queue:1;
         bool in_cleanup_queue:1;
@@ -271,6 +286,9 @@ struct Unit {
 
         bool sent_dbus_new_signal:1;
 
+        /* Set if the last change signal was skipped for some congested bus */
+        bool dbus_change_deferred:1;
+
         bool in_audit:1;
 
         bool cgroup_realized:1;
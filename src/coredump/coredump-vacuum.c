@@ -35,17 +35,31 @@
 #define DEFAULT_KEEP_FREE_UPPER (uint64_t) (4ULL*1024ULL*1024ULL*1024ULL) /* 4 GiB */
 #define DEFAULT_KEEP_FREE (uint64_t) (1024ULL*1024ULL)                    /* 1 MB */
 
+struct vacuum_file {
+        char *name;
+        usec_t mtime;
+        uint64_t size;
+};
+
 struct vacuum_candidate {
-        unsigned n_files;
-        char *oldest_file;
-        usec_t oldest_mtime;
+        struct vacuum_file *files;
+        size_t n_files, n_allocated;
+
+        /* The files are sorted by age once the directory has been read, this is the index of the oldest one we
+         * haven't removed yet */
+        size_t next;
 };
 
 static void vacuum_candidate_free(struct vacuum_candidate *c) {
+        size_t i;
+
         if (!c)
                 return;
 
-        free(c->oldest_file);
+        for (i = 0; i < c->n_files; i++)
+                free(c->files[i].name);
+
+        free(c->files);
         free(c);
 }
 
@@ -84,6 +98,17 @@ static int uid_from_file_name(const char *filename, uid_t *uid) {
         return parse_uid(u, uid);
 }
 
+static int vacuum_file_compare(const void *a, const void *b) {
+        const struct vacuum_file *x = a, *y = b;
+
+        if (x->mtime < y->mtime)
+                return -1;
+        if (x->mtime > y->mtime)
+                return 1;
+
+        return strcmp(x->name, y->name);
+}
+
 static bool vacuum_necessary(int fd, uint64_t sum, uint64_t keep_free, uint64_t max_use) {
         uint64_t fs_size = 0, fs_free = (uint64_t) -1;
         struct statvfs sv;
@@ -132,8 +157,13 @@ static bool vacuum_necessary(int fd, uint64_t sum, uint64_t keep_free, uint64_t
 }
 
 int coredump_vacuum(int exclude_fd, uint64_t keep_free, uint64_t max_use) {
+        _cleanup_(vacuum_candidate_hasmap_freep) Hashmap *h = NULL;
         _cleanup_closedir_ DIR *d = NULL;
+        struct vacuum_candidate *c;
         struct stat exclude_st;
+        struct dirent *de;
+        uint64_t sum = 0;
+        Iterator i;
         int r;
 
         if (keep_free == 0 && max_use == 0)
@@ -158,90 +188,87 @@ int coredump_vacuum(int exclude_fd, uint64_t keep_free, uint64_t max_use) {
                 return log_error_errno(errno, "Can't open coredump directory: %m");
         }
 
-        for (;;) {
-                _cleanup_(vacuum_candidate_hasmap_freep) Hashmap *h = NULL;
-                struct vacuum_candidate *worst = NULL;
-                struct dirent *de;
-                uint64_t sum = 0;
-
-                rewinddir(d);
-
-                FOREACH_DIRENT(de, d, goto fail) {
-                        struct vacuum_candidate *c;
-                        struct stat st;
-                        uid_t uid;
-                        usec_t t;
+        /* The directory is read only once. Afterwards we remove files and keep track of what is left in memory, so
+         * that deleting many old coredumps doesn't require rereading and restatting all of them each time. */
 
-                        r = uid_from_file_name(de->d_name, &uid);
-                        if (r < 0)
-                                continue;
+        FOREACH_DIRENT(de, d, goto fail) {
+                struct vacuum_candidate *c;
+                struct vacuum_file *f;
+                struct stat st;
+                uid_t uid;
 
-                        if (fstatat(dirfd(d), de->d_name, &st, AT_NO_AUTOMOUNT|AT_SYMLINK_NOFOLLOW) < 0) {
-                                if (errno == ENOENT)
-                                        continue;
+                r = uid_from_file_name(de->d_name, &uid);
+                if (r < 0)
+                        continue;
 
-                                log_warning_errno(errno, "Failed to stat /var/lib/systemd/coredump/%s: %m", de->d_name);
+                if (fstatat(dirfd(d), de->d_name, &st, AT_NO_AUTOMOUNT|AT_SYMLINK_NOFOLLOW) < 0) {
+                        if (errno == ENOENT)
                                 continue;
-                        }
 
-                        if (!S_ISREG(st.st_mode))
-                                continue;
+                        log_warning_errno(errno, "Failed to stat /var/lib/systemd/coredump/%s: %m", de->d_name);
+                        continue;
+                }
 
-                        if (exclude_fd >= 0 &&
-                            exclude_st.st_dev == st.st_dev &&
-                            exclude_st.st_ino == st.st_ino)
-                                continue;
+                if (!S_ISREG(st.st_mode))
+                        continue;
 
-                        r = hashmap_ensure_allocated(&h, NULL);
-                        if (r < 0)
-                                return log_oom();
+                if (exclude_fd >= 0 &&
+                    exclude_st.st_dev == st.st_dev &&
+                    exclude_st.st_ino == st.st_ino)
+                        continue;
 
-                        t = timespec_load(&st.st_mtim);
+                r = hashmap_ensure_allocated(&h, NULL);
+                if (r < 0)
+                        return log_oom();
 
-                        c = hashmap_get(h, UID_TO_PTR(uid));
-                        if (c) {
+                c = hashmap_get(h, UID_TO_PTR(uid));
+                if (!c) {
+                        _cleanup_(vacuum_candidate_freep) struct vacuum_candidate *n = NULL;
 
-                                if (t < c->oldest_mtime) {
-                                        char *n;
+                        n = new0(struct vacuum_candidate, 1);
+                        if (!n)
+                                return log_oom();
 
-                                        n = strdup(de->d_name);
-                                        if (!n)
-                                                return log_oom();
+                        r = hashmap_put(h, UID_TO_PTR(uid), n);
+                        if (r < 0)
+                                return log_oom();
 
-                                        free(c->oldest_file);
-                                        c->oldest_file = n;
-                                        c->oldest_mtime = t;
-                                }
+                        c = n;
+                        n = NULL;
+                }
 
-                        } else {
-                                _cleanup_(vacuum_candidate_freep) struct vacuum_candidate *n = NULL;
+                if (!GREEDY_REALLOC(c->files, c->n_allocated, c->n_files + 1))
+                        return log_oom();
 
-                                n = new0(struct vacuum_candidate, 1);
-                                if (!n)
-                                        return log_oom();
+                f = c->files + c->n_files;
+                f->name = strdup(de->d_name);
+                if (!f->name)
+                        return log_oom();
 
-                                n->oldest_file = strdup(de->d_name);
-                                if (!n->oldest_file)
-                                        return log_oom();
+                f->mtime = timespec_load(&st.st_mtim);
+                f->size = st.st_blocks * 512;
+                c->n_files++;
 
-                                n->oldest_mtime = t;
+                sum += f->size;
+        }
 
-                                r = hashmap_put(h, UID_TO_PTR(uid), n);
-                                if (r < 0)
-                                        return log_oom();
+        HASHMAP_FOREACH(c, h, i)
+                qsort_safe(c->files, c->n_files, sizeof(struct vacuum_file), vacuum_file_compare);
 
-                                c = n;
-                                n = NULL;
-                        }
+        for (;;) {
+                struct vacuum_candidate *worst = NULL;
+                struct vacuum_file *f;
 
-                        c->n_files++;
+                /* Pick the user with the most coredumps left, and among those the one with the oldest */
+                HASHMAP_FOREACH(c, h, i) {
+                        if (c->next >= c->n_files)
+                                continue;
 
                         if (!worst ||
-                            worst->n_files < c->n_files ||
-                            (worst->n_files == c->n_files && c->oldest_mtime < worst->oldest_mtime))
+                            worst->n_files - worst->next < c->n_files - c->next ||
+                            (worst->n_files - worst->next == c->n_files - c->next &&
+                             c->files[c->next].mtime < worst->files[worst->next].mtime))
                                 worst = c;
-
-                        sum += st.st_blocks * 512;
                 }
 
                 if (!worst)
@@ -251,14 +278,17 @@ int coredump_vacuum(int exclude_fd, uint64_t keep_free, uint64_t max_use) {
                 if (r <= 0)
                         return r;
 
-                if (unlinkat(dirfd(d), worst->oldest_file, 0) < 0) {
+                f = worst->files + worst->next++;
+                sum -= f->size;
+
+                if (unlinkat(dirfd(d), f->name, 0) < 0) {
 
                         if (errno == ENOENT)
                                 continue;
 
-                        return log_error_errno(errno, "Failed to remove file %s: %m", worst->oldest_file);
+                        return log_error_errno(errno, "Failed to remove file %s: %m", f->name);
                 } else
-                        log_info("Removed old coredump %s.", worst->oldest_file);
+                        log_info("Removed old coredump %s.", f->name);
         }
 
         return 0;
@@ -319,6 +319,22 @@ static int make_filename(const char *context[_CONTEXT_MAX], char **ret) {
         return 0;
 }
 
+static bool coredump_want_processing(void) {
+#ifdef HAVE_ELFUTILS
+        return arg_process_size_max > 0;
+#else
+        return false;
+#endif
+}
+
+static void log_coredump_truncated(uint64_t max_size) {
+        log_struct(LOG_INFO,
+                   LOG_MESSAGE("Core file was truncated to %" PRIu64 " bytes.", max_size),
+                   "SIZE_LIMIT=%" PRIu64, max_size,
+                   "MESSAGE_ID=" SD_MESSAGE_TRUNCATED_CORE_STR,
+                   NULL);
+}
+
 static int save_external_coredump(
                 const char *context[_CONTEXT_MAX],
                 int input_fd,
@@ -366,6 +382,54 @@ static int save_external_coredump(
 
         mkdir_p_label("/var/lib/systemd/coredump", 0755);
 
+#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+        /* If the uncompressed core is needed neither for the journal nor for generating a stack trace, compress it
+         * straight from the pipe, without writing out an uncompressed copy first. */
+        if (arg_compress && arg_storage == COREDUMP_STORAGE_EXTERNAL && !coredump_want_processing()) {
+                _cleanup_free_ char *fn_compressed = NULL, *tmp_compressed = NULL;
+                _cleanup_close_ int fd_compressed = -1;
+                uint64_t size = 0;
+
+                fn_compressed = strappend(fn, COMPRESSED_EXT);
+                if (!fn_compressed)
+                        return log_oom();
+
+                fd_compressed = open_tmpfile_linkable(fn_compressed, O_RDWR|O_CLOEXEC, &tmp_compressed);
+                if (fd_compressed < 0)
+                        return log_error_errno(fd_compressed, "Failed to create temporary file for coredump %s: %m", fn_compressed);
+
+                r = compress_stream(input_fd, fd_compressed, max_size, &size);
+                if (r < 0) {
+                        log_error_errno(r, "Cannot store coredump of %s (%s): %m", context[CONTEXT_PID], context[CONTEXT_COMM]);
+                        goto fail_streamed;
+                }
+
+                /* Like copy_bytes() below we cannot tell a core of exactly max_size apart from a truncated one */
+                *ret_truncated = size >= max_size;
+                if (*ret_truncated)
+                        log_coredump_truncated(max_size);
+
+                r = fix_permissions(fd_compressed, tmp_compressed, fn_compressed, context, uid);
+                if (r < 0)
+                        goto fail_streamed;
+
+                *ret_filename = fn_compressed;     /* compressed */
+                *ret_node_fd = fd_compressed;      /* compressed */
+                *ret_data_fd = -1;                 /* not needed */
+                *ret_size = size;                  /* uncompressed */
+
+                fn_compressed = NULL;
+                fd_compressed = -1;
+
+                return 0;
+
+        fail_streamed:
+                if (tmp_compressed)
+                        (void) unlink(tmp_compressed);
+                return r;
+        }
+#endif
+
         fd = open_tmpfile_linkable(fn, O_RDWR|O_CLOEXEC, &tmp);
         if (fd < 0)
                 return log_error_errno(fd, "Failed to create temporary file for coredump %s: %m", fn);
@@ -377,11 +441,7 @@ static int save_external_coredump(
         }
         *ret_truncated = r == 1;
         if (*ret_truncated)
-                log_struct(LOG_INFO,
-                           LOG_MESSAGE("Core file was truncated to %zu bytes.", max_size),
-                           "SIZE_LIMIT=%zu", max_size,
-                           "MESSAGE_ID=" SD_MESSAGE_TRUNCATED_CORE_STR,
-                           NULL);
+                log_coredump_truncated(max_size);
 
         if (fstat(fd, &st) < 0) {
                 log_error_errno(errno, "Failed to fstat core file %s: %m", coredump_tmpfile_name(tmp));
@@ -412,7 +472,7 @@ static int save_external_coredump(
                         goto uncompressed;
                 }
 
-                r = compress_stream(fd, fd_compressed, -1);
+                r = compress_stream(fd, fd_compressed, -1, NULL);
                 if (r < 0) {
                         log_error_errno(r, "Failed to compress %s: %m", coredump_tmpfile_name(tmp_compressed));
                         goto fail_compressed;
@@ -710,6 +770,31 @@ static bool is_pid1_crash(const char *context[_CONTEXT_MAX]) {
 
 #define SUBMIT_COREDUMP_FIELDS 4
 
+static void release_input_fd(int fd) {
+        int null_fd;
+
+        /* When we got the core from the kernel, it is on stdin. Don't leave fd 0 unused in that case, or the
+         * next file we open would become our stdin. Instead put /dev/null in its place, which closes the
+         * pipe just the same. */
+
+        if (fd != STDIN_FILENO) {
+                safe_close(fd);
+                return;
+        }
+
+        null_fd = open("/dev/null", O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (null_fd < 0) {
+                log_debug_errno(errno, "Failed to open /dev/null, keeping the core pipe open: %m");
+                return;
+        }
+
+        if (dup2(null_fd, STDIN_FILENO) < 0)
+                log_debug_errno(errno, "Failed to replace stdin, keeping the core pipe open: %m");
+
+        safe_close(null_fd);
+}
+
+/* Takes possession of input_fd, and releases it as soon as the core has been read from it */
 static int submit_coredump(
                 const char *context[_CONTEXT_MAX],
                 struct iovec *iovec,
@@ -736,6 +821,12 @@ static int submit_coredump(
         /* Always stream the coredump to disk, if that's possible */
         r = save_external_coredump(context, input_fd,
                                    &filename, &coredump_node_fd, &coredump_fd, &coredump_size, &truncated);
+
+        /* The core is stored away now (or we failed to), hence let go of the pipe right away. Until it is closed
+         * the kernel considers the process to still be dumping core, and we don't want the stack trace
+         * generation below to delay that. */
+        release_input_fd(input_fd);
+
         if (r < 0)
                 /* Skip whole core dumping part */
                 goto log;
@@ -767,7 +858,7 @@ static int submit_coredump(
 
 #ifdef HAVE_ELFUTILS
         /* Try to get a strack trace if we can */
-        if (coredump_size <= arg_process_size_max) {
+        if (coredump_fd >= 0 && coredump_size <= arg_process_size_max) {
                 _cleanup_free_ char *stacktrace = NULL;
 
                 r = coredump_make_stack_trace(coredump_fd, context[CONTEXT_EXE], &stacktrace);
@@ -988,6 +1079,7 @@ static int process_socket(int fd) {
                 context[CONTEXT_TIMESTAMP] = strndupa(context[CONTEXT_TIMESTAMP], k - 6);
 
         r = submit_coredump(context, iovec, n_allocated, n_iovec, coredump_fd);
+        coredump_fd = -1;
 
 finish:
         for (i = 0; i < n_iovec; i++)
@@ -30,10 +30,13 @@
 #include "device-util.h"
 #include "escape.h"
 #include "fileio.h"
+#include "lockfile-util.h"
 #include "log.h"
+#include "mkdir.h"
 #include "mount-util.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "util.h"
@@ -478,12 +481,49 @@ static int attach_tcrypt(
         return crypt_activate_by_volume_key(cd, name, NULL, 0, flags);
 }
 
+#define UNLOCK_SLOT_PATH_FMT "/run/systemd/cryptsetup/unlock-%u.lck"
+
+static int acquire_unlock_slot(LockFile *ret) {
+        char path[sizeof(UNLOCK_SLOT_PATH_FMT) + DECIMAL_STR_MAX(unsigned)];
+        unsigned i, n;
+        long k;
+        int r;
+
+        assert(ret);
+
+        /* Unlocking a LUKS volume means running its PBKDF, which is deliberately slow. Many volumes are set up in
+         * parallel at boot, hence make sure we don't run more key derivations at the same time than there are CPUs
+         * to run them on: take one of that many lock files, or wait for one if they are all taken. */
+
+        k = sysconf(_SC_NPROCESSORS_ONLN);
+        n = k > 0 ? (unsigned) k : 1;
+
+        r = mkdir_p("/run/systemd/cryptsetup", 0755);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n; i++) {
+                xsprintf(path, UNLOCK_SLOT_PATH_FMT, i);
+
+                r = make_lock_file(path, LOCK_EX|LOCK_NB, ret);
+                if (r != -EBUSY)
+                        return r;
+        }
+
+        log_info("Waiting for other volumes to finish unlocking.");
+
+        xsprintf(path, UNLOCK_SLOT_PATH_FMT, (unsigned) getpid_cached() % n);
+
+        return make_lock_file(path, LOCK_EX, ret);
+}
+
 static int attach_luks_or_plain(struct crypt_device *cd,
                                 const char *name,
                                 const char *key_file,
                                 const char *data_device,
                                 char **passwords,
                                 uint32_t flags) {
+        _cleanup_release_lock_file_ LockFile slot = LOCK_FILE_INIT;
         int r = 0;
         bool pass_volume_key = false;
 
@@ -560,6 +600,14 @@ static int attach_luks_or_plain(struct crypt_device *cd,
                  crypt_get_volume_key_size(cd)*8,
                  crypt_get_device_name(cd));
 
+        if (streq_ptr(crypt_get_type(cd), CRYPT_LUKS1)) {
+                int q;
+
+                q = acquire_unlock_slot(&slot);
+                if (q < 0)
+                        log_debug_errno(q, "Failed to acquire unlock slot, ignoring: %m");
+        }
+
         if (key_file) {
                 r = crypt_activate_by_keyfile_offset(cd, name, arg_key_slot, key_file, arg_keyfile_size, arg_keyfile_offset, flags);
                 if (r < 0) {
@@ -26,9 +26,14 @@
 #include "capability-util.h"
 #include "fd-util.h"
 #include "import-common.h"
+#include "missing.h"
 #include "signal-util.h"
 #include "util.h"
 
+/* Let tar consume data in large chunks, so that it doesn't have to wake up for every 64K (the default pipe size)
+ * while extracting large images */
+#define IMPORT_TAR_PIPE_SIZE (1024U*1024U)
+
 int import_make_read_only_fd(int fd) {
         int r;
 
@@ -81,6 +86,9 @@ int import_fork_tar_x(const char *path, pid_t *ret) {
         if (pipe2(pipefd, O_CLOEXEC) < 0)
                 return log_error_errno(errno, "Failed to create pipe for tar: %m");
 
+        if (fcntl(pipefd[0], F_SETPIPE_SZ, IMPORT_TAR_PIPE_SIZE) < 0)
+                log_debug_errno(errno, "Failed to increase pipe size for tar, ignoring: %m");
+
         pid = fork();
         if (pid < 0)
                 return log_error_errno(errno, "Failed to fork off tar: %m");
@@ -21,6 +21,10 @@
 #include "string-table.h"
 #include "util.h"
 
+/* Decompressed data is passed to the callback in chunks of this size at most. Since the callback usually writes
+ * the chunk to disk right-away, let's keep this large enough to not end up with a write() per 16K. */
+#define UNCOMPRESS_BUFFER_SIZE (128U * 1024U)
+
 void import_compress_free(ImportCompress *c) {
         assert(c);
 
@@ -128,7 +132,7 @@ int import_uncompress(ImportCompress *c, const void *data, size_t size, ImportCo
                 c->xz.avail_in = size;
 
                 while (c->xz.avail_in > 0) {
-                        uint8_t buffer[16 * 1024];
+                        uint8_t buffer[UNCOMPRESS_BUFFER_SIZE];
                         lzma_ret lzr;
 
                         c->xz.next_out = buffer;
@@ -150,7 +154,7 @@ int import_uncompress(ImportCompress *c, const void *data, size_t size, ImportCo
                 c->gzip.avail_in = size;
 
                 while (c->gzip.avail_in > 0) {
-                        uint8_t buffer[16 * 1024];
+                        uint8_t buffer[UNCOMPRESS_BUFFER_SIZE];
 
                         c->gzip.next_out = buffer;
                         c->gzip.avail_out = sizeof(buffer);
@@ -171,7 +175,7 @@ int import_uncompress(ImportCompress *c, const void *data, size_t size, ImportCo
                 c->bzip2.avail_in = size;
 
                 while (c->bzip2.avail_in > 0) {
-                        uint8_t buffer[16 * 1024];
+                        uint8_t buffer[UNCOMPRESS_BUFFER_SIZE];
 
                         c->bzip2.next_out = (char*) buffer;
                         c->bzip2.avail_out = sizeof(buffer);
@@ -35,6 +35,7 @@
 #include "io-util.h"
 #include "machine-pool.h"
 #include "mkdir.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "process-util.h"
 #include "qcow2-util.h"
@@ -68,7 +69,7 @@ struct TarImport {
 
         sd_event_source *input_event_source;
 
-        uint8_t buffer[16*1024];
+        uint8_t buffer[128*1024];
         size_t buffer_size;
 
         uint64_t written_compressed;
@@ -78,6 +79,7 @@ struct TarImport {
 
         pid_t tar_pid;
 
+        usec_t start_usec;
         unsigned last_percent;
         RateLimit progress_rate_limit;
 };
@@ -155,6 +157,8 @@ int tar_import_new(
 
 static void tar_import_report_progress(TarImport *i) {
         unsigned percent;
+        usec_t n;
+
         assert(i);
 
         /* We have no size information, unless the source is a regular file */
@@ -173,7 +177,16 @@ static void tar_import_report_progress(TarImport *i) {
                 return;
 
         sd_notifyf(false, "X_IMPORT_PROGRESS=%u", percent);
-        log_info("Imported %u%%.", percent);
+
+        n = now(CLOCK_MONOTONIC);
+        if (n - i->start_usec > USEC_PER_SEC) {
+                char bytes[FORMAT_BYTES_MAX];
+
+                log_info("Imported %u%% at %s/s.", percent,
+                         format_bytes(bytes, sizeof(bytes),
+                                      (uint64_t) ((double) i->written_uncompressed / ((double) (n - i->start_usec) / (double) USEC_PER_SEC))));
+        } else
+                log_info("Imported %u%%.", percent);
 
         i->last_percent = percent;
 }
@@ -245,6 +258,8 @@ static int tar_import_fork_tar(TarImport *i) {
         if (i->tar_fd < 0)
                 return i->tar_fd;
 
+        i->start_usec = now(CLOCK_MONOTONIC);
+
         return 0;
 }
 
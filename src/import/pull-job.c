@@ -32,6 +32,13 @@
 #include "strv.h"
 #include "xattr-util.h"
 
+/* The largest receive buffer libcurl supports (CURL_MAX_READ_SIZE) */
+#define PULL_JOB_BUFFER_SIZE (512L * 1024L)
+
+/* Only seek over runs of NUL bytes that may actually result in a hole, i.e. that cover at least one file system
+ * block. Shorter runs would only turn a single write() into an lseek() and two write()s. */
+#define PULL_JOB_SPARSE_RUN_LENGTH 4096U
+
 PullJob* pull_job_unref(PullJob *j) {
         if (!j)
                 return NULL;
@@ -248,7 +255,7 @@ static int pull_job_write_uncompressed(const void *p, size_t sz, void *userdata)
                 }
 
                 if (j->allow_sparse)
-                        n = sparse_write(j->disk_fd, p, sz, 64);
+                        n = sparse_write(j->disk_fd, p, sz, PULL_JOB_SPARSE_RUN_LENGTH);
                 else
                         n = write(j->disk_fd, p, sz);
                 if (n < 0)
@@ -632,6 +639,11 @@ int pull_job_begin(PullJob *j) {
                         return -EIO;
         }
 
+        /* Ask for larger chunks than the default 16K, so that we need fewer calls into the checksumming,
+         * decompression and writing logic per byte downloaded. Older libcurl versions silently ignore this. */
+        if (curl_easy_setopt(j->curl, CURLOPT_BUFFERSIZE, PULL_JOB_BUFFER_SIZE) != CURLE_OK)
+                log_debug("Failed to set curl buffer size, ignoring.");
+
         if (curl_easy_setopt(j->curl, CURLOPT_WRITEFUNCTION, pull_job_write_callback) != CURLE_OK)
                 return -EIO;
 
@@ -36,6 +36,7 @@
 #include "import-util.h"
 #include "macro.h"
 #include "mkdir.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "pull-common.h"
 #include "pull-job.h"
@@ -48,6 +49,9 @@
 #include "util.h"
 #include "web-util.h"
 
+/* The granularity at which we try to share data with a previous download of the same image */
+#define RAW_DEDUPE_CHUNK_SIZE (1024U * 1024U)
+
 typedef enum RawProgress {
         RAW_DOWNLOADING,
         RAW_VERIFYING,
@@ -378,7 +382,7 @@ static int raw_pull_make_local_copy(RawPull *i) {
         if (r < 0)
                 log_warning_errno(r, "Failed to set file attributes on %s: %m", tp);
 
-        r = copy_bytes(i->raw_job->disk_fd, dfd, (uint64_t) -1, COPY_REFLINK);
+        r = copy_bytes(i->raw_job->disk_fd, dfd, (uint64_t) -1, COPY_REFLINK|COPY_HOLES);
         if (r < 0) {
                 unlink(tp);
                 return log_error_errno(r, "Failed to make writable copy of image: %m");
@@ -413,6 +417,61 @@ static int raw_pull_make_local_copy(RawPull *i) {
         return 0;
 }
 
+static int raw_pull_dedupe(RawPull *i) {
+        _cleanup_close_ int fd = -1;
+        uint64_t offset, n, shared = 0;
+        char bytes[FORMAT_BYTES_MAX];
+        struct stat old_st, st;
+        char **etag;
+        int r;
+
+        assert(i);
+        assert(i->raw_job);
+        assert(i->raw_job->disk_fd >= 0);
+
+        /* If we have a previous version of the image from the same URL around, then let's ask the file system to
+         * share all chunks that didn't change with it. The kernel verifies that the data actually matches before
+         * doing so. This only works on file systems that support deduplication, and is purely an optimization,
+         * hence all errors are ignored. */
+
+        STRV_FOREACH(etag, i->raw_job->old_etags) {
+                _cleanup_free_ char *path = NULL;
+
+                r = pull_make_path(i->raw_job->url, *etag, i->image_root, ".raw-", ".raw", &path);
+                if (r < 0)
+                        return log_oom();
+
+                fd = open(path, O_RDONLY|O_NOCTTY|O_CLOEXEC);
+                if (fd >= 0)
+                        break;
+
+                log_debug_errno(errno, "Failed to open previous image %s, ignoring: %m", path);
+        }
+        if (fd < 0)
+                return 0;
+
+        if (fstat(fd, &old_st) < 0 || fstat(i->raw_job->disk_fd, &st) < 0)
+                return log_debug_errno(errno, "Failed to stat images, not deduplicating: %m");
+
+        if (!S_ISREG(old_st.st_mode) || !S_ISREG(st.st_mode) || old_st.st_dev != st.st_dev)
+                return 0;
+
+        n = MIN((uint64_t) old_st.st_size, (uint64_t) st.st_size) / RAW_DEDUPE_CHUNK_SIZE * RAW_DEDUPE_CHUNK_SIZE;
+
+        for (offset = 0; offset < n; offset += RAW_DEDUPE_CHUNK_SIZE) {
+                r = btrfs_dedupe_range(fd, offset, i->raw_job->disk_fd, offset, RAW_DEDUPE_CHUNK_SIZE);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to deduplicate image data, stopping: %m");
+                if (r > 0)
+                        shared += RAW_DEDUPE_CHUNK_SIZE;
+        }
+
+        if (shared > 0)
+                log_info("Sharing %s of image data with previous download.", format_bytes(bytes, sizeof(bytes), shared));
+
+        return 0;
+}
+
 static bool raw_pull_is_done(RawPull *i) {
         assert(i);
         assert(i->raw_job);
@@ -532,6 +591,8 @@ static void raw_pull_job_on_finished(PullJob *j) {
 
                 raw_pull_report_progress(i, RAW_FINALIZING);
 
+                (void) raw_pull_dedupe(i);
+
                 r = import_make_read_only_fd(i->raw_job->disk_fd);
                 if (r < 0)
                         goto finish;
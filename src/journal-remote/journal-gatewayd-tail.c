@@ -0,0 +1,623 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "io-util.h"
+#include "journal-gatewayd-tail.h"
+#include "log.h"
+#include "logs-show.h"
+#include "set.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+
+/* How long the reader waits for the journal to change before checking again anyway */
+#define TAIL_WAIT_TIMEOUT (10*USEC_PER_SEC)
+
+/* One reader for all connections that follow the journal. It sits at the end of the journal, evaluates
+ * the matches of all followers once for each new entry, formats it once for each output mode requested
+ * and queues it for the followers it matches. */
+struct Tail {
+        char *directory;
+
+        sd_journal *journal;
+        pthread_t thread;
+        bool started;
+
+        /* Protects everything below and the queues of the followers */
+        pthread_mutex_t lock;
+
+        /* Broadcast whenever entries were queued */
+        pthread_cond_t cond;
+
+        LIST_HEAD(Follower, followers);
+};
+
+TailEntry *tail_entry_ref(TailEntry *e) {
+        if (!e)
+                return NULL;
+
+        assert_se(REFCNT_INC(e->n_ref) >= 2);
+
+        return e;
+}
+
+TailEntry *tail_entry_unref(TailEntry *e) {
+        if (!e)
+                return NULL;
+
+        if (REFCNT_DEC(e->n_ref) > 0)
+                return NULL;
+
+        free(e->data);
+        return mfree(e);
+}
+
+static int tail_entry_new(TailEntry **ret, sd_journal *j, OutputMode mode) {
+        TailEntry *e;
+        FILE *f;
+        int r;
+
+        assert(ret);
+        assert(j);
+
+        e = new0(TailEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->n_ref = REFCNT_INIT;
+
+        f = open_memstream(&e->data, &e->size);
+        if (!f) {
+                free(e);
+                return -ENOMEM;
+        }
+
+        /* The reader is shared, hence don't rely on whatever the previous response left configured. The
+         * output functions lower this again where the mode asks for it. */
+        r = sd_journal_set_data_threshold(j, 0);
+        if (r >= 0)
+                r = output_journal(f, j, mode, 0, OUTPUT_FULL_WIDTH, NULL);
+        if (r >= 0)
+                r = fflush_and_check(f);
+        fclose(f);
+        if (r < 0) {
+                tail_entry_unref(e);
+                return r;
+        }
+
+        *ret = e;
+        return 0;
+}
+
+static int tail_entry_new_comment(TailEntry **ret, const char *comment) {
+        TailEntry *e;
+
+        assert(ret);
+        assert(comment);
+
+        e = new0(TailEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->n_ref = REFCNT_INIT;
+
+        /* Lines starting with a colon are comments in event streams, clients ignore them */
+        if (asprintf(&e->data, ": %s\n\n", comment) < 0) {
+                free(e);
+                return -ENOMEM;
+        }
+
+        e->size = strlen(e->data);
+        e->comment = true;
+
+        *ret = e;
+        return 0;
+}
+
+int tail_new(Tail **ret, const char *directory) {
+        _cleanup_free_ Tail *t = NULL;
+
+        assert(ret);
+
+        t = new0(Tail, 1);
+        if (!t)
+                return -ENOMEM;
+
+        if (directory) {
+                t->directory = strdup(directory);
+                if (!t->directory)
+                        return -ENOMEM;
+        }
+
+        assert_se(pthread_mutex_init(&t->lock, NULL) == 0);
+        assert_se(pthread_cond_init(&t->cond, NULL) == 0);
+
+        *ret = t;
+        t = NULL;
+
+        return 0;
+}
+
+static void follower_queue(Follower *f, TailEntry *e) {
+        assert(f);
+        assert(e);
+
+        /* Slow followers must not hold up the others, hence rather than waiting for them, drop entries
+         * they have no space for and tell them later */
+        if (f->n_queued >= FOLLOWER_QUEUE_MAX) {
+                f->n_dropped++;
+                return;
+        }
+
+        f->queue[(f->queue_start + f->n_queued) % FOLLOWER_QUEUE_MAX] = tail_entry_ref(e);
+        f->n_queued++;
+}
+
+static int entry_fields(sd_journal *j, Set **ret) {
+        _cleanup_set_free_free_ Set *s = NULL;
+        const void *data;
+        size_t length;
+        int r;
+
+        assert(j);
+        assert(ret);
+
+        s = set_new(&string_hash_ops);
+        if (!s)
+                return -ENOMEM;
+
+        /* The output functions might have restricted the fields returned, or their size */
+        (void) sd_journal_set_data_fields(j, NULL);
+        (void) sd_journal_set_data_threshold(j, 0);
+
+        SD_JOURNAL_FOREACH_DATA(j, data, length) {
+                char *d;
+
+                d = strndup(data, length);
+                if (!d)
+                        return -ENOMEM;
+
+                r = set_consume(s, d);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = s;
+        s = NULL;
+
+        return 0;
+}
+
+static bool follower_matches(Follower *f, Set *fields) {
+        char **i, **k;
+
+        assert(f);
+
+        /* Matches on the same field are ORed, matches on different fields ANDed, like
+         * sd_journal_add_match() does it. */
+
+        STRV_FOREACH(i, f->matches) {
+                size_t n;
+                bool found = false;
+
+                n = strcspn(*i, "=") + 1;
+
+                STRV_FOREACH(k, f->matches)
+                        if (strneq(*i, *k, n) && set_contains(fields, *k)) {
+                                found = true;
+                                break;
+                        }
+
+                if (!found)
+                        return false;
+        }
+
+        return true;
+}
+
+static int tail_dispatch_one(Tail *t, Follower *f, Set **fields, TailEntry *formatted[static _OUTPUT_MODE_MAX]) {
+        int r;
+
+        assert(t);
+        assert(f);
+        assert(fields);
+
+        if (!strv_isempty(f->matches)) {
+                if (!*fields) {
+                        r = entry_fields(t->journal, fields);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to read journal entry: %m");
+                }
+
+                if (!follower_matches(f, *fields))
+                        return 0;
+        }
+
+        if (!formatted[f->mode]) {
+                r = tail_entry_new(&formatted[f->mode], t->journal, f->mode);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to serialize item: %m");
+        }
+
+        follower_queue(f, formatted[f->mode]);
+        return 1;
+}
+
+static void tail_dispatch_locked(Tail *t, Follower *only) {
+        _cleanup_set_free_free_ Set *fields = NULL;
+        TailEntry *formatted[_OUTPUT_MODE_MAX] = {};
+        OutputMode m;
+
+        assert(t);
+
+        /* Queues the current entry for all followers it matches, or only for the one specified. Each
+         * entry is read and formatted at most once per output mode, however many followers there are. */
+
+        if (only)
+                (void) tail_dispatch_one(t, only, &fields, formatted);
+        else {
+                Follower *f;
+
+                LIST_FOREACH(followers, f, t->followers)
+                        (void) tail_dispatch_one(t, f, &fields, formatted);
+        }
+
+        for (m = 0; m < _OUTPUT_MODE_MAX; m++)
+                tail_entry_unref(formatted[m]);
+}
+
+static int tail_process_locked(Tail *t) {
+        int r;
+
+        assert(t);
+
+        r = sd_journal_process(t->journal);
+        if (r < 0)
+                log_warning_errno(r, "Failed to process journal changes, ignoring: %m");
+
+        for (;;) {
+                r = sd_journal_next(t->journal);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to advance journal pointer: %m");
+                if (r == 0)
+                        break;
+
+                if (!t->followers)
+                        continue;
+
+                tail_dispatch_locked(t, NULL);
+        }
+
+        assert_se(pthread_cond_broadcast(&t->cond) == 0);
+
+        return 0;
+}
+
+static void *tail_thread(void *userdata) {
+        Tail *t = userdata;
+        int fd, events;
+
+        assert(t);
+
+        assert_se(pthread_mutex_lock(&t->lock) == 0);
+        fd = sd_journal_get_fd(t->journal);
+        events = sd_journal_get_events(t->journal);
+        assert_se(pthread_mutex_unlock(&t->lock) == 0);
+
+        assert(fd >= 0);
+        if (events < 0) {
+                log_error_errno(events, "Failed to watch journal: %m");
+                return NULL;
+        }
+
+        for (;;) {
+                usec_t timeout = TAIL_WAIT_TIMEOUT;
+                uint64_t until;
+                int r;
+
+                assert_se(pthread_mutex_lock(&t->lock) == 0);
+                r = sd_journal_get_timeout(t->journal, &until);
+                assert_se(pthread_mutex_unlock(&t->lock) == 0);
+                if (r >= 0 && until != (uint64_t) -1) {
+                        usec_t n;
+
+                        n = now(CLOCK_MONOTONIC);
+                        timeout = MIN(timeout, until > n ? until - n : 0);
+                }
+
+                r = fd_wait_for_event(fd, events, timeout);
+                if (r < 0 && r != -EINTR) {
+                        log_error_errno(r, "Couldn't wait for journal event: %m");
+                        return NULL;
+                }
+
+                assert_se(pthread_mutex_lock(&t->lock) == 0);
+                (void) tail_process_locked(t);
+                assert_se(pthread_mutex_unlock(&t->lock) == 0);
+        }
+
+        return NULL;
+}
+
+static int tail_start_locked(Tail *t) {
+        pthread_attr_t attr;
+        int r;
+
+        assert(t);
+
+        if (t->started)
+                return 0;
+
+        if (!t->journal) {
+                if (t->directory)
+                        r = sd_journal_open_directory(&t->journal, t->directory, 0);
+                else
+                        r = sd_journal_open(&t->journal, SD_JOURNAL_LOCAL_ONLY|SD_JOURNAL_SYSTEM);
+                if (r < 0)
+                        return r;
+
+                r = sd_journal_seek_tail(t->journal);
+                if (r < 0)
+                        return r;
+
+                r = sd_journal_previous(t->journal);
+                if (r < 0)
+                        return r;
+
+                /* Set up the inotify watches right away, so that no change is missed */
+                r = sd_journal_get_fd(t->journal);
+                if (r < 0)
+                        return r;
+        }
+
+        /* The reader runs for the lifetime of the process */
+        r = -pthread_attr_init(&attr);
+        if (r < 0)
+                return r;
+
+        r = -pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (r >= 0)
+                r = -pthread_create(&t->thread, &attr, tail_thread, t);
+        (void) pthread_attr_destroy(&attr);
+        if (r < 0)
+                return r;
+
+        t->started = true;
+        return 0;
+}
+
+int follower_new(Follower **ret, Tail *t, OutputMode mode, char **matches) {
+        Follower *f;
+        int r;
+
+        assert(ret);
+        assert(t);
+
+        f = new0(Follower, 1);
+        if (!f)
+                return -ENOMEM;
+
+        f->matches = strv_copy(matches);
+        if (!f->matches) {
+                free(f);
+                return -ENOMEM;
+        }
+
+        f->tail = t;
+        f->mode = mode;
+
+        /* Remember where the shared reader is right now, so that a request that doesn't get to send any
+         * entry on its own still gets everything added from here on. If the journal is empty still, there
+         * is no cursor, and the follower starts at the head. */
+        assert_se(pthread_mutex_lock(&t->lock) == 0);
+
+        r = tail_start_locked(t);
+        if (r >= 0)
+                r = tail_process_locked(t);
+        if (r >= 0)
+                (void) sd_journal_get_cursor(t->journal, &f->attach_cursor);
+
+        assert_se(pthread_mutex_unlock(&t->lock) == 0);
+
+        if (r < 0) {
+                follower_free(f);
+                return r;
+        }
+
+        *ret = f;
+        return 0;
+}
+
+Follower *follower_free(Follower *f) {
+        unsigned i;
+
+        if (!f)
+                return NULL;
+
+        if (f->registered) {
+                assert_se(pthread_mutex_lock(&f->tail->lock) == 0);
+                LIST_REMOVE(followers, f->tail->followers, f);
+                assert_se(pthread_mutex_unlock(&f->tail->lock) == 0);
+        }
+
+        if (f->n_dropped > 0)
+                log_info("Follower was too slow, dropped %"PRIu64" entries.", f->n_dropped);
+
+        for (i = 0; i < f->n_queued; i++)
+                tail_entry_unref(f->queue[(f->queue_start + i) % FOLLOWER_QUEUE_MAX]);
+
+        strv_free(f->matches);
+        free(f->attach_cursor);
+        return mfree(f);
+}
+
+static int tail_replay_locked(Tail *t, Follower *f, const char *from, const char *to) {
+        int r;
+
+        assert(t);
+        assert(f);
+        assert(to);
+
+        /* The follower stopped reading its own journal at "from", or didn't read anything yet if NULL,
+         * while the shared reader already got to "to". Queue the entries in between for the follower, and
+         * leave the reader where it was. */
+
+        if (from)
+                r = sd_journal_seek_cursor(t->journal, from);
+        else
+                r = sd_journal_seek_head(t->journal);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                r = sd_journal_next(t->journal);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return 0;
+
+                if (from) {
+                        r = sd_journal_test_cursor(t->journal, from);
+                        if (r < 0)
+                                return r;
+                        if (r > 0)
+                                continue;
+                }
+
+                tail_dispatch_locked(t, f);
+
+                r = sd_journal_test_cursor(t->journal, to);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        return 0;
+        }
+}
+
+int follower_start(Follower *f, const char *cursor) {
+        _cleanup_free_ char *current = NULL;
+        Tail *t;
+        int r;
+
+        /* Without a cursor the request sent nothing itself, hence continue from where the shared reader
+         * was when it was attached */
+        if (!cursor)
+                cursor = f->attach_cursor;
+
+        assert(f);
+        assert(!f->registered);
+
+        t = f->tail;
+
+        assert_se(pthread_mutex_lock(&t->lock) == 0);
+
+        r = tail_start_locked(t);
+        if (r < 0)
+                goto finish;
+
+        /* Make sure the shared reader got at least as far as the follower got on its own, then hand
+         * over whatever it saw in the meantime */
+        r = tail_process_locked(t);
+        if (r < 0)
+                goto finish;
+
+        if (sd_journal_get_cursor(t->journal, &current) >= 0 && !streq_ptr(cursor, current)) {
+                r = tail_replay_locked(t, f, cursor, current);
+                if (r < 0) {
+                        log_warning_errno(r, "Failed to catch up follower, ignoring: %m");
+
+                        /* Make sure we are back at the end, so that the other followers don't get
+                         * old entries */
+                        r = sd_journal_seek_cursor(t->journal, current);
+                        if (r >= 0)
+                                r = sd_journal_next(t->journal);
+                        if (r < 0)
+                                goto finish;
+                }
+        }
+
+        LIST_PREPEND(followers, t->followers, f);
+        f->registered = true;
+        r = 0;
+
+finish:
+        assert_se(pthread_mutex_unlock(&t->lock) == 0);
+        return r;
+}
+
+int follower_pop(Follower *f, usec_t timeout, TailEntry **ret) {
+        struct timespec ts;
+        Tail *t;
+        int r = 0;
+
+        assert(f);
+        assert(f->registered);
+        assert(ret);
+
+        t = f->tail;
+
+        timespec_store(&ts, now(CLOCK_REALTIME) + timeout);
+
+        assert_se(pthread_mutex_lock(&t->lock) == 0);
+
+        while (f->n_queued == 0) {
+                r = -pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+                if (r == -ETIMEDOUT) {
+                        r = 0;
+                        goto finish;
+                }
+                assert(r == 0);
+        }
+
+        if (f->n_dropped > f->n_dropped_reported) {
+                uint64_t n;
+
+                n = f->n_dropped - f->n_dropped_reported;
+                f->n_dropped_reported = f->n_dropped;
+
+                log_debug("Follower too slow, dropped %"PRIu64" entries.", n);
+
+                /* Event streams can carry a note about this, other formats have no place for it */
+                if (f->mode == OUTPUT_JSON_SSE) {
+                        char comment[DECIMAL_STR_MAX(uint64_t) + 17];
+
+                        xsprintf(comment, "%"PRIu64" entries dropped", n);
+
+                        r = tail_entry_new_comment(ret, comment);
+                        if (r < 0)
+                                goto finish;
+
+                        r = 1;
+                        goto finish;
+                }
+        }
+
+        *ret = f->queue[f->queue_start];
+        f->queue_start = (f->queue_start + 1) % FOLLOWER_QUEUE_MAX;
+        f->n_queued--;
+        r = 1;
+
+finish:
+        assert_se(pthread_mutex_unlock(&t->lock) == 0);
+        return r;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pthread.h>
+
+#include "sd-journal.h"
+
+#include "list.h"
+#include "output-mode.h"
+#include "refcnt.h"
+#include "time-util.h"
+
+/* How many formatted entries may be queued for a follower that doesn't keep up, before newer ones are
+ * dropped */
+#define FOLLOWER_QUEUE_MAX 1024U
+
+typedef struct Tail Tail;
+
+/* An entry formatted in one output mode, shared between all followers that are sent it. The followers
+ * drop their references from the connection threads, without holding the lock of the Tail. */
+typedef struct TailEntry {
+        RefCount n_ref;
+        char *data;
+        size_t size;
+
+        /* Not a journal entry, but a note for the client */
+        bool comment;
+} TailEntry;
+
+TailEntry *tail_entry_ref(TailEntry *e);
+TailEntry *tail_entry_unref(TailEntry *e);
+
+typedef struct Follower Follower;
+
+struct Follower {
+        Tail *tail;
+
+        OutputMode mode;
+
+        /* The matches of the request, in "FIELD=value" form */
+        char **matches;
+
+        /* Where the shared reader was when the follower was created, NULL if the journal was empty */
+        char *attach_cursor;
+
+        /* Ring buffer of entries not sent out yet */
+        TailEntry *queue[FOLLOWER_QUEUE_MAX];
+        unsigned queue_start, n_queued;
+
+        uint64_t n_dropped, n_dropped_reported;
+
+        bool registered;
+
+        LIST_FIELDS(Follower, followers);
+};
+
+int tail_new(Tail **ret, const char *directory);
+
+int follower_new(Follower **ret, Tail *t, OutputMode mode, char **matches);
+Follower *follower_free(Follower *f);
+
+int follower_start(Follower *f, const char *cursor);
+int follower_pop(Follower *f, usec_t timeout, TailEntry **ret);
@@ -33,11 +33,13 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "hostname-util.h"
+#include "journal-gatewayd-tail.h"
 #include "log.h"
 #include "logs-show.h"
 #include "microhttpd-util.h"
 #include "parse-util.h"
 #include "sigbus.h"
+#include "strv.h"
 #include "util.h"
 
 #define JOURNAL_WAIT_TIMEOUT (10*USEC_PER_SEC)
@@ -47,6 +49,8 @@ static char *arg_cert_pem = NULL;
 static char *arg_trust_pem = NULL;
 static char *arg_directory = NULL;
 
+static Tail *tail = NULL;
+
 typedef struct RequestMeta {
         sd_journal *journal;
 
@@ -67,6 +71,13 @@ typedef struct RequestMeta {
 
         uint64_t n_fields;
         bool n_fields_set;
+
+        /* Matches specified as URL arguments */
+        char **matches;
+
+        /* Once a follower caught up with the journal, entries come from the shared reader */
+        Follower *follower;
+        TailEntry *entry;
 } RequestMeta;
 
 static const char* const mime_types[_OUTPUT_MODE_MAX] = {
@@ -106,6 +117,10 @@ static void request_meta_free(
 
         safe_fclose(m->tmp);
 
+        follower_free(m->follower);
+        tail_entry_unref(m->entry);
+        strv_free(m->matches);
+
         free(m->cursor);
         free(m);
 }
@@ -144,6 +159,76 @@ static int request_meta_ensure_tmp(RequestMeta *m) {
         return 0;
 }
 
+static ssize_t request_reader_follow(
+                RequestMeta *m,
+                uint64_t pos,
+                char *buf,
+                size_t max) {
+
+        size_t n;
+        int r;
+
+        assert(m);
+        assert(m->follower);
+        assert(buf);
+        assert(max > 0);
+        assert(pos >= m->delta);
+
+        pos -= m->delta;
+
+        while (pos >= m->size) {
+                TailEntry *e;
+
+                if (m->n_entries_set &&
+                    m->n_entries <= 0)
+                        return MHD_CONTENT_READER_END_OF_STREAM;
+
+                r = follower_pop(m->follower, JOURNAL_WAIT_TIMEOUT, &e);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to get next entry: %m");
+                        return MHD_CONTENT_READER_END_WITH_ERROR;
+                }
+                if (r == 0)
+                        return 0;
+
+                pos -= m->size;
+                m->delta += m->size;
+
+                tail_entry_unref(m->entry);
+                m->entry = e;
+                m->size = e->size;
+
+                if (m->n_entries_set && !e->comment)
+                        m->n_entries -= 1;
+        }
+
+        n = MIN(m->size - pos, max);
+        memcpy(buf, m->entry->data + pos, n);
+
+        return (ssize_t) n;
+}
+
+static int request_start_follow(RequestMeta *m) {
+        _cleanup_free_ char *cursor = NULL;
+        int r;
+
+        assert(m);
+        assert(m->follower);
+
+        /* We reached the end of the journal, from now on have the shared reader pass us new entries,
+         * starting right after the last one we sent ourselves. */
+        (void) sd_journal_get_cursor(m->journal, &cursor);
+
+        r = follower_start(m->follower, cursor);
+        if (r < 0)
+                return r;
+
+        sd_journal_close(m->journal);
+        m->journal = NULL;
+
+        return 0;
+}
+
 static ssize_t request_reader_entries(
                 void *cls,
                 uint64_t pos,
@@ -159,6 +244,9 @@ static ssize_t request_reader_entries(
         assert(max > 0);
         assert(pos >= m->delta);
 
+        if (m->follower && m->follower->registered)
+                return request_reader_follow(m, pos, buf, max);
+
         pos -= m->delta;
 
         while (pos >= m->size) {
@@ -183,6 +271,16 @@ static ssize_t request_reader_entries(
                         return MHD_CONTENT_READER_END_WITH_ERROR;
                 } else if (r == 0) {
 
+                        if (m->follower) {
+                                r = request_start_follow(m);
+                                if (r < 0) {
+                                        log_error_errno(r, "Failed to follow journal: %m");
+                                        return MHD_CONTENT_READER_END_WITH_ERROR;
+                                }
+
+                                return request_reader_follow(m, pos + m->delta, buf, max);
+                        }
+
                         if (m->follow) {
                                 r = sd_journal_wait(m->journal, (uint64_t) JOURNAL_WAIT_TIMEOUT);
                                 if (r < 0) {
@@ -429,6 +527,12 @@ static int request_parse_arguments_iterator(
                                 m->argument_parse_error = r;
                                 return MHD_NO;
                         }
+
+                        r = strv_extend(&m->matches, match);
+                        if (r < 0) {
+                                m->argument_parse_error = log_oom();
+                                return MHD_NO;
+                        }
                 }
 
                 return MHD_YES;
@@ -446,6 +550,13 @@ static int request_parse_arguments_iterator(
                 return MHD_NO;
         }
 
+        r = strv_consume(&m->matches, p);
+        p = NULL;
+        if (r < 0) {
+                m->argument_parse_error = log_oom();
+                return MHD_NO;
+        }
+
         return MHD_YES;
 }
 
@@ -494,6 +605,14 @@ static int request_handler_entries(
                 m->n_entries_set = true;
         }
 
+        if (m->follow && !m->discrete) {
+                r = follower_new(&m->follower, tail, m->mode, m->matches);
+                if (r == -ENOMEM)
+                        return respond_oom(connection);
+                if (r < 0)
+                        return mhd_respondf(connection, r, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to follow journal: %m");
+        }
+
         if (m->cursor)
                 r = sd_journal_seek_cursor(m->journal, m->cursor);
         else if (m->n_skip >= 0)
@@ -1009,6 +1128,13 @@ int main(int argc, char *argv[]) {
         if (r < 0)
                 return EXIT_FAILURE;
 
+        /* Shared by all requests following the journal */
+        r = tail_new(&tail, arg_directory);
+        if (r < 0) {
+                log_oom();
+                return EXIT_FAILURE;
+        }
+
         n = sd_listen_fds(1);
         if (n < 0) {
                 log_error_errno(n, "Failed to determine passed sockets: %m");
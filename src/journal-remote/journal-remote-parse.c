@@ -30,6 +30,11 @@ void source_free(RemoteSource *source) {
 
         journal_importer_cleanup(&source->importer);
 
+#ifdef HAVE_ZSTD
+        ZSTD_freeDStream(source->zstd);
+        free(source->zstd_buffer);
+#endif
+
         log_debug("Writer ref count %i", source->writer->n_ref);
         writer_unref(source->writer);
 
@@ -65,6 +70,89 @@ RemoteSource* source_new(int fd, bool passive_fd, char *name, Writer *writer) {
         return source;
 }
 
+bool source_encoding_supported(const char *encoding) {
+        if (!encoding || streq(encoding, "identity"))
+                return true;
+
+#ifdef HAVE_ZSTD
+        if (streq(encoding, "zstd"))
+                return true;
+#endif
+
+        return false;
+}
+
+int source_set_encoding(RemoteSource *source, const char *encoding) {
+        assert(source);
+
+        if (!source_encoding_supported(encoding))
+                return -EPROTONOSUPPORT;
+
+#ifdef HAVE_ZSTD
+        if (streq_ptr(encoding, "zstd")) {
+                size_t k;
+
+                source->zstd_buffer = malloc(ZSTD_DStreamOutSize());
+                if (!source->zstd_buffer)
+                        return -ENOMEM;
+
+                source->zstd = ZSTD_createDStream();
+                if (!source->zstd)
+                        return -ENOMEM;
+
+                k = ZSTD_initDStream(source->zstd);
+                if (ZSTD_isError(k))
+                        return -ENOMEM;
+        }
+#endif
+
+        return 0;
+}
+
+/* Feed received data to the importer, decompressing it first if necessary. */
+int source_push_data(RemoteSource *source, const char *data, size_t size) {
+        assert(source);
+        assert(data || size == 0);
+
+#ifdef HAVE_ZSTD
+        if (source->zstd) {
+                ZSTD_inBuffer in = {
+                        .src = data,
+                        .size = size,
+                };
+
+                for (;;) {
+                        ZSTD_outBuffer out = {
+                                .dst = source->zstd_buffer,
+                                .size = ZSTD_DStreamOutSize(),
+                        };
+                        size_t k;
+                        int r;
+
+                        k = ZSTD_decompressStream(source->zstd, &out, &in);
+                        if (ZSTD_isError(k)) {
+                                log_debug("Failed to decompress data from %s: %s",
+                                          source->importer.name, ZSTD_getErrorName(k));
+                                return -EBADMSG;
+                        }
+
+                        /* The first bytes of a frame and the frame end don't necessarily produce output */
+                        if (out.pos > 0) {
+                                r = journal_importer_push_data(&source->importer, out.dst, out.pos);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                        /* If the output buffer was not filled up, the decoder has nothing buffered anymore */
+                        if (in.pos >= in.size && out.pos < out.size)
+                                return 0;
+                }
+        }
+#endif
+
+        return journal_importer_push_data(&source->importer, data, size);
+}
+
 int process_source(RemoteSource *source, bool compress, bool seal) {
         int r;
 
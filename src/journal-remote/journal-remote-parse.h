@@ -19,6 +19,10 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "sd-event.h"
 
 #include "journal-importer.h"
@@ -31,8 +35,24 @@ typedef struct RemoteSource {
 
         sd_event_source *event;
         sd_event_source *buffer_event;
+
+#ifdef HAVE_ZSTD
+        /* Set if the data is received with Content-Encoding: zstd */
+        ZSTD_DStream *zstd;
+        void *zstd_buffer;
+#endif
 } RemoteSource;
 
+/* The encodings of the upload stream we understand, for the Accept-Encoding header */
+#ifdef HAVE_ZSTD
+#  define SOURCE_ENCODINGS "zstd, identity"
+#else
+#  define SOURCE_ENCODINGS "identity"
+#endif
+
 RemoteSource* source_new(int fd, bool passive_fd, char *name, Writer *writer);
 void source_free(RemoteSource *source);
+bool source_encoding_supported(const char *encoding);
+int source_set_encoding(RemoteSource *source, const char *encoding);
+int source_push_data(RemoteSource *source, const char *data, size_t size);
 int process_source(RemoteSource *source, bool compress, bool seal);
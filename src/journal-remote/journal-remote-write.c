@@ -45,6 +45,8 @@ Writer* writer_new(RemoteServer *server) {
         if (!w->mmap)
                 return mfree(w);
 
+        assert_se(pthread_mutex_init(&w->lock, NULL) == 0);
+
         w->n_ref = 1;
         w->server = server;
 
@@ -68,13 +70,28 @@ Writer* writer_free(Writer *w) {
         if (w->mmap)
                 mmap_cache_unref(w->mmap);
 
+        assert_se(pthread_mutex_destroy(&w->lock) == 0);
+
         return mfree(w);
 }
 
 Writer* writer_unref(Writer *w) {
-        if (w && (-- w->n_ref <= 0))
+        RemoteServer *s;
+
+        if (!w)
+                return NULL;
+
+        /* Writers are looked up and referenced with the server lock taken, hence we need it to drop the reference */
+        s = w->server;
+        if (s)
+                assert_se(pthread_mutex_lock(&s->lock) == 0);
+
+        if (-- w->n_ref <= 0)
                 writer_free(w);
 
+        if (s)
+                assert_se(pthread_mutex_unlock(&s->lock) == 0);
+
         return NULL;
 }
 
@@ -85,17 +102,13 @@ Writer* writer_ref(Writer *w) {
         return w;
 }
 
-int writer_write(Writer *w,
-                 struct iovec_wrapper *iovw,
-                 dual_timestamp *ts,
-                 bool compress,
-                 bool seal) {
+static int writer_write_locked(Writer *w,
+                               struct iovec_wrapper *iovw,
+                               dual_timestamp *ts,
+                               bool compress,
+                               bool seal) {
         int r;
 
-        assert(w);
-        assert(iovw);
-        assert(iovw->count > 0);
-
         if (journal_file_rotate_suggested(w->journal, 0)) {
                 log_info("%s: Journal header limits reached or header out-of-date, rotating",
                          w->journal->path);
@@ -108,7 +121,7 @@ int writer_write(Writer *w,
                                       &w->seqnum, NULL, NULL);
         if (r >= 0) {
                 if (w->server)
-                        w->server->event_count += 1;
+                        __sync_fetch_and_add(&w->server->event_count, 1);
                 return 1;
         }
 
@@ -126,6 +139,24 @@ int writer_write(Writer *w,
                 return r;
 
         if (w->server)
-                w->server->event_count += 1;
+                __sync_fetch_and_add(&w->server->event_count, 1);
         return 1;
 }
+
+int writer_write(Writer *w,
+                 struct iovec_wrapper *iovw,
+                 dual_timestamp *ts,
+                 bool compress,
+                 bool seal) {
+        int r;
+
+        assert(w);
+        assert(iovw);
+        assert(iovw->count > 0);
+
+        assert_se(pthread_mutex_lock(&w->lock) == 0);
+        r = writer_write_locked(w, iovw, ts, compress, seal);
+        assert_se(pthread_mutex_unlock(&w->lock) == 0);
+
+        return r;
+}
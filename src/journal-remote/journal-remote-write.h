@@ -19,6 +19,8 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <pthread.h>
+
 #include "journal-file.h"
 #include "journal-importer.h"
 
@@ -34,6 +36,9 @@ typedef struct Writer {
 
         uint64_t seqnum;
 
+        /* Serializes writes from sources processed by different threads */
+        pthread_mutex_t lock;
+
         int n_ref;
 } Writer;
 
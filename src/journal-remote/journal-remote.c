@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -55,6 +56,11 @@
 #define CERT_FILE     CERTIFICATE_ROOT "/certs/journal-remote.pem"
 #define TRUST_FILE    CERTIFICATE_ROOT "/ca/trusted.pem"
 
+#define THREADS_MAX 256U
+
+/* How long worker threads stop accepting connections when we ran out of file descriptors */
+#define ACCEPT_RETRY_USEC (1 * USEC_PER_SEC)
+
 static char* arg_url = NULL;
 static char* arg_getter = NULL;
 static char* arg_listen_raw = NULL;
@@ -68,6 +74,7 @@ static char** arg_gnutls_log = NULL;
 
 static JournalWriteSplitMode arg_split_mode = _JOURNAL_WRITE_SPLIT_INVALID;
 static char* arg_output = NULL;
+static unsigned arg_threads = 0;
 
 static char *arg_key = NULL;
 static char *arg_cert = NULL;
@@ -232,11 +239,45 @@ static int init_writer_hashmap(RemoteServer *s) {
         return 0;
 }
 
+static int open_writer(RemoteServer *s, const void *key, const char *host, Writer **ret) {
+        Writer *w;
+        int r;
+
+        /* Called with the server lock taken */
+
+        w = writer_new(s);
+        if (!w)
+                return log_oom();
+
+        if (arg_split_mode == JOURNAL_WRITE_SPLIT_HOST) {
+                w->hashmap_key = strdup(key);
+                if (!w->hashmap_key) {
+                        r = log_oom();
+                        goto fail;
+                }
+        }
+
+        r = open_output(w, host);
+        if (r < 0)
+                goto fail;
+
+        r = hashmap_put(s->writers, w->hashmap_key ?: key, w);
+        if (r < 0)
+                goto fail;
+
+        *ret = w;
+        return 0;
+
+fail:
+        writer_free(w);
+        return r;
+}
+
 static int get_writer(RemoteServer *s, const char *host,
                       Writer **writer) {
         const void *key;
-        _cleanup_writer_unref_ Writer *w = NULL;
-        int r;
+        Writer *w;
+        int r = 0;
 
         switch(arg_split_mode) {
         case JOURNAL_WRITE_SPLIT_NONE:
@@ -252,31 +293,20 @@ static int get_writer(RemoteServer *s, const char *host,
                 assert_not_reached("what split mode?");
         }
 
+        assert_se(pthread_mutex_lock(&s->lock) == 0);
+
         w = hashmap_get(s->writers, key);
         if (w)
                 writer_ref(w);
-        else {
-                w = writer_new(s);
-                if (!w)
-                        return log_oom();
-
-                if (arg_split_mode == JOURNAL_WRITE_SPLIT_HOST) {
-                        w->hashmap_key = strdup(key);
-                        if (!w->hashmap_key)
-                                return log_oom();
-                }
+        else
+                r = open_writer(s, key, host, &w);
 
-                r = open_output(w, host);
-                if (r < 0)
-                        return r;
+        assert_se(pthread_mutex_unlock(&s->lock) == 0);
 
-                r = hashmap_put(s->writers, w->hashmap_key ?: key, w);
-                if (r < 0)
-                        return r;
-        }
+        if (r < 0)
+                return r;
 
         *writer = w;
-        w = NULL;
         return 0;
 }
 
@@ -303,6 +333,8 @@ static int dispatch_http_event(sd_event_source *event,
                                int fd,
                                uint32_t revents,
                                void *userdata);
+static int setup_workers(RemoteServer *s);
+static void stop_workers(RemoteServer *s);
 
 static int get_source_for_fd(RemoteServer *s,
                              int fd, char *name, RemoteSource **source) {
@@ -314,46 +346,67 @@ static int get_source_for_fd(RemoteServer *s,
         assert(fd >= 0);
         assert(source);
 
-        if (!GREEDY_REALLOC0(s->sources, s->sources_size, fd + 1))
-                return log_oom();
-
         r = get_writer(s, name, &writer);
         if (r < 0)
                 return log_warning_errno(r, "Failed to get writer for source %s: %m",
                                          name);
 
+        assert_se(pthread_mutex_lock(&s->lock) == 0);
+
+        if (!GREEDY_REALLOC0(s->sources, s->sources_size, fd + 1)) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
         if (s->sources[fd] == NULL) {
                 s->sources[fd] = source_new(fd, false, name, writer);
                 if (!s->sources[fd]) {
-                        writer_unref(writer);
-                        return log_oom();
+                        r = -ENOMEM;
+                        goto finish;
                 }
 
+                writer = NULL;
                 s->active++;
         }
 
         *source = s->sources[fd];
-        return 0;
+
+finish:
+        assert_se(pthread_mutex_unlock(&s->lock) == 0);
+
+        /* Either we failed, or the source already existed */
+        writer_unref(writer);
+
+        if (r == -ENOMEM)
+                return log_oom();
+
+        return r;
 }
 
 static int remove_source(RemoteServer *s, int fd) {
         RemoteSource *source;
 
         assert(s);
+
+        assert_se(pthread_mutex_lock(&s->lock) == 0);
+
         assert(fd >= 0 && fd < (ssize_t) s->sources_size);
 
         source = s->sources[fd];
         if (source) {
-                /* this closes fd too */
-                source_free(source);
                 s->sources[fd] = NULL;
                 s->active--;
         }
 
+        assert_se(pthread_mutex_unlock(&s->lock) == 0);
+
+        /* this closes fd too */
+        source_free(source);
+
         return 0;
 }
 
-static int add_source(RemoteServer *s, int fd, char* name, bool own_name) {
+static int add_source(RemoteServer *s, sd_event *events, int fd, char* name, bool own_name) {
 
         RemoteSource *source = NULL;
         int r;
@@ -361,6 +414,7 @@ static int add_source(RemoteServer *s, int fd, char* name, bool own_name) {
         /* This takes ownership of name, even on failure, if own_name is true. */
 
         assert(s);
+        assert(events);
         assert(fd >= 0);
         assert(name);
 
@@ -378,19 +432,19 @@ static int add_source(RemoteServer *s, int fd, char* name, bool own_name) {
                 return r;
         }
 
-        r = sd_event_add_io(s->events, &source->event,
+        r = sd_event_add_io(events, &source->event,
                             fd, EPOLLIN|EPOLLRDHUP|EPOLLPRI,
                             dispatch_raw_source_event, source);
         if (r == 0) {
                 /* Add additional source for buffer processing. It will be
                  * enabled later. */
-                r = sd_event_add_defer(s->events, &source->buffer_event,
+                r = sd_event_add_defer(events, &source->buffer_event,
                                        dispatch_raw_source_until_block, source);
                 if (r == 0)
                         sd_event_source_set_enabled(source->buffer_event, SD_EVENT_OFF);
         } else if (r == -EPERM) {
                 log_debug("Falling back to sd_event_add_defer for fd:%d (%s)", fd, name);
-                r = sd_event_add_defer(s->events, &source->event,
+                r = sd_event_add_defer(events, &source->event,
                                        dispatch_blocking_source_event, source);
                 if (r == 0)
                         sd_event_source_set_enabled(source->event, SD_EVENT_ON);
@@ -421,6 +475,18 @@ static int add_raw_socket(RemoteServer *s, int fd) {
 
         assert(fd >= 0);
 
+        if (arg_threads > 0) {
+                /* The worker threads will listen on it, they are started once all sockets are set up */
+                if (!GREEDY_REALLOC(s->listen_raw_fds, s->listen_raw_fds_allocated, s->n_listen_raw_fds + 1))
+                        return log_oom();
+
+                s->listen_raw_fds[s->n_listen_raw_fds++] = fd;
+
+                fd_ = -1;
+                s->active++;
+                return 0;
+        }
+
         r = sd_event_add_io(s->events, &s->listen_event,
                             fd, EPOLLIN,
                             dispatch_raw_connection_event, s);
@@ -452,7 +518,7 @@ static int setup_raw_socket(RemoteServer *s, const char *address) {
  **********************************************************************
  **********************************************************************/
 
-static int request_meta(void **connection_cls, int fd, char *hostname) {
+static int request_meta(void **connection_cls, int fd, char *hostname, const char *encoding) {
         RemoteSource *source;
         Writer *writer;
         int r;
@@ -472,6 +538,14 @@ static int request_meta(void **connection_cls, int fd, char *hostname) {
                 return log_oom();
         }
 
+        r = source_set_encoding(source, encoding);
+        if (r < 0) {
+                /* The hostname is freed by our caller */
+                source->importer.name = NULL;
+                source_free(source);
+                return log_warning_errno(r, "Failed to set up decoding of %s data: %m", encoding);
+        }
+
         log_debug("Added RemoteSource as connection metadata %p", source);
 
         *connection_cls = source;
@@ -494,6 +568,27 @@ static void request_meta_free(void *cls,
         }
 }
 
+static int respond_unsupported_media_type(struct MHD_Connection *connection, const char *message) {
+        struct MHD_Response *response;
+        int r;
+
+        assert(connection);
+        assert(message);
+
+        /* Tell the client which encodings we accept, so that it can fall back to one of them, see RFC 7694 */
+
+        response = MHD_create_response_from_buffer(strlen(message), (char*) message, MHD_RESPMEM_PERSISTENT);
+        if (!response)
+                return MHD_NO;
+
+        MHD_add_response_header(response, "Content-Type", "text/plain");
+        MHD_add_response_header(response, "Accept-Encoding", SOURCE_ENCODINGS);
+        r = MHD_queue_response(connection, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE, response);
+        MHD_destroy_response(response);
+
+        return r;
+}
+
 static int process_http_upload(
                 struct MHD_Connection *connection,
                 const char *upload_data,
@@ -512,8 +607,10 @@ static int process_http_upload(
         if (*upload_data_size) {
                 log_trace("Received %zu bytes", *upload_data_size);
 
-                r = journal_importer_push_data(&source->importer,
-                                               upload_data, *upload_data_size);
+                r = source_push_data(source, upload_data, *upload_data_size);
+                if (r == -EBADMSG)
+                        return mhd_respond(connection, MHD_HTTP_BAD_REQUEST,
+                                           "Failed to decompress data.");
                 if (r < 0)
                         return mhd_respond_oom(connection);
 
@@ -565,7 +662,7 @@ static int request_handler(
                 size_t *upload_data_size,
                 void **connection_cls) {
 
-        const char *header;
+        const char *header, *encoding;
         int r, code, fd;
         _cleanup_free_ char *hostname = NULL;
 
@@ -589,9 +686,15 @@ static int request_handler(
 
         header = MHD_lookup_connection_value(connection,
                                              MHD_HEADER_KIND, "Content-Type");
-        if (!header || !streq(header, "application/vnd.fdo.journal"))
-                return mhd_respond(connection, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE,
-                                   "Content-Type: application/vnd.fdo.journal is required.");
+        if (!header || !STR_IN_SET(header, "application/vnd.fdo.journal", "application/vnd.fdo.journal+binary"))
+                return respond_unsupported_media_type(connection,
+                                                      "Content-Type: application/vnd.fdo.journal is required.");
+
+        encoding = MHD_lookup_connection_value(connection,
+                                               MHD_HEADER_KIND, "Content-Encoding");
+        if (!source_encoding_supported(encoding))
+                return respond_unsupported_media_type(connection,
+                                                      "Content-Encoding: " SOURCE_ENCODINGS " is required.");
 
         {
                 const union MHD_ConnectionInfo *ci;
@@ -621,7 +724,7 @@ static int request_handler(
 
         assert(hostname);
 
-        r = request_meta(connection_cls, fd, hostname);
+        r = request_meta(connection_cls, fd, hostname, encoding);
         if (r == -ENOMEM)
                 return respond_oom(connection);
         else if (r < 0)
@@ -631,6 +734,38 @@ static int request_handler(
         return MHD_YES;
 }
 
+static int setup_microhttpd_event(RemoteServer *s, MHDDaemonWrapper *d) {
+        const union MHD_DaemonInfo *info;
+        int r, epoll_fd;
+
+        assert(s);
+        assert(d);
+
+        info = MHD_get_daemon_info(d->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY);
+        if (!info) {
+                log_error("µhttp returned NULL daemon info");
+                return -EOPNOTSUPP;
+        }
+
+        epoll_fd = info->listen_fd;
+        if (epoll_fd < 0) {
+                log_error("µhttp epoll fd is invalid");
+                return -EUCLEAN;
+        }
+
+        r = sd_event_add_io(s->events, &d->event,
+                            epoll_fd, EPOLLIN,
+                            dispatch_http_event, d);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add event callback: %m");
+
+        r = sd_event_source_set_description(d->event, "epoll-fd");
+        if (r < 0)
+                return log_error_errno(r, "Failed to set source name: %m");
+
+        return 0;
+}
+
 static int setup_microhttpd_server(RemoteServer *s,
                                    int fd,
                                    const char *key,
@@ -645,6 +780,7 @@ static int setup_microhttpd_server(RemoteServer *s,
                 { MHD_OPTION_END},
                 { MHD_OPTION_END},
                 { MHD_OPTION_END},
+                { MHD_OPTION_END},
                 { MHD_OPTION_END}};
         int opts_pos = 4;
         int flags =
@@ -653,9 +789,8 @@ static int setup_microhttpd_server(RemoteServer *s,
                 MHD_USE_EPOLL |
                 MHD_USE_ITC;
 
-        const union MHD_DaemonInfo *info;
-        int r, epoll_fd;
         MHDDaemonWrapper *d;
+        int r;
 
         assert(fd >= 0);
 
@@ -692,7 +827,15 @@ static int setup_microhttpd_server(RemoteServer *s,
                                 {MHD_OPTION_HTTPS_MEM_TRUST, 0, (char*) trust};
         }
 
-        d = new(MHDDaemonWrapper, 1);
+        if (arg_threads > 0) {
+                /* Let µhttpd run the connections in its own pool of threads, instead of from our event loop */
+                opts[opts_pos++] = (struct MHD_OptionItem)
+                        {MHD_OPTION_THREAD_POOL_SIZE, arg_threads};
+
+                flags |= MHD_USE_INTERNAL_POLLING_THREAD;
+        }
+
+        d = new0(MHDDaemonWrapper, 1);
         if (!d)
                 return log_oom();
 
@@ -712,33 +855,10 @@ static int setup_microhttpd_server(RemoteServer *s,
         log_debug("Started MHD %s daemon on fd:%d (wrapper @ %p)",
                   key ? "HTTPS" : "HTTP", fd, d);
 
-
-        info = MHD_get_daemon_info(d->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY);
-        if (!info) {
-                log_error("µhttp returned NULL daemon info");
-                r = -EOPNOTSUPP;
-                goto error;
-        }
-
-        epoll_fd = info->listen_fd;
-        if (epoll_fd < 0) {
-                log_error("µhttp epoll fd is invalid");
-                r = -EUCLEAN;
-                goto error;
-        }
-
-        r = sd_event_add_io(s->events, &d->event,
-                            epoll_fd, EPOLLIN,
-                            dispatch_http_event, d);
-        if (r < 0) {
-                log_error_errno(r, "Failed to add event callback: %m");
-                goto error;
-        }
-
-        r = sd_event_source_set_description(d->event, "epoll-fd");
-        if (r < 0) {
-                log_error_errno(r, "Failed to set source name: %m");
-                goto error;
+        if (arg_threads == 0) {
+                r = setup_microhttpd_event(s, d);
+                if (r < 0)
+                        goto error;
         }
 
         r = hashmap_ensure_allocated(&s->daemons, &uint64_hash_ops);
@@ -757,6 +877,7 @@ static int setup_microhttpd_server(RemoteServer *s,
         return 0;
 
 error:
+        sd_event_source_unref(d->event);
         MHD_stop_daemon(d->daemon);
         free(d->daemon);
         free(d);
@@ -847,6 +968,8 @@ static int remoteserver_init(RemoteServer *s,
                 return -EINVAL;
         }
 
+        assert_se(pthread_mutex_init(&s->lock, NULL) == 0);
+
         r = sd_event_default(&s->events);
         if (r < 0)
                 return log_error_errno(r, "Failed to allocate event loop: %m");
@@ -890,7 +1013,7 @@ static int remoteserver_init(RemoteServer *s,
 
                         log_debug("Received a connection socket (fd:%d) from %s", fd, hostname);
 
-                        r = add_source(s, fd, hostname, true);
+                        r = add_source(s, s->events, fd, hostname, true);
                 } else {
                         log_error("Unknown socket passed on fd:%d", fd);
 
@@ -908,7 +1031,7 @@ static int remoteserver_init(RemoteServer *s,
                 if (fd < 0)
                         return fd;
 
-                r = add_source(s, fd, (char*) arg_output, false);
+                r = add_source(s, s->events, fd, (char*) arg_output, false);
                 if (r < 0)
                         return r;
         }
@@ -942,7 +1065,7 @@ static int remoteserver_init(RemoteServer *s,
                 if ((p = strchr(hostname, ':')))
                         *p = '\0';
 
-                r = add_source(s, fd, hostname, false);
+                r = add_source(s, s->events, fd, hostname, false);
                 if (r < 0)
                         return r;
         }
@@ -983,7 +1106,7 @@ static int remoteserver_init(RemoteServer *s,
                         output_name = *file;
                 }
 
-                r = add_source(s, fd, (char*) output_name, false);
+                r = add_source(s, s->events, fd, (char*) output_name, false);
                 if (r < 0)
                         return r;
         }
@@ -1002,6 +1125,12 @@ static int remoteserver_init(RemoteServer *s,
                         return r;
         }
 
+        if (arg_threads > 0) {
+                r = setup_workers(s);
+                if (r < 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -1009,6 +1138,9 @@ static void server_destroy(RemoteServer *s) {
         size_t i;
         MHDDaemonWrapper *d;
 
+        /* After this we are the only thread around, except for µhttpd's, which are stopped next */
+        stop_workers(s);
+
         while ((d = hashmap_steal_first(s->daemons))) {
                 MHD_stop_daemon(d->daemon);
                 sd_event_source_unref(d->event);
@@ -1022,6 +1154,21 @@ static void server_destroy(RemoteServer *s) {
                 remove_source(s, i);
         free(s->sources);
 
+        for (i = 0; i < s->n_workers; i++) {
+                RemoteWorker *w = s->workers + i;
+                size_t j;
+
+                if (w->listen_events)
+                        for (j = 0; j < s->n_listen_raw_fds; j++)
+                                sd_event_source_unref(w->listen_events[j]);
+                free(w->listen_events);
+                sd_event_source_unref(w->accept_retry_event);
+                sd_event_unref(w->events);
+                safe_close(w->exit_fd);
+        }
+        free(s->workers);
+        free(s->listen_raw_fds);
+
         writer_unref(s->_single_writer);
         hashmap_free(s->writers);
 
@@ -1030,6 +1177,8 @@ static void server_destroy(RemoteServer *s) {
         sd_event_source_unref(s->listen_event);
         sd_event_unref(s->events);
 
+        assert_se(pthread_mutex_destroy(&s->lock) == 0);
+
         /* fds that we're listening on remain open... */
 }
 
@@ -1038,20 +1187,17 @@ static void server_destroy(RemoteServer *s) {
  **********************************************************************/
 
 static int handle_raw_source(sd_event_source *event,
-                             int fd,
-                             uint32_t revents,
+                             RemoteSource *source,
                              RemoteServer *s) {
 
-        RemoteSource *source;
-        int r;
+        int fd, r;
 
         /* Returns 1 if there might be more data pending,
          * 0 if data is currently exhausted, negative on error.
          */
 
-        assert(fd >= 0 && fd < (ssize_t) s->sources_size);
-        source = s->sources[fd];
-        assert(source->importer.fd == fd);
+        assert(source);
+        fd = source->importer.fd;
 
         r = process_source(source, arg_compress, arg_seal);
         if (journal_importer_eof(&source->importer)) {
@@ -1073,7 +1219,7 @@ static int handle_raw_source(sd_event_source *event,
                 return 0;
         } else if (r < 0) {
                 log_debug_errno(r, "Closing connection: %m");
-                remove_source(server, fd);
+                remove_source(s, fd);
                 return 0;
         } else
                 return 1;
@@ -1087,7 +1233,7 @@ static int dispatch_raw_source_until_block(sd_event_source *event,
         /* Make sure event stays around even if source is destroyed */
         sd_event_source_ref(event);
 
-        r = handle_raw_source(event, source->importer.fd, EPOLLIN, server);
+        r = handle_raw_source(event, source, server);
         if (r != 1)
                 /* No more data for now */
                 sd_event_source_set_enabled(event, SD_EVENT_OFF);
@@ -1107,7 +1253,9 @@ static int dispatch_raw_source_event(sd_event_source *event,
         assert(source->event);
         assert(source->buffer_event);
 
-        r = handle_raw_source(event, fd, EPOLLIN, server);
+        assert(source->importer.fd == fd);
+
+        r = handle_raw_source(event, source, server);
         if (r == 1)
                 /* Might have more data. We need to rerun the handler
                  * until we are sure the buffer is exhausted. */
@@ -1120,7 +1268,7 @@ static int dispatch_blocking_source_event(sd_event_source *event,
                                           void *userdata) {
         RemoteSource *source = userdata;
 
-        return handle_raw_source(event, source->importer.fd, EPOLLIN, server);
+        return handle_raw_source(event, source, server);
 }
 
 static int accept_connection(const char* type, int fd,
@@ -1129,8 +1277,12 @@ static int accept_connection(const char* type, int fd,
 
         log_debug("Accepting new %s connection on fd:%d", type, fd);
         fd2 = accept4(fd, &addr->sockaddr.sa, &addr->size, SOCK_NONBLOCK|SOCK_CLOEXEC);
-        if (fd2 < 0)
+        if (fd2 < 0) {
+                if (errno == EAGAIN) /* Another thread was faster */
+                        return -EAGAIN;
+
                 return log_error_errno(errno, "accept() on fd:%d failed: %m", fd);
+        }
 
         switch(socket_address_family(addr)) {
         case AF_INET:
@@ -1186,7 +1338,193 @@ static int dispatch_raw_connection_event(sd_event_source *event,
         if (fd2 < 0)
                 return fd2;
 
-        return add_source(s, fd2, hostname, true);
+        return add_source(s, s->events, fd2, hostname, true);
+}
+
+/**********************************************************************
+ **********************************************************************
+ **********************************************************************/
+
+static int dispatch_worker_accept_retry(sd_event_source *event,
+                                       uint64_t usec,
+                                       void *userdata) {
+        RemoteWorker *w = userdata;
+        size_t i;
+        int r;
+
+        for (i = 0; i < w->server->n_listen_raw_fds; i++) {
+                r = sd_event_source_set_enabled(w->listen_events[i], SD_EVENT_ON);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to resume listening on fd:%d: %m", w->server->listen_raw_fds[i]);
+        }
+
+        return 0;
+}
+
+static int worker_pause_accepting(RemoteWorker *w) {
+        char ts[FORMAT_TIMESPAN_MAX];
+        usec_t until;
+        size_t i;
+        int r;
+
+        assert(w);
+
+        r = sd_event_now(w->events, CLOCK_MONOTONIC, &until);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get current time: %m");
+
+        until = usec_add(until, ACCEPT_RETRY_USEC);
+
+        if (w->accept_retry_event) {
+                r = sd_event_source_set_time(w->accept_retry_event, until);
+                if (r >= 0)
+                        r = sd_event_source_set_enabled(w->accept_retry_event, SD_EVENT_ONESHOT);
+        } else
+                r = sd_event_add_time(w->events, &w->accept_retry_event,
+                                      CLOCK_MONOTONIC, until, 0,
+                                      dispatch_worker_accept_retry, w);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set up timer to resume accepting connections: %m");
+
+        for (i = 0; i < w->server->n_listen_raw_fds; i++)
+                (void) sd_event_source_set_enabled(w->listen_events[i], SD_EVENT_OFF);
+
+        log_warning("Out of file descriptors, not accepting connections for %s.",
+                    format_timespan(ts, sizeof(ts), ACCEPT_RETRY_USEC, 0));
+        return 0;
+}
+
+static int dispatch_worker_connection_event(sd_event_source *event,
+                                            int fd,
+                                            uint32_t revents,
+                                            void *userdata) {
+        RemoteWorker *w = userdata;
+        int fd2;
+        SocketAddress addr = {
+                .size = sizeof(union sockaddr_union),
+                .type = SOCK_STREAM,
+        };
+        char *hostname = NULL;
+
+        /* All workers listen on the same sockets, whoever accepts a connection processes it. Errors are logged
+         * already, and must not disable the listening socket for this worker. */
+
+        fd2 = accept_connection("raw", fd, &addr, &hostname);
+        if (IN_SET(fd2, -EMFILE, -ENFILE))
+                /* The pending connection keeps the socket readable, don't spin on it until fds are freed again */
+                (void) worker_pause_accepting(w);
+        if (fd2 < 0)
+                return 0;
+
+        (void) add_source(w->server, w->events, fd2, hostname, true);
+        return 0;
+}
+
+static int dispatch_worker_exit(sd_event_source *event,
+                                int fd,
+                                uint32_t revents,
+                                void *userdata) {
+
+        return sd_event_exit(sd_event_source_get_event(event), 0);
+}
+
+static void *worker_thread(void *userdata) {
+        RemoteWorker *w = userdata;
+        int r;
+
+        r = sd_event_loop(w->events);
+        if (r < 0)
+                log_error_errno(r, "Failed to run worker event loop: %m");
+
+        return NULL;
+}
+
+static int setup_worker(RemoteServer *s, RemoteWorker *w) {
+        size_t i;
+        int r;
+
+        assert(s);
+        assert(w);
+
+        w->server = s;
+
+        r = sd_event_new(&w->events);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate worker event loop: %m");
+
+        w->exit_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->exit_fd < 0)
+                return log_error_errno(errno, "Failed to allocate eventfd: %m");
+
+        r = sd_event_add_io(w->events, NULL, w->exit_fd, EPOLLIN, dispatch_worker_exit, w);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add exit event source: %m");
+
+        w->listen_events = new0(sd_event_source*, s->n_listen_raw_fds);
+        if (!w->listen_events)
+                return log_oom();
+
+        for (i = 0; i < s->n_listen_raw_fds; i++) {
+                r = sd_event_add_io(w->events, &w->listen_events[i],
+                                    s->listen_raw_fds[i], EPOLLIN,
+                                    dispatch_worker_connection_event, w);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add listening socket to worker event loop: %m");
+        }
+
+        r = pthread_create(&w->thread, NULL, worker_thread, w);
+        if (r > 0)
+                return log_error_errno(r, "Failed to start worker thread: %m");
+
+        w->running = true;
+        return 0;
+}
+
+static int setup_workers(RemoteServer *s) {
+        int r;
+
+        assert(s);
+
+        if (s->n_listen_raw_fds == 0)
+                return 0;
+
+        /* The signals we handle are blocked already, and new threads inherit that, hence they only get delivered to
+         * the main thread */
+
+        s->workers = new0(RemoteWorker, arg_threads);
+        if (!s->workers)
+                return log_oom();
+
+        for (; s->n_workers < arg_threads; s->n_workers++) {
+                s->workers[s->n_workers].exit_fd = -1;
+
+                r = setup_worker(s, s->workers + s->n_workers);
+                if (r < 0) {
+                        /* Not started, but needs to be cleaned up */
+                        s->n_workers++;
+                        return r;
+                }
+        }
+
+        log_debug("Started %u worker threads.", s->n_workers);
+        return 0;
+}
+
+static void stop_workers(RemoteServer *s) {
+        unsigned i;
+
+        assert(s);
+
+        for (i = 0; i < s->n_workers; i++) {
+                RemoteWorker *w = s->workers + i;
+
+                if (!w->running)
+                        continue;
+
+                (void) eventfd_write(w->exit_fd, 1);
+                (void) pthread_join(w->thread, NULL);
+                w->running = false;
+        }
 }
 
 /**********************************************************************
@@ -1241,6 +1579,7 @@ static void help(void) {
                "     --gnutls-log=CATEGORY...\n"
                "                            Specify a list of gnutls logging categories\n"
                "     --split-mode=none|host How many output files to create\n"
+               "     --threads=N            Process network connections in N threads\n"
                "\n"
                "Note: file descriptors from sd_listen_fds() will be consumed, too.\n"
                , program_invocation_short_name);
@@ -1261,6 +1600,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CERT,
                 ARG_TRUST,
                 ARG_GNUTLS_LOG,
+                ARG_THREADS,
         };
 
         static const struct option options[] = {
@@ -1279,6 +1619,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "cert",         required_argument, NULL, ARG_CERT         },
                 { "trust",        required_argument, NULL, ARG_TRUST        },
                 { "gnutls-log",   required_argument, NULL, ARG_GNUTLS_LOG   },
+                { "threads",      required_argument, NULL, ARG_THREADS      },
                 {}
         };
 
@@ -1466,6 +1807,18 @@ static int parse_argv(int argc, char *argv[]) {
 #endif
                 }
 
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --threads= argument: %s", optarg);
+
+                        if (arg_threads > THREADS_MAX) {
+                                log_error("Too many threads requested, at most %u are supported.", THREADS_MAX);
+                                return -EINVAL;
+                        }
+
+                        break;
+
                 case '?':
                         return -EINVAL;
 
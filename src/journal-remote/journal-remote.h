@@ -19,6 +19,8 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <pthread.h>
+
 #include "sd-event.h"
 
 #include "hashmap.h"
@@ -35,6 +37,22 @@ struct MHDDaemonWrapper {
         sd_event_source *event;
 };
 
+typedef struct RemoteWorker RemoteWorker;
+
+struct RemoteWorker {
+        RemoteServer *server;
+
+        pthread_t thread;
+        bool running;
+
+        sd_event *events;
+        int exit_fd;
+
+        /* One for each of the server's listen_raw_fds */
+        sd_event_source **listen_events;
+        sd_event_source *accept_retry_event;
+};
+
 struct RemoteServer {
         RemoteSource **sources;
         size_t sources_size;
@@ -49,4 +67,15 @@ struct RemoteServer {
 
         bool check_trust;
         Hashmap *daemons;
+
+        /* With --threads= connections on raw sockets are accepted and processed by worker threads, each running its
+         * own event loop */
+        int *listen_raw_fds;
+        size_t n_listen_raw_fds, listen_raw_fds_allocated;
+        RemoteWorker *workers;
+        unsigned n_workers;
+
+        /* Protects sources, active and writers (including the reference counts of the writers), which are shared
+         * with worker threads and µhttpd's threads */
+        pthread_mutex_t lock;
 };
@@ -151,7 +151,10 @@ static ssize_t write_entry(char *buf, size_t size, Uploader *u) {
                                 continue;
                         }
 
-                        if (!utf8_is_printable_newline(u->field_data,
+                        /* In the binary protocol every field is sent with its size, so that neither we nor
+                         * the receiver need to look at the data itself */
+                        if (u->binary ||
+                            !utf8_is_printable_newline(u->field_data,
                                                        u->field_length, false)) {
                                 u->entry_state = ENTRY_BINARY_FIELD_START;
                                 continue;
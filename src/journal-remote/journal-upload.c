@@ -39,6 +39,7 @@
 #include "sigbus.h"
 #include "signal-util.h"
 #include "string-util.h"
+#include "strv.h"
 #include "util.h"
 
 #define PRIV_KEY_FILE CERTIFICATE_ROOT "/private/journal-upload.pem"
@@ -59,6 +60,7 @@ static const char *arg_machine = NULL;
 static bool arg_merge = false;
 static int arg_follow = -1;
 static const char *arg_save_state = NULL;
+static int arg_compress = true;
 
 static void close_fd_input(Uploader *u);
 
@@ -98,6 +100,35 @@ static size_t output_callback(char *buf,
         return size * nmemb;
 }
 
+static size_t header_callback(char *buf,
+                              size_t size,
+                              size_t nmemb,
+                              void *userp) {
+        Uploader *u = userp;
+        _cleanup_strv_free_ char **l = NULL;
+        const char *line, *v;
+
+        assert(u);
+
+        /* Remember the encodings a new enough server advertises when it refuses our data */
+
+        line = strndupa(buf, size*nmemb);
+        v = startswith_no_case(line, "Accept-Encoding:");
+        if (!v)
+                return size * nmemb;
+
+        l = strv_split(v, ", \t\r\n");
+        if (!l) {
+                log_oom();
+                return 0;
+        }
+
+        u->accept_encoding_seen = true;
+        u->accept_encoding_zstd = strv_contains(l, "zstd");
+
+        return size * nmemb;
+}
+
 static int check_cursor_updating(Uploader *u) {
         _cleanup_free_ char *temp_path = NULL;
         _cleanup_fclose_ FILE *f = NULL;
@@ -180,37 +211,160 @@ static int load_cursor_state(Uploader *u) {
 
 
 
-int start_upload(Uploader *u,
-                 size_t (*input_callback)(void *ptr,
-                                          size_t size,
-                                          size_t nmemb,
-                                          void *userdata),
-                 void *data) {
-        CURLcode code;
+#ifdef HAVE_ZSTD
+static size_t compressed_input_callback(void *buf, size_t size, size_t nmemb, Uploader *u) {
+        ZSTD_outBuffer out = {
+                .dst = buf,
+                .size = size * nmemb,
+        };
+        size_t k, n;
 
         assert(u);
-        assert(input_callback);
+        assert(u->zstd);
+
+        /* Compress the data provided by the real input callback into one zstd frame per upload. The compressed
+         * data is flushed whenever the input callback runs dry, so that follow mode does not add latency. */
+
+        while (out.pos < out.size) {
+                switch (u->compress_state) {
+
+                case COMPRESS_INPUT:
+                        if (u->zstd_in.pos >= u->zstd_in.size) {
+                                n = u->input_callback(u->zstd_buffer, 1, ZSTD_CStreamInSize(), u->input_data);
+                                if (n == CURL_READFUNC_ABORT)
+                                        return n;
+                                if (n == 0) {
+                                        u->compress_state = COMPRESS_END;
+                                        continue;
+                                }
 
-        if (!u->header) {
-                struct curl_slist *h;
+                                u->zstd_in = (ZSTD_inBuffer) {
+                                        .src = u->zstd_buffer,
+                                        .size = n,
+                                };
+                        }
 
-                h = curl_slist_append(NULL, "Content-Type: application/vnd.fdo.journal");
-                if (!h)
-                        return log_oom();
+                        k = ZSTD_compressStream(u->zstd, &out, &u->zstd_in);
+                        if (ZSTD_isError(k)) {
+                                log_error("Failed to compress upload data: %s", ZSTD_getErrorName(k));
+                                return CURL_READFUNC_ABORT;
+                        }
 
-                h = curl_slist_append(h, "Transfer-Encoding: chunked");
-                if (!h) {
-                        curl_slist_free_all(h);
-                        return log_oom();
+                        if (u->zstd_in.pos >= u->zstd_in.size)
+                                u->compress_state = COMPRESS_FLUSH;
+                        break;
+
+                case COMPRESS_FLUSH:
+                        k = ZSTD_flushStream(u->zstd, &out);
+                        if (ZSTD_isError(k)) {
+                                log_error("Failed to compress upload data: %s", ZSTD_getErrorName(k));
+                                return CURL_READFUNC_ABORT;
+                        }
+
+                        if (k == 0) {
+                                /* Everything we got so far is out, hand it over before asking for more */
+                                u->compress_state = COMPRESS_INPUT;
+                                return out.pos;
+                        }
+                        break;
+
+                case COMPRESS_END:
+                        k = ZSTD_endStream(u->zstd, &out);
+                        if (ZSTD_isError(k)) {
+                                log_error("Failed to compress upload data: %s", ZSTD_getErrorName(k));
+                                return CURL_READFUNC_ABORT;
+                        }
+
+                        if (k == 0)
+                                u->compress_state = COMPRESS_DONE;
+                        break;
+
+                case COMPRESS_DONE:
+                        return out.pos;
+
+                default:
+                        assert_not_reached("Unknown compression state");
                 }
+        }
+
+        return out.pos;
+}
+#endif
+
+static size_t upload_input_callback(void *buf, size_t size, size_t nmemb, void *userp) {
+        Uploader *u = userp;
+        size_t n;
 
-                h = curl_slist_append(h, "Accept: text/plain");
+        assert(u);
+
+#ifdef HAVE_ZSTD
+        if (u->compress)
+                n = compressed_input_callback(buf, size, nmemb, u);
+        else
+#endif
+                n = u->input_callback(buf, size, nmemb, u->input_data);
+
+        if (n != CURL_READFUNC_ABORT)
+                u->bytes_uploaded += n;
+
+        return n;
+}
+
+static int build_header(Uploader *u) {
+        struct curl_slist *h;
+
+        assert(u);
+
+        h = curl_slist_append(NULL,
+                              u->binary && u->journal ?
+                              "Content-Type: application/vnd.fdo.journal+binary" :
+                              "Content-Type: application/vnd.fdo.journal");
+        if (!h)
+                return log_oom();
+
+        h = curl_slist_append(h, "Transfer-Encoding: chunked");
+        if (!h) {
+                curl_slist_free_all(h);
+                return log_oom();
+        }
+
+        h = curl_slist_append(h, "Accept: text/plain");
+        if (!h) {
+                curl_slist_free_all(h);
+                return log_oom();
+        }
+
+        /* Make sure the server gets a chance to refuse our protocol before we send any data, so that we can
+         * fall back without having to rewind the input */
+        h = curl_slist_append(h, "Expect: 100-continue");
+        if (!h) {
+                curl_slist_free_all(h);
+                return log_oom();
+        }
+
+        if (u->compress) {
+                h = curl_slist_append(h, "Content-Encoding: zstd");
                 if (!h) {
                         curl_slist_free_all(h);
                         return log_oom();
                 }
+        }
 
-                u->header = h;
+        u->header = h;
+        return 0;
+}
+
+int start_upload(Uploader *u, upload_callback_t input_callback, void *data) {
+        CURLcode code;
+        int r;
+
+        assert(u);
+        assert(input_callback);
+
+        if (!u->header) {
+                r = build_header(u);
+                if (r < 0)
+                        return r;
         }
 
         if (!u->easy) {
@@ -236,15 +390,17 @@ int start_upload(Uploader *u,
                 easy_setopt(curl, CURLOPT_WRITEDATA, data,
                             LOG_ERR, return -EXFULL);
 
-                /* set where to read from */
-                easy_setopt(curl, CURLOPT_READFUNCTION, input_callback,
+                easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback,
+                            LOG_ERR, return -EXFULL);
+
+                easy_setopt(curl, CURLOPT_HEADERDATA, u,
                             LOG_ERR, return -EXFULL);
 
-                easy_setopt(curl, CURLOPT_READDATA, data,
+                /* set where to read from */
+                easy_setopt(curl, CURLOPT_READFUNCTION, upload_input_callback,
                             LOG_ERR, return -EXFULL);
 
-                /* use our special own mime type and chunked transfer */
-                easy_setopt(curl, CURLOPT_HTTPHEADER, u->header,
+                easy_setopt(curl, CURLOPT_READDATA, u,
                             LOG_ERR, return -EXFULL);
 
                 if (_unlikely_(log_get_max_level() >= LOG_DEBUG))
@@ -282,6 +438,31 @@ int start_upload(Uploader *u,
                 u->answer = 0;
         }
 
+        /* use our special own mime type and chunked transfer, the header is rebuilt when the protocol is
+         * downgraded */
+        easy_setopt(u->easy, CURLOPT_HTTPHEADER, u->header,
+                    LOG_ERR, return -EXFULL);
+
+        u->input_callback = input_callback;
+        u->input_data = data;
+        u->bytes_uploaded = 0;
+        u->accept_encoding_seen = u->accept_encoding_zstd = false;
+
+#ifdef HAVE_ZSTD
+        if (u->compress) {
+                size_t k;
+
+                k = ZSTD_initCStream(u->zstd, 1);
+                if (ZSTD_isError(k)) {
+                        log_error("Failed to initialize compression: %s", ZSTD_getErrorName(k));
+                        return -ENOMEM;
+                }
+
+                u->zstd_in = (ZSTD_inBuffer) {};
+                u->compress_state = COMPRESS_INPUT;
+        }
+#endif
+
         /* upload to this place */
         code = curl_easy_setopt(u->easy, CURLOPT_URL, u->url);
         if (code) {
@@ -431,6 +612,18 @@ static int setup_uploader(Uploader *u, const char *url, const char *state_file)
 
         memzero(u, sizeof(Uploader));
         u->input = -1;
+        u->binary = true;
+
+#ifdef HAVE_ZSTD
+        if (arg_compress) {
+                u->zstd = ZSTD_createCStream();
+                u->zstd_buffer = malloc(ZSTD_CStreamInSize());
+                if (!u->zstd || !u->zstd_buffer)
+                        return log_oom();
+
+                u->compress = true;
+        }
+#endif
 
         if (!(host = startswith(url, "http://")) && !(host = startswith(url, "https://"))) {
                 host = url;
@@ -475,6 +668,11 @@ static void destroy_uploader(Uploader *u) {
         curl_slist_free_all(u->header);
         free(u->answer);
 
+#ifdef HAVE_ZSTD
+        ZSTD_freeCStream(u->zstd);
+        free(u->zstd_buffer);
+#endif
+
         free(u->last_cursor);
         free(u->current_cursor);
 
@@ -490,9 +688,31 @@ static void destroy_uploader(Uploader *u) {
         sd_event_unref(u->events);
 }
 
+static bool downgrade_protocol(Uploader *u) {
+        assert(u);
+
+        /* The server refused our data before we sent any of it. If it told us which encodings it accepts, it
+         * knows about the binary format, otherwise it is an older version which only knows the plain export
+         * format. */
+
+        if (u->compress && u->accept_encoding_seen && !u->accept_encoding_zstd) {
+                log_notice("Server %s does not support zstd compression, uploading uncompressed data.", u->url);
+                u->compress = false;
+        } else if (u->compress || (u->binary && u->journal)) {
+                log_notice("Server %s does not support the binary upload protocol, falling back to the export format.", u->url);
+                u->compress = u->binary = false;
+        } else
+                return false;
+
+        curl_slist_free_all(u->header);
+        u->header = NULL;
+        return true;
+}
+
 static int perform_upload(Uploader *u) {
         CURLcode code;
         long status;
+        int r;
 
         assert(u);
 
@@ -515,6 +735,14 @@ static int perform_upload(Uploader *u) {
                 return -EUCLEAN;
         }
 
+        if (status == 415 && u->bytes_uploaded == 0 && downgrade_protocol(u)) {
+                r = start_upload(u, u->input_callback, u->input_data);
+                if (r < 0)
+                        return r;
+
+                return perform_upload(u);
+        }
+
         if (status >= 300) {
                 log_error("Upload to %s failed with code %ld: %s",
                           u->url, status, strna(u->answer));
@@ -538,6 +766,7 @@ static int parse_config(void) {
                 { "Upload",  "ServerKeyFile",          config_parse_path,   0, &arg_key    },
                 { "Upload",  "ServerCertificateFile",  config_parse_path,   0, &arg_cert   },
                 { "Upload",  "TrustedCertificateFile", config_parse_path,   0, &arg_trust  },
+                { "Upload",  "Compress",               config_parse_bool,   0, &arg_compress },
                 {}};
 
         return config_parse_many_nulstr(PKGSYSCONFDIR "/journal-upload.conf",
@@ -570,6 +799,7 @@ static void help(void) {
                "     --follow[=BOOL]        Do [not] wait for input\n"
                "     --save-state[=FILE]    Save uploaded cursors (default \n"
                "                            " STATE_FILE ")\n"
+               "     --compress[=BOOL]      Do [not] compress the uploaded data\n"
                "  -h --help                 Show this help and exit\n"
                "     --version              Print version string and exit\n"
                , program_invocation_short_name);
@@ -588,6 +818,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_AFTER_CURSOR,
                 ARG_FOLLOW,
                 ARG_SAVE_STATE,
+                ARG_COMPRESS,
         };
 
         static const struct option options[] = {
@@ -607,6 +838,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "after-cursor", required_argument, NULL, ARG_AFTER_CURSOR   },
                 { "follow",       optional_argument, NULL, ARG_FOLLOW         },
                 { "save-state",   optional_argument, NULL, ARG_SAVE_STATE     },
+                { "compress",     optional_argument, NULL, ARG_COMPRESS       },
                 {}
         };
 
@@ -735,6 +967,20 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_save_state = optarg ?: STATE_FILE;
                         break;
 
+                case ARG_COMPRESS:
+                        if (optarg) {
+                                r = parse_boolean(optarg);
+                                if (r < 0) {
+                                        log_error("Failed to parse --compress= parameter.");
+                                        return -EINVAL;
+                                }
+
+                                arg_compress = !!r;
+                        } else
+                                arg_compress = true;
+
+                        break;
+
                 case '?':
                         log_error("Unknown option %s.", argv[optind-1]);
                         return -EINVAL;
@@ -2,6 +2,10 @@
 
 #include <inttypes.h>
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "sd-event.h"
 #include "sd-journal.h"
 #include "time-util.h"
@@ -20,6 +24,15 @@ typedef enum {
         ENTRY_DONE,                 /* Need to move to a new field. */
 } entry_state;
 
+typedef enum {
+        COMPRESS_INPUT,             /* Compressing input data. */
+        COMPRESS_FLUSH,             /* Input consumed, flushing compressed data. */
+        COMPRESS_END,               /* End of input, writing the end of the frame. */
+        COMPRESS_DONE,
+} compress_state;
+
+typedef size_t (*upload_callback_t)(void *ptr, size_t size, size_t nmemb, void *userdata);
+
 typedef struct Uploader {
         sd_event *events;
         sd_event_source *sigint_event, *sigterm_event;
@@ -31,6 +44,23 @@ typedef struct Uploader {
         struct curl_slist *header;
         char *answer;
 
+        /* protocol, downgraded if the server does not know about it */
+        bool binary;                /* Send all fields in binary form, as application/vnd.fdo.journal+binary */
+        bool compress;              /* Send data with Content-Encoding: zstd */
+        bool accept_encoding_zstd;  /* The server advertised zstd in Accept-Encoding */
+        bool accept_encoding_seen;
+
+        upload_callback_t input_callback;
+        void *input_data;
+        uint64_t bytes_uploaded;
+
+#ifdef HAVE_ZSTD
+        ZSTD_CStream *zstd;
+        void *zstd_buffer;
+        ZSTD_inBuffer zstd_in;
+        compress_state compress_state;
+#endif
+
         sd_event_source *input_event;
         uint64_t timeout;
 
@@ -55,12 +85,7 @@ typedef struct Uploader {
 
 #define JOURNAL_UPLOAD_POLL_TIMEOUT (10 * USEC_PER_SEC)
 
-int start_upload(Uploader *u,
-                 size_t (*input_callback)(void *ptr,
-                                          size_t size,
-                                          size_t nmemb,
-                                          void *userdata),
-                 void *data);
+int start_upload(Uploader *u, upload_callback_t input_callback, void *data);
 
 int open_journal_for_upload(Uploader *u,
                             sd_journal *j,
@@ -0,0 +1,146 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "io-util.h"
+#include "journal-file.h"
+#include "journal-gatewayd-tail.h"
+#include "log.h"
+#include "macro.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+
+#define N_FOLLOWERS 8U
+#define N_ENTRIES 500U
+
+typedef struct Reader {
+        Follower *follower;
+        bool even_only;
+        unsigned n_received;
+} Reader;
+
+static void *reader_thread(void *userdata) {
+        Reader *reader = userdata;
+        unsigned expected = 0;
+
+        /* Pop entries as they come and drop them right away, while the other readers do the same with the
+         * entries they share with this one */
+
+        while (expected < N_ENTRIES) {
+                char buf[DECIMAL_STR_MAX(unsigned) + 1];
+                TailEntry *e;
+
+                if (reader->even_only && expected % 2 != 0) {
+                        expected++;
+                        continue;
+                }
+
+                assert_se(follower_pop(reader->follower, 10 * USEC_PER_SEC, &e) == 1);
+                assert_se(!e->comment);
+
+                xsprintf(buf, "%u\n", expected);
+                assert_se(e->size == strlen(buf));
+                assert_se(memcmp(e->data, buf, e->size) == 0);
+
+                tail_entry_unref(e);
+
+                reader->n_received++;
+                expected++;
+        }
+
+        return NULL;
+}
+
+static void append_entry(JournalFile *f, unsigned i) {
+        char message[sizeof("MESSAGE=") + DECIMAL_STR_MAX(unsigned)];
+        struct iovec iovec[2];
+        dual_timestamp ts;
+
+        xsprintf(message, "MESSAGE=%u", i);
+        iovec[0] = IOVEC_MAKE_STRING(message);
+        iovec[1] = IOVEC_MAKE_STRING((i % 2 == 0 ? "PARITY=even" : "PARITY=odd"));
+
+        dual_timestamp_get(&ts);
+        assert_se(journal_file_append_entry(f, &ts, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) == 0);
+}
+
+static void test_concurrent_followers(void) {
+        char dir[] = "/tmp/test-journal-gatewayd-tail-XXXXXX";
+        char **even = STRV_MAKE("PARITY=even");
+        pthread_t threads[N_FOLLOWERS];
+        Reader readers[N_FOLLOWERS];
+        const char *path;
+        struct iovec start = IOVEC_INIT_STRING("MESSAGE=start");
+        JournalFile *f;
+        Tail *t;
+        unsigned i;
+
+        assert_se(mkdtemp(dir));
+        path = strjoina(dir, "/test.journal");
+
+        assert_se(journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, false, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        /* Something for the followers to attach to. This one is already behind the shared reader, and isn't
+         * sent. */
+        assert_se(journal_file_append_entry(f, NULL, &start, 1, NULL, NULL, NULL) == 0);
+
+        assert_se(tail_new(&t, dir) >= 0);
+
+        /* All followers use the same output mode, hence share the formatted entries */
+        for (i = 0; i < N_FOLLOWERS; i++) {
+                readers[i] = (Reader) {
+                        .even_only = i % 2 == 1,
+                };
+
+                assert_se(follower_new(&readers[i].follower, t, OUTPUT_CAT, readers[i].even_only ? even : NULL) >= 0);
+                assert_se(follower_start(readers[i].follower, NULL) >= 0);
+
+                assert_se(pthread_create(&threads[i], NULL, reader_thread, &readers[i]) == 0);
+        }
+
+        for (i = 0; i < N_ENTRIES; i++)
+                append_entry(f, i);
+
+        for (i = 0; i < N_FOLLOWERS; i++) {
+                assert_se(pthread_join(threads[i], NULL) == 0);
+
+                assert_se(readers[i].n_received == (readers[i].even_only ? N_ENTRIES / 2 : N_ENTRIES));
+                assert_se(readers[i].follower->n_dropped == 0);
+                assert_se(readers[i].follower->n_queued == 0);
+
+                follower_free(readers[i].follower);
+        }
+
+        /* The shared reader keeps running for the lifetime of the process, hence there is nothing else to
+         * free here */
+        journal_file_close(f);
+        assert_se(rm_rf(dir, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        test_concurrent_followers();
+
+        return 0;
+}
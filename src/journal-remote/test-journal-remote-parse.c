@@ -0,0 +1,280 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "journal-remote-parse.h"
+#include "journal-remote-write.h"
+#include "log.h"
+#include "macro.h"
+#include "rm-rf.h"
+#include "sparse-endian.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "time-util.h"
+#include "util.h"
+
+#define N_ENTRIES 50
+
+static const char binary_data[] = "line one\nline two\n\001\002";
+
+/* Generates what journal-upload sends for N_ENTRIES entries, each with a printable message and a field
+ * with a newline in it. With binary, every field is sent in the size-prefixed form. */
+static void make_export(bool binary, char **ret, size_t *ret_size) {
+        _cleanup_fclose_ FILE *f = NULL;
+        unsigned i;
+
+        f = open_memstream(ret, ret_size);
+        assert_se(f);
+
+        for (i = 0; i < N_ENTRIES; i++) {
+                char message[sizeof("MESSAGE=entry ") + DECIMAL_STR_MAX(unsigned)];
+                le64_t le;
+
+                xsprintf(message, "MESSAGE=entry %u", i);
+
+                fprintf(f,
+                        "__REALTIME_TIMESTAMP=" USEC_FMT "\n"
+                        "__MONOTONIC_TIMESTAMP=" USEC_FMT "\n",
+                        1500000000 * USEC_PER_SEC + i, (usec_t) i + 1);
+
+                if (binary) {
+                        le = htole64(strlen(message) - strlen("MESSAGE="));
+                        fputs("MESSAGE\n", f);
+                        fwrite(&le, sizeof(le), 1, f);
+                        fputs(message + strlen("MESSAGE="), f);
+                        fputc('\n', f);
+                } else
+                        fprintf(f, "%s\n", message);
+
+                le = htole64(sizeof(binary_data) - 1);
+                fputs("BINARY\n", f);
+                fwrite(&le, sizeof(le), 1, f);
+                fwrite(binary_data, 1, sizeof(binary_data) - 1, f);
+                fputs("\n\n", f);
+        }
+
+        assert_se(fflush_and_check(f) >= 0);
+}
+
+#ifdef HAVE_ZSTD
+/* Compresses the data as one zstd frame, flushed every so often like journal-upload does when the
+ * journal runs dry */
+static void compress_zstd(const char *data, size_t size, char **ret, size_t *ret_size) {
+        ZSTD_CStream *z;
+        size_t allocated = 0, n = 0, i, k;
+        char *buf = NULL;
+
+        z = ZSTD_createCStream();
+        assert_se(z);
+        assert_se(!ZSTD_isError(ZSTD_initCStream(z, 1)));
+
+        for (i = 0; i <= size; i += 100) {
+                ZSTD_inBuffer in = {
+                        .src = data + i,
+                        .size = MIN(size - MIN(i, size), 100U),
+                };
+
+                do {
+                        ZSTD_outBuffer out;
+
+                        assert_se(GREEDY_REALLOC(buf, allocated, n + ZSTD_CStreamOutSize()));
+                        out = (ZSTD_outBuffer) {
+                                .dst = buf + n,
+                                .size = ZSTD_CStreamOutSize(),
+                        };
+
+                        if (in.pos < in.size)
+                                k = ZSTD_compressStream(z, &out, &in);
+                        else if (i + 100 <= size)
+                                k = ZSTD_flushStream(z, &out);
+                        else
+                                k = ZSTD_endStream(z, &out);
+                        assert_se(!ZSTD_isError(k));
+
+                        n += out.pos;
+                } while (in.pos < in.size || k > 0);
+        }
+
+        ZSTD_freeCStream(z);
+
+        *ret = buf;
+        *ret_size = n;
+}
+#endif
+
+static void check_journal(const char *path) {
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        const char *paths[] = { path, NULL };
+        unsigned n = 0;
+
+        assert_se(sd_journal_open_files(&j, paths, 0) >= 0);
+
+        SD_JOURNAL_FOREACH(j) {
+                char expected[sizeof("MESSAGE=entry ") + DECIMAL_STR_MAX(unsigned)];
+                const void *d;
+                size_t l;
+
+                xsprintf(expected, "MESSAGE=entry %u", n);
+
+                assert_se(sd_journal_get_data(j, "MESSAGE", &d, &l) >= 0);
+                assert_se(l == strlen(expected));
+                assert_se(memcmp(d, expected, l) == 0);
+
+                assert_se(sd_journal_get_data(j, "BINARY", &d, &l) >= 0);
+                assert_se(l == strlen("BINARY=") + sizeof(binary_data) - 1);
+                assert_se(memcmp((const char*) d + strlen("BINARY="), binary_data, sizeof(binary_data) - 1) == 0);
+
+                n++;
+        }
+
+        assert_se(n == N_ENTRIES);
+}
+
+static int push_all(RemoteSource *source, const char *data, size_t size) {
+        size_t i, n;
+        int r;
+
+        /* Hand the data over in pieces of varying size, as the HTTP server would */
+        for (i = 0; i < size; i += n) {
+                n = MIN(size - i, i % 61 + 1);
+
+                r = source_push_data(source, data + i, n);
+                if (r < 0)
+                        return r;
+
+                for (;;) {
+                        r = process_source(source, false, false);
+                        if (r == -EAGAIN)
+                                break;
+                        assert_se(r >= 0);
+                }
+        }
+
+        return 0;
+}
+
+static void test_one(const char *dir, bool binary, const char *encoding) {
+        _cleanup_free_ char *export = NULL, *data = NULL, *path = NULL, *name = NULL;
+        _cleanup_close_ int fd = -1;
+        RemoteSource *source;
+        size_t export_size, size;
+        Writer *w;
+
+        log_info("/* %s(%s, %s) */", __func__, yes_no(binary), strna(encoding));
+
+        make_export(binary, &export, &export_size);
+
+#ifdef HAVE_ZSTD
+        if (streq_ptr(encoding, "zstd"))
+                compress_zstd(export, export_size, &data, &size);
+        else
+#endif
+        {
+                data = export;
+                export = NULL;
+                size = export_size;
+        }
+
+        assert_se(asprintf(&path, "%s/%s-%s.journal", dir, binary ? "binary" : "export", encoding ?: "none") >= 0);
+
+        w = writer_new(NULL);
+        assert_se(w);
+        assert_se(journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, false, false, NULL, w->mmap, NULL, NULL, &w->journal) >= 0);
+
+        fd = open("/dev/null", O_RDONLY|O_CLOEXEC);
+        assert_se(fd >= 0);
+        name = strdup("test");
+        assert_se(name);
+
+        /* The fd is passive, i.e. stays ours, the data is pushed into the source instead */
+        source = source_new(fd, true, name, w);
+        assert_se(source);
+        name = NULL;
+
+        assert_se(source_set_encoding(source, encoding) >= 0);
+        assert_se(push_all(source, data, size) >= 0);
+        assert_se(journal_importer_bytes_remaining(&source->importer) == 0);
+
+        source_free(source);
+
+        check_journal(path);
+}
+
+static void test_bad_data(void) {
+#ifdef HAVE_ZSTD
+        static const char garbage[] = "this is not zstd compressed";
+        _cleanup_close_ int fd = -1;
+        RemoteSource *source;
+        Writer *w;
+        char *name;
+
+        log_info("/* %s */", __func__);
+
+        w = writer_new(NULL);
+        assert_se(w);
+        fd = open("/dev/null", O_RDONLY|O_CLOEXEC);
+        assert_se(fd >= 0);
+        name = strdup("test");
+        assert_se(name);
+
+        source = source_new(fd, true, name, w);
+        assert_se(source);
+
+        assert_se(source_set_encoding(source, "zstd") >= 0);
+        assert_se(source_push_data(source, garbage, sizeof(garbage)) == -EBADMSG);
+
+        source_free(source);
+#endif
+}
+
+int main(int argc, char *argv[]) {
+        char t[] = "/tmp/test-journal-remote-parse-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        assert_se(mkdtemp(t));
+
+        assert_se(source_encoding_supported(NULL));
+        assert_se(source_encoding_supported("identity"));
+        assert_se(!source_encoding_supported("gzip"));
+
+        test_one(t, false, NULL);
+        test_one(t, true, NULL);
+        test_one(t, true, "identity");
+#ifdef HAVE_ZSTD
+        test_one(t, false, "zstd");
+        test_one(t, true, "zstd");
+#endif
+        test_bad_data();
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
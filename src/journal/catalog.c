@@ -36,6 +36,7 @@
 #include "log.h"
 #include "mkdir.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "siphash24.h"
 #include "sparse-endian.h"
 #include "strbuf.h"
@@ -629,19 +630,86 @@ static const char *find_id(void *p, sd_id128_t id) {
                 le64toh(f->offset);
 }
 
+/* "journalctl -x" looks up the catalog for every entry shown, hence keep the database mapped between calls, and only
+ * map it anew when it has been replaced or modified. There's one mapping per process. It is guarded by a lock that
+ * records the PID of its holder and that is only ever tried, never waited for, so that a lock held by another
+ * thread at the time of fork() can't hang the child. If another thread of ours holds it, the database is mapped
+ * just for this one lookup. If a thread of the process we were forked from held it, we take it over. */
+static pid_t catalog_cache_owner = 0;
+static void *catalog_cache_p = NULL;
+static struct stat catalog_cache_st;
+
+static bool catalog_cache_trylock(void) {
+        int r;
+
+        r = pid_trylock(&catalog_cache_owner);
+        if (r < 0)
+                return false;
+        if (r > 0) {
+                /* The previous holder might have been in the middle of replacing the mapping, hence forget
+                 * about it, without unmapping anything. */
+                catalog_cache_p = NULL;
+        }
+
+        return true;
+}
+
+static int catalog_cache_get(const char *database, void **_p) {
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+        void *p;
+        int r;
+
+        assert(database);
+        assert(_p);
+
+        /* Must be called with the lock taken */
+
+        if (stat(database, &st) < 0)
+                return -errno;
+
+        if (catalog_cache_p &&
+            st.st_dev == catalog_cache_st.st_dev &&
+            st.st_ino == catalog_cache_st.st_ino &&
+            st.st_size == catalog_cache_st.st_size &&
+            st.st_mtim.tv_sec == catalog_cache_st.st_mtim.tv_sec &&
+            st.st_mtim.tv_nsec == catalog_cache_st.st_mtim.tv_nsec) {
+                *_p = catalog_cache_p;
+                return 0;
+        }
+
+        r = open_mmap(database, &fd, &st, &p);
+        if (r < 0)
+                return r;
+
+        if (catalog_cache_p)
+                munmap(catalog_cache_p, catalog_cache_st.st_size);
+
+        catalog_cache_p = p;
+        catalog_cache_st = st;
+
+        *_p = p;
+        return 0;
+}
+
 int catalog_get(const char* database, sd_id128_t id, char **_text) {
         _cleanup_close_ int fd = -1;
-        void *p = NULL;
         struct stat st = {};
+        void *p = NULL;
         char *text = NULL;
+        bool locked;
         int r;
         const char *s;
 
         assert(_text);
 
-        r = open_mmap(database, &fd, &st, &p);
+        locked = catalog_cache_trylock();
+        if (locked)
+                r = catalog_cache_get(database, &p);
+        else
+                r = open_mmap(database, &fd, &st, &p);
         if (r < 0)
-                return r;
+                goto finish;
 
         s = find_id(p, id);
         if (!s) {
@@ -659,7 +727,9 @@ int catalog_get(const char* database, sd_id128_t id, char **_text) {
         r = 0;
 
 finish:
-        if (p)
+        if (locked)
+                pid_unlock(&catalog_cache_owner);
+        else if (p)
                 munmap(p, st.st_size);
 
         return r;
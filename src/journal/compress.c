@@ -32,6 +32,11 @@
 #include <lz4frame.h>
 #endif
 
+#ifdef HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
 #include "alloc-util.h"
 #include "compress.h"
 #include "fd-util.h"
@@ -48,15 +53,176 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_compressionContext_t, LZ4F_freeCompressionConte
 DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_decompressionContext_t, LZ4F_freeDecompressionContext);
 #endif
 
+#ifdef HAVE_ZSTD
+DEFINE_TRIVIAL_CLEANUP_FUNC(ZSTD_DCtx*, ZSTD_freeDCtx);
+#endif
+
 #define ALIGN_8(l) ALIGN_TO(l, sizeof(size_t))
 
+/* We compress on the write path of journald, hence favour speed over ratio */
+#define ZSTD_COMPRESSION_LEVEL 1
+
+struct CompressDictionary {
+        void *data;
+        size_t size;
+        unsigned id;
+
+#ifdef HAVE_ZSTD
+        /* Created on first use, readers never need the compression side and writers rarely the other */
+        ZSTD_CDict *cdict;
+        ZSTD_CCtx *cctx;
+        ZSTD_DDict *ddict;
+        ZSTD_DCtx *dctx;
+#endif
+};
+
 static const char* const object_compressed_table[_OBJECT_COMPRESSED_MAX] = {
         [OBJECT_COMPRESSED_XZ] = "XZ",
         [OBJECT_COMPRESSED_LZ4] = "LZ4",
+        [OBJECT_COMPRESSED_ZSTD] = "ZSTD",
 };
 
 DEFINE_STRING_TABLE_LOOKUP(object_compressed, int);
 
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret) {
+#ifdef HAVE_ZSTD
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        unsigned id;
+
+        assert(data);
+        assert(ret);
+
+        /* Only accept dictionaries in the zstd format: frames compressed without a dictionary carry no dictionary
+         * ID, and that is how we tell them apart from frames that need this one. */
+        id = ZSTD_getDictID_fromDict(data, size);
+        if (id == 0)
+                return -EBADMSG;
+
+        d = new0(CompressDictionary, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->data = memdup(data, size);
+        if (!d->data)
+                return -ENOMEM;
+
+        d->size = size;
+        d->id = id;
+
+        *ret = d;
+        d = NULL;
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+CompressDictionary* compress_dictionary_free(CompressDictionary *d) {
+        if (!d)
+                return NULL;
+
+#ifdef HAVE_ZSTD
+        ZSTD_freeCDict(d->cdict);
+        ZSTD_freeCCtx(d->cctx);
+        ZSTD_freeDDict(d->ddict);
+        ZSTD_freeDCtx(d->dctx);
+#endif
+
+        free(d->data);
+        return mfree(d);
+}
+
+int compress_dictionary_train(const void *samples, const size_t *sample_sizes, unsigned n_samples,
+                              size_t max_size, void **ret, size_t *ret_size) {
+#ifdef HAVE_ZSTD
+        _cleanup_free_ void *buf = NULL;
+        size_t k;
+
+        assert(samples);
+        assert(sample_sizes);
+        assert(max_size > 0);
+        assert(ret);
+        assert(ret_size);
+
+        buf = malloc(max_size);
+        if (!buf)
+                return -ENOMEM;
+
+        /* This fails if there are too few samples, or if they are too small to learn anything from */
+        k = ZDICT_trainFromBuffer(buf, max_size, samples, sample_sizes, n_samples);
+        if (ZDICT_isError(k)) {
+                log_debug("Failed to train zstd dictionary on %u samples: %s", n_samples, ZDICT_getErrorName(k));
+                return -ENODATA;
+        }
+
+        *ret = buf;
+        *ret_size = k;
+        buf = NULL;
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+#ifdef HAVE_ZSTD
+static int compress_dictionary_setup_compress(CompressDictionary *d) {
+        assert(d);
+
+        if (!d->cdict) {
+                d->cdict = ZSTD_createCDict(d->data, d->size, ZSTD_COMPRESSION_LEVEL);
+                if (!d->cdict)
+                        return -ENOMEM;
+        }
+
+        if (!d->cctx) {
+                d->cctx = ZSTD_createCCtx();
+                if (!d->cctx)
+                        return -ENOMEM;
+        }
+
+        return 0;
+}
+
+static int compress_dictionary_setup_decompress(CompressDictionary *d, bool need_dctx) {
+        assert(d);
+
+        if (!d->ddict) {
+                d->ddict = ZSTD_createDDict(d->data, d->size);
+                if (!d->ddict)
+                        return -ENOMEM;
+        }
+
+        if (need_dctx && !d->dctx) {
+                d->dctx = ZSTD_createDCtx();
+                if (!d->dctx)
+                        return -ENOMEM;
+        }
+
+        return 0;
+}
+
+/* Returns the dictionary the frame needs, NULL if it doesn't need one, or -EBADMSG if we don't have the one it
+ * needs */
+static int compress_dictionary_for_frame(CompressDictionary *d, const void *src, uint64_t src_size,
+                                         CompressDictionary **ret) {
+        unsigned id;
+
+        id = ZSTD_getDictID_fromFrame(src, src_size);
+        if (id == 0) {
+                *ret = NULL;
+                return 0;
+        }
+
+        if (!d || d->id != id)
+                return -EBADMSG;
+
+        *ret = d;
+        return 0;
+}
+#endif
+
 int compress_blob_xz(const void *src, uint64_t src_size,
                      void *dst, size_t dst_alloc_size, size_t *dst_size) {
 #ifdef HAVE_XZ
@@ -129,6 +295,44 @@ int compress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int compress_blob_zstd_with_dictionary(CompressDictionary *d,
+                                       const void *src, uint64_t src_size,
+                                       void *dst, size_t dst_alloc_size, size_t *dst_size) {
+#ifdef HAVE_ZSTD
+        size_t k;
+        int r;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size > 0);
+        assert(dst_size);
+
+        /* Returns < 0 if we couldn't compress the data or the
+         * compressed result is longer than the original */
+
+        if (d) {
+                r = compress_dictionary_setup_compress(d);
+                if (r < 0)
+                        return r;
+
+                k = ZSTD_compress_usingCDict(d->cctx, dst, dst_alloc_size, src, src_size, d->cdict);
+        } else
+                k = ZSTD_compress(dst, dst_alloc_size, src, src_size, ZSTD_COMPRESSION_LEVEL);
+        if (ZSTD_isError(k))
+                return -ENOBUFS;
+
+        *dst_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int compress_blob_zstd(const void *src, uint64_t src_size,
+                       void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        return compress_blob_zstd_with_dictionary(NULL, src, src_size, dst, dst_alloc_size, dst_size);
+}
 
 int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
@@ -230,7 +434,60 @@ int decompress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int decompress_blob(int compression,
+int decompress_blob_zstd_with_dictionary(CompressDictionary *d,
+                                         const void *src, uint64_t src_size,
+                                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+#ifdef HAVE_ZSTD
+        unsigned long long size;
+        size_t k;
+        int r;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size);
+        assert(dst_size);
+        assert(*dst_alloc_size == 0 || *dst);
+
+        /* Like the LZ4 variant, this always decompresses the full blob and ignores dst_max. We always write the
+         * content size into the frame header. */
+        size = ZSTD_getFrameContentSize(src, src_size);
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+                return -EBADMSG;
+        if ((unsigned long long) (size_t) size != size)
+                return -EFBIG;
+
+        r = compress_dictionary_for_frame(d, src, src_size, &d);
+        if (r < 0)
+                return r;
+
+        if (!greedy_realloc(dst, dst_alloc_size, MAX(size, 1u), 1))
+                return -ENOMEM;
+
+        if (d) {
+                r = compress_dictionary_setup_decompress(d, true);
+                if (r < 0)
+                        return r;
+
+                k = ZSTD_decompress_usingDDict(d->dctx, *dst, size, src, src_size, d->ddict);
+        } else
+                k = ZSTD_decompress(*dst, size, src, src_size);
+        if (ZSTD_isError(k) || k != size)
+                return -EBADMSG;
+
+        *dst_size = size;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int decompress_blob_zstd(const void *src, uint64_t src_size,
+                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_zstd_with_dictionary(NULL, src, src_size, dst, dst_alloc_size, dst_size, dst_max);
+}
+
+int decompress_blob(int compression, CompressDictionary *d,
                     const void *src, uint64_t src_size,
                     void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
         if (compression == OBJECT_COMPRESSED_XZ)
@@ -239,6 +496,9 @@ int decompress_blob(int compression,
         else if (compression == OBJECT_COMPRESSED_LZ4)
                 return decompress_blob_lz4(src, src_size,
                                            dst, dst_alloc_size, dst_size, dst_max);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_blob_zstd_with_dictionary(d, src, src_size,
+                                                            dst, dst_alloc_size, dst_size, dst_max);
         else
                 return -EBADMSG;
 }
@@ -352,7 +612,121 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int decompress_startswith(int compression,
+#ifdef HAVE_ZSTD
+static int decompress_prefix_zstd(CompressDictionary *d,
+                                  const void *src, uint64_t src_size,
+                                  void **buffer, size_t *buffer_size,
+                                  size_t prefix_len, size_t *ret_size) {
+        _cleanup_(ZSTD_freeDCtxp) ZSTD_DCtx *own_dctx = NULL;
+        ZSTD_inBuffer input = {
+                .src = src,
+                .size = src_size,
+        };
+        ZSTD_outBuffer output = {};
+        ZSTD_DCtx *dctx;
+        size_t k;
+        int r;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(buffer);
+        assert(buffer_size);
+        assert(ret_size);
+        assert(*buffer_size == 0 || *buffer);
+
+        r = compress_dictionary_for_frame(d, src, src_size, &d);
+        if (r < 0)
+                return r;
+
+        if (!(greedy_realloc(buffer, buffer_size, ALIGN_8(MAX(prefix_len, 1u)), 1)))
+                return -ENOMEM;
+
+        if (d) {
+                /* Reuse the context of the dictionary, so that the dictionary is loaded into it only once, rather
+                 * than for every object we look at */
+                r = compress_dictionary_setup_decompress(d, true);
+                if (r < 0)
+                        return r;
+
+                dctx = d->dctx;
+
+                k = ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+                if (ZSTD_isError(k))
+                        return -EIO;
+
+                k = ZSTD_DCtx_refDDict(dctx, d->ddict);
+                if (ZSTD_isError(k))
+                        return -ENOMEM;
+        } else {
+                own_dctx = ZSTD_createDCtx();
+                if (!own_dctx)
+                        return -ENOMEM;
+
+                dctx = own_dctx;
+        }
+
+        /* Stream the frame, so that we stop as soon as we have the prefix, and don't decompress huge blobs
+         * entirely */
+        output.dst = *buffer;
+        output.size = prefix_len;
+
+        for (;;) {
+                k = ZSTD_decompressStream(dctx, &output, &input);
+                if (ZSTD_isError(k))
+                        return -EBADMSG;
+
+                /* Either we have enough, or the frame ended before */
+                if (output.pos >= prefix_len || k == 0)
+                        break;
+
+                /* Output space is left, hence everything that could be flushed was: the frame is truncated */
+                if (input.pos >= input.size)
+                        return -EBADMSG;
+        }
+
+        *ret_size = output.pos;
+        return 0;
+}
+#endif
+
+int decompress_startswith_zstd_with_dictionary(CompressDictionary *d,
+                                               const void *src, uint64_t src_size,
+                                               void **buffer, size_t *buffer_size,
+                                               const void *prefix, size_t prefix_len,
+                                               uint8_t extra) {
+#ifdef HAVE_ZSTD
+        size_t size;
+        int r;
+
+        /* Checks whether the decompressed blob starts with the
+         * mentioned prefix. The byte extra needs to follow the
+         * prefix */
+
+        assert(prefix);
+
+        r = decompress_prefix_zstd(d, src, src_size, buffer, buffer_size, prefix_len + 1, &size);
+        if (r < 0)
+                return r;
+
+        return size >= prefix_len + 1 &&
+                memcmp(*buffer, prefix, prefix_len) == 0 &&
+                ((const uint8_t*) *buffer)[prefix_len] == extra;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                               void **buffer, size_t *buffer_size,
+                               const void *prefix, size_t prefix_len,
+                               uint8_t extra) {
+        return decompress_startswith_zstd_with_dictionary(NULL, src, src_size,
+                                                          buffer, buffer_size,
+                                                          prefix, prefix_len,
+                                                          extra);
+}
+
+int decompress_startswith(int compression, CompressDictionary *d,
                           const void *src, uint64_t src_size,
                           void **buffer, size_t *buffer_size,
                           const void *prefix, size_t prefix_len,
@@ -367,11 +741,66 @@ int decompress_startswith(int compression,
                                                  buffer, buffer_size,
                                                  prefix, prefix_len,
                                                  extra);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_startswith_zstd_with_dictionary(d, src, src_size,
+                                                                  buffer, buffer_size,
+                                                                  prefix, prefix_len,
+                                                                  extra);
         else
                 return -EBADMSG;
 }
 
-int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes) {
+int decompress_prefix(int compression, CompressDictionary *d,
+                      const void *src, uint64_t src_size,
+                      void **buffer, size_t *buffer_size,
+                      size_t prefix_len, size_t *ret_size) {
+
+        /* Decompresses at least the first prefix_len bytes of the blob, or all of it if it is shorter, and
+         * returns how many bytes are available in the buffer. */
+
+        assert(prefix_len > 0);
+
+        if (compression == OBJECT_COMPRESSED_XZ)
+                return decompress_blob_xz(src, src_size, buffer, buffer_size, ret_size, prefix_len);
+        else if (compression == OBJECT_COMPRESSED_LZ4) {
+#ifdef HAVE_LZ4
+                int r;
+
+                assert(src);
+                assert(buffer);
+                assert(buffer_size);
+                assert(ret_size);
+                assert(*buffer_size == 0 || *buffer);
+
+                if (src_size <= 8)
+                        return -EBADMSG;
+
+                if (!(greedy_realloc(buffer, buffer_size, ALIGN_8(prefix_len), 1)))
+                        return -ENOMEM;
+
+                r = LZ4_decompress_safe_partial((char*)src + 8, *buffer, src_size - 8,
+                                                prefix_len, *buffer_size);
+                if (r >= 0) {
+                        *ret_size = (size_t) r;
+                        return 0;
+                }
+
+                /* See decompress_startswith_lz4() */
+                return decompress_blob_lz4(src, src_size, buffer, buffer_size, ret_size, 0);
+#else
+                return -EPROTONOSUPPORT;
+#endif
+        } else if (compression == OBJECT_COMPRESSED_ZSTD) {
+#ifdef HAVE_ZSTD
+                return decompress_prefix_zstd(d, src, src_size, buffer, buffer_size, prefix_len, ret_size);
+#else
+                return -EPROTONOSUPPORT;
+#endif
+        } else
+                return -EBADMSG;
+}
+
+int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size) {
 #ifdef HAVE_XZ
         _cleanup_(lzma_end) lzma_stream s = LZMA_STREAM_INIT;
         lzma_ret ret;
@@ -436,6 +865,9 @@ int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes) {
                                           s.total_in, s.total_out,
                                           (double) s.total_out / s.total_in * 100);
 
+                                if (ret_uncompressed_size)
+                                        *ret_uncompressed_size = s.total_in;
+
                                 return 0;
                         }
                 }
@@ -447,94 +879,92 @@ int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes) {
 
 #define LZ4_BUFSIZE (512*1024u)
 
-int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes) {
+int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size) {
 
 #ifdef HAVE_LZ4
         LZ4F_errorCode_t c;
         _cleanup_(LZ4F_freeCompressionContextp) LZ4F_compressionContext_t ctx = NULL;
-        _cleanup_free_ char *buf = NULL;
-        char *src = NULL;
-        size_t size, n, total_in = 0, total_out, offset = 0, frame_size;
-        struct stat st;
+        _cleanup_free_ char *buf = NULL, *src = NULL;
+        size_t size, n, total_out, offset = 0, frame_size;
+        uint64_t total_in = 0;
         int r;
-        static const LZ4F_compressOptions_t options = {
-                .stableSrc = 1,
-        };
         static const LZ4F_preferences_t preferences = {
                 .frameInfo.blockSizeID = 5,
         };
 
+        assert(fdf >= 0);
+        assert(fdt >= 0);
+
+        /* The input is read in chunks rather than mapped, so that it may be a pipe too, and is compressed in a
+         * single pass. */
+
         c = LZ4F_createCompressionContext(&ctx, LZ4F_VERSION);
         if (LZ4F_isError(c))
                 return -ENOMEM;
 
-        if (fstat(fdf, &st) < 0)
-                return log_debug_errno(errno, "fstat() failed: %m");
-
         frame_size = LZ4F_compressBound(LZ4_BUFSIZE, &preferences);
         size =  frame_size + 64*1024; /* add some space for header and trailer */
         buf = malloc(size);
-        if (!buf)
+        src = malloc(LZ4_BUFSIZE);
+        if (!buf || !src)
                 return -ENOMEM;
 
         n = offset = total_out = LZ4F_compressBegin(ctx, buf, size, &preferences);
         if (LZ4F_isError(n))
                 return -EINVAL;
 
-        src = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fdf, 0);
-        if (src == MAP_FAILED)
-                return -errno;
-
         log_debug("Buffer size is %zu bytes, header size %zu bytes.", size, n);
 
-        while (total_in < (size_t) st.st_size) {
+        for (;;) {
+                size_t m = LZ4_BUFSIZE;
                 ssize_t k;
 
-                k = MIN(LZ4_BUFSIZE, st.st_size - total_in);
-                n = LZ4F_compressUpdate(ctx, buf + offset, size - offset,
-                                        src + total_in, k, &options);
-                if (LZ4F_isError(n)) {
-                        r = -ENOTRECOVERABLE;
-                        goto cleanup;
-                }
+                if (max_bytes != (uint64_t) -1 && (uint64_t) m > max_bytes - total_in)
+                        m = (size_t) (max_bytes - total_in);
+                if (m == 0)
+                        break;
+
+                k = loop_read(fdf, src, m, true);
+                if (k < 0)
+                        return k;
+                if (k == 0)
+                        break;
+
+                /* The source buffer is reused for the next chunk, hence don't pass stableSrc */
+                n = LZ4F_compressUpdate(ctx, buf + offset, size - offset, src, k, NULL);
+                if (LZ4F_isError(n))
+                        return -ENOTRECOVERABLE;
 
                 total_in += k;
                 offset += n;
                 total_out += n;
 
-                if (max_bytes != (uint64_t) -1 && total_out > (size_t) max_bytes) {
-                        log_debug("Compressed stream longer than %"PRIu64" bytes", max_bytes);
-                        return -EFBIG;
-                }
-
                 if (size - offset < frame_size + 4) {
-                        k = loop_write(fdt, buf, offset, false);
-                        if (k < 0) {
-                                r = k;
-                                goto cleanup;
-                        }
+                        r = loop_write(fdt, buf, offset, false);
+                        if (r < 0)
+                                return r;
                         offset = 0;
                 }
         }
 
-        n = LZ4F_compressEnd(ctx, buf + offset, size - offset, &options);
-        if (LZ4F_isError(n)) {
-                r = -ENOTRECOVERABLE;
-                goto cleanup;
-        }
+        n = LZ4F_compressEnd(ctx, buf + offset, size - offset, NULL);
+        if (LZ4F_isError(n))
+                return -ENOTRECOVERABLE;
 
         offset += n;
         total_out += n;
         r = loop_write(fdt, buf, offset, false);
         if (r < 0)
-                goto cleanup;
+                return r;
 
-        log_debug("LZ4 compression finished (%zu -> %zu bytes, %.1f%%)",
+        log_debug("LZ4 compression finished (%"PRIu64" -> %zu bytes, %.1f%%)",
                   total_in, total_out,
                   (double) total_out / total_in * 100);
- cleanup:
-        munmap(src, st.st_size);
-        return r;
+
+        if (ret_uncompressed_size)
+                *ret_uncompressed_size = total_in;
+
+        return 0;
 #else
         return -EPROTONOSUPPORT;
 #endif
@@ -23,18 +23,39 @@
 
 #include "journal-def.h"
 
+#include "macro.h"
+
+/* A zstd dictionary, together with the compression and decompression state derived from it. Only zstd makes use
+ * of dictionaries, the other algorithms ignore them. */
+typedef struct CompressDictionary CompressDictionary;
+
 const char* object_compressed_to_string(int compression);
 int object_compressed_from_string(const char *compression);
 
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret);
+CompressDictionary* compress_dictionary_free(CompressDictionary *d);
+DEFINE_TRIVIAL_CLEANUP_FUNC(CompressDictionary*, compress_dictionary_free);
+int compress_dictionary_train(const void *samples, const size_t *sample_sizes, unsigned n_samples,
+                              size_t max_size, void **ret, size_t *ret_size);
+
 int compress_blob_xz(const void *src, uint64_t src_size,
                      void *dst, size_t dst_alloc_size, size_t *dst_size);
 int compress_blob_lz4(const void *src, uint64_t src_size,
                       void *dst, size_t dst_alloc_size, size_t *dst_size);
+int compress_blob_zstd(const void *src, uint64_t src_size,
+                       void *dst, size_t dst_alloc_size, size_t *dst_size);
+int compress_blob_zstd_with_dictionary(CompressDictionary *d,
+                                       const void *src, uint64_t src_size,
+                                       void *dst, size_t dst_alloc_size, size_t *dst_size);
 
 static inline int compress_blob(const void *src, uint64_t src_size,
                                 void *dst, size_t dst_alloc_size, size_t *dst_size) {
         int r;
-#ifdef HAVE_LZ4
+#if defined(HAVE_ZSTD)
+        r = compress_blob_zstd(src, src_size, dst, dst_alloc_size, dst_size);
+        if (r == 0)
+                return OBJECT_COMPRESSED_ZSTD;
+#elif defined(HAVE_LZ4)
         r = compress_blob_lz4(src, src_size, dst, dst_alloc_size, dst_size);
         if (r == 0)
                 return OBJECT_COMPRESSED_LZ4;
@@ -50,7 +71,12 @@ int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
 int decompress_blob_lz4(const void *src, uint64_t src_size,
                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
-int decompress_blob(int compression,
+int decompress_blob_zstd(const void *src, uint64_t src_size,
+                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
+int decompress_blob_zstd_with_dictionary(CompressDictionary *d,
+                                         const void *src, uint64_t src_size,
+                                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
+int decompress_blob(int compression, CompressDictionary *d,
                     const void *src, uint64_t src_size,
                     void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
 
@@ -62,14 +88,28 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
                               void **buffer, size_t *buffer_size,
                               const void *prefix, size_t prefix_len,
                               uint8_t extra);
-int decompress_startswith(int compression,
+int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                               void **buffer, size_t *buffer_size,
+                               const void *prefix, size_t prefix_len,
+                               uint8_t extra);
+int decompress_startswith_zstd_with_dictionary(CompressDictionary *d,
+                                               const void *src, uint64_t src_size,
+                                               void **buffer, size_t *buffer_size,
+                                               const void *prefix, size_t prefix_len,
+                                               uint8_t extra);
+int decompress_startswith(int compression, CompressDictionary *d,
                           const void *src, uint64_t src_size,
                           void **buffer, size_t *buffer_size,
                           const void *prefix, size_t prefix_len,
                           uint8_t extra);
-
-int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes);
-int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes);
+int decompress_prefix(int compression, CompressDictionary *d,
+                      const void *src, uint64_t src_size,
+                      void **buffer, size_t *buffer_size,
+                      size_t prefix_len, size_t *ret_size);
+
+/* Compress at most max_bytes from fdf, which may also be a pipe, and optionally return how many were read */
+int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size);
+int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size);
 
 int decompress_stream_xz(int fdf, int fdt, uint64_t max_size);
 int decompress_stream_lz4(int fdf, int fdt, uint64_t max_size);
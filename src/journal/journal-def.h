@@ -42,9 +42,13 @@ typedef struct EntryObject EntryObject;
 typedef struct HashTableObject HashTableObject;
 typedef struct EntryArrayObject EntryArrayObject;
 typedef struct TagObject TagObject;
+typedef struct EntryIndexObject EntryIndexObject;
+typedef struct DataBloomObject DataBloomObject;
+typedef struct CompressionDictionaryObject CompressionDictionaryObject;
 
 typedef struct EntryItem EntryItem;
 typedef struct HashItem HashItem;
+typedef struct EntryIndexItem EntryIndexItem;
 
 typedef struct FSSHeader FSSHeader;
 
@@ -58,6 +62,9 @@ typedef enum ObjectType {
         OBJECT_FIELD_HASH_TABLE,
         OBJECT_ENTRY_ARRAY,
         OBJECT_TAG,
+        OBJECT_ENTRY_INDEX,
+        OBJECT_DATA_BLOOM,
+        OBJECT_COMPRESSION_DICTIONARY,
         _OBJECT_TYPE_MAX
 } ObjectType;
 
@@ -65,10 +72,11 @@ typedef enum ObjectType {
 enum {
         OBJECT_COMPRESSED_XZ = 1 << 0,
         OBJECT_COMPRESSED_LZ4 = 1 << 1,
+        OBJECT_COMPRESSED_ZSTD = 1 << 2,
         _OBJECT_COMPRESSED_MAX
 };
 
-#define OBJECT_COMPRESSION_MASK (OBJECT_COMPRESSED_XZ | OBJECT_COMPRESSED_LZ4)
+#define OBJECT_COMPRESSION_MASK (OBJECT_COMPRESSED_XZ | OBJECT_COMPRESSED_LZ4 | OBJECT_COMPRESSED_ZSTD)
 
 struct ObjectHeader {
         uint8_t type;
@@ -137,6 +145,43 @@ struct TagObject {
         uint8_t tag[TAG_LENGTH]; /* SHA-256 HMAC */
 } _packed_;
 
+/* One item for each array of the main entry array chain. Written once when a file is archived, so that seeking by
+ * realtime or seqnum can go straight to the right array instead of walking the chain. */
+struct EntryIndexItem {
+        le64_t entry_array_offset;
+        le64_t entry_offset; /* the first entry in the array */
+        le64_t total;        /* the number of entries in all arrays before this one */
+        le64_t realtime;     /* of the first entry in the array */
+        le64_t seqnum;       /* of the first entry in the array */
+} _packed_;
+
+struct EntryIndexObject {
+        ObjectHeader object;
+        le64_t n_entries;    /* the number of entries in the file when the index was written */
+        EntryIndexItem items[];
+} _packed_;
+
+/* A bloom filter over the hashes of all DATA objects of a few commonly matched fields. Written once when a file is
+ * archived, so that readers can tell that a match cannot be fulfilled by this file without looking at its data
+ * hash table. The payload consists of the covered field names as NUL separated list terminated by an empty string
+ * (fields_size bytes), followed by the bitmap, which takes up the rest of the object. */
+struct DataBloomObject {
+        ObjectHeader object;
+        le64_t n_data;       /* the number of DATA objects in the file when the filter was written */
+        le32_t n_hashes;     /* the number of bits set for each DATA object */
+        le32_t fields_size;
+        uint8_t payload[];
+} _packed_;
+
+/* A zstd dictionary trained on the DATA payloads of the previous file, written into a file created at rotation once
+ * the training finished, hence possibly after some DATA objects. There is at most one per file. The zstd compressed
+ * DATA objects of the file that carry a dictionary ID refer to it, those written before it carry none. The payload
+ * is the dictionary as generated by ZDICT_trainFromBuffer(). */
+struct CompressionDictionaryObject {
+        ObjectHeader object;
+        uint8_t payload[];
+} _packed_;
+
 union Object {
         ObjectHeader object;
         DataObject data;
@@ -145,6 +190,9 @@ union Object {
         HashTableObject hash_table;
         EntryArrayObject entry_array;
         TagObject tag;
+        EntryIndexObject entry_index;
+        DataBloomObject data_bloom;
+        CompressionDictionaryObject compression_dictionary;
 };
 
 enum {
@@ -158,29 +206,41 @@ enum {
 enum {
         HEADER_INCOMPATIBLE_COMPRESSED_XZ = 1 << 0,
         HEADER_INCOMPATIBLE_COMPRESSED_LZ4 = 1 << 1,
+        HEADER_INCOMPATIBLE_COMPRESSED_ZSTD = 1 << 2,
 };
 
-#define HEADER_INCOMPATIBLE_ANY (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_LZ4)
+#define HEADER_INCOMPATIBLE_ANY (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD)
 
-#if defined(HAVE_XZ) && defined(HAVE_LZ4)
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_ANY
-#elif defined(HAVE_XZ)
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_COMPRESSED_XZ
-#elif defined(HAVE_LZ4)
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_COMPRESSED_LZ4
+#ifdef HAVE_XZ
+#  define HEADER_INCOMPATIBLE_SUPPORTED_XZ HEADER_INCOMPATIBLE_COMPRESSED_XZ
+#else
+#  define HEADER_INCOMPATIBLE_SUPPORTED_XZ 0
+#endif
+#ifdef HAVE_LZ4
+#  define HEADER_INCOMPATIBLE_SUPPORTED_LZ4 HEADER_INCOMPATIBLE_COMPRESSED_LZ4
+#else
+#  define HEADER_INCOMPATIBLE_SUPPORTED_LZ4 0
+#endif
+#ifdef HAVE_ZSTD
+#  define HEADER_INCOMPATIBLE_SUPPORTED_ZSTD HEADER_INCOMPATIBLE_COMPRESSED_ZSTD
 #else
-#  define HEADER_INCOMPATIBLE_SUPPORTED 0
+#  define HEADER_INCOMPATIBLE_SUPPORTED_ZSTD 0
 #endif
 
+#define HEADER_INCOMPATIBLE_SUPPORTED \
+        (HEADER_INCOMPATIBLE_SUPPORTED_XZ|HEADER_INCOMPATIBLE_SUPPORTED_LZ4|HEADER_INCOMPATIBLE_SUPPORTED_ZSTD)
+
 enum {
-        HEADER_COMPATIBLE_SEALED = 1
+        HEADER_COMPATIBLE_SEALED = 1 << 0,
+        HEADER_COMPATIBLE_ENTRY_INDEX = 1 << 1,
+        HEADER_COMPATIBLE_DATA_BLOOM = 1 << 2,
 };
 
-#define HEADER_COMPATIBLE_ANY HEADER_COMPATIBLE_SEALED
+#define HEADER_COMPATIBLE_ANY (HEADER_COMPATIBLE_SEALED|HEADER_COMPATIBLE_ENTRY_INDEX|HEADER_COMPATIBLE_DATA_BLOOM)
 #ifdef HAVE_GCRYPT
-#  define HEADER_COMPATIBLE_SUPPORTED HEADER_COMPATIBLE_SEALED
+#  define HEADER_COMPATIBLE_SUPPORTED (HEADER_COMPATIBLE_SEALED|HEADER_COMPATIBLE_ENTRY_INDEX|HEADER_COMPATIBLE_DATA_BLOOM)
 #else
-#  define HEADER_COMPATIBLE_SUPPORTED 0
+#  define HEADER_COMPATIBLE_SUPPORTED (HEADER_COMPATIBLE_ENTRY_INDEX|HEADER_COMPATIBLE_DATA_BLOOM)
 #endif
 
 #define HEADER_SIGNATURE ((char[]) { 'L', 'P', 'K', 'S', 'H', 'H', 'R', 'H' })
@@ -216,8 +276,14 @@ struct Header {
         /* Added in 189 */
         le64_t n_tags;
         le64_t n_entry_arrays;
-
-        /* Size: 240 */
+        /* Added in 236 */
+        le64_t entry_index_offset;
+        le64_t data_bloom_offset;
+        le64_t compression_dictionary_offset;
+        le64_t data_hash_chain_depth;
+        le64_t field_hash_chain_depth;
+
+        /* Size: 280 */
 } _packed_;
 
 #define FSS_HEADER_SIGNATURE ((char[]) { 'K', 'S', 'H', 'H', 'R', 'H', 'L', 'P' })
@@ -22,6 +22,7 @@
 #include <linux/fs.h>
 #include <pthread.h>
 #include <stddef.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/statvfs.h>
 #include <sys/uio.h>
@@ -31,6 +32,7 @@
 #include "btrfs-util.h"
 #include "chattr-util.h"
 #include "compress.h"
+#include "env-util.h"
 #include "fd-util.h"
 #include "journal-authenticate.h"
 #include "journal-def.h"
@@ -48,8 +50,28 @@
 #define DEFAULT_DATA_HASH_TABLE_SIZE (2047ULL*sizeof(HashItem))
 #define DEFAULT_FIELD_HASH_TABLE_SIZE (333ULL*sizeof(HashItem))
 
+/* Bounds for the number of bytes of journal file we reserve one data hash table item for. The upper bound is what
+ * we assume if we know nothing about the messages that will be stored, the lower bound limits how large we make the
+ * hash table if the file we replace stored its data objects more densely. */
+#define DATA_HASH_TABLE_BYTES_PER_ITEM_MAX (768ULL)
+#define DATA_HASH_TABLE_BYTES_PER_ITEM_MIN (256ULL)
+
+/* If a hash chain of a file we write to gets longer than this, we suggest rotation */
+#define HASH_CHAIN_DEPTH_MAX (100ULL)
+
 #define COMPRESSION_SIZE_THRESHOLD (512ULL)
 
+/* With a trained dictionary even short payloads compress well */
+#define COMPRESSION_DICTIONARY_SIZE_THRESHOLD (64ULL)
+
+/* Bounds for training the dictionary of a new file on the DATA objects of the file it replaces. Training time grows
+ * with the amount of sample data. It runs in a thread started when rotating, and until it is done, DATA objects are
+ * written without the dictionary. */
+#define COMPRESSION_DICTIONARY_MAX_SIZE (16U*1024U)
+#define COMPRESSION_DICTIONARY_SAMPLES_MAX_SIZE (1024U*1024U)
+#define COMPRESSION_DICTIONARY_SAMPLE_MAX_SIZE (16U*1024U)
+#define COMPRESSION_DICTIONARY_SAMPLES_MIN 128U
+
 /* This is the minimum journal file size */
 #define JOURNAL_FILE_SIZE_MIN (512ULL*1024ULL)                 /* 512 KiB */
 
@@ -81,15 +103,54 @@
 /* How many entries to keep in the entry array chain cache at max */
 #define CHAIN_CACHE_MAX 20
 
+/* How many copied DATA objects to remember at max when copying entries into another file */
+#define COPY_CACHE_MAX (64U*1024U)
+
 /* How much to increase the journal file size at once each time we allocate something new. */
 #define FILE_SIZE_INCREASE (8ULL*1024ULL*1024ULL)              /* 8MB */
 
+/* How far to read ahead of the current entry when iterating sequentially */
+#define READAHEAD_SIZE (16ULL*1024ULL*1024ULL)                 /* 16MB */
+
 /* Reread fstat() of the file for detecting deletions at least this often */
 #define LAST_STAT_REFRESH_USEC (5*USEC_PER_SEC)
 
 /* The mmap context to use for the header we pick as one above the last defined typed */
 #define CONTEXT_HEADER _OBJECT_TYPE_MAX
 
+static int fsync_directory_of_file(int fd) {
+        _cleanup_free_ char *path = NULL, *dn = NULL;
+        _cleanup_close_ int dfd = -1;
+        struct stat st;
+        int r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (!S_ISREG(st.st_mode))
+                return -EBADFD;
+
+        r = fd_get_path(fd, &path);
+        if (r < 0)
+                return r;
+
+        if (!path_is_absolute(path))
+                return -EINVAL;
+
+        dn = dirname_malloc(path);
+        if (!dn)
+                return -ENOMEM;
+
+        dfd = open(dn, O_RDONLY|O_CLOEXEC|O_DIRECTORY);
+        if (dfd < 0)
+                return -errno;
+
+        if (fsync(dfd) < 0)
+                return -errno;
+
+        return 0;
+}
+
 /* This may be called from a separate thread to prevent blocking the caller for the duration of fsync().
  * As a result we use atomic operations on f->offline_state for inter-thread communications with
  * journal_file_set_offline() and journal_file_set_online(). */
@@ -123,6 +184,11 @@ static void journal_file_set_offline_internal(JournalFile *f) {
 
                         f->header->state = f->archive ? STATE_ARCHIVED : STATE_OFFLINE;
                         (void) fsync(f->fd);
+
+                        /* Make the rename done when archiving stick too, so that the caller doesn't have to
+                         * wait for it */
+                        if (f->archive)
+                                (void) fsync_directory_of_file(f->fd);
                         break;
 
                 case OFFLINE_OFFLINING:
@@ -142,9 +208,18 @@ static void journal_file_set_offline_internal(JournalFile *f) {
 
 static void * journal_file_set_offline_thread(void *arg) {
         JournalFile *f = arg;
+        int fd;
+
+        /* Read this before finishing, the owner may free the file once it sees we're done. It needs to join us
+         * before it can do so, but let's not rely on that. */
+        fd = f->offline_notify_fd;
 
         journal_file_set_offline_internal(f);
 
+        /* Wake up the owner's event loop, so that it can join us and close the file if it was waiting for that */
+        if (fd >= 0)
+                (void) eventfd_write(fd, 1);
+
         return NULL;
 }
 
@@ -251,6 +326,12 @@ int journal_file_set_offline(JournalFile *f, bool wait) {
         return 0;
 }
 
+/* Puts the file back online before it is modified. Two things here block, both deliberately. If an offline thread
+ * is already writing the OFFLINE state, it can't be canceled anymore and has to be joined, or it would overwrite the
+ * state set here. And the ONLINE state is fsync()ed before returning: until it is on disk, the kernel might write
+ * back modified objects before the header, and after a crash the file would claim to have been closed cleanly. As
+ * the file was synced completely when it went offline, that fsync() only has to write back the header page. All the
+ * expensive syncing happens in the offline thread. */
 static int journal_file_set_online(JournalFile *f) {
         bool joined = false;
 
@@ -328,6 +409,31 @@ bool journal_file_is_offlining(JournalFile *f) {
         return true;
 }
 
+#ifdef HAVE_ZSTD
+struct CompressDictionaryTraining {
+        pthread_t thread;
+
+        uint8_t *samples;
+        size_t *sizes;
+        unsigned n_samples;
+
+        void *dict;
+        size_t dict_size;
+        int result;
+};
+
+static CompressDictionaryTraining* compress_dictionary_training_free(CompressDictionaryTraining *t) {
+        if (!t)
+                return NULL;
+
+        free(t->samples);
+        free(t->sizes);
+        free(t->dict);
+
+        return mfree(t);
+}
+#endif
+
 JournalFile* journal_file_close(JournalFile *f) {
         assert(f);
 
@@ -377,11 +483,22 @@ JournalFile* journal_file_close(JournalFile *f) {
         mmap_cache_unref(f->mmap);
 
         ordered_hashmap_free_free(f->chain_cache);
+        hashmap_free_free(f->copy_cache);
 
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
         free(f->compress_buffer);
 #endif
 
+        compress_dictionary_free(f->compress_dictionary);
+
+#ifdef HAVE_ZSTD
+        /* A dictionary that is still being trained is of no use anymore */
+        if (f->compress_dictionary_training) {
+                (void) pthread_join(f->compress_dictionary_training->thread, NULL);
+                compress_dictionary_training_free(f->compress_dictionary_training);
+        }
+#endif
+
 #ifdef HAVE_GCRYPT
         if (f->fss_file)
                 munmap(f->fss_file, PAGE_ALIGN(f->fss_file_size));
@@ -418,7 +535,8 @@ static int journal_file_init_header(JournalFile *f, JournalFile *template) {
 
         h.incompatible_flags |= htole32(
                 f->compress_xz * HEADER_INCOMPATIBLE_COMPRESSED_XZ |
-                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4);
+                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4 |
+                f->compress_zstd * HEADER_INCOMPATIBLE_COMPRESSED_ZSTD);
 
         h.compatible_flags = htole32(
                 f->seal * HEADER_COMPATIBLE_SEALED);
@@ -443,39 +561,6 @@ static int journal_file_init_header(JournalFile *f, JournalFile *template) {
         return 0;
 }
 
-static int fsync_directory_of_file(int fd) {
-        _cleanup_free_ char *path = NULL, *dn = NULL;
-        _cleanup_close_ int dfd = -1;
-        struct stat st;
-        int r;
-
-        if (fstat(fd, &st) < 0)
-                return -errno;
-
-        if (!S_ISREG(st.st_mode))
-                return -EBADFD;
-
-        r = fd_get_path(fd, &path);
-        if (r < 0)
-                return r;
-
-        if (!path_is_absolute(path))
-                return -EINVAL;
-
-        dn = dirname_malloc(path);
-        if (!dn)
-                return -ENOMEM;
-
-        dfd = open(dn, O_RDONLY|O_CLOEXEC|O_DIRECTORY);
-        if (dfd < 0)
-                return -errno;
-
-        if (fsync(dfd) < 0)
-                return -errno;
-
-        return 0;
-}
-
 static int journal_file_refresh_header(JournalFile *f) {
         sd_id128_t boot_id;
         int r;
@@ -521,7 +606,7 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                   f->path, type, flags & ~any);
                 flags = (flags & any) & ~supported;
                 if (flags) {
-                        const char* strv[3];
+                        const char* strv[4];
                         unsigned n = 0;
                         _cleanup_free_ char *t = NULL;
 
@@ -531,6 +616,8 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                 strv[n++] = "xz-compressed";
                         if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
                                 strv[n++] = "lz4-compressed";
+                        if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+                                strv[n++] = "zstd-compressed";
                         strv[n] = NULL;
                         assert(n < ELEMENTSOF(strv));
 
@@ -626,6 +713,7 @@ static int journal_file_verify_header(JournalFile *f) {
 
         f->compress_xz = JOURNAL_HEADER_COMPRESSED_XZ(f->header);
         f->compress_lz4 = JOURNAL_HEADER_COMPRESSED_LZ4(f->header);
+        f->compress_zstd = JOURNAL_HEADER_COMPRESSED_ZSTD(f->header);
 
         f->seal = JOURNAL_HEADER_SEALED(f->header);
 
@@ -761,6 +849,9 @@ static uint64_t minimum_header_size(Object *o) {
                 [OBJECT_FIELD_HASH_TABLE] = sizeof(HashTableObject),
                 [OBJECT_ENTRY_ARRAY] = sizeof(EntryArrayObject),
                 [OBJECT_TAG] = sizeof(TagObject),
+                [OBJECT_ENTRY_INDEX] = sizeof(EntryIndexObject),
+                [OBJECT_DATA_BLOOM] = sizeof(DataBloomObject),
+                [OBJECT_COMPRESSION_DICTIONARY] = sizeof(CompressionDictionaryObject),
         };
 
         if (o->object.type >= ELEMENTSOF(table) || table[o->object.type] <= 0)
@@ -926,6 +1017,47 @@ static int journal_file_check_object(JournalFile *f, uint64_t offset, Object *o)
                         return -EBADMSG;
                 }
 
+                break;
+
+        case OBJECT_ENTRY_INDEX:
+                if ((le64toh(o->object.size) - offsetof(EntryIndexObject, items)) % sizeof(EntryIndexItem) != 0) {
+                        log_debug(
+                              "Invalid object entry index size: %"PRIu64": %"PRIu64,
+                              le64toh(o->object.size),
+                              offset);
+                        return -EBADMSG;
+                }
+
+                break;
+
+        case OBJECT_DATA_BLOOM: {
+                uint64_t sz, fields_size;
+
+                sz = le64toh(o->object.size) - offsetof(DataBloomObject, payload);
+                fields_size = le32toh(o->data_bloom.fields_size);
+
+                if (fields_size < 1 || fields_size >= sz || o->data_bloom.payload[fields_size - 1] != 0 ||
+                    le32toh(o->data_bloom.n_hashes) <= 0) {
+                        log_debug(
+                              "Invalid object data bloom filter size: %"PRIu64"/%"PRIu64": %"PRIu64,
+                              le64toh(o->object.size),
+                              fields_size,
+                              offset);
+                        return -EBADMSG;
+                }
+
+                break;
+        }
+
+        case OBJECT_COMPRESSION_DICTIONARY:
+                if (le64toh(o->object.size) <= offsetof(CompressionDictionaryObject, payload)) {
+                        log_debug(
+                              "Invalid object compression dictionary size: %"PRIu64": %"PRIu64,
+                              le64toh(o->object.size),
+                              offset);
+                        return -EBADMSG;
+                }
+
                 break;
         }
 
@@ -1028,22 +1160,16 @@ static uint64_t journal_file_entry_seqnum(JournalFile *f, uint64_t *seqnum) {
         return r;
 }
 
-int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, Object **ret, uint64_t *offset) {
-        int r;
+static int journal_file_tail_end(JournalFile *f, uint64_t *ret) {
+        Object *tail;
         uint64_t p;
-        Object *tail, *o;
-        void *t;
+        int r;
 
         assert(f);
         assert(f->header);
-        assert(type > OBJECT_UNUSED && type < _OBJECT_TYPE_MAX);
-        assert(size >= sizeof(ObjectHeader));
-        assert(offset);
         assert(ret);
 
-        r = journal_file_set_online(f);
-        if (r < 0)
-                return r;
+        /* Returns the offset where the next object will be appended */
 
         p = le64toh(f->header->tail_object_offset);
         if (p == 0)
@@ -1056,6 +1182,31 @@ int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, O
                 p += ALIGN64(le64toh(tail->object.size));
         }
 
+        *ret = p;
+        return 0;
+}
+
+int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, Object **ret, uint64_t *offset) {
+        int r;
+        uint64_t p;
+        Object *o;
+        void *t;
+
+        assert(f);
+        assert(f->header);
+        assert(type > OBJECT_UNUSED && type < _OBJECT_TYPE_MAX);
+        assert(size >= sizeof(ObjectHeader));
+        assert(offset);
+        assert(ret);
+
+        r = journal_file_set_online(f);
+        if (r < 0)
+                return r;
+
+        r = journal_file_tail_end(f, &p);
+        if (r < 0)
+                return r;
+
         r = journal_file_allocate(f, p, size);
         if (r < 0)
                 return r;
@@ -1079,8 +1230,29 @@ int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, O
         return 0;
 }
 
-static int journal_file_setup_data_hash_table(JournalFile *f) {
-        uint64_t s, p;
+static uint64_t journal_file_data_bytes_per_item(JournalFile *template) {
+        uint64_t n;
+
+        /* If we replace a file, use the number of bytes it needed per data object, so that files with many small
+         * unique values (e.g. request IDs) get a hash table that fits them, instead of long hash chains. */
+
+        if (!template || !template->header)
+                return DATA_HASH_TABLE_BYTES_PER_ITEM_MAX;
+
+        if (!JOURNAL_HEADER_CONTAINS(template->header, n_data))
+                return DATA_HASH_TABLE_BYTES_PER_ITEM_MAX;
+
+        n = le64toh(template->header->n_data);
+        if (n <= 0)
+                return DATA_HASH_TABLE_BYTES_PER_ITEM_MAX;
+
+        return CLAMP(le64toh(template->header->arena_size) / n,
+                     DATA_HASH_TABLE_BYTES_PER_ITEM_MIN,
+                     DATA_HASH_TABLE_BYTES_PER_ITEM_MAX);
+}
+
+static int journal_file_setup_data_hash_table(JournalFile *f, JournalFile *template) {
+        uint64_t s, p, b;
         Object *o;
         int r;
 
@@ -1088,15 +1260,17 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         assert(f->header);
 
         /* We estimate that we need 1 hash table entry per 768 bytes
-           of journal file and we want to make sure we never get
-           beyond 75% fill level. Calculate the hash table size for
-           the maximum file size based on these metrics. */
+           of journal file (or whatever the file we replace needed)
+           and we want to make sure we never get beyond 75% fill
+           level. Calculate the hash table size for the maximum file
+           size based on these metrics. */
 
-        s = (f->metrics.max_size * 4 / 768 / 3) * sizeof(HashItem);
+        b = journal_file_data_bytes_per_item(template);
+        s = (f->metrics.max_size * 4 / b / 3) * sizeof(HashItem);
         if (s < DEFAULT_DATA_HASH_TABLE_SIZE)
                 s = DEFAULT_DATA_HASH_TABLE_SIZE;
 
-        log_debug("Reserving %"PRIu64" entries in hash table.", s / sizeof(HashItem));
+        log_debug("Reserving %"PRIu64" entries in hash table (%"PRIu64" bytes per item).", s / sizeof(HashItem), b);
 
         r = journal_file_append_object(f,
                                        OBJECT_DATA_HASH_TABLE,
@@ -1113,7 +1287,7 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         return 0;
 }
 
-static int journal_file_setup_field_hash_table(JournalFile *f) {
+static int journal_file_setup_field_hash_table(JournalFile *f, JournalFile *template) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1122,9 +1296,13 @@ static int journal_file_setup_field_hash_table(JournalFile *f) {
         assert(f->header);
 
         /* We use a fixed size hash table for the fields as this
-         * number should grow very slowly only */
+         * number should grow very slowly only. If the file we
+         * replace had more fields than fit at 75% fill level, make
+         * room for them. */
 
         s = DEFAULT_FIELD_HASH_TABLE_SIZE;
+        if (template && template->header && JOURNAL_HEADER_CONTAINS(template->header, n_fields))
+                s = MAX(s, (le64toh(template->header->n_fields) * 4 / 3) * sizeof(HashItem));
         r = journal_file_append_object(f,
                                        OBJECT_FIELD_HASH_TABLE,
                                        offsetof(Object, hash_table.items) + s,
@@ -1293,7 +1471,7 @@ int journal_file_find_field_object_with_hash(
                 const void *field, uint64_t size, uint64_t hash,
                 Object **ret, uint64_t *offset) {
 
-        uint64_t p, osize, h, m;
+        uint64_t p, osize, h, m, depth = 0;
         int r;
 
         assert(f);
@@ -1338,8 +1516,15 @@ int journal_file_find_field_object_with_hash(
                 }
 
                 p = le64toh(o->field.next_hash_offset);
+                depth++;
         }
 
+        /* Same as for data objects, see below */
+        if (f->writable &&
+            JOURNAL_HEADER_CONTAINS(f->header, field_hash_chain_depth) &&
+            depth > le64toh(f->header->field_hash_chain_depth))
+                f->header->field_hash_chain_depth = htole64(depth);
+
         return 0;
 }
 
@@ -1360,12 +1545,50 @@ int journal_file_find_field_object(
                                                         ret, offset);
 }
 
+CompressDictionary* journal_file_compress_dictionary(JournalFile *f) {
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Returns the dictionary zstd compressed DATA objects of this file may use, loading it on first use, or
+         * NULL if there is none */
+
+        if (f->compress_dictionary)
+                return f->compress_dictionary;
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset))
+                return NULL;
+
+        p = le64toh(f->header->compression_dictionary_offset);
+        if (p == 0)
+                return NULL;
+
+        r = journal_file_move_to_object(f, OBJECT_COMPRESSION_DICTIONARY, p, &o);
+        if (r < 0)
+                goto fail;
+
+        r = compress_dictionary_new(o->compression_dictionary.payload,
+                                    le64toh(o->object.size) - offsetof(Object, compression_dictionary.payload),
+                                    &f->compress_dictionary);
+        if (r < 0)
+                goto fail;
+
+        return f->compress_dictionary;
+
+fail:
+        log_debug_errno(r, "Failed to load compression dictionary of %s: %m", f->path);
+        return NULL;
+}
+
 int journal_file_find_data_object_with_hash(
                 JournalFile *f,
                 const void *data, uint64_t size, uint64_t hash,
                 Object **ret, uint64_t *offset) {
 
-        uint64_t p, osize, h, m;
+        uint64_t p, osize, h, m, depth = 0;
         int r;
 
         assert(f);
@@ -1401,7 +1624,7 @@ int journal_file_find_data_object_with_hash(
                         goto next;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
                         uint64_t l;
                         size_t rsize = 0;
 
@@ -1411,7 +1634,7 @@ int journal_file_find_data_object_with_hash(
 
                         l -= offsetof(Object, data.payload);
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
+                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK, journal_file_compress_dictionary(f),
                                             o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
                         if (r < 0)
                                 return r;
@@ -1444,8 +1667,16 @@ int journal_file_find_data_object_with_hash(
 
         next:
                 p = le64toh(o->data.next_hash_offset);
+                depth++;
         }
 
+        /* Remember the longest hash chain we had to walk through completely, i.e. right before an object is
+         * appended to it, so that we can suggest rotation when lookups get slow */
+        if (f->writable &&
+            JOURNAL_HEADER_CONTAINS(f->header, data_hash_chain_depth) &&
+            depth > le64toh(f->header->data_hash_chain_depth))
+                f->header->data_hash_chain_depth = htole64(depth);
+
         return 0;
 }
 
@@ -1528,12 +1759,42 @@ static int journal_file_append_field(
         return 0;
 }
 
-static int journal_file_append_data(
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
+static int journal_file_compress_blob(JournalFile *f, const void *src, uint64_t src_size,
+                                      void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        int r;
+
+        assert(f);
+
+        /* Use the algorithm the file header announces, which is not necessarily the one we'd pick for new
+         * files */
+
+        if (f->compress_zstd) {
+                r = compress_blob_zstd_with_dictionary(journal_file_compress_dictionary(f),
+                                                       src, src_size, dst, dst_alloc_size, dst_size);
+                return r < 0 ? r : OBJECT_COMPRESSED_ZSTD;
+        }
+
+        if (f->compress_lz4) {
+                r = compress_blob_lz4(src, src_size, dst, dst_alloc_size, dst_size);
+                return r < 0 ? r : OBJECT_COMPRESSED_LZ4;
+        }
+
+        if (f->compress_xz) {
+                r = compress_blob_xz(src, src_size, dst, dst_alloc_size, dst_size);
+                return r < 0 ? r : OBJECT_COMPRESSED_XZ;
+        }
+
+        return -EPROTONOSUPPORT;
+}
+#endif
+
+static int journal_file_append_data_with_hash(
                 JournalFile *f,
-                const void *data, uint64_t size,
+                const void *data, uint64_t size, uint64_t hash,
                 Object **ret, uint64_t *offset) {
 
-        uint64_t hash, p;
+        uint64_t p;
         uint64_t osize;
         Object *o;
         int r, compression = 0;
@@ -1542,8 +1803,6 @@ static int journal_file_append_data(
         assert(f);
         assert(data || size == 0);
 
-        hash = hash64(data, size);
-
         r = journal_file_find_data_object_with_hash(f, data, size, hash, &o, &p);
         if (r < 0)
                 return r;
@@ -1558,6 +1817,11 @@ static int journal_file_append_data(
                 return 0;
         }
 
+#ifdef HAVE_ZSTD
+        /* Make use of the dictionary as soon as it is trained */
+        (void) journal_file_install_compression_dictionary(f, false);
+#endif
+
         osize = offsetof(Object, data.payload) + size;
         r = journal_file_append_object(f, OBJECT_DATA, osize, &o, &p);
         if (r < 0)
@@ -1565,11 +1829,12 @@ static int journal_file_append_data(
 
         o->data.hash = htole64(hash);
 
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
-        if (JOURNAL_FILE_COMPRESS(f) && size >= COMPRESSION_SIZE_THRESHOLD) {
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
+        if (JOURNAL_FILE_COMPRESS(f) &&
+            size >= (journal_file_compress_dictionary(f) ? COMPRESSION_DICTIONARY_SIZE_THRESHOLD : COMPRESSION_SIZE_THRESHOLD)) {
                 size_t rsize = 0;
 
-                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize);
+                compression = journal_file_compress_blob(f, data, size, o->data.payload, size - 1, &rsize);
 
                 if (compression >= 0) {
                         o->object.size = htole64(offsetof(Object, data.payload) + rsize);
@@ -1629,6 +1894,17 @@ static int journal_file_append_data(
         return 0;
 }
 
+static int journal_file_append_data(
+                JournalFile *f,
+                const void *data, uint64_t size,
+                Object **ret, uint64_t *offset) {
+
+        assert(f);
+        assert(data || size == 0);
+
+        return journal_file_append_data_with_hash(f, data, size, hash64(data, size), ret, offset);
+}
+
 uint64_t journal_file_entry_n_items(Object *o) {
         assert(o);
 
@@ -1656,6 +1932,15 @@ uint64_t journal_file_hash_table_n_items(Object *o) {
         return (le64toh(o->object.size) - offsetof(Object, hash_table.items)) / sizeof(HashItem);
 }
 
+uint64_t journal_file_entry_index_n_items(Object *o) {
+        assert(o);
+
+        if (o->object.type != OBJECT_ENTRY_INDEX)
+                return 0;
+
+        return (le64toh(o->object.size) - offsetof(Object, entry_index.items)) / sizeof(EntryIndexItem);
+}
+
 static int link_entry_into_array(JournalFile *f,
                                  le64_t *first,
                                  le64_t *idx,
@@ -1888,9 +2173,14 @@ void journal_file_post_change(JournalFile *f) {
 }
 
 static int post_change_thunk(sd_event_source *timer, uint64_t usec, void *userdata) {
-        assert(userdata);
+        JournalFile *f = userdata;
+
+        assert(f);
+
+        journal_file_post_change(f);
 
-        journal_file_post_change(userdata);
+        if (sd_event_now(sd_event_source_get_event(timer), CLOCK_MONOTONIC, &f->post_change_last_usec) < 0)
+                f->post_change_last_usec = usec;
 
         return 1;
 }
@@ -1898,7 +2188,7 @@ static int post_change_thunk(sd_event_source *timer, uint64_t usec, void *userda
 static void schedule_post_change(JournalFile *f) {
         sd_event_source *timer;
         int enabled, r;
-        uint64_t now;
+        uint64_t now, next;
 
         assert(f);
         assert(f->post_change_timer);
@@ -1920,7 +2210,20 @@ static void schedule_post_change(JournalFile *f) {
                 goto fail;
         }
 
-        r = sd_event_source_set_time(timer, now+f->post_change_timer_period);
+        /* If we haven't posted a change for a full period, do so as soon as we are back in the event loop, so
+         * that followers see sporadic messages right away. Otherwise wait for the period to pass, coalescing all
+         * changes in the meantime, so that busy logging doesn't result in a flood of inotify events. In the former
+         * case, make sure the timer isn't coalesced with others, which would delay it by up to the default
+         * accuracy. */
+        next = usec_add(f->post_change_last_usec, f->post_change_timer_period);
+
+        r = sd_event_source_set_time_accuracy(timer, next <= now ? 1 : 0);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to set accuracy for scheduling ftruncate: %m");
+                goto fail;
+        }
+
+        r = sd_event_source_set_time(timer, MAX(now, next));
         if (r < 0) {
                 log_debug_errno(r, "Failed to set time for scheduling ftruncate: %m");
                 goto fail;
@@ -2034,33 +2337,222 @@ int journal_file_append_entry(JournalFile *f, const dual_timestamp *ts, const st
         return r;
 }
 
-typedef struct ChainCacheItem {
-        uint64_t first; /* the array at the beginning of the chain */
-        uint64_t array; /* the cached array */
-        uint64_t begin; /* the first item in the cached array */
-        uint64_t total; /* the total number of items in all arrays before this one in the chain */
-        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
-} ChainCacheItem;
+typedef struct BatchData {
+        const struct iovec *iovec;
+        uint64_t hash;
+        uint64_t offset; /* offset of the DATA object in the file, 0 if not appended yet */
+} BatchData;
 
-static void chain_cache_put(
-                OrderedHashmap *h,
-                ChainCacheItem *ci,
-                uint64_t first,
-                uint64_t array,
-                uint64_t begin,
-                uint64_t total,
-                uint64_t last_index) {
+static void batch_data_hash_func(const void *p, struct siphash *state) {
+        const BatchData *d = p;
 
-        if (!ci) {
-                /* If the chain item to cache for this chain is the
-                 * first one it's not worth caching anything */
-                if (array == first)
-                        return;
+        /* The payload was already hashed once for the file's hash table, reuse that */
+        siphash24_compress(&d->hash, sizeof(d->hash), state);
+}
 
-                if (ordered_hashmap_size(h) >= CHAIN_CACHE_MAX) {
-                        ci = ordered_hashmap_steal_first(h);
-                        assert(ci);
-                } else {
+static int batch_data_compare_func(const void *_a, const void *_b) {
+        const BatchData *a = _a, *b = _b;
+
+        if (a->hash < b->hash)
+                return -1;
+        if (a->hash > b->hash)
+                return 1;
+
+        if (a->iovec->iov_len < b->iovec->iov_len)
+                return -1;
+        if (a->iovec->iov_len > b->iovec->iov_len)
+                return 1;
+
+        if (a->iovec->iov_len == 0)
+                return 0;
+
+        return memcmp(a->iovec->iov_base, b->iovec->iov_base, a->iovec->iov_len);
+}
+
+static const struct hash_ops batch_data_hash_ops = {
+        .hash = batch_data_hash_func,
+        .compare = batch_data_compare_func,
+};
+
+static int journal_file_append_batch_entry(
+                JournalFile *f,
+                const JournalEntry *e,
+                BatchData *data,
+                Hashmap *cache,
+                uint64_t *seqnum) {
+
+        uint64_t xor_hash = 0;
+        EntryItem *items;
+        unsigned i;
+        int r;
+
+        assert(f);
+        assert(e);
+        assert(data || e->n_iovec == 0);
+        assert(cache);
+
+#ifdef HAVE_GCRYPT
+        r = journal_file_maybe_append_tag(f, e->ts.realtime);
+        if (r < 0)
+                return r;
+#endif
+
+        /* alloca() can't take 0, hence let's allocate at least one */
+        items = alloca(sizeof(EntryItem) * MAX(1u, e->n_iovec));
+
+        for (i = 0; i < e->n_iovec; i++) {
+                BatchData *d;
+
+                /* Identical payloads within the batch share the first occurrence's DATA object, which saves
+                 * us the hash chain walk for all but the first one. */
+                d = hashmap_get(cache, data + i);
+                assert(d);
+
+                if (d->offset == 0) {
+                        r = journal_file_append_data_with_hash(f, d->iovec->iov_base, d->iovec->iov_len, d->hash, NULL, &d->offset);
+                        if (r < 0)
+                                return r;
+                }
+
+                xor_hash ^= d->hash;
+                items[i].object_offset = htole64(d->offset);
+                items[i].hash = htole64(d->hash);
+        }
+
+        qsort_safe(items, e->n_iovec, sizeof(EntryItem), entry_item_cmp);
+
+        return journal_file_append_entry_internal(f, &e->ts, xor_hash, items, e->n_iovec, seqnum, NULL, NULL);
+}
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalEntry entries[], unsigned n_entries,
+                uint64_t *seqnum,
+                unsigned *ret_n_appended) {
+
+        _cleanup_hashmap_free_ Hashmap *cache = NULL;
+        _cleanup_free_ BatchData *data = NULL;
+        unsigned i, j, k, n_data = 0, n_appended = 0;
+        uint64_t reserve = 0, p;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(entries || n_entries == 0);
+
+        /* Appends a series of entries in one go. In contrast to calling journal_file_append_entry() for each of
+         * them, every payload is hashed only once, duplicate payloads within the batch are looked up only once,
+         * the file is grown only once for the whole batch, and the change is posted only once at the end. If an
+         * error is hit, the entries appended so far stay in the file, and their number is returned in
+         * ret_n_appended, so that the caller may rotate and retry with the rest. */
+
+        /* Nothing is appended on the early error paths below */
+        if (ret_n_appended)
+                *ret_n_appended = 0;
+
+        for (i = 0; i < n_entries; i++)
+                n_data += entries[i].n_iovec;
+
+        data = new(BatchData, MAX(1u, n_data));
+        if (!data)
+                return -ENOMEM;
+
+        cache = hashmap_new(&batch_data_hash_ops);
+        if (!cache)
+                return -ENOMEM;
+
+        for (i = 0, k = 0; i < n_entries; i++) {
+                assert(entries[i].iovec || entries[i].n_iovec == 0);
+
+                reserve += ALIGN64(offsetof(Object, entry.items) + entries[i].n_iovec * sizeof(EntryItem));
+
+                for (j = 0; j < entries[i].n_iovec; j++, k++) {
+                        const struct iovec *iov = entries[i].iovec + j;
+
+                        data[k] = (BatchData) {
+                                .iovec = iov,
+                                .hash = hash64(iov->iov_base, iov->iov_len),
+                        };
+
+                        r = hashmap_put(cache, data + k, data + k);
+                        if (r == -EEXIST)
+                                continue;
+                        if (r < 0)
+                                return r;
+
+                        reserve += ALIGN64(offsetof(Object, data.payload) + iov->iov_len);
+                }
+        }
+
+        r = journal_file_set_online(f);
+        if (r < 0)
+                return r;
+
+        /* Reserve space for the whole batch up front. This is an upper bound, as some of the payloads are
+         * likely already in the file. Hence, if we can't get all of it, don't fail, but let the individual
+         * object allocations decide. */
+        r = journal_file_tail_end(f, &p);
+        if (r < 0)
+                return r;
+
+        r = journal_file_allocate(f, p, reserve);
+        if (r < 0 && r != -E2BIG)
+                return r;
+
+        for (i = 0, k = 0; i < n_entries; i++) {
+                r = journal_file_append_batch_entry(f, entries + i, data + k, cache, seqnum);
+                if (r < 0)
+                        break;
+
+                k += entries[i].n_iovec;
+                n_appended++;
+        }
+
+        /* See journal_file_append_entry(). We can't tell which of the entries were hit by the SIGBUS, hence
+         * consider none of them written. */
+        if (mmap_cache_got_sigbus(f->mmap, f->cache_fd)) {
+                r = -EIO;
+                n_appended = 0;
+        }
+
+        if (f->post_change_timer)
+                schedule_post_change(f);
+        else
+                journal_file_post_change(f);
+
+        if (ret_n_appended)
+                *ret_n_appended = n_appended;
+
+        return r < 0 ? r : 0;
+}
+
+typedef struct ChainCacheItem {
+        uint64_t first; /* the array at the beginning of the chain */
+        uint64_t array; /* the cached array */
+        uint64_t begin; /* the first item in the cached array */
+        uint64_t total; /* the total number of items in all arrays before this one in the chain */
+        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
+} ChainCacheItem;
+
+static void chain_cache_put(
+                OrderedHashmap *h,
+                ChainCacheItem *ci,
+                uint64_t first,
+                uint64_t array,
+                uint64_t begin,
+                uint64_t total,
+                uint64_t last_index) {
+
+        if (!ci) {
+                /* If the chain item to cache for this chain is the
+                 * first one it's not worth caching anything */
+                if (array == first)
+                        return;
+
+                if (ordered_hashmap_size(h) >= CHAIN_CACHE_MAX) {
+                        ci = ordered_hashmap_steal_first(h);
+                        assert(ci);
+                } else {
                         ci = new(ChainCacheItem, 1);
                         if (!ci)
                                 return;
@@ -2498,6 +2990,63 @@ static int test_object_seqnum(JournalFile *f, uint64_t p, uint64_t needle) {
                 return TEST_RIGHT;
 }
 
+static int journal_file_seek_entry_index(JournalFile *f, uint64_t needle, bool by_seqnum) {
+        uint64_t p, first, left, right;
+        EntryIndexItem *item;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* If the file carries an entry index, look up the last array of the main entry array chain that starts
+         * before the needle, and prime the chain cache with it, so that the bisection can jump right to it,
+         * instead of walking the chain from the beginning. */
+
+        if (!JOURNAL_HEADER_ENTRY_INDEX(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset))
+                return 0;
+
+        p = le64toh(f->header->entry_index_offset);
+        if (p == 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_INDEX, p, &o);
+        if (r < 0)
+                return r;
+
+        /* Entries were added after the index was written, don't trust it */
+        if (le64toh(o->entry_index.n_entries) != le64toh(f->header->n_entries))
+                return 0;
+
+        left = 0;
+        right = journal_file_entry_index_n_items(o);
+        while (left < right) {
+                uint64_t i, k;
+
+                i = (left + right) / 2;
+                item = o->entry_index.items + i;
+                k = le64toh(by_seqnum ? item->seqnum : item->realtime);
+
+                if (k < needle)
+                        left = i + 1;
+                else
+                        right = i;
+        }
+
+        /* Nothing to skip if the needle is in the first array */
+        if (left <= 1)
+                return 0;
+
+        item = o->entry_index.items + left - 1;
+        first = le64toh(f->header->entry_array_offset);
+
+        chain_cache_put(f->chain_cache, ordered_hashmap_get(f->chain_cache, &first),
+                        first, le64toh(item->entry_array_offset), le64toh(item->entry_offset), le64toh(item->total),
+                        (uint64_t) -1);
+        return 1;
+}
+
 int journal_file_move_to_entry_by_seqnum(
                 JournalFile *f,
                 uint64_t seqnum,
@@ -2507,6 +3056,8 @@ int journal_file_move_to_entry_by_seqnum(
         assert(f);
         assert(f->header);
 
+        (void) journal_file_seek_entry_index(f, seqnum, true);
+
         return generic_array_bisect(f,
                                     le64toh(f->header->entry_array_offset),
                                     le64toh(f->header->n_entries),
@@ -2544,6 +3095,8 @@ int journal_file_move_to_entry_by_realtime(
         assert(f);
         assert(f->header);
 
+        (void) journal_file_seek_entry_index(f, realtime, false);
+
         return generic_array_bisect(f,
                                     le64toh(f->header->entry_array_offset),
                                     le64toh(f->header->n_entries),
@@ -2718,6 +3271,24 @@ static bool check_properly_ordered(uint64_t new_offset, uint64_t old_offset, dir
                 new_offset < old_offset;
 }
 
+static void journal_file_readahead(JournalFile *f, uint64_t p) {
+        uint64_t start;
+
+        assert(f);
+
+        /* Entries are appended in order, hence when iterating forward through a file we'll need the area
+         * right after the current entry next. Ask the kernel to read it in ahead of time, but only once we
+         * used up half of what we asked for last time, so that we don't issue a syscall for each entry. */
+
+        if (p + READAHEAD_SIZE / 2 < f->readahead_end)
+                return;
+
+        start = MAX(p, f->readahead_end);
+        (void) readahead(f->fd, start, p + READAHEAD_SIZE - start);
+
+        f->readahead_end = p + READAHEAD_SIZE;
+}
+
 int journal_file_next_entry(
                 JournalFile *f,
                 uint64_t p,
@@ -2779,6 +3350,9 @@ int journal_file_next_entry(
                 return -EBADMSG;
         }
 
+        if (f->sequential && direction == DIRECTION_DOWN)
+                journal_file_readahead(f, ofs);
+
         if (offset)
                 *offset = ofs;
 
@@ -3077,6 +3651,23 @@ void journal_file_dump(JournalFile *f) {
                                le64toh(o->tag.epoch));
                         break;
 
+                case OBJECT_ENTRY_INDEX:
+                        printf("Type: OBJECT_ENTRY_INDEX n_entries=%"PRIu64" n_items=%"PRIu64"\n",
+                               le64toh(o->entry_index.n_entries),
+                               journal_file_entry_index_n_items(o));
+                        break;
+
+                case OBJECT_DATA_BLOOM:
+                        printf("Type: OBJECT_DATA_BLOOM n_data=%"PRIu64" n_hashes=%"PRIu32"\n",
+                               le64toh(o->data_bloom.n_data),
+                               le32toh(o->data_bloom.n_hashes));
+                        break;
+
+                case OBJECT_COMPRESSION_DICTIONARY:
+                        printf("Type: OBJECT_COMPRESSION_DICTIONARY size=%"PRIu64"\n",
+                               le64toh(o->object.size) - offsetof(Object, compression_dictionary.payload));
+                        break;
+
                 default:
                         printf("Type: unknown (%i)\n", o->object.type);
                         break;
@@ -3121,8 +3712,8 @@ void journal_file_print_header(JournalFile *f) {
                "Boot ID: %s\n"
                "Sequential Number ID: %s\n"
                "State: %s\n"
-               "Compatible Flags:%s%s\n"
-               "Incompatible Flags:%s%s%s\n"
+               "Compatible Flags:%s%s%s%s\n"
+               "Incompatible Flags:%s%s%s%s\n"
                "Header size: %"PRIu64"\n"
                "Arena size: %"PRIu64"\n"
                "Data Hash Table Size: %"PRIu64"\n"
@@ -3144,9 +3735,12 @@ void journal_file_print_header(JournalFile *f) {
                f->header->state == STATE_ONLINE ? "ONLINE" :
                f->header->state == STATE_ARCHIVED ? "ARCHIVED" : "UNKNOWN",
                JOURNAL_HEADER_SEALED(f->header) ? " SEALED" : "",
+               JOURNAL_HEADER_ENTRY_INDEX(f->header) ? " ENTRY-INDEX" : "",
+               JOURNAL_HEADER_DATA_BLOOM(f->header) ? " DATA-BLOOM" : "",
                (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_ANY) ? " ???" : "",
                JOURNAL_HEADER_COMPRESSED_XZ(f->header) ? " COMPRESSED-XZ" : "",
                JOURNAL_HEADER_COMPRESSED_LZ4(f->header) ? " COMPRESSED-LZ4" : "",
+               JOURNAL_HEADER_COMPRESSED_ZSTD(f->header) ? " COMPRESSED-ZSTD" : "",
                (le32toh(f->header->incompatible_flags) & ~HEADER_INCOMPATIBLE_ANY) ? " ???" : "",
                le64toh(f->header->header_size),
                le64toh(f->header->arena_size),
@@ -3173,6 +3767,28 @@ void journal_file_print_header(JournalFile *f) {
                        le64toh(f->header->n_fields),
                        100.0 * (double) le64toh(f->header->n_fields) / ((double) (le64toh(f->header->field_hash_table_size) / sizeof(HashItem))));
 
+        if (JOURNAL_HEADER_CONTAINS(f->header, data_hash_chain_depth))
+                printf("Deepest Data Hash Chain: %"PRIu64"\n",
+                       le64toh(f->header->data_hash_chain_depth));
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, field_hash_chain_depth))
+                printf("Deepest Field Hash Chain: %"PRIu64"\n",
+                       le64toh(f->header->field_hash_chain_depth));
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_data) &&
+            journal_file_map_data_hash_table(f) >= 0) {
+                uint64_t i, m, used = 0;
+
+                m = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
+                for (i = 0; i < m; i++)
+                        if (f->data_hash_table[i].head_hash_offset != 0)
+                                used++;
+
+                if (used > 0)
+                        printf("Average Data Hash Chain: %.2f\n",
+                               (double) le64toh(f->header->n_data) / (double) used);
+        }
+
         if (JOURNAL_HEADER_CONTAINS(f->header, n_tags))
                 printf("Tag Objects: %"PRIu64"\n",
                        le64toh(f->header->n_tags));
@@ -3180,10 +3796,213 @@ void journal_file_print_header(JournalFile *f) {
                 printf("Entry Array Objects: %"PRIu64"\n",
                        le64toh(f->header->n_entry_arrays));
 
+        if (JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset) &&
+            le64toh(f->header->compression_dictionary_offset) > 0) {
+                Object *o;
+
+                if (journal_file_move_to_object(f, OBJECT_COMPRESSION_DICTIONARY, le64toh(f->header->compression_dictionary_offset), &o) >= 0)
+                        printf("Compression Dictionary Size: %s\n",
+                               format_bytes(bytes, sizeof(bytes), le64toh(o->object.size) - offsetof(Object, compression_dictionary.payload)));
+        }
+
         if (fstat(f->fd, &st) >= 0)
                 printf("Disk usage: %s\n", format_bytes(bytes, sizeof(bytes), (uint64_t) st.st_blocks * 512ULL));
 }
 
+#ifdef HAVE_ZSTD
+static int journal_file_collect_dictionary_samples(JournalFile *f, CompressDictionaryTraining *t) {
+        size_t n_samples_allocated = 0, n_sizes_allocated = 0, total = 0;
+        CompressDictionary *d;
+        uint64_t i, m;
+        int r;
+
+        assert(f);
+        assert(t);
+
+        /* Collects DATA payloads by walking the data hash table, whose order is unrelated to the order the data
+         * was written in, i.e. we get a mix of all fields rather than the head of the file. Large blobs such as
+         * core dumps would eat up the sample budget without helping the messages we care about, skip them. */
+
+        r = journal_file_map_data_hash_table(f);
+        if (r < 0)
+                return r;
+
+        d = journal_file_compress_dictionary(f);
+
+        m = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
+        for (i = 0; i < m && total < COMPRESSION_DICTIONARY_SAMPLES_MAX_SIZE; i++) {
+                uint64_t p;
+
+                p = le64toh(f->data_hash_table[i].head_hash_offset);
+                while (p > 0 && total < COMPRESSION_DICTIONARY_SAMPLES_MAX_SIZE) {
+                        const void *data;
+                        uint64_t l;
+                        Object *o;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        p = le64toh(o->data.next_hash_offset);
+
+                        l = le64toh(o->object.size) - offsetof(Object, data.payload);
+
+                        if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+                                size_t rsize = 0;
+
+                                r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK, d,
+                                                    o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                                if (r < 0)
+                                        return r;
+
+                                data = f->compress_buffer;
+                                l = rsize;
+                        } else
+                                data = o->data.payload;
+
+                        if (l < COMPRESSION_DICTIONARY_SIZE_THRESHOLD || l > COMPRESSION_DICTIONARY_SAMPLE_MAX_SIZE)
+                                continue;
+
+                        if (!GREEDY_REALLOC(t->samples, n_samples_allocated, total + l))
+                                return -ENOMEM;
+                        if (!GREEDY_REALLOC(t->sizes, n_sizes_allocated, t->n_samples + 1))
+                                return -ENOMEM;
+
+                        memcpy(t->samples + total, data, l);
+                        t->sizes[t->n_samples++] = l;
+                        total += l;
+                }
+        }
+
+        if (t->n_samples < COMPRESSION_DICTIONARY_SAMPLES_MIN)
+                return -ENODATA;
+
+        return 0;
+}
+
+static void *compress_dictionary_training_thread(void *userdata) {
+        CompressDictionaryTraining *t = userdata;
+
+        /* Only works on the samples we copied, hence doesn't need to synchronize with anything */
+        t->result = compress_dictionary_train(t->samples, t->sizes, t->n_samples, COMPRESSION_DICTIONARY_MAX_SIZE,
+                                              &t->dict, &t->dict_size);
+
+        t->samples = mfree(t->samples);
+        t->sizes = mfree(t->sizes);
+
+        return NULL;
+}
+
+static int journal_file_setup_compression_dictionary(JournalFile *f, JournalFile *template) {
+        CompressDictionaryTraining *t;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(template);
+
+        /* Trains a dictionary on the data of the file we replace, to be used for the new file. Journal data is
+         * highly repetitive from one file to the next, hence it should serve the new file well. We are called
+         * while rotating, hence only collect the samples here, and leave the training, which takes a while, to
+         * a thread. Until it is done, DATA objects are compressed without a dictionary. */
+
+        if (!f->compress_zstd)
+                return 0;
+
+        t = new0(CompressDictionaryTraining, 1);
+        if (!t)
+                return -ENOMEM;
+
+        r = journal_file_collect_dictionary_samples(template, t);
+        if (r == -ENODATA) {
+                log_debug("Not enough data in %s to train a compression dictionary on.", template->path);
+                r = 0;
+                goto fail;
+        }
+        if (r < 0)
+                goto fail;
+
+        r = pthread_create(&t->thread, NULL, compress_dictionary_training_thread, t);
+        if (r > 0) {
+                r = -r;
+                goto fail;
+        }
+
+        f->compress_dictionary_training = t;
+        return 0;
+
+fail:
+        compress_dictionary_training_free(t);
+        return r;
+}
+
+int journal_file_install_compression_dictionary(JournalFile *f, bool wait) {
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        CompressDictionaryTraining *t;
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Stores the dictionary trained in the background in the file, once it is ready. If wait is true, waits
+         * for the training to finish. Returns > 0 if a dictionary was added. */
+
+        t = f->compress_dictionary_training;
+        if (!t)
+                return 0;
+
+        r = wait ? pthread_join(t->thread, NULL) : pthread_tryjoin_np(t->thread, NULL);
+        if (r == EBUSY)
+                return 0;
+
+        f->compress_dictionary_training = NULL;
+
+        if (r > 0) {
+                r = -r;
+                goto finish;
+        }
+
+        r = t->result;
+        if (r < 0)
+                goto finish;
+
+        r = compress_dictionary_new(t->dict, t->dict_size, &d);
+        if (r < 0)
+                goto finish;
+
+        r = journal_file_append_object(f, OBJECT_COMPRESSION_DICTIONARY,
+                                       offsetof(Object, compression_dictionary.payload) + t->dict_size,
+                                       &o, &p);
+        if (r < 0)
+                goto finish;
+
+        memcpy(o->compression_dictionary.payload, t->dict, t->dict_size);
+
+#ifdef HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_COMPRESSION_DICTIONARY, o, p);
+        if (r < 0)
+                goto finish;
+#endif
+
+        f->header->compression_dictionary_offset = htole64(p);
+
+        f->compress_dictionary = d;
+        d = NULL;
+
+        log_debug("Trained %zu byte compression dictionary for %s.", t->dict_size, f->path);
+        r = 1;
+
+finish:
+        if (r < 0)
+                log_debug_errno(r, "Failed to set up compression dictionary for %s, ignoring: %m", f->path);
+
+        compress_dictionary_training_free(t);
+        return r;
+}
+#endif
+
 static int journal_file_warn_btrfs(JournalFile *f) {
         unsigned attrs;
         int r;
@@ -3255,15 +4074,28 @@ int journal_file_open(
 
         f->fd = fd;
         f->mode = mode;
+        f->offline_notify_fd = template ? template->offline_notify_fd : -1;
 
         f->flags = flags;
         f->prot = prot_from_flags(flags);
         f->writable = (flags & O_ACCMODE) != O_RDONLY;
+        if (compress) {
+#ifdef HAVE_ZSTD
+                /* Older versions can't read zstd compressed files, hence use it only when asked to */
+                if (getenv_bool("SYSTEMD_JOURNAL_ZSTD") > 0)
+                        f->compress_zstd = true;
+                else
+#endif
 #if defined(HAVE_LZ4)
-        f->compress_lz4 = compress;
+                        f->compress_lz4 = true;
 #elif defined(HAVE_XZ)
-        f->compress_xz = compress;
+                        f->compress_xz = true;
+#elif defined(HAVE_ZSTD)
+                        f->compress_zstd = true;
+#else
+                        ;
 #endif
+        }
 #ifdef HAVE_GCRYPT
         f->seal = seal;
 #endif
@@ -3403,11 +4235,11 @@ int journal_file_open(
 #endif
 
         if (newly_created) {
-                r = journal_file_setup_field_hash_table(f);
+                r = journal_file_setup_field_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
-                r = journal_file_setup_data_hash_table(f);
+                r = journal_file_setup_data_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
@@ -3416,6 +4248,14 @@ int journal_file_open(
                 if (r < 0)
                         goto fail;
 #endif
+
+#ifdef HAVE_ZSTD
+                if (template) {
+                        r = journal_file_setup_compression_dictionary(f, template);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to set up compression dictionary for %s, ignoring: %m", f->path);
+                }
+#endif
         }
 
         if (mmap_cache_got_sigbus(f->mmap, f->cache_fd)) {
@@ -3448,6 +4288,256 @@ fail:
         return r;
 }
 
+int journal_file_append_entry_index(JournalFile *f) {
+        uint64_t a, p, q, n = 0, total = 0, i = 0;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Writes an index of the main entry array chain, see EntryIndexItem. This is supposed to be called when the
+         * file is archived, i.e. when no further entries will be added. */
+
+        if (!f->writable)
+                return -EPERM;
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, entry_index_offset))
+                return -EPROTONOSUPPORT;
+
+        /* Verifiers of older versions refuse to authenticate objects they don't know, hence leave sealed files
+         * alone. */
+        if (JOURNAL_HEADER_SEALED(f->header))
+                return 0;
+
+        if (JOURNAL_HEADER_ENTRY_INDEX(f->header) || le64toh(f->header->n_entries) == 0)
+                return 0;
+
+        /* First, count the arrays in the chain */
+        for (a = le64toh(f->header->entry_array_offset); a > 0; a = le64toh(o->entry_array.next_entry_array_offset)) {
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
+                if (r < 0)
+                        return r;
+
+                n++;
+        }
+
+        r = journal_file_append_object(f, OBJECT_ENTRY_INDEX,
+                                       offsetof(Object, entry_index.items) + n * sizeof(EntryIndexItem),
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        o->entry_index.n_entries = f->header->n_entries;
+
+        for (a = le64toh(f->header->entry_array_offset); a > 0 && i < n; i++) {
+                EntryIndexItem item = {};
+                uint64_t k;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
+                if (r < 0)
+                        return r;
+
+                k = journal_file_entry_array_n_items(o);
+                q = le64toh(o->entry_array.items[0]);
+
+                item.entry_array_offset = htole64(a);
+                item.total = htole64(total);
+
+                total += k;
+                a = le64toh(o->entry_array.next_entry_array_offset);
+
+                if (q <= 0)
+                        return -EBADMSG;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY, q, &o);
+                if (r < 0)
+                        return r;
+
+                item.entry_offset = htole64(q);
+                item.realtime = o->entry.realtime;
+                item.seqnum = o->entry.seqnum;
+
+                /* Moving around might have altered the window, so let's refresh our pointer */
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_INDEX, p, &o);
+                if (r < 0)
+                        return r;
+
+                o->entry_index.items[i] = item;
+        }
+
+        f->header->entry_index_offset = htole64(p);
+        f->header->compatible_flags = htole32(le32toh(f->header->compatible_flags) | HEADER_COMPATIBLE_ENTRY_INDEX);
+
+        return 0;
+}
+
+/* Fields that are commonly matched on, and whose values usually show up in a small subset of all files only */
+static const char data_bloom_fields[] =
+        "_SYSTEMD_UNIT\0"
+        "_SYSTEMD_USER_UNIT\0"
+        "_SYSTEMD_SLICE\0"
+        "UNIT\0"
+        "USER_UNIT\0"
+        "OBJECT_SYSTEMD_UNIT\0"
+        "COREDUMP_UNIT\0"
+        "SYSLOG_IDENTIFIER\0"
+        "MESSAGE_ID\0"
+        "_COMM\0"
+        "_EXE\0"
+        "_BOOT_ID\0"
+        "_HOSTNAME\0";
+
+#define DATA_BLOOM_BITS_PER_DATA 10U
+#define DATA_BLOOM_N_HASHES 7U
+
+static uint64_t data_bloom_bit(uint64_t hash, unsigned i, uint64_t n_bits) {
+        /* We already have a good 64bit hash of each DATA object, hence derive the bits from its two halves
+         * instead of hashing the payload again. */
+        return ((hash & 0xffffffffU) + i * ((hash >> 32) | 1U)) % n_bits;
+}
+
+int journal_file_append_data_bloom(JournalFile *f) {
+        _cleanup_free_ uint64_t *hashes = NULL;
+        _cleanup_free_ uint8_t *bitmap = NULL;
+        size_t n_hashes = 0, n_allocated = 0;
+        uint64_t bitmap_size, n_bits, p, i;
+        const char *field;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Writes a bloom filter over the hashes of all DATA objects of the fields listed above, see
+         * DataBloomObject. Like the entry index this is supposed to be called when the file is archived. */
+
+        if (!f->writable)
+                return -EPERM;
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, data_bloom_offset))
+                return -EPROTONOSUPPORT;
+
+        /* See journal_file_append_entry_index() */
+        if (JOURNAL_HEADER_SEALED(f->header))
+                return 0;
+
+        if (JOURNAL_HEADER_DATA_BLOOM(f->header))
+                return 0;
+
+        NULSTR_FOREACH(field, data_bloom_fields) {
+                r = journal_file_find_field_object(f, field, strlen(field), &o, NULL);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        continue;
+
+                for (p = le64toh(o->field.head_data_offset); p > 0; p = le64toh(o->data.next_field_offset)) {
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        if (!GREEDY_REALLOC(hashes, n_allocated, n_hashes + 1))
+                                return -ENOMEM;
+
+                        hashes[n_hashes++] = le64toh(o->data.hash);
+                }
+        }
+
+        bitmap_size = ALIGN_TO(DIV_ROUND_UP(MAX(n_hashes, 1U) * DATA_BLOOM_BITS_PER_DATA, 8U), 8U);
+        n_bits = bitmap_size * 8;
+
+        bitmap = new0(uint8_t, bitmap_size);
+        if (!bitmap)
+                return -ENOMEM;
+
+        for (i = 0; i < n_hashes; i++) {
+                unsigned k;
+
+                for (k = 0; k < DATA_BLOOM_N_HASHES; k++) {
+                        uint64_t b;
+
+                        b = data_bloom_bit(hashes[i], k, n_bits);
+                        bitmap[b >> 3] |= 1U << (b & 7);
+                }
+        }
+
+        r = journal_file_append_object(f, OBJECT_DATA_BLOOM,
+                                       offsetof(Object, data_bloom.payload) + sizeof(data_bloom_fields) + bitmap_size,
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        o->data_bloom.n_data = f->header->n_data;
+        o->data_bloom.n_hashes = htole32(DATA_BLOOM_N_HASHES);
+        o->data_bloom.fields_size = htole32(sizeof(data_bloom_fields));
+        memcpy(o->data_bloom.payload, data_bloom_fields, sizeof(data_bloom_fields));
+        memcpy(o->data_bloom.payload + sizeof(data_bloom_fields), bitmap, bitmap_size);
+
+        f->header->data_bloom_offset = htole64(p);
+        f->header->compatible_flags = htole32(le32toh(f->header->compatible_flags) | HEADER_COMPATIBLE_DATA_BLOOM);
+
+        return 0;
+}
+
+int journal_file_data_bloom_test(JournalFile *f, const void *field, uint64_t size, uint64_t hash) {
+        uint64_t p, fields_size, n_bits;
+        const uint8_t *bitmap;
+        const char *fields, *i;
+        bool covered = false;
+        unsigned k, n;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(field && size > 0);
+
+        /* Returns 0 if the file definitely contains no DATA object of the specified field with the specified
+         * hash, and > 0 if it might. */
+
+        if (!JOURNAL_HEADER_DATA_BLOOM(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, data_bloom_offset))
+                return 1;
+
+        p = le64toh(f->header->data_bloom_offset);
+        if (p == 0)
+                return 1;
+
+        r = journal_file_move_to_object(f, OBJECT_DATA_BLOOM, p, &o);
+        if (r < 0)
+                return r;
+
+        /* Data was added after the filter was written, it doesn't know about it */
+        if (le64toh(o->data_bloom.n_data) != le64toh(f->header->n_data))
+                return 1;
+
+        /* journal_file_check_object() made sure the field list ends in a NUL byte and the bitmap is not empty */
+        fields_size = le32toh(o->data_bloom.fields_size);
+        fields = (const char*) o->data_bloom.payload;
+        for (i = fields; i < fields + fields_size && *i; i += strlen(i) + 1)
+                if (strlen(i) == size && memcmp(i, field, size) == 0) {
+                        covered = true;
+                        break;
+                }
+        if (!covered)
+                return 1;
+
+        bitmap = o->data_bloom.payload + fields_size;
+        n_bits = (le64toh(o->object.size) - offsetof(Object, data_bloom.payload) - fields_size) * 8;
+
+        n = le32toh(o->data_bloom.n_hashes);
+        for (k = 0; k < n; k++) {
+                uint64_t b;
+
+                b = data_bloom_bit(hash, k, n_bits);
+                if (!(bitmap[b >> 3] & (1U << (b & 7))))
+                        return 0;
+        }
+
+        return 1;
+}
+
 int journal_file_rotate(JournalFile **f, bool compress, bool seal, Set *deferred_closes) {
         _cleanup_free_ char *p = NULL;
         size_t l;
@@ -3486,15 +4576,26 @@ int journal_file_rotate(JournalFile **f, bool compress, bool seal, Set *deferred
         if (r < 0 && errno != ENOENT)
                 return -errno;
 
-        /* Sync the rename to disk */
-        (void) fsync_directory_of_file(old_file->fd);
+        /* No further entries will be added to the old file, hence now is the time to write its index */
+        r = journal_file_append_entry_index(old_file);
+        if (r == -E2BIG)
+                log_notice_errno(r, "Journal file %s has no room left for an entry index, lookups in it will be slower.", p);
+        else if (r < 0)
+                log_debug_errno(r, "Failed to write entry index to %s, ignoring: %m", p);
+
+        r = journal_file_append_data_bloom(old_file);
+        if (r == -E2BIG)
+                log_notice_errno(r, "Journal file %s has no room left for a data bloom filter, matches against it will be slower.", p);
+        else if (r < 0)
+                log_debug_errno(r, "Failed to write data bloom filter to %s, ignoring: %m", p);
 
         /* Set as archive so offlining commits w/state=STATE_ARCHIVED.
          * Previously we would set old_file->header->state to STATE_ARCHIVED directly here,
          * but journal_file_set_offline() short-circuits when state != STATE_ONLINE, which
          * would result in the rotated journal never getting fsync() called before closing.
          * Now we simply queue the archive state by setting an archive bit, leaving the state
-         * as STATE_ONLINE so proper offlining occurs. */
+         * as STATE_ONLINE so proper offlining occurs. Offlining also syncs the rename to disk,
+         * which hence happens in the offline thread rather than here. */
         old_file->archive = true;
 
         /* Currently, btrfs is not very good with out write patterns
@@ -3575,6 +4676,46 @@ int journal_file_open_reliably(
         return journal_file_open(-1, fname, flags, mode, compress, seal, metrics, mmap_cache, deferred_closes, template, ret);
 }
 
+typedef struct CopyCacheItem {
+        uint64_t from; /* the DATA object in the source file */
+        uint64_t to;   /* its copy in the target file */
+        le64_t hash;
+} CopyCacheItem;
+
+static int copy_cache_put(JournalFile *from, uint64_t q, uint64_t h, le64_t hash) {
+        CopyCacheItem *ci;
+        int r;
+
+        assert(from);
+
+        /* Once the cache is full we simply stop adding to it. The objects referenced by most entries (boot ID, host
+         * name, transport, …) show up early anyway. */
+        if (hashmap_size(from->copy_cache) >= COPY_CACHE_MAX)
+                return 0;
+
+        r = hashmap_ensure_allocated(&from->copy_cache, &uint64_hash_ops);
+        if (r < 0)
+                return r;
+
+        ci = new(CopyCacheItem, 1);
+        if (!ci)
+                return -ENOMEM;
+
+        *ci = (CopyCacheItem) {
+                .from = q,
+                .to = h,
+                .hash = hash,
+        };
+
+        r = hashmap_put(from->copy_cache, &ci->from, ci);
+        if (r < 0) {
+                free(ci);
+                return r;
+        }
+
+        return 1;
+}
+
 int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum, Object **ret, uint64_t *offset) {
         uint64_t i, n;
         uint64_t q, xor_hash = 0;
@@ -3590,6 +4731,14 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         if (!to->writable)
                 return -EPERM;
 
+        /* When many entries are copied, e.g. when flushing /run to /var, most of them reference the same DATA
+         * objects. Remember where we copied them to, so that we don't have to decompress, hash and look them up in
+         * the target file again. The cache is only valid for the file we copied to last. */
+        if (!sd_id128_equal(from->copy_target_id, to->header->file_id)) {
+                hashmap_clear_free(from->copy_cache);
+                from->copy_target_id = to->header->file_id;
+        }
+
         ts.monotonic = le64toh(o->entry.monotonic);
         ts.realtime = le64toh(o->entry.realtime);
 
@@ -3601,12 +4750,24 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 uint64_t l, h;
                 le64_t le_hash;
                 size_t t;
+                CopyCacheItem *ci;
                 void *data;
                 Object *u;
 
                 q = le64toh(o->entry.items[i].object_offset);
                 le_hash = o->entry.items[i].hash;
 
+                ci = hashmap_get(from->copy_cache, &q);
+                if (ci) {
+                        if (le_hash != ci->hash)
+                                return -EBADMSG;
+
+                        xor_hash ^= le64toh(le_hash);
+                        items[i].object_offset = htole64(ci->to);
+                        items[i].hash = le_hash;
+                        continue;
+                }
+
                 r = journal_file_move_to_object(from, OBJECT_DATA, q, &o);
                 if (r < 0)
                         return r;
@@ -3622,10 +4783,10 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                         return -E2BIG;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
                         size_t rsize = 0;
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
+                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK, journal_file_compress_dictionary(from),
                                             o->data.payload, l, &from->compress_buffer, &from->compress_buffer_size, &rsize, 0);
                         if (r < 0)
                                 return r;
@@ -3646,6 +4807,10 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 items[i].object_offset = htole64(h);
                 items[i].hash = u->data.hash;
 
+                r = copy_cache_put(from, q, h, u->data.hash);
+                if (r < 0)
+                        return r;
+
                 r = journal_file_move_to_object(from, OBJECT_ENTRY, p, &o);
                 if (r < 0)
                         return r;
@@ -3869,6 +5034,26 @@ bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec) {
                         return true;
                 }
 
+        /* Did lookups have to walk through overly long hash chains? The hash function isn't keyed, hence anybody
+         * who may log can come up with colliding data and make a single chain as long as they like. Only take that
+         * as a reason for a rotation if the table is at least half full anyway, so that long chains can't be used
+         * to make us rotate at will. */
+        if (JOURNAL_HEADER_CONTAINS(f->header, data_hash_chain_depth) &&
+            le64toh(f->header->data_hash_chain_depth) > HASH_CHAIN_DEPTH_MAX &&
+            le64toh(f->header->n_data) * 2ULL > le64toh(f->header->data_hash_table_size) / sizeof(HashItem)) {
+                log_debug("Data hash table of %s has deepest hash chain of length %"PRIu64", suggesting rotation.",
+                          f->path, le64toh(f->header->data_hash_chain_depth));
+                return true;
+        }
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, field_hash_chain_depth) &&
+            le64toh(f->header->field_hash_chain_depth) > HASH_CHAIN_DEPTH_MAX &&
+            le64toh(f->header->n_fields) * 2ULL > le64toh(f->header->field_hash_table_size) / sizeof(HashItem)) {
+                log_debug("Field hash table of %s has deepest hash chain of length %"PRIu64", suggesting rotation.",
+                          f->path, le64toh(f->header->field_hash_chain_depth));
+                return true;
+        }
+
         /* Are the data objects properly indexed by field objects? */
         if (JOURNAL_HEADER_CONTAINS(f->header, n_data) &&
             JOURNAL_HEADER_CONTAINS(f->header, n_fields) &&
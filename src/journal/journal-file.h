@@ -27,6 +27,7 @@
 
 #include "sd-id128.h"
 
+#include "compress.h"
 #include "hashmap.h"
 #include "journal-def.h"
 #include "macro.h"
@@ -73,6 +74,9 @@ typedef enum OfflineState {
         OFFLINE_DONE
 } OfflineState;
 
+/* A compression dictionary being trained in a thread */
+typedef struct CompressDictionaryTraining CompressDictionaryTraining;
+
 typedef struct JournalFile {
         int fd;
         MMapFileDescriptor *cache_fd;
@@ -84,16 +88,20 @@ typedef struct JournalFile {
         bool writable:1;
         bool compress_xz:1;
         bool compress_lz4:1;
+        bool compress_zstd:1;
         bool seal:1;
         bool defrag_on_close:1;
         bool close_fd:1;
         bool archive:1;
 
         bool tail_entry_monotonic_valid:1;
+        bool sequential:1;
 
         direction_t last_direction;
         LocationType location_type;
         uint64_t last_n_entries;
+        unsigned prioq_idx;
+        uint64_t readahead_end;
 
         char *path;
         struct stat last_stat;
@@ -115,17 +123,28 @@ typedef struct JournalFile {
 
         sd_event_source *post_change_timer;
         usec_t post_change_timer_period;
+        usec_t post_change_last_usec;
 
         OrderedHashmap *chain_cache;
 
+        /* DATA objects of this file already copied to the file with copy_target_id, see journal_file_copy_entry() */
+        Hashmap *copy_cache;
+        sd_id128_t copy_target_id;
+
         pthread_t offline_thread;
         volatile OfflineState offline_state;
+        int offline_notify_fd; /* eventfd the offline thread signals when done, or -1 */
 
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
         void *compress_buffer;
         size_t compress_buffer_size;
 #endif
 
+        CompressDictionary *compress_dictionary;
+#ifdef HAVE_ZSTD
+        CompressDictionaryTraining *compress_dictionary_training;
+#endif
+
 #ifdef HAVE_GCRYPT
         gcry_md_hd_t hmac;
         bool hmac_running;
@@ -144,6 +163,12 @@ typedef struct JournalFile {
 #endif
 } JournalFile;
 
+typedef struct JournalEntry {
+        dual_timestamp ts;
+        const struct iovec *iovec;
+        unsigned n_iovec;
+} JournalEntry;
+
 int journal_file_open(
                 int fd,
                 const char *fname,
@@ -202,22 +227,38 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_SEALED(h) \
         (!!(le32toh((h)->compatible_flags) & HEADER_COMPATIBLE_SEALED))
 
+#define JOURNAL_HEADER_ENTRY_INDEX(h) \
+        (!!(le32toh((h)->compatible_flags) & HEADER_COMPATIBLE_ENTRY_INDEX))
+
+#define JOURNAL_HEADER_DATA_BLOOM(h) \
+        (!!(le32toh((h)->compatible_flags) & HEADER_COMPATIBLE_DATA_BLOOM))
+
 #define JOURNAL_HEADER_COMPRESSED_XZ(h) \
         (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_XZ))
 
 #define JOURNAL_HEADER_COMPRESSED_LZ4(h) \
         (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
 
+#define JOURNAL_HEADER_COMPRESSED_ZSTD(h) \
+        (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+
 int journal_file_move_to_object(JournalFile *f, ObjectType type, uint64_t offset, Object **ret);
 
 uint64_t journal_file_entry_n_items(Object *o) _pure_;
 uint64_t journal_file_entry_array_n_items(Object *o) _pure_;
 uint64_t journal_file_hash_table_n_items(Object *o) _pure_;
+uint64_t journal_file_entry_index_n_items(Object *o) _pure_;
 
 int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_append_entry(JournalFile *f, const dual_timestamp *ts, const struct iovec iovec[], unsigned n_iovec, uint64_t *seqno, Object **ret, uint64_t *offset);
+int journal_file_append_entries(JournalFile *f, const JournalEntry entries[], unsigned n_entries, uint64_t *seqno, unsigned *ret_n_appended);
 
 int journal_file_find_data_object(JournalFile *f, const void *data, uint64_t size, Object **ret, uint64_t *offset);
+CompressDictionary* journal_file_compress_dictionary(JournalFile *f);
+#ifdef HAVE_ZSTD
+int journal_file_install_compression_dictionary(JournalFile *f, bool wait);
+#endif
+
 int journal_file_find_data_object_with_hash(JournalFile *f, const void *data, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
 int journal_file_find_field_object(JournalFile *f, const void *field, uint64_t size, Object **ret, uint64_t *offset);
@@ -244,6 +285,9 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
 void journal_file_dump(JournalFile *f);
 void journal_file_print_header(JournalFile *f);
 
+int journal_file_append_entry_index(JournalFile *f);
+int journal_file_append_data_bloom(JournalFile *f);
+int journal_file_data_bloom_test(JournalFile *f, const void *field, uint64_t size, uint64_t hash);
 int journal_file_rotate(JournalFile **f, bool compress, bool seal, Set *deferred_closes);
 
 void journal_file_post_change(JournalFile *f);
@@ -262,5 +306,5 @@ int journal_file_map_field_hash_table(JournalFile *f);
 
 static inline bool JOURNAL_FILE_COMPRESS(JournalFile *f) {
         assert(f);
-        return f->compress_xz || f->compress_lz4;
+        return f->compress_xz || f->compress_lz4 || f->compress_zstd;
 }
@@ -30,6 +30,7 @@
 #include "journal-def.h"
 #include "journal-file.h"
 #include "list.h"
+#include "prioq.h"
 #include "set.h"
 
 typedef struct Match Match;
@@ -90,6 +91,11 @@ struct sd_journal {
         OrderedHashmap *files;
         MMapCache *mmap;
 
+        /* Files with a candidate entry beyond the current location,
+         * ordered by that entry in the current iteration direction */
+        Prioq *files_prioq;
+        direction_t files_prioq_direction;
+
         Location current_location;
 
         JournalFile *current_file;
@@ -107,6 +113,7 @@ struct sd_journal {
         char *unique_field;
         JournalFile *unique_file;
         uint64_t unique_offset;
+        Set *unique_hashes;
 
         /* Iterating through known fields */
         JournalFile *fields_file;
@@ -127,8 +134,11 @@ struct sd_journal {
         bool fields_file_lost:1;
         bool has_runtime_files:1;
         bool has_persistent_files:1;
+        bool files_prioq_valid:1;
 
         size_t data_threshold;
+        char **data_fields;
+        size_t data_fields_max;
 
         Hashmap *directories_by_path;
         Hashmap *directories_by_wd;
@@ -18,6 +18,7 @@
 ***/
 
 #include <fcntl.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -26,10 +27,15 @@
 #include "alloc-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "hashmap.h"
 #include "journal-def.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
 #include "parse-util.h"
+#include "prioq.h"
+#include "set.h"
 #include "string-util.h"
 #include "util.h"
 #include "xattr-util.h"
@@ -43,14 +49,44 @@ struct vacuum_info {
         sd_id128_t seqnum_id;
         uint64_t seqnum;
         bool have_seqnum;
+
+        /* Empty files are always vacuumed */
+        bool empty;
+
+        unsigned queue_idx;
+};
+
+struct JournalVacuumCatalog {
+        char *directory;
+        int dir_fd;
+
+        /* If set, the catalog is kept up-to-date through inotify, instead of reading the whole directory
+         * each time it is used */
+        bool watch;
+        int inotify_fd;
+
+        Hashmap *files;         /* filename → struct vacuum_info, of the files we may vacuum */
+        Prioq *queue;           /* the same, in the order they shall be vacuumed */
+        Set *active;            /* names of the other journal files, which are left alone */
+
+        uint64_t sum;           /* usage of the files we may vacuum */
 };
 
+typedef enum VacuumFileType {
+        VACUUM_FILE_UNKNOWN,    /* Not a journal file, or inaccessible */
+        VACUUM_FILE_ACTIVE,     /* A journal file that is not archived */
+        VACUUM_FILE_ARCHIVED,   /* An archived or corrupted journal file */
+} VacuumFileType;
+
 static int vacuum_compare(const void *_a, const void *_b) {
         const struct vacuum_info *a, *b;
 
         a = _a;
         b = _b;
 
+        if (a->empty != b->empty)
+                return a->empty ? -1 : 1;
+
         if (a->have_seqnum && b->have_seqnum &&
             sd_id128_equal(a->seqnum_id, b->seqnum_id)) {
                 if (a->seqnum < b->seqnum)
@@ -142,208 +178,462 @@ static int journal_file_empty(int dir_fd, const char *name) {
         return le64toh(n_entries) <= 0;
 }
 
-int journal_directory_vacuum(
-                const char *directory,
-                uint64_t max_use,
-                uint64_t n_max_files,
-                usec_t max_retention_usec,
-                usec_t *oldest_usec,
-                bool verbose) {
+static int vacuum_info_load(int dir_fd, const char *name, struct vacuum_info *ret) {
+        unsigned long long seqnum = 0, realtime;
+        sd_id128_t seqnum_id = SD_ID128_NULL;
+        bool have_seqnum;
+        struct stat st;
+        char *p;
+        size_t q;
+        int r;
+
+        assert(dir_fd >= 0);
+        assert(name);
+        assert(ret);
+
+        if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+                log_debug_errno(errno, "Failed to stat file %s while vacuuming, ignoring: %m", name);
+                return VACUUM_FILE_UNKNOWN;
+        }
+
+        if (!S_ISREG(st.st_mode))
+                return VACUUM_FILE_UNKNOWN;
+
+        p = strdupa(name);
+        q = strlen(p);
+
+        if (endswith(p, ".journal")) {
+
+                /* Vacuum archived files. Active files are
+                 * left around */
+
+                if (q < 1 + 32 + 1 + 16 + 1 + 16 + 8)
+                        return VACUUM_FILE_ACTIVE;
+
+                if (p[q-8-16-1] != '-' ||
+                    p[q-8-16-1-16-1] != '-' ||
+                    p[q-8-16-1-16-1-32-1] != '@')
+                        return VACUUM_FILE_ACTIVE;
+
+                p[q-8-16-1-16-1] = 0;
+                if (sd_id128_from_string(p + q-8-16-1-16-1-32, &seqnum_id) < 0)
+                        return VACUUM_FILE_ACTIVE;
+
+                if (sscanf(p + q-8-16-1-16, "%16llx-%16llx.journal", &seqnum, &realtime) != 2)
+                        return VACUUM_FILE_ACTIVE;
+
+                have_seqnum = true;
+
+        } else if (endswith(p, ".journal~")) {
+                unsigned long long tmp;
+
+                /* Vacuum corrupted files */
+
+                if (q < 1 + 16 + 1 + 16 + 8 + 1)
+                        return VACUUM_FILE_ACTIVE;
+
+                if (p[q-1-8-16-1] != '-' ||
+                    p[q-1-8-16-1-16-1] != '@')
+                        return VACUUM_FILE_ACTIVE;
+
+                if (sscanf(p + q-1-8-16-1-16, "%16llx-%16llx.journal~", &realtime, &tmp) != 2)
+                        return VACUUM_FILE_ACTIVE;
+
+                have_seqnum = false;
+        } else {
+                /* We do not vacuum unknown files! */
+                log_debug("Not vacuuming unknown file %s.", name);
+                return VACUUM_FILE_UNKNOWN;
+        }
+
+        r = journal_file_empty(dir_fd, name);
+        if (r < 0) {
+                log_debug_errno(r, "Failed check if %s is empty, ignoring: %m", name);
+                return VACUUM_FILE_UNKNOWN;
+        }
+        if (r == 0)
+                patch_realtime(dir_fd, name, &st, &realtime);
+
+        p = strdup(name);
+        if (!p)
+                return -ENOMEM;
+
+        *ret = (struct vacuum_info) {
+                .usage = 512UL * (uint64_t) st.st_blocks,
+                .filename = p,
+                .realtime = realtime,
+                .seqnum_id = seqnum_id,
+                .seqnum = seqnum,
+                .have_seqnum = have_seqnum,
+                .empty = r > 0,
+                .queue_idx = PRIOQ_IDX_NULL,
+        };
+
+        return VACUUM_FILE_ARCHIVED;
+}
+
+static void vacuum_info_free(struct vacuum_info *i) {
+        if (!i)
+                return;
+
+        free(i->filename);
+        free(i);
+}
+
+static void catalog_remove(JournalVacuumCatalog *c, const char *name) {
+        struct vacuum_info *i;
+
+        assert(c);
+        assert(name);
 
+        free(set_remove(c->active, name));
+
+        i = hashmap_remove(c->files, name);
+        if (!i)
+                return;
+
+        prioq_remove(c->queue, i, &i->queue_idx);
+        c->sum = LESS_BY(c->sum, i->usage);
+        vacuum_info_free(i);
+}
+
+static int catalog_add(JournalVacuumCatalog *c, const char *name) {
+        struct vacuum_info *i;
+        int t, r;
+
+        assert(c);
+        assert(name);
+
+        /* Forget what we knew about the file, it might have changed */
+        catalog_remove(c, name);
+
+        i = new(struct vacuum_info, 1);
+        if (!i)
+                return -ENOMEM;
+
+        t = vacuum_info_load(c->dir_fd, name, i);
+        if (t != VACUUM_FILE_ARCHIVED) {
+                free(i);
+
+                if (t == VACUUM_FILE_ACTIVE) {
+                        r = set_put_strdup(c->active, name);
+                        if (r < 0)
+                                return r;
+                }
+
+                return t < 0 ? t : 0;
+        }
+
+        r = hashmap_put(c->files, i->filename, i);
+        if (r < 0) {
+                vacuum_info_free(i);
+                return r;
+        }
+
+        r = prioq_put(c->queue, i, &i->queue_idx);
+        if (r < 0) {
+                hashmap_remove(c->files, i->filename);
+                vacuum_info_free(i);
+                return r;
+        }
+
+        c->sum += i->usage;
+        return 0;
+}
+
+static void catalog_clear(JournalVacuumCatalog *c) {
+        struct vacuum_info *i;
+
+        assert(c);
+
+        while ((i = prioq_pop(c->queue))) {
+                hashmap_remove(c->files, i->filename);
+                vacuum_info_free(i);
+        }
+
+        set_clear_free(c->active);
+        c->sum = 0;
+}
+
+static void catalog_close(JournalVacuumCatalog *c) {
+        assert(c);
+
+        catalog_clear(c);
+
+        c->dir_fd = safe_close(c->dir_fd);
+        c->inotify_fd = safe_close(c->inotify_fd);
+}
+
+static int catalog_rescan(JournalVacuumCatalog *c) {
         _cleanup_closedir_ DIR *d = NULL;
-        struct vacuum_info *list = NULL;
-        unsigned n_list = 0, i, n_active_files = 0;
-        size_t n_allocated = 0;
-        uint64_t sum = 0, freed = 0;
-        usec_t retention_limit = 0;
-        char sbytes[FORMAT_BYTES_MAX];
         struct dirent *de;
         int r;
 
-        assert(directory);
+        assert(c);
 
-        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
-                return 0;
+        catalog_clear(c);
 
-        if (max_retention_usec > 0) {
-                retention_limit = now(CLOCK_REALTIME);
-                if (retention_limit > max_retention_usec)
-                        retention_limit -= max_retention_usec;
-                else
-                        max_retention_usec = retention_limit = 0;
+        if (c->dir_fd < 0) {
+                c->dir_fd = open(c->directory, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+                if (c->dir_fd < 0)
+                        return -errno;
         }
 
-        d = opendir(directory);
-        if (!d)
-                return -errno;
+        /* Start watching before reading the directory, so that we do not miss anything */
+        if (c->watch && c->inotify_fd < 0) {
+                c->inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+                if (c->inotify_fd >= 0 &&
+                    inotify_add_watch_fd(c->inotify_fd, c->dir_fd,
+                                         IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|
+                                         IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR) < 0)
+                        c->inotify_fd = safe_close(c->inotify_fd);
+
+                if (c->inotify_fd < 0)
+                        log_debug_errno(errno, "Failed to watch %s, reading whole directory on each vacuum: %m", c->directory);
+        }
 
-        FOREACH_DIRENT_ALL(de, d, r = -errno; goto finish) {
+        d = xopendirat(c->dir_fd, ".", 0);
+        if (!d) {
+                r = -errno;
+                goto fail;
+        }
 
-                unsigned long long seqnum = 0, realtime;
-                _cleanup_free_ char *p = NULL;
-                sd_id128_t seqnum_id;
-                bool have_seqnum;
-                uint64_t size;
-                struct stat st;
-                size_t q;
+        FOREACH_DIRENT_ALL(de, d, r = -errno; goto fail) {
+                r = catalog_add(c, de->d_name);
+                if (r < 0)
+                        goto fail;
+        }
 
-                if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
-                        log_debug_errno(errno, "Failed to stat file %s while vacuuming, ignoring: %m", de->d_name);
-                        continue;
-                }
+        return 0;
 
-                if (!S_ISREG(st.st_mode))
-                        continue;
+fail:
+        /* Make sure we start from scratch next time */
+        catalog_close(c);
+        return r;
+}
 
-                q = strlen(de->d_name);
+static int catalog_update(JournalVacuumCatalog *c) {
+        int r;
 
-                if (endswith(de->d_name, ".journal")) {
+        assert(c);
 
-                        /* Vacuum archived files. Active files are
-                         * left around */
+        if (c->dir_fd < 0 || c->inotify_fd < 0)
+                return catalog_rescan(c);
 
-                        if (q < 1 + 32 + 1 + 16 + 1 + 16 + 8) {
-                                n_active_files++;
-                                continue;
-                        }
+        for (;;) {
+                union inotify_event_buffer buffer;
+                struct inotify_event *e;
+                ssize_t l;
 
-                        if (de->d_name[q-8-16-1] != '-' ||
-                            de->d_name[q-8-16-1-16-1] != '-' ||
-                            de->d_name[q-8-16-1-16-1-32-1] != '@') {
-                                n_active_files++;
+                l = read(c->inotify_fd, &buffer, sizeof(buffer));
+                if (l < 0) {
+                        if (errno == EINTR)
                                 continue;
-                        }
+                        if (errno == EAGAIN)
+                                return 0;
 
-                        p = strdup(de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
-                                goto finish;
-                        }
+                        return -errno;
+                }
 
-                        de->d_name[q-8-16-1-16-1] = 0;
-                        if (sd_id128_from_string(de->d_name + q-8-16-1-16-1-32, &seqnum_id) < 0) {
-                                n_active_files++;
-                                continue;
+                FOREACH_INOTIFY_EVENT(e, buffer, l) {
+                        if (e->mask & (IN_Q_OVERFLOW|IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)) {
+                                /* We lost track, start from scratch */
+                                catalog_close(c);
+                                return catalog_rescan(c);
                         }
 
-                        if (sscanf(de->d_name + q-8-16-1-16, "%16llx-%16llx.journal", &seqnum, &realtime) != 2) {
-                                n_active_files++;
+                        if (e->len == 0)
                                 continue;
+
+                        if (e->mask & (IN_DELETE|IN_MOVED_FROM))
+                                catalog_remove(c, e->name);
+                        else {
+                                r = catalog_add(c, e->name);
+                                if (r < 0)
+                                        return r;
                         }
+                }
+        }
+}
 
-                        have_seqnum = true;
+int journal_vacuum_catalog_new(JournalVacuumCatalog **ret, const char *directory, bool watch) {
+        _cleanup_(journal_vacuum_catalog_freep) JournalVacuumCatalog *c = NULL;
 
-                } else if (endswith(de->d_name, ".journal~")) {
-                        unsigned long long tmp;
+        assert(ret);
+        assert(directory);
 
-                        /* Vacuum corrupted files */
+        c = new0(JournalVacuumCatalog, 1);
+        if (!c)
+                return -ENOMEM;
 
-                        if (q < 1 + 16 + 1 + 16 + 8 + 1) {
-                                n_active_files++;
-                                continue;
-                        }
+        c->dir_fd = c->inotify_fd = -1;
+        c->watch = watch;
 
-                        if (de->d_name[q-1-8-16-1] != '-' ||
-                            de->d_name[q-1-8-16-1-16-1] != '@') {
-                                n_active_files++;
-                                continue;
-                        }
+        c->directory = strdup(directory);
+        if (!c->directory)
+                return -ENOMEM;
 
-                        p = strdup(de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
-                                goto finish;
-                        }
+        c->files = hashmap_new(&string_hash_ops);
+        c->queue = prioq_new(vacuum_compare);
+        c->active = set_new(&string_hash_ops);
+        if (!c->files || !c->queue || !c->active)
+                return -ENOMEM;
 
-                        if (sscanf(de->d_name + q-1-8-16-1-16, "%16llx-%16llx.journal~", &realtime, &tmp) != 2) {
-                                n_active_files++;
-                                continue;
-                        }
+        *ret = c;
+        c = NULL;
 
-                        have_seqnum = false;
-                } else {
-                        /* We do not vacuum unknown files! */
-                        log_debug("Not vacuuming unknown file %s.", de->d_name);
-                        continue;
-                }
+        return 0;
+}
 
-                size = 512UL * (uint64_t) st.st_blocks;
+JournalVacuumCatalog* journal_vacuum_catalog_free(JournalVacuumCatalog *c) {
+        if (!c)
+                return NULL;
 
-                r = journal_file_empty(dirfd(d), p);
-                if (r < 0) {
-                        log_debug_errno(r, "Failed check if %s is empty, ignoring: %m", p);
-                        continue;
-                }
-                if (r > 0) {
-                        /* Always vacuum empty non-online files. */
+        catalog_close(c);
+
+        hashmap_free(c->files);
+        prioq_free(c->queue);
+        set_free(c->active);
+        free(c->directory);
+
+        return mfree(c);
+}
 
-                        if (unlinkat(dirfd(d), p, 0) >= 0) {
+int journal_vacuum_catalog_usage(JournalVacuumCatalog *c, uint64_t *ret) {
+        const char *name;
+        Iterator i;
+        uint64_t sum;
+        int r;
 
-                                log_full(verbose ? LOG_INFO : LOG_DEBUG,
-                                         "Deleted empty archived journal %s/%s (%s).", directory, p, format_bytes(sbytes, sizeof(sbytes), size));
+        assert(c);
+        assert(ret);
 
-                                freed += size;
-                        } else if (errno != ENOENT)
-                                log_warning_errno(errno, "Failed to delete empty archived journal %s/%s: %m", directory, p);
+        r = catalog_update(c);
+        if (r < 0)
+                return r;
 
+        /* Only the active files keep growing, hence they are the only ones we need to look at */
+        sum = c->sum;
+        SET_FOREACH(name, c->active, i) {
+                struct stat st;
+
+                if (fstatat(c->dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
                         continue;
-                }
 
-                patch_realtime(dirfd(d), p, &st, &realtime);
+                sum += (uint64_t) st.st_blocks * 512UL;
+        }
 
-                if (!GREEDY_REALLOC(list, n_allocated, n_list + 1)) {
-                        r = -ENOMEM;
-                        goto finish;
-                }
+        *ret = sum;
+        return 0;
+}
 
-                list[n_list].filename = p;
-                list[n_list].usage = size;
-                list[n_list].seqnum = seqnum;
-                list[n_list].realtime = realtime;
-                list[n_list].seqnum_id = seqnum_id;
-                list[n_list].have_seqnum = have_seqnum;
-                n_list++;
+int journal_vacuum_catalog_vacuum(
+                JournalVacuumCatalog *c,
+                uint64_t max_use,
+                uint64_t n_max_files,
+                usec_t max_retention_usec,
+                usec_t *oldest_usec,
+                bool verbose) {
+
+        _cleanup_free_ struct vacuum_info **failed = NULL;
+        size_t n_failed = 0, n_failed_allocated = 0, k;
+        uint64_t freed = 0;
+        usec_t retention_limit = 0;
+        char sbytes[FORMAT_BYTES_MAX];
+        struct vacuum_info *i;
+        int r;
 
-                p = NULL;
-                sum += size;
+        assert(c);
+
+        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
+                return 0;
+
+        if (max_retention_usec > 0) {
+                retention_limit = now(CLOCK_REALTIME);
+                if (retention_limit > max_retention_usec)
+                        retention_limit -= max_retention_usec;
+                else
+                        max_retention_usec = retention_limit = 0;
         }
 
-        qsort_safe(list, n_list, sizeof(struct vacuum_info), vacuum_compare);
+        r = catalog_update(c);
+        if (r < 0)
+                return r;
 
-        for (i = 0; i < n_list; i++) {
+        while ((i = prioq_peek(c->queue))) {
                 unsigned left;
 
-                left = n_active_files + n_list - i;
+                left = set_size(c->active) + prioq_size(c->queue);
 
-                if ((max_retention_usec <= 0 || list[i].realtime >= retention_limit) &&
-                    (max_use <= 0 || sum <= max_use) &&
+                if (!i->empty &&
+                    (max_retention_usec <= 0 || i->realtime >= retention_limit) &&
+                    (max_use <= 0 || c->sum <= max_use) &&
                     (n_max_files <= 0 || left <= n_max_files))
                         break;
 
-                if (unlinkat(dirfd(d), list[i].filename, 0) >= 0) {
-                        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Deleted archived journal %s/%s (%s).", directory, list[i].filename, format_bytes(sbytes, sizeof(sbytes), list[i].usage));
-                        freed += list[i].usage;
+                if (unlinkat(c->dir_fd, i->filename, 0) >= 0) {
+                        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Deleted %sarchived journal %s/%s (%s).",
+                                 i->empty ? "empty " : "", c->directory, i->filename, format_bytes(sbytes, sizeof(sbytes), i->usage));
+                        freed += i->usage;
+
+                } else if (errno != ENOENT) {
+                        log_warning_errno(errno, "Failed to delete %sarchived journal %s/%s: %m",
+                                          i->empty ? "empty " : "", c->directory, i->filename);
 
-                        if (list[i].usage < sum)
-                                sum -= list[i].usage;
-                        else
-                                sum = 0;
+                        /* Keep accounting for the file, but look at the next one for now */
+                        if (!GREEDY_REALLOC(failed, n_failed_allocated, n_failed + 1)) {
+                                r = -ENOMEM;
+                                goto finish;
+                        }
 
-                } else if (errno != ENOENT)
-                        log_warning_errno(errno, "Failed to delete archived journal %s/%s: %m", directory, list[i].filename);
+                        assert_se(prioq_pop(c->queue) == i);
+                        failed[n_failed++] = i;
+                        continue;
+                }
+
+                catalog_remove(c, i->filename);
         }
 
-        if (oldest_usec && i < n_list && (*oldest_usec == 0 || list[i].realtime < *oldest_usec))
-                *oldest_usec = list[i].realtime;
+        i = prioq_peek(c->queue);
+        if (oldest_usec && i && (*oldest_usec == 0 || i->realtime < *oldest_usec))
+                *oldest_usec = i->realtime;
 
         r = 0;
 
 finish:
-        for (i = 0; i < n_list; i++)
-                free(list[i].filename);
-        free(list);
+        for (k = 0; k < n_failed; k++)
+                if (prioq_put(c->queue, failed[k], &failed[k]->queue_idx) < 0) {
+                        /* Forget about it then */
+                        hashmap_remove(c->files, failed[k]->filename);
+                        c->sum = LESS_BY(c->sum, failed[k]->usage);
+                        vacuum_info_free(failed[k]);
+                }
 
-        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Vacuuming done, freed %s of archived journals from %s.", format_bytes(sbytes, sizeof(sbytes), freed), directory);
+        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Vacuuming done, freed %s of archived journals from %s.", format_bytes(sbytes, sizeof(sbytes), freed), c->directory);
 
         return r;
 }
+
+int journal_directory_vacuum(
+                const char *directory,
+                uint64_t max_use,
+                uint64_t n_max_files,
+                usec_t max_retention_usec,
+                usec_t *oldest_usec,
+                bool verbose) {
+
+        _cleanup_(journal_vacuum_catalog_freep) JournalVacuumCatalog *c = NULL;
+        int r;
+
+        assert(directory);
+
+        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
+                return 0;
+
+        /* A catalog that is used only once, hence does not watch the directory */
+        r = journal_vacuum_catalog_new(&c, directory, false);
+        if (r < 0)
+                return r;
+
+        return journal_vacuum_catalog_vacuum(c, max_use, n_max_files, max_retention_usec, oldest_usec, verbose);
+}
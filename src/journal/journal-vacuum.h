@@ -22,6 +22,18 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "macro.h"
 #include "time-util.h"
 
+/* Keeps track of the files in a journal directory for vacuuming. If watched, it is updated through inotify,
+ * hence each use only needs to look at the files that changed. */
+typedef struct JournalVacuumCatalog JournalVacuumCatalog;
+
+int journal_vacuum_catalog_new(JournalVacuumCatalog **ret, const char *directory, bool watch);
+JournalVacuumCatalog* journal_vacuum_catalog_free(JournalVacuumCatalog *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalVacuumCatalog*, journal_vacuum_catalog_free);
+
+int journal_vacuum_catalog_usage(JournalVacuumCatalog *c, uint64_t *ret);
+int journal_vacuum_catalog_vacuum(JournalVacuumCatalog *c, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, bool verbose);
+
 int journal_directory_vacuum(const char *directory, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, bool verbose);
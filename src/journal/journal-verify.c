@@ -134,7 +134,7 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
          * possible field values. It does not follow any references to
          * other objects. */
 
-        if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
+        if ((o->object.flags & OBJECT_COMPRESSION_MASK) &&
             o->object.type != OBJECT_DATA) {
                 error(offset, "Found compressed object that isn't of type DATA, which is not allowed.");
                 return -EBADMSG;
@@ -168,7 +168,7 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         _cleanup_free_ void *b = NULL;
                         size_t alloc = 0, b_size;
 
-                        r = decompress_blob(compression,
+                        r = decompress_blob(compression, journal_file_compress_dictionary(f),
                                             o->data.payload,
                                             le64toh(o->object.size) - offsetof(Object, data.payload),
                                             &b, &alloc, &b_size, 0);
@@ -359,9 +359,74 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         return -EBADMSG;
                 }
 
+                break;
+
+        case OBJECT_ENTRY_INDEX:
+                if ((le64toh(o->object.size) - offsetof(EntryIndexObject, items)) % sizeof(EntryIndexItem) != 0) {
+                        error(offset,
+                              "Invalid object entry index size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < journal_file_entry_index_n_items(o); i++)
+                        if (!VALID64(le64toh(o->entry_index.items[i].entry_array_offset)) ||
+                            !VALID64(le64toh(o->entry_index.items[i].entry_offset)) ||
+                            le64toh(o->entry_index.items[i].entry_array_offset) == 0 ||
+                            le64toh(o->entry_index.items[i].entry_offset) == 0) {
+                                error(offset,
+                                      "Invalid object entry index item (%"PRIu64"/%"PRIu64"): entry_array_offset="OFSfmt" entry_offset="OFSfmt,
+                                      i, journal_file_entry_index_n_items(o),
+                                      le64toh(o->entry_index.items[i].entry_array_offset),
+                                      le64toh(o->entry_index.items[i].entry_offset));
+                                return -EBADMSG;
+                        }
+
+                break;
+
+        case OBJECT_DATA_BLOOM: {
+                uint64_t sz, fields_size;
+
+                sz = le64toh(o->object.size) - offsetof(DataBloomObject, payload);
+                fields_size = le32toh(o->data_bloom.fields_size);
+
+                if (fields_size < 1 || fields_size >= sz || o->data_bloom.payload[fields_size - 1] != 0) {
+                        error(offset,
+                              "Invalid object data bloom filter size: %"PRIu64"/%"PRIu64,
+                              le64toh(o->object.size),
+                              fields_size);
+                        return -EBADMSG;
+                }
+
+                if (le32toh(o->data_bloom.n_hashes) <= 0) {
+                        error(offset, "Invalid object data bloom filter without hashes");
+                        return -EBADMSG;
+                }
+
                 break;
         }
 
+        case OBJECT_COMPRESSION_DICTIONARY: {
+                _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+                int r;
+
+                if (!JOURNAL_HEADER_COMPRESSED_ZSTD(f->header)) {
+                        error(offset, "Compression dictionary in file without zstd compression");
+                        return -EBADMSG;
+                }
+
+                r = compress_dictionary_new(o->compression_dictionary.payload,
+                                            le64toh(o->object.size) - offsetof(CompressionDictionaryObject, payload),
+                                            &d);
+                if (r < 0) {
+                        error_errno(offset, r, "Invalid compression dictionary: %m");
+                        return r;
+                }
+
+                break;
+        }
+        }
+
         return 0;
 }
 
@@ -940,8 +1005,8 @@ int journal_file_verify(
                         goto fail;
                 }
 
-                if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
-                    (o->object.flags & OBJECT_COMPRESSED_LZ4)) {
+                if (!IN_SET(o->object.flags & OBJECT_COMPRESSION_MASK,
+                            0, OBJECT_COMPRESSED_XZ, OBJECT_COMPRESSED_LZ4, OBJECT_COMPRESSED_ZSTD)) {
                         error(p, "Objected with double compression");
                         r = -EINVAL;
                         goto fail;
@@ -959,6 +1024,12 @@ int journal_file_verify(
                         goto fail;
                 }
 
+                if ((o->object.flags & OBJECT_COMPRESSED_ZSTD) && !JOURNAL_HEADER_COMPRESSED_ZSTD(f->header)) {
+                        error(p, "ZSTD compressed object in file without ZSTD compression");
+                        r = -EBADMSG;
+                        goto fail;
+                }
+
                 switch (o->object.type) {
 
                 case OBJECT_DATA:
@@ -1172,6 +1243,20 @@ int journal_file_verify(
                         n_tags++;
                         break;
 
+                case OBJECT_ENTRY_INDEX:
+                case OBJECT_DATA_BLOOM:
+                        /* Only accelerators, their contents are checked when they are used */
+                        break;
+
+                case OBJECT_COMPRESSION_DICTIONARY:
+                        if (!JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset) ||
+                            p != le64toh(f->header->compression_dictionary_offset)) {
+                                error(p, "Unreferenced compression dictionary");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+                        break;
+
                 default:
                         n_weird++;
                 }
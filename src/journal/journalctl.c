@@ -24,6 +24,7 @@
 #include <linux/fs.h>
 #include <locale.h>
 #include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -46,6 +47,9 @@
 #include "fileio.h"
 #include "fs-util.h"
 #include "fsprg.h"
+#ifdef HAVE_GCRYPT
+#include "gcrypt-util.h"
+#endif
 #include "glob-util.h"
 #include "hostname-util.h"
 #include "io-util.h"
@@ -75,6 +79,8 @@
 
 #define DEFAULT_FSS_INTERVAL_USEC (15*USEC_PER_MINUTE)
 
+#define VERIFY_THREADS_MAX 256U
+
 enum {
         /* Special values for arg_lines */
         ARG_LINES_DEFAULT = -2,
@@ -105,6 +111,7 @@ static char **arg_file = NULL;
 static bool arg_file_stdin = false;
 static int arg_priorities = 0xFF;
 static char *arg_verify_key = NULL;
+static unsigned arg_threads = 0;
 #ifdef HAVE_GCRYPT
 static usec_t arg_interval = DEFAULT_FSS_INTERVAL_USEC;
 static bool arg_force = false;
@@ -313,6 +320,7 @@ static void help(void) {
                "  -D --directory=PATH      Show journal files from directory\n"
                "     --file=PATH           Show journal file\n"
                "     --root=ROOT           Operate on files below a root directory\n"
+               "     --threads=N           Verify journal files in N threads\n"
 #ifdef HAVE_GCRYPT
                "     --interval=TIME       Time interval for changing the FSS sealing key\n"
                "     --verify-key=KEY      Specify FSS verification key\n"
@@ -361,6 +369,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_INTERVAL,
                 ARG_VERIFY,
                 ARG_VERIFY_KEY,
+                ARG_THREADS,
                 ARG_DISK_USAGE,
                 ARG_AFTER_CURSOR,
                 ARG_SHOW_CURSOR,
@@ -411,6 +420,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "interval",       required_argument, NULL, ARG_INTERVAL       },
                 { "verify",         no_argument,       NULL, ARG_VERIFY         },
                 { "verify-key",     required_argument, NULL, ARG_VERIFY_KEY     },
+                { "threads",        required_argument, NULL, ARG_THREADS        },
                 { "disk-usage",     no_argument,       NULL, ARG_DISK_USAGE     },
                 { "cursor",         required_argument, NULL, 'c'                },
                 { "after-cursor",   required_argument, NULL, ARG_AFTER_CURSOR   },
@@ -635,6 +645,14 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_VERIFY;
                         break;
 
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0 || arg_threads > VERIFY_THREADS_MAX) {
+                                log_error("Failed to parse number of threads, or too many threads: %s", optarg);
+                                return -EINVAL;
+                        }
+                        break;
+
                 case ARG_DISK_USAGE:
                         arg_action = ACTION_DISK_USAGE;
                         break;
@@ -1560,6 +1578,25 @@ static int add_syslog_identifier(sd_journal *j) {
         return 0;
 }
 
+static int open_flags_for_range(char **args) {
+
+        /* If we are going to dump everything from the head on, without filtering, we'll read all files front to
+         * back, hence tell the journal to read ahead aggressively. */
+
+        if (arg_action != ACTION_SHOW)
+                return 0;
+
+        if (arg_reverse || arg_lines >= 0 || arg_cursor || arg_after_cursor || arg_since_set)
+                return 0;
+
+        if (arg_boot || arg_dmesg || arg_priorities != 0xFF ||
+            !strv_isempty(arg_system_units) || !strv_isempty(arg_user_units) ||
+            !strv_isempty(arg_syslog_identifier) || !strv_isempty(args))
+                return 0;
+
+        return SD_JOURNAL_SEQUENTIAL;
+}
+
 static int setup_keys(void) {
 #ifdef HAVE_GCRYPT
         size_t mpk_size, seed_size, state_size, i;
@@ -1756,6 +1793,152 @@ finish:
 #endif
 }
 
+static int verify_report(JournalFile *f, int k, usec_t first, usec_t validated, usec_t last) {
+        char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX], c[FORMAT_TIMESPAN_MAX];
+
+        assert(f);
+
+        if (k < 0) {
+                log_warning_errno(k, "FAIL: %s (%m)", f->path);
+                return k;
+        }
+
+        log_info("PASS: %s", f->path);
+
+        if (arg_verify_key && JOURNAL_HEADER_SEALED(f->header)) {
+                if (validated > 0) {
+                        log_info("=> Validated from %s to %s, final %s entries not sealed.",
+                                 format_timestamp_maybe_utc(a, sizeof(a), first),
+                                 format_timestamp_maybe_utc(b, sizeof(b), validated),
+                                 format_timespan(c, sizeof(c), last > validated ? last - validated : 0, 0));
+                } else if (last > 0)
+                        log_info("=> No sealing yet, %s of entries not sealed.",
+                                 format_timespan(c, sizeof(c), last - first, 0));
+                else
+                        log_info("=> No sealing yet, no entries in file.");
+        }
+
+        return 0;
+}
+
+typedef struct VerifyJob {
+        JournalFile *file;
+        int result;
+        usec_t first, validated, last;
+} VerifyJob;
+
+typedef struct VerifyPool {
+        VerifyJob *jobs;
+        size_t n_jobs;
+        size_t next_job;
+        bool cancelled;
+} VerifyPool;
+
+static void *verify_thread(void *userdata) {
+        VerifyPool *pool = userdata;
+
+        /* Each thread verifies whole files. The mmap cache is not thread-safe, hence every file is opened a
+         * second time, with a cache private to this thread. The first pass over the objects of a file is
+         * inherently sequential, hence we do not split up files any further. */
+
+        for (;;) {
+                JournalFile *f = NULL;
+                VerifyJob *job;
+                size_t i;
+                int r;
+
+                if (__atomic_load_n(&pool->cancelled, __ATOMIC_RELAXED))
+                        break;
+
+                i = __sync_fetch_and_add(&pool->next_job, 1);
+                if (i >= pool->n_jobs)
+                        break;
+
+                job = pool->jobs + i;
+
+                /* Without a cache passed in, the file gets its own */
+                r = journal_file_open(-1, job->file->path, O_RDONLY, 0, false, false, NULL, NULL, NULL, NULL, &f);
+                if (r < 0) {
+                        job->result = r;
+                        continue;
+                }
+
+                job->result = journal_file_verify(f, arg_verify_key, &job->first, &job->validated, &job->last, false);
+                if (job->result == -EINVAL)
+                        /* The key is invalid, no point in looking at the other files */
+                        __atomic_store_n(&pool->cancelled, true, __ATOMIC_RELAXED);
+
+                (void) journal_file_close(f);
+        }
+
+        return NULL;
+}
+
+static int verify_threaded(sd_journal *j) {
+        _cleanup_free_ VerifyJob *jobs = NULL;
+        _cleanup_free_ pthread_t *threads = NULL;
+        VerifyPool pool = {};
+        unsigned n_threads = 0, t;
+        JournalFile *f;
+        Iterator i;
+        size_t k;
+        int r = 0;
+
+        assert(j);
+
+        jobs = new0(VerifyJob, ordered_hashmap_size(j->files));
+        if (!jobs)
+                return log_oom();
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
+#ifdef HAVE_GCRYPT
+                if (!arg_verify_key && JOURNAL_HEADER_SEALED(f->header))
+                        log_notice("Journal file %s has sealing enabled but verification key has not been passed using --verify-key=.", f->path);
+#endif
+                jobs[pool.n_jobs++].file = f;
+        }
+
+        pool.jobs = jobs;
+
+#ifdef HAVE_GCRYPT
+        /* Initialization of libgcrypt is not thread-safe, do it before any thread needs it */
+        initialize_libgcrypt(false);
+#endif
+
+        threads = new(pthread_t, MIN(arg_threads, pool.n_jobs));
+        if (!threads)
+                return log_oom();
+
+        for (t = 0; t < MIN(arg_threads, pool.n_jobs); t++) {
+                r = pthread_create(threads + t, NULL, verify_thread, &pool);
+                if (r > 0) {
+                        log_warning_errno(r, "Failed to start verification thread, continuing with %u threads: %m", n_threads);
+                        break;
+                }
+
+                n_threads++;
+        }
+
+        if (n_threads == 0)
+                /* Do all the work in this thread then */
+                (void) verify_thread(&pool);
+
+        for (t = 0; t < n_threads; t++)
+                (void) pthread_join(threads[t], NULL);
+
+        /* Report in the same order as the single threaded version would */
+        r = 0;
+        for (k = 0; k < pool.n_jobs; k++) {
+                if (jobs[k].result == -EINVAL)
+                        return jobs[k].result;
+
+                if (verify_report(jobs[k].file, jobs[k].result, jobs[k].first, jobs[k].validated, jobs[k].last) < 0)
+                        r = jobs[k].result;
+        }
+
+        return r;
+}
+
 static int verify(sd_journal *j) {
         int r = 0;
         Iterator i;
@@ -1765,6 +1948,9 @@ static int verify(sd_journal *j) {
 
         log_show_color(true);
 
+        if (arg_threads > 1)
+                return verify_threaded(j);
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 int k;
                 usec_t first = 0, validated = 0, last = 0;
@@ -1775,29 +1961,12 @@ static int verify(sd_journal *j) {
 #endif
 
                 k = journal_file_verify(f, arg_verify_key, &first, &validated, &last, true);
-                if (k == -EINVAL) {
+                if (k == -EINVAL)
                         /* If the key was invalid give up right-away. */
                         return k;
-                } else if (k < 0) {
-                        log_warning_errno(k, "FAIL: %s (%m)", f->path);
+
+                if (verify_report(f, k, first, validated, last) < 0)
                         r = k;
-                } else {
-                        char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX], c[FORMAT_TIMESPAN_MAX];
-                        log_info("PASS: %s", f->path);
-
-                        if (arg_verify_key && JOURNAL_HEADER_SEALED(f->header)) {
-                                if (validated > 0) {
-                                        log_info("=> Validated from %s to %s, final %s entries not sealed.",
-                                                 format_timestamp_maybe_utc(a, sizeof(a), first),
-                                                 format_timestamp_maybe_utc(b, sizeof(b), validated),
-                                                 format_timespan(c, sizeof(c), last > validated ? last - validated : 0, 0));
-                                } else if (last > 0)
-                                        log_info("=> No sealing yet, %s of entries not sealed.",
-                                                 format_timespan(c, sizeof(c), last - first, 0));
-                                else
-                                        log_info("=> No sealing yet, no entries in file.");
-                        }
-                }
         }
 
         return r;
@@ -1957,7 +2126,7 @@ static int sync_journal(void) {
 }
 
 int main(int argc, char *argv[]) {
-        int r;
+        int r, open_flags;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         bool need_seek = false;
         sd_id128_t previous_boot_id;
@@ -2049,15 +2218,17 @@ int main(int argc, char *argv[]) {
                 assert_not_reached("Unknown action");
         }
 
+        open_flags = open_flags_for_range(argv + optind);
+
         if (arg_directory)
-                r = sd_journal_open_directory(&j, arg_directory, arg_journal_type);
+                r = sd_journal_open_directory(&j, arg_directory, arg_journal_type | open_flags);
         else if (arg_root)
-                r = sd_journal_open_directory(&j, arg_root, arg_journal_type | SD_JOURNAL_OS_ROOT);
+                r = sd_journal_open_directory(&j, arg_root, arg_journal_type | SD_JOURNAL_OS_ROOT | open_flags);
         else if (arg_file_stdin) {
                 int ifd = STDIN_FILENO;
-                r = sd_journal_open_files_fd(&j, &ifd, 1, 0);
+                r = sd_journal_open_files_fd(&j, &ifd, 1, open_flags);
         } else if (arg_file)
-                r = sd_journal_open_files(&j, (const char**) arg_file, 0);
+                r = sd_journal_open_files(&j, (const char**) arg_file, open_flags);
         else if (arg_machine) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
@@ -2104,11 +2275,11 @@ int main(int argc, char *argv[]) {
                         goto finish;
                 }
 
-                r = sd_journal_open_directory_fd(&j, fd, SD_JOURNAL_OS_ROOT);
+                r = sd_journal_open_directory_fd(&j, fd, SD_JOURNAL_OS_ROOT | open_flags);
                 if (r < 0)
                         safe_close(fd);
         } else
-                r = sd_journal_open(&j, !arg_merge*SD_JOURNAL_LOCAL_ONLY + arg_journal_type);
+                r = sd_journal_open(&j, !arg_merge*SD_JOURNAL_LOCAL_ONLY + arg_journal_type + open_flags);
         if (r < 0) {
                 log_error_errno(r, "Failed to open %s: %m", arg_directory ?: arg_file ? "files" : "journal");
                 goto finish;
@@ -34,29 +34,22 @@ typedef struct MapField {
 
 static int map_simple_field(const char *field, const char **p, struct iovec **iov, size_t *n_iov_allocated, unsigned *n_iov) {
         _cleanup_free_ char *c = NULL;
-        size_t l = 0, allocated = 0;
         const char *e;
+        size_t l;
 
         assert(field);
         assert(p);
         assert(iov);
         assert(n_iov);
 
-        l = strlen(field);
-        allocated = l + 1;
-        c = malloc(allocated);
+        e = *p + strcspn(*p, " ");
+
+        l = strlen(field) + (e - *p);
+        c = malloc(l + 1);
         if (!c)
                 return -ENOMEM;
 
-        memcpy(c, field, l);
-        for (e = *p; *e != ' ' && *e != 0; e++) {
-                if (!GREEDY_REALLOC(c, allocated, l+2))
-                        return -ENOMEM;
-
-                c[l++] = *e;
-        }
-
-        c[l] = 0;
+        *((char*) mempcpy(stpcpy(c, field), *p, e - *p)) = 0;
 
         if (!GREEDY_REALLOC(*iov, *n_iov_allocated, *n_iov + 1))
                 return -ENOMEM;
@@ -101,11 +94,9 @@ static int map_string_field_internal(const char *field, const char **p, struct i
 
         } else if (unhexchar(**p) >= 0) {
                 /* Hexadecimal escaping */
-                size_t allocated = 0;
 
                 l = strlen(field);
-                allocated = l + 2;
-                c = malloc(allocated);
+                c = malloc(l + strcspn(*p, " ") / 2 + 1);
                 if (!c)
                         return -ENOMEM;
 
@@ -127,9 +118,6 @@ static int map_string_field_internal(const char *field, const char **p, struct i
                         if (filter_printable && x < (uint8_t) ' ')
                                 x = (uint8_t) ' ';
 
-                        if (!GREEDY_REALLOC(c, allocated, l+2))
-                                return -ENOMEM;
-
                         c[l++] = (char) x;
                 }
 
@@ -339,7 +327,7 @@ static void process_audit_string(Server *s, int type, const char *data, size_t s
         size_t n_iov_allocated = 0;
         unsigned n_iov = 0, k;
         uint64_t seconds, msec, id;
-        const char *p, *type_name;
+        const char *p, *q, *type_name;
         unsigned z;
         char id_field[sizeof("_AUDIT_ID=") + DECIMAL_STR_MAX(uint64_t)],
              type_field[sizeof("_AUDIT_TYPE=") + DECIMAL_STR_MAX(int)],
@@ -376,7 +364,13 @@ static void process_audit_string(Server *s, int type, const char *data, size_t s
         if (isempty(p))
                 return;
 
-        n_iov_allocated = N_IOVEC_META_FIELDS + 7;
+        /* Fields are separated by spaces, hence this is enough room for all of them plus the metadata
+         * server_dispatch_message() adds, and the array doesn't need to be grown while mapping */
+        n_iov_allocated = N_IOVEC_META_FIELDS + 7 + 1;
+        for (q = p; *q; q++)
+                if (*q == ' ')
+                        n_iov_allocated++;
+
         iov = new(struct iovec, n_iov_allocated);
         if (!iov) {
                 log_oom();
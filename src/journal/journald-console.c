@@ -18,6 +18,7 @@
 ***/
 
 #include <fcntl.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <time.h>
 
@@ -33,6 +34,8 @@
 #include "stdio-util.h"
 #include "terminal-util.h"
 
+#define WARN_FORWARD_CONSOLE_MISSED_USEC (30 * USEC_PER_SEC)
+
 static bool prefix_timestamp(void) {
 
         static int cached_printk_time = -1;
@@ -48,6 +51,61 @@ static bool prefix_timestamp(void) {
         return cached_printk_time;
 }
 
+static int open_console(Server *s) {
+        const char *tty;
+        int fd;
+
+        assert(s);
+
+        tty = s->tty_path ?: "/dev/console";
+
+        /* Before you ask: yes, on purpose we open/close the console for each log line we write individually. This is a
+         * good strategy to avoid journald getting killed by the kernel's SAK concept (it doesn't fix this entirely,
+         * but minimizes the time window the kernel might end up killing journald due to SAK). It also makes things
+         * easier for us so that we don't have to recover from hangups and suchlike triggered on the console. */
+
+        /* The console is opened in non-blocking mode, so that a slow console (such as a serial port) doesn't
+         * throttle how fast we can write to the journal. If its output buffer is full, we drop the message, and
+         * only count it, like we do when forwarding to syslog. */
+
+        fd = open_terminal(tty, O_WRONLY|O_NOCTTY|O_CLOEXEC|O_NONBLOCK);
+        if (fd < 0)
+                log_debug_errno(fd, "Failed to open %s for logging: %m", tty);
+
+        return fd;
+}
+
+/* Tries to write out the rest of a line that didn't fit into the console's output buffer earlier. Returns true
+ * if nothing is left over. */
+static bool flush_pending(Server *s, int fd) {
+        ssize_t k;
+
+        assert(s);
+        assert(fd >= 0);
+
+        if (s->forward_console_pending_size <= 0)
+                return true;
+
+        k = write(fd, s->forward_console_pending, s->forward_console_pending_size);
+        if (k < 0) {
+                if (errno == EAGAIN)
+                        return false;
+
+                /* Something else is wrong with the console, there's no point in holding on to the line */
+                log_debug_errno(errno, "Failed to write to %s for logging: %m", s->tty_path ?: "/dev/console");
+                k = s->forward_console_pending_size;
+        }
+
+        s->forward_console_pending_size -= k;
+        if (s->forward_console_pending_size > 0) {
+                memmove(s->forward_console_pending, s->forward_console_pending + k, s->forward_console_pending_size);
+                return false;
+        }
+
+        s->forward_console_pending = mfree(s->forward_console_pending);
+        return true;
+}
+
 void server_forward_console(
                 Server *s,
                 int priority,
@@ -61,8 +119,10 @@ void server_forward_console(
         char header_pid[sizeof("[]: ")-1 + DECIMAL_STR_MAX(pid_t)];
         _cleanup_free_ char *ident_buf = NULL;
         _cleanup_close_ int fd = -1;
-        const char *tty;
-        int n = 0;
+        size_t total;
+        ssize_t k;
+        int i, n = 0;
+        char *p;
 
         assert(s);
         assert(message);
@@ -102,19 +162,83 @@ void server_forward_console(
         iovec[n++] = IOVEC_MAKE_STRING(message);
         iovec[n++] = IOVEC_MAKE_STRING("\n");
 
-        tty = s->tty_path ?: "/dev/console";
+        /* Whatever we couldn't write of the previous line needs to go out first, otherwise the console would
+         * show half a line glued to the next one. If that doesn't fit either, drop this line as a whole. */
+        fd = open_console(s);
+        if (fd < 0)
+                return;
 
-        /* Before you ask: yes, on purpose we open/close the console for each log line we write individually. This is a
-         * good strategy to avoid journald getting killed by the kernel's SAK concept (it doesn't fix this entirely,
-         * but minimizes the time window the kernel might end up killing journald due to SAK). It also makes things
-         * easier for us so that we don't have to recover from hangups and suchlike triggered on the console. */
+        if (!flush_pending(s, fd)) {
+                s->n_forward_console_missed++;
+                return;
+        }
 
-        fd = open_terminal(tty, O_WRONLY|O_NOCTTY|O_CLOEXEC);
-        if (fd < 0) {
-                log_debug_errno(fd, "Failed to open %s for logging: %m", tty);
+        k = writev(fd, iovec, n);
+        if (k < 0) {
+                if (errno == EAGAIN) {
+                        s->n_forward_console_missed++;
+                        return;
+                }
+
+                log_debug_errno(errno, "Failed to write to %s for logging: %m", s->tty_path ?: "/dev/console");
                 return;
         }
 
-        if (writev(fd, iovec, n) < 0)
-                log_debug_errno(errno, "Failed to write to %s for logging: %m", tty);
+        /* The output buffer filled up in the middle of the line, remember the rest for the next time */
+        assert_se(IOVEC_INCREMENT(iovec, n, k) == 0);
+
+        total = IOVEC_TOTAL_SIZE(iovec, n);
+        if (total == 0)
+                return;
+
+        p = malloc(total);
+        if (!p) {
+                log_oom();
+                return;
+        }
+
+        for (i = 0, total = 0; i < n; i++) {
+                memcpy_safe(p + total, iovec[i].iov_base, iovec[i].iov_len);
+                total += iovec[i].iov_len;
+        }
+
+        s->forward_console_pending = p;
+        s->forward_console_pending_size = total;
+}
+
+void server_maybe_warn_forward_console_missed(Server *s) {
+        _cleanup_close_ int fd = -1;
+        usec_t n;
+        int q;
+
+        assert(s);
+
+        if (s->n_forward_console_missed <= 0)
+                return;
+
+        n = now(CLOCK_MONOTONIC);
+        if (s->last_warn_forward_console_missed + WARN_FORWARD_CONSOLE_MISSED_USEC > n)
+                return;
+
+        /* Only tell about the missed messages once the console caught up, so that the notice doesn't get
+         * dropped itself, and isn't written in the middle of a line. */
+        fd = open_console(s);
+        if (fd < 0)
+                return;
+
+        if (!flush_pending(s, fd))
+                return;
+
+        if (ioctl(fd, TIOCOUTQ, &q) >= 0 && q > 0)
+                return;
+
+        fd = safe_close(fd);
+
+        server_driver_message(s, NULL,
+                              LOG_MESSAGE("Forwarding to the console missed %u messages.",
+                                          s->n_forward_console_missed),
+                              NULL);
+
+        s->n_forward_console_missed = 0;
+        s->last_warn_forward_console_missed = n;
 }
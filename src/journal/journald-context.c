@@ -17,6 +17,8 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/inotify.h>
+
 #ifdef HAVE_SELINUX
 #include <selinux/selinux.h>
 #endif
@@ -24,7 +26,10 @@
 #include "alloc-util.h"
 #include "audit-util.h"
 #include "cgroup-util.h"
+#include "fd-util.h"
+#include "fs-util.h"
 #include "journald-context.h"
+#include "path-util.h"
 #include "process-util.h"
 #include "string-util.h"
 #include "user-util.h"
@@ -54,6 +59,13 @@
  *    stream connection. This should improve cases where a service process logs immediately before exiting and we
  *    previously had trouble associating the log message with the service.
  *
+ * Metadata derived from the cgroup of a client (unit, slice, session, invocation ID, ...) is cached once more, indexed
+ * by the cgroup path, so that all processes of a unit share it. Short-lived processes hence only cost us the per-PID
+ * reads, and not the cgroup parsing and the xattr lookup. On the unified hierarchy we watch the "cgroup.events" file of
+ * each cached cgroup, and throw out the entry as soon as the cgroup runs empty, which is what happens before it is
+ * removed and possibly recreated for a new invocation of the unit. Elsewhere cgroup entries are refreshed on the same
+ * schedule as the client entries.
+ *
  * NB: With and without the metadata cache: the implicitly added entry metadata in the journal (with the exception of
  *     UID/PID/GID and SELinux label) must be understood as possibly slightly out of sync (i.e. sometimes slighly older
  *     and sometimes slightly newer than what was current at the log event).
@@ -126,7 +138,8 @@ static int client_context_new(Server *s, pid_t pid, ClientContext **ret) {
         return 0;
 }
 
-static void client_context_reset(ClientContext *c) {
+static void client_context_reset(Server *s, ClientContext *c) {
+        assert(s);
         assert(c);
 
         c->timestamp = USEC_INFINITY;
@@ -142,13 +155,13 @@ static void client_context_reset(ClientContext *c) {
         c->auditid = AUDIT_SESSION_INVALID;
         c->loginuid = UID_INVALID;
 
-        c->cgroup = mfree(c->cgroup);
-        c->session = mfree(c->session);
+        c->cgroup = string_pool_unref(s->client_strings, c->cgroup);
+        c->session = string_pool_unref(s->client_strings, c->session);
         c->owner_uid = UID_INVALID;
-        c->unit = mfree(c->unit);
-        c->user_unit = mfree(c->user_unit);
-        c->slice = mfree(c->slice);
-        c->user_slice = mfree(c->user_slice);
+        c->unit = string_pool_unref(s->client_strings, c->unit);
+        c->user_unit = string_pool_unref(s->client_strings, c->user_unit);
+        c->slice = string_pool_unref(s->client_strings, c->slice);
+        c->user_slice = string_pool_unref(s->client_strings, c->user_slice);
 
         c->invocation_id = SD_ID128_NULL;
 
@@ -167,7 +180,7 @@ static ClientContext* client_context_free(Server *s, ClientContext *c) {
         if (c->in_lru)
                 assert_se(prioq_remove(s->client_contexts_lru, c, &c->lru_index) >= 0);
 
-        client_context_reset(c);
+        client_context_reset(s, c);
 
         return mfree(c);
 }
@@ -243,78 +256,62 @@ static int client_context_read_label(
         return 0;
 }
 
-static int client_context_read_cgroup(Server *s, ClientContext *c, const char *unit_id) {
-        char *t = NULL;
-        int r;
-
-        assert(c);
-
-        /* Try to acquire the current cgroup path */
-        r = cg_pid_get_path_shifted(c->pid, s->cgroup_root, &t);
-        if (r < 0) {
-
-                /* If that didn't work, we use the unit ID passed in as fallback, if we have nothing cached yet */
-                if (unit_id && !c->unit) {
-                        c->unit = strdup(unit_id);
-                        if (c->unit)
-                                return 0;
-                }
-
-                return r;
-        }
+static int client_strings_ensure(Server *s) {
+        assert(s);
 
-        /* Let's shortcut this if the cgroup path didn't change */
-        if (streq_ptr(c->cgroup, t)) {
-                free(t);
+        if (s->client_strings)
                 return 0;
-        }
 
-        free_and_replace(c->cgroup, t);
+        s->client_strings = string_pool_new();
+        if (!s->client_strings)
+                return -ENOMEM;
 
-        (void) cg_path_get_session(c->cgroup, &t);
-        free_and_replace(c->session, t);
+        return 1;
+}
 
-        if (cg_path_get_owner_uid(c->cgroup, &c->owner_uid) < 0)
-                c->owner_uid = UID_INVALID;
+static ClientCgroup* client_cgroup_free(Server *s, ClientCgroup *cg) {
+        assert(s);
 
-        (void) cg_path_get_unit(c->cgroup, &t);
-        free_and_replace(c->unit, t);
+        if (!cg)
+                return NULL;
 
-        (void) cg_path_get_user_unit(c->cgroup, &t);
-        free_and_replace(c->user_unit, t);
+        assert_se(hashmap_remove(s->client_cgroups, cg->path) == cg);
 
-        (void) cg_path_get_slice(c->cgroup, &t);
-        free_and_replace(c->slice, t);
+        if (cg->inotify_wd >= 0) {
+                assert_se(hashmap_remove(s->client_cgroups_by_wd, INT_TO_PTR(cg->inotify_wd)) == cg);
+                (void) inotify_rm_watch(s->cgroup_inotify_fd, cg->inotify_wd);
+        }
 
-        (void) cg_path_get_user_slice(c->cgroup, &t);
-        free_and_replace(c->user_slice, t);
+        string_pool_unref(s->client_strings, cg->path);
+        string_pool_unref(s->client_strings, cg->session);
+        string_pool_unref(s->client_strings, cg->unit);
+        string_pool_unref(s->client_strings, cg->user_unit);
+        string_pool_unref(s->client_strings, cg->slice);
+        string_pool_unref(s->client_strings, cg->user_slice);
 
-        return 0;
+        return mfree(cg);
 }
 
-static int client_context_read_invocation_id(
-                Server *s,
-                ClientContext *c) {
-
+static int client_cgroup_read_invocation_id(Server *s, ClientCgroup *cg) {
         _cleanup_free_ char *escaped = NULL, *slice_path = NULL;
         char ids[SD_ID128_STRING_MAX];
         const char *p;
         int r;
 
         assert(s);
-        assert(c);
+        assert(cg);
 
         /* Read the invocation ID of a unit off a unit. It's stored in the "trusted.invocation_id" extended attribute
          * on the cgroup path. */
 
-        if (!c->unit || !c->slice)
+        if (!cg->unit || !cg->slice)
                 return 0;
 
-        r = cg_slice_to_path(c->slice, &slice_path);
+        r = cg_slice_to_path(cg->slice, &slice_path);
         if (r < 0)
                 return r;
 
-        escaped = cg_escape(c->unit);
+        escaped = cg_escape(cg->unit);
         if (!escaped)
                 return -ENOMEM;
 
@@ -329,7 +326,242 @@ static int client_context_read_invocation_id(
                 return -EINVAL;
         ids[32] = 0;
 
-        return sd_id128_from_string(ids, &c->invocation_id);
+        return sd_id128_from_string(ids, &cg->invocation_id);
+}
+
+void client_cgroup_flush_all(Server *s) {
+        ClientCgroup *cg;
+
+        assert(s);
+
+        while ((cg = hashmap_first(s->client_cgroups)))
+                client_cgroup_free(s, cg);
+}
+
+int client_cgroup_dispatch_inotify(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+        assert(fd == s->cgroup_inotify_fd);
+
+        for (;;) {
+                union inotify_event_buffer buffer;
+                struct inotify_event *e;
+                ssize_t l;
+
+                l = read(fd, &buffer, sizeof(buffer));
+                if (l < 0) {
+                        if (IN_SET(errno, EINTR, EAGAIN))
+                                return 0;
+
+                        return log_error_errno(errno, "Failed to read cgroup inotify events: %m");
+                }
+
+                FOREACH_INOTIFY_EVENT(e, buffer, l) {
+                        ClientCgroup *cg;
+
+                        if (e->wd < 0) {
+                                /* The queue overflowed, we don't know what we missed */
+                                client_cgroup_flush_all(s);
+                                continue;
+                        }
+
+                        cg = hashmap_get(s->client_cgroups_by_wd, INT_TO_PTR(e->wd));
+                        if (!cg) /* Events may still be queued for watches we already removed */
+                                continue;
+
+                        if (e->mask & IN_IGNORED) {
+                                /* The cgroup is gone, and with it the watch */
+                                assert_se(hashmap_remove(s->client_cgroups_by_wd, INT_TO_PTR(e->wd)) == cg);
+                                cg->inotify_wd = -1;
+                        }
+
+                        /* The cgroup ran empty or got populated again. Either way, the next client in it might
+                         * belong to a different invocation, let's look again then. */
+                        client_cgroup_free(s, cg);
+                }
+        }
+}
+
+static int client_cgroup_watch(Server *s, ClientCgroup *cg) {
+        _cleanup_free_ char *events = NULL;
+        const char *p;
+        int r;
+
+        assert(s);
+        assert(cg);
+
+        /* cgroup.events only exists on the unified hierarchy, and not for the root cgroup */
+        r = cg_unified_controller(SYSTEMD_CGROUP_CONTROLLER);
+        if (r <= 0)
+                return r;
+
+        if (path_equal(cg->path, "/"))
+                return 0;
+
+        if (!s->event)
+                return 0;
+
+        if (s->cgroup_inotify_fd < 0) {
+                s->cgroup_inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+                if (s->cgroup_inotify_fd < 0)
+                        return -errno;
+
+                r = sd_event_add_io(s->event, &s->cgroup_inotify_event_source, s->cgroup_inotify_fd, EPOLLIN, client_cgroup_dispatch_inotify, s);
+                if (r < 0) {
+                        s->cgroup_inotify_fd = safe_close(s->cgroup_inotify_fd);
+                        return r;
+                }
+
+                /* Process cgroup events before any log messages, so that we don't use stale data */
+                (void) sd_event_source_set_priority(s->cgroup_inotify_event_source, SD_EVENT_PRIORITY_NORMAL-10);
+                (void) sd_event_source_set_description(s->cgroup_inotify_event_source, "cgroup-inotify");
+        }
+
+        r = hashmap_ensure_allocated(&s->client_cgroups_by_wd, NULL);
+        if (r < 0)
+                return r;
+
+        if (path_equal(s->cgroup_root, "/"))
+                p = cg->path;
+        else
+                p = strjoina(s->cgroup_root, cg->path);
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, p, "cgroup.events", &events);
+        if (r < 0)
+                return r;
+
+        cg->inotify_wd = inotify_add_watch(s->cgroup_inotify_fd, events, IN_MODIFY);
+        if (cg->inotify_wd < 0)
+                return -errno;
+
+        r = hashmap_put(s->client_cgroups_by_wd, INT_TO_PTR(cg->inotify_wd), cg);
+        if (r < 0) {
+                (void) inotify_rm_watch(s->cgroup_inotify_fd, cg->inotify_wd);
+                cg->inotify_wd = -1;
+                return r;
+        }
+
+        return 1;
+}
+
+int client_cgroup_get(Server *s, const char *path, usec_t timestamp, ClientCgroup **ret) {
+        _cleanup_free_ char *session = NULL, *unit = NULL, *user_unit = NULL, *slice = NULL, *user_slice = NULL;
+        ClientCgroup *cg;
+        int r;
+
+        assert(s);
+        assert(path);
+        assert(ret);
+
+        cg = hashmap_get(s->client_cgroups, path);
+        if (cg) {
+                /* Watched entries are valid until the cgroup runs empty, the others are refreshed when old */
+                if (cg->inotify_wd >= 0 || cg->timestamp + REFRESH_USEC >= timestamp) {
+                        *ret = cg;
+                        return 0;
+                }
+
+                client_cgroup_free(s, cg);
+        }
+
+        r = hashmap_ensure_allocated(&s->client_cgroups, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = client_strings_ensure(s);
+        if (r < 0)
+                return r;
+
+        /* We don't bother with an LRU here, the entries are cheap to recreate compared to the per-PID ones */
+        while (hashmap_size(s->client_cgroups) >= CGROUP_CACHE_MAX)
+                client_cgroup_free(s, hashmap_first(s->client_cgroups));
+
+        cg = new0(ClientCgroup, 1);
+        if (!cg)
+                return -ENOMEM;
+
+        cg->inotify_wd = -1;
+        cg->owner_uid = UID_INVALID;
+        cg->timestamp = timestamp;
+
+        cg->path = string_pool_ref(s->client_strings, path);
+        if (!cg->path) {
+                free(cg);
+                return -ENOMEM;
+        }
+
+        r = hashmap_put(s->client_cgroups, cg->path, cg);
+        if (r < 0) {
+                string_pool_unref(s->client_strings, cg->path);
+                free(cg);
+                return r;
+        }
+
+        (void) cg_path_get_session(cg->path, &session);
+
+        if (cg_path_get_owner_uid(cg->path, &cg->owner_uid) < 0)
+                cg->owner_uid = UID_INVALID;
+
+        (void) cg_path_get_unit(cg->path, &unit);
+        (void) cg_path_get_user_unit(cg->path, &user_unit);
+        (void) cg_path_get_slice(cg->path, &slice);
+        (void) cg_path_get_user_slice(cg->path, &user_slice);
+
+        /* Most cgroups share their slice, and the clients of a cgroup all share its strings below */
+        (void) string_pool_set(s->client_strings, &cg->session, session);
+        (void) string_pool_set(s->client_strings, &cg->unit, unit);
+        (void) string_pool_set(s->client_strings, &cg->user_unit, user_unit);
+        (void) string_pool_set(s->client_strings, &cg->slice, slice);
+        (void) string_pool_set(s->client_strings, &cg->user_slice, user_slice);
+
+        /* Watch before reading the invocation ID, so that we can't miss the unit being restarted in between */
+        r = client_cgroup_watch(s, cg);
+        if (r < 0)
+                log_debug_errno(r, "Failed to watch cgroup %s, refreshing it periodically: %m", cg->path);
+
+        (void) client_cgroup_read_invocation_id(s, cg);
+
+        *ret = cg;
+        return 0;
+}
+
+static int client_context_read_cgroup(Server *s, ClientContext *c, const char *unit_id, usec_t timestamp) {
+        _cleanup_free_ char *t = NULL;
+        ClientCgroup *cg;
+        int r;
+
+        assert(c);
+
+        /* Try to acquire the current cgroup path */
+        r = cg_pid_get_path_shifted(c->pid, s->cgroup_root, &t);
+        if (r < 0) {
+
+                /* If that didn't work, we use the unit ID passed in as fallback, if we have nothing cached yet */
+                if (unit_id && !c->unit && client_strings_ensure(s) >= 0) {
+                        c->unit = string_pool_ref(s->client_strings, unit_id);
+                        if (c->unit)
+                                return 0;
+                }
+
+                return r;
+        }
+
+        r = client_cgroup_get(s, t, timestamp, &cg);
+        if (r < 0)
+                return r;
+
+        c->owner_uid = cg->owner_uid;
+        c->invocation_id = cg->invocation_id;
+
+        (void) string_pool_set_interned(s->client_strings, &c->cgroup, cg->path);
+        (void) string_pool_set_interned(s->client_strings, &c->session, cg->session);
+        (void) string_pool_set_interned(s->client_strings, &c->unit, cg->unit);
+        (void) string_pool_set_interned(s->client_strings, &c->user_unit, cg->user_unit);
+        (void) string_pool_set_interned(s->client_strings, &c->slice, cg->slice);
+        (void) string_pool_set_interned(s->client_strings, &c->user_slice, cg->user_slice);
+
+        return 0;
 }
 
 static void client_context_really_refresh(
@@ -354,8 +586,7 @@ static void client_context_really_refresh(
         (void) audit_session_from_pid(c->pid, &c->auditid);
         (void) audit_loginuid_from_pid(c->pid, &c->loginuid);
 
-        (void) client_context_read_cgroup(s, c, unit_id);
-        (void) client_context_read_invocation_id(s, c);
+        (void) client_context_read_cgroup(s, c, unit_id, timestamp);
 
         c->timestamp = timestamp;
 
@@ -386,7 +617,7 @@ void client_context_maybe_refresh(
         /* If the data isn't pinned and if the cashed data is older than the upper limit, we flush it out
          * entirely. This follows the logic that as long as an entry is pinned the PID reuse is unlikely. */
         if (c->n_ref == 0 && c->timestamp + MAX_USEC < timestamp) {
-                client_context_reset(c);
+                client_context_reset(s, c);
                 goto refresh;
         }
 
@@ -448,6 +679,17 @@ void client_context_flush_all(Server *s) {
 
         s->client_contexts_lru = prioq_free(s->client_contexts_lru);
         s->client_contexts = hashmap_free(s->client_contexts);
+
+        client_cgroup_flush_all(s);
+
+        s->client_cgroups = hashmap_free(s->client_cgroups);
+        s->client_cgroups_by_wd = hashmap_free(s->client_cgroups_by_wd);
+
+        assert(string_pool_size(s->client_strings) == 0);
+        s->client_strings = string_pool_free(s->client_strings);
+
+        s->cgroup_inotify_event_source = sd_event_source_unref(s->cgroup_inotify_event_source);
+        s->cgroup_inotify_fd = safe_close(s->cgroup_inotify_fd);
 }
 
 static int client_context_get_internal(
@@ -25,6 +25,7 @@
 #include "sd-id128.h"
 
 typedef struct ClientContext ClientContext;
+typedef struct ClientCgroup ClientCgroup;
 
 #include "journald-server.h"
 
@@ -46,15 +47,15 @@ struct ClientContext {
         uint32_t auditid;
         uid_t loginuid;
 
-        char *cgroup;
-        char *session;
+        const char *cgroup;
+        const char *session;
         uid_t owner_uid;
 
-        char *unit;
-        char *user_unit;
+        const char *unit;
+        const char *user_unit;
 
-        char *slice;
-        char *user_slice;
+        const char *slice;
+        const char *user_slice;
 
         sd_id128_t invocation_id;
 
@@ -90,3 +91,28 @@ void client_context_maybe_refresh(
 
 void client_context_acquire_default(Server *s);
 void client_context_flush_all(Server *s);
+
+/* Keep at most 4K cgroups in the cache */
+#define CGROUP_CACHE_MAX (4*1024)
+
+/* The metadata shared by all clients in a cgroup. All strings are interned in s->client_strings. */
+struct ClientCgroup {
+        const char *path;
+        usec_t timestamp;
+        int inotify_wd;
+
+        const char *session;
+        uid_t owner_uid;
+
+        const char *unit;
+        const char *user_unit;
+
+        const char *slice;
+        const char *user_slice;
+
+        sd_id128_t invocation_id;
+};
+
+int client_cgroup_get(Server *s, const char *path, usec_t timestamp, ClientCgroup **ret);
+int client_cgroup_dispatch_inotify(sd_event_source *es, int fd, uint32_t revents, void *userdata);
+void client_cgroup_flush_all(Server *s);
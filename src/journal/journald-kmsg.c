@@ -39,6 +39,9 @@
 #include "stdio-util.h"
 #include "string-util.h"
 
+/* How many records to read from /dev/kmsg per wakeup at most */
+#define DEV_KMSG_READ_MAX 64U
+
 void server_forward_kmsg(
         Server *s,
         int priority,
@@ -108,6 +111,44 @@ static bool is_us(const char *pid) {
         return t == getpid_cached();
 }
 
+void server_forget_dev_kmsg_device(Server *s) {
+        assert(s);
+
+        s->dev_kmsg_device = udev_device_unref(s->dev_kmsg_device);
+        s->dev_kmsg_device_id = mfree(s->dev_kmsg_device_id);
+}
+
+static struct udev_device *dev_kmsg_get_device(Server *s, const char *id) {
+        struct udev_device *ud;
+        char *copy;
+
+        assert(s);
+        assert(id);
+
+        /* Kernel messages tend to come in bursts about the same device, hence remember the last device we
+         * looked up. The cache is dropped whenever we are done reading the currently queued messages, so that
+         * we don't report stale udev data later on. */
+
+        if (s->dev_kmsg_device && streq_ptr(s->dev_kmsg_device_id, id))
+                return s->dev_kmsg_device;
+
+        ud = udev_device_new_from_device_id(s->udev, id);
+        if (!ud)
+                return NULL;
+
+        copy = strdup(id);
+        if (!copy) {
+                udev_device_unref(ud);
+                return NULL;
+        }
+
+        server_forget_dev_kmsg_device(s);
+        s->dev_kmsg_device = ud;
+        s->dev_kmsg_device_id = copy;
+
+        return ud;
+}
+
 static void dev_kmsg_record(Server *s, const char *p, size_t l) {
         struct iovec iovec[N_IOVEC_META_FIELDS + 7 + N_IOVEC_KERNEL_FIELDS + 2 + N_IOVEC_UDEV_FIELDS];
         _cleanup_free_ char *message = NULL, *syslog_priority = NULL, *syslog_pid = NULL, *syslog_facility = NULL, *syslog_identifier = NULL, *source_time = NULL, *identifier = NULL, *pid = NULL;
@@ -225,7 +266,7 @@ static void dev_kmsg_record(Server *s, const char *p, size_t l) {
         if (kernel_device) {
                 struct udev_device *ud;
 
-                ud = udev_device_new_from_device_id(s->udev, kernel_device);
+                ud = dev_kmsg_get_device(s, kernel_device);
                 if (ud) {
                         const char *g;
                         struct udev_list_entry *ll;
@@ -267,8 +308,6 @@ static void dev_kmsg_record(Server *s, const char *p, size_t l) {
 
                                 j++;
                         }
-
-                        udev_device_unref(ud);
                 }
         }
 
@@ -360,18 +399,19 @@ int server_flush_dev_kmsg(Server *s) {
 
         for (;;) {
                 r = server_read_dev_kmsg(s);
-                if (r < 0)
-                        return r;
-
-                if (r == 0)
+                if (r <= 0)
                         break;
         }
 
-        return 0;
+        server_forget_dev_kmsg_device(s);
+
+        return r < 0 ? r : 0;
 }
 
 static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         Server *s = userdata;
+        unsigned i;
+        int r = 0;
 
         assert(es);
         assert(fd == s->dev_kmsg_fd);
@@ -383,7 +423,17 @@ static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void
         if (!(revents & EPOLLIN))
                 log_error("Got invalid event from epoll for /dev/kmsg: %"PRIx32, revents);
 
-        return server_read_dev_kmsg(s);
+        /* Read a batch of records per wakeup, instead of going through the event loop for each one, but don't
+         * starve the other event sources during a kernel log storm */
+        for (i = 0; i < DEV_KMSG_READ_MAX; i++) {
+                r = server_read_dev_kmsg(s);
+                if (r <= 0)
+                        break;
+        }
+
+        server_forget_dev_kmsg_device(s);
+
+        return r;
 }
 
 int server_open_dev_kmsg(Server *s) {
@@ -24,12 +24,10 @@
 #include "hashmap.h"
 #include "journald-rate-limit.h"
 #include "list.h"
-#include "random-util.h"
 #include "string-util.h"
 #include "util.h"
 
 #define POOLS_MAX 5
-#define BUCKETS_MAX 127
 #define GROUPS_MAX 2047
 
 static const int priority_map[] = {
@@ -43,13 +41,21 @@ static const int priority_map[] = {
         [LOG_DEBUG]   = 4
 };
 
+static const char* const pool_name[POOLS_MAX] = {
+        "crit", "err", "warning", "info", "debug"
+};
+
 typedef struct JournalRateLimitPool JournalRateLimitPool;
 typedef struct JournalRateLimitGroup JournalRateLimitGroup;
 
+/* Each pool is a token bucket holding up to 'burst' messages, refilled with 'burst' messages per interval. We keep
+ * track of it the GCRA way: instead of a token count we store the time until which the bucket is drained at the
+ * current level, which makes refilling implicit. */
 struct JournalRateLimitPool {
-        usec_t begin;
-        unsigned num;
+        usec_t tat;
+        usec_t suppressed_begin;
         unsigned suppressed;
+        uint64_t n_suppressed;
 };
 
 struct JournalRateLimitGroup {
@@ -57,9 +63,7 @@ struct JournalRateLimitGroup {
 
         char *id;
         JournalRateLimitPool pools[POOLS_MAX];
-        uint64_t hash;
 
-        LIST_FIELDS(JournalRateLimitGroup, bucket);
         LIST_FIELDS(JournalRateLimitGroup, lru);
 };
 
@@ -67,12 +71,8 @@ struct JournalRateLimit {
         usec_t interval;
         unsigned burst;
 
-        JournalRateLimitGroup* buckets[BUCKETS_MAX];
+        Hashmap *groups;
         JournalRateLimitGroup *lru, *lru_tail;
-
-        unsigned n_groups;
-
-        uint8_t hash_key[16];
 };
 
 JournalRateLimit *journal_rate_limit_new(usec_t interval, unsigned burst) {
@@ -87,8 +87,6 @@ JournalRateLimit *journal_rate_limit_new(usec_t interval, unsigned burst) {
         r->interval = interval;
         r->burst = burst;
 
-        random_bytes(r->hash_key, sizeof(r->hash_key));
-
         return r;
 }
 
@@ -96,15 +94,11 @@ static void journal_rate_limit_group_free(JournalRateLimitGroup *g) {
         assert(g);
 
         if (g->parent) {
-                assert(g->parent->n_groups > 0);
-
                 if (g->parent->lru_tail == g)
                         g->parent->lru_tail = g->lru_prev;
 
                 LIST_REMOVE(lru, g->parent->lru, g);
-                LIST_REMOVE(bucket, g->parent->buckets[g->hash % BUCKETS_MAX], g);
-
-                g->parent->n_groups--;
+                (void) hashmap_remove(g->parent->groups, g->id);
         }
 
         free(g->id);
@@ -117,6 +111,7 @@ void journal_rate_limit_free(JournalRateLimit *r) {
         while (r->lru)
                 journal_rate_limit_group_free(r->lru);
 
+        hashmap_free(r->groups);
         free(r);
 }
 
@@ -125,8 +120,9 @@ _pure_ static bool journal_rate_limit_group_expired(JournalRateLimitGroup *g, us
 
         assert(g);
 
+        /* Expired once all buckets have been full again for a whole interval */
         for (i = 0; i < POOLS_MAX; i++)
-                if (g->pools[i].begin + g->parent->interval >= ts)
+                if (g->pools[i].tat + g->parent->interval >= ts)
                         return false;
 
         return true;
@@ -138,18 +134,20 @@ static void journal_rate_limit_vacuum(JournalRateLimit *r, usec_t ts) {
         /* Makes room for at least one new item, but drop all
          * expored items too. */
 
-        while (r->n_groups >= GROUPS_MAX ||
+        while (hashmap_size(r->groups) >= GROUPS_MAX ||
                (r->lru_tail && journal_rate_limit_group_expired(r->lru_tail, ts)))
                 journal_rate_limit_group_free(r->lru_tail);
 }
 
 static JournalRateLimitGroup* journal_rate_limit_group_new(JournalRateLimit *r, const char *id, usec_t ts) {
         JournalRateLimitGroup *g;
-        struct siphash state;
 
         assert(r);
         assert(id);
 
+        if (hashmap_ensure_allocated(&r->groups, &string_hash_ops) < 0)
+                return NULL;
+
         g = new0(JournalRateLimitGroup, 1);
         if (!g)
                 return NULL;
@@ -158,17 +156,14 @@ static JournalRateLimitGroup* journal_rate_limit_group_new(JournalRateLimit *r,
         if (!g->id)
                 goto fail;
 
-        siphash24_init(&state, r->hash_key);
-        string_hash_func(g->id, &state);
-        g->hash = siphash24_finalize(&state);
-
         journal_rate_limit_vacuum(r, ts);
 
-        LIST_PREPEND(bucket, r->buckets[g->hash % BUCKETS_MAX], g);
+        if (hashmap_put(r->groups, g->id, g) < 0)
+                goto fail;
+
         LIST_PREPEND(lru, r->lru, g);
         if (!g->lru_next)
                 r->lru_tail = g;
-        r->n_groups++;
 
         g->parent = r;
         return g;
@@ -206,17 +201,15 @@ static unsigned burst_modulate(unsigned burst, uint64_t available) {
         return burst;
 }
 
-int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, uint64_t available) {
-        uint64_t h;
+int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, uint64_t available, usec_t ts) {
         JournalRateLimitGroup *g;
         JournalRateLimitPool *p;
-        struct siphash state;
         unsigned burst;
-        usec_t ts;
+        usec_t t;
 
         assert(id);
 
-        /* Returns:
+        /* Takes the current time in CLOCK_MONOTONIC. Returns:
          *
          * 0     → the log message shall be suppressed,
          * 1 + n → the log message shall be permitted, and n messages were dropped from the peer before
@@ -231,18 +224,17 @@ int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, u
 
         burst = burst_modulate(r->burst, available);
 
-        ts = now(CLOCK_MONOTONIC);
-
-        siphash24_init(&state, r->hash_key);
-        string_hash_func(id, &state);
-        h = siphash24_finalize(&state);
-        g = r->buckets[h % BUCKETS_MAX];
-
-        LIST_FOREACH(bucket, g, g)
-                if (streq(g->id, id))
-                        break;
-
-        if (!g) {
+        g = hashmap_get(r->groups, id);
+        if (g) {
+                /* Keep recently used groups at the front, so that vacuuming drops idle ones first */
+                if (r->lru != g) {
+                        if (r->lru_tail == g)
+                                r->lru_tail = g->lru_prev;
+
+                        LIST_REMOVE(lru, r->lru, g);
+                        LIST_PREPEND(lru, r->lru, g);
+                }
+        } else {
                 g = journal_rate_limit_group_new(r, id, ts);
                 if (!g)
                         return -ENOMEM;
@@ -250,29 +242,51 @@ int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, u
 
         p = &g->pools[priority_map[priority]];
 
-        if (p->begin <= 0) {
-                p->suppressed = 0;
-                p->num = 1;
-                p->begin = ts;
-                return 1;
+        /* Each message takes interval/burst worth of time out of the bucket, and we permit it as long as the bucket
+         * isn't drained more than a whole interval into the future, i.e. as long as at most 'burst' messages were seen
+         * in it. */
+        t = MAX(r->interval / burst, 1U);
+        if (p->tat < ts)
+                p->tat = ts;
+
+        if (p->tat + t > ts + r->interval) {
+                if (p->suppressed == 0)
+                        p->suppressed_begin = ts;
+
+                p->suppressed++;
+                p->n_suppressed++;
+                return 0;
         }
 
-        if (p->begin + r->interval < ts) {
+        p->tat += t;
+
+        /* Report suppressed messages at most once per interval, a bucket that is just about full lets single messages
+         * through regularly, and we don't want to generate a report for each of them. */
+        if (p->suppressed > 0 && p->suppressed_begin + r->interval <= ts) {
                 unsigned s;
 
                 s = p->suppressed;
                 p->suppressed = 0;
-                p->num = 1;
-                p->begin = ts;
 
                 return 1 + s;
         }
 
-        if (p->num < burst) {
-                p->num++;
-                return 1;
-        }
+        return 1;
+}
 
-        p->suppressed++;
-        return 0;
+void journal_rate_limit_dump(JournalRateLimit *r, FILE *f) {
+        JournalRateLimitGroup *g;
+        unsigned i;
+
+        assert(f);
+
+        if (!r)
+                return;
+
+        /* Lists the total number of dropped messages per group and priority, for the groups still tracked */
+        LIST_FOREACH(lru, g, r->lru)
+                for (i = 0; i < POOLS_MAX; i++)
+                        if (g->pools[i].n_suppressed > 0)
+                                fprintf(f, "%s %s %" PRIu64 " %u\n",
+                                        g->id, pool_name[i], g->pools[i].n_suppressed, g->pools[i].suppressed);
 }
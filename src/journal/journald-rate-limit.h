@@ -19,10 +19,13 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <stdio.h>
+
 #include "util.h"
 
 typedef struct JournalRateLimit JournalRateLimit;
 
 JournalRateLimit *journal_rate_limit_new(usec_t interval, unsigned burst);
 void journal_rate_limit_free(JournalRateLimit *r);
-int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, uint64_t available);
+int journal_rate_limit_test(JournalRateLimit *r, const char *id, int priority, uint64_t available, usec_t ts);
+void journal_rate_limit_dump(JournalRateLimit *r, FILE *f);
@@ -20,6 +20,7 @@
 #ifdef HAVE_SELINUX
 #include <selinux/selinux.h>
 #endif
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/signalfd.h>
@@ -83,6 +84,9 @@
 
 #define RECHECK_SPACE_USEC (30*USEC_PER_SEC)
 
+/* Where we tell the world which units are being rate limited */
+#define RATE_LIMITS_FILE "/run/systemd/journal/rate-limits"
+
 #define NOTIFY_SNDBUF_SIZE (8*1024*1024)
 
 /* The period to insert between posting changes for coalescing */
@@ -92,42 +96,63 @@
  * for a bit of additional metadata. */
 #define DEFAULT_LINE_MAX (48*1024)
 
-static int determine_path_usage(Server *s, const char *path, uint64_t *ret_used, uint64_t *ret_free) {
-        _cleanup_closedir_ DIR *d = NULL;
-        struct dirent *de;
-        struct statvfs ss;
+/* How many datagrams to pull off a socket per wakeup by default, and at most */
+#define DEFAULT_DATAGRAM_BATCH_SIZE 16U
+#define DATAGRAM_BATCH_SIZE_MAX 1024U
 
-        assert(ret_used);
-        assert(ret_free);
+/* The size of the receive buffer of each datagram slot except the first one, whose size we know exactly. This
+ * matches the send buffer size sd-journal clients request, which limits the datagrams they may send us. The
+ * buffers are mapped lazily by the kernel, hence only the pages actually written to take up memory. Whatever a
+ * datagram wrote beyond DATAGRAM_SLOT_KEEP is released again once it has been processed, so that a burst of
+ * large datagrams doesn't keep that much memory around in every slot. */
+#define DATAGRAM_SLOT_SIZE (8U*1024U*1024U)
+#define DATAGRAM_SLOT_KEEP (64U*1024U)
 
-        d = opendir(path);
-        if (!d)
-                return log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR,
-                                      errno, "Failed to open %s: %m", path);
+/* The payloads of the entries collected during a batch are copied into one buffer. If a burst made it grow beyond
+ * this, it is freed again once the batch has been written, rather than kept at its peak size. */
+#define PENDING_DATA_KEEP (256U*1024U)
 
-        if (fstatvfs(dirfd(d), &ss) < 0)
-                return log_error_errno(errno, "Failed to fstatvfs(%s): %m", path);
+static JournalVacuumCatalog *storage_get_vacuum_catalog(JournalStorage *storage) {
+        int r;
 
-        *ret_free = ss.f_bsize * ss.f_bavail;
-        *ret_used = 0;
-        FOREACH_DIRENT_ALL(de, d, break) {
-                struct stat st;
+        assert(storage);
 
-                if (!endswith(de->d_name, ".journal") &&
-                    !endswith(de->d_name, ".journal~"))
-                        continue;
+        /* The catalog watches the directory, hence neither determining the usage nor vacuuming need to look at
+         * all the files each time */
 
-                if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
-                        log_debug_errno(errno, "Failed to stat %s/%s, ignoring: %m", path, de->d_name);
-                        continue;
+        if (!storage->vacuum_catalog) {
+                r = journal_vacuum_catalog_new(&storage->vacuum_catalog, storage->path, true);
+                if (r < 0) {
+                        log_oom();
+                        return NULL;
                 }
+        }
 
-                if (!S_ISREG(st.st_mode))
-                        continue;
+        return storage->vacuum_catalog;
+}
 
-                *ret_used += (uint64_t) st.st_blocks * 512UL;
-        }
+static int determine_path_usage(Server *s, JournalStorage *storage, uint64_t *ret_used, uint64_t *ret_free) {
+        JournalVacuumCatalog *c;
+        struct statvfs ss;
+        int r;
 
+        assert(storage);
+        assert(ret_used);
+        assert(ret_free);
+
+        c = storage_get_vacuum_catalog(storage);
+        if (!c)
+                return -ENOMEM;
+
+        r = journal_vacuum_catalog_usage(c, ret_used);
+        if (r < 0)
+                return log_full_errno(r == -ENOENT ? LOG_DEBUG : LOG_ERR,
+                                      r, "Failed to open %s: %m", storage->path);
+
+        if (statvfs(storage->path, &ss) < 0)
+                return log_error_errno(errno, "Failed to statvfs(%s): %m", storage->path);
+
+        *ret_free = ss.f_bsize * ss.f_bavail;
         return 0;
 }
 
@@ -152,7 +177,7 @@ static int cache_space_refresh(Server *s, JournalStorage *storage) {
         if (space->timestamp != 0 && space->timestamp + RECHECK_SPACE_USEC > ts)
                 return 0;
 
-        r = determine_path_usage(s, storage->path, &vfs_used, &vfs_avail);
+        r = determine_path_usage(s, storage, &vfs_used, &vfs_avail);
         if (r < 0)
                 return r;
 
@@ -283,6 +308,9 @@ static int open_journal(
                 return r;
         }
 
+        /* Inherited by the files that replace this one when rotating */
+        f->offline_notify_fd = s->offline_notify_fd;
+
         *ret = f;
         return r;
 }
@@ -486,6 +514,15 @@ void server_rotate(Server *s) {
                         ordered_hashmap_remove(s->user_journals, k);
         }
 
+        server_vacuum_deferred_closes(s);
+}
+
+void server_vacuum_deferred_closes(Server *s) {
+        JournalFile *f;
+        Iterator i;
+
+        assert(s);
+
         /* Perform any deferred closes which aren't still offlining. */
         SET_FOREACH(f, s->deferred_closes, i)
                 if (!journal_file_is_offlining(f)) {
@@ -499,6 +536,10 @@ void server_sync(Server *s) {
         Iterator i;
         int r;
 
+        /* This doesn't wait for the data to hit the disk: the offline threads sync the files in the background,
+         * and only a thread that already finished is joined here. See journal_file_set_online() for what
+         * blocks when we write to the files again. */
+
         if (s->system_journal) {
                 r = journal_file_set_offline(s->system_journal, false);
                 if (r < 0)
@@ -521,7 +562,7 @@ void server_sync(Server *s) {
 }
 
 static void do_vacuum(Server *s, JournalStorage *storage, bool verbose) {
-
+        JournalVacuumCatalog *c;
         int r;
 
         assert(s);
@@ -532,9 +573,13 @@ static void do_vacuum(Server *s, JournalStorage *storage, bool verbose) {
         if (verbose)
                 server_space_usage_message(s, storage);
 
-        r = journal_directory_vacuum(storage->path, storage->space.limit,
-                                     storage->metrics.n_max_files, s->max_retention_usec,
-                                     &s->oldest_file_usec, verbose);
+        c = storage_get_vacuum_catalog(storage);
+        if (!c)
+                return;
+
+        r = journal_vacuum_catalog_vacuum(c, storage->space.limit,
+                                          storage->metrics.n_max_files, s->max_retention_usec,
+                                          &s->oldest_file_usec, verbose);
         if (r < 0 && r != -ENOENT)
                 log_warning_errno(r, "Failed to vacuum %s, ignoring: %m", storage->path);
 
@@ -645,22 +690,27 @@ static bool shall_try_append_again(JournalFile *f, int r) {
         }
 }
 
-static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, unsigned n, int priority) {
+static void write_entries_to_journal(Server *s, uid_t uid, JournalEntry *entries, unsigned n, int priority) {
         bool vacuumed = false, rotate = false;
         struct dual_timestamp ts;
+        unsigned i, n_appended = 0;
         JournalFile *f;
         int r;
 
         assert(s);
-        assert(iovec);
+        assert(entries);
         assert(n > 0);
 
         /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
          * the source time, and not even the time the event was originally seen, but instead simply the time we started
-         * processing it, as we want strictly linear ordering in what we write out.) */
+         * processing it, as we want strictly linear ordering in what we write out.) All entries of a batch are
+         * processed in the same event loop iteration, hence they share the timestamp. */
         assert_se(sd_event_now(s->event, CLOCK_REALTIME, &ts.realtime) >= 0);
         assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &ts.monotonic) >= 0);
 
+        for (i = 0; i < n; i++)
+                entries[i].ts = ts;
+
         if (ts.realtime < s->last_realtime_clock) {
                 /* When the time jumps backwards, let's immediately rotate. Of course, this should not happen during
                  * regular operation. However, when it does happen, then we should make sure that we start fresh files
@@ -693,14 +743,19 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, unsigned
 
         s->last_realtime_clock = ts.realtime;
 
-        r = journal_file_append_entry(f, &ts, iovec, n, &s->seqnum, NULL, NULL);
+        r = journal_file_append_entries(f, entries, n, &s->seqnum, &n_appended);
         if (r >= 0) {
                 server_schedule_sync(s, priority);
                 return;
         }
 
+        /* Whatever made it into the file before the failure stays there, only retry the rest */
+        entries += n_appended;
+        n -= n_appended;
+
         if (vacuumed || !shall_try_append_again(f, r)) {
-                log_error_errno(r, "Failed to write entry (%d items, %zu bytes), ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
+                log_error_errno(r, "Failed to write %u entries (first has %u items, %zu bytes), ignoring: %m",
+                                n, entries[0].n_iovec, IOVEC_TOTAL_SIZE(entries[0].iovec, entries[0].n_iovec));
                 return;
         }
 
@@ -712,13 +767,109 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, unsigned
                 return;
 
         log_debug("Retrying write.");
-        r = journal_file_append_entry(f, &ts, iovec, n, &s->seqnum, NULL, NULL);
+        r = journal_file_append_entries(f, entries, n, &s->seqnum, &n_appended);
         if (r < 0)
-                log_error_errno(r, "Failed to write entry (%d items, %zu bytes) despite vacuuming, ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
+                log_error_errno(r, "Failed to write %u entries (first has %u items, %zu bytes) despite vacuuming, ignoring: %m",
+                                n - n_appended, entries[n_appended].n_iovec,
+                                IOVEC_TOTAL_SIZE(entries[n_appended].iovec, entries[n_appended].n_iovec));
         else
                 server_schedule_sync(s, priority);
 }
 
+static void server_flush_pending(Server *s) {
+        PendingEntries *p;
+        size_t i, k;
+
+        assert(s);
+
+        p = &s->pending;
+
+        if (p->n_entries == 0)
+                return;
+
+        /* The data buffer might have been reallocated while we were collecting, hence resolve the offsets only now */
+        for (i = 0; i < p->n_iovec; i++)
+                p->iovec[i].iov_base = p->data + (size_t) p->iovec[i].iov_base;
+
+        for (i = 0, k = 0; i < p->n_entries; i++) {
+                p->entries[i].iovec = p->iovec + k;
+                k += p->entries[i].n_iovec;
+        }
+
+        write_entries_to_journal(s, p->uid, p->entries, p->n_entries, p->priority);
+
+        p->n_entries = p->n_iovec = p->data_size = 0;
+
+        if (p->data_allocated > PENDING_DATA_KEEP) {
+                p->data = mfree(p->data);
+                p->data_allocated = 0;
+        }
+}
+
+static int server_queue_pending(Server *s, uid_t uid, const struct iovec *iovec, unsigned n, int priority) {
+        PendingEntries *p;
+        unsigned i;
+
+        assert(s);
+        assert(iovec);
+        assert(n > 0);
+
+        p = &s->pending;
+
+        /* Entries for different files have to go out separately */
+        if (p->n_entries > 0 && p->uid != uid)
+                server_flush_pending(s);
+
+        if (!GREEDY_REALLOC(p->entries, p->n_entries_allocated, p->n_entries + 1))
+                return -ENOMEM;
+        if (!GREEDY_REALLOC(p->iovec, p->n_iovec_allocated, p->n_iovec + n))
+                return -ENOMEM;
+        if (!GREEDY_REALLOC(p->data, p->data_allocated, p->data_size + IOVEC_TOTAL_SIZE(iovec, n)))
+                return -ENOMEM;
+
+        for (i = 0; i < n; i++) {
+                p->iovec[p->n_iovec++] = (struct iovec) {
+                        .iov_base = (void*) p->data_size,
+                        .iov_len = iovec[i].iov_len,
+                };
+
+                memcpy_safe(p->data + p->data_size, iovec[i].iov_base, iovec[i].iov_len);
+                p->data_size += iovec[i].iov_len;
+        }
+
+        p->entries[p->n_entries++] = (JournalEntry) {
+                .n_iovec = n,
+        };
+
+        if (p->n_entries == 1 || priority < p->priority)
+                p->priority = priority;
+        p->uid = uid;
+
+        return 0;
+}
+
+static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, unsigned n, int priority) {
+        JournalEntry e = {
+                .iovec = iovec,
+                .n_iovec = n,
+        };
+
+        assert(s);
+        assert(iovec);
+        assert(n > 0);
+
+        /* While a batch of datagrams is processed, collect the entries and write them out together afterwards. If
+         * we can't queue the entry, write it out right away, after whatever we collected so far. */
+        if (s->batching) {
+                if (server_queue_pending(s, uid, iovec, n, priority) >= 0)
+                        return;
+
+                server_flush_pending(s);
+        }
+
+        write_entries_to_journal(s, uid, &e, 1, priority);
+}
+
 #define IOVEC_ADD_NUMERIC_FIELD(iovec, n, value, type, isset, format, field)  \
         if (isset(value)) {                                             \
                 char *k;                                                \
@@ -933,15 +1084,18 @@ void server_dispatch_message(
         if (c && c->unit) {
                 (void) determine_space(s, &available, NULL);
 
-                rl = journal_rate_limit_test(s->rate_limit, c->unit, priority & LOG_PRIMASK, available);
+                rl = journal_rate_limit_test(s->rate_limit, c->unit, priority & LOG_PRIMASK, available, now(CLOCK_MONOTONIC));
                 if (rl == 0)
                         return;
 
                 /* Write a suppression message if we suppressed something */
-                if (rl > 1)
+                if (rl > 1) {
                         server_driver_message(s, "MESSAGE_ID=" SD_MESSAGE_JOURNAL_DROPPED_STR,
                                               LOG_MESSAGE("Suppressed %u messages from %s", rl - 1, c->unit),
                                               NULL);
+
+                        (void) server_save_rate_limits(s);
+                }
         }
 
         dispatch_message_real(s, iovec, n, m, c, tv, priority, object_pid);
@@ -1047,77 +1201,57 @@ finish:
         return r;
 }
 
-int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
-        Server *s = userdata;
-        struct ucred *ucred = NULL;
-        struct timeval *tv = NULL;
-        struct cmsghdr *cmsg;
-        char *label = NULL;
-        size_t label_len = 0, m;
+/* We use NAME_MAX space for the SELinux label here. The kernel currently enforces no limit, but according to
+ * suggestions from the SELinux people this will change and it will probably be identical to NAME_MAX. For now we use
+ * that, but this should be updated one day when the final limit is known. */
+#define DATAGRAM_CONTROL_SIZE                           \
+        (CMSG_SPACE(sizeof(struct ucred)) +             \
+         CMSG_SPACE(sizeof(struct timeval)) +           \
+         CMSG_SPACE(sizeof(int)) + /* fd */             \
+         CMSG_SPACE(NAME_MAX)) /* selinux label */
+
+struct DatagramSlot {
+        char *buffer;
+        size_t buffer_size;
+
         struct iovec iovec;
-        ssize_t n;
-        int *fds = NULL, v = 0;
-        unsigned n_fds = 0;
+        union sockaddr_union sa;
 
         union {
                 struct cmsghdr cmsghdr;
+                uint8_t buf[DATAGRAM_CONTROL_SIZE];
+        } control;
 
-                /* We use NAME_MAX space for the SELinux label
-                 * here. The kernel currently enforces no
-                 * limit, but according to suggestions from
-                 * the SELinux people this will change and it
-                 * will probably be identical to NAME_MAX. For
-                 * now we use that, but this should be updated
-                 * one day when the final limit is known. */
-                uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
-                            CMSG_SPACE(sizeof(struct timeval)) +
-                            CMSG_SPACE(sizeof(int)) + /* fd */
-                            CMSG_SPACE(NAME_MAX)]; /* selinux label */
-        } control = {};
-
-        union sockaddr_union sa = {};
-
-        struct msghdr msghdr = {
-                .msg_iov = &iovec,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-                .msg_name = &sa,
-                .msg_namelen = sizeof(sa),
-        };
-
-        assert(s);
-        assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
+        ClientContext *context;
+};
 
-        if (revents != EPOLLIN) {
-                log_error("Got invalid event from epoll for datagram fd: %"PRIx32, revents);
-                return -EIO;
-        }
+static size_t datagram_buffer_size(int fd) {
+        int v = 0;
 
         /* Try to get the right size, if we can. (Not all sockets support SIOCINQ, hence we just try, but don't rely on
          * it.) */
         (void) ioctl(fd, SIOCINQ, &v);
 
         /* Fix it up, if it is too small. We use the same fixed value as auditd here. Awful! */
-        m = PAGE_ALIGN(MAX3((size_t) v + 1,
-                            (size_t) LINE_MAX,
-                            ALIGN(sizeof(struct nlmsghdr)) + ALIGN((size_t) MAX_AUDIT_MESSAGE_LENGTH)) + 1);
-
-        if (!GREEDY_REALLOC(s->buffer, s->buffer_size, m))
-                return log_oom();
-
-        iovec.iov_base = s->buffer;
-        iovec.iov_len = s->buffer_size - 1; /* Leave room for trailing NUL we add later */
+        return PAGE_ALIGN(MAX3((size_t) v + 1,
+                               (size_t) LINE_MAX,
+                               ALIGN(sizeof(struct nlmsghdr)) + ALIGN((size_t) MAX_AUDIT_MESSAGE_LENGTH)) + 1);
+}
 
-        n = recvmsg(fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
-        if (n < 0) {
-                if (IN_SET(errno, EINTR, EAGAIN))
-                        return 0;
+static void server_dispatch_datagram(Server *s, int fd, char *buffer, size_t n, struct msghdr *msghdr) {
+        struct ucred *ucred = NULL;
+        struct timeval *tv = NULL;
+        struct cmsghdr *cmsg;
+        char *label = NULL;
+        size_t label_len = 0;
+        int *fds = NULL;
+        unsigned n_fds = 0;
 
-                return log_error_errno(errno, "recvmsg() failed: %m");
-        }
+        assert(s);
+        assert(buffer);
+        assert(msghdr);
 
-        CMSG_FOREACH(cmsg, &msghdr) {
+        CMSG_FOREACH(cmsg, msghdr) {
 
                 if (cmsg->cmsg_level == SOL_SOCKET &&
                     cmsg->cmsg_type == SCM_CREDENTIALS &&
@@ -1139,17 +1273,17 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
         }
 
         /* And a trailing NUL, just in case */
-        s->buffer[n] = 0;
+        buffer[n] = 0;
 
         if (fd == s->syslog_fd) {
                 if (n > 0 && n_fds == 0)
-                        server_process_syslog_message(s, strstrip(s->buffer), ucred, tv, label, label_len);
+                        server_process_syslog_message(s, strstrip(buffer), ucred, tv, label, label_len);
                 else if (n_fds > 0)
                         log_warning("Got file descriptors via syslog socket. Ignoring.");
 
         } else if (fd == s->native_fd) {
                 if (n > 0 && n_fds == 0)
-                        server_process_native_message(s, s->buffer, n, ucred, tv, label, label_len);
+                        server_process_native_message(s, buffer, n, ucred, tv, label, label_len);
                 else if (n == 0 && n_fds == 1)
                         server_process_native_file(s, fds[0], ucred, tv, label, label_len);
                 else if (n_fds > 0)
@@ -1159,15 +1293,254 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
                 assert(fd == s->audit_fd);
 
                 if (n > 0 && n_fds == 0)
-                        server_process_audit_message(s, s->buffer, n, ucred, &sa, msghdr.msg_namelen);
+                        server_process_audit_message(s, buffer, n, ucred, msghdr->msg_name, msghdr->msg_namelen);
                 else if (n_fds > 0)
                         log_warning("Got file descriptors via audit socket. Ignoring.");
         }
 
         close_many(fds, n_fds);
+}
+
+static int server_process_datagram_one(Server *s, int fd) {
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[DATAGRAM_CONTROL_SIZE];
+        } control = {};
+        union sockaddr_union sa = {};
+        struct iovec iovec;
+        struct msghdr msghdr = {
+                .msg_iov = &iovec,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+                .msg_name = &sa,
+                .msg_namelen = sizeof(sa),
+        };
+        ssize_t n;
+
+        assert(s);
+
+        if (!GREEDY_REALLOC(s->buffer, s->buffer_size, datagram_buffer_size(fd)))
+                return log_oom();
+
+        iovec.iov_base = s->buffer;
+        iovec.iov_len = s->buffer_size - 1; /* Leave room for trailing NUL we add later */
+
+        n = recvmsg(fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+        if (n < 0) {
+                if (IN_SET(errno, EINTR, EAGAIN))
+                        return 0;
+
+                return log_error_errno(errno, "recvmsg() failed: %m");
+        }
+
+        server_dispatch_datagram(s, fd, s->buffer, n, &msghdr);
+        return 0;
+}
+
+static int datagram_slot_ensure_buffer(DatagramSlot *slot, size_t size) {
+        void *p;
+
+        assert(slot);
+
+        if (slot->buffer_size >= size)
+                return 0;
+
+        /* Map these buffers ourselves, so that we can hand the pages back with madvise() after use */
+        size = PAGE_ALIGN(size);
+        p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+                return -ENOMEM;
+
+        if (slot->buffer)
+                (void) munmap(slot->buffer, slot->buffer_size);
+
+        slot->buffer = p;
+        slot->buffer_size = size;
+        return 0;
+}
+
+static void datagram_slot_trim(DatagramSlot *slot, size_t n) {
+        size_t used;
+
+        assert(slot);
+
+        /* Drops the pages a large datagram was written to, including its trailing NUL, except for the first
+         * ones which are used all the time anyway. */
+
+        used = PAGE_ALIGN(MIN(n + 1, slot->buffer_size));
+        if (used <= DATAGRAM_SLOT_KEEP)
+                return;
+
+        (void) madvise(slot->buffer + DATAGRAM_SLOT_KEEP, used - DATAGRAM_SLOT_KEEP, MADV_DONTNEED);
+}
+
+static int server_ensure_datagram_slots(Server *s) {
+        DatagramSlot *slots;
+        struct mmsghdr *msgs;
+        unsigned n;
+
+        assert(s);
+
+        n = s->datagram_batch_size;
+        if (s->n_datagram_slots >= n)
+                return 0;
+
+        slots = realloc(s->datagram_slots, n * sizeof(DatagramSlot));
+        if (!slots)
+                return -ENOMEM;
+        s->datagram_slots = slots;
+
+        msgs = realloc(s->datagram_msgs, n * sizeof(struct mmsghdr));
+        if (!msgs)
+                return -ENOMEM;
+        s->datagram_msgs = msgs;
+
+        memzero(s->datagram_slots + s->n_datagram_slots, (n - s->n_datagram_slots) * sizeof(DatagramSlot));
+        s->n_datagram_slots = n;
+
+        return 0;
+}
+
+static void server_account_datagram_batch(Server *s, unsigned n) {
+        unsigned b;
+
+        assert(s);
+        assert(n > 0);
+
+        s->n_datagram_wakeups++;
+        s->n_datagrams += n;
+        s->datagram_batch_max = MAX(s->datagram_batch_max, n);
+
+        b = MIN(log2u(n), (unsigned) ELEMENTSOF(s->datagram_batch_histogram) - 1);
+        s->datagram_batch_histogram[b]++;
+
+        if (n > 1)
+                log_debug("Received %u datagrams in one go.", n);
+}
+
+static int server_process_datagram_batch(Server *s, int fd) {
+        unsigned i, n_batch;
+        int n, r;
+
+        assert(s);
+
+        r = server_ensure_datagram_slots(s);
+        if (r < 0)
+                return log_oom();
+
+        n_batch = s->datagram_batch_size;
+
+        for (i = 0; i < n_batch; i++) {
+                DatagramSlot *slot = s->datagram_slots + i;
+
+                /* We know the size of the first datagram exactly, make sure it always fits */
+                r = datagram_slot_ensure_buffer(slot, MAX(i == 0 ? datagram_buffer_size(fd) : 0, (size_t) DATAGRAM_SLOT_SIZE));
+                if (r < 0)
+                        return log_oom();
+
+                slot->iovec = (struct iovec) {
+                        .iov_base = slot->buffer,
+                        .iov_len = slot->buffer_size - 1, /* Leave room for trailing NUL we add later */
+                };
+
+                s->datagram_msgs[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &slot->iovec,
+                                .msg_iovlen = 1,
+                                .msg_control = &slot->control,
+                                .msg_controllen = sizeof(slot->control),
+                                .msg_name = &slot->sa,
+                                .msg_namelen = sizeof(slot->sa),
+                        },
+                };
+        }
+
+        n = recvmmsg(fd, s->datagram_msgs, n_batch, MSG_DONTWAIT|MSG_CMSG_CLOEXEC, NULL);
+        if (n < 0) {
+                if (IN_SET(errno, EINTR, EAGAIN))
+                        return 0;
+
+                return log_error_errno(errno, "recvmmsg() failed: %m");
+        }
+        if (n == 0)
+                return 0;
+
+        server_account_datagram_batch(s, n);
+
+        /* Resolve the senders' metadata once for the whole batch, and keep it pinned while we process it. Datagrams
+         * from the same client usually arrive in bursts, hence this saves us repeated lookups and refreshes. */
+        for (i = 0; i < (unsigned) n; i++) {
+                DatagramSlot *slot = s->datagram_slots + i;
+                struct ucred *ucred = NULL;
+                struct cmsghdr *cmsg;
+                char *label = NULL;
+                size_t label_len = 0;
+
+                slot->context = NULL;
+
+                if (fd == s->audit_fd)
+                        continue;
+
+                CMSG_FOREACH(cmsg, &s->datagram_msgs[i].msg_hdr) {
+                        if (cmsg->cmsg_level == SOL_SOCKET &&
+                            cmsg->cmsg_type == SCM_CREDENTIALS &&
+                            cmsg->cmsg_len == CMSG_LEN(sizeof(struct ucred)))
+                                ucred = (struct ucred*) CMSG_DATA(cmsg);
+                        else if (cmsg->cmsg_level == SOL_SOCKET &&
+                                 cmsg->cmsg_type == SCM_SECURITY) {
+                                label = (char*) CMSG_DATA(cmsg);
+                                label_len = cmsg->cmsg_len - CMSG_LEN(0);
+                        }
+                }
+
+                if (!ucred || !pid_is_valid(ucred->pid))
+                        continue;
+
+                if (i > 0 && s->datagram_slots[i-1].context && s->datagram_slots[i-1].context->pid == ucred->pid)
+                        continue;
+
+                (void) client_context_acquire(s, ucred->pid, ucred, label, label_len, NULL, &slot->context);
+        }
+
+        s->batching = true;
+
+        for (i = 0; i < (unsigned) n; i++) {
+                struct mmsghdr *msg = s->datagram_msgs + i;
+
+                if (msg->msg_hdr.msg_flags & MSG_TRUNC)
+                        log_warning("Datagram of more than %zu bytes received, truncating.", s->datagram_slots[i].iovec.iov_len);
+
+                server_dispatch_datagram(s, fd, s->datagram_slots[i].buffer, msg->msg_len, &msg->msg_hdr);
+                datagram_slot_trim(s->datagram_slots + i, msg->msg_len);
+        }
+
+        s->batching = false;
+        server_flush_pending(s);
+
+        for (i = 0; i < (unsigned) n; i++)
+                s->datagram_slots[i].context = client_context_release(s, s->datagram_slots[i].context);
+
         return 0;
 }
 
+int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+        assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
+
+        if (revents != EPOLLIN) {
+                log_error("Got invalid event from epoll for datagram fd: %"PRIx32, revents);
+                return -EIO;
+        }
+
+        if (s->datagram_batch_size <= 1)
+                return server_process_datagram_one(s, fd);
+
+        return server_process_datagram_batch(s, fd);
+}
+
 static int dispatch_sigusr1(sd_event_source *es, const struct signalfd_siginfo *si, void *userdata) {
         Server *s = userdata;
         int r;
@@ -1232,6 +1605,9 @@ static int dispatch_sigrtmin1(sd_event_source *es, const struct signalfd_siginfo
 
         server_sync(s);
 
+        /* Also bring the rate limit statistics up-to-date, so that they are current after "journalctl --sync" */
+        (void) server_save_rate_limits(s);
+
         /* Let clients know when the most recent sync happened. */
         r = write_timestamp_file_atomic("/run/systemd/journal/synced", now(CLOCK_MONOTONIC));
         if (r < 0)
@@ -1498,6 +1874,37 @@ static int server_open_hostname(Server *s) {
         return 0;
 }
 
+static int dispatch_offline_notify(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Server *s = userdata;
+        eventfd_t x;
+
+        assert(s);
+        assert(s->offline_notify_fd == fd);
+
+        /* An offline thread finished. Files rotated away are only waiting for that before they can be closed,
+         * don't keep them around until the next rotation. */
+        (void) eventfd_read(fd, &x);
+
+        server_vacuum_deferred_closes(s);
+        return 0;
+}
+
+static int server_open_offline_notify(Server *s) {
+        int r;
+
+        assert(s);
+
+        s->offline_notify_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (s->offline_notify_fd < 0)
+                return log_error_errno(errno, "Failed to create offline notification eventfd: %m");
+
+        r = sd_event_add_io(s->event, &s->offline_notify_event_source, s->offline_notify_fd, EPOLLIN, dispatch_offline_notify, s);
+        if (r < 0)
+                return log_error_errno(r, "Failed to register offline notification fd in event loop: %m");
+
+        return 0;
+}
+
 static int dispatch_notify_event(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         Server *s = userdata;
         int r;
@@ -1671,6 +2078,7 @@ int server_init(Server *s) {
 
         zero(*s);
         s->syslog_fd = s->native_fd = s->stdout_fd = s->dev_kmsg_fd = s->audit_fd = s->hostname_fd = s->notify_fd = -1;
+        s->offline_notify_fd = s->cgroup_inotify_fd = -1;
         s->compress = true;
         s->seal = true;
         s->read_kmsg = true;
@@ -1694,6 +2102,7 @@ int server_init(Server *s) {
         s->max_level_wall = LOG_EMERG;
 
         s->line_max = DEFAULT_LINE_MAX;
+        s->datagram_batch_size = DEFAULT_DATAGRAM_BATCH_SIZE;
 
         journal_reset_metrics(&s->system_storage.metrics);
         journal_reset_metrics(&s->runtime_storage.metrics);
@@ -1704,6 +2113,11 @@ int server_init(Server *s) {
         if (r < 0)
                 log_warning_errno(r, "Failed to parse kernel command line, ignoring: %m");
 
+        if (s->datagram_batch_size > DATAGRAM_BATCH_SIZE_MAX) {
+                log_debug("Limiting datagram batch size from %u to %u", s->datagram_batch_size, DATAGRAM_BATCH_SIZE_MAX);
+                s->datagram_batch_size = DATAGRAM_BATCH_SIZE_MAX;
+        }
+
         if (!!s->rate_limit_interval ^ !!s->rate_limit_burst) {
                 log_debug("Setting both rate limit interval and burst from "USEC_FMT",%u to 0,0",
                           s->rate_limit_interval, s->rate_limit_burst);
@@ -1832,6 +2246,10 @@ int server_init(Server *s) {
         if (r < 0)
                 return r;
 
+        r = server_open_offline_notify(s);
+        if (r < 0)
+                return r;
+
         r = setup_signals(s);
         if (r < 0)
                 return r;
@@ -1883,10 +2301,73 @@ void server_maybe_append_tags(Server *s) {
 #endif
 }
 
+int server_save_rate_limits(Server *s) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(s);
+
+        /* Writes out how many messages were dropped from which unit, separately for each priority pool, and how
+         * many of those haven't been reported in a "Suppressed" message yet. */
+
+        if (!s->rate_limit)
+                return 0;
+
+        r = fopen_temporary(RATE_LIMITS_FILE, &f, &temp_path);
+        if (r < 0)
+                goto fail;
+
+        (void) fchmod(fileno(f), 0644);
+
+        fputs("# UNIT PRIORITIES DROPPED UNREPORTED\n", f);
+        journal_rate_limit_dump(s->rate_limit, f);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, RATE_LIMITS_FILE) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        temp_path = mfree(temp_path);
+        return 0;
+
+fail:
+        if (temp_path)
+                (void) unlink(temp_path);
+
+        return log_warning_errno(r, "Failed to write " RATE_LIMITS_FILE ", ignoring: %m");
+}
+
+static void server_log_datagram_statistics(Server *s) {
+        unsigned i;
+
+        assert(s);
+
+        if (s->n_datagram_wakeups == 0)
+                return;
+
+        log_debug("Received %"PRIu64" datagrams in %"PRIu64" wakeups, at most %u at once.",
+                  s->n_datagrams, s->n_datagram_wakeups, s->datagram_batch_max);
+
+        for (i = 0; i < ELEMENTSOF(s->datagram_batch_histogram); i++)
+                if (s->datagram_batch_histogram[i] > 0)
+                        log_debug("%u%s datagrams per wakeup: %"PRIu64" times",
+                                  1U << i, i == ELEMENTSOF(s->datagram_batch_histogram) - 1 ? "+" : "",
+                                  s->datagram_batch_histogram[i]);
+}
+
 void server_done(Server *s) {
         JournalFile *f;
+        unsigned i;
+
         assert(s);
 
+        server_log_datagram_statistics(s);
+
         if (s->deferred_closes) {
                 journal_file_close_set(s->deferred_closes);
                 set_free(s->deferred_closes);
@@ -1922,6 +2403,7 @@ void server_done(Server *s) {
         sd_event_source_unref(s->hostname_event_source);
         sd_event_source_unref(s->notify_event_source);
         sd_event_source_unref(s->watchdog_event_source);
+        sd_event_source_unref(s->offline_notify_event_source);
         sd_event_unref(s->event);
 
         safe_close(s->syslog_fd);
@@ -1931,6 +2413,7 @@ void server_done(Server *s) {
         safe_close(s->audit_fd);
         safe_close(s->hostname_fd);
         safe_close(s->notify_fd);
+        safe_close(s->offline_notify_fd);
 
         if (s->rate_limit)
                 journal_rate_limit_free(s->rate_limit);
@@ -1939,15 +2422,31 @@ void server_done(Server *s) {
                 munmap(s->kernel_seqnum, sizeof(uint64_t));
 
         free(s->buffer);
+
+        for (i = 0; i < s->n_datagram_slots; i++)
+                if (s->datagram_slots[i].buffer)
+                        (void) munmap(s->datagram_slots[i].buffer, s->datagram_slots[i].buffer_size);
+        free(s->datagram_slots);
+        free(s->datagram_msgs);
+
+        free(s->pending.entries);
+        free(s->pending.iovec);
+        free(s->pending.data);
+
         free(s->tty_path);
+        free(s->forward_console_pending);
         free(s->cgroup_root);
         free(s->hostname_field);
+        journal_vacuum_catalog_free(s->runtime_storage.vacuum_catalog);
+        journal_vacuum_catalog_free(s->system_storage.vacuum_catalog);
+
         free(s->runtime_storage.path);
         free(s->system_storage.path);
 
         if (s->mmap)
                 mmap_cache_unref(s->mmap);
 
+        server_forget_dev_kmsg_device(s);
         udev_unref(s->udev);
 }
 
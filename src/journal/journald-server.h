@@ -28,11 +28,13 @@ typedef struct Server Server;
 
 #include "hashmap.h"
 #include "journal-file.h"
+#include "journal-vacuum.h"
 #include "journald-context.h"
 #include "journald-rate-limit.h"
 #include "journald-stream.h"
 #include "list.h"
 #include "prioq.h"
+#include "string-pool.h"
 
 typedef enum Storage {
         STORAGE_AUTO,
@@ -67,8 +69,27 @@ typedef struct JournalStorage {
 
         JournalMetrics metrics;
         JournalStorageSpace space;
+
+        JournalVacuumCatalog *vacuum_catalog;
 } JournalStorage;
 
+typedef struct DatagramSlot DatagramSlot;
+
+/* Entries collected while a batch of datagrams is processed, so that they can be written out in one go */
+typedef struct PendingEntries {
+        JournalEntry *entries;
+        size_t n_entries, n_entries_allocated;
+
+        struct iovec *iovec; /* iov_base is an offset into data until the entries are written */
+        size_t n_iovec, n_iovec_allocated;
+
+        char *data;
+        size_t data_size, data_allocated;
+
+        uid_t uid;
+        int priority;
+} PendingEntries;
+
 struct Server {
         int syslog_fd;
         int native_fd;
@@ -77,6 +98,7 @@ struct Server {
         int audit_fd;
         int hostname_fd;
         int notify_fd;
+        int offline_notify_fd;
 
         sd_event *event;
 
@@ -94,6 +116,7 @@ struct Server {
         sd_event_source *hostname_event_source;
         sd_event_source *notify_event_source;
         sd_event_source *watchdog_event_source;
+        sd_event_source *offline_notify_event_source;
 
         JournalFile *runtime_journal;
         JournalFile *system_journal;
@@ -124,6 +147,11 @@ struct Server {
         unsigned n_forward_syslog_missed;
         usec_t last_warn_forward_syslog_missed;
 
+        unsigned n_forward_console_missed;
+        usec_t last_warn_forward_console_missed;
+        char *forward_console_pending;
+        size_t forward_console_pending_size;
+
         uint64_t var_available_timestamp;
 
         usec_t max_retention_usec;
@@ -151,6 +179,10 @@ struct Server {
 
         struct udev *udev;
 
+        /* The device of the last kernel message carrying a device ID, reused while draining /dev/kmsg */
+        struct udev_device *dev_kmsg_device;
+        char *dev_kmsg_device_id;
+
         uint64_t *kernel_seqnum;
         bool dev_kmsg_readable:1;
 
@@ -171,10 +203,30 @@ struct Server {
 
         size_t line_max;
 
+        /* Batched datagram reception */
+        unsigned datagram_batch_size;
+        DatagramSlot *datagram_slots;
+        struct mmsghdr *datagram_msgs;
+        unsigned n_datagram_slots;
+        bool batching;
+        PendingEntries pending;
+
+        uint64_t n_datagram_wakeups;
+        uint64_t n_datagrams;
+        uint64_t datagram_batch_histogram[11]; /* log2 buckets of datagrams per wakeup */
+        unsigned datagram_batch_max;
+
         /* Caching of client metadata */
         Hashmap *client_contexts;
         Prioq *client_contexts_lru;
 
+        /* Caching of metadata derived from the cgroup, shared by all clients in it */
+        Hashmap *client_cgroups;
+        Hashmap *client_cgroups_by_wd;
+        StringPool *client_strings; /* cgroup paths, unit and slice names, shared by clients and cgroups */
+        int cgroup_inotify_fd;
+        sd_event_source *cgroup_inotify_event_source;
+
         ClientContext *my_context; /* the context of journald itself */
         ClientContext *pid1_context; /* the context of PID 1 */
 };
@@ -209,6 +261,8 @@ void server_done(Server *s);
 void server_sync(Server *s);
 int server_vacuum(Server *s, bool verbose);
 void server_rotate(Server *s);
+void server_vacuum_deferred_closes(Server *s);
+int server_save_rate_limits(Server *s);
 int server_schedule_sync(Server *s, int priority);
 int server_flush_to_var(Server *s, bool require_flag_file);
 void server_maybe_append_tags(Server *s);
@@ -52,6 +52,10 @@
 
 #define STDOUT_STREAMS_MAX 4096
 
+/* Streams that keep filling their buffer on every read() get it doubled up to this size (or LineMax=, if that's
+ * larger), so that a single wakeup picks up many lines at once */
+#define STDOUT_STREAM_BUFFER_MAX (64U*1024U)
+
 typedef enum StdoutStreamState {
         STDOUT_STREAM_IDENTIFIER,
         STDOUT_STREAM_UNIT_ID,
@@ -63,16 +67,6 @@ typedef enum StdoutStreamState {
         STDOUT_STREAM_RUNNING
 } StdoutStreamState;
 
-/* The different types of log record terminators: a real \n was read, a NUL character was read, the maximum line length
- * was reached, or the end of the stream was reached */
-
-typedef enum LineBreak {
-        LINE_BREAK_NEWLINE,
-        LINE_BREAK_NUL,
-        LINE_BREAK_LINE_MAX,
-        LINE_BREAK_EOF,
-} LineBreak;
-
 struct StdoutStream {
         Server *server;
         StdoutStreamState state;
@@ -91,6 +85,7 @@ struct StdoutStream {
 
         bool fdstore:1;
         bool in_notify_queue:1;
+        bool read_filled:1;
 
         char *buffer;
         size_t length;
@@ -327,7 +322,8 @@ static int stdout_stream_log(StdoutStream *s, const char *p, LineBreak line_brea
         return 0;
 }
 
-static int stdout_stream_line(StdoutStream *s, char *p, LineBreak line_break) {
+static int stdout_stream_line(char *p, LineBreak line_break, void *userdata) {
+        StdoutStream *s = userdata;
         int r;
         char *orig;
 
@@ -431,64 +427,99 @@ static int stdout_stream_line(StdoutStream *s, char *p, LineBreak line_break) {
         assert_not_reached("Unknown stream state");
 }
 
-static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
-        char *p;
-        size_t remaining;
+int stream_scan_lines(
+                char *buffer,
+                size_t length,
+                size_t line_max,
+                bool force_flush,
+                stream_line_callback_t callback,
+                void *userdata,
+                size_t *ret_consumed) {
+
+        char *p, *e, *end = NULL;
         int r;
 
-        assert(s);
+        assert(buffer);
+        assert(line_max > 0);
+        assert(callback);
+        assert(ret_consumed);
 
-        p = s->buffer;
-        remaining = s->length;
+        /* Splits the buffer into lines and passes each to the callback. The buffer needs to have room for one more
+         * byte after 'length'. Returns the number of bytes consumed, what's left is an incomplete line. */
 
-        /* XXX: This function does nothing if (s->length == 0) */
+        p = buffer;
+        e = buffer + length;
 
-        for (;;) {
+        /* With the buffer terminated a single strchrnul() pass finds the next \n or NUL, whichever comes first. libc
+         * vectorizes that just like memchr(), hence we don't need to scan for the two separately. */
+        *e = 0;
+
+        while (p < e) {
                 LineBreak line_break;
-                size_t skip;
-                char *end1, *end2;
 
-                end1 = memchr(p, '\n', remaining);
-                end2 = memchr(p, 0, end1 ? (size_t) (end1 - p) : remaining);
+                /* After splitting an overly long line we know there's no terminator before 'end', don't look again */
+                if (!end || end < p)
+                        end = strchrnul(p, '\n');
 
-                if (end2) {
-                        /* We found a NUL terminator */
-                        skip = end2 - p + 1;
-                        line_break = LINE_BREAK_NUL;
-                } else if (end1) {
-                        /* We found a \n terminator */
-                        *end1 = 0;
-                        skip = end1 - p + 1;
+                if ((size_t) (end - p) > line_max ||
+                    (end == e && (size_t) (end - p) >= line_max)) {
+                        char c;
+
+                        /* Force a line break after the maximum line length. The callback needs a NUL terminated
+                         * string, hence temporarily steal the first byte of what follows. */
+                        c = p[line_max];
+                        p[line_max] = 0;
+                        r = callback(p, LINE_BREAK_LINE_MAX, userdata);
+                        p[line_max] = c;
+                        if (r < 0)
+                                return r;
+
+                        p += line_max;
+                        continue;
+                }
+
+                if (end == e)
+                        break;
+
+                if (*end == '\n') {
+                        *end = 0;
                         line_break = LINE_BREAK_NEWLINE;
-                } else if (remaining >= s->server->line_max) {
-                        /* Force a line break after the maximum line length */
-                        *(p + s->server->line_max) = 0;
-                        skip = remaining;
-                        line_break = LINE_BREAK_LINE_MAX;
                 } else
-                        break;
+                        line_break = LINE_BREAK_NUL;
 
-                r = stdout_stream_line(s, p, line_break);
+                r = callback(p, line_break, userdata);
                 if (r < 0)
                         return r;
 
-                remaining -= skip;
-                p += skip;
+                p = end + 1;
         }
 
-        if (force_flush && remaining > 0) {
-                p[remaining] = 0;
-                r = stdout_stream_line(s, p, LINE_BREAK_EOF);
+        if (force_flush && p < e) {
+                r = callback(p, LINE_BREAK_EOF, userdata);
                 if (r < 0)
                         return r;
 
-                p += remaining;
-                remaining = 0;
+                p = e;
         }
 
-        if (p > s->buffer) {
-                memmove(s->buffer, p, remaining);
-                s->length = remaining;
+        *ret_consumed = p - buffer;
+        return 0;
+}
+
+static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
+        size_t consumed;
+        int r;
+
+        assert(s);
+        assert(s->buffer);
+
+        r = stream_scan_lines(s->buffer, s->length, s->server->line_max, force_flush, stdout_stream_line, s, &consumed);
+        if (r < 0)
+                return r;
+
+        if (consumed > 0) {
+                memmove(s->buffer, s->buffer + consumed, s->length - consumed);
+                s->length -= consumed;
         }
 
         return 0;
@@ -496,7 +527,7 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
 
 static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         StdoutStream *s = userdata;
-        size_t limit;
+        size_t limit, max_size;
         ssize_t l;
         int r;
 
@@ -507,17 +538,25 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
                 goto terminate;
         }
 
-        /* If the buffer is full already (discounting the extra NUL we need), add room for another 1K */
+        max_size = MAX(s->server->line_max, STDOUT_STREAM_BUFFER_MAX);
+
+        /* If the buffer is full already (discounting the extra NUL we need), add room for another 1K. If the last
+         * read() filled it completely the client writes faster than we read, double it then. */
         if (s->length + 1 >= s->allocated) {
                 if (!GREEDY_REALLOC(s->buffer, s->allocated, s->length + 1 + 1024)) {
                         log_oom();
                         goto terminate;
                 }
+        } else if (s->read_filled && s->allocated - 1 < max_size) {
+                if (!GREEDY_REALLOC(s->buffer, s->allocated, s->allocated + 1)) {
+                        log_oom();
+                        goto terminate;
+                }
         }
 
-        /* Try to make use of the allocated buffer in full, but never read more than the configured line size. Also,
-         * always leave room for a terminating NUL we might need to add. */
-        limit = MIN(s->allocated - 1, s->server->line_max);
+        /* Try to make use of the allocated buffer in full, but never buffer more than the larger of the configured line
+         * size and the maximum buffer size. Also, always leave room for a terminating NUL we need to add. */
+        limit = MIN(s->allocated - 1, max_size);
 
         l = read(s->fd, s->buffer + s->length, limit - s->length);
         if (l < 0) {
@@ -533,11 +572,18 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
                 goto terminate;
         }
 
+        s->read_filled = s->length + l >= limit;
         s->length += l;
         r = stdout_stream_scan(s, false);
         if (r < 0)
                 goto terminate;
 
+        /* The burst is over and nothing is left in the buffer, give back the memory a big buffer takes */
+        if (s->length == 0 && (size_t) l < (s->allocated - 1) / 4 && s->allocated > 4 * 1024) {
+                s->buffer = mfree(s->buffer);
+                s->allocated = 0;
+        }
+
         return 1;
 
 terminate:
@@ -24,8 +24,22 @@ typedef struct StdoutStream StdoutStream;
 #include "fdset.h"
 #include "journald-server.h"
 
+/* The different types of log record terminators: a real \n was read, a NUL character was read, the maximum line length
+ * was reached, or the end of the stream was reached */
+
+typedef enum LineBreak {
+        LINE_BREAK_NEWLINE,
+        LINE_BREAK_NUL,
+        LINE_BREAK_LINE_MAX,
+        LINE_BREAK_EOF,
+} LineBreak;
+
+typedef int (*stream_line_callback_t)(char *p, LineBreak line_break, void *userdata);
+
 int server_open_stdout_socket(Server *s);
 int server_restore_streams(Server *s, FDSet *fds);
 
 void stdout_stream_free(StdoutStream *s);
 void stdout_stream_send_notify(StdoutStream *s);
+
+int stream_scan_lines(char *buffer, size_t length, size_t line_max, bool force_flush, stream_line_callback_t callback, void *userdata, size_t *ret_consumed);
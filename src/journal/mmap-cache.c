@@ -40,12 +40,17 @@ struct Window {
         bool invalidated:1;
         bool keep_always:1;
         bool in_unused:1;
+        bool indexed:1;
 
         int prot;
         void *ptr;
         uint64_t offset;
         size_t size;
 
+        /* The start of the slot this window was created for, with the log2 of the slot size in the lowest
+         * bits, see window_slot_key() */
+        uint64_t slot_key;
+
         MMapFileDescriptor *fd;
 
         LIST_FIELDS(Window, by_fd);
@@ -67,17 +72,26 @@ struct MMapFileDescriptor {
         int fd;
         bool sigbus;
         LIST_HEAD(Window, windows);
+
+        /* slot key → Window */
+        Hashmap *windows_by_slot;
 };
 
 struct MMapCache {
         int n_ref;
         unsigned n_windows;
 
-        unsigned n_hit, n_missed;
+        unsigned n_context_hit, n_window_hit, n_missed, n_evicted;
 
         Hashmap *fds;
         Context *contexts[MMAP_CACHE_MAX_CONTEXTS];
 
+        /* The log2 of the window size to use for each context, and a mask of all of them */
+        unsigned window_size_class[MMAP_CACHE_MAX_CONTEXTS];
+        uint64_t window_size_classes;
+
+        bool sequential;
+
         LIST_HEAD(Window, unused);
         Window *last_unused;
 };
@@ -93,12 +107,18 @@ struct MMapCache {
 
 MMapCache* mmap_cache_new(void) {
         MMapCache *m;
+        unsigned i;
 
         m = new0(MMapCache, 1);
         if (!m)
                 return NULL;
 
         m->n_ref = 1;
+
+        for (i = 0; i < MMAP_CACHE_MAX_CONTEXTS; i++)
+                m->window_size_class[i] = u64log2(WINDOW_SIZE);
+        m->window_size_classes = UINT64_C(1) << u64log2(WINDOW_SIZE);
+
         return m;
 }
 
@@ -118,8 +138,12 @@ static void window_unlink(Window *w) {
         if (w->ptr)
                 munmap(w->ptr, w->size);
 
-        if (w->fd)
+        if (w->fd) {
+                if (w->indexed)
+                        hashmap_remove_value(w->fd->windows_by_slot, &w->slot_key, w);
+
                 LIST_REMOVE(by_fd, w->fd->windows, w);
+        }
 
         if (w->in_unused) {
                 if (w->cache->last_unused == w)
@@ -177,7 +201,33 @@ _pure_ static bool window_matches_fd(Window *w, MMapFileDescriptor *f, int prot,
                 window_matches(w, prot, offset, size);
 }
 
-static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool keep_always, uint64_t offset, size_t size, void *ptr) {
+static inline uint64_t window_slot_key(uint64_t offset, unsigned size_class) {
+        /* Windows are placed at offsets that are multiples of their size. Slots are at least a page large,
+         * hence the lowest bits of their start are always zero and we can store their size there. */
+        return (offset & ~((UINT64_C(1) << size_class) - 1)) | size_class;
+}
+
+static void window_index(MMapFileDescriptor *f, Window *w) {
+        Window *old;
+
+        assert(f);
+        assert(w);
+
+        /* If this fails, the window is merely not found by find_mmap(), which is not fatal. */
+        if (hashmap_ensure_allocated(&f->windows_by_slot, &uint64_hash_ops) < 0)
+                return;
+
+        /* A window created earlier for the same slot might have been clamped to the file size at that time,
+         * or have different protection flags. It remains valid for the contexts still using it. */
+        old = hashmap_get(f->windows_by_slot, &w->slot_key);
+        if (old)
+                old->indexed = false;
+
+        if (hashmap_replace(f->windows_by_slot, &w->slot_key, w) >= 0)
+                w->indexed = true;
+}
+
+static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool keep_always, uint64_t slot_key, uint64_t offset, size_t size, void *ptr) {
         Window *w;
 
         assert(m);
@@ -196,6 +246,7 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
                 w = m->last_unused;
                 window_unlink(w);
                 zero(*w);
+                m->n_evicted++;
         }
 
         w->cache = m;
@@ -205,8 +256,10 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
         w->offset = offset;
         w->size = size;
         w->ptr = ptr;
+        w->slot_key = slot_key;
 
         LIST_PREPEND(by_fd, f->windows, w);
+        window_index(f, w);
 
         return w;
 }
@@ -334,6 +387,7 @@ static int make_room(MMapCache *m) {
                 return 0;
 
         window_free(m->last_unused);
+        m->n_evicted++;
         return 1;
 }
 
@@ -395,6 +449,8 @@ static int find_mmap(
                 void **ret,
                 size_t *ret_size) {
 
+        uint64_t classes;
+        unsigned size_class;
         Window *w;
         Context *c;
 
@@ -406,12 +462,25 @@ static int find_mmap(
         if (f->sigbus)
                 return -EIO;
 
-        LIST_FOREACH(by_fd, w, f->windows)
-                if (window_matches(w, prot, offset, size))
+        /* Look up the slot the offset falls into for each window size in use, starting with the one of
+         * this context, as that's the most likely one. */
+        size_class = m->window_size_class[context];
+        classes = m->window_size_classes & ~(UINT64_C(1) << size_class);
+
+        for (;;) {
+                uint64_t key;
+
+                key = window_slot_key(offset, size_class);
+                w = hashmap_get(f->windows_by_slot, &key);
+                if (w && window_matches(w, prot, offset, size))
                         break;
 
-        if (!w)
-                return 0;
+                if (classes == 0)
+                        return 0;
+
+                size_class = u64log2(classes);
+                classes &= ~(UINT64_C(1) << size_class);
+        }
 
         c = context_add(m, context);
         if (!c)
@@ -466,7 +535,8 @@ static int add_mmap(
                 void **ret,
                 size_t *ret_size) {
 
-        uint64_t woffset, wsize;
+        uint64_t woffset, wsize, slot_size;
+        unsigned size_class;
         Context *c;
         Window *w;
         void *d;
@@ -478,22 +548,13 @@ static int add_mmap(
         assert(size > 0);
         assert(ret);
 
-        woffset = offset & ~((uint64_t) page_size() - 1ULL);
-        wsize = size + (offset - woffset);
-        wsize = PAGE_ALIGN(wsize);
-
-        if (wsize < WINDOW_SIZE) {
-                uint64_t delta;
-
-                delta = PAGE_ALIGN((WINDOW_SIZE - wsize) / 2);
+        /* Map the slot the offset falls into, or multiple consecutive ones if the object crosses the end of
+         * the slot */
+        size_class = m->window_size_class[context];
+        slot_size = UINT64_C(1) << size_class;
 
-                if (delta > offset)
-                        woffset = 0;
-                else
-                        woffset -= delta;
-
-                wsize = WINDOW_SIZE;
-        }
+        woffset = offset & ~(slot_size - 1);
+        wsize = ALIGN_TO(offset + size - woffset, slot_size);
 
         if (st) {
                 /* Memory maps that are larger then the files
@@ -511,11 +572,18 @@ static int add_mmap(
         if (r < 0)
                 return r;
 
+        if (m->sequential) {
+                /* Start reading in the whole window right away, and let the kernel read ahead aggressively
+                 * on faults, rather than blocking on every single page. */
+                (void) madvise(d, wsize, MADV_SEQUENTIAL);
+                (void) madvise(d, wsize, MADV_WILLNEED);
+        }
+
         c = context_add(m, context);
         if (!c)
                 goto outofmem;
 
-        w = window_add(m, f, prot, keep_always, woffset, wsize, d);
+        w = window_add(m, f, prot, keep_always, window_slot_key(woffset, size_class), woffset, wsize, d);
         if (!w)
                 goto outofmem;
 
@@ -556,14 +624,14 @@ int mmap_cache_get(
         /* Check whether the current context is the right one already */
         r = try_context(m, f, prot, context, keep_always, offset, size, ret, ret_size);
         if (r != 0) {
-                m->n_hit++;
+                m->n_context_hit++;
                 return r;
         }
 
         /* Search for a matching mmap */
         r = find_mmap(m, f, prot, context, keep_always, offset, size, ret, ret_size);
         if (r != 0) {
-                m->n_hit++;
+                m->n_window_hit++;
                 return r;
         }
 
@@ -573,10 +641,37 @@ int mmap_cache_get(
         return add_mmap(m, f, prot, context, keep_always, offset, size, st, ret, ret_size);
 }
 
+int mmap_cache_set_window_size(MMapCache *m, unsigned context, uint64_t size) {
+        assert(m);
+        assert(context < MMAP_CACHE_MAX_CONTEXTS);
+
+        /* Windows need to be page aligned, and we place them at multiples of their size */
+        if (size < page_size() || (size & (size - 1)) != 0)
+                return -EINVAL;
+
+        m->window_size_class[context] = u64log2(size);
+        m->window_size_classes |= size;
+
+        return 0;
+}
+
+void mmap_cache_set_sequential(MMapCache *m, bool b) {
+        assert(m);
+
+        /* Only affects windows mapped from now on */
+        m->sequential = b;
+}
+
 unsigned mmap_cache_get_hit(MMapCache *m) {
         assert(m);
 
-        return m->n_hit;
+        return m->n_context_hit + m->n_window_hit;
+}
+
+unsigned mmap_cache_get_context_hit(MMapCache *m) {
+        assert(m);
+
+        return m->n_context_hit;
 }
 
 unsigned mmap_cache_get_missed(MMapCache *m) {
@@ -585,6 +680,18 @@ unsigned mmap_cache_get_missed(MMapCache *m) {
         return m->n_missed;
 }
 
+unsigned mmap_cache_get_evicted(MMapCache *m) {
+        assert(m);
+
+        return m->n_evicted;
+}
+
+unsigned mmap_cache_get_n_windows(MMapCache *m) {
+        assert(m);
+
+        return m->n_windows;
+}
+
 static void mmap_cache_process_sigbus(MMapCache *m) {
         bool found = false;
         MMapFileDescriptor *f;
@@ -699,6 +806,8 @@ void mmap_cache_free_fd(MMapCache *m, MMapFileDescriptor *f) {
         while (f->windows)
                 window_free(f->windows);
 
+        hashmap_free(f->windows_by_slot);
+
         if (f->cache)
                 assert_se(hashmap_remove(f->cache->fds, FD_TO_PTR(f->fd)));
 
@@ -23,7 +23,7 @@
 #include <sys/stat.h>
 
 /* One context per object type, plus one of the header, plus one "additional" one */
-#define MMAP_CACHE_MAX_CONTEXTS 9
+#define MMAP_CACHE_MAX_CONTEXTS 12
 
 typedef struct MMapCache MMapCache;
 typedef struct MMapFileDescriptor MMapFileDescriptor;
@@ -46,7 +46,13 @@ int mmap_cache_get(
 MMapFileDescriptor * mmap_cache_add_fd(MMapCache *m, int fd);
 void mmap_cache_free_fd(MMapCache *m, MMapFileDescriptor *f);
 
+int mmap_cache_set_window_size(MMapCache *m, unsigned context, uint64_t size);
+void mmap_cache_set_sequential(MMapCache *m, bool b);
+
 unsigned mmap_cache_get_hit(MMapCache *m);
+unsigned mmap_cache_get_context_hit(MMapCache *m);
 unsigned mmap_cache_get_missed(MMapCache *m);
+unsigned mmap_cache_get_evicted(MMapCache *m);
+unsigned mmap_cache_get_n_windows(MMapCache *m);
 
 bool mmap_cache_got_sigbus(MMapCache *m, MMapFileDescriptor *f);
@@ -122,6 +122,7 @@ static void detach_location(sd_journal *j) {
 
         j->current_file = NULL;
         j->current_field = 0;
+        j->files_prioq_valid = false;
 
         ORDERED_HASHMAP_FOREACH(f, j->files, i)
                 journal_file_reset_location(f);
@@ -688,6 +689,46 @@ static int find_location_for_match(
         }
 }
 
+static bool match_may_be_in_file(JournalFile *f, Match *m) {
+        Match *i;
+
+        assert(f);
+        assert(m);
+
+        /* Consults the file's data bloom filter, if it has one, to figure out whether the match can be
+         * fulfilled at all, so that we can avoid looking into the data hash table. Errors are treated as
+         * "maybe", the real lookup will report them. */
+
+        if (m->type == MATCH_DISCRETE) {
+                const char *eq;
+
+                eq = memchr(m->data, '=', m->size);
+                assert(eq);
+
+                return journal_file_data_bloom_test(f, m->data, eq - m->data, le64toh(m->le_hash)) != 0;
+
+        } else if (m->type == MATCH_OR_TERM) {
+
+                LIST_FOREACH(matches, i, m->matches)
+                        if (match_may_be_in_file(f, i))
+                                return true;
+
+                return false;
+
+        } else {
+                assert(m->type == MATCH_AND_TERM);
+
+                if (!m->matches)
+                        return false;
+
+                LIST_FOREACH(matches, i, m->matches)
+                        if (!match_may_be_in_file(f, i))
+                                return false;
+
+                return true;
+        }
+}
+
 static int find_location_with_matches(
                 sd_journal *j,
                 JournalFile *f,
@@ -702,6 +743,21 @@ static int find_location_with_matches(
         assert(ret);
         assert(offset);
 
+        /* If the file shares the sequence number space of the location, the header tells us whether it has any
+         * entries beyond it at all. This saves us from bisecting files that are entirely on the wrong side, for
+         * example all the older files when moving forward from one boot to the next. */
+        if (IN_SET(j->current_location.type, LOCATION_DISCRETE, LOCATION_SEEK) &&
+            j->current_location.seqnum_set &&
+            sd_id128_equal(j->current_location.seqnum_id, f->header->seqnum_id)) {
+
+                if (direction == DIRECTION_DOWN &&
+                    le64toh(f->header->tail_entry_seqnum) < j->current_location.seqnum)
+                        return 0;
+                if (direction == DIRECTION_UP &&
+                    le64toh(f->header->head_entry_seqnum) > j->current_location.seqnum)
+                        return 0;
+        }
+
         if (!j->level0) {
                 /* No matches is simple */
 
@@ -720,8 +776,12 @@ static int find_location_with_matches(
                         return journal_file_move_to_entry_by_realtime(f, j->current_location.realtime, direction, ret, offset);
 
                 return journal_file_next_entry(f, 0, direction, ret, offset);
-        } else
+        } else {
+                if (!match_may_be_in_file(f, j->level0))
+                        return 0;
+
                 return find_location_for_match(j, j->level0, f, direction, ret, offset);
+        }
 }
 
 static int next_with_matches(
@@ -817,52 +877,131 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         }
 }
 
-static int real_journal_next(sd_journal *j, direction_t direction) {
-        JournalFile *f, *new_file = NULL;
+static int compare_files_prioq(const void *a, const void *b) {
+        JournalFile *x = (JournalFile*) a, *y = (JournalFile*) b;
+        int k;
+
+        assert(x->last_direction == y->last_direction);
+
+        k = journal_file_compare_locations(x, y);
+
+        return x->last_direction == DIRECTION_DOWN ? k : -k;
+}
+
+static int update_files_prioq(sd_journal *j, JournalFile *f, direction_t direction) {
+        int r;
+
+        assert(j);
+        assert(f);
+
+        r = next_beyond_location(j, f, direction);
+        if (r < 0) {
+                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                remove_file_real(j, f);
+                return 0;
+        } else if (r == 0) {
+                prioq_remove(j->files_prioq, f, &f->prioq_idx);
+                f->prioq_idx = PRIOQ_IDX_NULL;
+                f->location_type = LOCATION_TAIL;
+                return 0;
+        }
+
+        if (f->prioq_idx == PRIOQ_IDX_NULL)
+                r = prioq_put(j->files_prioq, f, &f->prioq_idx);
+        else
+                r = prioq_reshuffle(j->files_prioq, f, &f->prioq_idx);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+static int rebuild_files_prioq(sd_journal *j, direction_t direction) {
+        JournalFile *f;
         Iterator i;
+        int r;
+
+        assert(j);
+
+        j->files_prioq = prioq_free(j->files_prioq);
+        ORDERED_HASHMAP_FOREACH(f, j->files, i)
+                f->prioq_idx = PRIOQ_IDX_NULL;
+
+        r = prioq_ensure_allocated(&j->files_prioq, compare_files_prioq);
+        if (r < 0)
+                return r;
+
+        j->files_prioq_direction = direction;
+        j->files_prioq_valid = true;
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
+                r = update_files_prioq(j, f, direction);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int real_journal_next(sd_journal *j, direction_t direction) {
+        JournalFile *new_file;
         Object *o;
         int r;
 
         assert_return(j, -EINVAL);
         assert_return(!journal_pid_changed(j), -ECHILD);
 
-        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
-                bool found;
-
-                r = next_beyond_location(j, f, direction);
-                if (r < 0) {
-                        log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
-                        remove_file_real(j, f);
-                        continue;
-                } else if (r == 0) {
-                        f->location_type = LOCATION_TAIL;
-                        continue;
-                }
+        /* All files with an entry beyond the current location are kept in a priority queue, ordered by that
+         * entry. If nothing but our own iteration moved the location since the last call, only the file we
+         * returned the previous entry from needs to be advanced and put back into the queue. Otherwise,
+         * the queue is rebuilt from scratch by looking at every file. */
 
-                if (!new_file)
-                        found = true;
-                else {
-                        int k;
+        if (!j->files_prioq_valid || j->files_prioq_direction != direction)
+                r = rebuild_files_prioq(j, direction);
+        else if (j->current_file)
+                r = update_files_prioq(j, j->current_file, direction);
+        else
+                r = 0;
+        if (r < 0)
+                goto fail;
 
-                        k = journal_file_compare_locations(f, new_file);
+        for (;;) {
+                uint64_t p;
 
-                        found = direction == DIRECTION_DOWN ? k < 0 : k > 0;
+                new_file = prioq_peek(j->files_prioq);
+                if (!new_file) {
+                        /* Look at all files again next time, in case entries were appended to files that
+                         * hit EOF before. */
+                        j->files_prioq_valid = false;
+                        return 0;
                 }
 
-                if (found)
-                        new_file = f;
+                /* The candidate entry might have been picked relative to an older location. Make sure it is
+                 * still beyond the current one, which also skips entries that exist in more than one
+                 * file. */
+                p = new_file->current_offset;
+
+                r = update_files_prioq(j, new_file, direction);
+                if (r < 0)
+                        goto fail;
+                if (r > 0 && new_file->current_offset == p)
+                        break;
         }
 
-        if (!new_file)
-                return 0;
+        prioq_remove(j->files_prioq, new_file, &new_file->prioq_idx);
+        new_file->prioq_idx = PRIOQ_IDX_NULL;
 
         r = journal_file_move_to_object(new_file, OBJECT_ENTRY, new_file->current_offset, &o);
         if (r < 0)
-                return r;
+                goto fail;
 
         set_location(j, new_file, o);
 
         return 1;
+
+fail:
+        j->files_prioq_valid = false;
+        return r;
 }
 
 _public_ int sd_journal_next(sd_journal *j) {
@@ -1296,6 +1435,9 @@ static int add_any_file(sd_journal *j, int fd, const char *path) {
 
         /* journal_file_dump(f); */
 
+        f->prioq_idx = PRIOQ_IDX_NULL;
+        f->sequential = !!(j->flags & SD_JOURNAL_SEQUENTIAL);
+
         r = ordered_hashmap_put(j->files, f->path, f);
         if (r < 0) {
                 f->close_fd = close_fd;
@@ -1313,6 +1455,7 @@ static int add_any_file(sd_journal *j, int fd, const char *path) {
         check_network(j, f->fd);
 
         j->current_invalidate_counter++;
+        j->files_prioq_valid = false;
 
         return 0;
 
@@ -1363,6 +1506,11 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
 
         ordered_hashmap_remove(j->files, f->path);
 
+        /* An invalid queue may refer to files whose location was reset, don't touch it, it's going to be
+         * rebuilt anyway. */
+        if (j->files_prioq_valid)
+                prioq_remove(j->files_prioq, f, &f->prioq_idx);
+
         log_debug("File %s removed.", f->path);
 
         if (j->current_file == f) {
@@ -1740,6 +1888,9 @@ static sd_journal *journal_new(int flags, const char *path) {
         if (!j->files || !j->directories_by_path || !j->mmap)
                 goto fail;
 
+        if (flags & SD_JOURNAL_SEQUENTIAL)
+                mmap_cache_set_sequential(j->mmap, true);
+
         return j;
 
 fail:
@@ -1750,7 +1901,8 @@ fail:
 #define OPEN_ALLOWED_FLAGS                              \
         (SD_JOURNAL_LOCAL_ONLY |                        \
          SD_JOURNAL_RUNTIME_ONLY |                      \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER)
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_SEQUENTIAL)
 
 _public_ int sd_journal_open(sd_journal **ret, int flags) {
         sd_journal *j;
@@ -1777,7 +1929,8 @@ fail:
 }
 
 #define OPEN_CONTAINER_ALLOWED_FLAGS                    \
-        (SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM)
+        (SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM |    \
+         SD_JOURNAL_SEQUENTIAL)
 
 _public_ int sd_journal_open_container(sd_journal **ret, const char *machine, int flags) {
         _cleanup_free_ char *root = NULL, *class = NULL;
@@ -1823,7 +1976,8 @@ fail:
 
 #define OPEN_DIRECTORY_ALLOWED_FLAGS                    \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_SEQUENTIAL)
 
 _public_ int sd_journal_open_directory(sd_journal **ret, const char *path, int flags) {
         sd_journal *j;
@@ -1852,13 +2006,16 @@ fail:
         return r;
 }
 
+#define OPEN_FILES_ALLOWED_FLAGS                        \
+        (SD_JOURNAL_SEQUENTIAL)
+
 _public_ int sd_journal_open_files(sd_journal **ret, const char **paths, int flags) {
         sd_journal *j;
         const char **path;
         int r;
 
         assert_return(ret, -EINVAL);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~OPEN_FILES_ALLOWED_FLAGS) == 0, -EINVAL);
 
         j = journal_new(flags, NULL);
         if (!j)
@@ -1882,7 +2039,8 @@ fail:
 
 #define OPEN_DIRECTORY_FD_ALLOWED_FLAGS         \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_SEQUENTIAL)
 
 _public_ int sd_journal_open_directory_fd(sd_journal **ret, int fd, int flags) {
         sd_journal *j;
@@ -1929,7 +2087,7 @@ _public_ int sd_journal_open_files_fd(sd_journal **ret, int fds[], unsigned n_fd
 
         assert_return(ret, -EINVAL);
         assert_return(n_fds > 0, -EBADF);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~OPEN_FILES_ALLOWED_FLAGS) == 0, -EINVAL);
 
         j = journal_new(flags, NULL);
         if (!j)
@@ -1988,6 +2146,7 @@ _public_ void sd_journal_close(sd_journal *j) {
                 (void) journal_file_close(f);
 
         ordered_hashmap_free(j->files);
+        prioq_free(j->files_prioq);
 
         while ((d = hashmap_first(j->directories_by_path)))
                 remove_directory(j, d);
@@ -2001,7 +2160,10 @@ _public_ void sd_journal_close(sd_journal *j) {
         safe_close(j->inotify_fd);
 
         if (j->mmap) {
-                log_debug("mmap cache statistics: %u hit, %u miss", mmap_cache_get_hit(j->mmap), mmap_cache_get_missed(j->mmap));
+                log_debug("mmap cache statistics: %u hit (%u by context), %u miss, %u evicted, %u windows",
+                          mmap_cache_get_hit(j->mmap), mmap_cache_get_context_hit(j->mmap),
+                          mmap_cache_get_missed(j->mmap), mmap_cache_get_evicted(j->mmap),
+                          mmap_cache_get_n_windows(j->mmap));
                 mmap_cache_unref(j->mmap);
         }
 
@@ -2012,7 +2174,9 @@ _public_ void sd_journal_close(sd_journal *j) {
         free(j->path);
         free(j->prefix);
         free(j->unique_field);
+        set_free_free(j->unique_hashes);
         free(j->fields_buffer);
+        strv_free(j->data_fields);
         free(j);
 }
 
@@ -2152,8 +2316,8 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                 compression = o->object.flags & OBJECT_COMPRESSION_MASK;
                 if (compression) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
-                        r = decompress_startswith(compression,
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
+                        r = decompress_startswith(compression, journal_file_compress_dictionary(f),
                                                   o->data.payload, l,
                                                   &f->compress_buffer, &f->compress_buffer_size,
                                                   field, field_length, '=');
@@ -2164,7 +2328,7 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                                 size_t rsize;
 
-                                r = decompress_blob(compression,
+                                r = decompress_blob(compression, journal_file_compress_dictionary(f),
                                                     o->data.payload, l,
                                                     &f->compress_buffer, &f->compress_buffer_size, &rsize,
                                                     j->data_threshold);
@@ -2216,11 +2380,11 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
 
         compression = o->object.flags & OBJECT_COMPRESSION_MASK;
         if (compression) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
                 size_t rsize;
                 int r;
 
-                r = decompress_blob(compression,
+                r = decompress_blob(compression, journal_file_compress_dictionary(f),
                                     o->data.payload, l, &f->compress_buffer,
                                     &f->compress_buffer_size, &rsize, j->data_threshold);
                 if (r < 0)
@@ -2239,6 +2403,54 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
         return 0;
 }
 
+static int data_object_wanted(sd_journal *j, JournalFile *f, Object *o) {
+        const uint8_t *payload;
+        uint64_t l;
+        int compression;
+        char **field;
+
+        if (!j->data_fields)
+                return 1;
+
+        l = le64toh(o->object.size) - offsetof(Object, data.payload);
+        compression = o->object.flags & OBJECT_COMPRESSION_MASK;
+
+        if (compression) {
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
+                size_t rsize;
+                int r;
+
+                /* Only decompress as much as is needed to look at the longest field name, and do so once for
+                 * all fields */
+                r = decompress_prefix(compression, journal_file_compress_dictionary(f),
+                                      o->data.payload, l,
+                                      &f->compress_buffer, &f->compress_buffer_size,
+                                      j->data_fields_max + 1, &rsize);
+                if (r < 0)
+                        return r;
+
+                payload = f->compress_buffer;
+                l = rsize;
+#else
+                return -EPROTONOSUPPORT;
+#endif
+        } else
+                payload = o->data.payload;
+
+        STRV_FOREACH(field, j->data_fields) {
+                size_t field_length;
+
+                field_length = strlen(*field);
+
+                if (l >= field_length+1 &&
+                    memcmp(payload, *field, field_length) == 0 &&
+                    payload[field_length] == '=')
+                        return 1;
+        }
+
+        return 0;
+}
+
 _public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size) {
         JournalFile *f;
         uint64_t p, n;
@@ -2258,22 +2470,32 @@ _public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t
         if (f->current_offset <= 0)
                 return -EADDRNOTAVAIL;
 
-        r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
-        if (r < 0)
-                return r;
+        for (;;) {
+                r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
+                if (r < 0)
+                        return r;
 
-        n = journal_file_entry_n_items(o);
-        if (j->current_field >= n)
-                return 0;
+                n = journal_file_entry_n_items(o);
+                if (j->current_field >= n)
+                        return 0;
 
-        p = le64toh(o->entry.items[j->current_field].object_offset);
-        le_hash = o->entry.items[j->current_field].hash;
-        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
-        if (r < 0)
-                return r;
+                p = le64toh(o->entry.items[j->current_field].object_offset);
+                le_hash = o->entry.items[j->current_field].hash;
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        return r;
 
-        if (le_hash != o->data.hash)
-                return -EBADMSG;
+                if (le_hash != o->data.hash)
+                        return -EBADMSG;
+
+                r = data_object_wanted(j, f, o);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        break;
+
+                j->current_field++;
+        }
 
         r = return_data(j, f, o, data, size);
         if (r < 0)
@@ -2444,6 +2666,9 @@ _public_ int sd_journal_process(sd_journal *j) {
 
                 got_something = true;
 
+                /* Files might have grown, make sure the next iteration step looks at all of them */
+                j->files_prioq_valid = false;
+
                 FOREACH_INOTIFY_EVENT(e, buffer, l)
                         process_inotify_event(j, e);
         }
@@ -2590,6 +2815,20 @@ void journal_print_header(sd_journal *j) {
 
                 journal_file_print_header(f);
         }
+
+        if (j->mmap) {
+                if (newline)
+                        putchar('\n');
+
+                printf("MMap cache hits: %u (%u by context)\n"
+                       "MMap cache misses: %u\n"
+                       "MMap cache evictions: %u\n"
+                       "MMap cache windows: %u\n",
+                       mmap_cache_get_hit(j->mmap), mmap_cache_get_context_hit(j->mmap),
+                       mmap_cache_get_missed(j->mmap),
+                       mmap_cache_get_evicted(j->mmap),
+                       mmap_cache_get_n_windows(j->mmap));
+        }
 }
 
 _public_ int sd_journal_get_usage(sd_journal *j, uint64_t *bytes) {
@@ -2655,6 +2894,8 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                         return 0;
 
                 j->unique_offset = 0;
+                set_free_free(j->unique_hashes);
+                j->unique_hashes = NULL;
         }
 
         for (;;) {
@@ -2663,7 +2904,7 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                 Object *o;
                 const void *odata;
                 size_t ol;
-                bool found;
+                uint64_t h;
                 int r;
 
                 /* Proceed to next data object in the field's linked list */
@@ -2725,28 +2966,50 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                 }
 
                 /* OK, now let's see if we already returned this data
-                 * object by checking if it exists in the earlier
-                 * traversed files. */
-                found = false;
-                ORDERED_HASHMAP_FOREACH(of, j->files, i) {
-                        if (of == j->unique_file)
-                                break;
+                 * object. We remember the hashes of everything seen so
+                 * far, if the hash is new, so is the data object, and we
+                 * don't have to look it up in every earlier traversed
+                 * file, which gets expensive with many files. Only if the
+                 * hash is known we check if it exists in the earlier
+                 * traversed files, in order to deal with collisions. */
+                h = le64toh(o->data.hash);
+                if (set_contains(j->unique_hashes, &h)) {
+                        bool found = false;
+
+                        ORDERED_HASHMAP_FOREACH(of, j->files, i) {
+                                if (of == j->unique_file)
+                                        break;
 
-                        /* Skip this file it didn't have any fields indexed */
-                        if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
+                                /* Skip this file it didn't have any fields indexed */
+                                if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
+                                        continue;
+
+                                r = journal_file_find_data_object_with_hash(of, odata, ol, h, NULL, NULL);
+                                if (r < 0)
+                                        return r;
+                                if (r > 0) {
+                                        found = true;
+                                        break;
+                                }
+                        }
+
+                        if (found)
                                 continue;
+                } else {
+                        uint64_t *hh;
 
-                        r = journal_file_find_data_object_with_hash(of, odata, ol, le64toh(o->data.hash), NULL, NULL);
+                        r = set_ensure_allocated(&j->unique_hashes, &uint64_hash_ops);
                         if (r < 0)
                                 return r;
-                        if (r > 0) {
-                                found = true;
-                                break;
-                        }
-                }
 
-                if (found)
-                        continue;
+                        hh = newdup(uint64_t, &h, 1);
+                        if (!hh)
+                                return -ENOMEM;
+
+                        r = set_consume(j->unique_hashes, hh);
+                        if (r < 0)
+                                return r;
+                }
 
                 r = return_data(j, j->unique_file, o, data, l);
                 if (r < 0)
@@ -2998,6 +3261,39 @@ _public_ int sd_journal_get_data_threshold(sd_journal *j, size_t *sz) {
         return 0;
 }
 
+_public_ int sd_journal_set_data_fields(sd_journal *j, char **fields) {
+        char **i, **l;
+
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        STRV_FOREACH(i, fields)
+                if (!field_is_valid(*i))
+                        return -EINVAL;
+
+        if (strv_isempty(fields)) {
+                j->data_fields = strv_free(j->data_fields);
+                return 0;
+        }
+
+        /* Callers tend to set this once per entry, make that cheap */
+        if (strv_equal(j->data_fields, fields))
+                return 0;
+
+        l = strv_copy(fields);
+        if (!l)
+                return -ENOMEM;
+
+        strv_free(j->data_fields);
+        j->data_fields = l;
+
+        j->data_fields_max = 0;
+        STRV_FOREACH(i, l)
+                j->data_fields_max = MAX(j->data_fields_max, strlen(*i));
+
+        return 0;
+}
+
 _public_ int sd_journal_has_runtime_files(sd_journal *j) {
         assert_return(j, -EINVAL);
 
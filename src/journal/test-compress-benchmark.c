@@ -23,6 +23,7 @@
 #include "macro.h"
 #include "parse-util.h"
 #include "random-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "util.h"
 
@@ -31,7 +32,7 @@ typedef int (compress_t)(const void *src, uint64_t src_size, void *dst,
 typedef int (decompress_t)(const void *src, uint64_t src_size,
                            void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
 
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
 
 static usec_t arg_duration;
 static size_t arg_start;
@@ -39,6 +40,10 @@ static size_t arg_start;
 #define MAX_SIZE (1024*1024LU)
 #define PRIME 1048571  /* A prime close enough to one megabyte that mod 4 == 3 */
 
+/* Messages [0, N_TRAINING_MESSAGES) are used to train the dictionary, the benchmark uses the ones after that */
+#define N_MESSAGES 20000U
+#define N_TRAINING_MESSAGES 5000U
+
 static size_t _permute(size_t x) {
         size_t residue;
 
@@ -56,6 +61,21 @@ static size_t permute(size_t x) {
         return _permute((_permute(x) + arg_start) % MAX_SIZE ^ 0xFF345);
 }
 
+/* Something that looks like the structured payloads services log */
+static size_t make_message(char *buf, size_t n, unsigned i) {
+        static const char* const levels[] = { "debug", "info", "notice", "warning", "error" };
+        int k;
+
+        k = snprintf(buf, n,
+                     "MESSAGE={\"level\":\"%s\",\"unit\":\"worker-%u.service\",\"request_id\":\"%08x-%04x\","
+                     "\"method\":\"%s\",\"path\":\"/api/v1/items/%u\",\"status\":%u,\"duration_ms\":%u}",
+                     levels[i % ELEMENTSOF(levels)], i % 13, i * 2654435761U, i % 65536,
+                     i % 3 ? "GET" : "POST", i % 1000, i % 11 ? 200 : 500, i % 997);
+        assert_se(k > 0 && (size_t) k < n);
+
+        return k;
+}
+
 static char* make_buf(size_t count, const char *type) {
         char *buf;
         size_t i;
@@ -81,6 +101,17 @@ static char* make_buf(size_t count, const char *type) {
                 memzero(buf + 7*step, step);
                 random_bytes(buf + 8*step, step);
                 memzero(buf + 9*step, step);
+        } else if (streq(type, "messages")) {
+                char line[LINE_MAX];
+                unsigned k;
+
+                for (i = 0, k = 0; i < count; k++) {
+                        size_t l;
+
+                        l = MIN(make_message(line, sizeof(line), k), count - i);
+                        memcpy(buf + i, line, l);
+                        i += l;
+                }
         } else
                 assert_not_reached("here");
 
@@ -154,10 +185,99 @@ static void test_compress_decompress(const char* label, const char* type,
                  100 - compressed * 100. / total,
                  skipped);
 }
+
+static void test_compress_decompress_messages(const char* label, compress_t compress, decompress_t decompress) {
+        _cleanup_free_ void *buf2 = NULL;
+        size_t buf2_allocated = 0, compressed = 0, total = 0;
+        char text[LINE_MAX], buf[LINE_MAX];
+        unsigned i, n_messages = 0, n_compressed = 0;
+        usec_t n, n2 = 0;
+        float dt;
+
+        /* Compresses many short messages one by one, the way DATA objects are compressed. Messages that
+         * don't shrink are stored as they are, hence count them with their full size. */
+
+        n = now(CLOCK_MONOTONIC);
+
+        for (i = N_TRAINING_MESSAGES; i < N_MESSAGES; i++) {
+                size_t j = 0, k = 0, size;
+                int r;
+
+                size = make_message(text, sizeof(text), i);
+
+                r = compress(text, size, buf, size - 1, &j);
+                if (r < 0) {
+                        assert_se(r == -ENOBUFS);
+                        compressed += size;
+                } else {
+                        r = decompress(buf, j, &buf2, &buf2_allocated, &k, 0);
+                        assert_se(r == 0);
+                        assert_se(k == size);
+                        assert_se(memcmp(text, buf2, size) == 0);
+
+                        compressed += j;
+                        n_compressed++;
+                }
+
+                total += size;
+                n_messages++;
+
+                n2 = now(CLOCK_MONOTONIC);
+                if (n2 - n > arg_duration)
+                        break;
+        }
+
+        dt = (n2-n) / 1e6;
+
+        log_info("%s/single messages: compressed & decompressed %zu bytes in %.2fs (%.2fMiB/s), "
+                 "mean compresion %.2f%%, %u of %u messages compressed",
+                 label, total, dt,
+                 total / 1024. / 1024 / dt,
+                 100 - compressed * 100. / total,
+                 n_compressed, n_messages);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static CompressDictionary *arg_dictionary = NULL;
+
+static int compress_blob_zstd_dictionary(const void *src, uint64_t src_size,
+                                         void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        return compress_blob_zstd_with_dictionary(arg_dictionary, src, src_size, dst, dst_alloc_size, dst_size);
+}
+
+static int decompress_blob_zstd_dictionary(const void *src, uint64_t src_size,
+                                           void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_zstd_with_dictionary(arg_dictionary, src, src_size, dst, dst_alloc_size, dst_size, dst_max);
+}
+
+static void train_dictionary(void) {
+        _cleanup_free_ char *samples = NULL;
+        _cleanup_free_ void *dict = NULL;
+        size_t sizes[N_TRAINING_MESSAGES];
+        size_t total = 0, dict_size = 0;
+        unsigned i;
+        usec_t n;
+
+        samples = new(char, N_TRAINING_MESSAGES * LINE_MAX);
+        assert_se(samples);
+
+        for (i = 0; i < N_TRAINING_MESSAGES; i++) {
+                sizes[i] = make_message(samples + total, LINE_MAX, i);
+                total += sizes[i];
+        }
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(compress_dictionary_train(samples, sizes, N_TRAINING_MESSAGES, 16*1024, &dict, &dict_size) == 0);
+        assert_se(compress_dictionary_new(dict, dict_size, &arg_dictionary) == 0);
+
+        log_info("Trained %zu byte dictionary on %zu bytes of messages in %.2fs",
+                 dict_size, total, (now(CLOCK_MONOTONIC) - n) / 1e6);
+}
 #endif
 
 int main(int argc, char *argv[]) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
         const char *i;
         int r;
 
@@ -182,14 +302,32 @@ int main(int argc, char *argv[]) {
         else
                 arg_start = getpid_cached();
 
-        NULSTR_FOREACH(i, "zeros\0simple\0random\0") {
+        NULSTR_FOREACH(i, "zeros\0simple\0random\0messages\0") {
 #ifdef HAVE_XZ
                 test_compress_decompress("XZ", i, compress_blob_xz, decompress_blob_xz);
 #endif
 #ifdef HAVE_LZ4
                 test_compress_decompress("LZ4", i, compress_blob_lz4, decompress_blob_lz4);
+#endif
+#ifdef HAVE_ZSTD
+                test_compress_decompress("ZSTD", i, compress_blob_zstd, decompress_blob_zstd);
 #endif
         }
+
+#ifdef HAVE_XZ
+        test_compress_decompress_messages("XZ", compress_blob_xz, decompress_blob_xz);
+#endif
+#ifdef HAVE_LZ4
+        test_compress_decompress_messages("LZ4", compress_blob_lz4, decompress_blob_lz4);
+#endif
+#ifdef HAVE_ZSTD
+        test_compress_decompress_messages("ZSTD", compress_blob_zstd, decompress_blob_zstd);
+
+        train_dictionary();
+        test_compress_decompress_messages("ZSTD+dictionary", compress_blob_zstd_dictionary, decompress_blob_zstd_dictionary);
+        arg_dictionary = compress_dictionary_free(arg_dictionary);
+#endif
+
         return 0;
 #else
         return EXIT_TEST_SKIP;
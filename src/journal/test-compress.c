@@ -27,6 +27,7 @@
 #include "fileio.h"
 #include "macro.h"
 #include "random-util.h"
+#include "stdio-util.h"
 #include "util.h"
 
 #ifdef HAVE_XZ
@@ -51,10 +52,10 @@ typedef int (decompress_sw_t)(const void *src, uint64_t src_size,
                               const void *prefix, size_t prefix_len,
                               uint8_t extra);
 
-typedef int (compress_stream_t)(int fdf, int fdt, uint64_t max_bytes);
+typedef int (compress_stream_t)(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size);
 typedef int (decompress_stream_t)(int fdf, int fdt, uint64_t max_size);
 
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
 static void test_compress_decompress(int compression,
                                      compress_blob_t compress,
                                      decompress_blob_t decompress,
@@ -158,6 +159,8 @@ static void test_compress_stream(int compression,
         int r;
         _cleanup_free_ char *cmd = NULL, *cmd2;
         struct stat st = {};
+        uint64_t uncompressed_size;
+        _cleanup_close_pair_ int pipefd[2] = { -1, -1 };
 
         log_debug("/* testing %s compression */",
                   object_compressed_to_string(compression));
@@ -170,7 +173,7 @@ static void test_compress_stream(int compression,
 
         assert_se((dst = mkostemp_safe(pattern)) >= 0);
 
-        assert_se(compress(src, dst, -1) == 0);
+        assert_se(compress(src, dst, -1, &uncompressed_size) == 0);
 
         if (cat) {
                 assert_se(asprintf(&cmd, "%s %s | diff %s -", cat, pattern, srcfile) > 0);
@@ -182,6 +185,7 @@ static void test_compress_stream(int compression,
         assert_se((dst2 = mkostemp_safe(pattern2)) >= 0);
 
         assert_se(stat(srcfile, &st) == 0);
+        assert_se(uncompressed_size == (uint64_t) st.st_size);
 
         assert_se(lseek(dst, 0, SEEK_SET) == 0);
         r = decompress(dst, dst2, st.st_size);
@@ -201,6 +205,17 @@ static void test_compress_stream(int compression,
         r = decompress(dst, dst2, st.st_size - 1);
         assert_se(r == -EFBIG);
 
+        log_debug("/* test compression from a pipe, with a limit */");
+
+        assert_se(pipe2(pipefd, O_CLOEXEC) == 0);
+        assert_se(write(pipefd[1], "foobarfoobar", 12) == 12);
+        pipefd[1] = safe_close(pipefd[1]);
+
+        assert_se(ftruncate(dst, 0) == 0);
+        assert_se(lseek(dst, 0, SEEK_SET) == 0);
+        assert_se(compress(pipefd[0], dst, 6, &uncompressed_size) == 0);
+        assert_se(uncompressed_size == 6);
+
         assert_se(unlink(pattern) == 0);
         assert_se(unlink(pattern2) == 0);
 }
@@ -248,8 +263,70 @@ static void test_lz4_decompress_partial(void) {
 }
 #endif
 
+#ifdef HAVE_ZSTD
+static void test_zstd_dictionary(void) {
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        _cleanup_free_ char *samples = NULL, *decompressed = NULL;
+        _cleanup_free_ void *dict = NULL;
+        size_t sizes[1000], total = 0, dict_size = 0, csize, csize_plain, usize = 0, rsize;
+        char text[LINE_MAX], compressed[LINE_MAX];
+        unsigned i;
+
+        log_info("/* testing zstd dictionary compression */");
+
+        samples = new(char, ELEMENTSOF(sizes) * LINE_MAX);
+        assert_se(samples);
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                sizes[i] = snprintf(samples + total, LINE_MAX,
+                                    "MESSAGE={\"unit\":\"foo-%u.service\",\"request\":%u,\"status\":%u}",
+                                    i % 17, i * 7919, 200 + i % 5);
+                total += sizes[i];
+        }
+
+        assert_se(compress_dictionary_train(samples, sizes, ELEMENTSOF(sizes), 4096, &dict, &dict_size) == 0);
+        assert_se(dict_size > 0 && dict_size <= 4096);
+
+        assert_se(compress_dictionary_new("garbage", 7, &d) == -EBADMSG);
+        assert_se(compress_dictionary_new(dict, dict_size, &d) == 0);
+
+        xsprintf(text, "MESSAGE={\"unit\":\"foo-%u.service\",\"request\":%u,\"status\":%u}", 4, 4242, 201);
+
+        assert_se(compress_blob_zstd(text, strlen(text), compressed, sizeof(compressed), &csize_plain) == 0);
+        assert_se(compress_blob_zstd_with_dictionary(d, text, strlen(text), compressed, sizeof(compressed), &csize) == 0);
+        log_info("%zu bytes compressed to %zu bytes without and %zu bytes with dictionary",
+                 strlen(text), csize_plain, csize);
+        assert_se(csize < csize_plain);
+        assert_se(csize < strlen(text));
+
+        assert_se(decompress_blob_zstd_with_dictionary(d, compressed, csize,
+                                                       (void **) &decompressed, &usize, &rsize, 0) == 0);
+        assert_se(rsize == strlen(text));
+        assert_se(memcmp(decompressed, text, rsize) == 0);
+
+        assert_se(decompress_startswith_zstd_with_dictionary(d, compressed, csize,
+                                                             (void **) &decompressed, &usize,
+                                                             "MESSAGE", 7, '=') > 0);
+        assert_se(decompress_startswith_zstd_with_dictionary(d, compressed, csize,
+                                                             (void **) &decompressed, &usize,
+                                                             "MESSAGE", 7, 'x') == 0);
+
+        /* The frame references a dictionary we don't have */
+        assert_se(decompress_blob_zstd(compressed, csize, (void **) &decompressed, &usize, &rsize, 0) == -EBADMSG);
+        assert_se(decompress_startswith_zstd(compressed, csize, (void **) &decompressed, &usize,
+                                             "MESSAGE", 7, '=') == -EBADMSG);
+
+        /* ... and frames without a dictionary don't need one */
+        assert_se(compress_blob_zstd(text, strlen(text), compressed, sizeof(compressed), &csize) == 0);
+        assert_se(decompress_blob(OBJECT_COMPRESSED_ZSTD, d, compressed, csize,
+                                  (void **) &decompressed, &usize, &rsize, 0) == 0);
+        assert_se(rsize == strlen(text));
+        assert_se(memcmp(decompressed, text, rsize) == 0);
+}
+#endif
+
 int main(int argc, char *argv[]) {
-#if defined(HAVE_XZ) || defined(HAVE_LZ4)
+#if defined(HAVE_XZ) || defined(HAVE_LZ4) || defined(HAVE_ZSTD)
         const char text[] =
                 "text\0foofoofoofoo AAAA aaaaaaaaa ghost busters barbarbar FFF"
                 "foofoofoofoo AAAA aaaaaaaaa ghost busters barbarbar FFF";
@@ -314,6 +391,27 @@ int main(int argc, char *argv[]) {
         log_info("/* LZ4 test skipped */");
 #endif
 
+#ifdef HAVE_ZSTD
+        test_compress_decompress(OBJECT_COMPRESSED_ZSTD, compress_blob_zstd, decompress_blob_zstd,
+                                 text, sizeof(text), false);
+        test_compress_decompress(OBJECT_COMPRESSED_ZSTD, compress_blob_zstd, decompress_blob_zstd,
+                                 data, sizeof(data), true);
+
+        test_decompress_startswith(OBJECT_COMPRESSED_ZSTD,
+                                   compress_blob_zstd, decompress_startswith_zstd,
+                                   text, sizeof(text), false);
+        test_decompress_startswith(OBJECT_COMPRESSED_ZSTD,
+                                   compress_blob_zstd, decompress_startswith_zstd,
+                                   data, sizeof(data), true);
+        test_decompress_startswith(OBJECT_COMPRESSED_ZSTD,
+                                   compress_blob_zstd, decompress_startswith_zstd,
+                                   huge, sizeof(huge), true);
+
+        test_zstd_dictionary();
+#else
+        log_info("/* ZSTD test skipped */");
+#endif
+
         return 0;
 #else
         return EXIT_TEST_SKIP;
@@ -0,0 +1,145 @@
+/***
+  This file is part of systemd
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "log.h"
+#include "macro.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "util.h"
+
+/* Compares the append throughput of plain and sealed journal files. Sealing requires a key for this machine, as
+ * generated with "journalctl --setup-keys", if there is none only the plain variants are measured. */
+
+typedef struct Context {
+        const char *directory;
+        bool compress;
+        bool seal;
+} Context;
+
+static JournalFile *append_open(const Context *c) {
+        _cleanup_free_ char *path = NULL;
+        JournalFile *f;
+
+        assert_se(path = strjoin(c->directory, "/bench.journal"));
+        assert_se(journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, c->compress, c->seal, NULL, NULL, NULL, NULL, &f) == 0);
+
+        return f;
+}
+
+static void append_close(JournalFile *f) {
+        _cleanup_free_ char *path = NULL;
+
+        assert_se(path = strdup(f->path));
+
+        (void) journal_file_close(f);
+        assert_se(unlink(path) >= 0);
+}
+
+static bool sealing_available(const char *directory) {
+        Context c = {
+                .directory = directory,
+                .seal = true,
+        };
+        JournalFile *f;
+        bool b;
+
+        f = append_open(&c);
+        b = JOURNAL_HEADER_SEALED(f->header);
+        append_close(f);
+
+        return b;
+}
+
+static nsec_t bench_append(unsigned n, void *userdata) {
+        Context *c = userdata;
+        dual_timestamp ts;
+        JournalFile *f;
+        unsigned i;
+        nsec_t t;
+
+        f = append_open(c);
+
+        dual_timestamp_get(&ts);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+
+        for (i = 0; i < n; i++) {
+                char message[LINE_MAX], pid[32], unit[64];
+                struct iovec iovec[7];
+                unsigned k = 0;
+
+                xsprintf(pid, "_PID=%u", 1000 + i % 32);
+                xsprintf(unit, "_SYSTEMD_UNIT=worker-%u.service", i % 32);
+                xsprintf(message, "MESSAGE=GET /api/v1/items/%u HTTP/1.1 %u, took %ums, %u bytes sent to client",
+                         i, i % 11 ? 200 : 500, i % 97, (i * 7919) % 65536);
+
+                iovec[k++] = IOVEC_MAKE_STRING(message);
+                iovec[k++] = IOVEC_MAKE_STRING("PRIORITY=6");
+                iovec[k++] = IOVEC_MAKE_STRING("SYSLOG_IDENTIFIER=worker");
+                iovec[k++] = IOVEC_MAKE_STRING("_TRANSPORT=stdout");
+                iovec[k++] = IOVEC_MAKE_STRING("_COMM=worker");
+                iovec[k++] = IOVEC_MAKE_STRING(pid);
+                iovec[k++] = IOVEC_MAKE_STRING(unit);
+
+                ts.realtime++;
+                ts.monotonic++;
+
+                assert_se(journal_file_append_entry(f, &ts, iovec, k, NULL, NULL, NULL) == 0);
+        }
+
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        append_close(f);
+
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        char t[] = "/tmp/journal-append-XXXXXX";
+        unsigned n;
+
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return EXIT_TEST_SKIP;
+
+        log_set_max_level(LOG_INFO);
+
+        n = benchmark_get_iterations(argc, argv, 2000, 200000);
+
+        assert_se(mkdtemp(t));
+
+        benchmark_run("journal-append", "plain", n, bench_append, &(Context) { t, false, false });
+        benchmark_run("journal-append", "compressed", n, bench_append, &(Context) { t, true, false });
+
+        if (sealing_available(t)) {
+                benchmark_run("journal-append", "plain/sealed", n, bench_append, &(Context) { t, false, true });
+                benchmark_run("journal-append", "compressed/sealed", n, bench_append, &(Context) { t, true, true });
+        } else
+                log_info("No sealing key set up for this machine, skipping sealed runs.");
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
@@ -0,0 +1,168 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "fd-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "journald-context.h"
+#include "log.h"
+#include "macro.h"
+#include "stdio-util.h"
+#include "string-util.h"
+
+static void server_init_for_test(Server *s) {
+        /* A server without an event loop, whose cgroup entries hence are never watched */
+        *s = (Server) {
+                .cgroup_inotify_fd = -1,
+        };
+
+        assert_se(s->cgroup_root = strdup("/"));
+}
+
+static void server_done_for_test(Server *s) {
+        client_context_flush_all(s);
+        free(s->cgroup_root);
+}
+
+static void test_cgroup_hit(void) {
+        ClientCgroup *a, *b;
+        Server s;
+
+        server_init_for_test(&s);
+
+        assert_se(client_cgroup_get(&s, "/user.slice/user-1000.slice/session-4.scope", USEC_PER_SEC, &a) >= 0);
+        assert_se(streq(a->path, "/user.slice/user-1000.slice/session-4.scope"));
+        assert_se(streq(a->session, "4"));
+        assert_se(a->owner_uid == 1000);
+        assert_se(streq(a->unit, "session-4.scope"));
+        assert_se(streq(a->slice, "user-1000.slice"));
+        assert_se(a->inotify_wd < 0);
+
+        /* The same cgroup again, while the entry is still fresh: no new lookup */
+        assert_se(client_cgroup_get(&s, "/user.slice/user-1000.slice/session-4.scope", USEC_PER_SEC + 10, &b) >= 0);
+        assert_se(a == b);
+        assert_se(b->timestamp == USEC_PER_SEC);
+
+        /* Another cgroup gets its own entry, but shares the interned strings */
+        assert_se(client_cgroup_get(&s, "/user.slice/user-1000.slice/session-5.scope", USEC_PER_SEC, &b) >= 0);
+        assert_se(a != b);
+        assert_se(streq(b->session, "5"));
+        assert_se(a->slice == b->slice);
+        assert_se(hashmap_size(s.client_cgroups) == 2);
+
+        server_done_for_test(&s);
+}
+
+static void test_cgroup_refresh(void) {
+        ClientCgroup *cg;
+        Server s;
+
+        server_init_for_test(&s);
+
+        assert_se(client_cgroup_get(&s, "/system.slice/foo.service", USEC_PER_SEC, &cg) >= 0);
+        assert_se(streq(cg->unit, "foo.service"));
+        assert_se(streq(cg->slice, "system.slice"));
+        assert_se(cg->timestamp == USEC_PER_SEC);
+
+        /* Entries that aren't watched are looked up again once they are old */
+        assert_se(client_cgroup_get(&s, "/system.slice/foo.service", 5 * USEC_PER_SEC, &cg) >= 0);
+        assert_se(streq(cg->unit, "foo.service"));
+        assert_se(cg->timestamp == 5 * USEC_PER_SEC);
+        assert_se(hashmap_size(s.client_cgroups) == 1);
+
+        server_done_for_test(&s);
+}
+
+static void test_cgroup_invalidate(void) {
+        char t[] = "/tmp/test-journal-context-XXXXXX";
+        _cleanup_close_ int fd = -1;
+        ClientCgroup *cg;
+        Server s;
+
+        server_init_for_test(&s);
+
+        fd = mkostemp_safe(t);
+        assert_se(fd >= 0);
+
+        assert_se(client_cgroup_get(&s, "/system.slice/bar.service", USEC_PER_SEC, &cg) >= 0);
+
+        /* Pretend the file is the cgroup.events file of the cgroup */
+        s.cgroup_inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        assert_se(s.cgroup_inotify_fd >= 0);
+        cg->inotify_wd = inotify_add_watch(s.cgroup_inotify_fd, t, IN_MODIFY);
+        assert_se(cg->inotify_wd >= 0);
+        assert_se(hashmap_ensure_allocated(&s.client_cgroups_by_wd, NULL) >= 0);
+        assert_se(hashmap_put(s.client_cgroups_by_wd, INT_TO_PTR(cg->inotify_wd), cg) >= 0);
+
+        /* Watched entries stay valid however old they are */
+        assert_se(client_cgroup_get(&s, "/system.slice/bar.service", 60 * USEC_PER_SEC, &cg) >= 0);
+        assert_se(cg->timestamp == USEC_PER_SEC);
+
+        /* Until the cgroup's populated state changes */
+        assert_se(write_string_file(t, "populated 0", 0) >= 0);
+        assert_se(client_cgroup_dispatch_inotify(NULL, s.cgroup_inotify_fd, EPOLLIN, &s) >= 0);
+        assert_se(hashmap_isempty(s.client_cgroups));
+        assert_se(hashmap_isempty(s.client_cgroups_by_wd));
+
+        assert_se(client_cgroup_get(&s, "/system.slice/bar.service", 60 * USEC_PER_SEC, &cg) >= 0);
+        assert_se(cg->timestamp == 60 * USEC_PER_SEC);
+
+        server_done_for_test(&s);
+        s.cgroup_inotify_fd = safe_close(s.cgroup_inotify_fd);
+        assert_se(unlink(t) >= 0);
+}
+
+static void test_cgroup_evict(void) {
+        char path[sizeof("/system.slice/test-.service") + DECIMAL_STR_MAX(unsigned)];
+        ClientCgroup *cg;
+        unsigned i;
+        Server s;
+
+        server_init_for_test(&s);
+
+        for (i = 0; i < CGROUP_CACHE_MAX + 10; i++) {
+                xsprintf(path, "/system.slice/test-%u.service", i);
+
+                assert_se(client_cgroup_get(&s, path, USEC_PER_SEC, &cg) >= 0);
+                assert_se(streq(cg->path, path));
+                assert_se(hashmap_size(s.client_cgroups) <= CGROUP_CACHE_MAX);
+        }
+
+        assert_se(hashmap_size(s.client_cgroups) == CGROUP_CACHE_MAX);
+
+        /* The entry added last is always kept */
+        assert_se(hashmap_get(s.client_cgroups, path) == cg);
+
+        server_done_for_test(&s);
+}
+
+int main(int argc, char *argv[]) {
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        test_cgroup_hit();
+        test_cgroup_refresh();
+        test_cgroup_invalidate();
+        test_cgroup_evict();
+
+        return 0;
+}
@@ -19,16 +19,22 @@
 ***/
 
 #include <fcntl.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include "sd-journal.h"
 
 #include "alloc-util.h"
+#include "env-util.h"
+#include "io-util.h"
 #include "journal-file.h"
+#include "journal-internal.h"
 #include "journal-vacuum.h"
 #include "log.h"
 #include "parse-util.h"
+#include "rlimit-util.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "util.h"
 
 /* This program tests skipping around in a multi-file journal.
@@ -288,7 +294,180 @@ static void test_sequence_numbers(void) {
         }
 }
 
+static void check_number_quiet(sd_journal *j, unsigned n) {
+        char buf[sizeof("NUMBER=") + DECIMAL_STR_MAX(unsigned)];
+        const void *d;
+        size_t l;
+
+        assert_ret(sd_journal_get_data(j, "NUMBER", &d, &l));
+        xsprintf(buf, "NUMBER=%u", n);
+        assert_se(l == strlen(buf));
+        assert_se(memcmp(d, buf, l) == 0);
+}
+
+static void test_many_files(unsigned n_files, unsigned n_per_file) {
+        char t[] = "/tmp/journal-many-XXXXXX";
+        JournalMetrics metrics;
+        struct rlimit rl;
+        sd_journal *j;
+        usec_t start, down, up;
+        char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX];
+        unsigned k, total;
+        int r;
+
+        /* The reader keeps every file open at the same time */
+        rl.rlim_cur = rl.rlim_max = n_files + 64;
+        (void) setrlimit_closest(RLIMIT_NOFILE, &rl);
+        assert_se(getrlimit(RLIMIT_NOFILE, &rl) >= 0);
+        if (rl.rlim_cur < n_files + 64)
+                n_files = rl.rlim_cur > 128 ? rl.rlim_cur - 64 : 64;
+
+        total = n_files * n_per_file;
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        journal_reset_metrics(&metrics);
+        metrics.max_size = 512 * 1024;
+
+        /* Entry n goes to file n % n_files, with timestamps derived from n, so that reading all files
+         * merged has to switch files on every step. */
+        for (k = 0; k < n_files; k++) {
+                char fn[sizeof("many-.journal") + DECIMAL_STR_MAX(unsigned)];
+                JournalFile *f;
+                unsigned n;
+
+                xsprintf(fn, "many-%u.journal", k);
+                assert_ret(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0644, true, false, &metrics, NULL, NULL, NULL, &f));
+
+                for (n = k == 0 ? n_files : k; n <= total; n += n_files) {
+                        char buf[sizeof("NUMBER=") + DECIMAL_STR_MAX(unsigned)];
+                        dual_timestamp ts;
+                        struct iovec iovec;
+
+                        ts.realtime = USEC_PER_SEC + n;
+                        ts.monotonic = USEC_PER_SEC + n;
+
+                        xsprintf(buf, "NUMBER=%u", n);
+                        iovec = IOVEC_MAKE_STRING(buf);
+                        assert_ret(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL));
+                }
+
+                test_close(f);
+        }
+
+        /* This is the access pattern the flag is meant for */
+        assert_ret(sd_journal_open_directory(&j, t, SD_JOURNAL_SEQUENTIAL));
+
+        log_set_max_level(LOG_INFO);
+
+        start = now(CLOCK_MONOTONIC);
+        assert_ret(sd_journal_seek_head(j));
+        for (k = 1; k <= total; k++) {
+                assert_ret(r = sd_journal_next(j));
+                assert_se(r == 1);
+                check_number_quiet(j, k);
+        }
+        assert_ret(r = sd_journal_next(j));
+        assert_se(r == 0);
+        down = now(CLOCK_MONOTONIC) - start;
+
+        /* We are still positioned on the last entry */
+        start = now(CLOCK_MONOTONIC);
+        for (k = total - 1; k >= 1; k--) {
+                assert_ret(r = sd_journal_previous(j));
+                assert_se(r == 1);
+                check_number_quiet(j, k);
+        }
+        assert_ret(r = sd_journal_previous(j));
+        assert_se(r == 0);
+        up = now(CLOCK_MONOTONIC) - start;
+
+        log_set_max_level(LOG_DEBUG);
+
+        log_info("%u files, %u entries: forward %s, backward %s",
+                 n_files, total,
+                 format_timespan(a, sizeof(a), down, 0),
+                 format_timespan(b, sizeof(b), up, 0));
+
+        sd_journal_close(j);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+static void test_sequential_flag(void) {
+        char t[] = "/tmp/journal-sequential-XXXXXX";
+        unsigned k, n_files = 4, total = 4 * 50;
+        int flags[] = { 0, SD_JOURNAL_SEQUENTIAL };
+        JournalFile *f;
+        Iterator i;
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        /* Entry n goes to file n % n_files, so that reading them in order has to switch files on every step */
+        for (k = 0; k < n_files; k++) {
+                char fn[sizeof("sequential-.journal") + DECIMAL_STR_MAX(unsigned)];
+                unsigned n;
+
+                xsprintf(fn, "sequential-%u.journal", k);
+                assert_ret(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0644, true, false, NULL, NULL, NULL, NULL, &f));
+
+                for (n = k == 0 ? n_files : k; n <= total; n += n_files) {
+                        char buf[sizeof("NUMBER=") + DECIMAL_STR_MAX(unsigned)];
+                        dual_timestamp ts;
+                        struct iovec iovec;
+
+                        ts.realtime = USEC_PER_SEC + n;
+                        ts.monotonic = USEC_PER_SEC + n;
+
+                        xsprintf(buf, "NUMBER=%u", n);
+                        iovec = IOVEC_MAKE_STRING(buf);
+                        assert_ret(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL));
+                }
+
+                test_close(f);
+        }
+
+        for (k = 0; k < ELEMENTSOF(flags); k++) {
+                sd_journal *j;
+                unsigned n;
+                int r;
+
+                assert_ret(sd_journal_open_directory(&j, t, flags[k]));
+
+                /* The flag has to apply to every file right from the start, not only once we reached its end */
+                ORDERED_HASHMAP_FOREACH(f, j->files, i)
+                        assert_se(f->sequential == !!(flags[k] & SD_JOURNAL_SEQUENTIAL));
+
+                assert_ret(sd_journal_seek_head(j));
+                for (n = 1; n <= total; n++) {
+                        assert_ret(r = sd_journal_next(j));
+                        assert_se(r == 1);
+                        check_number_quiet(j, n);
+                }
+                assert_ret(r = sd_journal_next(j));
+                assert_se(r == 0);
+
+                ORDERED_HASHMAP_FOREACH(f, j->files, i)
+                        assert_se((f->readahead_end > 0) == !!(flags[k] & SD_JOURNAL_SEQUENTIAL));
+
+                sd_journal_close(j);
+        }
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
 int main(int argc, char *argv[]) {
+        bool slow;
+        int r;
+
         log_set_max_level(LOG_DEBUG);
 
         /* journal_file_open requires a valid machine id */
@@ -301,6 +480,12 @@ int main(int argc, char *argv[]) {
         test_skip(setup_interleaved);
 
         test_sequence_numbers();
+        test_sequential_flag();
+
+        r = getenv_bool("SYSTEMD_SLOW_TESTS");
+        slow = r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT;
+
+        test_many_files(slow ? 3000 : 64, slow ? 10 : 4);
 
         return 0;
 }
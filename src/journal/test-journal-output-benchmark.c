@@ -0,0 +1,198 @@
+/***
+  This file is part of systemd
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "env-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "log.h"
+#include "logs-show.h"
+#include "macro.h"
+#include "output-mode.h"
+#include "parse-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "util.h"
+
+static unsigned arg_entries;
+
+static char* escape(const char *p, size_t l) {
+        _cleanup_fclose_ FILE *f = NULL;
+        char *buf = NULL;
+        size_t sz = 0;
+
+        f = open_memstream(&buf, &sz);
+        assert_se(f);
+        json_escape(f, p, l, 0);
+        assert_se(fflush_and_check(f) >= 0);
+
+        return buf;
+}
+
+static void test_json_escape_one(const char *p, size_t l, const char *expected) {
+        _cleanup_free_ char *s = NULL;
+
+        s = escape(p, l);
+        log_debug("%s → %s", p, s);
+        assert_se(streq(s, expected));
+}
+
+static void test_json_escape(void) {
+        test_json_escape_one("", 0, "\"\"");
+        test_json_escape_one("abc", 3, "\"abc\"");
+        test_json_escape_one("abcdefgh", 8, "\"abcdefgh\"");
+        test_json_escape_one("\"quoted\"", 8, "\"\\\"quoted\\\"\"");
+        test_json_escape_one("back\\slash", 10, "\"back\\\\slash\"");
+        test_json_escape_one("line\nbreak\n", 11, "\"line\\nbreak\\n\"");
+        test_json_escape_one("tab\there", 8, "\"tab\\u0009here\"");
+        test_json_escape_one("\\\\\\\\\\", 5, "\"\\\\\\\\\\\\\\\\\\\\\"");
+        test_json_escape_one("zażółć gęślą jaźń", strlen("zażółć gęślą jaźń"), "\"zażółć gęślą jaźń\"");
+
+        /* Not printable, hence output as an array of bytes */
+        test_json_escape_one("a\x01" "b", 3, "[ 97, 1, 98 ]");
+}
+
+static void make_journal(const char *path) {
+        _cleanup_free_ char *payload = NULL;
+        dual_timestamp ts;
+        JournalFile *f;
+        unsigned i;
+
+        assert_se(journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, false, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        /* Something shaped like the output of a busy service, including the occasional multi-line message,
+         * a field that needs escaping and a binary one */
+        assert_se(payload = malloc(7 + 64));
+        memcpy(payload, "BINARY=", 7);
+        for (i = 0; i < 64; i++)
+                payload[7 + i] = i * 7;
+
+        dual_timestamp_get(&ts);
+
+        for (i = 0; i < arg_entries; i++) {
+                char message[LINE_MAX], pid[32], unit[64], cmdline[128];
+                struct iovec iovec[9];
+                unsigned n = 0;
+
+                xsprintf(pid, "_PID=%u", 1000 + i % 32);
+                xsprintf(unit, "_SYSTEMD_UNIT=worker-%u.service", i % 32);
+                xsprintf(cmdline, "_CMDLINE=/usr/bin/worker --id=%u --config=\"/etc/worker.conf\"", i % 32);
+                if (i % 50 == 0)
+                        xsprintf(message, "MESSAGE=Request %u failed:\n\tat handler()\n\tat main()", i);
+                else
+                        xsprintf(message, "MESSAGE=GET /api/v1/items/%u HTTP/1.1 %u, took %ums, %u bytes sent to client",
+                                 i, i % 11 ? 200 : 500, i % 97, (i * 7919) % 65536);
+
+                iovec[n++] = IOVEC_MAKE_STRING(message);
+                iovec[n++] = IOVEC_MAKE_STRING("PRIORITY=6");
+                iovec[n++] = IOVEC_MAKE_STRING("SYSLOG_IDENTIFIER=worker");
+                iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=stdout");
+                iovec[n++] = IOVEC_MAKE_STRING("_COMM=worker");
+                iovec[n++] = IOVEC_MAKE_STRING(pid);
+                iovec[n++] = IOVEC_MAKE_STRING(unit);
+                iovec[n++] = IOVEC_MAKE_STRING(cmdline);
+                if (i % 100 == 0)
+                        iovec[n++] = IOVEC_MAKE(payload, 7 + 64);
+
+                ts.realtime++;
+                ts.monotonic++;
+
+                assert_se(journal_file_append_entry(f, &ts, iovec, n, NULL, NULL, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+}
+
+static void test_output_benchmark(const char *directory, OutputMode mode) {
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        unsigned n_entries = 0;
+        usec_t n, t;
+        long bytes;
+
+        assert_se(sd_journal_open_directory(&j, directory, 0) >= 0);
+
+        /* Write to a real file, so that the cost of stdio is included, but let the kernel sort out
+         * where the pages go */
+        f = tmpfile();
+        assert_se(f);
+
+        n = now(CLOCK_MONOTONIC);
+
+        SD_JOURNAL_FOREACH(j) {
+                assert_se(output_journal(f, j, mode, 0, OUTPUT_FULL_WIDTH, NULL) >= 0);
+                n_entries++;
+        }
+
+        assert_se(fflush_and_check(f) >= 0);
+        t = now(CLOCK_MONOTONIC) - n;
+
+        assert_se(n_entries == arg_entries);
+        bytes = ftell(f);
+        assert_se(bytes > 0);
+
+        log_info("%-16s %u entries, %7.2fMiB in %.2fs (%.2fMiB/s, %.0f entries/s)",
+                 output_mode_to_string(mode), n_entries, bytes / 1024. / 1024., t / 1e6,
+                 bytes / 1024. / 1024. / (t / 1e6), n_entries / (t / 1e6));
+}
+
+int main(int argc, char *argv[]) {
+        char t[] = "/tmp/journal-output-XXXXXX";
+        const char *path;
+        OutputMode m;
+
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return EXIT_TEST_SKIP;
+
+        log_set_max_level(LOG_INFO);
+
+        test_json_escape();
+
+        if (argc >= 2)
+                assert_se(safe_atou(argv[1], &arg_entries) >= 0);
+        else {
+                bool slow;
+                int r;
+
+                r = getenv_bool("SYSTEMD_SLOW_TESTS");
+                slow = r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT;
+
+                arg_entries = slow ? 200000 : 2000;
+        }
+
+        assert_se(mkdtemp(t));
+
+        path = strjoina(t, "/bench.journal");
+        make_journal(path);
+
+        for (m = 0; m < _OUTPUT_MODE_MAX; m++)
+                test_output_benchmark(t, m);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
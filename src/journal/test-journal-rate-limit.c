@@ -0,0 +1,142 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <syslog.h>
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "journald-rate-limit.h"
+#include "macro.h"
+#include "string-util.h"
+
+/* Little enough disk space that the burst isn't raised */
+#define AVAILABLE (1024U*1024U)
+
+#define INTERVAL (10*USEC_PER_SEC)
+#define BURST 10U
+
+/* Some time well after the clock started */
+#define T0 (1000*USEC_PER_SEC)
+
+static void test_burst(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new(INTERVAL, BURST));
+
+        /* A full bucket lets a whole burst through at once, but not more */
+        for (i = 0; i < BURST; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 1);
+
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 0);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 1) == 0);
+
+        /* Other priorities and other units have buckets of their own */
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_ERR, AVAILABLE, T0) == 1);
+        assert_se(journal_rate_limit_test(r, "bar.service", LOG_INFO, AVAILABLE, T0) == 1);
+
+        /* Priorities that share a pool share the bucket */
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_NOTICE, AVAILABLE, T0) == 0);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_refill(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new(INTERVAL, BURST));
+
+        for (i = 0; i < BURST; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 0);
+
+        /* The bucket is refilled continuously, by one message per interval/burst */
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL / BURST - 1) == 0);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL / BURST) == 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL / BURST) == 0);
+
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 3 * INTERVAL / BURST) == 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 3 * INTERVAL / BURST) == 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 3 * INTERVAL / BURST) == 0);
+
+        /* An idle bucket fills up to a whole burst, but not beyond */
+        for (i = 0; i < BURST; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 10 * INTERVAL) >= 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 10 * INTERVAL) == 0);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_interval_rollover(void) {
+        _cleanup_free_ char *dump = NULL;
+        JournalRateLimit *r;
+        size_t size;
+        FILE *f;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new(INTERVAL, BURST));
+
+        for (i = 0; i < BURST; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 1);
+        for (i = 0; i < 5; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 0);
+
+        /* A message let through within the interval in which the suppression started doesn't report it yet */
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL / BURST) == 1);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL / BURST) == 0);
+
+        f = open_memstream(&dump, &size);
+        assert_se(f);
+        journal_rate_limit_dump(r, f);
+        assert_se(fflush_and_check(f) >= 0);
+        fclose(f);
+        assert_se(streq(dump, "foo.service info 6 6\n"));
+
+        /* The first message let through once the interval is over carries the number of dropped ones */
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL) == 1 + 6);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL) == 1);
+
+        /* A new suppression is counted from scratch */
+        for (i = 0; i < BURST; i++)
+                (void) journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + INTERVAL) == 0);
+        assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0 + 3 * INTERVAL) >= 1 + 1);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_disabled(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(journal_rate_limit_test(NULL, "foo.service", LOG_INFO, AVAILABLE, T0) == 1);
+
+        assert_se(r = journal_rate_limit_new(0, 0));
+        for (i = 0; i < 2 * BURST; i++)
+                assert_se(journal_rate_limit_test(r, "foo.service", LOG_INFO, AVAILABLE, T0) == 1);
+        journal_rate_limit_free(r);
+}
+
+int main(int argc, char *argv[]) {
+        test_burst();
+        test_refill();
+        test_interval_rollover();
+        test_disabled();
+
+        return 0;
+}
@@ -0,0 +1,163 @@
+/***
+  This file is part of systemd
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "log.h"
+#include "macro.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "util.h"
+
+/* Measures the sd_journal read paths journalctl uses: iterating, seeking to a point in time, as "--since" does,
+ * and doing so with a match installed, as for "-u". The journal file is written once, read many times. */
+
+#define N_UNITS 32U
+
+typedef struct Context {
+        sd_journal *journal;
+        usec_t realtime_base;
+        unsigned n_entries;
+} Context;
+
+static void write_journal(const char *directory, unsigned n, usec_t *ret_base) {
+        _cleanup_free_ char *path = NULL;
+        dual_timestamp ts;
+        JournalFile *f;
+        unsigned i;
+
+        assert_se(path = strjoin(directory, "/bench.journal"));
+        assert_se(journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, false, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        dual_timestamp_get(&ts);
+        *ret_base = ts.realtime;
+
+        for (i = 0; i < n; i++) {
+                char message[LINE_MAX], unit[64];
+                struct iovec iovec[3];
+                unsigned k = 0;
+
+                xsprintf(unit, "_SYSTEMD_UNIT=worker-%u.service", i % N_UNITS);
+                xsprintf(message, "MESSAGE=Request %u handled", i);
+
+                iovec[k++] = IOVEC_MAKE_STRING(message);
+                iovec[k++] = IOVEC_MAKE_STRING("PRIORITY=6");
+                iovec[k++] = IOVEC_MAKE_STRING(unit);
+
+                /* One entry per millisecond */
+                ts.realtime = *ret_base + i * USEC_PER_MSEC;
+                ts.monotonic += USEC_PER_MSEC;
+
+                assert_se(journal_file_append_entry(f, &ts, iovec, k, NULL, NULL, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+}
+
+static usec_t pick_time(Context *c, unsigned i, unsigned range) {
+        /* Some fixed permutation of the first entries, so that consecutive seeks land far apart */
+        return c->realtime_base + ((i * UINT64_C(2654435761)) % range) * USEC_PER_MSEC;
+}
+
+static nsec_t bench_next(unsigned n, void *userdata) {
+        Context *c = userdata;
+        unsigned i;
+        nsec_t t;
+
+        assert_se(sd_journal_seek_head(c->journal) >= 0);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(sd_journal_next(c->journal) > 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        return t;
+}
+
+static nsec_t bench_seek_realtime(unsigned n, void *userdata) {
+        Context *c = userdata;
+        unsigned i;
+        nsec_t t;
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                assert_se(sd_journal_seek_realtime_usec(c->journal, pick_time(c, i, c->n_entries)) >= 0);
+                assert_se(sd_journal_next(c->journal) > 0);
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        return t;
+}
+
+static nsec_t bench_seek_match(unsigned n, void *userdata) {
+        Context *c = userdata;
+        unsigned i;
+        nsec_t t;
+
+        assert_se(sd_journal_add_match(c->journal, "_SYSTEMD_UNIT=worker-7.service", 0) >= 0);
+
+        /* Seek to the first matching entry after some point in time, there's one for every N_UNITS entries */
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                assert_se(sd_journal_seek_realtime_usec(c->journal, pick_time(c, i, c->n_entries - N_UNITS)) >= 0);
+                assert_se(sd_journal_next(c->journal) > 0);
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        sd_journal_flush_matches(c->journal);
+
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        char t[] = "/tmp/journal-seek-XXXXXX";
+        Context c = {};
+        unsigned n;
+
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return EXIT_TEST_SKIP;
+
+        log_set_max_level(LOG_INFO);
+
+        n = MAX(benchmark_get_iterations(argc, argv, 5000, 500000), 2 * N_UNITS);
+
+        assert_se(mkdtemp(t));
+
+        write_journal(t, n, &c.realtime_base);
+        c.n_entries = n;
+
+        assert_se(sd_journal_open_directory(&c.journal, t, 0) >= 0);
+
+        benchmark_run("journal-seek", "next", n, bench_next, &c);
+        benchmark_run("journal-seek", "seek-realtime", n, bench_seek_realtime, &c);
+        benchmark_run("journal-seek", "seek-realtime-match", n, bench_seek_match, &c);
+
+        sd_journal_close(c.journal);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
@@ -23,12 +23,16 @@
 #include "sd-journal.h"
 
 #include "alloc-util.h"
+#include "env-util.h"
 #include "journal-file.h"
 #include "journal-internal.h"
+#include "journald-stream.h"
 #include "log.h"
 #include "macro.h"
 #include "parse-util.h"
 #include "rm-rf.h"
+#include "string-util.h"
+#include "strv.h"
 #include "util.h"
 
 #define N_ENTRIES 200
@@ -73,10 +77,148 @@ static void verify_contents(sd_journal *j, unsigned skip) {
                 assert_se(i == N_ENTRIES);
 }
 
+typedef struct ScanResult {
+        unsigned n_lines;
+        unsigned n_line_max;
+        size_t bytes;
+        char *last;
+        LineBreak last_break;
+} ScanResult;
+
+static int scan_line(char *p, LineBreak line_break, void *userdata) {
+        ScanResult *r = userdata;
+
+        r->n_lines++;
+        if (line_break == LINE_BREAK_LINE_MAX)
+                r->n_line_max++;
+        r->bytes += strlen(p);
+        r->last = p;
+        r->last_break = line_break;
+
+        return 0;
+}
+
+static void test_scan_lines(void) {
+        /* One spare byte each for the terminating NUL */
+        char a[] = "foo\nbar\0waldo\nincompl\0";
+        char b[] = "0123456789012345678901234\nab\0";
+        char c[] = "tail\0";
+        ScanResult r = {};
+        size_t consumed;
+
+        assert_se(stream_scan_lines(a, sizeof(a) - 2, 100, false, scan_line, &r, &consumed) >= 0);
+        assert_se(r.n_lines == 3);
+        assert_se(streq(r.last, "waldo"));
+        assert_se(r.last_break == LINE_BREAK_NEWLINE);
+        assert_se(consumed == sizeof("foo\nbar\0waldo\n") - 1);
+
+        /* Lines longer than the maximum get split, the remainder still ends in the \n */
+        r = (ScanResult) {};
+        assert_se(stream_scan_lines(b, sizeof(b) - 2, 10, false, scan_line, &r, &consumed) >= 0);
+        assert_se(r.n_lines == 3);
+        assert_se(r.n_line_max == 2);
+        assert_se(streq(r.last, "01234"));
+        assert_se(r.last_break == LINE_BREAK_NEWLINE);
+        assert_se(consumed == strlen("0123456789012345678901234\n"));
+
+        /* The incomplete line is flushed when forced to */
+        r = (ScanResult) {};
+        assert_se(stream_scan_lines(b + consumed, sizeof(b) - 2 - consumed, 10, false, scan_line, &r, &consumed) >= 0);
+        assert_se(r.n_lines == 0);
+        assert_se(consumed == 0);
+        assert_se(stream_scan_lines(c, strlen(c), 10, true, scan_line, &r, &consumed) >= 0);
+        assert_se(r.n_lines == 1);
+        assert_se(streq(r.last, "tail"));
+        assert_se(r.last_break == LINE_BREAK_EOF);
+        assert_se(consumed == strlen(c));
+}
+
+static void test_scan_lines_benchmark(void) {
+        _cleanup_free_ char *buf = NULL;
+        size_t size, length = 0, consumed;
+        ScanResult r = {};
+        usec_t n, t = 0;
+        unsigned i, k, n_runs;
+        bool slow;
+        char *p;
+        int q;
+
+        q = getenv_bool("SYSTEMD_SLOW_TESTS");
+        slow = q >= 0 ? q : SYSTEMD_SLOW_TESTS_DEFAULT;
+
+        size = slow ? 16 * 1024 * 1024 : 1024 * 1024;
+        n_runs = slow ? 8 : 2;
+
+        /* Something resembling a chatty service on stdout */
+        assert_se(buf = malloc(size + 1));
+        for (i = 0; length + LINE_MAX < size; i++)
+                length += snprintf(buf + length, LINE_MAX, "%u INFO [worker-%u] GET /api/items/%u HTTP/1.1 200 %u bytes in %ums\n",
+                                   i, i % 16, i * 7919, i % 4096, i % 97);
+
+        for (k = 0; k < n_runs; k++) {
+                r = (ScanResult) {};
+                n = now(CLOCK_MONOTONIC);
+                assert_se(stream_scan_lines(buf, length, 48 * 1024, false, scan_line, &r, &consumed) >= 0);
+                t += now(CLOCK_MONOTONIC) - n;
+                assert_se(r.n_lines == i);
+                assert_se(consumed == length);
+
+                /* Put the line breaks back for the next run */
+                for (p = buf; p < buf + length; p++)
+                        if (*p == 0)
+                                *p = '\n';
+        }
+
+        log_info("Scanned %u lines, %zu bytes %u times in %.2fs (%.2fMiB/s)",
+                 i, length, k, t / 1e6, (double) length * k / 1024 / 1024 / (t / 1e6));
+}
+
+static void test_data_fields(sd_journal *j) {
+        unsigned n_entries = 0;
+        const void *data;
+        size_t l;
+
+        /* Only the data fields whose names are listed are enumerated */
+
+        sd_journal_flush_matches(j);
+
+        assert_se(sd_journal_set_data_fields(j, STRV_MAKE("NUM")) >= 0);
+        SD_JOURNAL_FOREACH(j) {
+                assert_se(sd_journal_enumerate_data(j, &data, &l) == 0);
+                n_entries++;
+        }
+        assert_se(n_entries == N_ENTRIES);
+
+        assert_se(sd_journal_set_data_fields(j, STRV_MAKE("NUMBER")) >= 0);
+        SD_JOURNAL_FOREACH(j) {
+                unsigned n = 0;
+
+                SD_JOURNAL_FOREACH_DATA(j, data, l) {
+                        assert_se(l > 7 && memcmp(data, "NUMBER=", 7) == 0);
+                        n++;
+                }
+                assert_se(n == 1);
+
+                /* Lookups by name are not affected */
+                assert_se(sd_journal_get_data(j, "MAGIC", &data, &l) >= 0);
+        }
+
+        assert_se(sd_journal_set_data_fields(j, STRV_MAKE("MAGIC", "NUMBER")) >= 0);
+        assert_se(sd_journal_seek_head(j) >= 0);
+        assert_se(sd_journal_next(j) > 0);
+        n_entries = 0;
+        SD_JOURNAL_FOREACH_DATA(j, data, l)
+                n_entries++;
+        assert_se(n_entries == 2);
+
+        assert_se(sd_journal_set_data_fields(j, STRV_MAKE("BAD=FIELD")) == -EINVAL);
+        assert_se(sd_journal_set_data_fields(j, NULL) >= 0);
+}
+
 int main(int argc, char *argv[]) {
         JournalFile *one, *two, *three;
         char t[] = "/tmp/journal-stream-XXXXXX";
-        unsigned i;
+        unsigned i, n_unique;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         char *z;
         const void *data;
@@ -89,6 +231,9 @@ int main(int argc, char *argv[]) {
 
         log_set_max_level(LOG_DEBUG);
 
+        test_scan_lines();
+        test_scan_lines_benchmark();
+
         assert_se(mkdtemp(t));
         assert_se(chdir(t) >= 0);
 
@@ -186,9 +331,23 @@ int main(int argc, char *argv[]) {
 
         verify_contents(j, 0);
 
+        /* Entries are spread over three files, some of them appear in two of them, each value should be
+         * returned once nonetheless */
+        n_unique = 0;
         assert_se(sd_journal_query_unique(j, "NUMBER") >= 0);
-        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l) {
                 printf("%.*s\n", (int) l, (const char*) data);
+                n_unique++;
+        }
+        assert_se(n_unique == N_ENTRIES);
+
+        n_unique = 0;
+        assert_se(sd_journal_query_unique(j, "MAGIC") >= 0);
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+                n_unique++;
+        assert_se(n_unique == 2);
+
+        test_data_fields(j);
 
         assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
 
@@ -18,13 +18,24 @@
 ***/
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "sd-journal.h"
+
+#include "dirent-util.h"
+#include "fd-util.h"
+#include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
+#include "journal-verify.h"
 #include "log.h"
+#include "lookup3.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 
 static bool arg_keep = false;
 
@@ -122,6 +133,468 @@ static void test_non_empty(void) {
         puts("------------------------------------------------------------");
 }
 
+static void test_append_entries(void) {
+        JournalFile *f;
+        JournalEntry entries[3] = {};
+        struct iovec a[2], b[1], c[2];
+        static const char test[] = "TEST1=1", test2[] = "TEST2=2", test3[] = "TEST3=3";
+        uint64_t seqnum = 0, p;
+        unsigned n_appended = 0;
+        Object *o;
+        char t[] = "/tmp/journal-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        a[0] = IOVEC_MAKE_STRING(test);
+        a[1] = IOVEC_MAKE_STRING(test2);
+        b[0] = IOVEC_MAKE_STRING(test);
+        c[0] = IOVEC_MAKE_STRING(test3);
+        c[1] = IOVEC_MAKE_STRING(test2);
+
+        entries[0].iovec = a;
+        entries[0].n_iovec = ELEMENTSOF(a);
+        entries[1].iovec = b;
+        entries[1].n_iovec = ELEMENTSOF(b);
+        entries[2].iovec = c;
+        entries[2].n_iovec = ELEMENTSOF(c);
+
+        dual_timestamp_get(&entries[0].ts);
+        entries[1].ts = entries[2].ts = entries[0].ts;
+
+        assert_se(journal_file_append_entries(f, entries, ELEMENTSOF(entries), &seqnum, &n_appended) == 0);
+        assert_se(n_appended == 3);
+        assert_se(seqnum == 3);
+
+        /* Duplicates within the batch are stored only once */
+        assert_se(le64toh(f->header->n_entries) == 3);
+        assert_se(le64toh(f->header->n_data) == 3);
+
+        assert_se(journal_file_next_entry(f, 0, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 1);
+        assert_se(journal_file_entry_n_items(o) == 2);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+        assert_se(journal_file_entry_n_items(o) == 1);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 3);
+        assert_se(journal_file_entry_n_items(o) == 2);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 0);
+
+        assert_se(journal_file_find_data_object(f, test, strlen(test), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 2);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_UP, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+
+        assert_se(journal_file_find_data_object(f, test2, strlen(test2), &o, NULL) == 1);
+        assert_se(le64toh(o->data.n_entries) == 2);
+
+        assert_se(journal_file_find_data_object(f, test3, strlen(test3), &o, NULL) == 1);
+        assert_se(le64toh(o->data.n_entries) == 1);
+
+        /* An empty batch is fine too */
+        assert_se(journal_file_append_entries(f, NULL, 0, &seqnum, &n_appended) == 0);
+        assert_se(n_appended == 0);
+
+        (void) journal_file_close(f);
+
+        log_info("Done...");
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_entry_index(void) {
+        JournalFile *f;
+        struct iovec iovec;
+        static const char test[] = "TEST1=1";
+        dual_timestamp ts;
+        uint64_t i, base;
+        Object *o;
+        char t[] = "/tmp/journal-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        dual_timestamp_get(&ts);
+        base = ts.realtime;
+
+        iovec = IOVEC_MAKE_STRING(test);
+
+        /* Every second entry gets the same timestamp as the one before */
+        for (i = 0; i < 2000; i++) {
+                ts.realtime = base + (i / 2) * 10;
+                assert_se(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        assert_se(!JOURNAL_HEADER_ENTRY_INDEX(f->header));
+        assert_se(journal_file_append_entry_index(f) == 0);
+        assert_se(JOURNAL_HEADER_ENTRY_INDEX(f->header));
+        assert_se(le64toh(f->header->entry_index_offset) > 0);
+
+        journal_file_dump(f);
+
+        for (i = 0; i < 990; i += 37) {
+                assert_se(journal_file_move_to_entry_by_realtime(f, base + i * 10, DIRECTION_DOWN, &o, NULL) == 1);
+                assert_se(le64toh(o->entry.seqnum) == i * 2 + 1);
+
+                assert_se(journal_file_move_to_entry_by_realtime(f, base + i * 10, DIRECTION_UP, &o, NULL) == 1);
+                assert_se(le64toh(o->entry.seqnum) == i * 2 + 2);
+
+                assert_se(journal_file_move_to_entry_by_realtime(f, base + i * 10 + 5, DIRECTION_DOWN, &o, NULL) == 1);
+                assert_se(le64toh(o->entry.seqnum) == i * 2 + 3);
+
+                assert_se(journal_file_move_to_entry_by_seqnum(f, i * 2 + 1, DIRECTION_DOWN, &o, NULL) == 1);
+                assert_se(le64toh(o->entry.seqnum) == i * 2 + 1);
+        }
+
+        assert_se(journal_file_move_to_entry_by_realtime(f, base + 10000, DIRECTION_DOWN, &o, NULL) == 0);
+        assert_se(journal_file_move_to_entry_by_realtime(f, base + 10000, DIRECTION_UP, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2000);
+
+        assert_se(journal_file_move_to_entry_by_seqnum(f, 1, DIRECTION_DOWN, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 1);
+
+        (void) journal_file_close(f);
+
+        log_info("Done...");
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static int bloom_test_unit(JournalFile *f, unsigned u) {
+        char buf[sizeof("_SYSTEMD_UNIT=unit-.service") + DECIMAL_STR_MAX(unsigned)];
+
+        xsprintf(buf, "_SYSTEMD_UNIT=unit-%u.service", u);
+        return journal_file_data_bloom_test(f, "_SYSTEMD_UNIT", strlen("_SYSTEMD_UNIT"), hash64(buf, strlen(buf)));
+}
+
+static void test_data_bloom(void) {
+        static const char message[] = "MESSAGE=foo";
+        JournalFile *f;
+        sd_journal *j;
+        dual_timestamp ts;
+        unsigned i, n = 0, n_positive = 0;
+        char t[] = "/tmp/journal-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 0; i < 100; i++) {
+                char buf[sizeof("_SYSTEMD_UNIT=unit-.service") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec[2];
+
+                xsprintf(buf, "_SYSTEMD_UNIT=unit-%u.service", i % 50);
+                iovec[0] = IOVEC_MAKE_STRING(buf);
+                iovec[1] = IOVEC_MAKE_STRING(message);
+
+                dual_timestamp_get(&ts);
+                assert_se(journal_file_append_entry(f, &ts, iovec, 2, NULL, NULL, NULL) == 0);
+        }
+
+        /* Without a filter everything might be there */
+        assert_se(bloom_test_unit(f, 4711) > 0);
+
+        assert_se(!JOURNAL_HEADER_DATA_BLOOM(f->header));
+        assert_se(journal_file_append_data_bloom(f) == 0);
+        assert_se(JOURNAL_HEADER_DATA_BLOOM(f->header));
+        assert_se(le64toh(f->header->data_bloom_offset) > 0);
+
+        /* No false negatives */
+        for (i = 0; i < 50; i++)
+                assert_se(bloom_test_unit(f, i) > 0);
+
+        /* Few false positives */
+        for (i = 1000; i < 2000; i++)
+                if (bloom_test_unit(f, i) > 0)
+                        n_positive++;
+        log_info("%u false positives out of 1000", n_positive);
+        assert_se(n_positive < 100);
+
+        /* Fields that are not covered might always be there */
+        assert_se(journal_file_data_bloom_test(f, "MESSAGE", strlen("MESSAGE"), hash64("MESSAGE=bar", strlen("MESSAGE=bar"))) > 0);
+
+        (void) journal_file_close(f);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+
+        assert_se(sd_journal_add_match(j, "_SYSTEMD_UNIT=unit-7.service", 0) >= 0);
+        SD_JOURNAL_FOREACH(j)
+                n++;
+        assert_se(n == 2);
+
+        sd_journal_flush_matches(j);
+        assert_se(sd_journal_add_match(j, "_SYSTEMD_UNIT=unit-4711.service", 0) >= 0);
+        assert_se(sd_journal_seek_head(j) >= 0);
+        assert_se(sd_journal_next(j) == 0);
+
+        sd_journal_close(j);
+
+        log_info("Done...");
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+#ifdef HAVE_ZSTD
+static void append_message(JournalFile *f, unsigned i) {
+        char buf[LINE_MAX];
+        struct iovec iovec;
+        dual_timestamp ts;
+
+        xsprintf(buf, "MESSAGE={\"unit\":\"worker-%u.service\",\"request\":%u,\"path\":\"/api/items/%u\",\"status\":%u}",
+                 i % 13, i * 7919, i % 1000, i % 11 ? 200 : 500);
+        iovec = IOVEC_MAKE_STRING(buf);
+
+        dual_timestamp_get(&ts);
+        assert_se(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL) == 0);
+}
+
+static void test_compression_dictionary(void) {
+        char buf[LINE_MAX];
+        JournalFile *f;
+        sd_journal *j;
+        Object *o;
+        const void *data;
+        size_t l;
+        unsigned i, n = 0;
+        char t[] = "/tmp/journal-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        /* zstd needs to be asked for */
+        assert_se(setenv("SYSTEMD_JOURNAL_ZSTD", "1", 1) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(f->compress_zstd);
+
+        for (i = 0; i < 1000; i++)
+                append_message(f, i);
+
+        /* Nothing to learn from yet */
+        assert_se(!journal_file_compress_dictionary(f));
+
+        /* The new file gets a dictionary trained on the old one, once the training thread is done */
+        assert_se(journal_file_rotate(&f, true, false, NULL) >= 0);
+        assert_se(journal_file_install_compression_dictionary(f, true) > 0);
+        assert_se(le64toh(f->header->compression_dictionary_offset) > 0);
+        assert_se(journal_file_compress_dictionary(f));
+
+        for (i = 1000; i < 1100; i++)
+                append_message(f, i);
+
+        /* Short messages are compressed now */
+        xsprintf(buf, "MESSAGE={\"unit\":\"worker-%u.service\",\"request\":%u,\"path\":\"/api/items/%u\",\"status\":%u}",
+                 1042 % 13, 1042 * 7919, 1042 % 1000, 1042 % 11 ? 200 : 500);
+        assert_se(journal_file_find_data_object(f, buf, strlen(buf), &o, NULL) == 1);
+        assert_se(o->object.flags & OBJECT_COMPRESSED_ZSTD);
+        assert_se(le64toh(o->object.size) - offsetof(Object, data.payload) < strlen(buf));
+
+        journal_file_print_header(f);
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) >= 0);
+
+        (void) journal_file_close(f);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+
+        SD_JOURNAL_FOREACH(j)
+                n++;
+        assert_se(n == 1100);
+
+        assert_se(sd_journal_add_match(j, buf, 0) >= 0);
+        assert_se(sd_journal_seek_head(j) >= 0);
+        assert_se(sd_journal_next(j) > 0);
+        assert_se(sd_journal_get_data(j, "MESSAGE", &data, &l) >= 0);
+        assert_se(l == strlen(buf));
+        assert_se(memcmp(data, buf, l) == 0);
+
+        sd_journal_close(j);
+
+        assert_se(unsetenv("SYSTEMD_JOURNAL_ZSTD") >= 0);
+
+        log_info("Done...");
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+#endif
+
+static void test_offline_notify(void) {
+        _cleanup_close_ int efd = -1;
+        dual_timestamp ts;
+        JournalFile *f, *f2;
+        struct iovec iovec;
+        static const char test[] = "TEST1=1";
+        eventfd_t x;
+        char t[] = "/tmp/journal-XXXXXX";
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        efd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        assert_se(efd >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, false, NULL, NULL, NULL, NULL, &f) == 0);
+        f->offline_notify_fd = efd;
+
+        dual_timestamp_get(&ts);
+        iovec.iov_base = (void*) test;
+        iovec.iov_len = strlen(test);
+        assert_se(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL) == 0);
+
+        /* The offline thread tells us when it's done */
+        assert_se(journal_file_set_offline(f, false) >= 0);
+        assert_se(fd_wait_for_event(efd, POLLIN, 10 * USEC_PER_SEC) > 0);
+        assert_se(eventfd_read(efd, &x) >= 0);
+        assert_se(x == 1);
+        assert_se(!journal_file_is_offlining(f));
+        assert_se(f->header->state == STATE_OFFLINE);
+
+        /* Files opened with a template inherit the fd, archiving signals it too */
+        assert_se(journal_file_append_entry(f, &ts, &iovec, 1, NULL, NULL, NULL) == 0);
+        assert_se(journal_file_open(-1, "test2.journal", O_RDWR|O_CREAT, 0666, true, false, NULL, NULL, NULL, f, &f2) == 0);
+        assert_se(f2->offline_notify_fd == efd);
+        (void) journal_file_close(f2);
+
+        f->archive = true;
+        assert_se(journal_file_set_offline(f, false) >= 0);
+        assert_se(fd_wait_for_event(efd, POLLIN, 10 * USEC_PER_SEC) > 0);
+        assert_se(!journal_file_is_offlining(f));
+        assert_se(f->header->state == STATE_ARCHIVED);
+
+        (void) journal_file_close(f);
+
+        log_info("Done...");
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static unsigned count_journal_files(const char *directory, uint64_t *usage) {
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        unsigned n = 0;
+
+        assert_se(d = opendir(directory));
+
+        *usage = 0;
+        FOREACH_DIRENT_ALL(de, d, assert_not_reached("readdir() failed")) {
+                struct stat st;
+
+                if (!endswith(de->d_name, ".journal") && !endswith(de->d_name, ".journal~"))
+                        continue;
+
+                assert_se(fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) >= 0);
+                *usage += (uint64_t) st.st_blocks * 512UL;
+                n++;
+        }
+
+        return n;
+}
+
+static void append_and_rotate(JournalFile **f, unsigned n) {
+        static const char test[] = "TEST1=1";
+        struct iovec iovec = IOVEC_MAKE((void*) test, strlen(test));
+        dual_timestamp ts;
+        unsigned i;
+
+        for (i = 0; i < n; i++) {
+                dual_timestamp_get(&ts);
+                assert_se(journal_file_append_entry(*f, &ts, &iovec, 1, NULL, NULL, NULL) == 0);
+                assert_se(journal_file_rotate(f, true, false, NULL) >= 0);
+        }
+}
+
+static void test_vacuum_catalog(void) {
+        _cleanup_(journal_vacuum_catalog_freep) JournalVacuumCatalog *c = NULL;
+        JournalFile *f;
+        char t[] = "/tmp/journal-vacuum-XXXXXX";
+        uint64_t usage, catalog_usage;
+        usec_t oldest = 0;
+        int fd;
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_vacuum_catalog_new(&c, t, true) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, false, NULL, NULL, NULL, NULL, &f) == 0);
+        append_and_rotate(&f, 4);
+
+        /* The first use reads the whole directory */
+        assert_se(count_journal_files(t, &usage) == 5);
+        assert_se(journal_vacuum_catalog_usage(c, &catalog_usage) >= 0);
+        assert_se(catalog_usage == usage);
+
+        assert_se(journal_vacuum_catalog_vacuum(c, 0, 3, 0, &oldest, true) >= 0);
+        assert_se(count_journal_files(t, &usage) == 3);
+        assert_se(oldest > 0);
+
+        /* Later ones only look at what changed. Empty files are always vacuumed. */
+        append_and_rotate(&f, 2);
+        fd = open("test@0000000000000001-0000000000000002.journal~", O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+        assert_se(fd >= 0);
+        safe_close(fd);
+
+        assert_se(count_journal_files(t, &usage) == 6);
+        assert_se(journal_vacuum_catalog_usage(c, &catalog_usage) >= 0);
+        assert_se(catalog_usage == usage);
+
+        assert_se(journal_vacuum_catalog_vacuum(c, 0, 2, 0, NULL, true) >= 0);
+        assert_se(count_journal_files(t, &usage) == 2);
+        assert_se(access("test@0000000000000001-0000000000000002.journal~", F_OK) < 0 && errno == ENOENT);
+
+        assert_se(journal_vacuum_catalog_usage(c, &catalog_usage) >= 0);
+        assert_se(catalog_usage == usage);
+
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
 static void test_empty(void) {
         JournalFile *f1, *f2, *f3, *f4;
         char t[] = "/tmp/journal-XXXXXX";
@@ -172,6 +645,14 @@ int main(int argc, char *argv[]) {
                 return EXIT_TEST_SKIP;
 
         test_non_empty();
+        test_append_entries();
+        test_entry_index();
+        test_data_bloom();
+#ifdef HAVE_ZSTD
+        test_compression_dictionary();
+#endif
+        test_offline_notify();
+        test_vacuum_catalog();
         test_empty();
 
         return 0;
@@ -72,6 +72,35 @@ int main(int argc, char *argv[]) {
 
         assert_se((uint8_t*) p + 1 == (uint8_t*) q);
 
+        /* Both windows were found through the index, none by context */
+        assert_se(mmap_cache_get_missed(m) == 2);
+        assert_se(mmap_cache_get_hit(m) == 3);
+        assert_se(mmap_cache_get_context_hit(m) == 1);
+        assert_se(mmap_cache_get_n_windows(m) == 2);
+
+        /* Small windows for context 2, which still finds the large ones */
+        assert_se(mmap_cache_set_window_size(m, 2, page_size() + 1) == -EINVAL);
+        assert_se(mmap_cache_set_window_size(m, 2, page_size()) == 0);
+
+        r = mmap_cache_get(m, fx, PROT_READ, 2, false, 16ULL*1024ULL*1024ULL+2, 2, NULL, &q, NULL);
+        assert_se(r >= 0);
+        assert_se((uint8_t*) p + 2 == (uint8_t*) q);
+        assert_se(mmap_cache_get_missed(m) == 2);
+
+        r = mmap_cache_get(m, fx, PROT_READ, 2, false, 64ULL*1024ULL*1024ULL, 2, NULL, &p, NULL);
+        assert_se(r >= 0);
+        assert_se(mmap_cache_get_missed(m) == 3);
+
+        /* Objects crossing the end of a slot get a window covering both slots */
+        r = mmap_cache_get(m, fx, PROT_READ, 2, false, 64ULL*1024ULL*1024ULL + page_size() - 1, 2, NULL, &q, NULL);
+        assert_se(r >= 0);
+        assert_se(mmap_cache_get_missed(m) == 4);
+
+        r = mmap_cache_get(m, fx, PROT_READ, 2, false, 64ULL*1024ULL*1024ULL + page_size() - 2, 2, NULL, &p, NULL);
+        assert_se(r >= 0);
+        assert_se((uint8_t*) p + 1 == (uint8_t*) q);
+        assert_se(mmap_cache_get_missed(m) == 4);
+
         mmap_cache_free_fd(m, fx);
         mmap_cache_unref(m);
 
@@ -66,7 +66,7 @@ struct sd_dhcp_server {
         bool emit_router;
 
         Hashmap *leases_by_client_id;
-        DHCPLease **bound_leases;
+        Hashmap *bound_leases_by_address;
         DHCPLease invalid_lease;
 
         uint32_t max_lease_time, default_lease_time;
@@ -1373,6 +1373,16 @@ static uint64_t client_compute_timeout(sd_dhcp_client *client, uint32_t lifetime
                 + (random_u32() & 0x1fffff);
 }
 
+static usec_t client_compute_timeout_accuracy(usec_t time_now, usec_t timeout) {
+        /* The renewal timers of typical leases fire hours after they were armed, and hosts running many clients
+         * would otherwise wake up separately for each of them. Allow the event loop to coalesce them, by a small
+         * fraction of the time left only, so that they stay well ordered even for very short leases. */
+        if (timeout <= time_now)
+                return 10 * USEC_PER_MSEC;
+
+        return CLAMP((timeout - time_now) / 32, 10 * USEC_PER_MSEC, 10 * USEC_PER_SEC);
+}
+
 static int client_set_lease_timeouts(sd_dhcp_client *client) {
         usec_t time_now;
         uint64_t lifetime_timeout;
@@ -1472,7 +1482,7 @@ static int client_set_lease_timeouts(sd_dhcp_client *client) {
                               &client->timeout_t2,
                               clock_boottime_or_monotonic(),
                               t2_timeout,
-                              10 * USEC_PER_MSEC,
+                              client_compute_timeout_accuracy(time_now, t2_timeout),
                               client_timeout_t2, client);
         if (r < 0)
                 return r;
@@ -1497,7 +1507,8 @@ static int client_set_lease_timeouts(sd_dhcp_client *client) {
         r = sd_event_add_time(client->event,
                               &client->timeout_t1,
                               clock_boottime_or_monotonic(),
-                              t1_timeout, 10 * USEC_PER_MSEC,
+                              t1_timeout,
+                              client_compute_timeout_accuracy(time_now, t1_timeout),
                               client_timeout_t1, client);
         if (r < 0)
                 return r;
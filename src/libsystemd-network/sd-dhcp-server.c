@@ -34,6 +34,8 @@
 #define DHCP_DEFAULT_LEASE_TIME_USEC USEC_PER_HOUR
 #define DHCP_MAX_LEASE_TIME_USEC (USEC_PER_HOUR*12)
 
+#define SERVER_RECEIVE_BATCH_MAX 64U
+
 static void dhcp_lease_free(DHCPLease *lease) {
         if (!lease)
                 return;
@@ -50,6 +52,7 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
         struct in_addr netmask_addr;
         be32_t netmask;
         uint32_t server_off, broadcast_off, size_max;
+        int r;
 
         assert_return(server, -EINVAL);
         assert_return(address, -EINVAL);
@@ -88,10 +91,7 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
         if (server->address != address->s_addr || server->netmask != netmask || server->pool_size != size || server->pool_offset != offset) {
                 DHCPLease *lease;
 
-                free(server->bound_leases);
-                server->bound_leases = new0(DHCPLease*, size);
-                if (!server->bound_leases)
-                        return -ENOMEM;
+                hashmap_clear(server->bound_leases_by_address);
 
                 server->pool_offset = offset;
                 server->pool_size = size;
@@ -100,8 +100,11 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
                 server->netmask = netmask;
                 server->subnet = address->s_addr & netmask;
 
-                if (server_off >= offset && server_off - offset < size)
-                        server->bound_leases[server_off - offset] = &server->invalid_lease;
+                if (server_off >= offset && server_off - offset < size) {
+                        r = hashmap_put(server->bound_leases_by_address, UINT32_TO_PTR(server->address), &server->invalid_lease);
+                        if (r < 0)
+                                return r;
+                }
 
                 /* Drop any leases associated with the old address range */
                 while ((lease = hashmap_steal_first(server->leases_by_client_id)))
@@ -185,7 +188,7 @@ sd_dhcp_server *sd_dhcp_server_unref(sd_dhcp_server *server) {
                 dhcp_lease_free(lease);
         hashmap_free(server->leases_by_client_id);
 
-        free(server->bound_leases);
+        hashmap_free(server->bound_leases_by_address);
         return mfree(server);
 }
 
@@ -210,6 +213,10 @@ int sd_dhcp_server_new(sd_dhcp_server **ret, int ifindex) {
         if (!server->leases_by_client_id)
                 return -ENOMEM;
 
+        server->bound_leases_by_address = hashmap_new(NULL);
+        if (!server->bound_leases_by_address)
+                return -ENOMEM;
+
         server->default_lease_time = DIV_ROUND_UP(DHCP_DEFAULT_LEASE_TIME_USEC, USEC_PER_SEC);
         server->max_lease_time = DIV_ROUND_UP(DHCP_MAX_LEASE_TIME_USEC, USEC_PER_SEC);
 
@@ -775,8 +782,11 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                         next_offer = hash % server->pool_size;
 
                         for (i = 0; i < server->pool_size; i++) {
-                                if (!server->bound_leases[next_offer]) {
-                                        address = server->subnet | htobe32(server->pool_offset + next_offer);
+                                be32_t a;
+
+                                a = server->subnet | htobe32(server->pool_offset + next_offer);
+                                if (!hashmap_contains(server->bound_leases_by_address, UINT32_TO_PTR(a))) {
+                                        address = a;
                                         break;
                                 } else
                                         next_offer = (next_offer + 1) % server->pool_size;
@@ -863,7 +873,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                 /* verify that the requested address is from the pool, and either
                    owned by the current client or free */
                 if (pool_offset >= 0 &&
-                    server->bound_leases[pool_offset] == existing_lease) {
+                    hashmap_get(server->bound_leases_by_address, UINT32_TO_PTR(address)) == existing_lease) {
                         DHCPLease *lease;
                         usec_t time_now = 0;
 
@@ -910,7 +920,13 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                                 log_dhcp_server(server, "ACK (0x%x)",
                                                 be32toh(req->message->xid));
 
-                                server->bound_leases[pool_offset] = lease;
+                                r = hashmap_put(server->bound_leases_by_address, UINT32_TO_PTR(address), lease);
+                                if (r < 0) {
+                                        if (!existing_lease)
+                                                dhcp_lease_free(lease);
+                                        return r;
+                                }
+
                                 hashmap_put(server->leases_by_client_id,
                                             &lease->client_id, lease);
 
@@ -949,8 +965,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                 if (pool_offset < 0)
                         return 0;
 
-                if (server->bound_leases[pool_offset] == existing_lease) {
-                        server->bound_leases[pool_offset] = NULL;
+                if (hashmap_remove_value(server->bound_leases_by_address, UINT32_TO_PTR(existing_lease->address), existing_lease)) {
                         hashmap_remove(server->leases_by_client_id, existing_lease);
                         dhcp_lease_free(existing_lease);
 
@@ -963,11 +978,9 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
         return 0;
 }
 
-static int server_receive_message(sd_event_source *s, int fd,
-                                  uint32_t revents, void *userdata) {
+static int server_receive_one(sd_dhcp_server *server, int fd) {
         _cleanup_free_ DHCPMessage *message = NULL;
         uint8_t cmsgbuf[CMSG_LEN(sizeof(struct in_pktinfo))];
-        sd_dhcp_server *server = userdata;
         struct iovec iov = {};
         struct msghdr msg = {
                 .msg_iov = &iov,
@@ -994,7 +1007,7 @@ static int server_receive_message(sd_event_source *s, int fd,
         len = recvmsg(fd, &msg, 0);
         if (len < 0) {
                 if (errno == EAGAIN || errno == EINTR)
-                        return 0;
+                        return -EAGAIN;
 
                 return -errno;
         } else if ((size_t)len < sizeof(DHCPMessage))
@@ -1018,6 +1031,27 @@ static int server_receive_message(sd_event_source *s, int fd,
         return dhcp_server_handle_message(server, message, (size_t)len);
 }
 
+static int server_receive_message(sd_event_source *s, int fd,
+                                  uint32_t revents, void *userdata) {
+        sd_dhcp_server *server = userdata;
+        unsigned i;
+        int r;
+
+        assert(server);
+
+        /* When lots of clients come up at the same time, process a bunch of the queued requests per
+         * wakeup rather than going back to the event loop for each one of them. */
+        for (i = 0; i < SERVER_RECEIVE_BATCH_MAX; i++) {
+                r = server_receive_one(server, fd);
+                if (r == -EAGAIN)
+                        break;
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 int sd_dhcp_server_start(sd_dhcp_server *server) {
         int r;
 
@@ -1064,16 +1098,14 @@ int sd_dhcp_server_start(sd_dhcp_server *server) {
 }
 
 int sd_dhcp_server_forcerenew(sd_dhcp_server *server) {
-        unsigned i;
+        DHCPLease *lease;
+        Iterator i;
         int r = 0;
 
         assert_return(server, -EINVAL);
-        assert(server->bound_leases);
-
-        for (i = 0; i < server->pool_size; i++) {
-                DHCPLease *lease = server->bound_leases[i];
 
-                if (!lease || lease == &server->invalid_lease)
+        HASHMAP_FOREACH(lease, server->bound_leases_by_address, i) {
+                if (lease == &server->invalid_lease)
                         continue;
 
                 r = server_send_forcerenew(server, lease->address,
@@ -244,10 +244,121 @@ _public_ int sd_bus_list_names(sd_bus *bus, char ***acquired, char ***activatabl
         return bus_list_names_dbus1(bus, acquired, activatable);
 }
 
+/* Upper bound for the number of peers whose credentials we remember */
+#define CREDS_CACHE_MAX 512U
+
+static struct creds_cache_entry *creds_cache_entry_free(struct creds_cache_entry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->unique_name);
+        free(e->label);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct creds_cache_entry*, creds_cache_entry_free);
+
+void bus_creds_cache_flush(sd_bus *bus) {
+        struct creds_cache_entry *e;
+
+        assert(bus);
+
+        while ((e = hashmap_steal_first(bus->creds_cache)))
+                creds_cache_entry_free(e);
+}
+
+void bus_creds_cache_process(sd_bus *bus, sd_bus_message *m) {
+        const char *name = NULL, *new_owner = NULL;
+
+        assert(bus);
+        assert(m);
+
+        /* Once a peer is gone, its credentials are of no use anymore. We don't install a match for this,
+         * but if the signal comes along anyway, let's use it. */
+
+        if (hashmap_isempty(bus->creds_cache))
+                return;
+
+        if (!sd_bus_message_is_signal(m, "org.freedesktop.DBus", "NameOwnerChanged") ||
+            !streq_ptr(m->sender, "org.freedesktop.DBus"))
+                return;
+
+        if (bus_message_get_arg(m, 0, &name) < 0 || !name || name[0] != ':')
+                return;
+        if (bus_message_get_arg(m, 2, &new_owner) < 0 || !isempty(new_owner))
+                return;
+
+        creds_cache_entry_free(hashmap_remove(bus->creds_cache, name));
+}
+
+static int creds_cache_store(
+                sd_bus *bus,
+                const char *unique,
+                bool have_pid, pid_t pid,
+                bool have_euid, uid_t euid,
+                const char *label) {
+
+        _cleanup_(creds_cache_entry_freep) struct creds_cache_entry *n = NULL;
+        struct creds_cache_entry *e;
+        int r;
+
+        assert(bus);
+        assert(unique);
+
+        e = hashmap_get(bus->creds_cache, unique);
+        if (!e) {
+                if (hashmap_size(bus->creds_cache) >= CREDS_CACHE_MAX)
+                        bus_creds_cache_flush(bus);
+
+                r = hashmap_ensure_allocated(&bus->creds_cache, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                n = new0(struct creds_cache_entry, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                n->unique_name = strdup(unique);
+                if (!n->unique_name)
+                        return -ENOMEM;
+
+                e = n;
+        }
+
+        if (have_pid) {
+                e->pid = pid;
+                e->mask |= SD_BUS_CREDS_PID;
+        }
+
+        if (have_euid) {
+                e->euid = euid;
+                e->mask |= SD_BUS_CREDS_EUID;
+        }
+
+        if (label) {
+                r = free_and_strdup(&e->label, label);
+                if (r < 0)
+                        return r;
+
+                e->mask |= SD_BUS_CREDS_SELINUX_CONTEXT;
+        }
+
+        if (n) {
+                r = hashmap_put(bus->creds_cache, n->unique_name, n);
+                if (r < 0)
+                        return r;
+
+                n = NULL;
+        }
+
+        return 0;
+}
+
 static int bus_get_name_creds_dbus1(
                 sd_bus *bus,
                 const char *name,
                 uint64_t mask,
+                bool use_cache,
                 sd_bus_creds **creds) {
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply_unique = NULL, *reply = NULL;
@@ -279,7 +390,10 @@ static int bus_get_name_creds_dbus1(
 
         if (mask != 0) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-                bool need_pid, need_uid, need_selinux, need_separate_calls;
+                bool need_pid, need_uid, need_selinux, need_separate_calls, fetch_pid, fetch_uid;
+                struct creds_cache_entry *e = NULL;
+                const char *cache_key = NULL;
+
                 c = bus_creds_new();
                 if (!c)
                         return -ENOMEM;
@@ -305,6 +419,50 @@ static int bus_get_name_creds_dbus1(
                 need_uid = mask & SD_BUS_CREDS_EUID;
                 need_selinux = mask & SD_BUS_CREDS_SELINUX_CONTEXT;
 
+                /* The bus reports the credentials a peer had when it connected, hence they are fixed for
+                 * a unique name, and unique names are never reused. Only the data from /proc is not. */
+                if (use_cache) {
+                        cache_key = unique ?: (name[0] == ':' ? name : NULL);
+                        e = cache_key ? hashmap_get(bus->creds_cache, cache_key) : NULL;
+                }
+
+                if (e) {
+                        if (need_pid && (e->mask & SD_BUS_CREDS_PID)) {
+                                pid = e->pid;
+                                if (mask & SD_BUS_CREDS_PID) {
+                                        c->pid = e->pid;
+                                        c->mask |= SD_BUS_CREDS_PID;
+                                }
+
+                                need_pid = false;
+                        }
+
+                        if (need_uid && (e->mask & SD_BUS_CREDS_EUID)) {
+                                c->euid = e->euid;
+                                c->mask |= SD_BUS_CREDS_EUID;
+                                need_uid = false;
+                        }
+
+                        if (need_selinux && (e->mask & SD_BUS_CREDS_SELINUX_CONTEXT)) {
+                                c->label = strdup(e->label);
+                                if (!c->label)
+                                        return -ENOMEM;
+
+                                c->mask |= SD_BUS_CREDS_SELINUX_CONTEXT;
+                                need_selinux = false;
+                        }
+                }
+
+                if (cache_key) {
+                        if (need_pid || need_uid || need_selinux)
+                                bus->creds_cache_misses++;
+                        else
+                                bus->creds_cache_hits++;
+                }
+
+                fetch_pid = need_pid;
+                fetch_uid = need_uid;
+
                 if (need_pid + need_uid + need_selinux > 1) {
 
                         /* If we need more than one of the credentials, then use GetConnectionCredentials() */
@@ -505,6 +663,15 @@ static int bus_get_name_creds_dbus1(
                         }
                 }
 
+                if (cache_key && (fetch_pid || fetch_uid || need_selinux)) {
+                        r = creds_cache_store(bus, cache_key,
+                                              fetch_pid && pid > 0, pid,
+                                              fetch_uid && (c->mask & SD_BUS_CREDS_EUID), c->euid,
+                                              need_selinux ? c->label : NULL);
+                        if (r < 0)
+                                return r;
+                }
+
                 r = bus_creds_add_more(c, mask, pid, 0);
                 if (r < 0)
                         return r;
@@ -518,18 +685,15 @@ static int bus_get_name_creds_dbus1(
         return 0;
 }
 
-_public_ int sd_bus_get_name_creds(
+int bus_get_name_creds(
                 sd_bus *bus,
                 const char *name,
                 uint64_t mask,
+                bool use_cache,
                 sd_bus_creds **creds) {
 
-        assert_return(bus, -EINVAL);
-        assert_return(name, -EINVAL);
-        assert_return((mask & ~SD_BUS_CREDS_AUGMENT) <= _SD_BUS_CREDS_ALL, -EOPNOTSUPP);
-        assert_return(mask == 0 || creds, -EINVAL);
-        assert_return(!bus_pid_changed(bus), -ECHILD);
-        assert_return(service_name_is_valid(name), -EINVAL);
+        assert(bus);
+        assert(name);
 
         if (!bus->bus_client)
                 return -EINVAL;
@@ -548,7 +712,23 @@ _public_ int sd_bus_get_name_creds(
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
-        return bus_get_name_creds_dbus1(bus, name, mask, creds);
+        return bus_get_name_creds_dbus1(bus, name, mask, use_cache, creds);
+}
+
+_public_ int sd_bus_get_name_creds(
+                sd_bus *bus,
+                const char *name,
+                uint64_t mask,
+                sd_bus_creds **creds) {
+
+        assert_return(bus, -EINVAL);
+        assert_return(name, -EINVAL);
+        assert_return((mask & ~SD_BUS_CREDS_AUGMENT) <= _SD_BUS_CREDS_ALL, -EOPNOTSUPP);
+        assert_return(mask == 0 || creds, -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+        assert_return(service_name_is_valid(name), -EINVAL);
+
+        return bus_get_name_creds(bus, name, mask, false, creds);
 }
 
 static int bus_get_owner_creds_dbus1(sd_bus *bus, uint64_t mask, sd_bus_creds **ret) {
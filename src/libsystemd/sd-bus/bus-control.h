@@ -25,3 +25,8 @@
 
 int bus_add_match_internal(sd_bus *bus, const char *match, struct bus_match_component *components, unsigned n_components);
 int bus_remove_match_internal(sd_bus *bus, const char *match);
+
+int bus_get_name_creds(sd_bus *bus, const char *name, uint64_t mask, bool use_cache, sd_bus_creds **creds);
+
+void bus_creds_cache_flush(sd_bus *bus);
+void bus_creds_cache_process(sd_bus *bus, sd_bus_message *m);
@@ -598,5 +598,6 @@ int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
                 snaplen -= w;
         }
 
-        return fflush_and_check(f);
+        /* Flushing is left to the caller, which knows when no further messages are queued */
+        return ferror(f) ? -EIO : 0;
 }
@@ -21,233 +21,143 @@
 #include "bus-signature.h"
 #include "bus-type.h"
 
-int bus_gvariant_get_size(const char *signature) {
+int bus_gvariant_get_layout(const char *signature, size_t l, int *ret_alignment, int *ret_size) {
+        size_t alignment = 1, sum = 0;
+        bool fixed = true;
         const char *p;
-        int sum = 0, r;
+        int r;
 
-        /* For fixed size structs. Fails for variable size structs. */
+        /* Determines alignment and fixed size of the first l characters of the signature in one pass. The
+         * size is returned as negative for variable size types. */
+
+        assert(signature);
 
         p = signature;
-        while (*p != 0) {
+        while (p < signature + l) {
+                int a, sz;
                 size_t n;
 
                 r = signature_element_length(p, &n);
                 if (r < 0)
                         return r;
-                else {
-                        char t[n+1];
-
-                        memcpy(t, p, n);
-                        t[n] = 0;
-
-                        r = bus_gvariant_get_alignment(t);
-                        if (r < 0)
-                                return r;
-
-                        sum = ALIGN_TO(sum, r);
-                }
+                if (n > (size_t) (signature + l - p))
+                        return -EINVAL;
 
                 switch (*p) {
 
                 case SD_BUS_TYPE_BOOLEAN:
                 case SD_BUS_TYPE_BYTE:
-                        sum += 1;
+                        a = sz = 1;
                         break;
 
                 case SD_BUS_TYPE_INT16:
                 case SD_BUS_TYPE_UINT16:
-                        sum += 2;
+                        a = sz = 2;
                         break;
 
                 case SD_BUS_TYPE_INT32:
                 case SD_BUS_TYPE_UINT32:
                 case SD_BUS_TYPE_UNIX_FD:
-                        sum += 4;
+                        a = sz = 4;
                         break;
 
                 case SD_BUS_TYPE_INT64:
                 case SD_BUS_TYPE_UINT64:
                 case SD_BUS_TYPE_DOUBLE:
-                        sum += 8;
-                        break;
-
-                case SD_BUS_TYPE_STRUCT_BEGIN:
-                case SD_BUS_TYPE_DICT_ENTRY_BEGIN: {
-                        if (n == 2) {
-                                /* unary type () has fixed size of 1 */
-                                r = 1;
-                        } else {
-                                char t[n-1];
-
-                                memcpy(t, p + 1, n - 2);
-                                t[n - 2] = 0;
-
-                                r = bus_gvariant_get_size(t);
-                                if (r < 0)
-                                        return r;
-                        }
-
-                        sum += r;
+                        a = sz = 8;
                         break;
-                }
-
-                case SD_BUS_TYPE_STRING:
-                case SD_BUS_TYPE_OBJECT_PATH:
-                case SD_BUS_TYPE_SIGNATURE:
-                case SD_BUS_TYPE_ARRAY:
-                case SD_BUS_TYPE_VARIANT:
-                        return -EINVAL;
-
-                default:
-                        assert_not_reached("Unknown signature type");
-                }
-
-                p += n;
-        }
-
-        r = bus_gvariant_get_alignment(signature);
-        if (r < 0)
-                return r;
-
-        return ALIGN_TO(sum, r);
-}
-
-int bus_gvariant_get_alignment(const char *signature) {
-        size_t alignment = 1;
-        const char *p;
-        int r;
-
-        p = signature;
-        while (*p != 0 && alignment < 8) {
-                size_t n;
-                int a;
-
-                r = signature_element_length(p, &n);
-                if (r < 0)
-                        return r;
-
-                switch (*p) {
 
-                case SD_BUS_TYPE_BYTE:
-                case SD_BUS_TYPE_BOOLEAN:
                 case SD_BUS_TYPE_STRING:
                 case SD_BUS_TYPE_OBJECT_PATH:
                 case SD_BUS_TYPE_SIGNATURE:
                         a = 1;
+                        sz = -1;
                         break;
 
-                case SD_BUS_TYPE_INT16:
-                case SD_BUS_TYPE_UINT16:
-                        a = 2;
-                        break;
-
-                case SD_BUS_TYPE_INT32:
-                case SD_BUS_TYPE_UINT32:
-                case SD_BUS_TYPE_UNIX_FD:
-                        a = 4;
-                        break;
-
-                case SD_BUS_TYPE_INT64:
-                case SD_BUS_TYPE_UINT64:
-                case SD_BUS_TYPE_DOUBLE:
                 case SD_BUS_TYPE_VARIANT:
                         a = 8;
+                        sz = -1;
                         break;
 
-                case SD_BUS_TYPE_ARRAY: {
-                        char t[n];
-
-                        memcpy(t, p + 1, n - 1);
-                        t[n - 1] = 0;
+                case SD_BUS_TYPE_ARRAY:
+                        r = bus_gvariant_get_layout(p + 1, n - 1, &a, NULL);
+                        if (r < 0)
+                                return r;
 
-                        a = bus_gvariant_get_alignment(t);
+                        sz = -1;
                         break;
-                }
 
                 case SD_BUS_TYPE_STRUCT_BEGIN:
-                case SD_BUS_TYPE_DICT_ENTRY_BEGIN: {
-                        char t[n-1];
-
-                        memcpy(t, p + 1, n - 2);
-                        t[n - 2] = 0;
+                case SD_BUS_TYPE_DICT_ENTRY_BEGIN:
+                        if (n == 2) {
+                                /* unary type () has fixed size of 1 */
+                                a = sz = 1;
+                                break;
+                        }
 
-                        a = bus_gvariant_get_alignment(t);
+                        r = bus_gvariant_get_layout(p + 1, n - 2, &a, &sz);
+                        if (r < 0)
+                                return r;
                         break;
-                }
 
                 default:
                         assert_not_reached("Unknown signature type");
                 }
 
-                if (a < 0)
-                        return a;
-
                 assert(a > 0 && a <= 8);
                 if ((size_t) a > alignment)
                         alignment = (size_t) a;
 
+                if (sz < 0)
+                        fixed = false;
+                else
+                        sum = ALIGN_TO(sum, (size_t) a) + sz;
+
                 p += n;
         }
 
-        return alignment;
-}
-
-int bus_gvariant_is_fixed_size(const char *signature) {
-        const char *p;
-        int r;
+        if (ret_alignment)
+                *ret_alignment = (int) alignment;
+        if (ret_size)
+                *ret_size = fixed ? (int) ALIGN_TO(sum, alignment) : -1;
 
-        assert(signature);
+        return 0;
+}
 
-        p = signature;
-        while (*p != 0) {
-                size_t n;
+int bus_gvariant_get_size(const char *signature) {
+        int r, sz;
 
-                r = signature_element_length(p, &n);
-                if (r < 0)
-                        return r;
+        /* For fixed size structs. Fails for variable size structs. */
 
-                switch (*p) {
+        r = bus_gvariant_get_layout(signature, strlen(signature), NULL, &sz);
+        if (r < 0)
+                return r;
+        if (sz < 0)
+                return -EINVAL;
 
-                case SD_BUS_TYPE_STRING:
-                case SD_BUS_TYPE_OBJECT_PATH:
-                case SD_BUS_TYPE_SIGNATURE:
-                case SD_BUS_TYPE_ARRAY:
-                case SD_BUS_TYPE_VARIANT:
-                        return 0;
+        return sz;
+}
 
-                case SD_BUS_TYPE_BYTE:
-                case SD_BUS_TYPE_BOOLEAN:
-                case SD_BUS_TYPE_INT16:
-                case SD_BUS_TYPE_UINT16:
-                case SD_BUS_TYPE_INT32:
-                case SD_BUS_TYPE_UINT32:
-                case SD_BUS_TYPE_UNIX_FD:
-                case SD_BUS_TYPE_INT64:
-                case SD_BUS_TYPE_UINT64:
-                case SD_BUS_TYPE_DOUBLE:
-                        break;
+int bus_gvariant_get_alignment(const char *signature) {
+        int r, alignment;
 
-                case SD_BUS_TYPE_STRUCT_BEGIN:
-                case SD_BUS_TYPE_DICT_ENTRY_BEGIN: {
-                        char t[n-1];
+        r = bus_gvariant_get_layout(signature, strlen(signature), &alignment, NULL);
+        if (r < 0)
+                return r;
 
-                        memcpy(t, p + 1, n - 2);
-                        t[n - 2] = 0;
+        return alignment;
+}
 
-                        r = bus_gvariant_is_fixed_size(t);
-                        if (r <= 0)
-                                return r;
-                        break;
-                }
+int bus_gvariant_is_fixed_size(const char *signature) {
+        int r, sz;
 
-                default:
-                        assert_not_reached("Unknown signature type");
-                }
+        assert(signature);
 
-                p += n;
-        }
+        r = bus_gvariant_get_layout(signature, strlen(signature), NULL, &sz);
+        if (r < 0)
+                return r;
 
-        return true;
+        return sz >= 0;
 }
 
 size_t bus_gvariant_determine_word_size(size_t sz, size_t extra) {
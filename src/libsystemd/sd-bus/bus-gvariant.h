@@ -21,6 +21,7 @@
 
 #include "macro.h"
 
+int bus_gvariant_get_layout(const char *signature, size_t l, int *ret_alignment, int *ret_size);
 int bus_gvariant_get_size(const char *signature) _pure_;
 int bus_gvariant_get_alignment(const char *signature) _pure_;
 int bus_gvariant_is_fixed_size(const char *signature) _pure_;
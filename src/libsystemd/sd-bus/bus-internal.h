@@ -121,6 +121,26 @@ struct vtable_member {
         const sd_bus_vtable *vtable;
 };
 
+struct creds_cache_entry {
+        char *unique_name;
+
+        /* Which of the fields below are known */
+        uint64_t mask;
+
+        pid_t pid;
+        uid_t euid;
+        char *label;
+};
+
+struct property_cache_entry {
+        /* The object the body was generated for, and how many vtables contributed to it */
+        void *userdata;
+        unsigned n_vtables;
+
+        size_t size;
+        uint8_t body[];
+};
+
 typedef enum BusSlotType {
         BUS_REPLY_CALLBACK,
         BUS_FILTER_CALLBACK,
@@ -206,6 +226,8 @@ struct sd_bus {
         bool is_user:1;
         bool allow_interactive_authorization:1;
         bool exit_on_disconnect:1;
+        bool corked:1;
+        bool method_stats_enabled:1;
         bool exited:1;
         bool exit_triggered:1;
         bool is_local:1;
@@ -237,6 +259,13 @@ struct sd_bus {
         Hashmap *nodes;
         Hashmap *vtable_methods;
         Hashmap *vtable_properties;
+        Hashmap *property_cache;
+
+        Hashmap *creds_cache;
+        uint64_t creds_cache_hits, creds_cache_misses;
+
+        /* struct bus_method_stats per interface and member, only freed with the bus */
+        Hashmap *method_stats;
 
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
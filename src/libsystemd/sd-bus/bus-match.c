@@ -68,10 +68,19 @@ static inline bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
         return t >= BUS_MATCH_SENDER && t <= BUS_MATCH_ARG_HAS_LAST;
 }
 
+static inline bool BUS_MATCH_BY_PREFIX(enum bus_match_node_type t) {
+        return t == BUS_MATCH_PATH_NAMESPACE ||
+                (t >= BUS_MATCH_ARG_PATH && t <= BUS_MATCH_ARG_PATH_LAST) ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST);
+}
+
 static inline bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
+        /* The prefix matches are hashed too, we then look up every prefix of the tested value that could
+         * match, see bus_match_run_prefixes() below. */
         return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
                 (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST) ||
-                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
+                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST) ||
+                BUS_MATCH_BY_PREFIX(t);
 }
 
 static void bus_match_node_free(struct bus_match_node *node) {
@@ -255,6 +264,111 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_found(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *key,
+                sd_bus_message *m) {
+
+        struct bus_match_node *found;
+
+        found = hashmap_get(node->compare.children, key);
+        if (!found)
+                return 0;
+
+        return bus_match_run(bus, found, m);
+}
+
+static int bus_match_run_prefixes(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *buf = NULL;
+        bool simple;
+        char separator;
+        size_t i, l;
+        int r;
+
+        assert(node);
+        assert(BUS_MATCH_BY_PREFIX(node->type));
+
+        if (!test_str)
+                return 0;
+
+        /* Instead of testing every value node, look up the value itself and each of its prefixes ending
+         * right before or right after a separator, as only those can match. See simple_pattern_check()
+         * and complex_pattern_check() for the rules. Prefixes not ending in a separator only match the
+         * simple patterns, i.e. path_namespace= and argNnamespace=. */
+
+        simple = node->type == BUS_MATCH_PATH_NAMESPACE ||
+                (node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST);
+        separator = node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST ? '.' : '/';
+
+        r = bus_match_run_found(bus, node, test_str, m);
+        if (r != 0)
+                return r;
+        if (bus && bus->match_callbacks_modified)
+                return 0;
+
+        buf = strdup(test_str);
+        if (!buf)
+                return -ENOMEM;
+
+        l = strlen(buf);
+        for (i = 0; i < l; i++) {
+                char c;
+
+                if (buf[i] != separator)
+                        continue;
+
+                /* After a doubled separator the prefix ending before this one was already looked up as
+                 * the one ending after the previous separator, don't run it twice. */
+                if (simple && (i == 0 || buf[i-1] != separator)) {
+                        buf[i] = 0;
+                        r = bus_match_run_found(bus, node, buf, m);
+                        buf[i] = separator;
+                        if (r != 0)
+                                return r;
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+
+                if (i + 1 < l) {
+                        c = buf[i+1];
+                        buf[i+1] = 0;
+                        r = bus_match_run_found(bus, node, buf, m);
+                        buf[i+1] = c;
+                        if (r != 0)
+                                return r;
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+        }
+
+        /* argNpath= also matches if the value is a prefix of the pattern ending in a separator, those
+         * cannot be looked up by hashing the value. */
+        if (!simple && l > 0 && buf[l-1] == separator) {
+                struct bus_match_node *n;
+                Iterator j;
+
+                HASHMAP_FOREACH(n, node->compare.children, j) {
+                        if (strlen(n->value.str) <= l || !startswith(n->value.str, buf))
+                                continue;
+
+                        r = bus_match_run(bus, n, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+        }
+
+        return 0;
+}
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -387,7 +501,11 @@ int bus_match_run(
                 assert_not_reached("Unknown match type.");
         }
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_BY_PREFIX(node->type)) {
+                r = bus_match_run_prefixes(bus, node, test_str, m);
+                if (r != 0)
+                        return r;
+        } else if (BUS_MATCH_CAN_HASH(node->type)) {
                 struct bus_match_node *found;
 
                 /* Lookup via hash table, nice! So let's jump directly. */
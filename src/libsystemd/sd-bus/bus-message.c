@@ -723,6 +723,8 @@ static int message_new_reply(
 
         t->dont_send = !!(call->header->flags & BUS_MESSAGE_NO_REPLY_EXPECTED);
         t->enforced_reply_signature = call->enforced_reply_signature;
+        t->stats = call->stats;
+        t->stats_begin = call->stats_begin;
 
         *m = t;
         return 0;
@@ -1676,6 +1678,31 @@ _public_ int sd_bus_message_append_string_iovec(
         return 0;
 }
 
+static int container_get_element_layout(struct bus_container *c, int *ret_alignment, int *ret_size) {
+        int r;
+
+        assert(c);
+        assert(c->enclosing == SD_BUS_TYPE_ARRAY);
+
+        /* All elements of an array are of the same type, hence there's no need to parse the signature
+         * for each of them again */
+
+        if (!c->element_layout_cached) {
+                r = bus_gvariant_get_layout(strempty(c->signature), strlen(strempty(c->signature)), &c->element_alignment, &c->element_size);
+                if (r < 0)
+                        return r;
+
+                c->element_layout_cached = true;
+        }
+
+        if (ret_alignment)
+                *ret_alignment = c->element_alignment;
+        if (ret_size)
+                *ret_size = c->element_size;
+
+        return 0;
+}
+
 static int bus_message_open_array(
                 sd_bus_message *m,
                 struct bus_container *c,
@@ -1726,20 +1753,18 @@ static int bus_message_open_array(
         }
 
         if (BUS_MESSAGE_IS_GVARIANT(m)) {
-                alignment = bus_gvariant_get_alignment(contents);
-                if (alignment < 0)
-                        return alignment;
+                int sz;
+
+                r = bus_gvariant_get_layout(contents, strlen(contents), &alignment, &sz);
+                if (r < 0)
+                        return r;
 
                 /* Add alignment padding and add to offset list */
                 if (!message_extend_body(m, alignment, 0, false, false))
                         return -ENOMEM;
 
-                r = bus_gvariant_is_fixed_size(contents);
-                if (r < 0)
-                        return r;
-
                 *begin = m->body_size;
-                *need_offsets = r == 0;
+                *need_offsets = sz < 0;
         } else {
                 void *a, *op;
                 size_t os;
@@ -1879,21 +1904,20 @@ static int bus_message_open_struct(
         }
 
         if (BUS_MESSAGE_IS_GVARIANT(m)) {
-                int alignment;
+                int alignment, sz;
 
-                alignment = bus_gvariant_get_alignment(contents);
-                if (alignment < 0)
-                        return alignment;
+                if (c->enclosing == SD_BUS_TYPE_ARRAY)
+                        r = container_get_element_layout(c, &alignment, &sz);
+                else
+                        r = bus_gvariant_get_layout(contents, strlen(contents), &alignment, &sz);
+                if (r < 0)
+                        return r;
 
                 if (!message_extend_body(m, alignment, 0, false, false))
                         return -ENOMEM;
 
-                r = bus_gvariant_is_fixed_size(contents);
-                if (r < 0)
-                        return r;
-
                 *begin = m->body_size;
-                *need_offsets = r == 0;
+                *need_offsets = sz < 0;
         } else {
                 /* Align contents to 8 byte boundary */
                 if (!message_extend_body(m, 8, 0, false, false))
@@ -1940,21 +1964,20 @@ static int bus_message_open_dict_entry(
                 return -ENXIO;
 
         if (BUS_MESSAGE_IS_GVARIANT(m)) {
-                int alignment;
+                int alignment, sz;
 
-                alignment = bus_gvariant_get_alignment(contents);
-                if (alignment < 0)
-                        return alignment;
+                if (c->enclosing == SD_BUS_TYPE_ARRAY)
+                        r = container_get_element_layout(c, &alignment, &sz);
+                else
+                        r = bus_gvariant_get_layout(contents, strlen(contents), &alignment, &sz);
+                if (r < 0)
+                        return r;
 
                 if (!message_extend_body(m, alignment, 0, false, false))
                         return -ENOMEM;
 
-                r = bus_gvariant_is_fixed_size(contents);
-                if (r < 0)
-                        return r;
-
                 *begin = m->body_size;
-                *need_offsets = r == 0;
+                *need_offsets = sz < 0;
         } else {
                 /* Align contents to 8 byte boundary */
                 if (!message_extend_body(m, 8, 0, false, false))
@@ -2027,6 +2050,7 @@ _public_ int sd_bus_message_open_container(
         w->n_offsets = w->offsets_allocated = 0;
         w->offsets = NULL;
         w->need_offsets = need_offsets;
+        w->element_layout_cached = false;
 
         return 0;
 }
@@ -2096,7 +2120,7 @@ static int bus_message_close_struct(sd_bus_message *m, struct bus_container *c,
         unsigned i = 0;
         const char *p;
         uint8_t *a;
-        int r;
+        int r, element_size;
 
         assert(m);
         assert(c);
@@ -2111,25 +2135,19 @@ static int bus_message_close_struct(sd_bus_message *m, struct bus_container *c,
                 r = signature_element_length(p, &n);
                 if (r < 0)
                         return r;
-                else {
-                        char t[n+1];
 
-                        memcpy(t, p, n);
-                        t[n] = 0;
-
-                        r = bus_gvariant_is_fixed_size(t);
-                        if (r < 0)
-                                return r;
-                }
+                r = bus_gvariant_get_layout(p, n, NULL, &element_size);
+                if (r < 0)
+                        return r;
 
                 assert(!c->need_offsets || i <= c->n_offsets);
 
                 /* We need to add an offset for each item that has a
                  * variable size and that is not the last one in the
                  * list */
-                if (r == 0)
+                if (element_size < 0)
                         fixed_size = false;
-                if (r == 0 && p[n] != 0)
+                if (element_size < 0 && p[n] != 0)
                         n_variable++;
 
                 i++;
@@ -2182,20 +2200,15 @@ static int bus_message_close_struct(sd_bus_message *m, struct bus_container *c,
                         r = signature_element_length(p, &n);
                         if (r < 0)
                                 return r;
-                        else {
-                                char t[n+1];
 
-                                memcpy(t, p, n);
-                                t[n] = 0;
+                        r = bus_gvariant_get_layout(p, n, NULL, &element_size);
+                        if (r < 0)
+                                return r;
 
-                                p += n;
+                        p += n;
 
-                                r = bus_gvariant_is_fixed_size(t);
-                                if (r < 0)
-                                        return r;
-                                if (r > 0 || p[0] == 0)
-                                        continue;
-                        }
+                        if (element_size >= 0 || p[0] == 0)
+                                continue;
 
                         k = n_variable - 1 - j;
 
@@ -3143,18 +3156,18 @@ static int container_next_item(sd_bus_message *m, struct bus_container *c, size_
                 return 0;
 
         if (c->enclosing == SD_BUS_TYPE_ARRAY) {
-                int sz;
+                int alignment, sz;
 
-                sz = bus_gvariant_get_size(c->signature);
-                if (sz < 0) {
-                        int alignment;
+                r = container_get_element_layout(c, &alignment, &sz);
+                if (r < 0)
+                        return r;
 
+                if (sz < 0) {
                         if (c->offset_index+1 >= c->n_offsets)
                                 goto end;
 
                         /* Variable-size array */
 
-                        alignment = bus_gvariant_get_alignment(c->signature);
                         assert(alignment > 0);
 
                         *rindex = ALIGN_TO(c->offsets[c->offset_index], alignment);
@@ -3186,13 +3199,10 @@ static int container_next_item(sd_bus_message *m, struct bus_container *c, size_
                 r = signature_element_length(c->signature + c->index + n, &j);
                 if (r < 0)
                         return r;
-                else {
-                        char t[j+1];
-                        memcpy(t, c->signature + c->index + n, j);
-                        t[j] = 0;
 
-                        alignment = bus_gvariant_get_alignment(t);
-                }
+                r = bus_gvariant_get_layout(c->signature + c->index + n, j, &alignment, NULL);
+                if (r < 0)
+                        return r;
 
                 assert(alignment > 0);
 
@@ -3777,22 +3787,16 @@ static int build_struct_offsets(
         p = signature;
         while (*p != 0) {
                 size_t n;
+                int k;
 
                 r = signature_element_length(p, &n);
                 if (r < 0)
                         return r;
-                else {
-                        char t[n+1];
-
-                        memcpy(t, p, n);
-                        t[n] = 0;
-
-                        r = bus_gvariant_is_fixed_size(t);
-                }
 
+                r = bus_gvariant_get_layout(p, n, NULL, &k);
                 if (r < 0)
                         return r;
-                if (r == 0 && p[n] != 0) /* except the last item */
+                if (k < 0 && p[n] != 0) /* except the last item */
                         n_variable++;
                 n_total++;
 
@@ -3819,48 +3823,42 @@ static int build_struct_offsets(
         p = signature;
         while (*p != 0) {
                 size_t n, offset;
-                int k;
+                int k, align;
 
                 r = signature_element_length(p, &n);
                 if (r < 0)
                         return r;
-                else {
-                        char t[n+1];
-
-                        memcpy(t, p, n);
-                        t[n] = 0;
 
-                        k = bus_gvariant_get_size(t);
-                        if (k < 0) {
-                                size_t x;
+                r = bus_gvariant_get_layout(p, n, &align, &k);
+                if (r < 0)
+                        return r;
 
-                                /* variable size */
-                                if (v > 0) {
-                                        v--;
+                if (k < 0) {
+                        size_t x;
 
-                                        x = bus_gvariant_read_word_le((uint8_t*) q + v*sz, sz);
-                                        if (x >= size)
-                                                return -EBADMSG;
-                                        if (m->rindex + x < previous)
-                                                return -EBADMSG;
-                                } else
-                                        /* The last item's end
-                                         * is determined from
-                                         * the start of the
-                                         * offset array */
-                                        x = size - (n_variable * sz);
+                        /* variable size */
+                        if (v > 0) {
+                                v--;
 
-                                offset = m->rindex + x;
+                                x = bus_gvariant_read_word_le((uint8_t*) q + v*sz, sz);
+                                if (x >= size)
+                                        return -EBADMSG;
+                                if (m->rindex + x < previous)
+                                        return -EBADMSG;
+                        } else
+                                /* The last item's end
+                                 * is determined from
+                                 * the start of the
+                                 * offset array */
+                                x = size - (n_variable * sz);
 
-                        } else {
-                                size_t align;
+                        offset = m->rindex + x;
 
-                                /* fixed size */
-                                align = bus_gvariant_get_alignment(t);
-                                assert(align > 0);
+                } else {
+                        /* fixed size */
+                        assert(align > 0);
 
-                                offset = (*n_offsets == 0 ? m->rindex  : ALIGN_TO((*offsets)[*n_offsets-1], align)) + k;
-                        }
+                        offset = (*n_offsets == 0 ? m->rindex  : ALIGN_TO((*offsets)[*n_offsets-1], align)) + k;
                 }
 
                 previous = (*offsets)[(*n_offsets)++] = offset;
@@ -4098,6 +4096,7 @@ _public_ int sd_bus_message_enter_container(sd_bus_message *m,
         w->offsets = offsets;
         w->n_offsets = n_offsets;
         w->offset_index = 0;
+        w->element_layout_cached = false;
 
         return 1;
 }
@@ -5498,6 +5497,44 @@ int bus_message_get_blob(sd_bus_message *m, void **buffer, size_t *sz) {
         return 0;
 }
 
+int bus_message_append_body(sd_bus_message *m, const char *signature, const void *p, size_t sz) {
+        void *a;
+
+        assert(m);
+        assert(signature);
+        assert(p || sz == 0);
+
+        /* Fills an empty message with a body marshalled before, for example from an earlier message with the
+         * same contents. As dbus1 marshalling aligns relative to the beginning of the body, the data may be
+         * copied verbatim. It must not refer to any fds. */
+
+        if (m->sealed)
+                return -EPERM;
+        if (m->poisoned)
+                return -ESTALE;
+        if (BUS_MESSAGE_IS_GVARIANT(m))
+                return -EOPNOTSUPP;
+        if (m->n_containers > 0 || m->body_size > 0 || !isempty(m->root_container.signature))
+                return -EBUSY;
+        if (!signature_is_valid(signature, false))
+                return -EINVAL;
+
+        a = message_extend_body(m, 8, sz, false, false);
+        if (!a)
+                return -ENOMEM;
+
+        memcpy_safe(a, p, sz);
+
+        if (free_and_strdup(&m->root_container.signature, signature) < 0) {
+                m->poisoned = true;
+                return -ENOMEM;
+        }
+
+        m->root_container.index = strlen(signature);
+
+        return 0;
+}
+
 int bus_message_read_strv_extend(sd_bus_message *m, char ***l) {
         const char *s;
         int r;
@@ -47,6 +47,10 @@ struct bus_container {
         size_t *offsets, n_offsets, offsets_allocated, offset_index;
         size_t item_size;
 
+        /* gvariant: layout of the element type if this is an array, computed once on first use */
+        int element_alignment, element_size;
+        bool element_layout_cached:1;
+
         char *peeked_signature;
 };
 
@@ -133,6 +137,10 @@ struct sd_bus_message {
          * from the vtable data */
         const char *enforced_reply_signature;
 
+        /* Statistics: when a call was read, when it (or the call this replies to) was dispatched */
+        usec_t read_usec, stats_begin;
+        struct bus_method_stats *stats;
+
         usec_t timeout;
 
         char sender_buffer[3 + DECIMAL_STR_MAX(uint64_t) + 1];
@@ -189,6 +197,7 @@ static inline bool BUS_MESSAGE_IS_GVARIANT(sd_bus_message *m) {
 
 int bus_message_seal(sd_bus_message *m, uint64_t serial, usec_t timeout);
 int bus_message_get_blob(sd_bus_message *m, void **buffer, size_t *sz);
+int bus_message_append_body(sd_bus_message *m, const char *signature, const void *p, size_t sz);
 int bus_message_read_strv_extend(sd_bus_message *m, char ***l);
 
 int bus_message_from_header(
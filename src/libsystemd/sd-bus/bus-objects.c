@@ -571,6 +571,105 @@ static int invoke_property_set(
         return 1;
 }
 
+/* Upper bound of the number of GetAll() replies we keep around */
+#define PROPERTY_CACHE_MAX 4096U
+
+static struct property_cache_entry *property_cache_get(sd_bus *bus, const char *path, const char *interface) {
+        const char *key;
+
+        assert(bus);
+        assert(path);
+        assert(interface);
+
+        if (hashmap_isempty(bus->property_cache))
+                return NULL;
+
+        /* Interface names never contain a '/', while object paths always start with one, hence the
+         * concatenation of the two is unambiguous. */
+        key = strjoina(interface, path);
+        return hashmap_get(bus->property_cache, key);
+}
+
+static void property_cache_drop(sd_bus *bus, const char *path, const char *interface) {
+        struct property_cache_entry *e;
+        const char *key;
+        char *k = NULL;
+
+        assert(bus);
+        assert(path);
+        assert(interface);
+
+        if (hashmap_isempty(bus->property_cache))
+                return;
+
+        key = strjoina(interface, path);
+        e = hashmap_remove2(bus->property_cache, key, (void**) &k);
+        free(e);
+        free(k);
+}
+
+static int property_cache_put(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                sd_bus_message *reply,
+                unsigned n_vtables,
+                void *userdata) {
+
+        _cleanup_free_ struct property_cache_entry *e = NULL;
+        _cleanup_free_ char *key = NULL;
+        struct bus_body_part *part;
+        uint8_t *p;
+        unsigned i;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(interface);
+        assert(reply);
+
+        if (BUS_MESSAGE_IS_GVARIANT(reply))
+                return 0;
+        if (hashmap_size(bus->property_cache) >= PROPERTY_CACHE_MAX)
+                return 0;
+
+        r = hashmap_ensure_allocated(&bus->property_cache, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        key = strappend(interface, path);
+        if (!key)
+                return -ENOMEM;
+
+        e = malloc(offsetof(struct property_cache_entry, body) + reply->body_size);
+        if (!e)
+                return -ENOMEM;
+
+        e->userdata = userdata;
+        e->n_vtables = n_vtables;
+        e->size = reply->body_size;
+
+        p = e->body;
+        MESSAGE_FOREACH_PART(part, i, reply)
+                p = mempcpy(p, part->data, part->size);
+        assert(p == e->body + e->size);
+
+        r = hashmap_put(bus->property_cache, key, e);
+        if (r < 0)
+                return r;
+
+        key = NULL;
+        e = NULL;
+
+        return 0;
+}
+
+void bus_property_cache_flush(sd_bus *bus) {
+        assert(bus);
+
+        hashmap_clear_free_free(bus->property_cache);
+}
+
 static int property_get_set_callbacks_run(
                 sd_bus *bus,
                 sd_bus_message *m,
@@ -669,6 +768,8 @@ static int property_get_set_callbacks_run(
                 if (r < 0)
                         return bus_maybe_reply_error(m, r, &error);
 
+                property_cache_drop(bus, m->path, c->interface);
+
                 if (bus->nodes_modified)
                         return 0;
 
@@ -781,26 +882,39 @@ static int property_get_all_callbacks_run(
                 bool *found_object) {
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        struct property_cache_entry *cached;
         struct node_vtable *c;
-        bool found_interface;
+        bool found_interface, cacheable;
+        unsigned n_vtables;
+        void *userdata;
         int r;
 
         assert(bus);
         assert(m);
         assert(found_object);
 
+        /* If all vtables of the interface opted into caching, a previously generated body is sent again
+         * as long as the same object is behind the path. The getters are then not called at all. */
+        cached = iface ? property_cache_get(bus, m->path, iface) : NULL;
+
         r = sd_bus_message_new_method_return(m, &reply);
         if (r < 0)
                 return r;
 
-        r = sd_bus_message_open_container(reply, 'a', "{sv}");
-        if (r < 0)
-                return r;
+restart:
+        if (!cached) {
+                r = sd_bus_message_open_container(reply, 'a', "{sv}");
+                if (r < 0)
+                        return r;
+        }
 
         found_interface = !iface ||
                 streq(iface, "org.freedesktop.DBus.Properties") ||
                 streq(iface, "org.freedesktop.DBus.Peer") ||
                 streq(iface, "org.freedesktop.DBus.Introspectable");
+        cacheable = iface;
+        n_vtables = 0;
+        userdata = NULL;
 
         LIST_FOREACH(vtables, c, first) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
@@ -823,6 +937,14 @@ static int property_get_all_callbacks_run(
                         continue;
                 found_interface = true;
 
+                if (!(c->vtable[0].flags & SD_BUS_VTABLE_CACHE_PROPERTIES))
+                        cacheable = false;
+                if (n_vtables++ == 0)
+                        userdata = u;
+
+                if (cached)
+                        continue;
+
                 r = vtable_append_all_properties(bus, reply, m->path, c, u, &error);
                 if (r < 0)
                         return bus_maybe_reply_error(m, r, &error);
@@ -844,9 +966,26 @@ static int property_get_all_callbacks_run(
                 return 1;
         }
 
-        r = sd_bus_message_close_container(reply);
-        if (r < 0)
-                return r;
+        if (cached) {
+                if (!cacheable || cached->n_vtables != n_vtables || cached->userdata != userdata) {
+                        /* The object was replaced behind our back, generate everything anew */
+                        property_cache_drop(bus, m->path, iface);
+                        cached = NULL;
+                        goto restart;
+                }
+
+                r = bus_message_append_body(reply, "a{sv}", cached->body, cached->size);
+                if (r < 0)
+                        return r;
+        } else {
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+
+                /* Not being able to cache this is not fatal, we'll simply generate the body again next time */
+                if (cacheable && n_vtables > 0)
+                        (void) property_cache_put(bus, m->path, iface, reply, n_vtables, userdata);
+        }
 
         r = sd_bus_send(bus, reply, NULL);
         if (r < 0)
@@ -1237,6 +1376,18 @@ static int process_get_managed_objects(
         return 1;
 }
 
+static bool node_has_vtables(struct node *n, bool require_fallback) {
+        struct node_vtable *c;
+
+        assert(n);
+
+        LIST_FOREACH(vtables, c, n->vtables)
+                if (!require_fallback || c->is_fallback)
+                        return true;
+
+        return false;
+}
+
 static int object_find_and_run(
                 sd_bus *bus,
                 sd_bus_message *m,
@@ -1246,6 +1397,7 @@ static int object_find_and_run(
 
         struct node *n;
         struct vtable_member vtable_key, *v;
+        bool has_vtables;
         int r;
 
         assert(bus);
@@ -1267,18 +1419,25 @@ static int object_find_and_run(
         if (!m->interface || !m->member)
                 return 0;
 
-        /* Then, look for a known method */
-        vtable_key.path = (char*) p;
-        vtable_key.interface = m->interface;
-        vtable_key.member = m->member;
+        /* Methods and properties only exist where vtables are registered. When we look at the prefixes of
+         * the path, most often there are none, or none for fallback use, so skip hashing all the strings
+         * of the key (and parsing Properties calls) for nothing. */
+        has_vtables = node_has_vtables(n, require_fallback);
 
-        v = hashmap_get(bus->vtable_methods, &vtable_key);
-        if (v) {
-                r = method_callbacks_run(bus, m, v, require_fallback, found_object);
-                if (r != 0)
-                        return r;
-                if (bus->nodes_modified)
-                        return 0;
+        /* Then, look for a known method */
+        if (has_vtables) {
+                vtable_key.path = (char*) p;
+                vtable_key.interface = m->interface;
+                vtable_key.member = m->member;
+
+                v = hashmap_get(bus->vtable_methods, &vtable_key);
+                if (v) {
+                        r = method_callbacks_run(bus, m, v, require_fallback, found_object);
+                        if (r != 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+                }
         }
 
         /* Then, look for a known property */
@@ -1287,7 +1446,7 @@ static int object_find_and_run(
 
                 get = streq(m->member, "Get");
 
-                if (get || streq(m->member, "Set")) {
+                if (has_vtables && (get || streq(m->member, "Set"))) {
 
                         r = sd_bus_message_rewind(m, true);
                         if (r < 0)
@@ -1306,7 +1465,7 @@ static int object_find_and_run(
                                         return r;
                         }
 
-                } else if (streq(m->member, "GetAll")) {
+                } else if (has_vtables && streq(m->member, "GetAll")) {
                         const char *iface;
 
                         r = sd_bus_message_rewind(m, true);
@@ -1771,6 +1930,16 @@ static int add_object_vtable_internal(
                                 goto fail;
                         }
 
+                        /* If the properties are cached, all changes to them which GetAll() would show need
+                         * to be signalled. Also, cached bodies cannot carry fds. */
+                        if ((vtable[0].flags & SD_BUS_VTABLE_CACHE_PROPERTIES) &&
+                            (strchr(v->x.property.signature, SD_BUS_TYPE_UNIX_FD) ||
+                             (!(v->flags & (SD_BUS_VTABLE_HIDDEN|SD_BUS_VTABLE_PROPERTY_EXPLICIT)) &&
+                              !(v->flags & (SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE|SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))))) {
+                                r = -EINVAL;
+                                goto fail;
+                        }
+
                         m = new0(struct vtable_member, 1);
                         if (!m) {
                                 r = -ENOMEM;
@@ -1812,6 +1981,7 @@ static int add_object_vtable_internal(
         s->node_vtable.node = n;
         LIST_INSERT_AFTER(vtables, n->vtables, existing, &s->node_vtable);
         bus->nodes_modified = true;
+        bus_property_cache_flush(bus);
 
         if (slot)
                 *slot = s;
@@ -2125,6 +2295,8 @@ _public_ int sd_bus_emit_properties_changed_strv(
         if (names && names[0] == NULL)
                 return 0;
 
+        property_cache_drop(bus, path, interface);
+
         do {
                 bus->nodes_modified = false;
 
@@ -2347,6 +2519,9 @@ _public_ int sd_bus_emit_object_added(sd_bus *bus, const char *path) {
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
+        /* The object appears or vanishes, don't trust anything we cached for it anymore */
+        bus_property_cache_flush(bus);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2517,6 +2692,9 @@ _public_ int sd_bus_emit_object_removed(sd_bus *bus, const char *path) {
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
+        /* The object appears or vanishes, don't trust anything we cached for it anymore */
+        bus_property_cache_flush(bus);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2673,6 +2851,9 @@ _public_ int sd_bus_emit_interfaces_added_strv(sd_bus *bus, const char *path, ch
         if (strv_isempty(interfaces))
                 return 0;
 
+        /* The object appears or vanishes, don't trust anything we cached for it anymore */
+        bus_property_cache_flush(bus);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2756,6 +2937,9 @@ _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path,
         if (strv_isempty(interfaces))
                 return 0;
 
+        /* The object appears or vanishes, don't trust anything we cached for it anymore */
+        bus_property_cache_flush(bus);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
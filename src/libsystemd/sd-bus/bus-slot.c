@@ -178,6 +178,7 @@ void bus_slot_disconnect(sd_bus_slot *slot) {
                 if (slot->node_vtable.node) {
                         LIST_REMOVE(vtables, slot->node_vtable.node->vtables, &slot->node_vtable);
                         slot->bus->nodes_modified = true;
+                        bus_property_cache_flush(slot->bus);
 
                         bus_node_gc(slot->bus, slot->node_vtable.node);
                 }
@@ -18,6 +18,7 @@
 ***/
 
 #include <endian.h>
+#include <limits.h>
 #include <poll.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -38,12 +39,19 @@
 #include "signal-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "utf8.h"
 #include "util.h"
 
 #define SNDBUF_SIZE (8*1024*1024)
 
+/* How much to read at once, so that a batch of small messages can be read with a single syscall */
+#define READ_AHEAD_SIZE (64*1024)
+
+/* Up to how much of the write queue to send with a single syscall */
+#define WRITE_COALESCE_SIZE (128*1024)
+
 static void iovec_advance(struct iovec iov[], unsigned *idx, size_t size) {
 
         while (size > 0) {
@@ -765,54 +773,75 @@ int bus_socket_take_fd(sd_bus *b) {
         return bus_socket_start_auth(b);
 }
 
-int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+int bus_socket_write_messages(sd_bus *bus, sd_bus_message **messages, unsigned n_messages, size_t *idx) {
         struct iovec *iov;
+        size_t n_iov = 0, size = 0;
+        unsigned i, j, n;
         ssize_t k;
-        size_t n;
-        unsigned j;
         int r;
 
         assert(bus);
-        assert(m);
+        assert(messages);
+        assert(n_messages > 0);
         assert(idx);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        if (*idx >= BUS_MESSAGE_SIZE(m))
+        /* Writes as many of the messages as we can with a single syscall. *idx is the number of bytes
+         * written so far, counted from the beginning of the first message. */
+
+        if (*idx >= BUS_MESSAGE_SIZE(messages[0]))
                 return 0;
 
-        r = bus_message_setup_iovec(m);
-        if (r < 0)
-                return r;
+        for (n = 0; n < n_messages; n++) {
+                sd_bus_message *m = messages[n];
+
+                r = bus_message_setup_iovec(m);
+                if (r < 0)
+                        return r;
+
+                /* File descriptors are sent along with the first byte of a sendmsg(), hence a message that
+                 * carries some always starts a new batch */
+                if (n > 0 &&
+                    (m->n_fds > 0 ||
+                     size >= WRITE_COALESCE_SIZE ||
+                     n_iov + m->n_iovec > IOV_MAX))
+                        break;
 
-        n = m->n_iovec * sizeof(struct iovec);
-        iov = alloca(n);
-        memcpy_safe(iov, m->iovec, n);
+                n_iov += m->n_iovec;
+                size += BUS_MESSAGE_SIZE(m);
+        }
+
+        iov = newa(struct iovec, n_iov);
+        for (i = 0, j = 0; i < n; i++) {
+                memcpy_safe(iov + j, messages[i]->iovec, messages[i]->n_iovec * sizeof(struct iovec));
+                j += messages[i]->n_iovec;
+        }
 
         j = 0;
         iovec_advance(iov, &j, *idx);
 
         if (bus->prefer_writev)
-                k = writev(bus->output_fd, iov, m->n_iovec);
+                k = writev(bus->output_fd, iov, n_iov);
         else {
                 struct msghdr mh = {
                         .msg_iov = iov,
-                        .msg_iovlen = m->n_iovec,
+                        .msg_iovlen = n_iov,
                 };
 
-                if (m->n_fds > 0 && *idx == 0) {
+                if (messages[0]->n_fds > 0 && *idx == 0) {
                         struct cmsghdr *control;
 
-                        mh.msg_control = control = alloca(CMSG_SPACE(sizeof(int) * m->n_fds));
-                        mh.msg_controllen = control->cmsg_len = CMSG_LEN(sizeof(int) * m->n_fds);
+                        mh.msg_control = control = alloca(CMSG_SPACE(sizeof(int) * messages[0]->n_fds));
+                        mh.msg_controllen = control->cmsg_len = CMSG_LEN(sizeof(int) * messages[0]->n_fds);
                         control->cmsg_level = SOL_SOCKET;
                         control->cmsg_type = SCM_RIGHTS;
-                        memcpy(CMSG_DATA(control), m->fds, sizeof(int) * m->n_fds);
+                        memcpy(CMSG_DATA(control), messages[0]->fds, sizeof(int) * messages[0]->n_fds);
                 }
 
                 k = sendmsg(bus->output_fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
                 if (k < 0 && errno == ENOTSOCK) {
                         bus->prefer_writev = true;
-                        k = writev(bus->output_fd, iov, m->n_iovec);
+                        k = writev(bus->output_fd, iov, n_iov);
                 }
         }
 
@@ -823,16 +852,19 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         return 1;
 }
 
-static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+        return bus_socket_write_messages(bus, &m, 1, idx);
+}
+
+static int bus_socket_read_message_need(const void *p, size_t size, size_t *need) {
         uint32_t a, b;
         uint8_t e;
         uint64_t sum;
 
-        assert(bus);
+        assert(p || size == 0);
         assert(need);
-        assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        if (bus->rbuffer_size < sizeof(struct bus_header)) {
+        if (size < sizeof(struct bus_header)) {
                 *need = sizeof(struct bus_header) + 8;
 
                 /* Minimum message size:
@@ -854,16 +886,14 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
-
-        e = ((const uint8_t*) bus->rbuffer)[0];
+        /* Messages following others in the buffer aren't necessarily aligned */
+        e = ((const uint8_t*) p)[0];
         if (e == BUS_LITTLE_ENDIAN) {
-                a = le32toh(a);
-                b = le32toh(b);
+                a = unaligned_read_le32((const uint8_t*) p + 4);
+                b = unaligned_read_le32((const uint8_t*) p + 12);
         } else if (e == BUS_BIG_ENDIAN) {
-                a = be32toh(a);
-                b = be32toh(b);
+                a = unaligned_read_be32((const uint8_t*) p + 4);
+                b = unaligned_read_be32((const uint8_t*) p + 12);
         } else
                 return -EBADMSG;
 
@@ -875,53 +905,197 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
-static int bus_socket_make_message(sd_bus *bus, size_t size) {
+static uint32_t read_u32(const uint8_t *p, bool le) {
+        return le ? unaligned_read_le32(p) : unaligned_read_be32(p);
+}
+
+static int bus_socket_peek_unix_fds(const uint8_t *p, size_t size, unsigned *ret) {
+        size_t i, end;
+        unsigned n = 0;
+        bool le;
+
+        assert(p);
+        assert(size >= sizeof(struct bus_header));
+        assert(ret);
+
+        /* Looks for the UNIX_FDS header field of a complete message, without parsing it fully. Returns 0 if
+         * the header fields are not what we understand here, and leaves the proper parser to judge them. */
+
+        if (p[3] != 1)
+                return 0;
+
+        le = p[0] == BUS_LITTLE_ENDIAN;
+
+        i = sizeof(struct bus_header);
+        end = i + read_u32(p + 12, le);
+        if (end > size)
+                return 0;
+
+        while (i < end) {
+                uint8_t code, type;
+
+                /* Each field is a (yv) struct, and all known ones have a single character signature */
+                i = ALIGN_TO(i, 8);
+                if (i + 4 > end)
+                        return 0;
+
+                code = p[i];
+                if (p[i+1] != 1 || p[i+3] != 0)
+                        return 0;
+                type = p[i+2];
+                i += 4;
+
+                switch (type) {
+
+                case SD_BUS_TYPE_UINT32:
+                        i = ALIGN_TO(i, 4);
+                        if (i + 4 > end)
+                                return 0;
+
+                        if (code == BUS_MESSAGE_HEADER_UNIX_FDS)
+                                n = read_u32(p + i, le);
+                        i += 4;
+                        break;
+
+                case SD_BUS_TYPE_STRING:
+                case SD_BUS_TYPE_OBJECT_PATH:
+                        i = ALIGN_TO(i, 4);
+                        if (i + 4 > end)
+                                return 0;
+
+                        i += 4 + (size_t) read_u32(p + i, le) + 1;
+                        break;
+
+                case SD_BUS_TYPE_SIGNATURE:
+                        if (i >= end)
+                                return 0;
+
+                        i += 1 + (size_t) p[i] + 1;
+                        break;
+
+                default:
+                        return 0;
+                }
+        }
+
+        *ret = n;
+        return 1;
+}
+
+static int bus_socket_make_message(sd_bus *bus, size_t offset, size_t size, size_t allocated) {
         sd_bus_message *t;
+        int *fds = NULL;
+        unsigned n_fds;
+        bool steal;
         void *b;
         int r;
 
         assert(bus);
-        assert(bus->rbuffer_size >= size);
+        assert(bus->rbuffer_size >= offset + size);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         r = bus_rqueue_make_room(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
-                if (!b)
+        /* If the message is all we have, pass the buffer on as it is, unless it is mostly unused read-ahead
+         * space. Otherwise copy the message out: parsing in place would pin the whole buffer for as long as
+         * any message in it is referenced, and the messages following the first one might not be aligned. */
+        steal = offset == 0 && size == bus->rbuffer_size && size >= allocated / 2;
+
+        /* File descriptors are sent with the first byte of a message, but a single read might cover many
+         * messages. Hence, hand out those received so far in order, as many as each message declares. If we
+         * can't tell, the message gets all of them, and the parser will complain if that's wrong. */
+        n_fds = bus->n_fds;
+        if (bus->n_fds > 0 &&
+            bus_socket_peek_unix_fds((const uint8_t*) bus->rbuffer + offset, size, &n_fds) > 0 &&
+            n_fds > 0 && n_fds < bus->n_fds) {
+                fds = newdup(int, bus->fds, n_fds);
+                if (!fds)
                         return -ENOMEM;
         } else
-                b = NULL;
+                n_fds = MIN(n_fds, bus->n_fds);
+
+        if (steal)
+                b = bus->rbuffer;
+        else {
+                b = memdup((const uint8_t*) bus->rbuffer + offset, size);
+                if (!b) {
+                        free(fds);
+                        return -ENOMEM;
+                }
+        }
 
         r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
+                                    b, size,
+                                    n_fds > 0 ? fds ?: bus->fds : NULL, n_fds,
                                     NULL,
                                     &t);
         if (r < 0) {
-                free(b);
+                if (!steal)
+                        free(b);
+                free(fds);
                 return r;
         }
 
-        bus->rbuffer = b;
-        bus->rbuffer_size -= size;
+        if (steal) {
+                bus->rbuffer = NULL;
+                bus->rbuffer_size = 0;
+        }
+
+        if (fds) {
+                bus->n_fds -= n_fds;
+                memmove(bus->fds, bus->fds + n_fds, sizeof(int) * bus->n_fds);
+        } else if (n_fds > 0) {
+                bus->fds = NULL;
+                bus->n_fds = 0;
+        }
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        if (bus->method_stats_enabled)
+                t->read_usec = now(CLOCK_MONOTONIC);
 
         bus->rqueue[bus->rqueue_size++] = t;
 
         return 1;
 }
 
+static int bus_socket_make_messages(sd_bus *bus, size_t allocated) {
+        size_t offset = 0, need;
+        int r = 0, ret = 0;
+
+        assert(bus);
+
+        /* Turns all complete messages in the read buffer into message objects, and keeps the rest */
+
+        while (bus->rbuffer) {
+                r = bus_socket_read_message_need((const uint8_t*) bus->rbuffer + offset, bus->rbuffer_size - offset, &need);
+                if (r < 0)
+                        break;
+
+                if (bus->rbuffer_size - offset < need)
+                        break;
+
+                r = bus_socket_make_message(bus, offset, need, allocated);
+                if (r < 0)
+                        break;
+
+                offset += need;
+                ret = 1;
+        }
+
+        if (bus->rbuffer && offset > 0) {
+                bus->rbuffer_size -= offset;
+                memmove(bus->rbuffer, (const uint8_t*) bus->rbuffer + offset, bus->rbuffer_size);
+        }
+
+        return r < 0 ? r : ret;
+}
+
 int bus_socket_read_message(sd_bus *bus) {
         struct msghdr mh;
         struct iovec iov = {};
         ssize_t k;
-        size_t need;
+        size_t need, allocated;
         int r;
         void *b;
         union {
@@ -933,21 +1107,25 @@ int bus_socket_read_message(sd_bus *bus) {
         assert(bus);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        r = bus_socket_read_message_need(bus, &need);
+        /* Complete messages might be left over from the authentication phase */
+        r = bus_socket_make_messages(bus, SIZE_MAX);
+        if (r != 0)
+                return r;
+
+        r = bus_socket_read_message_need(bus->rbuffer, bus->rbuffer_size, &need);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+        allocated = MAX(need, (size_t) READ_AHEAD_SIZE);
 
-        b = realloc(bus->rbuffer, need);
+        b = realloc(bus->rbuffer, allocated);
         if (!b)
                 return -ENOMEM;
 
         bus->rbuffer = b;
 
         iov.iov_base = (uint8_t*) bus->rbuffer + bus->rbuffer_size;
-        iov.iov_len = need - bus->rbuffer_size;
+        iov.iov_len = allocated - bus->rbuffer_size;
 
         if (bus->prefer_readv)
                 k = readv(bus->input_fd, &iov, 1);
@@ -1005,13 +1183,10 @@ int bus_socket_read_message(sd_bus *bus) {
                                           cmsg->cmsg_level, cmsg->cmsg_type);
         }
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_make_messages(bus, allocated);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
-
         return 1;
 }
 
@@ -0,0 +1,299 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "alloc-util.h"
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "bus-stats.h"
+#include "hashmap.h"
+#include "string-util.h"
+
+static void method_stats_hash_func(const void *p, struct siphash *state) {
+        const struct bus_method_stats *s = p;
+
+        assert(s);
+
+        string_hash_func(s->interface, state);
+        string_hash_func(s->member, state);
+}
+
+static int method_stats_compare_func(const void *a, const void *b) {
+        const struct bus_method_stats *x = a, *y = b;
+        int r;
+
+        assert(x);
+        assert(y);
+
+        r = strcmp(x->interface, y->interface);
+        if (r != 0)
+                return r;
+
+        return strcmp(x->member, y->member);
+}
+
+static const struct hash_ops method_stats_hash_ops = {
+        .hash = method_stats_hash_func,
+        .compare = method_stats_compare_func
+};
+
+static struct bus_method_stats *method_stats_free(struct bus_method_stats *s) {
+        if (!s)
+                return NULL;
+
+        free(s->interface);
+        free(s->member);
+        return mfree(s);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct bus_method_stats*, method_stats_free);
+
+void bus_stats_free(sd_bus *bus) {
+        struct bus_method_stats *s;
+
+        assert(bus);
+
+        while ((s = hashmap_steal_first(bus->method_stats)))
+                method_stats_free(s);
+
+        bus->method_stats = hashmap_free(bus->method_stats);
+}
+
+static bool method_is_registered(sd_bus *bus, sd_bus_message *m) {
+        struct vtable_member key = {}, *v;
+        char *prefix;
+
+        assert(bus);
+        assert(m);
+
+        if (!m->path || !m->interface || !m->member)
+                return false;
+
+        key.interface = m->interface;
+        key.member = m->member;
+
+        key.path = m->path;
+        if (hashmap_get(bus->vtable_methods, &key))
+                return true;
+
+        prefix = alloca(strlen(m->path) + 1);
+        OBJECT_PATH_FOREACH_PREFIX(prefix, m->path) {
+                key.path = prefix;
+
+                v = hashmap_get(bus->vtable_methods, &key);
+                if (v && v->parent->is_fallback)
+                        return true;
+        }
+
+        return false;
+}
+
+static struct bus_method_stats *method_stats_get(sd_bus *bus, sd_bus_message *m) {
+        _cleanup_(method_stats_freep) struct bus_method_stats *n = NULL;
+        struct bus_method_stats key, *s;
+
+        assert(bus);
+        assert(m);
+
+        /* Only methods from the vtables get an entry of their own, so that clients calling arbitrary names
+         * can't make us allocate one entry each. All other calls are counted together under an empty
+         * interface and member name. */
+        if (method_is_registered(bus, m))
+                key = (struct bus_method_stats) {
+                        .interface = (char*) m->interface,
+                        .member = (char*) m->member,
+                };
+        else
+                key = (struct bus_method_stats) {
+                        .interface = (char*) "",
+                        .member = (char*) "",
+                };
+
+        s = hashmap_get(bus->method_stats, &key);
+        if (s)
+                return s;
+
+        /* Statistics are best effort, hence on allocation failures we simply don't collect any */
+
+        if (hashmap_ensure_allocated(&bus->method_stats, &method_stats_hash_ops) < 0)
+                return NULL;
+
+        n = new0(struct bus_method_stats, 1);
+        if (!n)
+                return NULL;
+
+        n->interface = strdup(key.interface);
+        n->member = strdup(key.member);
+        if (!n->interface || !n->member)
+                return NULL;
+
+        if (hashmap_put(bus->method_stats, n, n) < 0)
+                return NULL;
+
+        s = n;
+        n = NULL;
+
+        return s;
+}
+
+static void histogram_add(struct bus_stats_histogram *h, usec_t t) {
+        unsigned i;
+
+        assert(h);
+
+        for (i = 0; i < BUS_STATS_BUCKETS - 1 && t >= (UINT64_C(1) << i); i++)
+                ;
+
+        h->n++;
+        h->total += t;
+        h->buckets[i]++;
+}
+
+void bus_stats_call_begin(sd_bus *bus, sd_bus_message *m) {
+        struct bus_method_stats *s;
+
+        assert(bus);
+        assert(m);
+
+        if (!bus->method_stats_enabled)
+                return;
+
+        if (m->header->type != SD_BUS_MESSAGE_METHOD_CALL)
+                return;
+
+        s = method_stats_get(bus, m);
+        if (!s)
+                return;
+
+        m->stats = s;
+        m->stats_begin = now(CLOCK_MONOTONIC);
+
+        if (m->read_usec > 0 && m->stats_begin >= m->read_usec)
+                histogram_add(s->histograms + BUS_STATS_QUEUED, m->stats_begin - m->read_usec);
+}
+
+void bus_stats_call_end(sd_bus *bus, sd_bus_message *m) {
+        assert(bus);
+        assert(m);
+
+        if (!m->stats || !bus->method_stats_enabled)
+                return;
+
+        histogram_add(m->stats->histograms + BUS_STATS_HANDLED, now(CLOCK_MONOTONIC) - m->stats_begin);
+}
+
+void bus_stats_message_sent(sd_bus *bus, sd_bus_message *m) {
+        assert(bus);
+        assert(m);
+
+        /* The entries are only freed together with the bus, hence as long as the reply belongs to the
+         * bus that received the call the pointer is valid */
+        if (!m->stats || m->bus != bus || !bus->method_stats_enabled)
+                return;
+
+        histogram_add(m->stats->histograms + BUS_STATS_REPLIED, now(CLOCK_MONOTONIC) - m->stats_begin);
+}
+
+static int append_method_stats(sd_bus_message *reply, struct bus_method_stats *s) {
+        BusStatsPhase p;
+        int r;
+
+        assert(reply);
+        assert(s);
+
+        r = sd_bus_message_open_container(reply, 'r', "ssa(ttat)");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(reply, "ss", s->interface, s->member);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ttat)");
+        if (r < 0)
+                return r;
+
+        for (p = 0; p < _BUS_STATS_PHASE_MAX; p++) {
+                r = sd_bus_message_open_container(reply, 'r', "ttat");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "tt", s->histograms[p].n, s->histograms[p].total);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append_array(reply, 't', s->histograms[p].buckets, sizeof(s->histograms[p].buckets));
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_close_container(reply);
+}
+
+int bus_stats_process_builtin(sd_bus *bus, sd_bus_message *m) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        struct bus_method_stats *s;
+        Iterator i;
+        int r;
+
+        assert(bus);
+        assert(m);
+
+        if (m->header->flags & BUS_MESSAGE_NO_REPLY_EXPECTED)
+                return 1;
+
+        if (streq_ptr(m->member, "GetMethodStats")) {
+                r = sd_bus_message_new_method_return(m, &reply);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "u", BUS_STATS_BUCKETS);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(reply, 'a', "(ssa(ttat))");
+                if (r < 0)
+                        return r;
+
+                HASHMAP_FOREACH(s, bus->method_stats, i) {
+                        r = append_method_stats(reply, s);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = sd_bus_message_close_container(reply);
+        } else
+                r = sd_bus_message_new_method_errorf(
+                                m, &reply,
+                                SD_BUS_ERROR_UNKNOWN_METHOD,
+                                "Unknown method '%s' on interface '%s'.", m->member, m->interface);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_send(bus, reply, NULL);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
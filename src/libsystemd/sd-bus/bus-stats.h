@@ -0,0 +1,55 @@
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "sd-bus.h"
+
+#include "time-util.h"
+
+#define BUS_STATS_INTERFACE "org.freedesktop.LibSystemd1.Stats"
+
+/* Bucket 0 counts latencies below 1µs, bucket i those below 2^i µs, the last one all others */
+#define BUS_STATS_BUCKETS 24U
+
+typedef enum BusStatsPhase {
+        BUS_STATS_QUEUED,    /* from reading a call until dispatching it */
+        BUS_STATS_HANDLED,   /* from dispatching a call until its handlers returned */
+        BUS_STATS_REPLIED,   /* from dispatching a call until its reply was written */
+        _BUS_STATS_PHASE_MAX,
+} BusStatsPhase;
+
+struct bus_stats_histogram {
+        uint64_t n;
+        usec_t total;
+        uint64_t buckets[BUS_STATS_BUCKETS];
+};
+
+struct bus_method_stats {
+        char *interface;
+        char *member;
+
+        struct bus_stats_histogram histograms[_BUS_STATS_PHASE_MAX];
+};
+
+void bus_stats_free(sd_bus *bus);
+
+void bus_stats_call_begin(sd_bus *bus, sd_bus_message *m);
+void bus_stats_call_end(sd_bus *bus, sd_bus_message *m);
+void bus_stats_message_sent(sd_bus *bus, sd_bus_message *m);
+
+int bus_stats_process_builtin(sd_bus *bus, sd_bus_message *m);
@@ -38,6 +38,7 @@
 #include "bus-protocol.h"
 #include "bus-slot.h"
 #include "bus-socket.h"
+#include "bus-stats.h"
 #include "bus-track.h"
 #include "bus-type.h"
 #include "bus-util.h"
@@ -157,6 +158,12 @@ static void bus_free(sd_bus *b) {
 
         hashmap_free_free(b->vtable_methods);
         hashmap_free_free(b->vtable_properties);
+        hashmap_free_free_free(b->property_cache);
+
+        bus_creds_cache_flush(b);
+        hashmap_free(b->creds_cache);
+
+        bus_stats_free(b);
 
         assert(hashmap_isempty(b->nodes));
         hashmap_free(b->nodes);
@@ -169,6 +176,7 @@ static void bus_free(sd_bus *b) {
 }
 
 _public_ int sd_bus_new(sd_bus **ret) {
+        const char *e;
         sd_bus *r;
 
         assert_return(ret, -EINVAL);
@@ -185,6 +193,11 @@ _public_ int sd_bus_new(sd_bus **ret) {
         r->attach_flags |= KDBUS_ATTACH_NAMES;
         r->original_pid = getpid_cached();
 
+        /* Allow turning on call statistics without changing a service */
+        e = secure_getenv("SYSTEMD_BUS_STATS");
+        if (e && parse_boolean(e) > 0)
+                r->method_stats_enabled = true;
+
         assert_se(pthread_mutex_init(&r->memfd_cache_mutex, NULL) == 0);
 
         /* We guarantee that wqueue always has space for at least one
@@ -1455,6 +1468,22 @@ int bus_seal_synthetic_message(sd_bus *b, sd_bus_message *m) {
         return bus_message_seal(m, 0xFFFFFFFFULL, 0);
 }
 
+static void bus_log_sent(sd_bus_message *m) {
+        assert(m);
+
+        log_debug("Sent message type=%s sender=%s destination=%s object=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " error-name=%s error-message=%s",
+                  bus_message_type_to_string(m->header->type),
+                  strna(sd_bus_message_get_sender(m)),
+                  strna(sd_bus_message_get_destination(m)),
+                  strna(sd_bus_message_get_path(m)),
+                  strna(sd_bus_message_get_interface(m)),
+                  strna(sd_bus_message_get_member(m)),
+                  BUS_MESSAGE_COOKIE(m),
+                  m->reply_cookie,
+                  strna(m->error.name),
+                  strna(m->error.message));
+}
+
 static int bus_write_message(sd_bus *bus, sd_bus_message *m, bool hint_sync_call, size_t *idx) {
         int r;
 
@@ -1465,18 +1494,10 @@ static int bus_write_message(sd_bus *bus, sd_bus_message *m, bool hint_sync_call
         if (r <= 0)
                 return r;
 
-        if (*idx >= BUS_MESSAGE_SIZE(m))
-                log_debug("Sent message type=%s sender=%s destination=%s object=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " error-name=%s error-message=%s",
-                          bus_message_type_to_string(m->header->type),
-                          strna(sd_bus_message_get_sender(m)),
-                          strna(sd_bus_message_get_destination(m)),
-                          strna(sd_bus_message_get_path(m)),
-                          strna(sd_bus_message_get_interface(m)),
-                          strna(sd_bus_message_get_member(m)),
-                          BUS_MESSAGE_COOKIE(m),
-                          m->reply_cookie,
-                          strna(m->error.name),
-                          strna(m->error.message));
+        if (*idx >= BUS_MESSAGE_SIZE(m)) {
+                bus_log_sent(m);
+                bus_stats_message_sent(bus, m);
+        }
 
         return r;
 }
@@ -1488,28 +1509,28 @@ static int dispatch_wqueue(sd_bus *bus) {
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         while (bus->wqueue_size > 0) {
+                unsigned n;
 
-                r = bus_write_message(bus, bus->wqueue[0], false, &bus->windex);
+                /* Write out as much of the queue as we can in one go */
+                r = bus_socket_write_messages(bus, bus->wqueue, bus->wqueue_size, &bus->windex);
                 if (r < 0)
                         return r;
                 else if (r == 0)
                         /* Didn't do anything this time */
                         return ret;
-                else if (bus->windex >= BUS_MESSAGE_SIZE(bus->wqueue[0])) {
-                        /* Fully written. Let's drop the entry from
-                         * the queue.
-                         *
-                         * This isn't particularly optimized, but
-                         * well, this is supposed to be our worst-case
-                         * buffer only, and the socket buffer is
-                         * supposed to be our primary buffer, and if
-                         * it got full, then all bets are off
-                         * anyway. */
-
-                        bus->wqueue_size--;
-                        sd_bus_message_unref(bus->wqueue[0]);
-                        memmove(bus->wqueue, bus->wqueue + 1, sizeof(sd_bus_message*) * bus->wqueue_size);
-                        bus->windex = 0;
+
+                /* Drop all fully written entries from the queue at once */
+                for (n = 0; n < bus->wqueue_size && bus->windex >= BUS_MESSAGE_SIZE(bus->wqueue[n]); n++) {
+                        bus->windex -= BUS_MESSAGE_SIZE(bus->wqueue[n]);
+
+                        bus_log_sent(bus->wqueue[n]);
+                        bus_stats_message_sent(bus, bus->wqueue[n]);
+                        sd_bus_message_unref(bus->wqueue[n]);
+                }
+
+                if (n > 0) {
+                        bus->wqueue_size -= n;
+                        memmove(bus->wqueue, bus->wqueue + n, sizeof(sd_bus_message*) * bus->wqueue_size);
 
                         ret = 1;
                 }
@@ -1610,7 +1631,7 @@ static int bus_send_internal(sd_bus *bus, sd_bus_message *_m, uint64_t *cookie,
         if (m->dont_send)
                 goto finish;
 
-        if (IN_SET(bus->state, BUS_RUNNING, BUS_HELLO) && bus->wqueue_size <= 0) {
+        if (IN_SET(bus->state, BUS_RUNNING, BUS_HELLO) && bus->wqueue_size <= 0 && !bus->corked) {
                 size_t idx = 0;
 
                 r = bus_write_message(bus, m, hint_sync_call, &idx);
@@ -2284,10 +2305,13 @@ static int process_builtin(sd_bus *bus, sd_bus_message *m) {
         if (bus->hello_flags & KDBUS_HELLO_MONITOR)
                 return 0;
 
-        if (bus->manual_peer_interface)
+        if (m->header->type != SD_BUS_MESSAGE_METHOD_CALL)
                 return 0;
 
-        if (m->header->type != SD_BUS_MESSAGE_METHOD_CALL)
+        if (bus->method_stats_enabled && streq_ptr(m->interface, BUS_STATS_INTERFACE))
+                return bus_stats_process_builtin(bus, m);
+
+        if (bus->manual_peer_interface)
                 return 0;
 
         if (!streq_ptr(m->interface, "org.freedesktop.DBus.Peer"))
@@ -2365,10 +2389,14 @@ static int process_message(sd_bus *bus, sd_bus_message *m) {
 
         log_debug_bus_message(m);
 
+        bus_stats_call_begin(bus, m);
+
         r = process_hello(bus, m);
         if (r != 0)
                 goto finish;
 
+        bus_creds_cache_process(bus, m);
+
         r = process_reply(bus, m);
         if (r != 0)
                 goto finish;
@@ -2392,6 +2420,8 @@ static int process_message(sd_bus *bus, sd_bus_message *m) {
         r = bus_process_object(bus, m);
 
 finish:
+        bus_stats_call_end(bus, m);
+
         bus->current_message = NULL;
         return r;
 }
@@ -3634,3 +3664,57 @@ _public_ int sd_bus_get_exit_on_disconnect(sd_bus *bus) {
 
         return bus->exit_on_disconnect;
 }
+
+_public_ int sd_bus_set_cork(sd_bus *bus, int b) {
+        int r;
+
+        assert_return(bus, -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        /* While corked, sent messages are only queued, and written out in batches the next time the
+         * connection is processed or flushed, or when it is uncorked again. Useful for sending a burst of
+         * signals at once. */
+
+        if (bus->corked == !!b)
+                return 0;
+
+        bus->corked = b;
+
+        if (b || !IN_SET(bus->state, BUS_RUNNING, BUS_HELLO))
+                return 1;
+
+        r = dispatch_wqueue(bus);
+        if (r < 0) {
+                if (IN_SET(r, -ENOTCONN, -ECONNRESET, -EPIPE, -ESHUTDOWN)) {
+                        bus_enter_closing(bus);
+                        return -ECONNRESET;
+                }
+
+                return r;
+        }
+
+        return 1;
+}
+
+_public_ int sd_bus_get_cork(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+
+        return bus->corked;
+}
+
+_public_ int sd_bus_set_method_stats(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        /* While enabled, the number and latencies of incoming method calls are recorded, and can be
+         * queried through the org.freedesktop.LibSystemd1.Stats interface on any object path. */
+
+        bus->method_stats_enabled = b;
+        return 0;
+}
+
+_public_ int sd_bus_get_method_stats(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+
+        return bus->method_stats_enabled;
+}
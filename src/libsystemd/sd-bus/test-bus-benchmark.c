@@ -31,6 +31,7 @@
 #include "util.h"
 
 #define MAX_SIZE (2*1024*1024)
+#define MAX_BURST 4096
 
 static usec_t arg_loop_usec = 100 * USEC_PER_MSEC;
 
@@ -221,10 +222,99 @@ static void client_chart(Type type, const char *address, const char *server_name
         sd_bus_unref(b);
 }
 
+static void burst(sd_bus *b, unsigned n, const char *server_name) {
+        unsigned i, n_replies = 0;
+        int r;
+
+        /* Queue up many small calls before waiting for any reply, like a monitoring loop hammering the bus
+         * does, and write them out in batches */
+        assert_se(sd_bus_set_cork(b, true) >= 0);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                uint64_t cookie;
+
+                /* Pass a cookie, as otherwise the call is sent without expecting a reply */
+                assert_se(sd_bus_message_new_method_call(b, &m, server_name, "/", "benchmark.server", "Ping") >= 0);
+                assert_se(sd_bus_send(b, m, &cookie) >= 0);
+        }
+
+        assert_se(sd_bus_set_cork(b, false) >= 0);
+
+        while (n_replies < n) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+                uint8_t type;
+
+                r = sd_bus_process(b, &reply);
+                assert_se(r >= 0);
+
+                if (r == 0)
+                        assert_se(sd_bus_wait(b, USEC_INFINITY) >= 0);
+                if (!reply)
+                        continue;
+
+                assert_se(sd_bus_message_get_type(reply, &type) >= 0);
+                if (type == SD_BUS_MESSAGE_METHOD_RETURN)
+                        n_replies++;
+        }
+}
+
+static void client_burst(Type type, const char *address, const char *server_name, int fd) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
+        unsigned n;
+        sd_bus *b;
+        int r;
+
+        r = sd_bus_new(&b);
+        assert_se(r >= 0);
+
+        if (type == TYPE_DIRECT) {
+                r = sd_bus_set_fd(b, fd, fd);
+                assert_se(r >= 0);
+        } else {
+                r = sd_bus_set_address(b, address);
+                assert_se(r >= 0);
+
+                r = sd_bus_set_bus_client(b, true);
+                assert_se(r >= 0);
+        }
+
+        r = sd_bus_start(b);
+        assert_se(r >= 0);
+
+        r = sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL);
+        assert_se(r >= 0);
+
+        printf("BURST\tCALLS/s\n");
+
+        for (n = 1; n <= MAX_BURST; n *= 4) {
+                usec_t t;
+                uint64_t n_calls;
+
+                printf("%u\t", n);
+
+                t = now(CLOCK_MONOTONIC);
+                for (n_calls = 0;; n_calls += n) {
+                        burst(b, n, server_name);
+                        if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                                break;
+                }
+
+                printf("%" PRIu64 "\n", (n_calls * USEC_PER_SEC) / arg_loop_usec);
+        }
+
+        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
+        assert_se(sd_bus_message_append(x, "t", (uint64_t) MAX_BURST) >= 0);
+        assert_se(sd_bus_send(b, x, NULL) >= 0);
+
+        sd_bus_unref(b);
+}
+
 int main(int argc, char *argv[]) {
         enum {
                 MODE_BISECT,
                 MODE_CHART,
+                MODE_BURST,
         } mode = MODE_BISECT;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
@@ -241,6 +331,9 @@ int main(int argc, char *argv[]) {
                 if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
+                } else if (streq(argv[i], "burst")) {
+                        mode = MODE_BURST;
+                        continue;
                 } else if (streq(argv[i], "legacy")) {
                         type = TYPE_LEGACY;
                         continue;
@@ -316,6 +409,10 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                case MODE_BURST:
+                        client_burst(type, address, server_name, pair[1]);
+                        break;
                 }
 
                 _exit(0);
@@ -20,8 +20,97 @@
 #include "sd-bus.h"
 
 #include "bus-dump.h"
+#include "bus-internal.h"
 #include "bus-util.h"
 #include "cgroup-util.h"
+#include "hashmap.h"
+
+static int ping_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *c1 = NULL, *c2 = NULL;
+        sd_bus *bus = sd_bus_message_get_bus(m);
+        unsigned *n_pings = userdata;
+        uid_t euid;
+        pid_t pid;
+
+        if (!sd_bus_message_is_signal(m, "org.freedesktop.systemd.test", "Ping"))
+                return 0;
+
+        /* The first query asks the bus daemon, the second one is served from the cache */
+        assert_se(sd_bus_query_sender_creds(m, SD_BUS_CREDS_PID|SD_BUS_CREDS_EUID, &c1) >= 0);
+        assert_se(bus->creds_cache_misses == 1);
+        assert_se(bus->creds_cache_hits == 0);
+
+        assert_se(sd_bus_query_sender_creds(m, SD_BUS_CREDS_PID|SD_BUS_CREDS_EUID, &c2) >= 0);
+        assert_se(bus->creds_cache_misses == 1);
+        assert_se(bus->creds_cache_hits == 1);
+
+        assert_se(sd_bus_creds_get_pid(c2, &pid) >= 0);
+        assert_se(pid == getpid_cached());
+        assert_se(sd_bus_creds_get_euid(c2, &euid) >= 0);
+        assert_se(euid == geteuid());
+
+        (*n_pings)++;
+        return 1;
+}
+
+static int owner_changed_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        bool *gone = userdata;
+
+        *gone = true;
+        return 0;
+}
+
+static int test_sender_creds_cache(void) {
+        _cleanup_(sd_bus_unrefp) sd_bus *a = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        sd_bus *b = NULL;
+        const char *unique_a, *unique_b;
+        unsigned n_pings = 0;
+        bool gone = false;
+        char *match;
+        int r;
+
+        r = sd_bus_open_user(&a);
+        if (r < 0)
+                return log_info_errno(r, "Failed to connect to user bus, skipping cache test: %m");
+
+        assert_se(sd_bus_open_user(&b) >= 0);
+        assert_se(sd_bus_get_unique_name(a, &unique_a) >= 0);
+        assert_se(sd_bus_get_unique_name(b, &unique_b) >= 0);
+
+        assert_se(sd_bus_add_filter(a, NULL, ping_handler, &n_pings) >= 0);
+
+        match = strjoina("type='signal',sender='org.freedesktop.DBus',member='NameOwnerChanged',arg0='", unique_b, "'");
+        assert_se(sd_bus_add_match(a, NULL, match, owner_changed_handler, &gone) >= 0);
+
+        assert_se(sd_bus_message_new_signal(b, &m, "/", "org.freedesktop.systemd.test", "Ping") >= 0);
+        assert_se(sd_bus_message_set_destination(m, unique_a) >= 0);
+        assert_se(sd_bus_send(b, m, NULL) >= 0);
+        assert_se(sd_bus_flush(b) >= 0);
+
+        while (n_pings == 0) {
+                r = sd_bus_process(a, NULL);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(a, (uint64_t) -1) >= 0);
+        }
+
+        assert_se(hashmap_size(a->creds_cache) == 1);
+
+        /* Once the peer disconnects its cache entry goes away */
+        b = sd_bus_flush_close_unref(b);
+
+        while (!gone) {
+                r = sd_bus_process(a, NULL);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(a, (uint64_t) -1) >= 0);
+        }
+
+        assert_se(hashmap_isempty(a->creds_cache));
+
+        return 0;
+}
 
 int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
@@ -51,5 +140,7 @@ int main(int argc, char *argv[]) {
                 bus_creds_dump(creds, NULL, true);
         }
 
+        test_sender_creds_cache();
+
         return 0;
 }
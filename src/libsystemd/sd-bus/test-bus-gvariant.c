@@ -30,6 +30,7 @@
 #include "bus-message.h"
 #include "bus-util.h"
 #include "macro.h"
+#include "time-util.h"
 #include "util.h"
 
 static void test_bus_gvariant_is_fixed_size(void) {
@@ -213,11 +214,59 @@ static void test_marshal(void) {
         assert_se(bus_message_dump(m, NULL, BUS_MESSAGE_DUMP_WITH_HEADER) >= 0);
 }
 
+static void test_marshal_benchmark(void) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        usec_t n, t_append, t_read;
+        unsigned i;
+        int r;
+
+        /* Arrays of structs as in ListUnits() replies, where the element layout is the same every time */
+
+        r = sd_bus_open_user(&bus);
+        if (r < 0)
+                return;
+
+        bus->message_version = 2; /* dirty hack to enable gvariant */
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, "a.x", "/a/x", "a.x", "Ax") >= 0);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(sd_bus_message_open_container(m, 'a', "(ssssssouso)") >= 0);
+        for (i = 0; i < 10000; i++)
+                assert_se(sd_bus_message_append(m, "(ssssssouso)",
+                                                "foo.service", "Foo", "loaded", "active", "running", "",
+                                                "/org/freedesktop/systemd1/unit/foo_2eservice",
+                                                i, "", "/") >= 0);
+        assert_se(sd_bus_message_close_container(m) >= 0);
+        t_append = now(CLOCK_MONOTONIC) - n;
+
+        assert_se(bus_message_seal(m, 4713, 0) >= 0);
+        assert_se(sd_bus_message_rewind(m, true) >= 0);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(sd_bus_message_enter_container(m, 'a', "(ssssssouso)") >= 0);
+        for (i = 0; i < 10000; i++) {
+                const char *a, *b, *c, *d, *e, *f, *g, *h, *j;
+                uint32_t u;
+
+                assert_se(sd_bus_message_read(m, "(ssssssouso)", &a, &b, &c, &d, &e, &f, &g, &u, &h, &j) > 0);
+                assert_se(u == i);
+                assert_se(streq(g, "/org/freedesktop/systemd1/unit/foo_2eservice"));
+        }
+        assert_se(sd_bus_message_exit_container(m) >= 0);
+        t_read = now(CLOCK_MONOTONIC) - n;
+
+        log_info("gvariant a(ssssssouso), 10000 elements: append %.2fms, read %.2fms",
+                 t_append / 1e3, t_read / 1e3);
+}
+
 int main(int argc, char *argv[]) {
 
         test_bus_gvariant_is_fixed_size();
         test_bus_gvariant_get_size();
         test_bus_gvariant_get_alignment();
+        test_marshal_benchmark();
         test_marshal();
 
         return 0;
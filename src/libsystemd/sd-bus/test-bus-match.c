@@ -17,19 +17,32 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "alloc-util.h"
+#include "bus-internal.h"
 #include "bus-match.h"
 #include "bus-message.h"
 #include "bus-slot.h"
 #include "bus-util.h"
 #include "log.h"
 #include "macro.h"
+#include "time-util.h"
+
+#define N_BENCH_MATCHES 10000U
+#define N_BENCH_RUNS 10000U
 
 static bool mask[32];
+static unsigned n_runs;
 
 static int filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
         log_info("Ran %u", PTR_TO_UINT(userdata));
         assert_se(PTR_TO_UINT(userdata) < ELEMENTSOF(mask));
         mask[PTR_TO_UINT(userdata)] = true;
+        n_runs++;
+        return 0;
+}
+
+static int count_filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        n_runs++;
         return 0;
 }
 
@@ -83,6 +96,113 @@ static void test_match_scope(const char *match, enum bus_match_scope scope) {
         bus_match_parse_free(components, n_components);
 }
 
+static void test_prefix_matches(sd_bus *bus) {
+        static const char * const paths[] = {
+                "/", "/foo", "/foo/", "/foo/bar", "/foo/bar/", "/foo//bar", "/foobar", "/quux", NULL
+        };
+        static const char * const names[] = {
+                "org", "org.foo", "org.foo.", "org.foo.bar", "org.foobar", "net.foo", NULL
+        };
+        static const char * const formats[] = {
+                "path_namespace='%s'", "arg0path='%s'", "arg0namespace='%s'"
+        };
+        unsigned k;
+
+        /* Checks that looking up the prefixes in the hash table gives the same result as testing each
+         * pattern, and that no callback runs twice */
+
+        for (k = 0; k < ELEMENTSOF(formats); k++) {
+                struct bus_match_node root = {
+                        .type = BUS_MATCH_ROOT,
+                };
+                const char * const *patterns = k == 2 ? names : paths;
+                sd_bus_slot slots[ELEMENTSOF(paths)];
+                unsigned i, j;
+
+                for (i = 0; patterns[i]; i++) {
+                        _cleanup_free_ char *match = NULL;
+
+                        assert_se(asprintf(&match, formats[k], patterns[i]) >= 0);
+                        assert_se(match_add(slots, &root, match, i) >= 0);
+                }
+
+                for (j = 0; patterns[j]; j++) {
+                        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                        unsigned n_expected = 0;
+
+                        if (k == 0 && !object_path_is_valid(patterns[j]))
+                                continue;
+
+                        assert_se(sd_bus_message_new_signal(bus, &m, k == 0 ? patterns[j] : "/", "bar.x", "waldo") >= 0);
+                        assert_se(sd_bus_message_append(m, "s", patterns[j]) >= 0);
+                        assert_se(bus_message_seal(m, 1, 0) >= 0);
+
+                        zero(mask);
+                        n_runs = 0;
+                        assert_se(bus_match_run(NULL, &root, m) == 0);
+
+                        for (i = 0; patterns[i]; i++) {
+                                bool expected;
+
+                                expected = k == 0 ? path_simple_pattern(patterns[i], patterns[j]) :
+                                           k == 1 ? path_complex_pattern(patterns[i], patterns[j]) :
+                                                    namespace_simple_pattern(patterns[i], patterns[j]);
+                                assert_se(mask[i] == expected);
+                                n_expected += expected;
+                        }
+
+                        assert_se(n_runs == n_expected);
+                }
+
+                bus_match_free(&root);
+        }
+}
+
+static void test_match_benchmark(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        usec_t n;
+        unsigned i;
+
+        /* Lots of namespace matches, only two of which match the message */
+
+        assert_se(slots = new0(sd_bus_slot, 2 * N_BENCH_MATCHES));
+
+        for (i = 0; i < 2 * N_BENCH_MATCHES; i++) {
+                struct bus_match_component *components = NULL;
+                _cleanup_free_ char *match = NULL;
+                unsigned n_components = 0;
+
+                if (i < N_BENCH_MATCHES)
+                        assert_se(asprintf(&match, "type='signal',path_namespace='/org/freedesktop/systemd1/unit/bench_%u'", i) >= 0);
+                else
+                        assert_se(asprintf(&match, "type='signal',arg0namespace='org.bench.u%u'", i - N_BENCH_MATCHES) >= 0);
+
+                assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+                slots[i].match_callback.callback = count_filter;
+                assert_se(bus_match_add(&root, components, n_components, &slots[i].match_callback) >= 0);
+                bus_match_parse_free(components, n_components);
+        }
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/systemd1/unit/bench_4711/sub", "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "org.bench.u4711.name") >= 0);
+        assert_se(bus_message_seal(m, 1, 0) >= 0);
+
+        n_runs = 0;
+        n = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_BENCH_RUNS; i++)
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+        n = now(CLOCK_MONOTONIC) - n;
+
+        assert_se(n_runs == 2 * N_BENCH_RUNS);
+        log_info("%u matches: %.1fus/message", 2 * N_BENCH_MATCHES, (double) n / N_BENCH_RUNS);
+
+        bus_match_free(&root);
+}
+
 int main(int argc, char *argv[]) {
         struct bus_match_node root = {
                 .type = BUS_MATCH_ROOT,
@@ -148,6 +268,9 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_prefix_matches(bus);
+        test_match_benchmark(bus);
+
         test_match_scope("interface='foobar'", BUS_MATCH_GENERIC);
         test_match_scope("", BUS_MATCH_GENERIC);
         test_match_scope("interface='org.freedesktop.DBus.Local'", BUS_MATCH_LOCAL);
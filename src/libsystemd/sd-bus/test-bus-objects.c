@@ -29,6 +29,8 @@
 #include "bus-util.h"
 #include "log.h"
 #include "macro.h"
+#include "stdio-util.h"
+#include "string-util.h"
 #include "strv.h"
 #include "util.h"
 
@@ -38,6 +40,8 @@ struct context {
         char *something;
         char *automatic_string_property;
         uint32_t automatic_integer_property;
+        uint32_t counter;
+        unsigned n_counter_get;
 };
 
 static int something_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
@@ -194,6 +198,23 @@ static int emit_object_removed(sd_bus_message *m, void *userdata, sd_bus_error *
         return 1;
 }
 
+static int counter_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->n_counter_get++;
+
+        return sd_bus_message_append(reply, "u", c->counter);
+}
+
+static int bump(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->counter++;
+        assert_se(sd_bus_emit_properties_changed(sd_bus_message_get_bus(m), m->path, "org.freedesktop.systemd.CachedTest", "Counter", NULL) >= 0);
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
 static const sd_bus_vtable vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("AlterSomething", "s", "s", something_handler, 0),
@@ -221,6 +242,21 @@ static const sd_bus_vtable vtable2[] = {
         SD_BUS_VTABLE_END
 };
 
+static const sd_bus_vtable cached_vtable[] = {
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_CACHE_PROPERTIES),
+        SD_BUS_METHOD("Bump", "", "", bump, 0),
+        SD_BUS_PROPERTY("Counter", "u", counter_handler, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Something", "s", NULL, offsetof(struct context, something), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Hidden", "u", counter_handler, 0, SD_BUS_VTABLE_HIDDEN),
+        SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable uncacheable_vtable[] = {
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_CACHE_PROPERTIES),
+        SD_BUS_PROPERTY("Counter", "u", counter_handler, 0, 0),
+        SD_BUS_VTABLE_END
+};
+
 static int enumerator_callback(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
 
         if (object_path_startswith("/value", path))
@@ -250,6 +286,7 @@ static void *server(void *p) {
         assert_se(sd_bus_new(&bus) >= 0);
         assert_se(sd_bus_set_fd(bus, c->fds[0], c->fds[0]) >= 0);
         assert_se(sd_bus_set_server(bus, 1, id) >= 0);
+        assert_se(sd_bus_set_method_stats(bus, true) >= 0);
 
         assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test", vtable, c) >= 0);
         assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test2", vtable, c) >= 0);
@@ -258,6 +295,8 @@ static void *server(void *p) {
         assert_se(sd_bus_add_node_enumerator(bus, NULL, "/value/a", enumerator2_callback, NULL) >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value") >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value/a") >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/cached", "org.freedesktop.systemd.CachedTest", cached_vtable, c) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/cached", "org.freedesktop.systemd.CachedTest2", uncacheable_vtable, c) == -EINVAL);
 
         assert_se(sd_bus_start(bus) >= 0);
 
@@ -294,11 +333,81 @@ fail:
         return INT_TO_PTR(r);
 }
 
+static void test_method_stats(sd_bus *bus) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        const char *interface, *member;
+        bool found = false, found_other = false;
+        uint32_t n_buckets;
+        unsigned i;
+
+        /* Calls to methods nobody registered must not get entries of their own */
+        for (i = 0; i < 3; i++) {
+                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+                char member_buf[sizeof("DoesNotExist") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(member_buf, "DoesNotExist%u", i);
+                assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", member_buf, &error, NULL, NULL) < 0);
+        }
+
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/", "org.freedesktop.LibSystemd1.Stats", "GetMethodStats", NULL, &reply, NULL) >= 0);
+        assert_se(sd_bus_message_read(reply, "u", &n_buckets) >= 0);
+        assert_se(n_buckets > 0);
+
+        assert_se(sd_bus_message_enter_container(reply, 'a', "(ssa(ttat))") > 0);
+        while (sd_bus_message_enter_container(reply, 'r', "ssa(ttat)") > 0) {
+                unsigned phase = 0;
+
+                assert_se(sd_bus_message_read(reply, "ss", &interface, &member) > 0);
+
+                assert_se(sd_bus_message_enter_container(reply, 'a', "(ttat)") > 0);
+                while (sd_bus_message_enter_container(reply, 'r', "ttat") > 0) {
+                        const uint64_t *buckets;
+                        uint64_t n, total, sum = 0;
+                        size_t sz, i;
+
+                        assert_se(sd_bus_message_read(reply, "tt", &n, &total) > 0);
+                        assert_se(sd_bus_message_read_array(reply, 't', (const void**) &buckets, &sz) > 0);
+                        assert_se(sz == n_buckets * sizeof(uint64_t));
+
+                        for (i = 0; i < n_buckets; i++)
+                                sum += buckets[i];
+                        assert_se(sum == n);
+
+                        /* AlterSomething() was called twice, once with the wrong signature, and each
+                         * call gets queued, handled and replied to */
+                        if (streq(interface, "org.freedesktop.systemd.test") && streq(member, "AlterSomething")) {
+                                assert_se(n == 2);
+                                found = true;
+                        }
+
+                        assert_se(!startswith(member, "DoesNotExist"));
+
+                        /* The unknown methods are all counted in the catch-all entry */
+                        if (isempty(interface) && isempty(member)) {
+                                assert_se(n >= 3);
+                                found_other = true;
+                        }
+
+                        assert_se(sd_bus_message_exit_container(reply) > 0);
+                        phase++;
+                }
+                assert_se(phase == 3);
+
+                assert_se(sd_bus_message_exit_container(reply) > 0);
+                assert_se(sd_bus_message_exit_container(reply) > 0);
+        }
+        assert_se(sd_bus_message_exit_container(reply) > 0);
+
+        assert_se(found);
+        assert_se(found_other);
+}
+
 static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         const char *s;
+        unsigned i;
         int r;
 
         assert_se(sd_bus_new(&bus) >= 0);
@@ -421,6 +530,40 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        for (i = 0; i < 3; i++) {
+                const char *v;
+                uint32_t u;
+
+                /* The first call fills the cache, the second one is served from it, the third one
+                 * follows a change signal and hence needs to call the getter again */
+                if (i == 2) {
+                        r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.systemd.CachedTest", "Bump", &error, NULL, NULL);
+                        assert_se(r >= 0);
+
+                        r = sd_bus_process(bus, &reply);
+                        assert_se(r > 0);
+                        assert_se(sd_bus_message_is_signal(reply, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+                        reply = sd_bus_message_unref(reply);
+                }
+
+                r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.DBus.Properties", "GetAll", &error, &reply, "s", "org.freedesktop.systemd.CachedTest");
+                assert_se(r >= 0);
+
+                assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+                assert_se(sd_bus_message_read(reply, "{sv}", &s, "u", &u) > 0);
+                assert_se(streq(s, "Counter"));
+                assert_se(u == (i == 2));
+                assert_se(sd_bus_message_read(reply, "{sv}", &s, "s", &v) > 0);
+                assert_se(streq(s, "Something"));
+                assert_se(streq(v, c->something));
+                assert_se(sd_bus_message_at_end(reply, false) > 0);
+                assert_se(sd_bus_message_exit_container(reply) >= 0);
+                /* The PropertiesChanged signal carries the new value, hence needs another getter call */
+                assert_se(c->n_counter_get == (i == 2 ? 3 : 1));
+
+                reply = sd_bus_message_unref(reply);
+        }
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/value/a", "org.freedesktop.DBus.Properties", "GetAll", &error, &reply, "s", "org.freedesktop.systemd.ValueTest2");
         assert_se(r < 0);
         assert_se(sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_INTERFACE));
@@ -511,6 +654,8 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        test_method_stats(bus);
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", "Exit", &error, NULL, "");
         assert_se(r >= 0);
 
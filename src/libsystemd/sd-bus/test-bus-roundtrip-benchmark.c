@@ -0,0 +1,180 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "log.h"
+#include "macro.h"
+#include "string-util.h"
+#include "tests.h"
+#include "util.h"
+
+/* Measures building, sealing and parsing a message with a typical property payload, and method call round trips
+ * between a client and a server connected directly through a socket pair, without any broker in between. Unlike
+ * test-bus-benchmark this needs no running bus, hence it can be run anywhere. */
+
+typedef struct Context {
+        sd_bus *server;
+        sd_bus *client;
+} Context;
+
+static void message_append_properties(sd_bus_message *m, unsigned i) {
+        assert_se(sd_bus_message_append(m, "s", "org.freedesktop.systemd1.Unit") >= 0);
+        assert_se(sd_bus_message_append(m, "a{sv}", 3,
+                                        "Id", "s", "waldo.service",
+                                        "ActiveState", "s", "active",
+                                        "MainPID", "u", i) >= 0);
+}
+
+static void message_read_properties(sd_bus_message *m, unsigned i) {
+        const char *interface, *id, *state;
+        unsigned k;
+        uint32_t pid;
+
+        assert_se(sd_bus_message_read(m, "s", &interface) > 0);
+        assert_se(sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}") > 0);
+
+        for (k = 0; k < 3; k++) {
+                const char *name;
+
+                assert_se(sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv") > 0);
+                assert_se(sd_bus_message_read(m, "s", &name) > 0);
+
+                if (streq(name, "MainPID"))
+                        assert_se(sd_bus_message_read(m, "v", "u", &pid) > 0);
+                else if (streq(name, "Id"))
+                        assert_se(sd_bus_message_read(m, "v", "s", &id) > 0);
+                else
+                        assert_se(sd_bus_message_read(m, "v", "s", &state) > 0);
+
+                assert_se(sd_bus_message_exit_container(m) > 0);
+        }
+
+        assert_se(sd_bus_message_exit_container(m) > 0);
+        assert_se(pid == i);
+}
+
+static nsec_t bench_marshal(unsigned n, void *userdata) {
+        Context *c = userdata;
+        unsigned i;
+        nsec_t t;
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                assert_se(sd_bus_message_new_method_call(c->client, &m, NULL, "/org/freedesktop/systemd1/unit/waldo_2eservice",
+                                                         "org.freedesktop.DBus.Properties", "Set") >= 0);
+                message_append_properties(m, i);
+                assert_se(bus_message_seal(m, i + 1, 0) >= 0);
+
+                assert_se(sd_bus_message_rewind(m, true) >= 0);
+                message_read_properties(m, i);
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        return t;
+}
+
+static int reply_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        unsigned *replies = userdata;
+
+        assert_se(!sd_bus_message_is_method_error(m, NULL));
+        (*replies)++;
+
+        return 1;
+}
+
+static nsec_t bench_roundtrip(unsigned n, void *userdata) {
+        Context *c = userdata;
+        unsigned i, replies = 0;
+        nsec_t t;
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                assert_se(sd_bus_message_new_method_call(c->client, &m, NULL, "/org/freedesktop/systemd1/unit/waldo_2eservice",
+                                                         "org.freedesktop.DBus.Properties", "Set") >= 0);
+                message_append_properties(m, i);
+                assert_se(sd_bus_call_async(c->client, NULL, m, reply_handler, &replies, 0) >= 0);
+
+                /* Serve the call on the other end, and then dispatch its reply */
+                for (;;) {
+                        _cleanup_(sd_bus_message_unrefp) sd_bus_message *call = NULL, *reply = NULL;
+
+                        assert_se(sd_bus_process(c->server, &call) >= 0);
+                        if (!call)
+                                continue;
+
+                        assert_se(sd_bus_message_is_method_call(call, "org.freedesktop.DBus.Properties", "Set"));
+                        message_read_properties(call, i);
+
+                        assert_se(sd_bus_message_new_method_return(call, &reply) >= 0);
+                        assert_se(sd_bus_send(c->server, reply, NULL) >= 0);
+                        break;
+                }
+
+                while (replies <= i)
+                        assert_se(sd_bus_process(c->client, NULL) >= 0);
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        Context c = {};
+        sd_id128_t id;
+        int pair[2];
+        unsigned n;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        n = benchmark_get_iterations(argc, argv, 5000, 200000);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&c.server) >= 0);
+        assert_se(sd_bus_set_fd(c.server, pair[0], pair[0]) >= 0);
+        assert_se(sd_bus_set_server(c.server, 1, id) >= 0);
+        assert_se(sd_bus_start(c.server) >= 0);
+
+        assert_se(sd_bus_new(&c.client) >= 0);
+        assert_se(sd_bus_set_fd(c.client, pair[1], pair[1]) >= 0);
+        assert_se(sd_bus_start(c.client) >= 0);
+
+        while (c.server->state != BUS_RUNNING || c.client->state != BUS_RUNNING) {
+                assert_se(sd_bus_process(c.server, NULL) >= 0);
+                assert_se(sd_bus_process(c.client, NULL) >= 0);
+        }
+
+        benchmark_run("sd-bus", "marshal", n, bench_marshal, &c);
+        benchmark_run("sd-bus", "roundtrip", n, bench_roundtrip, &c);
+
+        c.client = sd_bus_flush_close_unref(c.client);
+        c.server = sd_bus_flush_close_unref(c.server);
+
+        return 0;
+}
@@ -17,6 +17,7 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdlib.h>
 
@@ -24,6 +25,7 @@
 
 #include "bus-internal.h"
 #include "bus-util.h"
+#include "fd-util.h"
 #include "log.h"
 #include "macro.h"
 #include "util.h"
@@ -188,6 +190,93 @@ static int test_one(bool client_negotiate_unix_fds, bool server_negotiate_unix_f
         return 0;
 }
 
+static void test_pipelined(void) {
+        _cleanup_(sd_bus_unrefp) sd_bus *server = NULL, *client = NULL;
+        unsigned i, n_received = 0;
+        int pair[2];
+        sd_id128_t id;
+
+        /* Many messages queued up before the other side reads, so that they are sent and received in batches,
+         * with a file descriptor attached to some of them */
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, pair[0], pair[0]) >= 0);
+        assert_se(sd_bus_set_server(server, 1, id) >= 0);
+        assert_se(sd_bus_negotiate_fds(server, true) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, pair[1], pair[1]) >= 0);
+        assert_se(sd_bus_negotiate_fds(client, true) >= 0);
+        assert_se(sd_bus_start(client) >= 0);
+
+        while (server->state != BUS_RUNNING || client->state != BUS_RUNNING) {
+                assert_se(sd_bus_process(server, NULL) >= 0);
+                assert_se(sd_bus_process(client, NULL) >= 0);
+        }
+
+        assert_se(sd_bus_can_send(client, SD_BUS_TYPE_UNIX_FD) > 0);
+
+        /* Queue up the first half without writing anything, so that it is written in batches */
+        assert_se(sd_bus_set_cork(client, true) == 1);
+        assert_se(sd_bus_get_cork(client) > 0);
+
+        for (i = 0; i < 2000; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                if (i == 1000) {
+                        assert_se(client->wqueue_size == 1000);
+                        assert_se(sd_bus_set_cork(client, false) == 1);
+                        assert_se(sd_bus_get_cork(client) == 0);
+                }
+
+                assert_se(sd_bus_message_new_method_call(client, &m, NULL, "/", "org.freedesktop.systemd.test", "Pipelined") >= 0);
+
+                if (i % 7 == 3) {
+                        _cleanup_close_ int fd = -1;
+
+                        assert_se((fd = open("/dev/null", O_RDONLY|O_CLOEXEC)) >= 0);
+                        assert_se(sd_bus_message_append(m, "uh", i, fd) >= 0);
+                } else
+                        assert_se(sd_bus_message_append(m, "us", i, "waldo") >= 0);
+
+                assert_se(sd_bus_send(client, m, NULL) >= 0);
+        }
+
+        while (n_received < i) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                uint32_t u;
+                int r;
+
+                assert_se(sd_bus_flush(client) >= 0);
+
+                r = sd_bus_process(server, &m);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(server, 100 * USEC_PER_MSEC) >= 0);
+                if (!m || !sd_bus_message_is_method_call(m, "org.freedesktop.systemd.test", "Pipelined"))
+                        continue;
+
+                if (sd_bus_message_has_signature(m, "uh")) {
+                        int fd;
+
+                        assert_se(sd_bus_message_read(m, "uh", &u, &fd) > 0);
+                        assert_se(fd >= 0);
+                        assert_se(u % 7 == 3);
+                } else {
+                        const char *x;
+
+                        assert_se(sd_bus_message_read(m, "us", &u, &x) > 0);
+                        assert_se(u % 7 != 3);
+                }
+
+                assert_se(u == n_received++);
+        }
+}
+
 int main(int argc, char *argv[]) {
         int r;
 
@@ -212,5 +301,7 @@ int main(int argc, char *argv[]) {
         r = test_one(true, true, true, false);
         assert_se(r == -EPERM);
 
+        test_pipelined();
+
         return EXIT_SUCCESS;
 }
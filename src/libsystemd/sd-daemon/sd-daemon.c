@@ -38,6 +38,7 @@
 #include "fs-util.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "socket-util.h"
 #include "strv.h"
 #include "util.h"
@@ -458,6 +459,88 @@ _public_ int sd_is_mq(int fd, const char *path) {
         return 1;
 }
 
+/* The socket used for sending notifications is created once and then reused by all subsequent calls, as services
+ * sending watchdog pings and status updates at a high rate otherwise pay for a socket()/setsockopt()/close() round
+ * trip each time. It is not connected, so it works for whatever $NOTIFY_SOCKET says at the time of the call. The
+ * program might close the fd behind our back (for example when closing all fds after fork()), hence we remember
+ * what the socket looked like and verify that the fd still refers to it before each use.
+ *
+ * The cache is guarded by a lock that records the PID of its holder, and that is only ever tried, never waited
+ * for: a normal mutex held by some other thread at the time of fork() would stay locked forever in the child. If
+ * the holder is another thread of ours, we simply use a private socket for this one message. If it is a thread of
+ * the process we were forked from, we take the lock over. */
+static pid_t notify_socket_owner = 0;
+static int notify_socket_fd = -1;
+static dev_t notify_socket_dev = 0;
+static ino_t notify_socket_ino = 0;
+
+static bool notify_socket_trylock(void) {
+        int r;
+
+        r = pid_trylock(&notify_socket_owner);
+        if (r < 0)
+                return false;
+        if (r > 0) {
+                /* The previous holder might have been in the middle of updating the cache, hence forget about
+                 * it, but don't close anything, as we can't tell what the fd refers to. */
+                notify_socket_fd = -1;
+        }
+
+        return true;
+}
+
+static int notify_socket_new(void) {
+        int fd;
+
+        fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return -errno;
+
+        fd_inc_sndbuf(fd, SNDBUF_SIZE);
+
+        return fd;
+}
+
+static int notify_socket_acquire(void) {
+        struct stat st;
+        int fd;
+
+        if (!notify_socket_trylock())
+                return -EBUSY;
+
+        if (notify_socket_fd >= 0) {
+                if (fstat(notify_socket_fd, &st) >= 0 &&
+                    S_ISSOCK(st.st_mode) &&
+                    st.st_dev == notify_socket_dev &&
+                    st.st_ino == notify_socket_ino) {
+                        fd = notify_socket_fd;
+                        goto finish;
+                }
+
+                /* The fd got closed or reused for something else. It's not ours anymore, hence just forget
+                 * about it, don't close it. */
+                notify_socket_fd = -1;
+        }
+
+        fd = notify_socket_new();
+        if (fd < 0)
+                goto finish;
+
+        if (fstat(fd, &st) < 0) {
+                safe_close(fd);
+                fd = -errno;
+                goto finish;
+        }
+
+        notify_socket_fd = fd;
+        notify_socket_dev = st.st_dev;
+        notify_socket_ino = st.st_ino;
+
+finish:
+        pid_unlock(&notify_socket_owner);
+        return fd;
+}
+
 _public_ int sd_pid_notify_with_fds(pid_t pid, int unset_environment, const char *state, const int *fds, unsigned n_fds) {
         union sockaddr_union sockaddr = {
                 .sa.sa_family = AF_UNIX,
@@ -470,11 +553,11 @@ _public_ int sd_pid_notify_with_fds(pid_t pid, int unset_environment, const char
                 .msg_iovlen = 1,
                 .msg_name = &sockaddr,
         };
-        _cleanup_close_ int fd = -1;
+        _cleanup_close_ int temporary_fd = -1;
         struct cmsghdr *cmsg = NULL;
         const char *e;
         bool have_pid;
-        int r;
+        int fd, r;
 
         if (!state) {
                 r = -EINVAL;
@@ -501,14 +584,14 @@ _public_ int sd_pid_notify_with_fds(pid_t pid, int unset_environment, const char
                 goto finish;
         }
 
-        fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        fd = notify_socket_acquire();
+        if (fd == -EBUSY) /* Another thread is busy with the shared socket right now */
+                fd = temporary_fd = notify_socket_new();
         if (fd < 0) {
-                r = -errno;
+                r = fd;
                 goto finish;
         }
 
-        fd_inc_sndbuf(fd, SNDBUF_SIZE);
-
         iovec.iov_len = strlen(state);
 
         strncpy(sockaddr.un.sun_path, e, sizeof(sockaddr.un.sun_path));
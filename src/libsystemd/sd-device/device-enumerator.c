@@ -509,23 +509,13 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                         continue;
                 }
 
-                k = sd_device_get_devnum(device, &devnum);
-                if (k < 0) {
-                        r = k;
+                if (!match_parent(enumerator, device))
                         continue;
-                }
 
-                k = sd_device_get_ifindex(device, &ifindex);
-                if (k < 0) {
-                        r = k;
-                        continue;
-                }
-
-                k = sd_device_get_is_initialized(device, &initialized);
-                if (k < 0) {
-                        r = k;
+                /* Check the sysattr matches before anything else is loaded: they only read the attributes
+                 * they ask for, while the checks below need the uevent file and the udev database. */
+                if (!match_sysattr(enumerator, device))
                         continue;
-                }
 
                 /*
                  * All devices with a device node or network interfaces
@@ -537,13 +527,30 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                  * might not store a database, and have no way to find out
                  * for all other types of devices.
                  */
-                if (!enumerator->match_allow_uninitialized &&
-                    !initialized &&
-                    (major(devnum) > 0 || ifindex > 0))
-                        continue;
+                if (!enumerator->match_allow_uninitialized) {
+                        k = sd_device_get_devnum(device, &devnum);
+                        if (k < 0) {
+                                r = k;
+                                continue;
+                        }
 
-                if (!match_parent(enumerator, device))
-                        continue;
+                        k = sd_device_get_ifindex(device, &ifindex);
+                        if (k < 0) {
+                                r = k;
+                                continue;
+                        }
+
+                        if (major(devnum) > 0 || ifindex > 0) {
+                                k = sd_device_get_is_initialized(device, &initialized);
+                                if (k < 0) {
+                                        r = k;
+                                        continue;
+                                }
+
+                                if (!initialized)
+                                        continue;
+                        }
+                }
 
                 if (!match_tag(enumerator, device))
                         continue;
@@ -551,9 +558,6 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                 if (!match_property(enumerator, device))
                         continue;
 
-                if (!match_sysattr(enumerator, device))
-                        continue;
-
                 k = device_enumerator_add_device(enumerator, device);
                 if (k < 0)
                         r = k;
@@ -18,6 +18,7 @@
 ***/
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
 
@@ -27,12 +28,15 @@
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "macro.h"
+#include "mempool.h"
 #include "missing.h"
 #include "prioq.h"
 #include "process-util.h"
+#include "ratelimit.h"
 #include "set.h"
 #include "signal-util.h"
 #include "string-table.h"
@@ -42,6 +46,17 @@
 
 #define DEFAULT_ACCURACY_USEC (250 * USEC_PER_MSEC)
 
+/* The maximum number of epoll events fetched in one go */
+#define EPOLL_QUEUE_MAX 512U
+
+/* Time sources on the monotonic and boottime clocks with an accuracy in the range [TIMER_WHEEL_SLOT_USEC,
+ * 2*TIMER_WHEEL_SLOT_USEC), which includes the default accuracy, are kept in a timer wheel instead of the
+ * prioqs of their clock, as long as their latest dispatch time is less than TIMER_WHEEL_SLOTS slots away. */
+#define TIMER_WHEEL_SLOT_USEC DEFAULT_ACCURACY_USEC
+#define TIMER_WHEEL_SLOTS 256U
+#define TIMER_WHEEL_EXPIRED TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_UNLINKED ((unsigned) -1)
+
 typedef enum EventSourceType {
         SOURCE_IO,
         SOURCE_TIME_REALTIME,
@@ -55,6 +70,7 @@ typedef enum EventSourceType {
         SOURCE_POST,
         SOURCE_EXIT,
         SOURCE_WATCHDOG,
+        SOURCE_INOTIFY,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -1
 } EventSourceType;
@@ -72,6 +88,7 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_POST] = "post",
         [SOURCE_EXIT] = "exit",
         [SOURCE_WATCHDOG] = "watchdog",
+        [SOURCE_INOTIFY] = "inotify",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
@@ -83,6 +100,7 @@ typedef enum WakeupType {
         WAKEUP_EVENT_SOURCE,
         WAKEUP_CLOCK_DATA,
         WAKEUP_SIGNAL_DATA,
+        WAKEUP_INOTIFY_DATA,
         _WAKEUP_TYPE_MAX,
         _WAKEUP_TYPE_INVALID = -1,
 } WakeupType;
@@ -105,6 +123,8 @@ struct sd_event_source {
         bool pending:1;
         bool dispatching:1;
         bool floating:1;
+        bool ratelimited:1;
+        bool from_pool:1;
 
         int64_t priority;
         unsigned pending_index;
@@ -112,6 +132,15 @@ struct sd_event_source {
         uint64_t pending_iteration;
         uint64_t prepare_iteration;
 
+        /* Only maintained with SD_EVENT_PROFILE_DELAYS=1, reset whenever the profile is logged */
+        unsigned n_dispatched;
+        usec_t dispatch_usec;
+
+        /* Once the burst is used up within the interval, the source is paused until ratelimit_timer
+         * fires at the end of the interval */
+        RateLimit rate_limit;
+        sd_event_source *ratelimit_timer;
+
         LIST_FIELDS(sd_event_source, sources);
 
         union {
@@ -127,6 +156,9 @@ struct sd_event_source {
                         usec_t next, accuracy;
                         unsigned earliest_index;
                         unsigned latest_index;
+                        unsigned wheel_slot;
+                        bool in_wheel:1;
+                        LIST_FIELDS(sd_event_source, wheel);
                 } time;
                 struct {
                         sd_event_signal_handler_t callback;
@@ -138,6 +170,8 @@ struct sd_event_source {
                         siginfo_t siginfo;
                         pid_t pid;
                         int options;
+                        int pidfd;
+                        bool registered:1;
                 } child;
                 struct {
                         sd_event_handler_t callback;
@@ -149,9 +183,17 @@ struct sd_event_source {
                         sd_event_handler_t callback;
                         unsigned prioq_index;
                 } exit;
+                struct {
+                        sd_event_inotify_handler_t callback;
+                        uint32_t mask;
+                        struct inode_data *inode_data;
+                        LIST_FIELDS(sd_event_source, by_inode_data);
+                } inotify;
         };
 };
 
+DEFINE_MEMPOOL(event_source_pool, sd_event_source, 64);
+
 struct clock_data {
         WakeupType wakeup;
         int fd;
@@ -167,9 +209,34 @@ struct clock_data {
         Prioq *latest;
         usec_t next;
 
+        struct timer_wheel *wheel;
+
         bool needs_rearm:1;
 };
 
+struct timer_wheel {
+        /* Slot k covers the time range starting at k*TIMER_WHEEL_SLOT_USEC plus the sub-slot part of the
+         * perturbation, and lists the sources whose latest dispatch time falls into it. Since their
+         * accuracy is at least one slot wide, all of them may be dispatched when the slot begins. Only
+         * slots in the range [cursor, cursor+TIMER_WHEEL_SLOTS) are used, and each is stored at index k
+         * modulo TIMER_WHEEL_SLOTS. Sources whose slot lies before the cursor are due right-away and
+         * are listed in "expired". */
+        LIST_HEAD(sd_event_source, slots[TIMER_WHEEL_SLOTS]);
+        LIST_HEAD(sd_event_source, expired);
+        uint32_t bitmap[TIMER_WHEEL_SLOTS / 32];
+        uint64_t cursor;
+        unsigned n_linked;
+};
+
+/* A callback handed over from another thread with sd_event_post_to() */
+typedef struct EventHandoff EventHandoff;
+
+struct EventHandoff {
+        EventHandoff *next;
+        sd_event_handler_t callback;
+        void *userdata;
+};
+
 struct signal_data {
         WakeupType wakeup;
 
@@ -183,6 +250,59 @@ struct signal_data {
         sd_event_source *current;
 };
 
+/* Watching the same inode from multiple event sources (of the same priority) is merged into a single
+ * inotify watch descriptor, keyed by the inode's device and inode number. */
+struct inode_data {
+        dev_t dev;
+        ino_t ino;
+
+        /* An O_PATH fd to the inode. We need it to add a watch descriptor to a different inotify object when the
+         * priority of an event source is changed. Keeping it open forever would waste an fd per watched inode
+         * and keep the mount busy, hence it is closed again when the next event loop iteration is prepared,
+         * and priorities may only be changed until then. All inode_data objects with an open fd are linked
+         * in the to_close list of the event loop. */
+        int fd;
+
+        int wd;
+
+        /* The combined mask of all event sources watching this inode, as last set on the watch descriptor */
+        uint32_t combined_mask;
+
+        LIST_HEAD(sd_event_source, event_sources);
+
+        struct inotify_data *inotify_data;
+
+        LIST_FIELDS(struct inode_data, to_close);
+};
+
+#define INOTIFY_BUFFER_SIZE (16 * INOTIFY_EVENT_MAX)
+
+struct inotify_data {
+        WakeupType wakeup;
+
+        /* For each priority we maintain one inotify fd, like for signals */
+        int fd;
+        int64_t priority;
+
+        Hashmap *inodes; /* struct inode_data by dev and inode number */
+        Hashmap *wd;     /* struct inode_data by watch descriptor */
+
+        /* The event currently being dispatched, and the number of event sources still pending for it. No
+         * further event is taken from the buffer before all of them have been dispatched. */
+        union inotify_event_buffer current;
+        unsigned n_pending;
+
+        /* Events are read in batches, and stay in here until they have been dispatched one by one */
+        union {
+                struct inotify_event ev;
+                uint8_t raw[INOTIFY_BUFFER_SIZE];
+        } buffer;
+        size_t buffer_offset, buffer_filled;
+
+        /* Linked into inotify_data_buffered of the event loop for as long as the buffer is not empty */
+        LIST_FIELDS(struct inotify_data, buffered);
+};
+
 struct sd_event {
         unsigned n_ref;
 
@@ -213,6 +333,15 @@ struct sd_event {
 
         Prioq *exit;
 
+        Hashmap *inotify_data; /* indexed by priority */
+        LIST_HEAD(struct inode_data, inode_data_to_close);
+        LIST_HEAD(struct inotify_data, inotify_data_buffered);
+
+        /* Callbacks posted by other threads, pushed without taking a lock and drained by wakeup_source */
+        EventHandoff *handoff;
+        int wakeup_fd;
+        sd_event_source *wakeup_source;
+
         pid_t original_pid;
 
         uint64_t iteration;
@@ -235,6 +364,9 @@ struct sd_event {
 
         LIST_HEAD(sd_event_source, sources);
 
+        struct epoll_event *event_queue;
+        size_t event_queue_allocated;
+
         usec_t last_run, last_log;
         unsigned delays[sizeof(usec_t) * 8];
 };
@@ -355,6 +487,109 @@ static int latest_time_prioq_compare(const void *a, const void *b) {
         return 0;
 }
 
+static usec_t timer_wheel_offset(sd_event *e) {
+        assert(e->perturb != USEC_INFINITY);
+
+        return e->perturb % TIMER_WHEEL_SLOT_USEC;
+}
+
+static usec_t timer_wheel_slot_start(sd_event *e, uint64_t k) {
+        return k * TIMER_WHEEL_SLOT_USEC + timer_wheel_offset(e);
+}
+
+static bool timer_wheel_slot_of(sd_event *e, usec_t t, uint64_t *ret) {
+        usec_t o;
+
+        o = timer_wheel_offset(e);
+        if (t < o)
+                return false;
+
+        *ret = (t - o) / TIMER_WHEEL_SLOT_USEC;
+        return true;
+}
+
+static void timer_wheel_link(sd_event *e, struct clock_data *d, sd_event_source *s) {
+        struct timer_wheel *w = d->wheel;
+        uint64_t k;
+
+        assert(w);
+        assert(s->time.in_wheel);
+        assert(s->time.wheel_slot == TIMER_WHEEL_UNLINKED);
+
+        if (!timer_wheel_slot_of(e, time_event_source_latest(s), &k) || k < w->cursor) {
+                LIST_PREPEND(time.wheel, w->expired, s);
+                s->time.wheel_slot = TIMER_WHEEL_EXPIRED;
+        } else {
+                unsigned i;
+
+                /* The cursor only moves forward, hence this holds as long as it held when the source
+                 * was put into the wheel, see timer_wheel_fits() */
+                assert(k - w->cursor < TIMER_WHEEL_SLOTS);
+
+                i = k % TIMER_WHEEL_SLOTS;
+                LIST_PREPEND(time.wheel, w->slots[i], s);
+                w->bitmap[i / 32] |= UINT32_C(1) << (i % 32);
+                s->time.wheel_slot = i;
+        }
+
+        w->n_linked++;
+        d->needs_rearm = true;
+}
+
+static void timer_wheel_unlink(struct clock_data *d, sd_event_source *s) {
+        struct timer_wheel *w = d->wheel;
+        unsigned i;
+
+        assert(s->time.in_wheel);
+
+        i = s->time.wheel_slot;
+        if (i == TIMER_WHEEL_UNLINKED)
+                return;
+
+        assert(w);
+
+        if (i == TIMER_WHEEL_EXPIRED)
+                LIST_REMOVE(time.wheel, w->expired, s);
+        else {
+                LIST_REMOVE(time.wheel, w->slots[i], s);
+                if (!w->slots[i])
+                        w->bitmap[i / 32] &= ~(UINT32_C(1) << (i % 32));
+        }
+
+        s->time.wheel_slot = TIMER_WHEEL_UNLINKED;
+
+        assert(w->n_linked > 0);
+        w->n_linked--;
+        d->needs_rearm = true;
+}
+
+static usec_t timer_wheel_next(sd_event *e, struct clock_data *d) {
+        struct timer_wheel *w = d->wheel;
+        unsigned start, n;
+
+        /* Returns the beginning of the first populated slot, i.e. the time the next source linked into
+         * the wheel has to be dispatched at */
+
+        if (!w || w->n_linked == 0)
+                return USEC_INFINITY;
+        if (w->expired)
+                return 0;
+
+        start = w->cursor % TIMER_WHEEL_SLOTS;
+        for (n = 0; n < TIMER_WHEEL_SLOTS;) {
+                unsigned i = (start + n) % TIMER_WHEEL_SLOTS;
+                uint32_t bits;
+
+                bits = w->bitmap[i / 32] >> (i % 32);
+                if (bits != 0)
+                        return timer_wheel_slot_start(e, w->cursor + n + u32ctz(bits));
+
+                n += 32 - i % 32;
+        }
+
+        assert_not_reached("Timer wheel has linked sources, but no populated slot.");
+}
+
 static int exit_prioq_compare(const void *a, const void *b) {
         const sd_event_source *x = a, *y = b;
 
@@ -383,6 +618,9 @@ static void free_clock_data(struct clock_data *d) {
         safe_close(d->fd);
         prioq_free(d->earliest);
         prioq_free(d->latest);
+
+        assert(!d->wheel || d->wheel->n_linked == 0);
+        free(d->wheel);
 }
 
 static void event_free(sd_event *e) {
@@ -390,6 +628,10 @@ static void event_free(sd_event *e) {
 
         assert(e);
 
+        /* Rate limit timers are floating, but owned by the source they belong to, release them first */
+        LIST_FOREACH(sources, s, e->sources)
+                s->ratelimit_timer = sd_event_source_unref(s->ratelimit_timer);
+
         while ((s = e->sources)) {
                 assert(s->floating);
                 source_disconnect(s);
@@ -419,6 +661,20 @@ static void event_free(sd_event *e) {
 
         hashmap_free(e->child_sources);
         set_free(e->post_sources);
+
+        assert(hashmap_isempty(e->inotify_data));
+        hashmap_free(e->inotify_data);
+
+        free(e->event_queue);
+
+        while (e->handoff) {
+                EventHandoff *h = e->handoff;
+
+                e->handoff = h->next;
+                free(h);
+        }
+        safe_close(e->wakeup_fd);
+
         free(e);
 }
 
@@ -433,7 +689,7 @@ _public_ int sd_event_new(sd_event** ret) {
                 return -ENOMEM;
 
         e->n_ref = 1;
-        e->watchdog_fd = e->epoll_fd = e->realtime.fd = e->boottime.fd = e->monotonic.fd = e->realtime_alarm.fd = e->boottime_alarm.fd = -1;
+        e->wakeup_fd = e->watchdog_fd = e->epoll_fd = e->realtime.fd = e->boottime.fd = e->monotonic.fd = e->realtime_alarm.fd = e->boottime_alarm.fd = -1;
         e->realtime.next = e->boottime.next = e->monotonic.next = e->realtime_alarm.next = e->boottime_alarm.next = USEC_INFINITY;
         e->realtime.wakeup = e->boottime.wakeup = e->monotonic.wakeup = e->realtime_alarm.wakeup = e->boottime_alarm.wakeup = WAKEUP_CLOCK_DATA;
         e->original_pid = getpid_cached();
@@ -450,7 +706,7 @@ _public_ int sd_event_new(sd_event** ret) {
         }
 
         if (secure_getenv("SD_EVENT_PROFILE_DELAYS")) {
-                log_debug("Event loop profiling enabled. Logarithmic histogram of event loop iterations in the range 2^0 ... 2^63 us will be logged every 5s.");
+                log_debug("Event loop profiling enabled. Logarithmic histogram of event loop iterations in the range 2^0 ... 2^63 us, and the time spent per event source, will be logged every 5s.");
                 e->profile_delays = true;
         }
 
@@ -516,6 +772,42 @@ static void source_io_unregister(sd_event_source *s) {
         s->io.registered = false;
 }
 
+static void source_child_pidfd_unregister(sd_event_source *s) {
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+
+        if (event_pid_changed(s->event))
+                return;
+
+        if (!s->child.registered)
+                return;
+
+        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->child.pidfd, NULL) < 0)
+                log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll: %m",
+                                strna(s->description), event_source_type_to_string(s->type));
+
+        s->child.registered = false;
+}
+
+static int source_child_pidfd_register(sd_event_source *s) {
+        struct epoll_event ev = {};
+
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+
+        if (s->child.pidfd < 0 || s->child.registered)
+                return 0;
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = s;
+
+        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, s->child.pidfd, &ev) < 0)
+                return -errno;
+
+        s->child.registered = true;
+        return 0;
+}
+
 static int source_io_register(
                 sd_event_source *s,
                 int enabled,
@@ -787,142 +1079,496 @@ static void event_gc_signal_data(sd_event *e, const int64_t *priority, int sig)
                 event_unmask_signal_data(e, d, sig);
 }
 
-static void source_disconnect(sd_event_source *s) {
-        sd_event *event;
-
-        assert(s);
+static void inode_data_hash_func(const void *p, struct siphash *state) {
+        const struct inode_data *d = p;
 
-        if (!s->event)
-                return;
+        assert(p);
 
-        assert(s->event->n_sources > 0);
+        siphash24_compress(&d->dev, sizeof(d->dev), state);
+        siphash24_compress(&d->ino, sizeof(d->ino), state);
+}
 
-        switch (s->type) {
+static int inode_data_compare(const void *a, const void *b) {
+        const struct inode_data *x = a, *y = b;
 
-        case SOURCE_IO:
-                if (s->io.fd >= 0)
-                        source_io_unregister(s);
+        assert(x);
+        assert(y);
 
-                break;
+        if (x->dev < y->dev)
+                return -1;
+        if (x->dev > y->dev)
+                return 1;
 
-        case SOURCE_TIME_REALTIME:
-        case SOURCE_TIME_BOOTTIME:
-        case SOURCE_TIME_MONOTONIC:
-        case SOURCE_TIME_REALTIME_ALARM:
-        case SOURCE_TIME_BOOTTIME_ALARM: {
-                struct clock_data *d;
+        if (x->ino < y->ino)
+                return -1;
+        if (x->ino > y->ino)
+                return 1;
 
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
+        return 0;
+}
 
-                prioq_remove(d->earliest, s, &s->time.earliest_index);
-                prioq_remove(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
-                break;
-        }
+static const struct hash_ops inode_data_hash_ops = {
+        .hash = inode_data_hash_func,
+        .compare = inode_data_compare
+};
 
-        case SOURCE_SIGNAL:
-                if (s->signal.sig > 0) {
+static int event_make_inotify_data(
+                sd_event *e,
+                int64_t priority,
+                struct inotify_data **ret) {
 
-                        if (s->event->signal_sources)
-                                s->event->signal_sources[s->signal.sig] = NULL;
+        _cleanup_close_ int fd = -1;
+        struct inotify_data *d;
+        struct epoll_event ev = {};
+        int r;
 
-                        event_gc_signal_data(s->event, &s->priority, s->signal.sig);
-                }
+        assert(e);
 
-                break;
+        d = hashmap_get(e->inotify_data, &priority);
+        if (d) {
+                if (ret)
+                        *ret = d;
+                return 0;
+        }
 
-        case SOURCE_CHILD:
-                if (s->child.pid > 0) {
-                        if (s->enabled != SD_EVENT_OFF) {
-                                assert(s->event->n_enabled_child_sources > 0);
-                                s->event->n_enabled_child_sources--;
-                        }
+        fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        if (fd < 0)
+                return -errno;
 
-                        (void) hashmap_remove(s->event->child_sources, PID_TO_PTR(s->child.pid));
-                        event_gc_signal_data(s->event, &s->priority, SIGCHLD);
-                }
+        r = hashmap_ensure_allocated(&e->inotify_data, &uint64_hash_ops);
+        if (r < 0)
+                return r;
 
-                break;
+        d = new0(struct inotify_data, 1);
+        if (!d)
+                return -ENOMEM;
 
-        case SOURCE_DEFER:
-                /* nothing */
-                break;
+        d->wakeup = WAKEUP_INOTIFY_DATA;
+        d->fd = fd;
+        d->priority = priority;
 
-        case SOURCE_POST:
-                set_remove(s->event->post_sources, s);
-                break;
+        r = hashmap_put(e->inotify_data, &d->priority, d);
+        if (r < 0) {
+                free(d);
+                return r;
+        }
 
-        case SOURCE_EXIT:
-                prioq_remove(s->event->exit, s, &s->exit.prioq_index);
-                break;
+        ev.events = EPOLLIN;
+        ev.data.ptr = d;
 
-        default:
-                assert_not_reached("Wut? I shouldn't exist.");
+        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &ev) < 0) {
+                r = -errno;
+                hashmap_remove(e->inotify_data, &d->priority);
+                free(d);
+                return r;
         }
 
-        if (s->pending)
-                prioq_remove(s->event->pending, s, &s->pending_index);
+        fd = -1;
 
-        if (s->prepare)
-                prioq_remove(s->event->prepare, s, &s->prepare_index);
+        if (ret)
+                *ret = d;
 
-        event = s->event;
+        return 1;
+}
 
-        s->type = _SOURCE_EVENT_SOURCE_TYPE_INVALID;
-        s->event = NULL;
-        LIST_REMOVE(sources, event->sources, s);
-        event->n_sources--;
+static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
+        assert(e);
 
-        if (!s->floating)
-                sd_event_unref(event);
-}
+        if (!d)
+                return;
 
-static void source_free(sd_event_source *s) {
-        assert(s);
+        assert(hashmap_isempty(d->inodes));
+        assert(hashmap_isempty(d->wd));
 
-        source_disconnect(s);
-        free(s->description);
-        free(s);
-}
+        if (d->buffer_filled > 0)
+                LIST_REMOVE(buffered, e->inotify_data_buffered, d);
 
-static int source_set_pending(sd_event_source *s, bool b) {
-        int r;
+        hashmap_free(d->inodes);
+        hashmap_free(d->wd);
 
-        assert(s);
-        assert(s->type != SOURCE_EXIT);
+        assert_se(hashmap_remove(e->inotify_data, &d->priority) == d);
 
-        if (s->pending == b)
-                return 0;
+        if (d->fd >= 0) {
+                if (epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, d->fd, NULL) < 0)
+                        log_debug_errno(errno, "Failed to remove inotify fd from epoll, ignoring: %m");
 
-        s->pending = b;
+                safe_close(d->fd);
+        }
 
-        if (b) {
-                s->pending_iteration = s->event->iteration;
+        free(d);
+}
 
-                r = prioq_put(s->event->pending, s, &s->pending_index);
-                if (r < 0) {
-                        s->pending = false;
-                        return r;
-                }
-        } else
-                assert_se(prioq_remove(s->event->pending, s, &s->pending_index));
+static void event_gc_inotify_data(sd_event *e, struct inotify_data *d) {
+        assert(e);
 
-        if (EVENT_SOURCE_IS_TIME(s->type)) {
-                struct clock_data *d;
+        /* Release the inotify object once no inode is watched through it anymore */
 
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
+        if (!d)
+                return;
 
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
-        }
+        if (!hashmap_isempty(d->inodes))
+                return;
 
-        if (s->type == SOURCE_SIGNAL && !b) {
-                struct signal_data *d;
+        event_free_inotify_data(e, d);
+}
 
-                d = hashmap_get(s->event->signal_data, &s->priority);
+static int event_make_inode_data(
+                sd_event *e,
+                struct inotify_data *inotify_data,
+                dev_t dev,
+                ino_t ino,
+                struct inode_data **ret) {
+
+        struct inode_data *d, key;
+        int r;
+
+        assert(e);
+        assert(inotify_data);
+
+        key = (struct inode_data) {
+                .dev = dev,
+                .ino = ino,
+        };
+
+        d = hashmap_get(inotify_data->inodes, &key);
+        if (d) {
+                if (ret)
+                        *ret = d;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&inotify_data->inodes, &inode_data_hash_ops);
+        if (r < 0)
+                return r;
+
+        d = new0(struct inode_data, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->dev = dev;
+        d->ino = ino;
+        d->fd = -1;
+        d->wd = -1;
+        d->inotify_data = inotify_data;
+
+        r = hashmap_put(inotify_data->inodes, d, d);
+        if (r < 0) {
+                free(d);
+                return r;
+        }
+
+        if (ret)
+                *ret = d;
+
+        return 1;
+}
+
+static void event_free_inode_data(sd_event *e, struct inode_data *d) {
+        assert(e);
+
+        if (!d)
+                return;
+
+        assert(!d->event_sources);
+
+        if (d->fd >= 0) {
+                LIST_REMOVE(to_close, e->inode_data_to_close, d);
+                safe_close(d->fd);
+        }
+
+        if (d->wd >= 0) {
+                assert_se(hashmap_remove(d->inotify_data->wd, INT_TO_PTR(d->wd)) == d);
+
+                /* The watch might be gone already if the inode was removed, don't complain about that */
+                if (inotify_rm_watch(d->inotify_data->fd, d->wd) < 0 && errno != EINVAL)
+                        log_debug_errno(errno, "Failed to remove watch descriptor %i from inotify, ignoring: %m", d->wd);
+        }
+
+        assert_se(hashmap_remove(d->inotify_data->inodes, d) == d);
+        free(d);
+}
+
+static void event_gc_inode_data(sd_event *e, struct inode_data *d) {
+        struct inotify_data *inotify_data;
+
+        assert(e);
+
+        if (!d)
+                return;
+
+        if (d->event_sources)
+                return;
+
+        inotify_data = d->inotify_data;
+        event_free_inode_data(e, d);
+
+        event_gc_inotify_data(e, inotify_data);
+}
+
+static uint32_t inode_data_determine_mask(struct inode_data *d) {
+        bool excl_unlink = true;
+        uint32_t combined = 0;
+        sd_event_source *s;
+
+        assert(d);
+
+        /* The watch masks of all event sources watching this inode are ORed together, except for
+         * IN_EXCL_UNLINK, which only applies if all of them ask for it. */
+
+        LIST_FOREACH(inotify.by_inode_data, s, d->event_sources) {
+                if (!(s->inotify.mask & IN_EXCL_UNLINK))
+                        excl_unlink = false;
+
+                combined |= s->inotify.mask;
+        }
+
+        return (combined & ~(IN_DONT_FOLLOW|IN_ONLYDIR|IN_EXCL_UNLINK)) | (excl_unlink ? IN_EXCL_UNLINK : 0);
+}
+
+static int inode_data_realize_watch(sd_event *e, struct inode_data *d) {
+        uint32_t combined;
+        int wd, r;
+
+        assert(e);
+        assert(d);
+        assert(d->fd >= 0);
+
+        combined = inode_data_determine_mask(d);
+
+        if (d->wd >= 0 && combined == d->combined_mask)
+                return 0;
+
+        r = hashmap_ensure_allocated(&d->inotify_data->wd, NULL);
+        if (r < 0)
+                return r;
+
+        wd = inotify_add_watch_fd(d->inotify_data->fd, d->fd, combined);
+        if (wd < 0)
+                return wd;
+
+        if (d->wd != wd) {
+                r = hashmap_put(d->inotify_data->wd, INT_TO_PTR(wd), d);
+                if (r < 0) {
+                        (void) inotify_rm_watch(d->inotify_data->fd, wd);
+                        return r;
+                }
+
+                if (d->wd >= 0)
+                        assert_se(hashmap_remove(d->inotify_data->wd, INT_TO_PTR(d->wd)) == d);
+
+                d->wd = wd;
+        }
+
+        d->combined_mask = combined;
+        return 1;
+}
+
+static void event_close_inode_data_fds(sd_event *e) {
+        struct inode_data *d;
+
+        assert(e);
+
+        /* Close the fds pinning the inodes we watch, see the comment in struct inode_data */
+
+        while ((d = e->inode_data_to_close)) {
+                assert(d->fd >= 0);
+                d->fd = safe_close(d->fd);
+
+                LIST_REMOVE(to_close, e->inode_data_to_close, d);
+        }
+}
+
+static void source_disconnect(sd_event_source *s) {
+        sd_event *event;
+
+        assert(s);
+
+        if (!s->event)
+                return;
+
+        assert(s->event->n_sources > 0);
+
+        switch (s->type) {
+
+        case SOURCE_IO:
+                if (s->io.fd >= 0)
+                        source_io_unregister(s);
+
+                if (s->event->wakeup_source == s)
+                        s->event->wakeup_source = NULL;
+
+                break;
+
+        case SOURCE_TIME_REALTIME:
+        case SOURCE_TIME_BOOTTIME:
+        case SOURCE_TIME_MONOTONIC:
+        case SOURCE_TIME_REALTIME_ALARM:
+        case SOURCE_TIME_BOOTTIME_ALARM: {
+                struct clock_data *d;
+
+                d = event_get_clock_data(s->event, s->type);
+                assert(d);
+
+                if (s->time.in_wheel)
+                        timer_wheel_unlink(d, s);
+                else {
+                        prioq_remove(d->earliest, s, &s->time.earliest_index);
+                        prioq_remove(d->latest, s, &s->time.latest_index);
+                }
+                d->needs_rearm = true;
+                break;
+        }
+
+        case SOURCE_SIGNAL:
+                if (s->signal.sig > 0) {
+
+                        if (s->event->signal_sources)
+                                s->event->signal_sources[s->signal.sig] = NULL;
+
+                        event_gc_signal_data(s->event, &s->priority, s->signal.sig);
+                }
+
+                break;
+
+        case SOURCE_CHILD:
+                if (s->child.pid > 0) {
+                        if (s->enabled != SD_EVENT_OFF) {
+                                assert(s->event->n_enabled_child_sources > 0);
+                                s->event->n_enabled_child_sources--;
+                        }
+
+                        (void) hashmap_remove(s->event->child_sources, PID_TO_PTR(s->child.pid));
+                        event_gc_signal_data(s->event, &s->priority, SIGCHLD);
+                }
+
+                source_child_pidfd_unregister(s);
+                s->child.pidfd = safe_close(s->child.pidfd);
+
+                break;
+
+        case SOURCE_DEFER:
+                /* nothing */
+                break;
+
+        case SOURCE_POST:
+                set_remove(s->event->post_sources, s);
+                break;
+
+        case SOURCE_EXIT:
+                prioq_remove(s->event->exit, s, &s->exit.prioq_index);
+                break;
+
+        case SOURCE_INOTIFY: {
+                struct inode_data *inode_data;
+
+                inode_data = s->inotify.inode_data;
+                if (inode_data) {
+                        if (s->pending) {
+                                assert(inode_data->inotify_data->n_pending > 0);
+                                inode_data->inotify_data->n_pending--;
+                        }
+
+                        LIST_REMOVE(inotify.by_inode_data, inode_data->event_sources, s);
+                        s->inotify.inode_data = NULL;
+
+                        /* Note that the mask of the watch descriptor isn't reduced if other sources keep
+                         * watching the inode, as that requires access to the inode, which we might not have
+                         * anymore. Events nobody is interested in anymore are dropped after reception. */
+                        event_gc_inode_data(s->event, inode_data);
+                }
+
+                break;
+        }
+
+        default:
+                assert_not_reached("Wut? I shouldn't exist.");
+        }
+
+        if (s->pending)
+                prioq_remove(s->event->pending, s, &s->pending_index);
+
+        if (s->prepare)
+                prioq_remove(s->event->prepare, s, &s->prepare_index);
+
+        s->ratelimit_timer = sd_event_source_unref(s->ratelimit_timer);
+
+        event = s->event;
+
+        s->type = _SOURCE_EVENT_SOURCE_TYPE_INVALID;
+        s->event = NULL;
+        LIST_REMOVE(sources, event->sources, s);
+        event->n_sources--;
+
+        if (!s->floating)
+                sd_event_unref(event);
+}
+
+static void source_free(sd_event_source *s) {
+        assert(s);
+
+        source_disconnect(s);
+        free(s->description);
+
+        if (s->from_pool)
+                mempool_free_tile(&event_source_pool, s);
+        else
+                free(s);
+}
+
+static int source_set_pending(sd_event_source *s, bool b) {
+        int r;
+
+        assert(s);
+        assert(s->type != SOURCE_EXIT);
+
+        if (s->pending == b)
+                return 0;
+
+        s->pending = b;
+
+        if (b) {
+                s->pending_iteration = s->event->iteration;
+
+                r = prioq_put(s->event->pending, s, &s->pending_index);
+                if (r < 0) {
+                        s->pending = false;
+                        return r;
+                }
+        } else
+                assert_se(prioq_remove(s->event->pending, s, &s->pending_index));
+
+        if (s->type == SOURCE_INOTIFY) {
+                assert(s->inotify.inode_data);
+                assert(s->inotify.inode_data->inotify_data);
+
+                if (b)
+                        s->inotify.inode_data->inotify_data->n_pending++;
+                else {
+                        assert(s->inotify.inode_data->inotify_data->n_pending > 0);
+                        s->inotify.inode_data->inotify_data->n_pending--;
+                }
+        }
+
+        if (EVENT_SOURCE_IS_TIME(s->type)) {
+                struct clock_data *d;
+
+                d = event_get_clock_data(s->event, s->type);
+                assert(d);
+
+                if (!s->time.in_wheel) {
+                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
+                } else if (b)
+                        timer_wheel_unlink(d, s);
+                else if (s->enabled != SD_EVENT_OFF)
+                        timer_wheel_link(s->event, d, s);
+                d->needs_rearm = true;
+        }
+
+        if (s->type == SOURCE_SIGNAL && !b) {
+                struct signal_data *d;
+
+                d = hashmap_get(s->event->signal_data, &s->priority);
                 if (d && d->current == s)
                         d->current = NULL;
         }
@@ -932,13 +1578,19 @@ static int source_set_pending(sd_event_source *s, bool b) {
 
 static sd_event_source *source_new(sd_event *e, bool floating, EventSourceType type) {
         sd_event_source *s;
+        bool use_pool;
 
         assert(e);
 
-        s = new0(sd_event_source, 1);
+        /* Like hashmaps, the sources of loops running in the main thread come from a pool, which isn't
+         * thread-safe */
+        use_pool = is_main_thread();
+
+        s = use_pool ? mempool_alloc0_tile(&event_source_pool) : new0(sd_event_source, 1);
         if (!s)
                 return NULL;
 
+        s->from_pool = use_pool;
         s->n_ref = 1;
         s->event = e;
         s->floating = floating;
@@ -1045,6 +1697,55 @@ static int event_setup_timer_fd(
         return 0;
 }
 
+static bool timer_wheel_fits(
+                sd_event *e,
+                struct clock_data *d,
+                clockid_t clock,
+                usec_t next,
+                usec_t accuracy) {
+
+        uint64_t k;
+
+        /* Checks whether a time source with the specified parameters shall be kept in the timer wheel of
+         * the clock, and allocates the wheel if needed. If that fails we simply use the prioqs instead. */
+
+        /* The cursor only ever moves forward, and is compared with the absolute times of the sources. When
+         * the realtime clock is set backwards, new sources would end up before the cursor and be dispatched
+         * right-away, hence only use the wheel for the clocks that never jump. */
+        if (!IN_SET(clock, CLOCK_MONOTONIC, CLOCK_BOOTTIME, CLOCK_BOOTTIME_ALARM))
+                return false;
+
+        if (next == USEC_INFINITY)
+                return false;
+        if (accuracy < TIMER_WHEEL_SLOT_USEC || accuracy >= 2 * TIMER_WHEEL_SLOT_USEC)
+                return false;
+
+        /* The slot boundaries are derived from the perturbation, hence it must not change anymore */
+        initialize_perturb(e);
+        if (e->perturb == USEC_INFINITY)
+                return false;
+
+        if (!d->wheel) {
+                d->wheel = new0(struct timer_wheel, 1);
+                if (!d->wheel)
+                        return false;
+        }
+
+        /* When nothing is linked into the wheel we may move the cursor up to the current time, so that
+         * the whole range of slots is available again. */
+        if (d->wheel->n_linked == 0) {
+                usec_t n;
+
+                if (sd_event_now(e, clock, &n) >= 0 && timer_wheel_slot_of(e, n, &k))
+                        d->wheel->cursor = MAX(d->wheel->cursor, k);
+        }
+
+        if (!timer_wheel_slot_of(e, usec_add(next, accuracy), &k))
+                return true;
+
+        return k < d->wheel->cursor || k - d->wheel->cursor < TIMER_WHEEL_SLOTS;
+}
+
 static int time_exit_callback(sd_event_source *s, uint64_t usec, void *userdata) {
         assert(s);
 
@@ -1105,18 +1806,24 @@ _public_ int sd_event_add_time(
         s->time.accuracy = accuracy == 0 ? DEFAULT_ACCURACY_USEC : accuracy;
         s->time.callback = callback;
         s->time.earliest_index = s->time.latest_index = PRIOQ_IDX_NULL;
+        s->time.wheel_slot = TIMER_WHEEL_UNLINKED;
         s->userdata = userdata;
         s->enabled = SD_EVENT_ONESHOT;
 
         d->needs_rearm = true;
 
-        r = prioq_put(d->earliest, s, &s->time.earliest_index);
-        if (r < 0)
-                goto fail;
+        if (timer_wheel_fits(e, d, clock, s->time.next, s->time.accuracy)) {
+                s->time.in_wheel = true;
+                timer_wheel_link(e, d, s);
+        } else {
+                r = prioq_put(d->earliest, s, &s->time.earliest_index);
+                if (r < 0)
+                        goto fail;
 
-        r = prioq_put(d->latest, s, &s->time.latest_index);
-        if (r < 0)
-                goto fail;
+                r = prioq_put(d->latest, s, &s->time.latest_index);
+                if (r < 0)
+                        goto fail;
+        }
 
         if (ret)
                 *ret = s;
@@ -1206,51 +1913,143 @@ _public_ int sd_event_add_child(
         int r;
 
         assert_return(e, -EINVAL);
-        assert_return(pid > 1, -EINVAL);
-        assert_return(!(options & ~(WEXITED|WSTOPPED|WCONTINUED)), -EINVAL);
-        assert_return(options != 0, -EINVAL);
+        assert_return(pid > 1, -EINVAL);
+        assert_return(!(options & ~(WEXITED|WSTOPPED|WCONTINUED)), -EINVAL);
+        assert_return(options != 0, -EINVAL);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        r = hashmap_ensure_allocated(&e->child_sources, NULL);
+        if (r < 0)
+                return r;
+
+        if (hashmap_contains(e->child_sources, PID_TO_PTR(pid)))
+                return -EBUSY;
+
+        s = source_new(e, !ret, SOURCE_CHILD);
+        if (!s)
+                return -ENOMEM;
+
+        s->wakeup = WAKEUP_EVENT_SOURCE;
+        s->child.pid = pid;
+        s->child.options = options;
+        s->child.callback = callback;
+        s->child.pidfd = -1;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ONESHOT;
+
+        r = hashmap_put(e->child_sources, PID_TO_PTR(pid), s);
+        if (r < 0) {
+                source_free(s);
+                return r;
+        }
+
+        e->n_enabled_child_sources++;
+
+        r = event_make_signal_data(e, SIGCHLD, NULL);
+        if (r < 0) {
+                e->n_enabled_child_sources--;
+                source_free(s);
+                return r;
+        }
+
+        /* If the kernel supports it, watch the child through a pidfd, so that its exit wakes us up for this
+         * child alone. Otherwise, and for stop/continue notifications which pidfds don't report, we have to
+         * ask the kernel about each watched child on every SIGCHLD. */
+        if (options == WEXITED) {
+                s->child.pidfd = missing_pidfd_open(pid, 0);
+                if (s->child.pidfd >= 0 && source_child_pidfd_register(s) < 0)
+                        s->child.pidfd = safe_close(s->child.pidfd);
+        }
+
+        e->need_process_child = true;
+
+        if (ret)
+                *ret = s;
+
+        return 0;
+}
+
+_public_ int sd_event_add_inotify(
+                sd_event *e,
+                sd_event_source **ret,
+                const char *path,
+                uint32_t mask,
+                sd_event_inotify_handler_t callback,
+                void *userdata) {
+
+        struct inotify_data *inotify_data = NULL;
+        struct inode_data *inode_data = NULL;
+        _cleanup_close_ int fd = -1;
+        sd_event_source *s;
+        struct stat st;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(path, -EINVAL);
         assert_return(callback, -EINVAL);
         assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
         assert_return(!event_pid_changed(e), -ECHILD);
 
-        r = hashmap_ensure_allocated(&e->child_sources, NULL);
-        if (r < 0)
-                return r;
+        /* Refuse IN_MASK_ADD since we manage the masks ourselves, and IN_ONESHOT since that's what
+         * SD_EVENT_ONESHOT is for */
+        if (mask & (IN_MASK_ADD|IN_ONESHOT))
+                return -EINVAL;
 
-        if (hashmap_contains(e->child_sources, PID_TO_PTR(pid)))
-                return -EBUSY;
+        fd = open(path, O_PATH|O_CLOEXEC|
+                  (mask & IN_ONLYDIR ? O_DIRECTORY : 0)|
+                  (mask & IN_DONT_FOLLOW ? O_NOFOLLOW : 0));
+        if (fd < 0)
+                return -errno;
 
-        s = source_new(e, !ret, SOURCE_CHILD);
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        s = source_new(e, !ret, SOURCE_INOTIFY);
         if (!s)
                 return -ENOMEM;
 
-        s->child.pid = pid;
-        s->child.options = options;
-        s->child.callback = callback;
+        s->enabled = SD_EVENT_ON;
         s->userdata = userdata;
-        s->enabled = SD_EVENT_ONESHOT;
+        s->inotify.mask = mask;
+        s->inotify.callback = callback;
 
-        r = hashmap_put(e->child_sources, PID_TO_PTR(pid), s);
+        /* Allocate an inotify object for this priority, and an inode object within it */
+        r = event_make_inotify_data(e, s->priority, &inotify_data);
+        if (r < 0)
+                goto fail;
+
+        r = event_make_inode_data(e, inotify_data, st.st_dev, st.st_ino, &inode_data);
         if (r < 0) {
-                source_free(s);
-                return r;
+                event_gc_inotify_data(e, inotify_data);
+                goto fail;
         }
 
-        e->n_enabled_child_sources++;
-
-        r = event_make_signal_data(e, SIGCHLD, NULL);
-        if (r < 0) {
-                e->n_enabled_child_sources--;
-                source_free(s);
-                return r;
+        /* Keep the O_PATH fd around until the next event loop iteration, so that the priority may still be
+         * changed until then */
+        if (inode_data->fd < 0) {
+                inode_data->fd = fd;
+                fd = -1;
+                LIST_PREPEND(to_close, e->inode_data_to_close, inode_data);
         }
 
-        e->need_process_child = true;
+        LIST_PREPEND(inotify.by_inode_data, inode_data->event_sources, s);
+        s->inotify.inode_data = inode_data;
+
+        /* Update the watch descriptor to the combined mask of all sources on this inode */
+        r = inode_data_realize_watch(e, inode_data);
+        if (r < 0)
+                goto fail;
 
         if (ret)
                 *ret = s;
 
         return 0;
+
+fail:
+        source_free(s);
+        return r;
 }
 
 _public_ int sd_event_add_defer(
@@ -1364,6 +2163,126 @@ _public_ int sd_event_add_exit(
         return 0;
 }
 
+static int wakeup_dispatch(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        sd_event *e = userdata;
+        EventHandoff *h, *queue = NULL;
+        uint64_t x;
+
+        assert(s);
+        assert(e);
+
+        /* Clear the counter first, so that a callback posted after we took the list below wakes us up
+         * again */
+        if (read(fd, &x, sizeof(x)) < 0 && errno != EAGAIN)
+                return log_debug_errno(errno, "Failed to read wakeup eventfd: %m");
+
+        h = __atomic_exchange_n(&e->handoff, NULL, __ATOMIC_ACQUIRE);
+
+        /* The list is pushed to at the front, reverse it to dispatch in the order callbacks were posted */
+        while (h) {
+                EventHandoff *next = h->next;
+
+                h->next = queue;
+                queue = h;
+                h = next;
+        }
+
+        while ((h = queue)) {
+                int r;
+
+                queue = h->next;
+
+                r = h->callback(s, h->userdata);
+                if (r < 0)
+                        log_debug_errno(r, "Callback posted from another thread failed, ignoring: %m");
+
+                free(h);
+        }
+
+        return 0;
+}
+
+_public_ int sd_event_add_wakeup(sd_event *e, sd_event_source **ret) {
+        sd_event_source *s;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        if (e->wakeup_source)
+                return -EBUSY;
+
+        /* The eventfd stays around for the lifetime of the event loop, so that other threads never see it
+         * change under their feet, even if the event source is dropped and added again. */
+        if (e->wakeup_fd < 0) {
+                e->wakeup_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+                if (e->wakeup_fd < 0)
+                        return -errno;
+        }
+
+        s = source_new(e, !ret, SOURCE_IO);
+        if (!s)
+                return -ENOMEM;
+
+        s->wakeup = WAKEUP_EVENT_SOURCE;
+        s->io.fd = e->wakeup_fd;
+        s->io.events = EPOLLIN;
+        s->io.callback = wakeup_dispatch;
+        s->userdata = e;
+        s->enabled = SD_EVENT_ON;
+
+        /* If callbacks were posted while no source was around, the counter is still set and we'll be
+         * woken up right away */
+        r = source_io_register(s, s->enabled, s->io.events);
+        if (r < 0) {
+                source_free(s);
+                return r;
+        }
+
+        (void) sd_event_source_set_description(s, "wakeup");
+        e->wakeup_source = s;
+
+        if (ret)
+                *ret = s;
+
+        return 0;
+}
+
+_public_ int sd_event_post_to(sd_event *e, sd_event_handler_t callback, void *userdata) {
+        EventHandoff *h;
+
+        /* This may be called from any thread, hence only touches the handoff list and the eventfd. The
+         * caller has to make sure the event loop is not freed concurrently. */
+
+        assert_return(e, -EINVAL);
+        assert_return(callback, -EINVAL);
+
+        if (e->wakeup_fd < 0)
+                return -ENXIO;
+
+        h = new(EventHandoff, 1);
+        if (!h)
+                return -ENOMEM;
+
+        h->callback = callback;
+        h->userdata = userdata;
+        h->next = __atomic_load_n(&e->handoff, __ATOMIC_RELAXED);
+
+        while (!__atomic_compare_exchange_n(&e->handoff, &h->next, h, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                ;
+
+        /* If the list was non-empty, somebody else posted before the loop got to drain it, and the loop
+         * is already woken up. */
+        if (h->next)
+                return 0;
+
+        if (eventfd_write(e->wakeup_fd, 1) < 0 && errno != EAGAIN)
+                return -errno;
+
+        return 0;
+}
+
 _public_ sd_event_source* sd_event_source_ref(sd_event_source *s) {
 
         if (!s)
@@ -1455,7 +2374,7 @@ _public_ int sd_event_source_set_io_fd(sd_event_source *s, int fd) {
         if (s->io.fd == fd)
                 return 0;
 
-        if (s->enabled == SD_EVENT_OFF) {
+        if (s->enabled == SD_EVENT_OFF || s->ratelimited) {
                 s->io.fd = fd;
                 s->io.registered = false;
         } else {
@@ -1503,7 +2422,7 @@ _public_ int sd_event_source_set_io_events(sd_event_source *s, uint32_t events)
         if (s->io.events == events && !(events & EPOLLET))
                 return 0;
 
-        if (s->enabled != SD_EVENT_OFF) {
+        if (s->enabled != SD_EVENT_OFF && !s->ratelimited) {
                 r = source_io_register(s, s->enabled, events);
                 if (r < 0)
                         return r;
@@ -1542,6 +2461,70 @@ _public_ int sd_event_source_get_priority(sd_event_source *s, int64_t *priority)
         return 0;
 }
 
+static int source_inotify_move(sd_event_source *s, int64_t priority) {
+        struct inode_data *old_inode_data, *new_inode_data = NULL;
+        struct inotify_data *new_inotify_data = NULL;
+        int r;
+
+        assert(s);
+        assert(s->type == SOURCE_INOTIFY);
+
+        /* Move us to the inotify fd belonging to the new priority. That requires the original inode,
+         * which we only have until the next event loop iteration. While an event is pending for us,
+         * it refers to the old inotify fd, hence refuse that too. */
+
+        old_inode_data = s->inotify.inode_data;
+        assert(old_inode_data);
+
+        if (old_inode_data->fd < 0)
+                return -EOPNOTSUPP;
+        if (s->pending)
+                return -EBUSY;
+
+        r = event_make_inotify_data(s->event, priority, &new_inotify_data);
+        if (r < 0)
+                return r;
+
+        r = event_make_inode_data(s->event, new_inotify_data, old_inode_data->dev, old_inode_data->ino, &new_inode_data);
+        if (r < 0)
+                goto fail;
+
+        if (new_inode_data->fd < 0) {
+                new_inode_data->fd = fcntl(old_inode_data->fd, F_DUPFD_CLOEXEC, 3);
+                if (new_inode_data->fd < 0) {
+                        r = -errno;
+                        goto fail;
+                }
+
+                LIST_PREPEND(to_close, s->event->inode_data_to_close, new_inode_data);
+        }
+
+        LIST_REMOVE(inotify.by_inode_data, old_inode_data->event_sources, s);
+        LIST_PREPEND(inotify.by_inode_data, new_inode_data->event_sources, s);
+        s->inotify.inode_data = new_inode_data;
+
+        r = inode_data_realize_watch(s->event, new_inode_data);
+        if (r < 0) {
+                LIST_REMOVE(inotify.by_inode_data, new_inode_data->event_sources, s);
+                LIST_PREPEND(inotify.by_inode_data, old_inode_data->event_sources, s);
+                s->inotify.inode_data = old_inode_data;
+                goto fail;
+        }
+
+        s->priority = priority;
+
+        event_gc_inode_data(s->event, old_inode_data);
+        return 0;
+
+fail:
+        if (new_inode_data)
+                event_gc_inode_data(s->event, new_inode_data);
+        else
+                event_gc_inotify_data(s->event, new_inotify_data);
+
+        return r;
+}
+
 _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority) {
         int r;
 
@@ -1569,6 +2552,11 @@ _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority)
                 }
 
                 event_unmask_signal_data(s->event, old, s->signal.sig);
+
+        } else if (s->type == SOURCE_INOTIFY) {
+                r = source_inotify_move(s, priority);
+                if (r < 0)
+                        return r;
         } else
                 s->priority = priority;
 
@@ -1628,8 +2616,12 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                         d = event_get_clock_data(s->event, s->type);
                         assert(d);
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
+                        if (s->time.in_wheel)
+                                timer_wheel_unlink(d, s);
+                        else {
+                                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+                                prioq_reshuffle(d->latest, s, &s->time.latest_index);
+                        }
                         d->needs_rearm = true;
                         break;
                 }
@@ -1646,6 +2638,8 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                         assert(s->event->n_enabled_child_sources > 0);
                         s->event->n_enabled_child_sources--;
 
+                        source_child_pidfd_unregister(s);
+
                         event_gc_signal_data(s->event, &s->priority, SIGCHLD);
                         break;
 
@@ -1659,6 +2653,16 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                         s->enabled = m;
                         break;
 
+                case SOURCE_INOTIFY:
+                        s->enabled = m;
+
+                        /* Don't hold up later events for the other sources on the same inotify fd */
+                        r = source_set_pending(s, false);
+                        if (r < 0)
+                                return r;
+
+                        break;
+
                 default:
                         assert_not_reached("Wut? I shouldn't exist.");
                 }
@@ -1667,9 +2671,12 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 switch (s->type) {
 
                 case SOURCE_IO:
-                        r = source_io_register(s, m, s->io.events);
-                        if (r < 0)
-                                return r;
+                        /* A paused source is registered again when its rate limit interval ends */
+                        if (!s->ratelimited) {
+                                r = source_io_register(s, m, s->io.events);
+                                if (r < 0)
+                                        return r;
+                        }
 
                         s->enabled = m;
                         break;
@@ -1681,70 +2688,210 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_TIME_BOOTTIME_ALARM: {
                         struct clock_data *d;
 
-                        s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
+                        s->enabled = m;
+                        d = event_get_clock_data(s->event, s->type);
+                        assert(d);
+
+                        if (!s->time.in_wheel) {
+                                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+                                prioq_reshuffle(d->latest, s, &s->time.latest_index);
+                        } else if (!s->pending && s->time.wheel_slot == TIMER_WHEEL_UNLINKED)
+                                timer_wheel_link(s->event, d, s);
+                        d->needs_rearm = true;
+                        break;
+                }
+
+                case SOURCE_SIGNAL:
+
+                        s->enabled = m;
+
+                        r = event_make_signal_data(s->event, s->signal.sig, NULL);
+                        if (r < 0) {
+                                s->enabled = SD_EVENT_OFF;
+                                event_gc_signal_data(s->event, &s->priority, s->signal.sig);
+                                return r;
+                        }
+
+                        break;
+
+                case SOURCE_CHILD:
+
+                        if (s->enabled == SD_EVENT_OFF)
+                                s->event->n_enabled_child_sources++;
+
+                        s->enabled = m;
+
+                        r = event_make_signal_data(s->event, SIGCHLD, NULL);
+                        if (r < 0) {
+                                s->enabled = SD_EVENT_OFF;
+                                s->event->n_enabled_child_sources--;
+                                event_gc_signal_data(s->event, &s->priority, SIGCHLD);
+                                return r;
+                        }
+
+                        /* If we can't watch the pidfd anymore, fall back to checking on SIGCHLD */
+                        if (source_child_pidfd_register(s) < 0) {
+                                s->child.pidfd = safe_close(s->child.pidfd);
+                                s->event->need_process_child = true;
+                        }
+
+                        break;
+
+                case SOURCE_EXIT:
+                        s->enabled = m;
+                        prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
+                        break;
+
+                case SOURCE_DEFER:
+                case SOURCE_POST:
+                case SOURCE_INOTIFY:
+                        s->enabled = m;
+                        break;
+
+                default:
+                        assert_not_reached("Wut? I shouldn't exist.");
+                }
+        }
+
+        if (s->pending)
+                prioq_reshuffle(s->event->pending, s, &s->pending_index);
+
+        if (s->prepare)
+                prioq_reshuffle(s->event->prepare, s, &s->prepare_index);
+
+        return 0;
+}
+
+static int source_leave_ratelimited(sd_event_source *s) {
+        int r;
+
+        assert(s);
+
+        if (!s->ratelimited)
+                return 0;
+
+        s->ratelimited = false;
+        RATELIMIT_RESET(s->rate_limit);
+
+        if (s->ratelimit_timer)
+                (void) sd_event_source_set_enabled(s->ratelimit_timer, SD_EVENT_OFF);
+
+        /* Defer sources are pending for as long as they exist, whether they are enabled or not */
+        if (s->type == SOURCE_DEFER)
+                return source_set_pending(s, true);
+
+        if (s->type == SOURCE_IO && s->enabled != SD_EVENT_OFF) {
+                r = source_io_register(s, s->enabled, s->io.events);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to resume event source %s (type %s) after rate limit, disabling: %m",
+                                        strna(s->description), event_source_type_to_string(s->type));
+                        s->enabled = SD_EVENT_OFF;
+                        return r;
+                }
+        }
+
+        return 0;
+}
+
+static int ratelimit_timer_handler(sd_event_source *t, uint64_t usec, void *userdata) {
+        sd_event_source *s = userdata;
+
+        assert(s);
+
+        (void) source_leave_ratelimited(s);
+        return 0;
+}
+
+static int source_enter_ratelimited(sd_event_source *s) {
+        char t[FORMAT_TIMESPAN_MAX];
+        usec_t until;
+        int r;
+
+        assert(s);
+        assert(s->event);
+        assert(!s->ratelimited);
+
+        until = usec_add(s->rate_limit.begin, s->rate_limit.interval);
+
+        if (s->ratelimit_timer) {
+                r = sd_event_source_set_time(s->ratelimit_timer, until);
+                if (r < 0)
+                        return r;
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
-                        break;
-                }
+                r = sd_event_source_set_enabled(s->ratelimit_timer, SD_EVENT_ONESHOT);
+                if (r < 0)
+                        return r;
+        } else {
+                r = sd_event_add_time(s->event, &s->ratelimit_timer, CLOCK_MONOTONIC, until, 1,
+                                      ratelimit_timer_handler, s);
+                if (r < 0)
+                        return r;
 
-                case SOURCE_SIGNAL:
+                /* The timer belongs to the source, and must not keep the event loop alive by itself */
+                s->ratelimit_timer->floating = true;
+                sd_event_unref(s->event);
 
-                        s->enabled = m;
+                (void) sd_event_source_set_description(s->ratelimit_timer, "ratelimit");
+        }
 
-                        r = event_make_signal_data(s->event, s->signal.sig, NULL);
-                        if (r < 0) {
-                                s->enabled = SD_EVENT_OFF;
-                                event_gc_signal_data(s->event, &s->priority, s->signal.sig);
-                                return r;
-                        }
+        if (s->type == SOURCE_IO)
+                source_io_unregister(s);
 
-                        break;
+        r = source_set_pending(s, false);
+        if (r < 0)
+                return r;
 
-                case SOURCE_CHILD:
+        s->ratelimited = true;
 
-                        if (s->enabled == SD_EVENT_OFF)
-                                s->event->n_enabled_child_sources++;
+        log_debug("Event source %s (type %s) exceeded its rate limit of %u dispatches per %s, pausing it.",
+                  strna(s->description), event_source_type_to_string(s->type),
+                  s->rate_limit.burst, format_timespan(t, sizeof(t), s->rate_limit.interval, 0));
 
-                        s->enabled = m;
+        return 0;
+}
 
-                        r = event_make_signal_data(s->event, SIGCHLD, NULL);
-                        if (r < 0) {
-                                s->enabled = SD_EVENT_OFF;
-                                s->event->n_enabled_child_sources--;
-                                event_gc_signal_data(s->event, &s->priority, SIGCHLD);
-                                return r;
-                        }
+_public_ int sd_event_source_set_ratelimit(sd_event_source *s, uint64_t interval, unsigned burst) {
+        int r;
 
-                        break;
+        assert_return(s, -EINVAL);
+        assert_return(IN_SET(s->type, SOURCE_IO, SOURCE_DEFER, SOURCE_POST), -EDOM);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
 
-                case SOURCE_EXIT:
-                        s->enabled = m;
-                        prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
-                        break;
+        /* A zero interval or burst turns rate limiting off. Either way, start with a fresh interval. */
+        r = source_leave_ratelimited(s);
+        if (r < 0)
+                return r;
 
-                case SOURCE_DEFER:
-                case SOURCE_POST:
-                        s->enabled = m;
-                        break;
+        if (interval == 0 || burst == 0)
+                RATELIMIT_INIT(s->rate_limit, 0, 0);
+        else
+                RATELIMIT_INIT(s->rate_limit, interval, burst);
 
-                default:
-                        assert_not_reached("Wut? I shouldn't exist.");
-                }
-        }
+        return 0;
+}
 
-        if (s->pending)
-                prioq_reshuffle(s->event->pending, s, &s->pending_index);
+_public_ int sd_event_source_get_ratelimit(sd_event_source *s, uint64_t *ret_interval, unsigned *ret_burst) {
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
 
-        if (s->prepare)
-                prioq_reshuffle(s->event->prepare, s, &s->prepare_index);
+        if (s->rate_limit.interval == 0)
+                return -ENOEXEC;
+
+        if (ret_interval)
+                *ret_interval = s->rate_limit.interval;
+        if (ret_burst)
+                *ret_burst = s->rate_limit.burst;
 
         return 0;
 }
 
+_public_ int sd_event_source_is_ratelimited(sd_event_source *s) {
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        return s->ratelimited;
+}
+
 _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
         assert_return(s, -EINVAL);
         assert_return(usec, -EINVAL);
@@ -1755,26 +2902,70 @@ _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
         return 0;
 }
 
-_public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
+static int source_time_update(sd_event_source *s, usec_t next, usec_t accuracy) {
         struct clock_data *d;
+        bool wheel;
+        int r;
 
-        assert_return(s, -EINVAL);
-        assert_return(EVENT_SOURCE_IS_TIME(s->type), -EDOM);
-        assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
-        assert_return(!event_pid_changed(s->event), -ECHILD);
-
-        s->time.next = usec;
-
-        source_set_pending(s, false);
+        assert(s);
+        assert(EVENT_SOURCE_IS_TIME(s->type));
 
         d = event_get_clock_data(s->event, s->type);
         assert(d);
 
-        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
+        wheel = timer_wheel_fits(s->event, d, event_source_type_to_clock(s->type), next, accuracy);
+
+        if (s->time.in_wheel) {
+                timer_wheel_unlink(d, s);
+
+                if (!wheel) {
+                        /* Moving the source back into the prioqs needs memory, hence do so before
+                         * changing anything, so that we can fail cleanly */
+                        r = prioq_put(d->earliest, s, &s->time.earliest_index);
+                        if (r < 0)
+                                goto fail;
+
+                        r = prioq_put(d->latest, s, &s->time.latest_index);
+                        if (r < 0) {
+                                prioq_remove(d->earliest, s, &s->time.earliest_index);
+                                goto fail;
+                        }
+
+                        s->time.in_wheel = false;
+                }
+        } else if (wheel) {
+                prioq_remove(d->earliest, s, &s->time.earliest_index);
+                prioq_remove(d->latest, s, &s->time.latest_index);
+                s->time.in_wheel = true;
+        }
+
+        s->time.next = next;
+        s->time.accuracy = accuracy;
+
+        source_set_pending(s, false);
+
+        if (!s->time.in_wheel) {
+                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+                prioq_reshuffle(d->latest, s, &s->time.latest_index);
+        } else if (s->enabled != SD_EVENT_OFF && s->time.wheel_slot == TIMER_WHEEL_UNLINKED)
+                timer_wheel_link(s->event, d, s);
         d->needs_rearm = true;
 
         return 0;
+
+fail:
+        if (s->enabled != SD_EVENT_OFF && !s->pending)
+                timer_wheel_link(s->event, d, s);
+        return r;
+}
+
+_public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
+        assert_return(s, -EINVAL);
+        assert_return(EVENT_SOURCE_IS_TIME(s->type), -EDOM);
+        assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        return source_time_update(s, usec, s->time.accuracy);
 }
 
 _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *usec) {
@@ -1788,8 +2979,6 @@ _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *use
 }
 
 _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
-
         assert_return(s, -EINVAL);
         assert_return(usec != (uint64_t) -1, -EINVAL);
         assert_return(EVENT_SOURCE_IS_TIME(s->type), -EDOM);
@@ -1799,17 +2988,7 @@ _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec
         if (usec == 0)
                 usec = DEFAULT_ACCURACY_USEC;
 
-        s->time.accuracy = usec;
-
-        source_set_pending(s, false);
-
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
-
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
-
-        return 0;
+        return source_time_update(s, s->time.next, usec);
 }
 
 _public_ int sd_event_source_get_time_clock(sd_event_source *s, clockid_t *clock) {
@@ -1832,6 +3011,16 @@ _public_ int sd_event_source_get_child_pid(sd_event_source *s, pid_t *pid) {
         return 0;
 }
 
+_public_ int sd_event_source_get_inotify_mask(sd_event_source *s, uint32_t *ret) {
+        assert_return(s, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(s->type == SOURCE_INOTIFY, -EDOM);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        *ret = s->inotify.mask;
+        return 0;
+}
+
 _public_ int sd_event_source_set_prepare(sd_event_source *s, sd_event_handler_t callback) {
         int r;
 
@@ -1967,7 +3156,7 @@ static int event_arm_timer(
 
         struct itimerspec its = {};
         sd_event_source *a, *b;
-        usec_t t;
+        usec_t t, w;
         int r;
 
         assert(e);
@@ -1978,8 +3167,13 @@ static int event_arm_timer(
         else
                 d->needs_rearm = false;
 
+        w = timer_wheel_next(e, d);
+
         a = prioq_peek(d->earliest);
-        if (!a || a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY) {
+        if (a && (a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY))
+                a = NULL;
+
+        if (!a && w == USEC_INFINITY) {
 
                 if (d->fd < 0)
                         return 0;
@@ -1996,10 +3190,15 @@ static int event_arm_timer(
                 return 0;
         }
 
-        b = prioq_peek(d->latest);
-        assert_se(b && b->enabled != SD_EVENT_OFF);
+        if (a && a->time.next <= w) {
+                b = prioq_peek(d->latest);
+                assert_se(b && b->enabled != SD_EVENT_OFF);
 
-        t = sleep_between(e, a->time.next, time_event_source_latest(b));
+                /* Sources in the timer wheel are dispatched at the beginning of their slot, which is
+                 * already aligned, hence only limit the window of the prioqs by it */
+                t = sleep_between(e, a->time.next, MIN(time_event_source_latest(b), w));
+        } else
+                t = w;
         if (d->next == t)
                 return 0;
 
@@ -2039,6 +3238,162 @@ static int process_io(sd_event *e, sd_event_source *s, uint32_t revents) {
         return source_set_pending(s, true);
 }
 
+static int process_pidfd(sd_event *e, sd_event_source *s, uint32_t revents) {
+        assert(e);
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+        assert(s->child.pidfd >= 0);
+
+        if (s->pending)
+                return 0;
+
+        /* The pidfd became readable, hence the child exited. Fetch its state, but leave it a zombie so
+         * that the callback can still look at it, exactly like process_child() does. */
+        zero(s->child.siginfo);
+        if (waitid(P_PID, s->child.pid, &s->child.siginfo, WNOHANG|WNOWAIT|WEXITED) < 0) {
+                if (errno != ECHILD)
+                        return -errno;
+
+                /* Somebody else reaped it already, there's nothing to wait for anymore */
+                source_child_pidfd_unregister(s);
+                return 0;
+        }
+
+        if (s->child.siginfo.si_pid == 0)
+                return 0;
+
+        return source_set_pending(s, true);
+}
+
+static int event_inotify_data_read(sd_event *e, struct inotify_data *d, uint32_t revents) {
+        ssize_t n;
+
+        assert(e);
+        assert(d);
+
+        /* Only refill the buffer once everything in it has been dispatched */
+        if (d->buffer_filled > 0)
+                return 0;
+
+        n = read(d->fd, &d->buffer, sizeof(d->buffer));
+        if (n < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
+
+                return -errno;
+        }
+
+        assert(n > 0);
+        d->buffer_offset = 0;
+        d->buffer_filled = (size_t) n;
+        LIST_PREPEND(buffered, e->inotify_data_buffered, d);
+
+        return 1;
+}
+
+static void event_inotify_data_consume(sd_event *e, struct inotify_data *d, size_t sz) {
+        assert(e);
+        assert(d);
+        assert(sz <= d->buffer_filled);
+
+        d->buffer_offset += sz;
+        d->buffer_filled -= sz;
+
+        if (d->buffer_filled == 0)
+                LIST_REMOVE(buffered, e->inotify_data_buffered, d);
+}
+
+static int event_inotify_data_process(sd_event *e, struct inotify_data *d) {
+        int r;
+
+        assert(e);
+        assert(d);
+
+        /* Takes events off the buffer until one is found that some event source is interested in, and marks
+         * those sources pending. The next one is only looked at after all of them have been dispatched. */
+
+        if (d->n_pending > 0)
+                return 0;
+
+        while (d->buffer_filled > 0) {
+                struct inotify_event *ev = (struct inotify_event*) (d->buffer.raw + d->buffer_offset);
+                struct inode_data *inode_data;
+                sd_event_source *s;
+                Iterator i;
+                size_t sz;
+
+                if (d->buffer_filled < offsetof(struct inotify_event, name))
+                        return -EIO;
+
+                sz = offsetof(struct inotify_event, name) + ev->len;
+                if (d->buffer_filled < sz || sz > sizeof(d->current))
+                        return -EIO;
+
+                memcpy(&d->current, ev, sz);
+                event_inotify_data_consume(e, d, sz);
+                ev = &d->current.ev;
+
+                if (ev->mask & IN_Q_OVERFLOW) {
+                        /* Events were lost, tell everybody on this inotify fd */
+                        HASHMAP_FOREACH(inode_data, d->inodes, i)
+                                LIST_FOREACH(inotify.by_inode_data, s, inode_data->event_sources) {
+                                        if (s->enabled == SD_EVENT_OFF)
+                                                continue;
+
+                                        r = source_set_pending(s, true);
+                                        if (r < 0)
+                                                return r;
+                                }
+                } else {
+                        /* Events for watch descriptors we removed already might still be queued */
+                        inode_data = hashmap_get(d->wd, INT_TO_PTR(ev->wd));
+                        if (!inode_data)
+                                continue;
+
+                        /* The kernel dropped the watch, because the inode was deleted or unmounted */
+                        if (ev->mask & IN_IGNORED) {
+                                assert_se(hashmap_remove(d->wd, INT_TO_PTR(inode_data->wd)) == inode_data);
+                                inode_data->wd = -1;
+                        }
+
+                        LIST_FOREACH(inotify.by_inode_data, s, inode_data->event_sources) {
+                                if (s->enabled == SD_EVENT_OFF)
+                                        continue;
+
+                                if (!(ev->mask & (IN_IGNORED|IN_UNMOUNT)) &&
+                                    !(ev->mask & s->inotify.mask & IN_ALL_EVENTS))
+                                        continue;
+
+                                r = source_set_pending(s, true);
+                                if (r < 0)
+                                        return r;
+                        }
+                }
+
+                if (d->n_pending > 0)
+                        return 1;
+        }
+
+        return 0;
+}
+
+static int process_inotify(sd_event *e) {
+        struct inotify_data *d, *n;
+        int r, done = 0;
+
+        assert(e);
+
+        LIST_FOREACH_SAFE(buffered, d, n, e->inotify_data_buffered) {
+                r = event_inotify_data_process(e, d);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        done++;
+        }
+
+        return done;
+}
+
 static int flush_timer(sd_event *e, int fd, uint32_t events, usec_t *next) {
         uint64_t x;
         ssize_t ss;
@@ -2093,6 +3448,30 @@ static int process_timer(
                 d->needs_rearm = true;
         }
 
+        if (!d->wheel)
+                return 0;
+
+        /* Making a source pending unlinks it from the wheel */
+        while ((s = d->wheel->expired)) {
+                r = source_set_pending(s, true);
+                if (r < 0)
+                        return r;
+        }
+
+        /* All sources of a slot are due once it begins. We stop as soon as the wheel is empty, hence
+         * this walks over each slot at most once, even if we haven't run for a long time. */
+        while (d->wheel->n_linked > 0 &&
+               timer_wheel_slot_start(e, d->wheel->cursor) <= n) {
+
+                while ((s = d->wheel->slots[d->wheel->cursor % TIMER_WHEEL_SLOTS])) {
+                        r = source_set_pending(s, true);
+                        if (r < 0)
+                                return r;
+                }
+
+                d->wheel->cursor++;
+        }
+
         return 0;
 }
 
@@ -2132,6 +3511,10 @@ static int process_child(sd_event *e) {
                 if (s->enabled == SD_EVENT_OFF)
                         continue;
 
+                /* Children we have a pidfd for are handled by process_pidfd() */
+                if (s->child.pidfd >= 0)
+                        continue;
+
                 zero(s->child.siginfo);
                 r = waitid(P_PID, s->child.pid, &s->child.siginfo,
                            WNOHANG | (s->child.options & WEXITED ? WNOWAIT : 0) | s->child.options);
@@ -2223,6 +3606,7 @@ static int process_signal(sd_event *e, struct signal_data *d, uint32_t events) {
 
 static int source_dispatch(sd_event_source *s) {
         EventSourceType saved_type;
+        usec_t start = USEC_INFINITY;
         int r = 0;
 
         assert(s);
@@ -2246,7 +3630,7 @@ static int source_dispatch(sd_event_source *s) {
                  * post sources as pending */
 
                 SET_FOREACH(z, s->event->post_sources, i) {
-                        if (z->enabled == SD_EVENT_OFF)
+                        if (z->enabled == SD_EVENT_OFF || z->ratelimited)
                                 continue;
 
                         r = source_set_pending(z, true);
@@ -2261,6 +3645,14 @@ static int source_dispatch(sd_event_source *s) {
                         return r;
         }
 
+        /* Note that the callback might disconnect the source from the event loop object, hence remember
+         * whether we shall profile it */
+        if (s->event->profile_delays)
+                start = now(CLOCK_MONOTONIC);
+
+        if (s->rate_limit.interval > 0)
+                (void) ratelimit_test(&s->rate_limit);
+
         s->dispatching = true;
 
         switch (s->type) {
@@ -2307,6 +3699,24 @@ static int source_dispatch(sd_event_source *s) {
                 r = s->exit.callback(s, s->userdata);
                 break;
 
+        case SOURCE_INOTIFY: {
+                struct inotify_data *d;
+                struct inotify_event *ev;
+                size_t sz;
+
+                assert(s->inotify.inode_data);
+                assert_se(d = s->inotify.inode_data->inotify_data);
+
+                /* The callback might release the inotify object with the last event source on it, hence
+                 * pass a copy */
+                sz = offsetof(struct inotify_event, name) + d->current.ev.len;
+                ev = alloca(sz);
+                memcpy(ev, &d->current, sz);
+
+                r = s->inotify.callback(s, ev, s->userdata);
+                break;
+        }
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -2315,6 +3725,11 @@ static int source_dispatch(sd_event_source *s) {
 
         s->dispatching = false;
 
+        if (start != USEC_INFINITY) {
+                s->n_dispatched++;
+                s->dispatch_usec += now(CLOCK_MONOTONIC) - start;
+        }
+
         if (r < 0)
                 log_debug_errno(r, "Event source %s (type %s) returned error, disabling: %m",
                                 strna(s->description), event_source_type_to_string(saved_type));
@@ -2323,6 +3738,8 @@ static int source_dispatch(sd_event_source *s) {
                 source_free(s);
         else if (r < 0)
                 sd_event_source_set_enabled(s, SD_EVENT_OFF);
+        else if (s->rate_limit.interval > 0 && s->rate_limit.num >= s->rate_limit.burst)
+                (void) source_enter_ratelimited(s);
 
         return 1;
 }
@@ -2455,6 +3872,9 @@ _public_ int sd_event_prepare(sd_event *e) {
         if (e->exit_requested)
                 goto pending;
 
+        /* Priorities of inotify sources added since the last iteration can't be changed anymore after this */
+        event_close_inode_data_fds(e);
+
         e->iteration++;
 
         e->state = SD_EVENT_PREPARING;
@@ -2483,7 +3903,7 @@ _public_ int sd_event_prepare(sd_event *e) {
         if (r < 0)
                 return r;
 
-        if (event_next_pending(e) || e->need_process_child)
+        if (event_next_pending(e) || e->need_process_child || e->inotify_data_buffered)
                 goto pending;
 
         e->state = SD_EVENT_ARMED;
@@ -2501,7 +3921,7 @@ pending:
 
 _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
         struct epoll_event *ev_queue;
-        unsigned ev_queue_max;
+        size_t ev_queue_max;
         int r, m, i;
 
         assert_return(e, -EINVAL);
@@ -2514,8 +3934,15 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                 return 1;
         }
 
-        ev_queue_max = MAX(e->n_sources, 1u);
-        ev_queue = newa(struct epoll_event, ev_queue_max);
+        /* The buffer is kept around between iterations, and bounded in size. Events that don't fit are
+         * simply reported again by the next epoll_wait(). */
+        ev_queue_max = CLAMP((size_t) e->n_sources, 1U, EPOLL_QUEUE_MAX);
+        if (!GREEDY_REALLOC(e->event_queue, e->event_queue_allocated, ev_queue_max)) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        ev_queue = e->event_queue;
 
         m = epoll_wait(e->epoll_fd, ev_queue, ev_queue_max,
                        timeout == (uint64_t) -1 ? -1 : (int) ((timeout + USEC_PER_MSEC - 1) / USEC_PER_MSEC));
@@ -2540,9 +3967,15 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
 
                         switch (*t) {
 
-                        case WAKEUP_EVENT_SOURCE:
-                                r = process_io(e, ev_queue[i].data.ptr, ev_queue[i].events);
+                        case WAKEUP_EVENT_SOURCE: {
+                                sd_event_source *s = ev_queue[i].data.ptr;
+
+                                if (s->type == SOURCE_CHILD)
+                                        r = process_pidfd(e, s, ev_queue[i].events);
+                                else
+                                        r = process_io(e, s, ev_queue[i].events);
                                 break;
+                        }
 
                         case WAKEUP_CLOCK_DATA: {
                                 struct clock_data *d = ev_queue[i].data.ptr;
@@ -2554,6 +3987,10 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                                 r = process_signal(e, ev_queue[i].data.ptr, ev_queue[i].events);
                                 break;
 
+                        case WAKEUP_INOTIFY_DATA:
+                                r = event_inotify_data_read(e, ev_queue[i].data.ptr, ev_queue[i].events);
+                                break;
+
                         default:
                                 assert_not_reached("Invalid wake-up pointer");
                         }
@@ -2592,6 +4029,10 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                         goto finish;
         }
 
+        r = process_inotify(e);
+        if (r < 0)
+                goto finish;
+
         if (event_next_pending(e)) {
                 e->state = SD_EVENT_PENDING;
 
@@ -2638,6 +4079,7 @@ _public_ int sd_event_dispatch(sd_event *e) {
 
 static void event_log_delays(sd_event *e) {
         char b[ELEMENTSOF(e->delays) * DECIMAL_STR_MAX(unsigned) + 1];
+        sd_event_source *s;
         unsigned i;
         int o;
 
@@ -2646,6 +4088,21 @@ static void event_log_delays(sd_event *e) {
                 e->delays[i] = 0;
         }
         log_debug("Event loop iterations: %.*s", o, b);
+
+        /* Also show which sources the time went to */
+        LIST_FOREACH(sources, s, e->sources) {
+                char t[FORMAT_TIMESPAN_MAX];
+
+                if (s->n_dispatched == 0)
+                        continue;
+
+                log_debug("Event source %s (type %s): dispatched %u times, %s total.",
+                          strna(s->description), event_source_type_to_string(s->type),
+                          s->n_dispatched, format_timespan(t, sizeof(t), s->dispatch_usec, 1));
+
+                s->n_dispatched = 0;
+                s->dispatch_usec = 0;
+        }
 }
 
 _public_ int sd_event_run(sd_event *e, uint64_t timeout) {
@@ -0,0 +1,138 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "log.h"
+#include "macro.h"
+#include "tests.h"
+#include "util.h"
+
+/* Measures how fast the event loop dispatches the source types daemons use most: deferred work, ready file
+ * descriptors and elapsed timers. */
+
+static int counting_handler(sd_event_source *s, void *userdata) {
+        unsigned *c = userdata;
+
+        (*c)++;
+        return 0;
+}
+
+static int io_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        return counting_handler(s, userdata);
+}
+
+static int time_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        return counting_handler(s, userdata);
+}
+
+static nsec_t bench_defer(unsigned n, void *userdata) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        unsigned c = 0, i;
+        nsec_t t;
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_add_defer(e, &s, counting_handler, &c) >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(sd_event_run(e, 0) > 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        assert_se(c == n);
+
+        return t;
+}
+
+static nsec_t bench_io(unsigned n, void *userdata) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_close_pair_ int p[2] = { -1, -1 };
+        unsigned c = 0, i;
+        nsec_t t;
+
+        /* The pipe is never drained, so that the source stays ready for every iteration */
+        assert_se(pipe2(p, O_CLOEXEC|O_NONBLOCK) >= 0);
+        assert_se(write(p[1], "x", 1) == 1);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_add_io(e, &s, p[0], EPOLLIN, io_handler, &c) >= 0);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(sd_event_run(e, 0) > 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        assert_se(c == n);
+
+        return t;
+}
+
+static nsec_t bench_time(unsigned n, void *userdata) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source **sources;
+        unsigned c = 0, i;
+        uint64_t base;
+        nsec_t t;
+
+        sources = new0(sd_event_source*, n);
+        assert_se(sources);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_now(e, CLOCK_MONOTONIC, &base) >= 0);
+
+        /* All of them elapsed already, in an order different from the one they were added in. An accuracy of 0
+         * would select the default one, and let the loop wait for the end of the window it allows. */
+        for (i = 0; i < n; i++)
+                assert_se(sd_event_add_time(e, sources + i, CLOCK_MONOTONIC,
+                                            base - 1 - (i * UINT64_C(2654435761)) % n, 1,
+                                            time_handler, &c) >= 0);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        while (c < n)
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        for (i = 0; i < n; i++)
+                sd_event_source_unref(sources[i]);
+        free(sources);
+
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        unsigned n;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        n = benchmark_get_iterations(argc, argv, 10000, 1000000);
+
+        benchmark_run("sd-event", "defer", n, bench_defer, NULL);
+        benchmark_run("sd-event", "io", n, bench_io, NULL);
+        benchmark_run("sd-event", "time", n, bench_time, NULL);
+
+        return 0;
+}
@@ -17,14 +17,19 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <pthread.h>
 #include <sys/wait.h>
 
 #include "sd-event.h"
 
+#include "env-util.h"
 #include "fd-util.h"
+#include "fs-util.h"
 #include "log.h"
 #include "macro.h"
+#include "rm-rf.h"
 #include "signal-util.h"
+#include "string-util.h"
 #include "util.h"
 
 static int prepare_handler(sd_event_source *s, void *userdata) {
@@ -353,14 +358,314 @@ static void test_rtqueue(void) {
         sd_event_unref(e);
 }
 
+static unsigned n_children = 0, n_children_exited = 0;
+
+static int many_children_handler(sd_event_source *s, const siginfo_t *si, void *userdata) {
+        assert_se(si->si_code == CLD_EXITED);
+        assert_se(si->si_status == EXIT_SUCCESS);
+
+        if (++n_children_exited >= n_children)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        sd_event_source_unref(s);
+        return 1;
+}
+
+static void test_many_children(bool slow) {
+        sd_event *e = NULL;
+        int p[2] = { -1, -1 };
+        usec_t start;
+        unsigned i;
+
+        /* Let a lot of watched children exit one by one and see how long it takes to process them all */
+
+        n_children = slow ? 2000 : 32;
+
+        assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGCHLD, -1) >= 0);
+        assert_se(pipe(p) >= 0);
+        assert_se(sd_event_new(&e) >= 0);
+
+        for (i = 0; i < n_children; i++) {
+                pid_t pid;
+
+                pid = fork();
+                assert_se(pid >= 0);
+                if (pid == 0) {
+                        char c;
+
+                        /* Wait until the parent is ready, and exit one after the other */
+                        safe_close(p[1]);
+                        _exit(read(p[0], &c, 1) == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+                }
+
+                assert_se(sd_event_add_child(e, NULL, pid, WEXITED, many_children_handler, NULL) >= 0);
+        }
+
+        start = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < n_children; i++)
+                assert_se(write(p[1], "x", 1) == 1);
+
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(n_children_exited == n_children);
+
+        log_info("%u children processed in %.2fms", n_children, (now(CLOCK_MONOTONIC) - start) / 1e3);
+
+        safe_close_pair(p);
+        sd_event_unref(e);
+}
+
+#define N_POSTS 10000U
+
+static unsigned n_posts_dispatched = 0;
+
+static int post_to_handler(sd_event_source *s, void *userdata) {
+        /* Callbacks from a single thread are dispatched in the order they were posted */
+        assert_se(PTR_TO_UINT(userdata) == n_posts_dispatched);
+
+        if (++n_posts_dispatched >= N_POSTS)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+static void *post_to_thread(void *p) {
+        sd_event *e = p;
+        unsigned i;
+
+        for (i = 0; i < N_POSTS; i++)
+                assert_se(sd_event_post_to(e, post_to_handler, UINT_TO_PTR(i)) >= 0);
+
+        return NULL;
+}
+
+static void test_post_to(void) {
+        sd_event_source *s = NULL;
+        sd_event *e = NULL;
+        pthread_t t;
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_post_to(e, post_to_handler, NULL) == -ENXIO);
+
+        assert_se(sd_event_add_wakeup(e, &s) >= 0);
+        assert_se(sd_event_add_wakeup(e, NULL) == -EBUSY);
+
+        assert_se(pthread_create(&t, NULL, post_to_thread, e) == 0);
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        assert_se(n_posts_dispatched == N_POSTS);
+
+        sd_event_source_unref(s);
+        sd_event_unref(e);
+}
+
+static unsigned n_ratelimit_io = 0;
+
+static int ratelimit_io_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        /* Never read anything, so that the fd stays readable, like a socket under flood */
+        n_ratelimit_io++;
+        return 0;
+}
+
+static void test_ratelimit(void) {
+        _cleanup_close_pair_ int p[2] = { -1, -1 };
+        sd_event_source *s = NULL;
+        sd_event *e = NULL;
+        uint64_t interval;
+        unsigned burst, i;
+        usec_t start;
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(pipe2(p, O_CLOEXEC|O_NONBLOCK) >= 0);
+        assert_se(write(p[1], "x", 1) == 1);
+
+        assert_se(sd_event_add_io(e, &s, p[0], EPOLLIN, ratelimit_io_handler, NULL) >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -ENOEXEC);
+
+        assert_se(sd_event_source_set_ratelimit(s, 10 * USEC_PER_SEC, 10) >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, &interval, &burst) >= 0);
+        assert_se(interval == 10 * USEC_PER_SEC);
+        assert_se(burst == 10);
+
+        /* The source is paused after its burst, even though the fd is still readable */
+        for (i = 0; i < 20; i++)
+                assert_se(sd_event_run(e, 10 * USEC_PER_MSEC) >= 0);
+        assert_se(n_ratelimit_io == 10);
+        assert_se(sd_event_source_is_ratelimited(s) > 0);
+
+        /* Lifting the limit resumes the source right away */
+        assert_se(sd_event_source_set_ratelimit(s, 0, 0) >= 0);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+        assert_se(sd_event_run(e, 0) >= 0);
+        assert_se(n_ratelimit_io == 11);
+
+        /* With a short interval the source is resumed whenever an interval ends, 5 dispatches later it's
+         * paused again. */
+        assert_se(sd_event_source_set_ratelimit(s, 20 * USEC_PER_MSEC, 5) >= 0);
+        start = now(CLOCK_MONOTONIC);
+        while (n_ratelimit_io < 31)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+        assert_se(now(CLOCK_MONOTONIC) - start >= 60 * USEC_PER_MSEC);
+
+        sd_event_source_unref(s);
+        sd_event_unref(e);
+}
+
+static unsigned n_inotify_created = 0, n_inotify_deleted = 0, n_inotify_other_priority = 0;
+
+static int inotify_handler(sd_event_source *s, const struct inotify_event *ev, void *userdata) {
+        const char *which = userdata;
+
+        log_info("inotify event on %s: %s mask %" PRIx32, which, ev->len > 0 ? ev->name : "n/a", ev->mask);
+
+        assert_se(ev->len > 0);
+
+        if (streq(which, "create")) {
+                assert_se(ev->mask & IN_CREATE);
+                n_inotify_created++;
+        } else if (streq(which, "delete")) {
+                assert_se(ev->mask & IN_DELETE);
+                assert_se(streq(ev->name, "a"));
+                n_inotify_deleted++;
+        } else {
+                assert_se(ev->mask & IN_CREATE);
+                n_inotify_other_priority++;
+        }
+
+        return 0;
+}
+
+static void test_inotify(void) {
+        char p[] = "/tmp/test-event-inotify.XXXXXX";
+        sd_event_source *a = NULL, *b = NULL, *c = NULL;
+        sd_event *e = NULL;
+        uint32_t mask;
+
+        assert_se(mkdtemp(p));
+        assert_se(sd_event_new(&e) >= 0);
+
+        /* Three sources on the same directory, two of which share a watch descriptor */
+        assert_se(sd_event_add_inotify(e, &a, p, IN_CREATE, inotify_handler, (void*) "create") >= 0);
+        assert_se(sd_event_add_inotify(e, &b, p, IN_DELETE, inotify_handler, (void*) "delete") >= 0);
+        assert_se(sd_event_add_inotify(e, &c, p, IN_CREATE|IN_ONLYDIR, inotify_handler, (void*) "other") >= 0);
+        assert_se(sd_event_add_inotify(e, NULL, p, IN_ONESHOT, inotify_handler, NULL) == -EINVAL);
+
+        assert_se(sd_event_source_get_inotify_mask(b, &mask) >= 0);
+        assert_se(mask == IN_DELETE);
+
+        assert_se(sd_event_source_set_priority(c, SD_EVENT_PRIORITY_IDLE) >= 0);
+
+        assert_se(touch(strjoina(p, "/a")) >= 0);
+        assert_se(touch(strjoina(p, "/b")) >= 0);
+        assert_se(touch(strjoina(p, "/c")) >= 0);
+        assert_se(unlink(strjoina(p, "/a")) >= 0);
+
+        while (n_inotify_created < 3 || n_inotify_deleted < 1 || n_inotify_other_priority < 3)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        /* Give unexpected events a chance to show up */
+        assert_se(sd_event_run(e, 10 * USEC_PER_MSEC) >= 0);
+        assert_se(n_inotify_created == 3);
+        assert_se(n_inotify_deleted == 1);
+        assert_se(n_inotify_other_priority == 3);
+
+        /* After the first iteration the original inode isn't pinned anymore */
+        assert_se(sd_event_source_set_priority(c, SD_EVENT_PRIORITY_NORMAL) == -EOPNOTSUPP);
+
+        sd_event_source_unref(a);
+        sd_event_source_unref(b);
+        sd_event_source_unref(c);
+        sd_event_unref(e);
+
+        assert_se(rm_rf(p, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+#define N_WHEEL_TIMERS 100U
+
+static unsigned n_wheel_timers = 0;
+
+static int wheel_timer_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        uint64_t accuracy, n;
+
+        assert_se(sd_event_now(sd_event_source_get_event(s), CLOCK_MONOTONIC, &n) >= 0);
+        assert_se(sd_event_source_get_time_accuracy(s, &accuracy) >= 0);
+
+        /* Never too early, and not much later than the end of the window either */
+        assert_se(n >= usec);
+        assert_se(n <= usec + accuracy + 100 * USEC_PER_MSEC);
+
+        n_wheel_timers++;
+        return 0;
+}
+
+static void test_timer_wheel(void) {
+        sd_event_source *s[N_WHEEL_TIMERS] = {};
+        sd_event *e = NULL;
+        usec_t start;
+        unsigned i;
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        start = now(CLOCK_MONOTONIC);
+
+        /* Mix sources with the default accuracy, which end up in the timer wheel, with precise ones */
+        for (i = 0; i < N_WHEEL_TIMERS; i++)
+                assert_se(sd_event_add_time(e, &s[i], CLOCK_MONOTONIC, start + i * 10 * USEC_PER_MSEC,
+                                            i % 3 == 0 ? USEC_PER_MSEC : 0, wheel_timer_handler, NULL) >= 0);
+
+        /* Move some far into the future and back, which switches them between the wheel and the prioqs */
+        for (i = 1; i < N_WHEEL_TIMERS; i += 7) {
+                assert_se(sd_event_source_set_time(s[i], start + USEC_PER_HOUR) >= 0);
+                assert_se(sd_event_source_set_time(s[i], start + i * 5 * USEC_PER_MSEC) >= 0);
+        }
+
+        for (i = 2; i < N_WHEEL_TIMERS; i += 11) {
+                assert_se(sd_event_source_set_enabled(s[i], SD_EVENT_OFF) >= 0);
+                assert_se(sd_event_source_set_time_accuracy(s[i], 300 * USEC_PER_MSEC) >= 0);
+                assert_se(sd_event_source_set_enabled(s[i], SD_EVENT_ONESHOT) >= 0);
+        }
+
+        /* This one stays far away and must not fire */
+        assert_se(sd_event_source_set_time(s[N_WHEEL_TIMERS - 1], start + USEC_PER_HOUR) >= 0);
+
+        while (n_wheel_timers < N_WHEEL_TIMERS - 1)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        assert_se(sd_event_run(e, 300 * USEC_PER_MSEC) == 0);
+        assert_se(n_wheel_timers == N_WHEEL_TIMERS - 1);
+
+        /* Re-arming a dispatched source in the past fires it right-away */
+        assert_se(sd_event_source_set_time(s[0], now(CLOCK_MONOTONIC) - USEC_PER_MSEC) >= 0);
+        assert_se(sd_event_source_set_enabled(s[0], SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_run(e, (uint64_t) -1) >= 1);
+        assert_se(n_wheel_timers == N_WHEEL_TIMERS);
+
+        for (i = 0; i < N_WHEEL_TIMERS; i++)
+                sd_event_source_unref(s[i]);
+
+        sd_event_unref(e);
+}
+
 int main(int argc, char *argv[]) {
+        bool slow;
+        int r;
 
         log_set_max_level(LOG_DEBUG);
         log_parse_environment();
 
+        r = getenv_bool("SYSTEMD_SLOW_TESTS");
+        slow = r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT;
+
         test_basic();
         test_sd_event_now();
         test_rtqueue();
+        test_many_children(slow);
+        test_post_to();
+        test_ratelimit();
+        test_inotify();
+        test_timer_wheel();
 
         return 0;
 }
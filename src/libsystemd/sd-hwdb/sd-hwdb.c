@@ -211,6 +211,53 @@ static int hwdb_add_property(sd_hwdb *hwdb, const struct trie_value_entry_f *ent
         return 0;
 }
 
+/* Returns false if the glob in @buf is cut off in the middle of an escape sequence or a bracket
+ * expression, i.e. if appending more characters could still change the meaning of what is there. */
+static bool linebuf_glob_is_complete(struct linebuf *buf) {
+        size_t i;
+
+        for (i = 0; i < buf->len; i++) {
+                if (buf->bytes[i] == '\\') {
+                        i++;
+                        if (i >= buf->len)
+                                return false;
+                } else if (buf->bytes[i] == '[') {
+                        i++;
+                        if (i < buf->len && IN_SET(buf->bytes[i], '!', '^'))
+                                i++;
+                        if (i < buf->len && buf->bytes[i] == ']')
+                                i++;
+                        for (; i < buf->len && buf->bytes[i] != ']'; i++)
+                                /* escapes and character classes inside brackets, don't bother */
+                                if (IN_SET(buf->bytes[i], '\\', '['))
+                                        return false;
+                        if (i >= buf->len)
+                                return false;
+                }
+        }
+
+        return true;
+}
+
+/* Returns false if no glob starting with the one in @buf can match @search. A pattern P extended by
+ * anything matches a string iff P matches a prefix of it, which is exactly what "P*" matches. */
+static bool linebuf_may_match(struct linebuf *buf, const char *search) {
+        const char *pattern;
+        bool r;
+
+        if (!linebuf_glob_is_complete(buf))
+                return true;
+
+        if (!linebuf_add_char(buf, '*'))
+                return true;
+
+        pattern = linebuf_get(buf);
+        r = !pattern || fnmatch(pattern, search, 0) == 0;
+        linebuf_rem_char(buf);
+
+        return r;
+}
+
 static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t p,
                           struct linebuf *buf, const char *search) {
         size_t len;
@@ -222,6 +269,13 @@ static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t
         len = strlen(prefix + p);
         linebuf_add(buf, prefix + p, len);
 
+        /* Skip the whole subtree if the glob collected so far already rules out a match, instead of
+         * running fnmatch() on every entry below. */
+        if (node->children_count > 0 && !linebuf_may_match(buf, search)) {
+                linebuf_rem(buf, len);
+                return 0;
+        }
+
         for (i = 0; i < node->children_count; i++) {
                 const struct trie_child_entry_f *child = trie_node_child(hwdb, node, i);
 
@@ -19,8 +19,10 @@
 
 #include <errno.h>
 #include <poll.h>
+#include <stdarg.h>
 #include <string.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "sd-login.h"
@@ -28,6 +30,7 @@
 #include "alloc-util.h"
 #include "cgroup-util.h"
 #include "dirent-util.h"
+#include "env-util.h"
 #include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -39,6 +42,7 @@
 #include "macro.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "socket-util.h"
 #include "string-util.h"
 #include "strv.h"
@@ -55,6 +59,129 @@
  *    requested metadata on object is missing → -ENODATA
  */
 
+/* The state files of sessions, users and seats below /run/systemd/ are replaced atomically by logind whenever they
+ * change, hence their identity tells us whether their contents changed. Keep the most recently parsed file around,
+ * so that clients that query several properties of the same object in a row only need one stat() for each of them,
+ * instead of reading and parsing the whole file again.
+ *
+ * The cache is guarded by a lock that records the PID of its holder, and that is only ever tried, never waited
+ * for: a normal mutex held by some other thread at the time of fork() would stay locked forever in the child. If
+ * the holder is another thread of ours, the file is parsed without the cache. If it is a thread of the process we
+ * were forked from, we take the lock over. */
+static pid_t state_file_owner = 0;
+static char *state_file_path = NULL;
+static struct stat state_file_stat;
+static char **state_file_env = NULL;
+
+static bool state_file_trylock(void) {
+        int r;
+
+        r = pid_trylock(&state_file_owner);
+        if (r < 0)
+                return false;
+        if (r > 0) {
+                /* The previous holder might have been in the middle of updating the cache, hence forget about
+                 * it. Don't free anything, it might be gone already. */
+                state_file_path = NULL;
+                state_file_env = NULL;
+        }
+
+        return true;
+}
+
+static bool state_file_stat_equal(const struct stat *a, const struct stat *b) {
+        return a->st_dev == b->st_dev &&
+                a->st_ino == b->st_ino &&
+                a->st_size == b->st_size &&
+                a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+                a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static int state_file_load(const char *path) {
+        _cleanup_strv_free_ char **env = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *copy = NULL;
+        struct stat st;
+        int r;
+
+        if (stat(path, &st) < 0)
+                return -errno;
+
+        if (state_file_path && path_equal(state_file_path, path) && state_file_stat_equal(&st, &state_file_stat))
+                return 0;
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        /* Use the identity of the file we actually read, in case it was replaced in the meantime */
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        r = load_env_file(f, path, NEWLINE, &env);
+        if (r < 0)
+                return r;
+
+        copy = strdup(path);
+        if (!copy)
+                return -ENOMEM;
+
+        free_and_replace(state_file_path, copy);
+        strv_free(state_file_env);
+        state_file_env = env;
+        env = NULL;
+        state_file_stat = st;
+
+        return 0;
+}
+
+static int parse_state_file(const char *path, ...) {
+        _cleanup_strv_free_ char **uncached = NULL;
+        const char *key;
+        unsigned n = 0;
+        char **env;
+        bool locked;
+        va_list ap;
+        int r;
+
+        assert(path);
+
+        locked = state_file_trylock();
+        if (locked) {
+                r = state_file_load(path);
+                env = state_file_env;
+        } else {
+                r = load_env_file(NULL, path, NEWLINE, &uncached);
+                env = uncached;
+        }
+        if (r < 0)
+                goto finish;
+
+        va_start(ap, path);
+        while ((key = va_arg(ap, const char*))) {
+                char **v = va_arg(ap, char**);
+                const char *value;
+
+                value = strv_env_get(env, key);
+                if (!value)
+                        continue;
+
+                if (r >= 0 && free_and_strdup(v, value) < 0)
+                        r = -ENOMEM;
+                n++;
+        }
+        va_end(ap);
+
+        if (r >= 0)
+                r = (int) n;
+
+finish:
+        if (locked)
+                pid_unlock(&state_file_owner);
+
+        return r;
+}
+
 _public_ int sd_pid_get_session(pid_t pid, char **session) {
         int r;
 
@@ -285,7 +412,7 @@ _public_ int sd_uid_get_state(uid_t uid, char**state) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "STATE", &s, NULL);
+        r = parse_state_file(p, "STATE", &s, NULL);
         if (r == -ENOENT) {
                 free(s);
                 s = strdup("offline");
@@ -316,7 +443,7 @@ _public_ int sd_uid_get_display(uid_t uid, char **session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "DISPLAY", &s, NULL);
+        r = parse_state_file(p, "DISPLAY", &s, NULL);
         if (r == -ENOENT)
                 return -ENODATA;
         if (r < 0)
@@ -373,7 +500,7 @@ _public_ int sd_uid_is_on_seat(uid_t uid, int require_active, const char *seat)
 
         variable = require_active ? "ACTIVE_UID" : "UIDS";
 
-        r = parse_env_file(p, NEWLINE, variable, &s, NULL);
+        r = parse_state_file(p, variable, &s, NULL);
         if (r == -ENOENT)
                 return 0;
         if (r < 0)
@@ -402,7 +529,7 @@ static int uid_get_array(uid_t uid, const char *variable, char ***array) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, variable, &s, NULL);
+        r = parse_state_file(p, variable, &s, NULL);
         if (r == -ENOENT || (r >= 0 && isempty(s))) {
                 if (array)
                         *array = NULL;
@@ -480,7 +607,7 @@ _public_ int sd_session_is_active(const char *session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "ACTIVE", &s, NULL);
+        r = parse_state_file(p, "ACTIVE", &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -499,7 +626,7 @@ _public_ int sd_session_is_remote(const char *session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "REMOTE", &s, NULL);
+        r = parse_state_file(p, "REMOTE", &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -520,7 +647,7 @@ _public_ int sd_session_get_state(const char *session, char **state) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "STATE", &s, NULL);
+        r = parse_state_file(p, "STATE", &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -544,7 +671,7 @@ _public_ int sd_session_get_uid(const char *session, uid_t *uid) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, "UID", &s, NULL);
+        r = parse_state_file(p, "UID", &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -566,7 +693,7 @@ static int session_get_string(const char *session, const char *field, char **val
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE, field, &s, NULL);
+        r = parse_state_file(p, field, &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -659,10 +786,7 @@ _public_ int sd_seat_get_active(const char *seat, char **session, uid_t *uid) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE,
-                           "ACTIVE", &s,
-                           "ACTIVE_UID", &t,
-                           NULL);
+        r = parse_state_file(p, "ACTIVE", &s, "ACTIVE_UID", &t, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -699,10 +823,7 @@ _public_ int sd_seat_get_sessions(const char *seat, char ***sessions, uid_t **ui
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE,
-                           "SESSIONS", &s,
-                           "UIDS", &t,
-                           NULL);
+        r = parse_state_file(p, "SESSIONS", &s, "UIDS", &t, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -772,9 +893,7 @@ static int seat_get_can(const char *seat, const char *variable) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(p, NEWLINE,
-                           variable, &s,
-                           NULL);
+        r = parse_state_file(p, variable, &s, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -924,7 +1043,7 @@ _public_ int sd_machine_get_class(const char *machine, char **class) {
         assert_return(class, -EINVAL);
 
         p = strjoina("/run/systemd/machines/", machine);
-        r = parse_env_file(p, NEWLINE, "CLASS", &c, NULL);
+        r = parse_state_file(p, "CLASS", &c, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -949,7 +1068,7 @@ _public_ int sd_machine_get_ifindices(const char *machine, int **ifindices) {
         assert_return(ifindices, -EINVAL);
 
         p = strjoina("/run/systemd/machines/", machine);
-        r = parse_env_file(p, NEWLINE, "NETIF", &netif, NULL);
+        r = parse_state_file(p, "NETIF", &netif, NULL);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -33,6 +33,9 @@
 #define RTNL_WQUEUE_MAX 1024
 #define RTNL_RQUEUE_MAX 64*1024
 
+/* Maximum number of messages dispatched per event loop iteration */
+#define RTNL_PROCESS_BATCH_MAX 64U
+
 #define RTNL_CONTAINER_DEPTH 32
 
 struct reply_callback {
@@ -84,6 +87,11 @@ struct sd_netlink {
 
         LIST_HEAD(struct match_callback, match_callbacks);
 
+        /* Messages were lost since the last time the overflow handler was called */
+        bool overflowed:1;
+        sd_netlink_overflow_handler_t overflow_callback;
+        void *overflow_userdata;
+
         pid_t original_pid;
 
         sd_event_source *io_event_source;
@@ -115,12 +123,14 @@ struct sd_netlink_message {
         unsigned n_containers; /* number of containers */
         bool sealed:1;
         bool broadcast:1;
+        bool embedded:1; /* the top-level attributes are stored in the hdr allocation */
 
         sd_netlink_message *next; /* next in a chain of multi-part messages */
 };
 
 int message_new(sd_netlink *rtnl, sd_netlink_message **ret, uint16_t type);
 int message_new_empty(sd_netlink *rtnl, sd_netlink_message **ret);
+int message_new_received(sd_netlink *rtnl, const struct nlmsghdr *hdr, const NLType *nl_type, sd_netlink_message **ret);
 
 int socket_open(int family);
 int socket_bind(sd_netlink *nl);
@@ -122,9 +122,12 @@ sd_netlink_message *sd_netlink_message_unref(sd_netlink_message *m) {
         while (m && REFCNT_DEC(m->n_ref) == 0) {
                 unsigned i;
 
+                /* For received messages the top-level attributes are part of the header allocation */
+                if (!m->embedded)
+                        free(m->containers[0].attributes);
                 free(m->hdr);
 
-                for (i = 0; i <= m->n_containers; i++)
+                for (i = 1; i <= m->n_containers; i++)
                         free(m->containers[i].attributes);
 
                 t = m;
@@ -723,17 +726,11 @@ int sd_netlink_message_read_in6_addr(sd_netlink_message *m, unsigned short type,
         return 0;
 }
 
-static int netlink_container_parse(sd_netlink_message *m,
-                                   struct netlink_container *container,
-                                   int count,
-                                   struct rtattr *rta,
-                                   unsigned int rt_len) {
-        _cleanup_free_ struct netlink_attribute *attributes = NULL;
-
-        attributes = new0(struct netlink_attribute, count);
-        if (!attributes)
-                return -ENOMEM;
-
+static void netlink_container_parse_attributes(sd_netlink_message *m,
+                                              struct netlink_attribute *attributes,
+                                              int count,
+                                              struct rtattr *rta,
+                                              unsigned int rt_len) {
         for (; RTA_OK(rta, rt_len); rta = RTA_NEXT(rta, rt_len)) {
                 unsigned short type;
 
@@ -751,6 +748,20 @@ static int netlink_container_parse(sd_netlink_message *m,
                 attributes[type].nested = RTA_FLAGS(rta) & NLA_F_NESTED;
                 attributes[type].net_byteorder = RTA_FLAGS(rta) & NLA_F_NET_BYTEORDER;
         }
+}
+
+static int netlink_container_parse(sd_netlink_message *m,
+                                   struct netlink_container *container,
+                                   int count,
+                                   struct rtattr *rta,
+                                   unsigned int rt_len) {
+        _cleanup_free_ struct netlink_attribute *attributes = NULL;
+
+        attributes = new0(struct netlink_attribute, count);
+        if (!attributes)
+                return -ENOMEM;
+
+        netlink_container_parse_attributes(m, attributes, count, rta, rt_len);
 
         container->attributes = attributes;
         attributes = NULL;
@@ -759,6 +770,57 @@ static int netlink_container_parse(sd_netlink_message *m,
         return 0;
 }
 
+int message_new_received(sd_netlink *rtnl, const struct nlmsghdr *hdr, const NLType *nl_type, sd_netlink_message **ret) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+        const NLTypeSystem *type_system = NULL;
+        size_t size, count = 0;
+        int r;
+
+        assert(hdr);
+        assert(nl_type);
+        assert(ret);
+
+        if (type_get_type(nl_type) == NETLINK_TYPE_NESTED) {
+                type_get_type_system(nl_type, &type_system);
+                count = type_system_get_count(type_system);
+        }
+
+        /* Dumps deliver messages by the thousands, hence allocate the copy of the header together with
+         * the array of top-level attributes, and parse those right away. */
+        r = message_new_empty(rtnl, &m);
+        if (r < 0)
+                return r;
+
+        size = ALIGN(hdr->nlmsg_len);
+        m->hdr = malloc(size + count * sizeof(struct netlink_attribute));
+        if (!m->hdr)
+                return -ENOMEM;
+
+        m->embedded = true;
+        memcpy(m->hdr, hdr, hdr->nlmsg_len);
+
+        rtnl_message_seal(m);
+
+        if (type_system) {
+                size_t header_size = type_get_size(nl_type);
+
+                m->containers[0].type_system = type_system;
+                m->containers[0].attributes = memzero((uint8_t*) m->hdr + size, count * sizeof(struct netlink_attribute));
+                m->containers[0].n_attributes = count;
+
+                netlink_container_parse_attributes(m,
+                                                   m->containers[0].attributes,
+                                                   count,
+                                                   (struct rtattr*)((uint8_t*)NLMSG_DATA(m->hdr) + NLMSG_ALIGN(header_size)),
+                                                   NLMSG_PAYLOAD(m->hdr, header_size));
+        }
+
+        *ret = m;
+        m = NULL;
+
+        return 0;
+}
+
 int sd_netlink_message_enter_container(sd_netlink_message *m, unsigned short type_id) {
         const NLType *nl_type;
         const NLTypeSystem *type_system;
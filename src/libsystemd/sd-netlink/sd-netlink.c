@@ -276,8 +276,11 @@ static int dispatch_rqueue(sd_netlink *rtnl, sd_netlink_message **message) {
         if (rtnl->rqueue_size <= 0) {
                 /* Try to read a new message */
                 r = socket_read_message(rtnl);
-                if (r == -ENOBUFS) { /* FIXME: ignore buffer overruns for now */
-                        log_debug_errno(r, "Got ENOBUFS from netlink socket, ignoring.");
+                if (r == -ENOBUFS) {
+                        /* Either the kernel or our read queue dropped messages. There is no way to
+                         * tell which ones, hence let the owner resynchronize its state. */
+                        log_debug_errno(r, "Got ENOBUFS from netlink socket, messages were lost.");
+                        rtnl->overflowed = true;
                         return 1;
                 }
                 if (r <= 0)
@@ -382,6 +385,26 @@ static int process_match(sd_netlink *rtnl, sd_netlink_message *m) {
         return 1;
 }
 
+static int process_overflow(sd_netlink *rtnl) {
+        int r;
+
+        assert(rtnl);
+
+        if (!rtnl->overflowed)
+                return 0;
+
+        rtnl->overflowed = false;
+
+        if (!rtnl->overflow_callback)
+                return 0;
+
+        r = rtnl->overflow_callback(rtnl, rtnl->overflow_userdata);
+        if (r < 0)
+                log_debug_errno(r, "sd-netlink: overflow callback failed: %m");
+
+        return 1;
+}
+
 static int process_running(sd_netlink *rtnl, sd_netlink_message **ret) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
         int r;
@@ -392,6 +415,10 @@ static int process_running(sd_netlink *rtnl, sd_netlink_message **ret) {
         if (r != 0)
                 goto null_message;
 
+        r = process_overflow(rtnl);
+        if (r != 0)
+                goto null_message;
+
         r = dispatch_rqueue(rtnl, &m);
         if (r < 0)
                 return r;
@@ -723,13 +750,23 @@ int sd_netlink_get_timeout(sd_netlink *rtnl, uint64_t *timeout_usec) {
 
 static int io_callback(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         sd_netlink *rtnl = userdata;
+        unsigned i;
         int r;
 
         assert(rtnl);
 
-        r = sd_netlink_process(rtnl, NULL);
-        if (r < 0)
-                return r;
+        NETLINK_DONT_DESTROY(rtnl);
+
+        /* When many requests are in flight, e.g. while configuring lots of links, the replies arrive
+         * in bulk. Dispatch a bunch of them per wakeup instead of going through the event loop (and
+         * its post sources) for each single one. */
+        for (i = 0; i < RTNL_PROCESS_BATCH_MAX; i++) {
+                r = sd_netlink_process(rtnl, NULL);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+        }
 
         return 1;
 }
@@ -969,3 +1006,13 @@ int sd_netlink_remove_match(sd_netlink *rtnl,
 
         return 0;
 }
+
+int sd_netlink_set_overflow_handler(sd_netlink *rtnl, sd_netlink_overflow_handler_t callback, void *userdata) {
+        assert_return(rtnl, -EINVAL);
+        assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+
+        rtnl->overflow_callback = callback;
+        rtnl->overflow_userdata = userdata;
+
+        return 0;
+}
@@ -22,12 +22,14 @@
 
 #include "sd-netlink.h"
 
+#include "env-util.h"
 #include "ether-addr-util.h"
 #include "macro.h"
 #include "missing.h"
 #include "netlink-util.h"
 #include "socket-util.h"
 #include "string-util.h"
+#include "time-util.h"
 #include "util.h"
 
 static void test_message_link_bridge(sd_netlink *rtnl) {
@@ -368,6 +370,51 @@ static void test_get_addresses(sd_netlink *rtnl) {
         }
 }
 
+static void test_dump_throughput(sd_netlink *rtnl) {
+        char ts[FORMAT_TIMESPAN_MAX];
+        unsigned i, n_messages = 0;
+        usec_t t;
+        int r;
+
+        /* Not a real benchmark, but gives an idea how long processing dumps takes per message. It takes
+         * a while on machines with many routes, hence only do it when asked for slow tests. */
+
+        r = getenv_bool("SYSTEMD_SLOW_TESTS");
+        if (!(r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT)) {
+                log_info("Skipping route dump throughput test, set $SYSTEMD_SLOW_TESTS=1 to run it.");
+                return;
+        }
+
+        t = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < 100; i++) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL, *reply = NULL;
+                sd_netlink_message *m;
+
+                assert_se(sd_rtnl_message_new_route(rtnl, &req, RTM_GETROUTE, AF_UNSPEC, 0) >= 0);
+                assert_se(sd_netlink_message_request_dump(req, true) >= 0);
+                assert_se(sd_netlink_call(rtnl, req, 0, &reply) >= 0);
+
+                for (m = reply; m; m = sd_netlink_message_next(m)) {
+                        uint32_t ifindex;
+                        uint16_t type;
+
+                        assert_se(sd_netlink_message_get_type(m, &type) >= 0);
+                        assert_se(type == RTM_NEWROUTE);
+
+                        (void) sd_netlink_message_read_u32(m, RTA_OIF, &ifindex);
+
+                        n_messages++;
+                }
+        }
+
+        t = now(CLOCK_MONOTONIC) - t;
+
+        log_info("route dumps: %u messages in %s, %.1fus/message",
+                 n_messages, format_timespan(ts, sizeof(ts), t, USEC_PER_MSEC),
+                 n_messages > 0 ? (double) t / n_messages : 0.0);
+}
+
 static void test_message(void) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
 
@@ -409,6 +456,8 @@ int main(void) {
 
         test_get_addresses(rtnl);
 
+        test_dump_throughput(rtnl);
+
         test_message_link_bridge(rtnl);
 
         assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, if_loopback) >= 0);
@@ -33,6 +33,7 @@
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "hashmap.h"
 #include "io-util.h"
 #include "list.h"
 #include "missing.h"
@@ -40,10 +41,14 @@
 #include "util.h"
 
 #define WORKERS_MIN 1U
-#define WORKERS_MAX 16U
-#define QUERIES_MAX 256U
+#define WORKERS_MAX 64U
+#define QUERIES_MAX 65536U
 #define BUFSIZE 10240U
 
+/* How much room to ask for in the sockets between the main thread and the workers. Requests that don't fit anymore
+ * are queued up in memory, see send_request(). */
+#define QUEUE_BUFFER_SIZE (256U * BUFSIZE)
+
 typedef enum {
         REQUEST_ADDRINFO,
         RESPONSE_ADDRINFO,
@@ -73,7 +78,7 @@ struct sd_resolve {
         unsigned n_valid_workers;
 
         unsigned current_id;
-        sd_resolve_query* query_array[QUERIES_MAX];
+        Hashmap *query_table;
         unsigned n_queries, n_done, n_outstanding;
 
         sd_event_source *event_source;
@@ -85,6 +90,10 @@ struct sd_resolve {
         pid_t tid;
 
         LIST_HEAD(sd_resolve_query, queries);
+
+        /* Requests that didn't fit into the request socket yet, oldest first */
+        LIST_HEAD(sd_resolve_query, pending);
+        sd_resolve_query *pending_tail;
 };
 
 struct sd_resolve_query {
@@ -110,7 +119,12 @@ struct sd_resolve_query {
 
         void *userdata;
 
+        /* The serialized request, while the query is in the pending list */
+        void *request;
+        size_t request_size;
+
         LIST_FIELDS(sd_resolve_query, queries);
+        LIST_FIELDS(sd_resolve_query, pending);
 };
 
 typedef struct RHeader {
@@ -490,10 +504,10 @@ _public_ int sd_resolve_new(sd_resolve **ret) {
                 goto fail;
         }
 
-        fd_inc_sndbuf(resolve->fds[REQUEST_SEND_FD], QUERIES_MAX * BUFSIZE);
-        fd_inc_rcvbuf(resolve->fds[REQUEST_RECV_FD], QUERIES_MAX * BUFSIZE);
-        fd_inc_sndbuf(resolve->fds[RESPONSE_SEND_FD], QUERIES_MAX * BUFSIZE);
-        fd_inc_rcvbuf(resolve->fds[RESPONSE_RECV_FD], QUERIES_MAX * BUFSIZE);
+        fd_inc_sndbuf(resolve->fds[REQUEST_SEND_FD], QUEUE_BUFFER_SIZE);
+        fd_inc_rcvbuf(resolve->fds[REQUEST_RECV_FD], QUEUE_BUFFER_SIZE);
+        fd_inc_sndbuf(resolve->fds[RESPONSE_SEND_FD], QUEUE_BUFFER_SIZE);
+        fd_inc_rcvbuf(resolve->fds[RESPONSE_RECV_FD], QUEUE_BUFFER_SIZE);
 
         fd_nonblock(resolve->fds[RESPONSE_RECV_FD], true);
 
@@ -586,6 +600,7 @@ static void resolve_free(sd_resolve *resolve) {
 
         /* Close all communication channels */
         close_many(resolve->fds, _FD_MAX);
+        hashmap_free(resolve->query_table);
         free(resolve);
 }
 
@@ -636,16 +651,76 @@ _public_ int sd_resolve_get_timeout(sd_resolve *resolve, uint64_t *usec) {
 }
 
 static sd_resolve_query *lookup_query(sd_resolve *resolve, unsigned id) {
+        assert(resolve);
+
+        return hashmap_get(resolve->query_table, UINT_TO_PTR(id));
+}
+
+static void pending_remove(sd_resolve *resolve, sd_resolve_query *q) {
+        assert(resolve);
+        assert(q);
+        assert(q->request);
+
+        if (resolve->pending_tail == q)
+                resolve->pending_tail = q->pending_prev;
+
+        LIST_REMOVE(pending, resolve->pending, q);
+
+        q->request = mfree(q->request);
+        q->request_size = 0;
+}
+
+static int send_request(sd_resolve *resolve, sd_resolve_query *q, const struct msghdr *mh) {
+        size_t i, l = 0;
+        uint8_t *b;
+
+        assert(resolve);
+        assert(q);
+        assert(mh);
+
+        /* Never block on the request socket: when it is full, all workers are busy, and they might be waiting for
+         * us to read their responses. Instead, keep the request around and send it once a worker picked up a
+         * previous one. As long as older requests are still waiting, queue new ones up behind them. */
+
+        if (!resolve->pending) {
+                if (sendmsg(resolve->fds[REQUEST_SEND_FD], mh, MSG_NOSIGNAL|MSG_DONTWAIT) >= 0)
+                        return 0;
+
+                if (errno != EAGAIN)
+                        return -errno;
+        }
+
+        for (i = 0; i < mh->msg_iovlen; i++)
+                l += mh->msg_iov[i].iov_len;
+
+        q->request = b = malloc(l);
+        if (!q->request)
+                return -ENOMEM;
+
+        for (i = 0; i < mh->msg_iovlen; i++)
+                b = mempcpy(b, mh->msg_iov[i].iov_base, mh->msg_iov[i].iov_len);
+
+        q->request_size = l;
+
+        LIST_INSERT_AFTER(pending, resolve->pending, resolve->pending_tail, q);
+        resolve->pending_tail = q;
+
+        return 0;
+}
+
+static int flush_pending(sd_resolve *resolve) {
         sd_resolve_query *q;
 
         assert(resolve);
 
-        q = resolve->query_array[id % QUERIES_MAX];
-        if (q)
-                if (q->id == id)
-                        return q;
+        while ((q = resolve->pending)) {
+                if (send(resolve->fds[REQUEST_SEND_FD], q->request, q->request_size, MSG_NOSIGNAL|MSG_DONTWAIT) < 0)
+                        return errno == EAGAIN ? 0 : -errno;
 
-        return NULL;
+                pending_remove(resolve, q);
+        }
+
+        return 0;
 }
 
 static int complete_query(sd_resolve *resolve, sd_resolve_query *q) {
@@ -871,6 +946,11 @@ _public_ int sd_resolve_process(sd_resolve *resolve) {
         if (r < 0)
                 return r;
 
+        /* A worker picked up a request, hence there's room for the pending ones now */
+        r = flush_pending(resolve);
+        if (r < 0)
+                return r;
+
         return 1;
 }
 
@@ -903,14 +983,20 @@ static int alloc_query(sd_resolve *resolve, bool floating, sd_resolve_query **_q
         if (resolve->n_queries >= QUERIES_MAX)
                 return -ENOBUFS;
 
+        r = hashmap_ensure_allocated(&resolve->query_table, NULL);
+        if (r < 0)
+                return r;
+
         r = start_threads(resolve, 1);
         if (r < 0)
                 return r;
 
-        while (resolve->query_array[resolve->current_id % QUERIES_MAX])
+        /* Skip 0 when the IDs wrap around, it can't be used as hashmap key */
+        while (resolve->current_id == 0 ||
+               hashmap_contains(resolve->query_table, UINT_TO_PTR(resolve->current_id)))
                 resolve->current_id++;
 
-        q = resolve->query_array[resolve->current_id % QUERIES_MAX] = new0(sd_resolve_query, 1);
+        q = new0(sd_resolve_query, 1);
         if (!q)
                 return -ENOMEM;
 
@@ -919,6 +1005,12 @@ static int alloc_query(sd_resolve *resolve, bool floating, sd_resolve_query **_q
         q->floating = floating;
         q->id = resolve->current_id++;
 
+        r = hashmap_put(resolve->query_table, UINT_TO_PTR(q->id), q);
+        if (r < 0) {
+                free(q);
+                return r;
+        }
+
         if (!floating)
                 sd_resolve_ref(resolve);
 
@@ -977,9 +1069,10 @@ _public_ int sd_resolve_getaddrinfo(
                 iov[mh.msg_iovlen++] = (struct iovec) { .iov_base = (void*) service, .iov_len = req.service_len };
         mh.msg_iov = iov;
 
-        if (sendmsg(resolve->fds[REQUEST_SEND_FD], &mh, MSG_NOSIGNAL) < 0) {
+        r = send_request(resolve, q, &mh);
+        if (r < 0) {
                 sd_resolve_query_unref(q);
-                return -errno;
+                return r;
         }
 
         resolve->n_outstanding++;
@@ -1047,9 +1140,10 @@ _public_ int sd_resolve_getnameinfo(
         mh.msg_iov = iov;
         mh.msg_iovlen = 2;
 
-        if (sendmsg(resolve->fds[REQUEST_SEND_FD], &mh, MSG_NOSIGNAL) < 0) {
+        r = send_request(resolve, q, &mh);
+        if (r < 0) {
                 sd_resolve_query_unref(q);
-                return -errno;
+                return r;
         }
 
         resolve->n_outstanding++;
@@ -1094,7 +1188,6 @@ static void resolve_freeaddrinfo(struct addrinfo *ai) {
 
 static void resolve_query_disconnect(sd_resolve_query *q) {
         sd_resolve *resolve;
-        unsigned i;
 
         assert(q);
 
@@ -1109,9 +1202,15 @@ static void resolve_query_disconnect(sd_resolve_query *q) {
                 resolve->n_done--;
         }
 
-        i = q->id % QUERIES_MAX;
-        assert(resolve->query_array[i] == q);
-        resolve->query_array[i] = NULL;
+        /* A query that was never handed to a worker is cancelled entirely, as no response will come back for it */
+        if (q->request) {
+                pending_remove(resolve, q);
+
+                assert(resolve->n_outstanding > 0);
+                resolve->n_outstanding--;
+        }
+
+        assert_se(hashmap_remove(resolve->query_table, UINT_TO_PTR(q->id)) == q);
         LIST_REMOVE(queries, resolve->queries, q);
         resolve->n_queries--;
 
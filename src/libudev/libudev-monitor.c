@@ -290,6 +290,17 @@ static inline void bpf_jmp(struct sock_filter *inss, unsigned int *i,
  *
  * Returns: 0 on success, otherwise a negative error value.
  */
+static bool subsystem_match_without_devtype(struct udev_monitor *udev_monitor, const char *subsystem) {
+        struct udev_list_entry *list_entry;
+
+        udev_list_entry_foreach(list_entry, udev_list_get_entry(&udev_monitor->filter_subsystem_list))
+                if (udev_list_entry_get_value(list_entry) == NULL &&
+                    streq(udev_list_entry_get_name(list_entry), subsystem))
+                        return true;
+
+        return false;
+}
+
 _public_ int udev_monitor_filter_update(struct udev_monitor *udev_monitor)
 {
         struct sock_filter ins[512];
@@ -320,6 +331,10 @@ _public_ int udev_monitor_filter_update(struct udev_monitor *udev_monitor)
                 udev_list_entry_foreach(list_entry, udev_list_get_entry(&udev_monitor->filter_tag_list))
                         tag_matches++;
 
+                /* the jump behind the block must fit into the 8 bit offset of the first match */
+                if (1 + (tag_matches - 1) * 6 > UINT8_MAX)
+                        return -E2BIG;
+
                 /* add all tags matches */
                 udev_list_entry_foreach(list_entry, udev_list_get_entry(&udev_monitor->filter_tag_list)) {
                         uint64_t tag_bloom_bits = util_string_bloom64(udev_list_entry_get_name(list_entry));
@@ -348,30 +363,41 @@ _public_ int udev_monitor_filter_update(struct udev_monitor *udev_monitor)
 
         /* add all subsystem matches */
         if (udev_list_get_entry(&udev_monitor->filter_subsystem_list) != NULL) {
+                /* load device subsystem value in A, it is only replaced while looking at a devtype */
+                bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(struct udev_monitor_netlink_header, filter_subsystem_hash));
+
                 udev_list_entry_foreach(list_entry, udev_list_get_entry(&udev_monitor->filter_subsystem_list)) {
-                        unsigned int hash = util_string_hash32(udev_list_entry_get_name(list_entry));
+                        const char *subsystem = udev_list_entry_get_name(list_entry);
+                        const char *devtype = udev_list_entry_get_value(list_entry);
+                        unsigned int hash = util_string_hash32(subsystem);
+
+                        if (i + 6 >= ELEMENTSOF(ins))
+                                return -E2BIG;
 
-                        /* load device subsystem value in A */
-                        bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(struct udev_monitor_netlink_header, filter_subsystem_hash));
-                        if (udev_list_entry_get_value(list_entry) == NULL) {
+                        if (devtype == NULL) {
                                 /* jump if subsystem does not match */
                                 bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 1);
                         } else {
+                                /* a match on the subsystem alone covers all its devtypes */
+                                if (subsystem_match_without_devtype(udev_monitor, subsystem))
+                                        continue;
+
                                 /* jump if subsystem does not match */
-                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 3);
+                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 4);
 
                                 /* load device devtype value in A */
                                 bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(struct udev_monitor_netlink_header, filter_devtype_hash));
                                 /* jump if value does not match */
-                                hash = util_string_hash32(udev_list_entry_get_value(list_entry));
+                                hash = util_string_hash32(devtype);
                                 bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 1);
                         }
 
                         /* matched, pass packet */
                         bpf_stmt(ins, &i, BPF_RET|BPF_K, 0xffffffff);
 
-                        if (i+1 >= ELEMENTSOF(ins))
-                                return -E2BIG;
+                        /* load device subsystem value in A again */
+                        if (devtype != NULL)
+                                bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(struct udev_monitor_netlink_header, filter_subsystem_hash));
                 }
 
                 /* nothing matched, drop packet */
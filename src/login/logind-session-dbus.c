@@ -456,7 +456,7 @@ static int method_take_device(sd_bus_message *message, void *userdata, sd_bus_er
         if (r < 0)
                 goto error;
 
-        session_save(s);
+        session_add_to_save_queue(s);
         return 1;
 
 error:
@@ -487,7 +487,7 @@ static int method_release_device(sd_bus_message *message, void *userdata, sd_bus
                 return sd_bus_error_setf(error, BUS_ERROR_DEVICE_NOT_TAKEN, "Device not taken");
 
         session_device_free(sd);
-        session_save(s);
+        session_add_to_save_queue(s);
 
         return sd_bus_reply_method_return(message, NULL);
 }
@@ -759,12 +759,15 @@ int session_send_create_reply(Session *s, sd_bus_error *error) {
 
         /* This is called after the session scope and the user service
          * were successfully created, and finishes where
-         * bus_manager_create_session() left off. */
+         * bus_manager_create_session() left off. Light background
+         * sessions don't wait for the user service, it is started
+         * nonetheless, or simply reused if it is already running. */
 
         if (!s->create_message)
                 return 0;
 
-        if (!sd_bus_error_is_set(error) && (s->scope_job || s->user->service_job))
+        if (!sd_bus_error_is_set(error) &&
+            (s->scope_job || (s->user->service_job && s->class != SESSION_BACKGROUND_LIGHT)))
                 return 0;
 
         c = s->create_message;
@@ -777,9 +780,11 @@ int session_send_create_reply(Session *s, sd_bus_error *error) {
         if (fifo_fd < 0)
                 return fifo_fd;
 
-        /* Update the session state file before we notify the client
-         * about the result. */
+        /* Update the session state file (and the user's, if it is
+         * outdated) before we notify the client about the result. */
         session_save(s);
+        if (s->user->in_save_queue)
+                user_save(s->user);
 
         p = session_bus_path(s);
         if (!p)
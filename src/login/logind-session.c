@@ -49,6 +49,9 @@
 
 #define RELEASE_USEC (20*USEC_PER_SEC)
 
+/* The kernel only updates the atime of a TTY if it is more than 8s off, so a little staleness doesn't matter */
+#define TTY_ATIME_CACHE_USEC (5*USEC_PER_SEC)
+
 static void session_remove_fifo(Session *s);
 
 Session* session_new(Manager *m, const char *id) {
@@ -88,6 +91,16 @@ Session* session_new(Manager *m, const char *id) {
         return s;
 }
 
+static void session_remove_from_save_queue(Session *s) {
+        assert(s);
+
+        if (!s->in_save_queue)
+                return;
+
+        LIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+        s->in_save_queue = false;
+}
+
 void session_free(Session *s) {
         SessionDevice *sd;
 
@@ -96,6 +109,8 @@ void session_free(Session *s) {
         if (s->in_gc_queue)
                 LIST_REMOVE(gc_queue, s->manager->session_gc_queue, s);
 
+        session_remove_from_save_queue(s);
+
         s->timer_event_source = sd_event_source_unref(s->timer_event_source);
 
         session_remove_fifo(s);
@@ -173,6 +188,9 @@ int session_save(Session *s) {
 
         assert(s);
 
+        /* Whatever was queued is written out now */
+        session_remove_from_save_queue(s);
+
         if (!s->user)
                 return -ESTALE;
 
@@ -623,7 +641,7 @@ int session_start(Session *s) {
         if (r < 0)
                 return r;
 
-        log_struct(s->class == SESSION_BACKGROUND ? LOG_DEBUG : LOG_INFO,
+        log_struct(SESSION_CLASS_IS_BACKGROUND(s->class) ? LOG_DEBUG : LOG_INFO,
                    "MESSAGE_ID=" SD_MESSAGE_SESSION_START_STR,
                    "SESSION_ID=%s", s->id,
                    "USER_ID=%s", s->user->name,
@@ -642,8 +660,8 @@ int session_start(Session *s) {
         user_elect_display(s->user);
 
         /* Save data */
-        session_save(s);
-        user_save(s->user);
+        session_add_to_save_queue(s);
+        user_add_to_save_queue(s->user);
         if (s->seat)
                 seat_save(s->seat);
 
@@ -713,8 +731,8 @@ int session_stop(Session *s, bool force) {
 
         user_elect_display(s->user);
 
-        session_save(s);
-        user_save(s->user);
+        session_add_to_save_queue(s);
+        user_add_to_save_queue(s->user);
 
         return r;
 }
@@ -728,7 +746,7 @@ int session_finalize(Session *s) {
                 return -ESTALE;
 
         if (s->started)
-                log_struct(s->class == SESSION_BACKGROUND ? LOG_DEBUG : LOG_INFO,
+                log_struct(SESSION_CLASS_IS_BACKGROUND(s->class) ? LOG_DEBUG : LOG_INFO,
                            "MESSAGE_ID=" SD_MESSAGE_SESSION_STOP_STR,
                            "SESSION_ID=%s", s->id,
                            "USER_ID=%s", s->user->name,
@@ -746,6 +764,7 @@ int session_finalize(Session *s) {
                 session_device_free(sd);
 
         (void) unlink(s->state_file);
+        session_remove_from_save_queue(s);
         session_add_to_gc_queue(s);
         user_add_to_gc_queue(s->user);
 
@@ -761,7 +780,7 @@ int session_finalize(Session *s) {
                 seat_save(s->seat);
         }
 
-        user_save(s->user);
+        user_add_to_save_queue(s->user);
         user_send_changed(s->user, "Display", NULL);
 
         return 0;
@@ -839,6 +858,42 @@ static int get_process_ctty_atime(pid_t pid, usec_t *atime) {
         return get_tty_atime(p, atime);
 }
 
+static int session_get_tty_atime(Session *s, usec_t *atime) {
+        usec_t n;
+        int r = -ENXIO;
+
+        assert(s);
+        assert(atime);
+
+        /* The idle hints of users, seats and the manager are all derived from their sessions' one, hence
+         * don't stat() the TTY again each time they are queried, but cache the result for a short while. */
+
+        n = now(CLOCK_MONOTONIC);
+        if (n < s->tty_atime_until) {
+                if (s->tty_atime_error < 0)
+                        return s->tty_atime_error;
+
+                *atime = s->tty_atime;
+                return 0;
+        }
+
+        /* For sessions with an explicitly configured tty, let's check
+         * its atime */
+        if (s->tty)
+                r = get_tty_atime(s->tty, atime);
+
+        /* For sessions with a leader but no explicitly configured
+         * tty, let's check the controlling tty of the leader */
+        if ((!s->tty || r < 0) && s->leader > 0)
+                r = get_process_ctty_atime(s->leader, atime);
+
+        s->tty_atime = r >= 0 ? *atime : 0;
+        s->tty_atime_error = r < 0 ? r : 0;
+        s->tty_atime_until = usec_add(n, TTY_ATIME_CACHE_USEC);
+
+        return r;
+}
+
 int session_get_idle_hint(Session *s, dual_timestamp *t) {
         usec_t atime = 0, n;
         int r;
@@ -858,18 +913,8 @@ int session_get_idle_hint(Session *s, dual_timestamp *t) {
         if (SESSION_TYPE_IS_GRAPHICAL(s->type))
                 goto dont_know;
 
-        /* For sessions with an explicitly configured tty, let's check
-         * its atime */
-        if (s->tty) {
-                r = get_tty_atime(s->tty, &atime);
-                if (r >= 0)
-                        goto found_atime;
-        }
-
-        /* For sessions with a leader but no explicitly configured
-         * tty, let's check the controlling tty of the leader */
-        if (s->leader > 0) {
-                r = get_process_ctty_atime(s->leader, &atime);
+        if (s->tty || s->leader > 0) {
+                r = session_get_tty_atime(s, &atime);
                 if (r >= 0)
                         goto found_atime;
         }
@@ -1032,6 +1077,19 @@ void session_add_to_gc_queue(Session *s) {
         s->in_gc_queue = true;
 }
 
+void session_add_to_save_queue(Session *s) {
+        assert(s);
+
+        /* Rather than rewriting the state file on every change, we note that it is out of date, and write it once
+         * before going back to the event loop */
+
+        if (s->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, s->manager->session_save_queue, s);
+        s->in_save_queue = true;
+}
+
 SessionState session_get_state(Session *s) {
         assert(s);
 
@@ -1273,7 +1331,7 @@ int session_set_controller(Session *s, const char *sender, bool force, bool prep
         session_release_controller(s, true);
         s->controller = name;
         name = NULL;
-        session_save(s);
+        session_add_to_save_queue(s);
 
         return 0;
 }
@@ -1286,7 +1344,7 @@ void session_drop_controller(Session *s) {
 
         s->track = sd_bus_track_unref(s->track);
         session_release_controller(s, false);
-        session_save(s);
+        session_add_to_save_queue(s);
         session_restore_vt(s);
 }
 
@@ -1314,7 +1372,8 @@ static const char* const session_class_table[_SESSION_CLASS_MAX] = {
         [SESSION_USER] = "user",
         [SESSION_GREETER] = "greeter",
         [SESSION_LOCK_SCREEN] = "lock-screen",
-        [SESSION_BACKGROUND] = "background"
+        [SESSION_BACKGROUND] = "background",
+        [SESSION_BACKGROUND_LIGHT] = "background-light",
 };
 
 DEFINE_STRING_TABLE_LOOKUP(session_class, SessionClass);
@@ -40,10 +40,13 @@ typedef enum SessionClass {
         SESSION_GREETER,
         SESSION_LOCK_SCREEN,
         SESSION_BACKGROUND,
+        SESSION_BACKGROUND_LIGHT, /* like SESSION_BACKGROUND, but doesn't wait for the user's service manager */
         _SESSION_CLASS_MAX,
         _SESSION_CLASS_INVALID = -1
 } SessionClass;
 
+#define SESSION_CLASS_IS_BACKGROUND(class) IN_SET(class, SESSION_BACKGROUND, SESSION_BACKGROUND_LIGHT)
+
 typedef enum SessionType {
         SESSION_UNSPECIFIED,
         SESSION_TTY,
@@ -105,9 +108,15 @@ struct Session {
         bool idle_hint;
         dual_timestamp idle_hint_timestamp;
 
+        /* The last atime of the session's TTY we looked up, or the error we got, and until when to reuse it */
+        usec_t tty_atime;
+        int tty_atime_error;
+        usec_t tty_atime_until;
+
         bool locked_hint;
 
         bool in_gc_queue:1;
+        bool in_save_queue:1;
         bool started:1;
         bool stopping:1;
 
@@ -125,6 +134,7 @@ struct Session {
         LIST_FIELDS(Session, sessions_by_seat);
 
         LIST_FIELDS(Session, gc_queue);
+        LIST_FIELDS(Session, save_queue);
 };
 
 Session *session_new(Manager *m, const char *id);
@@ -132,6 +142,7 @@ void session_free(Session *s);
 void session_set_user(Session *s, User *u);
 bool session_check_gc(Session *s, bool drop_not_started);
 void session_add_to_gc_queue(Session *s);
+void session_add_to_save_queue(Session *s);
 int session_activate(Session *s);
 bool session_is_active(Session *s);
 int session_get_idle_hint(Session *s, dual_timestamp *t);
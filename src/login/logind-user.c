@@ -103,6 +103,16 @@ int user_new(User **out, Manager *m, uid_t uid, gid_t gid, const char *name) {
         return 0;
 }
 
+static void user_remove_from_save_queue(User *u) {
+        assert(u);
+
+        if (!u->in_save_queue)
+                return;
+
+        LIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+        u->in_save_queue = false;
+}
+
 User *user_free(User *u) {
         if (!u)
                 return NULL;
@@ -110,6 +120,8 @@ User *user_free(User *u) {
         if (u->in_gc_queue)
                 LIST_REMOVE(gc_queue, u->manager->user_gc_queue, u);
 
+        user_remove_from_save_queue(u);
+
         while (u->sessions)
                 session_free(u->sessions);
 
@@ -288,6 +300,9 @@ fail:
 int user_save(User *u) {
         assert(u);
 
+        /* Whatever was queued is written out now */
+        user_remove_from_save_queue(u);
+
         if (!u->started)
                 return 0;
 
@@ -491,7 +506,7 @@ int user_start(User *u) {
         }
 
         /* Save new user data */
-        user_save(u);
+        user_add_to_save_queue(u);
 
         return 0;
 }
@@ -564,7 +579,7 @@ int user_stop(User *u, bool force) {
 
         /* Stop jobs have already been queued */
         if (u->stopping) {
-                user_save(u);
+                user_add_to_save_queue(u);
                 return r;
         }
 
@@ -586,7 +601,7 @@ int user_stop(User *u, bool force) {
 
         u->stopping = true;
 
-        user_save(u);
+        user_add_to_save_queue(u);
 
         return r;
 }
@@ -624,6 +639,7 @@ int user_finalize(User *u) {
         }
 
         unlink(u->state_file);
+        user_remove_from_save_queue(u);
         user_add_to_gc_queue(u);
 
         if (u->started) {
@@ -714,6 +730,16 @@ void user_add_to_gc_queue(User *u) {
         u->in_gc_queue = true;
 }
 
+void user_add_to_save_queue(User *u) {
+        assert(u);
+
+        if (u->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, u->manager->user_save_queue, u);
+        u->in_save_queue = true;
+}
+
 UserState user_get_state(User *u) {
         Session *i;
 
@@ -118,6 +118,21 @@ fail:
         return NULL;
 }
 
+static void manager_save_queued(Manager *m) {
+        Session *session;
+        User *user;
+
+        assert(m);
+
+        /* Saving removes the objects from the queues */
+
+        while ((session = m->session_save_queue))
+                (void) session_save(session);
+
+        while ((user = m->user_save_queue))
+                (void) user_save(user);
+}
+
 static void manager_free(Manager *m) {
         Session *session;
         User *u;
@@ -129,6 +144,8 @@ static void manager_free(Manager *m) {
         if (!m)
                 return;
 
+        manager_save_queued(m);
+
         while ((session = hashmap_first(m->sessions)))
                 session_free(session);
 
@@ -1196,6 +1213,9 @@ static int manager_run(Manager *m) {
 
                 manager_gc(m, true);
 
+                /* Write out all state files that changed in this iteration, each once */
+                manager_save_queued(m);
+
                 r = manager_dispatch_delayed(m, false);
                 if (r < 0)
                         return r;
@@ -51,6 +51,10 @@ struct Manager {
         LIST_HEAD(Session, session_gc_queue);
         LIST_HEAD(User, user_gc_queue);
 
+        /* Sessions and users whose state files need to be written out before we go back to sleep */
+        LIST_HEAD(Session, session_save_queue);
+        LIST_HEAD(User, user_save_queue);
+
         struct udev *udev;
         struct udev_monitor *udev_seat_monitor, *udev_device_monitor, *udev_vcsa_monitor, *udev_button_monitor;
 
@@ -327,14 +327,16 @@ _public_ PAM_EXTERN int pam_sm_open_session(
                  * long time and it probably shouldn't stop doing that
                  * for compatibility reasons. */
                 type = "unspecified";
-                class = "background";
+                if (isempty(class))
+                        class = "background";
                 tty = NULL;
         } else if (streq(tty, "ssh")) {
                 /* ssh has been setting PAM_TTY to "ssh" for a very
                  * long time and probably shouldn't stop doing that
                  * for compatibility reasons. */
                 type ="tty";
-                class = "user";
+                if (isempty(class))
+                        class = "user";
                 tty = NULL;
         } else
                 /* Chop off leading /dev prefix that some clients specify, but others do not. */
@@ -17,7 +17,9 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/epoll.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
 #include <sys/mount.h>
 
 #include "alloc-util.h"
@@ -38,6 +40,10 @@
 #include "strv.h"
 #include "user-util.h"
 
+/* Changes to image usage and limits are not reported via inotify, hence let's not cache discovery results for
+ * too long */
+#define IMAGE_DISCOVERY_CACHE_USEC (5 * USEC_PER_SEC)
+
 static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_type, image_type, ImageType);
 
 int bus_image_method_remove(
@@ -140,6 +146,8 @@ int bus_image_method_rename(
         if (r < 0)
                 return r;
 
+        manager_flush_image_discovery(m);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -247,6 +255,8 @@ int bus_image_method_mark_read_only(
         if (r < 0)
                 return r;
 
+        manager_flush_image_discovery(m);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -286,6 +296,8 @@ int bus_image_method_set_limit(
         if (r < 0)
                 return r;
 
+        manager_flush_image_discovery(m);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -550,8 +562,9 @@ char *image_bus_path(const char *name) {
 }
 
 int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
-        _cleanup_(image_hashmap_freep) Hashmap *images = NULL;
         _cleanup_strv_free_ char **l = NULL;
+        Manager *m = userdata;
+        Hashmap *images;
         Image *image;
         Iterator i;
         int r;
@@ -559,12 +572,9 @@ int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char **
         assert(bus);
         assert(path);
         assert(nodes);
+        assert(m);
 
-        images = hashmap_new(&string_hash_ops);
-        if (!images)
-                return -ENOMEM;
-
-        r = image_discover(images);
+        r = manager_discover_images(m, &images);
         if (r < 0)
                 return r;
 
@@ -585,3 +595,97 @@ int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char **
 
         return 1;
 }
+
+void manager_flush_image_discovery(Manager *m) {
+        assert(m);
+
+        image_hashmap_free(m->image_discovery);
+        m->image_discovery = NULL;
+
+        m->image_watch_event_source = sd_event_source_unref(m->image_watch_event_source);
+        m->image_watch_fd = safe_close(m->image_watch_fd);
+}
+
+static int image_watch_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        /* Something changed in one of the image directories. We don't bother with figuring out what exactly,
+         * but simply forget everything, and discover from scratch on the next request. This also drops the
+         * watches, they are set up again then. */
+        manager_flush_image_discovery(m);
+
+        return 0;
+}
+
+static int manager_watch_images(Manager *m) {
+        int r;
+
+        assert(m);
+        assert(m->image_watch_fd < 0);
+
+        m->image_watch_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        if (m->image_watch_fd < 0)
+                return -errno;
+
+        r = image_discover_watch(m->image_watch_fd);
+        if (r < 0)
+                goto fail;
+
+        r = sd_event_add_io(m->event, &m->image_watch_event_source, m->image_watch_fd, EPOLLIN, image_watch_handler, m);
+        if (r < 0)
+                goto fail;
+
+        (void) sd_event_source_set_description(m->image_watch_event_source, "image-watch");
+
+        return 0;
+
+fail:
+        m->image_watch_fd = safe_close(m->image_watch_fd);
+        return r;
+}
+
+int manager_discover_images(Manager *m, Hashmap **ret) {
+        _cleanup_(image_hashmap_freep) Hashmap *images = NULL;
+        usec_t n;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        /* Returns the currently known images. The returned hashmap remains owned by the manager, and is valid
+         * until the next iteration of the event loop at least. */
+
+        n = now(CLOCK_MONOTONIC);
+
+        if (m->image_discovery &&
+            m->image_watch_event_source &&
+            m->image_discovery_timestamp + IMAGE_DISCOVERY_CACHE_USEC > n) {
+                *ret = m->image_discovery;
+                return 0;
+        }
+
+        manager_flush_image_discovery(m);
+
+        /* Set up the watches before enumerating, so that we don't miss changes made while we are at it. If that
+         * doesn't work, we'll simply not cache anything. */
+        r = manager_watch_images(m);
+        if (r < 0)
+                log_debug_errno(r, "Failed to watch image directories, not caching images: %m");
+
+        images = hashmap_new(&string_hash_ops);
+        if (!images)
+                return -ENOMEM;
+
+        r = image_discover(images);
+        if (r < 0)
+                return r;
+
+        m->image_discovery = images;
+        m->image_discovery_timestamp = n;
+        images = NULL;
+
+        *ret = m->image_discovery;
+        return 0;
+}
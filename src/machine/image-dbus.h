@@ -28,6 +28,9 @@ char *image_bus_path(const char *name);
 int image_object_find(sd_bus *bus, const char *path, const char *interface, void *userdata, void **found, sd_bus_error *error);
 int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error);
 
+int manager_discover_images(Manager *m, Hashmap **ret);
+void manager_flush_image_discovery(Manager *m);
+
 int bus_image_method_remove(sd_bus_message *message, void *userdata, sd_bus_error *error);
 int bus_image_method_rename(sd_bus_message *message, void *userdata, sd_bus_error *error);
 int bus_image_method_clone(sd_bus_message *message, void *userdata, sd_bus_error *error);
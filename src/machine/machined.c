@@ -48,6 +48,7 @@ Manager *manager_new(void) {
         m->machines = hashmap_new(&string_hash_ops);
         m->machine_units = hashmap_new(&string_hash_ops);
         m->machine_leaders = hashmap_new(NULL);
+        m->image_watch_fd = -1;
 
         if (!m->machines || !m->machine_units || !m->machine_leaders) {
                 manager_free(m);
@@ -90,6 +91,8 @@ void manager_free(Manager *m) {
 
         sd_event_source_unref(m->image_cache_defer_event);
 
+        manager_flush_image_discovery(m);
+
         bus_verify_polkit_async_registry_free(m->polkit_registry);
 
         sd_bus_unref(m->bus);
@@ -47,6 +47,13 @@ struct Manager {
         Hashmap *image_cache;
         sd_event_source *image_cache_defer_event;
 
+        /* The result of the last image_discover() call, kept until inotify tells us that one of the image
+         * directories changed, or until it is too old. */
+        Hashmap *image_discovery;
+        usec_t image_discovery_timestamp;
+        int image_watch_fd;
+        sd_event_source *image_watch_event_source;
+
         LIST_HEAD(Machine, machine_gc_queue);
 
         Machine *host_machine;
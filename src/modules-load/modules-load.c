@@ -22,7 +22,9 @@
 #include <libkmod.h>
 #include <limits.h>
 #include <string.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "conf-files.h"
 #include "def.h"
@@ -30,10 +32,16 @@
 #include "fileio.h"
 #include "log.h"
 #include "proc-cmdline.h"
+#include "process-util.h"
+#include "signal-util.h"
 #include "string-util.h"
 #include "strv.h"
+#include "time-util.h"
 #include "util.h"
 
+/* The maximum number of processes inserting modules at the same time */
+#define WORKERS_MAX 8U
+
 static char **arg_proc_cmdline_modules = NULL;
 
 static const char conf_file_dirs[] = CONF_PATHS_NULSTR("modules-load.d");
@@ -92,8 +100,10 @@ static int load_module(struct kmod_ctx *ctx, const char *m) {
         }
 
         kmod_list_foreach(itr, modlist) {
+                char ts[FORMAT_TIMESPAN_MAX];
                 struct kmod_module *mod;
                 int state, err;
+                usec_t n;
 
                 mod = kmod_module_get_module(itr);
                 state = kmod_module_get_initstate(mod);
@@ -108,11 +118,14 @@ static int load_module(struct kmod_ctx *ctx, const char *m) {
                         break;
 
                 default:
+                        n = now(CLOCK_MONOTONIC);
                         err = kmod_module_probe_insert_module(mod, probe_flags,
                                                               NULL, NULL, NULL, NULL);
+                        n = now(CLOCK_MONOTONIC) - n;
 
                         if (err == 0)
-                                log_info("Inserted module '%s'", kmod_module_get_name(mod));
+                                log_info("Inserted module '%s' in %s", kmod_module_get_name(mod),
+                                         format_timespan(ts, sizeof(ts), n, USEC_PER_MSEC));
                         else if (err == KMOD_PROBE_APPLY_BLACKLIST)
                                 log_info("Module '%s' is blacklisted", kmod_module_get_name(mod));
                         else {
@@ -129,12 +142,12 @@ static int load_module(struct kmod_ctx *ctx, const char *m) {
         return r;
 }
 
-static int apply_file(struct kmod_ctx *ctx, const char *path, bool ignore_enoent) {
+static int apply_file(const char *path, bool ignore_enoent, char ***modules) {
         _cleanup_fclose_ FILE *f = NULL;
         int r;
 
-        assert(ctx);
         assert(path);
+        assert(modules);
 
         r = search_and_fopen_nulstr(path, "re", NULL, conf_file_dirs, &f);
         if (r < 0) {
@@ -147,7 +160,6 @@ static int apply_file(struct kmod_ctx *ctx, const char *path, bool ignore_enoent
         log_debug("apply: %s", path);
         for (;;) {
                 char line[LINE_MAX], *l;
-                int k;
 
                 if (!fgets(line, sizeof(line), f)) {
                         if (feof(f))
@@ -162,7 +174,74 @@ static int apply_file(struct kmod_ctx *ctx, const char *path, bool ignore_enoent
                 if (strchr(COMMENTS "\n", *l))
                         continue;
 
-                k = load_module(ctx, l);
+                if (strv_extend(modules, l) < 0)
+                        return log_oom();
+        }
+
+        return 0;
+}
+
+static int load_modules_share(struct kmod_ctx *ctx, char **modules, unsigned index, unsigned n_shares) {
+        unsigned i = 0;
+        char **m;
+        int r = 0, k;
+
+        STRV_FOREACH(m, modules) {
+                if (i++ % n_shares != index)
+                        continue;
+
+                k = load_module(ctx, *m);
+                if (k < 0 && r == 0)
+                        r = k;
+        }
+
+        return r;
+}
+
+static int load_modules(struct kmod_ctx *ctx, char **modules) {
+        pid_t pids[WORKERS_MAX] = {};
+        unsigned i, n;
+        long c;
+        int r, k;
+
+        /* Initializing a module may take a while (probing hardware, loading firmware, …), and the kernel can
+         * initialize unrelated modules at the same time. Hence split the modules up between a couple of worker
+         * processes. Dependencies shared between modules in different workers are fine: the kernel lets the second
+         * insertion wait until the module is initialized and fail with EEXIST, which libkmod ignores. */
+
+        c = sysconf(_SC_NPROCESSORS_ONLN);
+        n = MIN3(c > 0 ? (unsigned) c : 1U, WORKERS_MAX, strv_length(modules));
+        if (n <= 1)
+                return load_modules_share(ctx, modules, 0, 1);
+
+        for (i = 1; i < n; i++) {
+                pids[i] = fork();
+                if (pids[i] < 0)
+                        log_warning_errno(errno, "Failed to fork worker, loading its modules ourselves: %m");
+                if (pids[i] == 0) {
+
+                        /* Child */
+
+                        (void) reset_all_signal_handlers();
+                        (void) reset_signal_mask();
+                        assert_se(prctl(PR_SET_PDEATHSIG, SIGTERM) == 0);
+
+                        r = load_modules_share(ctx, modules, i, n);
+                        _exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+                }
+        }
+
+        r = load_modules_share(ctx, modules, 0, n);
+
+        for (i = 1; i < n; i++) {
+                if (pids[i] < 0)
+                        k = load_modules_share(ctx, modules, i, n);
+                else {
+                        k = wait_for_terminate_and_warn("worker", pids[i], true);
+                        if (k > 0)
+                                k = -EPROTO; /* the worker already logged why */
+                }
+
                 if (k < 0 && r == 0)
                         r = k;
         }
@@ -217,6 +296,7 @@ static int parse_argv(int argc, char *argv[]) {
 }
 
 int main(int argc, char *argv[]) {
+        _cleanup_strv_free_ char **modules = NULL;
         int r, k;
         struct kmod_ctx *ctx;
 
@@ -249,19 +329,18 @@ int main(int argc, char *argv[]) {
                 int i;
 
                 for (i = optind; i < argc; i++) {
-                        k = apply_file(ctx, argv[i], false);
+                        k = apply_file(argv[i], false, &modules);
                         if (k < 0 && r == 0)
                                 r = k;
                 }
 
         } else {
                 _cleanup_strv_free_ char **files = NULL;
-                char **fn, **i;
+                char **fn;
 
-                STRV_FOREACH(i, arg_proc_cmdline_modules) {
-                        k = load_module(ctx, *i);
-                        if (k < 0 && r == 0)
-                                r = k;
+                if (strv_extend_strv(&modules, arg_proc_cmdline_modules, false) < 0) {
+                        r = log_oom();
+                        goto finish;
                 }
 
                 k = conf_files_list_nulstr(&files, ".conf", NULL, 0, conf_file_dirs);
@@ -273,12 +352,18 @@ int main(int argc, char *argv[]) {
                 }
 
                 STRV_FOREACH(fn, files) {
-                        k = apply_file(ctx, *fn, true);
+                        k = apply_file(*fn, true, &modules);
                         if (k < 0 && r == 0)
                                 r = k;
                 }
         }
 
+        strv_uniq(modules);
+
+        k = load_modules(ctx, modules);
+        if (k < 0 && r == 0)
+                r = k;
+
 finish:
         kmod_unref(ctx);
         strv_free(arg_proc_cmdline_modules);
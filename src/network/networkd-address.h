@@ -64,6 +64,7 @@ struct Address {
         union in_addr_union in_addr_peer;
 
         bool ip_masquerade_done:1;
+        bool marked:1; /* not seen since the start of an rtnl resync */
         bool duplicate_address_detection;
         bool manage_temporary_address;
         bool home_address;
@@ -42,6 +42,9 @@
 #include "util.h"
 #include "virt.h"
 
+/* Maximum number of static route requests to have in flight at a time */
+#define LINK_ROUTES_IN_FLIGHT_MAX 256U
+
 static bool link_dhcp6_enabled(Link *link) {
         assert(link);
 
@@ -768,6 +771,28 @@ void link_check_ready(Link *link) {
         return;
 }
 
+static int route_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata);
+
+static int link_request_static_routes(Link *link) {
+        int r;
+
+        assert(link);
+
+        /* Keep only a limited number of requests in flight, and send the next ones as the replies come in. Otherwise,
+         * with many static routes, the kernel's replies would overrun the receive buffer of our netlink socket. */
+
+        while (link->static_routes_next && link->link_messages < LINK_ROUTES_IN_FLIGHT_MAX) {
+                r = route_configure(link->static_routes_next, link, route_handler);
+                if (r < 0)
+                        return r;
+
+                link->link_messages++;
+                link->static_routes_next = link->static_routes_next->routes_next;
+        }
+
+        return 0;
+}
+
 static int route_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata) {
         _cleanup_link_unref_ Link *link = userdata;
         int r;
@@ -786,6 +811,13 @@ static int route_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata
         if (r < 0 && r != -EEXIST)
                 log_link_warning_errno(link, r, "Could not set route: %m");
 
+        r = link_request_static_routes(link);
+        if (r < 0) {
+                log_link_warning_errno(link, r, "Could not set routes: %m");
+                link_enter_failed(link);
+                return 1;
+        }
+
         if (link->link_messages == 0) {
                 log_link_debug(link, "Routes set");
                 link->static_configured = true;
@@ -796,7 +828,6 @@ static int route_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata
 }
 
 static int link_enter_set_routes(Link *link) {
-        Route *rt;
         int r;
 
         assert(link);
@@ -805,15 +836,13 @@ static int link_enter_set_routes(Link *link) {
 
         link_set_state(link, LINK_STATE_SETTING_ROUTES);
 
-        LIST_FOREACH(routes, rt, link->network->static_routes) {
-                r = route_configure(rt, link, route_handler);
-                if (r < 0) {
-                        log_link_warning_errno(link, r, "Could not set routes: %m");
-                        link_enter_failed(link);
-                        return r;
-                }
+        link->static_routes_next = link->network->static_routes;
 
-                link->link_messages++;
+        r = link_request_static_routes(link);
+        if (r < 0) {
+                log_link_warning_errno(link, r, "Could not set routes: %m");
+                link_enter_failed(link);
+                return r;
         }
 
         if (link->link_messages == 0) {
@@ -1523,15 +1552,10 @@ static int link_lldp_save(Link *link) {
                 (void) fwrite(p, 1, sz, f);
         }
 
-        r = fflush_and_check(f);
+        r = state_file_commit(f, temp_path, link->lldp_file);
         if (r < 0)
                 goto finish;
 
-        if (rename(temp_path, link->lldp_file) < 0) {
-                r = -errno;
-                goto finish;
-        }
-
 finish:
         if (r < 0) {
                 (void) unlink(link->lldp_file);
@@ -1556,7 +1580,10 @@ static void lldp_handler(sd_lldp *lldp, sd_lldp_event event, sd_lldp_neighbor *n
 
         assert(link);
 
-        (void) link_lldp_save(link);
+        /* Refreshes only restart the neighbor's TTL, the exported data stays the same. Otherwise have the
+         * neighbor file written out with the next state save, which coalesces churning neighbors. */
+        if (event != SD_LLDP_EVENT_REFRESHED)
+                link_dirty(link);
 
         if (link_lldp_emit_enabled(link) && event == SD_LLDP_EVENT_ADDED) {
                 /* If we received information about a new neighbor, restart the LLDP "fast" logic */
@@ -3618,15 +3645,10 @@ int link_save(Link *link) {
                 }
         }
 
-        r = fflush_and_check(f);
+        r = state_file_commit(f, temp_path, link->state_file);
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, link->state_file) < 0) {
-                r = -errno;
-                goto fail;
-        }
-
         return 0;
 
 fail:
@@ -61,6 +61,7 @@ typedef enum LinkOperationalState {
 typedef struct Manager Manager;
 typedef struct Network Network;
 typedef struct Address Address;
+typedef struct Route Route;
 
 typedef struct Link {
         Manager *manager;
@@ -88,6 +89,8 @@ typedef struct Link {
         unsigned link_messages;
         unsigned enslaving;
 
+        Route *static_routes_next; /* the static route to request next, while setting routes */
+
         Set *addresses;
         Set *addresses_foreign;
         Set *routes;
@@ -109,6 +112,7 @@ typedef struct Link {
         bool ipv4ll_route:1;
 
         bool static_configured;
+        bool marked; /* not seen since the start of an rtnl resync */
 
         LIST_HEAD(Address, pool_addresses);
 
@@ -41,8 +41,12 @@
 #include "udev-util.h"
 #include "virt.h"
 
-/* use 8 MB for receive socket kernel queue. */
+/* use 8 MB for receive socket kernel queue, and grow it up to 128 MB when it overflows. */
 #define RCVBUF_SIZE    (8*1024*1024)
+#define RCVBUF_SIZE_MAX (128*1024*1024)
+
+/* Minimum interval between writes of the state files to /run */
+#define STATE_SAVE_INTERVAL_USEC (100 * USEC_PER_MSEC)
 
 const char* const network_dirs[] = {
         "/etc/systemd/network",
@@ -345,6 +349,12 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, vo
                 }
         }
 
+        /* Without tracking of foreign routes only the ones we configured ourselves are of interest,
+         * hence don't bother parsing routes of links we have not configured any routes on. On hosts
+         * carrying full routing tables this is the vast majority of messages. */
+        if (!m->manage_foreign_routes && set_isempty(link->routes))
+                return 0;
+
         r = sd_rtnl_message_route_get_family(message, &family);
         if (r < 0 || !IN_SET(family, AF_INET, AF_INET6)) {
                 log_link_warning(link, "rtnl: received address with invalid family, ignoring.");
@@ -464,12 +474,16 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, vo
         switch (type) {
         case RTM_NEWROUTE:
                 if (!route) {
+                        if (!m->manage_foreign_routes)
+                                return 0;
+
                         /* A route appeared that we did not request */
                         r = route_add_foreign(link, family, &dst, dst_prefixlen, tos, priority, table, &route);
                         if (r < 0)
                                 return 0;
                 }
 
+                route->marked = false;
                 route_update(route, &src, src_prefixlen, &gw, &prefsrc, scope, rt_type, protocol);
 
                 break;
@@ -617,6 +631,7 @@ int manager_rtnl_process_address(sd_netlink *rtnl, sd_netlink_message *message,
                                                valid_str ? "for " : "forever", valid_str ?: "");
                 }
 
+                address->marked = false;
                 address_update(address, flags, scope, &cinfo);
 
                 break;
@@ -706,6 +721,8 @@ static int manager_rtnl_process_link(sd_netlink *rtnl, sd_netlink_message *messa
                         }
                 }
 
+                link->marked = false;
+
                 r = link_update(link, message);
                 if (r < 0)
                         return 0;
@@ -822,6 +839,8 @@ int manager_rtnl_process_rule(sd_netlink *rtnl, sd_netlink_message *message, voi
                                 return 0;
                         }
                 }
+
+                rule->marked = false;
                 break;
         case RTM_DELRULE:
                 routing_policy_rule_free(rule);
@@ -854,6 +873,248 @@ static int systemd_netlink_fd(void) {
         return rtnl_fd;
 }
 
+static const sd_netlink_message_handler_t rtnl_resync_handlers[] = {
+        manager_rtnl_process_link,
+        manager_rtnl_process_address,
+        manager_rtnl_process_route,
+        manager_rtnl_process_rule,
+};
+
+static int manager_rtnl_resync_next(Manager *m);
+
+static void manager_rtnl_resync_mark(Manager *m) {
+        RoutingPolicyRule *rule;
+        Address *address;
+        Route *route;
+        Iterator i, j;
+        Link *link;
+
+        assert(m);
+
+        /* Everything the dumps report is unmarked again by the manager_rtnl_process_*() handlers, what
+         * is still marked once the last dump is done no longer exists in the kernel. */
+        HASHMAP_FOREACH(link, m->links, i) {
+                if (link->state == LINK_STATE_LINGER)
+                        continue;
+
+                link->marked = true;
+
+                SET_FOREACH(address, link->addresses, j)
+                        address->marked = true;
+                SET_FOREACH(address, link->addresses_foreign, j)
+                        address->marked = true;
+
+                if (!m->manage_foreign_routes)
+                        continue;
+
+                SET_FOREACH(route, link->routes, j)
+                        route->marked = true;
+                SET_FOREACH(route, link->routes_foreign, j)
+                        route->marked = true;
+        }
+
+        /* Rules without source and destination prefix are ignored by manager_rtnl_process_rule() */
+        SET_FOREACH(rule, m->rules, i)
+                rule->marked = rule->from_prefixlen > 0 || rule->to_prefixlen > 0;
+        SET_FOREACH(rule, m->rules_foreign, i)
+                rule->marked = rule->from_prefixlen > 0 || rule->to_prefixlen > 0;
+}
+
+static void manager_rtnl_resync_sweep_rules(Manager *m, Set *rules) {
+        RoutingPolicyRule *rule;
+        Iterator i;
+
+        SET_FOREACH(rule, rules, i) {
+                if (!rule->marked)
+                        continue;
+
+                log_debug("rtnl: routing policy rule vanished while messages were lost, dropping it.");
+
+                /* routing_policy_rule_free() only unlinks rules that belong to a network */
+                set_remove(rules, rule);
+                routing_policy_rule_free(rule);
+        }
+}
+
+static void manager_rtnl_resync_sweep(Manager *m) {
+        Address *address;
+        Route *route;
+        Iterator i, j;
+        Link *link;
+
+        assert(m);
+
+        HASHMAP_FOREACH(link, m->links, i) {
+                NetDev *netdev = NULL;
+
+                if (!link->marked || link->state == LINK_STATE_LINGER)
+                        continue;
+
+                log_link_debug(link, "rtnl: link vanished while messages were lost, dropping it.");
+
+                (void) netdev_get(m, link->ifname, &netdev);
+                link_drop(link);
+                netdev_drop(netdev);
+        }
+
+        HASHMAP_FOREACH(link, m->links, i) {
+                if (link->state == LINK_STATE_LINGER)
+                        continue;
+
+                SET_FOREACH(address, link->addresses, j)
+                        if (address->marked)
+                                address_drop(address);
+                SET_FOREACH(address, link->addresses_foreign, j)
+                        if (address->marked)
+                                address_drop(address);
+
+                if (!m->manage_foreign_routes)
+                        continue;
+
+                SET_FOREACH(route, link->routes, j)
+                        if (route->marked)
+                                route_free(route);
+                SET_FOREACH(route, link->routes_foreign, j)
+                        if (route->marked)
+                                route_free(route);
+        }
+
+        manager_rtnl_resync_sweep_rules(m, m->rules);
+        manager_rtnl_resync_sweep_rules(m, m->rules_foreign);
+}
+
+static int on_rtnl_resync_dump(sd_netlink *rtnl, sd_netlink_message *reply, void *userdata) {
+        Manager *m = userdata;
+        sd_netlink_message *i;
+
+        assert(m);
+        assert(m->rtnl_resync_stage < ELEMENTSOF(rtnl_resync_handlers));
+
+        for (i = reply; i; i = sd_netlink_message_next(i)) {
+                m->enumerating = true;
+
+                (void) rtnl_resync_handlers[m->rtnl_resync_stage](rtnl, i, m);
+
+                m->enumerating = false;
+        }
+
+        m->rtnl_resync_stage++;
+
+        (void) manager_rtnl_resync_next(m);
+
+        return 1;
+}
+
+static int manager_rtnl_resync_next(Manager *m) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL;
+        int r;
+
+        assert(m);
+
+        /* A netlink socket can only run one dump at a time, hence we go through links, addresses,
+         * routes and rules one after the other */
+        for (;;) {
+                switch (m->rtnl_resync_stage) {
+
+                case 0:
+                        manager_rtnl_resync_mark(m);
+
+                        r = sd_rtnl_message_new_link(m->rtnl, &req, RTM_GETLINK, 0);
+                        break;
+
+                case 1:
+                        r = sd_rtnl_message_new_addr(m->rtnl, &req, RTM_GETADDR, 0, 0);
+                        break;
+
+                case 2:
+                        if (!m->manage_foreign_routes) {
+                                m->rtnl_resync_stage++;
+                                continue;
+                        }
+
+                        r = sd_rtnl_message_new_route(m->rtnl, &req, RTM_GETROUTE, 0, 0);
+                        break;
+
+                case 3:
+                        r = sd_rtnl_message_new_routing_policy_rule(m->rtnl, &req, RTM_GETRULE, 0);
+                        break;
+
+                default:
+                        if (m->rtnl_resync_again) {
+                                /* We lost messages again while resynchronizing */
+                                m->rtnl_resync_again = false;
+                                m->rtnl_resync_stage = 0;
+                                m->n_rtnl_resyncs++;
+                                continue;
+                        }
+
+                        manager_rtnl_resync_sweep(m);
+
+                        log_info("rtnl: resynchronized state with the kernel (%u overflows, %u resyncs so far)",
+                                 m->n_rtnl_overflows, m->n_rtnl_resyncs);
+                        m->rtnl_resync_stage = (unsigned) -1;
+                        return 0;
+                }
+
+                break;
+        }
+        if (r < 0)
+                goto fail;
+
+        r = sd_netlink_message_request_dump(req, true);
+        if (r < 0)
+                goto fail;
+
+        r = sd_netlink_call_async(m->rtnl, req, on_rtnl_resync_dump, m, 0, NULL);
+        if (r < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        m->rtnl_resync_stage = (unsigned) -1;
+        return log_error_errno(r, "rtnl: could not resynchronize state with the kernel: %m");
+}
+
+int manager_rtnl_resync(Manager *m) {
+        assert(m);
+
+        /* Dumps are already in progress. Their results may predate the lost messages, so start over
+         * once they are done. */
+        if (m->rtnl_resync_stage != (unsigned) -1) {
+                m->rtnl_resync_again = true;
+                return 0;
+        }
+
+        m->n_rtnl_resyncs++;
+        m->rtnl_resync_stage = 0;
+
+        return manager_rtnl_resync_next(m);
+}
+
+static int manager_rtnl_overflow(sd_netlink *rtnl, void *userdata) {
+        Manager *m = userdata;
+        int r;
+
+        assert(m);
+
+        m->n_rtnl_overflows++;
+
+        /* Make room for bigger bursts next time */
+        if (m->rtnl_rcvbuf_size < RCVBUF_SIZE_MAX) {
+                r = sd_netlink_inc_rcvbuf(rtnl, m->rtnl_rcvbuf_size * 2);
+                if (r < 0)
+                        log_debug_errno(r, "rtnl: could not increase receive buffer size, ignoring: %m");
+                else
+                        m->rtnl_rcvbuf_size *= 2;
+        }
+
+        log_warning("rtnl: lost messages from the kernel (receive buffer %zu bytes), resynchronizing state.",
+                    m->rtnl_rcvbuf_size);
+
+        return manager_rtnl_resync(m);
+}
+
 static int manager_connect_rtnl(Manager *m) {
         int fd, r;
 
@@ -871,10 +1132,16 @@ static int manager_connect_rtnl(Manager *m) {
         if (r < 0)
                 return r;
 
+        m->rtnl_rcvbuf_size = RCVBUF_SIZE;
+
         r = sd_netlink_attach_event(m->rtnl, m->event, 0);
         if (r < 0)
                 return r;
 
+        r = sd_netlink_set_overflow_handler(m->rtnl, manager_rtnl_overflow, m);
+        if (r < 0)
+                return r;
+
         r = sd_netlink_add_match(m->rtnl, RTM_NEWLINK, &manager_rtnl_process_link, m);
         if (r < 0)
                 return r;
@@ -1148,15 +1415,10 @@ static int manager_save(Manager *m) {
                 fputc('\n', f);
         }
 
-        r = fflush_and_check(f);
+        r = state_file_commit(f, temp_path, m->state_file);
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, m->state_file) < 0) {
-                r = -errno;
-                goto fail;
-        }
-
         if (m->operational_state != operstate) {
                 m->operational_state = operstate;
                 r = manager_send_changed(m, "OperationalState", NULL);
@@ -1175,14 +1437,15 @@ fail:
         return log_error_errno(r, "Failed to save network state to %s: %m", m->state_file);
 }
 
-static int manager_dirty_handler(sd_event_source *s, void *userdata) {
-        Manager *m = userdata;
+static void manager_save_state(Manager *m) {
         Link *link;
         Iterator i;
         int r;
 
         assert(m);
 
+        m->state_save_event_source = sd_event_source_unref(m->state_save_event_source);
+
         if (m->dirty)
                 manager_save(m);
 
@@ -1192,6 +1455,51 @@ static int manager_dirty_handler(sd_event_source *s, void *userdata) {
                         link_clean(link);
         }
 
+        m->state_save_usec = now(clock_boottime_or_monotonic());
+}
+
+static int on_state_save_timer(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        manager_save_state(m);
+
+        return 0;
+}
+
+static int manager_dirty_handler(sd_event_source *s, void *userdata) {
+        Manager *m = userdata;
+        usec_t n;
+        int r;
+
+        assert(m);
+
+        if (!m->dirty && set_isempty(m->dirty_links))
+                return 1;
+
+        /* A write is scheduled already, it will pick up the new changes too */
+        if (m->state_save_event_source)
+                return 1;
+
+        /* Write out state right away, unless we did so just now. When links are flapping or created
+         * in bulk, coalesce the changes instead of rewriting the state files on each event loop
+         * iteration. */
+        n = now(clock_boottime_or_monotonic());
+        if (m->state_save_usec > 0 && n < usec_add(m->state_save_usec, STATE_SAVE_INTERVAL_USEC)) {
+                r = sd_event_add_time(m->event, &m->state_save_event_source, clock_boottime_or_monotonic(),
+                                      usec_add(m->state_save_usec, STATE_SAVE_INTERVAL_USEC), 0,
+                                      on_state_save_timer, m);
+                if (r >= 0) {
+                        (void) sd_event_source_set_description(m->state_save_event_source, "networkd-state-save");
+                        return 1;
+                }
+
+                log_warning_errno(r, "Failed to schedule writing state, writing it now: %m");
+        }
+
+        manager_save_state(m);
+
         return 1;
 }
 
@@ -1232,6 +1540,8 @@ int manager_new(Manager **ret, sd_event *event) {
                 return r;
 
         m->duid.type = DUID_TYPE_EN;
+        m->manage_foreign_routes = true;
+        m->rtnl_resync_stage = (unsigned) -1;
 
         (void) routing_policy_rule_load(m);
 
@@ -1251,6 +1561,10 @@ void manager_free(Manager *m) {
         if (!m)
                 return;
 
+        /* Don't lose changes whose writing was deferred */
+        if (m->state_save_event_source)
+                manager_save_state(m);
+
         free(m->state_file);
 
         while ((network = m->networks))
@@ -1261,6 +1575,7 @@ void manager_free(Manager *m) {
         hashmap_free(m->links);
 
         hashmap_free(m->networks_by_name);
+        hashmap_free_free(m->networks_by_match_name);
 
         while ((netdev = hashmap_first(m->netdevs)))
                 netdev_unref(netdev);
@@ -1410,6 +1725,10 @@ int manager_rtnl_enumerate_routes(Manager *m) {
         assert(m);
         assert(m->rtnl);
 
+        /* All routes present at startup are foreign to us, so don't dump what we'd ignore anyway */
+        if (!m->manage_foreign_routes)
+                return 0;
+
         r = sd_rtnl_message_new_route(m->rtnl, &req, RTM_GETROUTE, 0, 0);
         if (r < 0)
                 return r;
@@ -47,22 +47,33 @@ struct Manager {
         sd_event_source *udev_event_source;
 
         bool enumerating:1;
+        bool rtnl_resync_again:1;
         bool dirty:1;
 
         Set *dirty_links;
 
+        /* Recovering from lost rtnl messages, see manager_rtnl_overflow() */
+        size_t rtnl_rcvbuf_size;
+        unsigned rtnl_resync_stage;
+        unsigned n_rtnl_overflows;
+        unsigned n_rtnl_resyncs;
+        sd_event_source *state_save_event_source;
+        usec_t state_save_usec;
+
         char *state_file;
         LinkOperationalState operational_state;
 
         Hashmap *links;
         Hashmap *netdevs;
         Hashmap *networks_by_name;
+        Hashmap *networks_by_match_name; /* literal Name= → NULL-terminated array of Network*, in load order */
         LIST_HEAD(Network, networks);
         LIST_HEAD(AddressPool, address_pools);
 
         usec_t network_dirs_ts_usec;
 
         DUID duid;
+        bool manage_foreign_routes;
         char* dynamic_hostname;
         char* dynamic_timezone;
 
@@ -93,6 +104,7 @@ int manager_rtnl_enumerate_links(Manager *m);
 int manager_rtnl_enumerate_addresses(Manager *m);
 int manager_rtnl_enumerate_routes(Manager *m);
 int manager_rtnl_enumerate_rules(Manager *m);
+int manager_rtnl_resync(Manager *m);
 
 int manager_rtnl_process_address(sd_netlink *nl, sd_netlink_message *message, void *userdata);
 int manager_rtnl_process_route(sd_netlink *nl, sd_netlink_message *message, void *userdata);
@@ -25,6 +25,7 @@
 #include "conf-parser.h"
 #include "dns-domain.h"
 #include "fd-util.h"
+#include "glob-util.h"
 #include "hostname-util.h"
 #include "in-addr-util.h"
 #include "network-internal.h"
@@ -318,6 +319,73 @@ static int network_load_one(Manager *manager, const char *filename) {
         return 0;
 }
 
+static bool network_match_name_is_literal(Network *network) {
+        char **name;
+
+        assert(network);
+
+        if (strv_isempty(network->match_name) || network->match_name[0][0] == '!')
+                return false;
+
+        STRV_FOREACH(name, network->match_name)
+                if (string_is_glob(*name))
+                        return false;
+
+        return true;
+}
+
+static int network_index_match_names(Manager *manager) {
+        Network *network;
+        int r;
+
+        assert(manager);
+
+        /* Most .network files match on plain interface names. Index those, so that network_get() only
+         * has to glob on the files that actually use patterns, negations or no Name= at all. */
+
+        r = hashmap_ensure_allocated(&manager->networks_by_match_name, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        LIST_FOREACH(networks, network, manager->networks) {
+                char **name;
+
+                if (!network_match_name_is_literal(network))
+                        continue;
+
+                STRV_FOREACH(name, network->match_name) {
+                        Network **l;
+                        size_t n = 0;
+
+                        l = hashmap_get(manager->networks_by_match_name, *name);
+                        while (l && l[n])
+                                n++;
+
+                        /* The same name listed twice in one file */
+                        if (n > 0 && l[n-1] == network)
+                                continue;
+
+                        l = realloc(l, sizeof(Network*) * (n + 2));
+                        if (!l)
+                                return -ENOMEM;
+
+                        l[n] = network;
+                        l[n+1] = NULL;
+
+                        r = hashmap_replace(manager->networks_by_match_name, *name, l);
+                        if (r < 0) {
+                                if (n == 0)
+                                        free(l);
+                                return r;
+                        }
+                }
+
+                network->match_name_indexed = true;
+        }
+
+        return 0;
+}
+
 int network_load(Manager *manager) {
         Network *network;
         _cleanup_strv_free_ char **files = NULL;
@@ -326,6 +394,8 @@ int network_load(Manager *manager) {
 
         assert(manager);
 
+        manager->networks_by_match_name = hashmap_free_free(manager->networks_by_match_name);
+
         while ((network = manager->networks))
                 network_free(network);
 
@@ -339,6 +409,10 @@ int network_load(Manager *manager) {
                         return r;
         }
 
+        r = network_index_match_names(manager);
+        if (r < 0)
+                return log_error_errno(r, "Failed to index network files: %m");
+
         return 0;
 }
 
@@ -457,13 +531,16 @@ int network_get_by_name(Manager *manager, const char *name, Network **ret) {
 int network_get(Manager *manager, struct udev_device *device,
                 const char *ifname, const struct ether_addr *address,
                 Network **ret) {
-        Network *network;
+        Network *network, **candidates = NULL;
         struct udev_device *parent;
         const char *path = NULL, *parent_driver = NULL, *driver = NULL, *devtype = NULL;
 
         assert(manager);
         assert(ret);
 
+        if (ifname)
+                candidates = hashmap_get(manager->networks_by_match_name, ifname);
+
         if (device) {
                 path = udev_device_get_property_value(device, "ID_PATH");
 
@@ -477,6 +554,15 @@ int network_get(Manager *manager, struct udev_device *device,
         }
 
         LIST_FOREACH(networks, network, manager->networks) {
+                /* Networks matching on literal names only are considered if the index lists them for
+                 * this name. The candidates are in load order too, hence walk them along. */
+                if (network->match_name_indexed) {
+                        if (!candidates || *candidates != network)
+                                continue;
+
+                        candidates++;
+                }
+
                 if (net_match_config(network->match_mac, network->match_path,
                                      network->match_driver, network->match_type,
                                      network->match_name, network->match_host,
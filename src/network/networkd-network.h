@@ -108,6 +108,7 @@ struct Network {
         char **match_driver;
         char **match_type;
         char **match_name;
+        bool match_name_indexed; /* all Name= entries are literal and listed in networks_by_match_name */
 
         Condition *match_host;
         Condition *match_virt;
@@ -51,6 +51,8 @@ struct Route {
         usec_t lifetime;
         sd_event_source *expire;
 
+        bool marked; /* not seen since the start of an rtnl resync */
+
         LIST_FIELDS(Route, routes);
 };
 
@@ -52,6 +52,8 @@ struct RoutingPolicyRule {
         union in_addr_union to;
         union in_addr_union from;
 
+        bool marked; /* not seen since the start of an rtnl resync */
+
         LIST_FIELDS(RoutingPolicyRule, rules);
 };
 
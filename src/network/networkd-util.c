@@ -17,7 +17,9 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "alloc-util.h"
 #include "conf-parser.h"
+#include "fileio.h"
 #include "networkd-util.h"
 #include "parse-util.h"
 #include "string-table.h"
@@ -98,3 +100,38 @@ int config_parse_address_family_boolean_with_kernel(
 
         return 0;
 }
+
+int state_file_commit(FILE *f, const char *temp_path, const char *path) {
+        _cleanup_free_ char *old = NULL, *new = NULL;
+        size_t old_size, new_size;
+        int r;
+
+        assert(f);
+        assert(temp_path);
+        assert(path);
+
+        /* Moves the freshly written temporary file over the state file, unless the latter has the very
+         * same contents already, so that sd-network clients watching it do not wake up for nothing.
+         * Returns 0 if nothing changed, 1 otherwise. */
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        if (read_full_file(path, &old, &old_size) >= 0) {
+                /* The stream is write-only, read back what we wrote through the file system */
+                r = read_full_file(temp_path, &new, &new_size);
+                if (r < 0)
+                        return r;
+
+                if (old_size == new_size && memcmp(old, new, old_size) == 0) {
+                        (void) unlink(temp_path);
+                        return 0;
+                }
+        }
+
+        if (rename(temp_path, path) < 0)
+                return -errno;
+
+        return 1;
+}
@@ -19,6 +19,8 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <stdio.h>
+
 #include "macro.h"
 
 typedef enum AddressFamilyBoolean {
@@ -36,3 +38,5 @@ int config_parse_address_family_boolean_with_kernel(const char* unit, const char
 
 const char *address_family_boolean_to_string(AddressFamilyBoolean b) _const_;
 AddressFamilyBoolean address_family_boolean_from_string(const char *s) _const_;
+
+int state_file_commit(FILE *f, const char *temp_path, const char *path);
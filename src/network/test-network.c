@@ -19,8 +19,14 @@
 
 #include "alloc-util.h"
 #include "dhcp-lease-internal.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
 #include "network-internal.h"
 #include "networkd-manager.h"
+#include "networkd-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
 
 static void test_deserialize_in_addr(void) {
         _cleanup_free_ struct in_addr *addresses = NULL;
@@ -184,6 +190,81 @@ static void test_address_equality(void) {
         assert_se(!address_equal(a1, a2));
 }
 
+static void test_rtnl_resync(Manager *manager) {
+        union in_addr_union bogus = {}, loopback = {}, any = {};
+        RoutingPolicyRule *rule;
+        Address *address;
+        Link *lo;
+
+        assert_se(manager_rtnl_enumerate_addresses(manager) >= 0);
+        assert_se(link_get(manager, 1, &lo) >= 0);
+
+        assert_se(inet_pton(AF_INET, "192.0.2.1", &bogus.in) == 1);
+        assert_se(inet_pton(AF_INET, "127.0.0.1", &loopback.in) == 1);
+        assert_se(address_get(lo, AF_INET, &loopback, 8, NULL) >= 0);
+
+        /* Pretend the messages removing these from the kernel got lost */
+        assert_se(address_add_foreign(lo, AF_INET, &bogus, 32, &address) >= 0);
+        assert_se(routing_policy_rule_add_foreign(manager, AF_INET, &bogus, 32, &any, 0, 0, 0, 0, &rule) >= 0);
+
+        assert_se(manager_rtnl_resync(manager) >= 0);
+        while (manager->rtnl_resync_stage != (unsigned) -1)
+                assert_se(sd_event_run(manager->event, (uint64_t) -1) >= 0);
+
+        assert_se(address_get(lo, AF_INET, &bogus, 32, NULL) == -ENOENT);
+        assert_se(routing_policy_rule_get(manager, AF_INET, &bogus, 32, &any, 0, 0, 0, 0, NULL) == -ENOENT);
+
+        /* ... while whatever the kernel still reports is kept */
+        assert_se(link_get(manager, 1, &lo) >= 0);
+        assert_se(address_get(lo, AF_INET, &loopback, 8, NULL) >= 0);
+}
+
+static int save_state(const char *path, const void *data, size_t size) {
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *temp_path = NULL;
+        int r;
+
+        assert_se(fopen_temporary(path, &f, &temp_path) >= 0);
+        assert_se(fwrite(data, 1, size, f) == size);
+
+        r = state_file_commit(f, temp_path, path);
+        assert_se(access(temp_path, F_OK) < 0 && errno == ENOENT);
+
+        return r;
+}
+
+static void test_state_file_commit_one(const char *path, const void *data, size_t size) {
+        _cleanup_free_ char *contents = NULL;
+        size_t contents_size;
+
+        /* Saving the same state again must leave the file untouched, and in place */
+        assert_se(save_state(path, data, size) == 1);
+        assert_se(save_state(path, data, size) == 0);
+        assert_se(save_state(path, data, size) == 0);
+
+        assert_se(read_full_file(path, &contents, &contents_size) >= 0);
+        assert_se(contents_size == size);
+        assert_se(memcmp(contents, data, size) == 0);
+}
+
+static void test_state_file_commit(void) {
+        char t[] = "/tmp/test-network-state-XXXXXX";
+        /* LLDP neighbour files are binary: a little-endian size followed by the raw frame */
+        static const uint8_t lldp[] = { 4, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x07, 0x04, 0x00 };
+        const char *p, *q;
+
+        assert_se(mkdtemp(t));
+
+        p = strjoina(t, "/state");
+        test_state_file_commit_one(p, "OPER_STATE=routable\n", strlen("OPER_STATE=routable\n"));
+        test_state_file_commit_one(p, "OPER_STATE=degraded\n", strlen("OPER_STATE=degraded\n"));
+
+        q = strjoina(t, "/lldp");
+        test_state_file_commit_one(q, lldp, sizeof(lldp));
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
 int main(void) {
         _cleanup_manager_free_ Manager *manager = NULL;
         sd_event *event;
@@ -194,6 +275,7 @@ int main(void) {
         test_deserialize_in_addr();
         test_deserialize_dhcp_routes();
         test_address_equality();
+        test_state_file_commit();
 
         r = sd_event_default(&event);
         assert_se(r >= 0);
@@ -217,6 +299,8 @@ int main(void) {
 
         assert_se(manager_rtnl_enumerate_links(manager) >= 0);
 
+        test_rtnl_resync(manager);
+
         udev_device_unref(loopback);
         udev_unref(udev);
         sd_event_unref(event);
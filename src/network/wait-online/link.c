@@ -23,8 +23,10 @@
 #include "alloc-util.h"
 #include "hashmap.h"
 #include "link.h"
+#include "log.h"
 #include "manager.h"
 #include "string-util.h"
+#include "strv.h"
 
 int link_new(Manager *m, Link **ret, int ifindex, const char *ifname) {
         _cleanup_(link_freep) Link *l = NULL;
@@ -74,11 +76,18 @@ Link *link_free(Link *l) {
                 return NULL;
 
         if (l->manager) {
+                if (l->pending)
+                        l->manager->n_links_pending--;
+                if (l->ready)
+                        l->manager->n_links_ready--;
+
                 hashmap_remove(l->manager->links, INT_TO_PTR(l->ifindex));
                 hashmap_remove(l->manager->links_by_name, l->ifname);
         }
 
         free(l->ifname);
+        free(l->operational_state);
+        free(l->state);
         return mfree(l);
  }
 
@@ -130,3 +139,44 @@ int link_update_monitor(Link *l) {
 
         return 0;
 }
+
+void link_update_readiness(Link *l) {
+        bool pending = false, ready = false;
+        Manager *m;
+
+        assert(l);
+        assert(l->manager);
+
+        m = l->manager;
+
+        if (manager_ignore_link(m, l))
+                log_debug("ignoring: %s", l->ifname);
+        else {
+                if (!l->state) {
+                        log_debug("link %s has not yet been processed by udev", l->ifname);
+                        pending = true;
+                } else if (STR_IN_SET(l->state, "configuring", "pending")) {
+                        log_debug("link %s is being processed by networkd", l->ifname);
+                        pending = true;
+                }
+
+                /* we wait for at least one link to be ready, regardless of who manages it */
+                ready = l->operational_state && STR_IN_SET(l->operational_state, "degraded", "routable");
+        }
+
+        if (pending != l->pending) {
+                if (pending)
+                        m->n_links_pending++;
+                else
+                        m->n_links_pending--;
+                l->pending = pending;
+        }
+
+        if (ready != l->ready) {
+                if (ready)
+                        m->n_links_ready++;
+                else
+                        m->n_links_ready--;
+                l->ready = ready;
+        }
+}
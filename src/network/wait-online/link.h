@@ -34,12 +34,17 @@ struct Link {
 
         char *operational_state;
         char *state;
+
+        /* What this link currently contributes to the manager's counters */
+        bool pending:1;
+        bool ready:1;
 };
 
 int link_new(Manager *m, Link **ret, int ifindex, const char *ifname);
 Link *link_free(Link *l);
 int link_update_rtnl(Link *l, sd_netlink_message *m);
 int link_update_monitor(Link *l);
+void link_update_readiness(Link *l);
 bool link_relevant(Link *l);
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(Link*, link_free);
@@ -20,12 +20,16 @@
 #include <netinet/ether.h>
 #include <linux/if.h>
 #include <fnmatch.h>
+#include <sys/inotify.h>
 
 #include "alloc-util.h"
+#include "fd-util.h"
+#include "fs-util.h"
 #include "link.h"
 #include "manager.h"
 #include "netlink-util.h"
 #include "network-internal.h"
+#include "parse-util.h"
 #include "time-util.h"
 #include "util.h"
 
@@ -46,10 +50,8 @@ bool manager_ignore_link(Manager *m, Link *link) {
 }
 
 bool manager_all_configured(Manager *m) {
-        Iterator i;
         Link *l;
         char **ifname;
-        bool one_ready = false;
 
         /* wait for all the links given on the command line to appear */
         STRV_FOREACH(ifname, m->interfaces) {
@@ -61,33 +63,14 @@ bool manager_all_configured(Manager *m) {
         }
 
         /* wait for all links networkd manages to be in admin state 'configured'
-           and at least one link to gain a carrier */
-        HASHMAP_FOREACH(l, m->links, i) {
-                if (manager_ignore_link(m, l)) {
-                        log_info("ignoring: %s", l->ifname);
-                        continue;
-                }
-
-                if (!l->state) {
-                        log_debug("link %s has not yet been processed by udev",
-                                  l->ifname);
-                        return false;
-                }
-
-                if (STR_IN_SET(l->state, "configuring", "pending")) {
-                        log_debug("link %s is being processed by networkd",
-                                  l->ifname);
-                        return false;
-                }
-
-                if (l->operational_state &&
-                    STR_IN_SET(l->operational_state, "degraded", "routable"))
-                        /* we wait for at least one link to be ready,
-                           regardless of who manages it */
-                        one_ready = true;
+           and at least one link to gain a carrier. Links keep the counters
+           up-to-date as they change, see link_update_readiness(). */
+        if (m->n_links_pending > 0) {
+                log_debug("still waiting for %u links", m->n_links_pending);
+                return false;
         }
 
-        return one_ready;
+        return m->n_links_ready > 0;
 }
 
 static int manager_process_link(sd_netlink *rtnl, sd_netlink_message *mm, void *userdata) {
@@ -134,6 +117,8 @@ static int manager_process_link(sd_netlink *rtnl, sd_netlink_message *mm, void *
                 if (r < 0)
                         goto fail;
 
+                link_update_readiness(l);
+
                 break;
 
         case RTM_DELLINK:
@@ -212,20 +197,90 @@ static int manager_rtnl_listen(Manager *m) {
         return r;
 }
 
+static int network_monitor_add_watch(int fd) {
+        int k;
+
+        /* Same as sd_network_monitor, but we need the names of the changed files */
+
+        k = inotify_add_watch(fd, "/run/systemd/netif/links/", IN_MOVED_TO|IN_DELETE);
+        if (k >= 0)
+                return 0;
+        else if (errno != ENOENT)
+                return -errno;
+
+        k = inotify_add_watch(fd, "/run/systemd/netif/", IN_CREATE|IN_ISDIR);
+        if (k >= 0)
+                return 0;
+        else if (errno != ENOENT)
+                return -errno;
+
+        k = inotify_add_watch(fd, "/run/systemd/", IN_CREATE|IN_ISDIR);
+        if (k < 0)
+                return -errno;
+
+        return 0;
+}
+
+static void manager_update_link(Manager *m, Link *l) {
+        int r;
+
+        assert(m);
+        assert(l);
+
+        r = link_update_monitor(l);
+        if (r < 0)
+                log_warning_errno(r, "Failed to update monitor information for %i: %m", l->ifindex);
+
+        link_update_readiness(l);
+}
+
 static int on_network_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        union inotify_event_buffer buffer;
+        struct inotify_event *e;
         Manager *m = userdata;
-        Iterator i;
-        Link *l;
+        bool all = false;
+        ssize_t l;
         int r;
 
         assert(m);
 
-        sd_network_monitor_flush(m->network_monitor);
+        l = read(fd, &buffer, sizeof(buffer));
+        if (l < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
 
-        HASHMAP_FOREACH(l, m->links, i) {
-                r = link_update_monitor(l);
-                if (r < 0)
-                        log_warning_errno(r, "Failed to update monitor information for %i: %m", l->ifindex);
+                return log_error_errno(errno, "Failed to read inotify event: %m");
+        }
+
+        /* Only re-read the state of the links whose files changed */
+        FOREACH_INOTIFY_EVENT(e, buffer, l) {
+                Link *link;
+                int ifindex;
+
+                if (e->mask & (IN_ISDIR|IN_Q_OVERFLOW)) {
+                        r = network_monitor_add_watch(fd);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to watch network state directory: %m");
+
+                        /* The links directory appeared, or we lost events: look at all links */
+                        all = true;
+                        continue;
+                }
+
+                if (e->len == 0 || parse_ifindex(e->name, &ifindex) < 0)
+                        continue;
+
+                link = hashmap_get(m->links, INT_TO_PTR(ifindex));
+                if (link)
+                        manager_update_link(m, link);
+        }
+
+        if (all) {
+                Iterator i;
+                Link *link;
+
+                HASHMAP_FOREACH(link, m->links, i)
+                        manager_update_link(m, link);
         }
 
         if (manager_all_configured(m))
@@ -235,24 +290,20 @@ static int on_network_event(sd_event_source *s, int fd, uint32_t revents, void *
 }
 
 static int manager_network_monitor_listen(Manager *m) {
-        int r, fd, events;
+        int r;
 
         assert(m);
 
-        r = sd_network_monitor_new(&m->network_monitor, NULL);
+        m->network_monitor_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        if (m->network_monitor_fd < 0)
+                return -errno;
+
+        r = network_monitor_add_watch(m->network_monitor_fd);
         if (r < 0)
                 return r;
 
-        fd = sd_network_monitor_get_fd(m->network_monitor);
-        if (fd < 0)
-                return fd;
-
-        events = sd_network_monitor_get_events(m->network_monitor);
-        if (events < 0)
-                return events;
-
         r = sd_event_add_io(m->event, &m->network_monitor_event_source,
-                            fd, events, &on_network_event, m);
+                            m->network_monitor_fd, EPOLLIN, &on_network_event, m);
         if (r < 0)
                 return r;
 
@@ -271,6 +322,7 @@ int manager_new(Manager **ret, char **interfaces, char **ignore, usec_t timeout)
 
         m->interfaces = interfaces;
         m->ignore = ignore;
+        m->network_monitor_fd = -1;
 
         r = sd_event_default(&m->event);
         if (r < 0)
@@ -317,7 +369,7 @@ void manager_free(Manager *m) {
         hashmap_free(m->links_by_name);
 
         sd_event_source_unref(m->network_monitor_event_source);
-        sd_network_monitor_unref(m->network_monitor);
+        safe_close(m->network_monitor_fd);
 
         sd_event_source_unref(m->rtnl_event_source);
         sd_netlink_unref(m->rtnl);
@@ -21,7 +21,6 @@
 
 #include "sd-event.h"
 #include "sd-netlink.h"
-#include "sd-network.h"
 
 #include "hashmap.h"
 
@@ -35,10 +34,15 @@ struct Manager {
         char **interfaces;
         char **ignore;
 
+        /* Number of links not ignored which networkd has not finished with yet, and of those
+         * which are degraded or routable */
+        unsigned n_links_pending;
+        unsigned n_links_ready;
+
         sd_netlink *rtnl;
         sd_event_source *rtnl_event_source;
 
-        sd_network_monitor *network_monitor;
+        int network_monitor_fd;
         sd_event_source *network_monitor_event_source;
 
         sd_event *event;
@@ -23,6 +23,7 @@
 #include <sys/acl.h>
 #endif
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/vfs.h>
 #include <unistd.h>
 
@@ -242,7 +243,6 @@ static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shi
 static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift) {
         uid_t new_uid;
         gid_t new_gid;
-        bool changed = false;
         int r;
 
         assert(fd >= 0);
@@ -254,33 +254,36 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
         if (!uid_is_valid(new_uid) || !gid_is_valid(new_gid))
                 return -EINVAL;
 
-        if (st->st_uid != new_uid || st->st_gid != new_gid) {
-                if (name)
-                        r = fchownat(fd, name, new_uid, new_gid, AT_SYMLINK_NOFOLLOW);
-                else
-                        r = fchown(fd, new_uid, new_gid);
-                if (r < 0)
-                        return -errno;
-
-                /* The Linux kernel alters the mode in some cases of chown(). Let's undo this. */
-                if (name) {
-                        if (!S_ISLNK(st->st_mode))
-                                r = fchmodat(fd, name, st->st_mode, 0);
-                        else /* AT_SYMLINK_NOFOLLOW is not available for fchmodat() */
-                                r = 0;
-                } else
-                        r = fchmod(fd, st->st_mode);
-                if (r < 0)
-                        return -errno;
-
-                changed = true;
-        }
+        /* If the inode is already owned by the target range we consider it fully patched, and don't bother
+         * with its ACLs either. This is safe since we always patch the ACLs first and the ownership last, so
+         * that an interrupted run never leaves an inode behind that is in the target range but whose ACLs
+         * are not. */
+        if (st->st_uid == new_uid && st->st_gid == new_gid)
+                return 0;
 
         r = patch_acls(fd, name, st, shift);
         if (r < 0)
                 return r;
 
-        return r > 0 || changed;
+        if (name)
+                r = fchownat(fd, name, new_uid, new_gid, AT_SYMLINK_NOFOLLOW);
+        else
+                r = fchown(fd, new_uid, new_gid);
+        if (r < 0)
+                return -errno;
+
+        /* The Linux kernel alters the mode in some cases of chown(). Let's undo this. */
+        if (name) {
+                if (!S_ISLNK(st->st_mode))
+                        r = fchmodat(fd, name, st->st_mode, 0);
+                else /* AT_SYMLINK_NOFOLLOW is not available for fchmodat() */
+                        r = 0;
+        } else
+                r = fchmod(fd, st->st_mode);
+        if (r < 0)
+                return -errno;
+
+        return 1;
 }
 
 /*
@@ -289,90 +292,97 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
  * user namespaces, however their inodes may relate to host resources or only
  * valid in the global user namespace, therefore no patching should be applied.
  */
-static int is_fs_fully_userns_compatible(int fd) {
-        struct statfs sfs;
-
-        assert(fd >= 0);
+static bool is_fs_fully_userns_compatible(const struct statfs *sfs) {
+
+        assert(sfs);
+
+        return F_TYPE_EQUAL(sfs->f_type, BINFMTFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, CGROUP_SUPER_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, CGROUP2_SUPER_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, DEBUGFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, DEVPTS_SUPER_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, EFIVARFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, HUGETLBFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, MQUEUE_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, PROC_SUPER_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, PSTOREFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, SELINUX_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, SMACK_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, SECURITYFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, BPF_FS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, TRACEFS_MAGIC) ||
+               F_TYPE_EQUAL(sfs->f_type, SYSFS_MAGIC);
+}
 
-        if (fstatfs(fd, &sfs) < 0)
-                return -errno;
+static bool stat_in_range(const struct stat *st, uid_t shift) {
+        assert(st);
 
-        return F_TYPE_EQUAL(sfs.f_type, BINFMTFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, CGROUP_SUPER_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, CGROUP2_SUPER_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, DEBUGFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, DEVPTS_SUPER_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, EFIVARFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, HUGETLBFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, MQUEUE_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, PROC_SUPER_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, PSTOREFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, SELINUX_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, SMACK_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, SECURITYFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, BPF_FS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, TRACEFS_MAGIC) ||
-               F_TYPE_EQUAL(sfs.f_type, SYSFS_MAGIC);
+        return ((uint32_t) (st->st_uid ^ shift) >> 16) == 0 &&
+               ((uint32_t) (st->st_gid ^ shift) >> 16) == 0;
 }
 
 static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, bool is_toplevel) {
+        struct statfs sfs;
         bool changed = false;
         int r;
 
         assert(fd >= 0);
 
+        /* Directories are patched only after everything below them has been, hence a directory that is
+         * already owned by the target range marks a completely patched subtree. This way a run that got
+         * interrupted half-way will pick up where it left off, instead of walking the full tree again. */
+        if (!is_toplevel && stat_in_range(st, shift)) {
+                r = 0;
+                goto finish;
+        }
+
+        if (fstatfs(fd, &sfs) < 0) {
+                r = -errno;
+                goto finish;
+        }
+
         /* We generally want to permit crossing of mount boundaries when patching the UIDs/GIDs. However, we
          * probably shouldn't do this for /proc and /sys if that is already mounted into place. Hence, let's
          * stop the recursion when we hit procfs, sysfs or some other special file systems. */
-        r = is_fs_fully_userns_compatible(fd);
-        if (r < 0)
-                goto finish;
-        if (r > 0) {
+        if (is_fs_fully_userns_compatible(&sfs)) {
                 r = 0; /* don't recurse */
                 goto finish;
         }
 
-        r = patch_fd(fd, NULL, st, shift);
-        if (r == -EROFS) {
+        if (sfs.f_flags & ST_RDONLY) {
                 _cleanup_free_ char *name = NULL;
 
-                if (!is_toplevel) {
-                        /* When we hit a ready-only subtree we simply skip it, but log about it. */
-                        (void) fd_get_path(fd, &name);
-                        log_debug("Skippping read-only file or directory %s.", strna(name));
-                        r = 0;
+                if (is_toplevel) {
+                        r = -EROFS;
+                        goto finish;
                 }
 
+                /* When we hit a ready-only subtree we simply skip it, but log about it. */
+                (void) fd_get_path(fd, &name);
+                log_debug("Skippping read-only file or directory %s.", strna(name));
+                r = 0;
                 goto finish;
         }
-        if (r < 0)
-                goto finish;
-        if (r > 0)
-                changed = true;
 
         if (S_ISDIR(st->st_mode)) {
                 _cleanup_closedir_ DIR *d = NULL;
                 struct dirent *de;
+                int copy;
 
-                if (!donate_fd) {
-                        int copy;
-
-                        copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
-                        if (copy < 0) {
-                                r = -errno;
-                                goto finish;
-                        }
-
-                        fd = copy;
-                        donate_fd = true;
+                /* Keep our own fd around, we still need it to patch the directory itself once we are done
+                 * with its contents. */
+                copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+                if (copy < 0) {
+                        r = -errno;
+                        goto finish;
                 }
 
-                d = fdopendir(fd);
+                d = fdopendir(copy);
                 if (!d) {
                         r = -errno;
+                        safe_close(copy);
                         goto finish;
                 }
-                fd = -1;
 
                 FOREACH_DIRENT_ALL(de, d, r = -errno; goto finish) {
                         struct stat fst;
@@ -388,6 +398,10 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
                         if (S_ISDIR(fst.st_mode)) {
                                 int subdir_fd;
 
+                                /* Don't bother opening directories that are already done */
+                                if (stat_in_range(&fst, shift))
+                                        continue;
+
                                 subdir_fd = openat(dirfd(d), de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW|O_NOATIME);
                                 if (subdir_fd < 0) {
                                         r = -errno;
@@ -411,6 +425,12 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
                 }
         }
 
+        r = patch_fd(fd, NULL, st, shift);
+        if (r < 0)
+                goto finish;
+        if (r > 0)
+                changed = true;
+
         r = changed;
 
 finish:
@@ -454,10 +474,12 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
                 goto finish;
         }
 
-        /* Try to detect if the range is already right. Of course, this a pretty drastic optimization, as we assume
-         * that if the top-level dir has the right upper 16bit assigned, then everything below will have too... */
-        if (((uint32_t) (st.st_uid ^ shift) >> 16) == 0)
-                return 0;
+        /* Try to detect if the range is already right. Since the top-level directory is the last inode we patch,
+         * if it has the right upper 16bit assigned, then everything below will have too. */
+        if (stat_in_range(&st, shift)) {
+                r = 0;
+                goto finish;
+        }
 
         return recurse_fd(fd, donate_fd, &st, shift, true);
 
@@ -3219,6 +3219,7 @@ static int run(int master,
         _cleanup_(sd_event_unrefp) sd_event *event = NULL;
         _cleanup_(pty_forward_freep) PTYForward *forward = NULL;
         _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         ContainerStatus container_status = 0;
         char last_char = 0;
         int ifi = 0, r;
@@ -3326,6 +3327,20 @@ static int run(int master,
         notify_socket_pair[1] = safe_close(notify_socket_pair[1]);
         uid_shift_socket_pair[1] = safe_close(uid_shift_socket_pair[1]);
 
+        if (arg_register || !arg_keep_unit) {
+                const char *unique;
+
+                /* Connect to the bus while the child is busy setting up the container, so that the
+                 * authentication and Hello() round trips don't delay the registration later on. */
+                r = sd_bus_default_system(&bus);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to open system bus: %m");
+
+                r = sd_bus_get_unique_name(bus, &unique);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to connect to system bus: %m");
+        }
+
         if (arg_userns_mode != USER_NAMESPACE_NO) {
                 /* The child just let us know the UID shift it might have read from the image. */
                 l = recv(uid_shift_socket_pair[0], &arg_uid_shift, sizeof arg_uid_shift, 0);
@@ -3451,6 +3466,7 @@ static int run(int master,
 
         if (arg_register) {
                 r = register_machine(
+                                bus,
                                 arg_machine,
                                 *pid,
                                 arg_directory,
@@ -3466,6 +3482,7 @@ static int run(int master,
                         return r;
         } else if (!arg_keep_unit) {
                 r = allocate_scope(
+                                bus,
                                 arg_machine,
                                 *pid,
                                 arg_slice,
@@ -3515,6 +3532,14 @@ static int run(int master,
         if (r < 0)
                 return r;
 
+        /* Keep processing the bus connection while the container runs, so that nothing piles up on it until we
+         * need it again for terminating the machine. */
+        if (bus) {
+                r = sd_bus_attach_event(bus, event, 0);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to attach bus to event loop: %m");
+        }
+
         /* Let the child know that we are ready and wait that the child is completely ready now. */
         if (!barrier_place_and_sync(&barrier)) { /* #4 */
                 log_error("Child died too early.");
@@ -3572,8 +3597,20 @@ static int run(int master,
                 putc('\n', stdout);
 
         /* Kill if it is not dead yet anyway */
-        if (arg_register && !arg_keep_unit)
-                terminate_machine(*pid);
+        if (arg_register && !arg_keep_unit) {
+                /* The connection opened at start-up might have been closed since, for example if the bus
+                 * daemon was restarted while the container was running, hence reconnect in that case. */
+                if (!sd_bus_is_open(bus)) {
+                        bus = sd_bus_flush_close_unref(bus);
+
+                        r = sd_bus_open_system(&bus);
+                        if (r < 0)
+                                log_warning_errno(r, "Failed to reconnect to system bus, not terminating machine: %m");
+                }
+
+                if (bus)
+                        terminate_machine(bus, *pid);
+        }
 
         /* Normally redundant, but better safe than sorry */
         (void) kill(*pid, SIGKILL);
@@ -3809,7 +3846,7 @@ int main(int argc, char *argv[]) {
                                 goto finish;
                         }
 
-                        r = copy_file(arg_image, np, O_EXCL, arg_read_only ? 0400 : 0600, FS_NOCOW_FL, COPY_REFLINK);
+                        r = copy_file(arg_image, np, O_EXCL, arg_read_only ? 0400 : 0600, FS_NOCOW_FL, COPY_REFLINK|COPY_HOLES);
                         if (r < 0) {
                                 r = log_error_errno(r, "Failed to copy image file: %m");
                                 goto finish;
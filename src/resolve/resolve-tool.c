@@ -906,8 +906,9 @@ static int show_statistics(sd_bus *bus) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         uint64_t n_current_transactions, n_total_transactions,
-                cache_size, n_cache_hit, n_cache_miss,
+                cache_size, n_cache_hit, n_cache_miss, cache_memory, n_cache_evicted,
                 n_dnssec_secure, n_dnssec_insecure, n_dnssec_bogus, n_dnssec_indeterminate;
+        char size_str[FORMAT_BYTES_MAX];
         int r, dnssec_supported;
 
         assert(bus);
@@ -985,6 +986,30 @@ static int show_statistics(sd_bus *bus) {
 
         reply = sd_bus_message_unref(reply);
 
+        r = sd_bus_get_property(bus,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                "CacheMemoryStatistics",
+                                &error,
+                                &reply,
+                                "(tt)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cache memory statistics: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_read(reply, "(tt)",
+                                &cache_memory,
+                                &n_cache_evicted);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        printf("        Cache Memory: %s\n"
+               "     Cache Evictions: %" PRIu64 "\n",
+               format_bytes(size_str, sizeof size_str, cache_memory),
+               n_cache_evicted);
+
+        reply = sd_bus_message_unref(reply);
+
         r = sd_bus_get_property(bus,
                                 "org.freedesktop.resolve1",
                                 "/org/freedesktop/resolve1",
@@ -1382,6 +1382,30 @@ static int bus_property_get_cache_statistics(
         return sd_bus_message_append(reply, "(ttt)", size, hit, miss);
 }
 
+static int bus_property_get_cache_memory_statistics(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        uint64_t size = 0, evicted = 0;
+        Manager *m = userdata;
+        DnsScope *s;
+
+        assert(reply);
+        assert(m);
+
+        LIST_FOREACH(scopes, s, m->dns_scopes) {
+                size += s->cache.size;
+                evicted += s->cache.n_evicted;
+        }
+
+        return sd_bus_message_append(reply, "(tt)", size, evicted);
+}
+
 static int bus_property_get_dnssec_statistics(
                 sd_bus *bus,
                 const char *path,
@@ -1460,7 +1484,7 @@ static int bus_method_reset_statistics(sd_bus_message *message, void *userdata,
         assert(m);
 
         LIST_FOREACH(scopes, s, m->dns_scopes)
-                s->cache.n_hit = s->cache.n_miss = 0;
+                s->cache.n_hit = s->cache.n_miss = s->cache.n_evicted = 0;
 
         m->n_transactions_total = 0;
         zero(m->n_dnssec_verdict);
@@ -1576,6 +1600,7 @@ static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_PROPERTY("Domains", "a(isb)", bus_property_get_domains, 0, 0),
         SD_BUS_PROPERTY("TransactionStatistics", "(tt)", bus_property_get_transaction_statistics, 0, 0),
         SD_BUS_PROPERTY("CacheStatistics", "(ttt)", bus_property_get_cache_statistics, 0, 0),
+        SD_BUS_PROPERTY("CacheMemoryStatistics", "(tt)", bus_property_get_cache_memory_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSECStatistics", "(tttt)", bus_property_get_dnssec_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSECSupported", "b", bus_property_get_dnssec_supported, 0, 0),
         SD_BUS_PROPERTY("DNSSECNegativeTrustAnchors", "as", bus_property_get_ntas, 0, 0),
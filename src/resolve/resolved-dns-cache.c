@@ -22,15 +22,14 @@
 #include "af-list.h"
 #include "alloc-util.h"
 #include "dns-domain.h"
+#include "extract-word.h"
+#include "hexdecoct.h"
+#include "parse-util.h"
 #include "resolved-dns-answer.h"
 #include "resolved-dns-cache.h"
 #include "resolved-dns-packet.h"
 #include "string-util.h"
 
-/* Never cache more than 4K entries. RFC 1536, Section 5 suggests to
- * leave DNS caches unbounded, but that's crazy. */
-#define CACHE_MAX 4096
-
 /* We never keep any item longer than 2h in our cache */
 #define CACHE_TTL_MAX_USEC (2 * USEC_PER_HOUR)
 
@@ -38,8 +37,12 @@
  * now) */
 #define CACHE_TTL_STRANGE_RCODE_USEC (30 * USEC_PER_SEC)
 
+/* Items that are hit this often and are in the last tenth of their lifetime are suggested for refreshing before they
+ * expire, so that popular names don't cause a burst of cache misses every TTL period */
+#define CACHE_PREFETCH_HITS_MIN 4U
+#define CACHE_PREFETCH_LIFETIME_DIV 10U
+
 typedef enum DnsCacheItemType DnsCacheItemType;
-typedef struct DnsCacheItem DnsCacheItem;
 
 enum DnsCacheItemType {
         DNS_CACHE_POSITIVE,
@@ -54,16 +57,22 @@ struct DnsCacheItem {
         DnsResourceRecord *rr;
         int rcode;
 
-        usec_t until;
+        usec_t added, until;
+        unsigned n_hit;
         bool authenticated:1;
         bool shared_owner:1;
+        bool prefetching:1; /* a refresh was suggested already, see dns_cache_item_want_prefetch() */
 
         int ifindex;
         int owner_family;
         union in_addr_union owner_address;
 
+        /* What this item was accounted for in the cache size */
+        size_t size;
+
         unsigned prioq_idx;
         LIST_FIELDS(DnsCacheItem, by_key);
+        LIST_FIELDS(DnsCacheItem, by_lru);
 };
 
 static const char *dns_cache_item_type_to_string(DnsCacheItem *item) {
@@ -98,6 +107,139 @@ static void dns_cache_item_free(DnsCacheItem *i) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(DnsCacheItem*, dns_cache_item_free);
 
+static size_t dns_resource_record_data_size(DnsResourceRecord *rr) {
+        DnsTxtItem *t;
+        size_t sz = 0;
+
+        assert(rr);
+
+        /* The heap memory the parsed RR data points to. Fixed-size fields are covered by
+         * sizeof(DnsResourceRecord) already. */
+
+        if (rr->unparseable)
+                return rr->generic.data_size;
+
+        switch (rr->key->type) {
+
+        case DNS_TYPE_SRV:
+                return strlen_ptr(rr->srv.name) + 1;
+
+        case DNS_TYPE_PTR:
+        case DNS_TYPE_NS:
+        case DNS_TYPE_CNAME:
+        case DNS_TYPE_DNAME:
+                return strlen_ptr(rr->ptr.name) + 1;
+
+        case DNS_TYPE_HINFO:
+                return strlen_ptr(rr->hinfo.cpu) + strlen_ptr(rr->hinfo.os) + 2;
+
+        case DNS_TYPE_TXT:
+        case DNS_TYPE_SPF:
+                LIST_FOREACH(items, t, rr->txt.items)
+                        sz += sizeof(DnsTxtItem) + t->length + 1;
+                return sz;
+
+        case DNS_TYPE_SOA:
+                return strlen_ptr(rr->soa.mname) + strlen_ptr(rr->soa.rname) + 2;
+
+        case DNS_TYPE_MX:
+                return strlen_ptr(rr->mx.exchange) + 1;
+
+        case DNS_TYPE_DS:
+                return rr->ds.digest_size;
+
+        case DNS_TYPE_SSHFP:
+                return rr->sshfp.fingerprint_size;
+
+        case DNS_TYPE_DNSKEY:
+                return rr->dnskey.key_size;
+
+        case DNS_TYPE_RRSIG:
+                return strlen_ptr(rr->rrsig.signer) + 1 + rr->rrsig.signature_size;
+
+        case DNS_TYPE_NSEC:
+                return strlen_ptr(rr->nsec.next_domain_name) + 1;
+
+        case DNS_TYPE_NSEC3:
+                return rr->nsec3.salt_size + rr->nsec3.next_hashed_name_size;
+
+        case DNS_TYPE_LOC:
+        case DNS_TYPE_A:
+        case DNS_TYPE_AAAA:
+                return 0;
+
+        case DNS_TYPE_TLSA:
+                return rr->tlsa.data_size;
+
+        case DNS_TYPE_CAA:
+                return strlen_ptr(rr->caa.tag) + 1 + rr->caa.value_size;
+
+        case DNS_TYPE_OPENPGPKEY:
+        default:
+                return rr->generic.data_size;
+        }
+}
+
+static size_t dns_cache_item_size(DnsResourceKey *key, DnsResourceRecord *rr) {
+        size_t sz;
+
+        /* A rough estimate of the memory an item keeps alive: the item itself, its key and the RR including
+         * whatever it allocated. This is called for every RR added, hence don't serialize anything here. */
+
+        sz = sizeof(DnsCacheItem);
+
+        if (key)
+                sz += sizeof(DnsResourceKey) + strlen(dns_resource_key_name(key)) + 1;
+
+        if (rr)
+                sz += sizeof(DnsResourceRecord) + dns_resource_record_data_size(rr) +
+                        rr->wire_format_size + strlen_ptr(rr->to_string);
+
+        return sz;
+}
+
+static void dns_cache_lru_link(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        LIST_PREPEND(by_lru, c->by_lru, i);
+        if (!c->lru_tail)
+                c->lru_tail = i;
+}
+
+static void dns_cache_lru_unlink(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        if (c->lru_tail == i)
+                c->lru_tail = i->by_lru_prev;
+        LIST_REMOVE(by_lru, c->by_lru, i);
+}
+
+static void dns_cache_item_touch(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        if (c->by_lru == i)
+                return;
+
+        dns_cache_lru_unlink(c, i);
+        dns_cache_lru_link(c, i);
+}
+
+static void dns_cache_item_forget(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        /* Drops the item from the expiry and LRU lists, the caller deals with the by_key list */
+
+        prioq_remove(c->by_expiry, i, &i->prioq_idx);
+        dns_cache_lru_unlink(c, i);
+
+        assert(c->size >= i->size);
+        c->size -= i->size;
+}
+
 static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         DnsCacheItem *first;
 
@@ -114,8 +256,7 @@ static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         else
                 hashmap_remove(c->by_key, i->key);
 
-        prioq_remove(c->by_expiry, i, &i->prioq_idx);
-
+        dns_cache_item_forget(c, i);
         dns_cache_item_free(i);
 }
 
@@ -148,7 +289,7 @@ static bool dns_cache_remove_by_key(DnsCache *c, DnsResourceKey *key) {
                 return false;
 
         LIST_FOREACH_SAFE(by_key, i, n, first) {
-                prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                dns_cache_item_forget(c, i);
                 dns_cache_item_free(i);
         }
 
@@ -165,39 +306,40 @@ void dns_cache_flush(DnsCache *c) {
 
         assert(hashmap_size(c->by_key) == 0);
         assert(prioq_size(c->by_expiry) == 0);
+        assert(!c->by_lru && !c->lru_tail);
+        assert(c->size == 0);
 
         c->by_key = hashmap_free(c->by_key);
         c->by_expiry = prioq_free(c->by_expiry);
 }
 
-static void dns_cache_make_space(DnsCache *c, unsigned add) {
+static void dns_cache_make_space(DnsCache *c, size_t add) {
         assert(c);
 
         if (add <= 0)
                 return;
 
-        /* Makes space for n new entries. Note that we actually allow
-         * the cache to grow beyond CACHE_MAX, but only when we shall
-         * add more RRs to the cache than CACHE_MAX at once. In that
-         * case the cache will be emptied completely otherwise. */
-
-        for (;;) {
-                _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
-                DnsCacheItem *i;
+        /* Makes space for new entries of the specified estimated size, evicting the least recently used keys
+         * first. Note that we actually allow the cache to grow beyond its budget, but only when we shall add more at
+         * once than fits into it. In that case the cache will be emptied completely otherwise. */
 
-                if (prioq_size(c->by_expiry) <= 0)
-                        break;
+        if (c->size + add <= c->size_max)
+                return;
 
-                if (prioq_size(c->by_expiry) + add < CACHE_MAX)
-                        break;
+        /* Before throwing away anything still valid, get rid of what is expired anyway */
+        dns_cache_prune(c);
 
-                i = prioq_peek(c->by_expiry);
-                assert(i);
+        while (c->lru_tail && c->size + add > c->size_max) {
+                _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+                unsigned n;
 
                 /* Take an extra reference to the key so that it
                  * doesn't go away in the middle of the remove call */
-                key = dns_resource_key_ref(i->key);
+                key = dns_resource_key_ref(c->lru_tail->key);
+
+                n = prioq_size(c->by_expiry);
                 dns_cache_remove_by_key(c, key);
+                c->n_evicted += n - prioq_size(c->by_expiry);
         }
 }
 
@@ -304,6 +446,10 @@ static int dns_cache_link_item(DnsCache *c, DnsCacheItem *i) {
                 }
         }
 
+        i->size = dns_cache_item_size(i->key, i->rr);
+        c->size += i->size;
+        dns_cache_lru_link(c, i);
+
         return 0;
 }
 
@@ -387,7 +533,10 @@ static void dns_cache_item_update_positive(
         dns_resource_key_unref(i->key);
         i->key = dns_resource_key_ref(rr->key);
 
+        i->added = timestamp;
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
+        i->n_hit = 0;
+        i->prefetching = false;
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
 
@@ -396,7 +545,12 @@ static void dns_cache_item_update_positive(
         i->owner_family = owner_family;
         i->owner_address = *owner_address;
 
+        c->size -= i->size;
+        i->size = dns_cache_item_size(i->key, i->rr);
+        c->size += i->size;
+
         prioq_reshuffle(c->by_expiry, i, &i->prioq_idx);
+        dns_cache_item_touch(c, i);
 }
 
 static int dns_cache_put_positive(
@@ -454,7 +608,7 @@ static int dns_cache_put_positive(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
+        dns_cache_make_space(c, dns_cache_item_size(rr->key, rr));
 
         i = new0(DnsCacheItem, 1);
         if (!i)
@@ -463,6 +617,7 @@ static int dns_cache_put_positive(
         i->type = DNS_CACHE_POSITIVE;
         i->key = dns_resource_key_ref(rr->key);
         i->rr = dns_resource_record_ref(rr);
+        i->added = timestamp;
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
@@ -538,7 +693,7 @@ static int dns_cache_put_negative(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
+        dns_cache_make_space(c, dns_cache_item_size(key, NULL));
 
         i = new0(DnsCacheItem, 1);
         if (!i)
@@ -547,6 +702,7 @@ static int dns_cache_put_negative(
         i->type =
                 rcode == DNS_RCODE_SUCCESS ? DNS_CACHE_NODATA :
                 rcode == DNS_RCODE_NXDOMAIN ? DNS_CACHE_NXDOMAIN : DNS_CACHE_RCODE;
+        i->added = timestamp;
         i->until =
                 i->type == DNS_CACHE_RCODE ? timestamp + CACHE_TTL_STRANGE_RCODE_USEC :
                 calculate_until(soa, nsec_ttl, timestamp, true);
@@ -652,7 +808,7 @@ int dns_cache_put(
         DnsResourceRecord *soa = NULL, *rr;
         bool weird_rcode = false;
         DnsAnswerFlags flags;
-        unsigned cache_keys;
+        size_t cache_size;
         int r, ifindex;
 
         assert(c);
@@ -684,12 +840,14 @@ int dns_cache_put(
                 weird_rcode = true;
         }
 
-        cache_keys = dns_answer_size(answer);
+        cache_size = 0;
+        DNS_ANSWER_FOREACH(rr, answer)
+                cache_size += dns_cache_item_size(rr->key, rr);
         if (key)
-                cache_keys++;
+                cache_size += dns_cache_item_size(key, NULL);
 
         /* Make some space for our new entries */
-        dns_cache_make_space(c, cache_keys);
+        dns_cache_make_space(c, cache_size);
 
         if (timestamp <= 0)
                 timestamp = now(clock_boottime_or_monotonic());
@@ -837,7 +995,24 @@ static DnsCacheItem *dns_cache_get_by_key_follow_cname_dname_nsec(DnsCache *c, D
         return NULL;
 }
 
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated) {
+static bool dns_cache_item_want_prefetch(DnsCacheItem *i, usec_t current) {
+        assert(i);
+
+        /* Strange rcodes are cached only briefly anyway, don't make them stick */
+        if (i->type == DNS_CACHE_RCODE)
+                return false;
+
+        /* Refreshing it is in progress already. If the refresh fails the item simply expires. */
+        if (i->prefetching)
+                return false;
+
+        if (i->n_hit < CACHE_PREFETCH_HITS_MIN)
+                return false;
+
+        return current + (i->until - i->added) / CACHE_PREFETCH_LIFETIME_DIV >= i->until;
+}
+
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated, bool *prefetch) {
         _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
         char key_str[DNS_RESOURCE_KEY_STRING_MAX];
         unsigned n = 0;
@@ -853,6 +1028,9 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         assert(rcode);
         assert(ret);
         assert(authenticated);
+        assert(prefetch);
+
+        *prefetch = false;
 
         if (key->type == DNS_TYPE_ANY || key->class == DNS_CLASS_ANY) {
                 /* If we have ANY lookups we don't use the cache, so
@@ -886,7 +1064,19 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 return 0;
         }
 
+        current = now(clock_boottime_or_monotonic());
+
+        /* Suggest a refresh only once per item, so that the caller doesn't start a new one for each lookup while the
+         * previous is still in progress. The flag goes away with the item once the refreshed answer is cached. */
+        first->n_hit++;
+        if (dns_cache_item_want_prefetch(first, current)) {
+                first->prefetching = true;
+                *prefetch = true;
+        }
+
         LIST_FOREACH(by_key, j, first) {
+                dns_cache_item_touch(c, j);
+
                 if (j->rr) {
                         if (j->rr->key->type == DNS_TYPE_NSEC)
                                 nsec = j;
@@ -960,9 +1150,6 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         if (!answer)
                 return -ENOMEM;
 
-        if (clamp_ttl)
-                current = now(clock_boottime_or_monotonic());
-
         LIST_FOREACH(by_key, j, first) {
                 _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
 
@@ -1116,6 +1303,139 @@ void dns_cache_dump(DnsCache *cache, FILE *f) {
         }
 }
 
+int dns_cache_save(DnsCache *cache, FILE *f) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        usec_t n_boot, n_real;
+        Iterator iterator;
+        DnsCacheItem *i;
+        int r;
+
+        assert(cache);
+        assert(f);
+
+        /* Writes out all positive items, one per line, in wire format and with an absolute expiry time in
+         * CLOCK_REALTIME, so that they can be loaded again by the next instance, see dns_cache_load_item(). */
+
+        r = dns_packet_new(&p, DNS_PROTOCOL_DNS, 0);
+        if (r < 0)
+                return r;
+
+        p->refuse_compression = true;
+
+        n_boot = now(clock_boottime_or_monotonic());
+        n_real = now(CLOCK_REALTIME);
+
+        HASHMAP_FOREACH(i, cache->by_key, iterator) {
+                DnsCacheItem *j;
+
+                LIST_FOREACH(by_key, j, i) {
+                        _cleanup_free_ char *b = NULL;
+                        size_t start;
+                        ssize_t l;
+
+                        if (j->type != DNS_CACHE_POSITIVE || j->shared_owner)
+                                continue;
+
+                        if (j->until <= n_boot)
+                                continue;
+
+                        r = dns_packet_append_rr(p, j->rr, 0, &start, NULL);
+                        if (r < 0)
+                                return r;
+
+                        l = base64mem(DNS_PACKET_DATA(p) + start, p->size - start, &b);
+                        dns_packet_truncate(p, start);
+                        if (l < 0)
+                                return l;
+
+                        fprintf(f, "rr " USEC_FMT " %s %s\n",
+                                n_real + (j->until - n_boot),
+                                one_zero(j->authenticated),
+                                b);
+                }
+        }
+
+        return 0;
+}
+
+int dns_cache_load_item(
+                DnsCache *cache,
+                const char *line,
+                int ifindex,
+                int owner_family,
+                const union in_addr_union *owner_address) {
+
+        _cleanup_free_ char *until_str = NULL, *authenticated_str = NULL, *data_str = NULL;
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        _cleanup_free_ void *data = NULL;
+        usec_t until, n_real;
+        int r, authenticated;
+        size_t size;
+
+        assert(cache);
+        assert(line);
+        assert(owner_address);
+
+        /* Parses a line written by dns_cache_save(). Returns 0 if the item expired in the meantime, > 0 if it was
+         * added. */
+
+        r = extract_many_words(&line, NULL, 0, &until_str, &authenticated_str, &data_str, NULL);
+        if (r < 0)
+                return r;
+        if (r != 3 || !isempty(line))
+                return -EINVAL;
+
+        r = safe_atou64(until_str, &until);
+        if (r < 0)
+                return r;
+
+        authenticated = parse_boolean(authenticated_str);
+        if (authenticated < 0)
+                return authenticated;
+
+        r = unbase64mem(data_str, strlen(data_str), &data, &size);
+        if (r < 0)
+                return r;
+
+        r = dns_packet_new(&p, DNS_PROTOCOL_DNS, size);
+        if (r < 0)
+                return r;
+
+        r = dns_packet_append_blob(p, data, size, NULL);
+        if (r < 0)
+                return r;
+
+        r = dns_packet_read_rr(p, &rr, NULL, NULL);
+        if (r < 0)
+                return r;
+        if (p->rindex != p->size)
+                return -EBADMSG;
+
+        /* Only keep what remains of the TTL, and don't bother with what is about to expire anyway */
+        n_real = now(CLOCK_REALTIME);
+        if (until < n_real + USEC_PER_SEC)
+                return 0;
+
+        r = dns_resource_record_clamp_ttl(&rr, MIN((until - n_real) / USEC_PER_SEC, (usec_t) UINT32_MAX));
+        if (r < 0)
+                return r;
+
+        r = dns_cache_put_positive(
+                        cache,
+                        rr,
+                        authenticated,
+                        false,
+                        now(clock_boottime_or_monotonic()),
+                        ifindex,
+                        owner_family,
+                        owner_address);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
 bool dns_cache_is_empty(DnsCache *cache) {
         if (!cache)
                 return true;
@@ -24,11 +24,26 @@
 #include "prioq.h"
 #include "time-util.h"
 
+/* Default memory budget of each scope's cache */
+#define CACHE_SIZE_MAX_DEFAULT (4U*1024U*1024U)
+
+typedef struct DnsCacheItem DnsCacheItem;
+
 typedef struct DnsCache {
         Hashmap *by_key;
         Prioq *by_expiry;
+
+        /* All items, most recently used first */
+        LIST_HEAD(DnsCacheItem, by_lru);
+        DnsCacheItem *lru_tail;
+
+        /* Estimated memory used by the items, and the budget for it */
+        size_t size;
+        size_t size_max;
+
         unsigned n_hit;
         unsigned n_miss;
+        unsigned n_evicted;
 } DnsCache;
 
 #include "resolved-dns-answer.h"
@@ -40,11 +55,14 @@ void dns_cache_flush(DnsCache *c);
 void dns_cache_prune(DnsCache *c);
 
 int dns_cache_put(DnsCache *c, DnsResourceKey *key, int rcode, DnsAnswer *answer, bool authenticated, uint32_t nsec_ttl, usec_t timestamp, int owner_family, const union in_addr_union *owner_address);
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated);
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated, bool *prefetch);
 
 int dns_cache_check_conflicts(DnsCache *cache, DnsResourceRecord *rr, int owner_family, const union in_addr_union *owner_address);
 
 void dns_cache_dump(DnsCache *cache, FILE *f);
+
+int dns_cache_save(DnsCache *cache, FILE *f);
+int dns_cache_load_item(DnsCache *cache, const char *line, int ifindex, int owner_family, const union in_addr_union *owner_address);
 bool dns_cache_is_empty(DnsCache *cache);
 
 unsigned dns_cache_size(DnsCache *cache);
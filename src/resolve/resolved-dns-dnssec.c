@@ -38,6 +38,9 @@
 /* Maximum number of NSEC3 iterations we'll do. RFC5155 says 2500 shall be the maximum useful value */
 #define NSEC3_ITERATIONS_MAX 2500
 
+/* Number of successfully verified signatures we remember */
+#define VERIFIED_CACHE_SIZE 1024U
+
 /*
  * The DNSSEC Chain of trust:
  *
@@ -449,6 +452,57 @@ static void md_add_uint32(gcry_md_hd_t md, uint32_t v) {
         gcry_md_write(md, &v, sizeof(v));
 }
 
+/* Verifying RSA and ECDSA signatures is by far the most expensive part of DNSSEC validation, and the same RRsets are
+ * validated again and again, by different transactions and scopes. Hence, remember the signatures we verified
+ * successfully recently, identified by a digest over the hash of the signed data, the signature and the key. Entries
+ * don't need to expire, as the validity period of the signature is checked before we look here, and the TTL of the
+ * RRset is fixed up each time anyway. They are simply replaced when another signature maps to the same slot. */
+static uint8_t verified_cache[VERIFIED_CACHE_SIZE][32];
+
+static int dnssec_verified_digest(
+                const void *hash,
+                size_t hash_size,
+                DnsResourceRecord *rrsig,
+                DnsResourceRecord *dnskey,
+                uint8_t ret[static 32]) {
+
+        gcry_md_hd_t md = NULL;
+        void *digest;
+
+        assert(hash);
+        assert(rrsig);
+        assert(dnskey);
+
+        assert(gcry_md_get_algo_dlen(GCRY_MD_SHA256) == 32);
+
+        gcry_md_open(&md, GCRY_MD_SHA256, 0);
+        if (!md)
+                return -EIO;
+
+        md_add_uint8(md, rrsig->rrsig.algorithm);
+        md_add_uint16(md, (uint16_t) hash_size);
+        gcry_md_write(md, hash, hash_size);
+        md_add_uint16(md, (uint16_t) rrsig->rrsig.signature_size);
+        gcry_md_write(md, rrsig->rrsig.signature, rrsig->rrsig.signature_size);
+        md_add_uint16(md, (uint16_t) dnskey->dnskey.key_size);
+        gcry_md_write(md, dnskey->dnskey.key, dnskey->dnskey.key_size);
+
+        digest = gcry_md_read(md, 0);
+        if (!digest) {
+                gcry_md_close(md);
+                return -EIO;
+        }
+
+        memcpy(ret, digest, 32);
+        gcry_md_close(md);
+
+        return 0;
+}
+
+static uint8_t *dnssec_verified_slot(const uint8_t digest[static 32]) {
+        return verified_cache[((size_t) digest[0] << 8 | (size_t) digest[1]) % VERIFIED_CACHE_SIZE];
+}
+
 static int dnssec_rrsig_prepare(DnsResourceRecord *rrsig) {
         int n_key_labels, n_signer_labels;
         const char *name;
@@ -606,7 +660,7 @@ int dnssec_verify_rrset(
                 usec_t realtime,
                 DnssecResult *result) {
 
-        uint8_t wire_format_name[DNS_WIRE_FOMAT_HOSTNAME_MAX];
+        uint8_t wire_format_name[DNS_WIRE_FOMAT_HOSTNAME_MAX], digest[32], *slot;
         DnsResourceRecord **list, *rr;
         const char *source, *name;
         gcry_md_hd_t md = NULL;
@@ -779,6 +833,16 @@ int dnssec_verify_rrset(
                 goto finish;
         }
 
+        r = dnssec_verified_digest(hash, hash_size, rrsig, dnskey, digest);
+        if (r < 0)
+                goto finish;
+
+        slot = dnssec_verified_slot(digest);
+        if (memcmp(slot, digest, sizeof(digest)) == 0) {
+                r = 1;
+                goto verified;
+        }
+
         switch (rrsig->rrsig.algorithm) {
 
         case DNSSEC_ALGORITHM_RSASHA1:
@@ -806,6 +870,11 @@ int dnssec_verify_rrset(
         if (r < 0)
                 goto finish;
 
+        /* Only remember successful verifications, anyone can make us verify rubbish */
+        if (r > 0)
+                memcpy(slot, digest, sizeof(digest));
+
+verified:
         /* Now, fix the ttl, expiry, and remember the synthesizing source and the signer */
         if (r > 0)
                 dnssec_fix_rrset_ttl(list, n, rrsig, realtime);
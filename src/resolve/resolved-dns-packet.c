@@ -170,6 +170,7 @@ DnsPacket *dns_packet_ref(DnsPacket *p) {
 }
 
 static void dns_packet_free(DnsPacket *p) {
+        DnsResourceKey *k;
         char *s;
 
         assert(p);
@@ -182,6 +183,10 @@ static void dns_packet_free(DnsPacket *p) {
                 free(s);
         hashmap_free(p->names);
 
+        while ((k = hashmap_steal_first(p->read_keys)))
+                dns_resource_key_unref(k);
+        hashmap_free(p->read_keys);
+
         free(p->_data);
 
         if (!p->on_stack)
@@ -353,6 +358,7 @@ static int dns_packet_extend(DnsPacket *p, size_t add, void **ret, size_t *start
 }
 
 void dns_packet_truncate(DnsPacket *p, size_t sz) {
+        DnsResourceKey *k;
         Iterator i;
         char *s;
         void *n;
@@ -371,6 +377,15 @@ void dns_packet_truncate(DnsPacket *p, size_t sz) {
                 free(s);
         }
 
+        HASHMAP_FOREACH_KEY(k, n, p->read_keys, i) {
+
+                if (PTR_TO_SIZE(n) < sz)
+                        continue;
+
+                hashmap_remove(p->read_keys, n);
+                dns_resource_key_unref(k);
+        }
+
         p->size = sz;
 }
 
@@ -1558,19 +1573,48 @@ static int dns_packet_read_type_windows(DnsPacket *p, Bitmap **types, size_t siz
         return 0;
 }
 
+static size_t dns_packet_peek_name_offset(DnsPacket *p) {
+        const uint8_t *d;
+
+        assert(p);
+
+        /* If the name at the read index consists of nothing but a compression pointer, returns where it points to,
+         * otherwise the read index itself. Either way, the same offset means the same name. */
+
+        if (p->refuse_compression || p->rindex + 2 > p->size)
+                return p->rindex;
+
+        d = DNS_PACKET_DATA(p) + p->rindex;
+        if ((d[0] & 0xc0) != 0xc0)
+                return p->rindex;
+
+        return (size_t) (d[0] & ~0xc0) << 8 | (size_t) d[1];
+}
+
 int dns_packet_read_key(DnsPacket *p, DnsResourceKey **ret, bool *ret_cache_flush, size_t *start) {
         _cleanup_(rewind_dns_packet) DnsPacketRewinder rewinder;
         _cleanup_free_ char *name = NULL;
+        DnsResourceKey *key, *cached = NULL;
         bool cache_flush = false;
         uint16_t class, type;
-        DnsResourceKey *key;
+        size_t offset;
         int r;
 
         assert(p);
         assert(ret);
         INIT_REWINDER(rewinder, p);
 
-        r = dns_packet_read_name(p, &name, true, NULL);
+        /* The owner names of RRs are usually compression pointers to a name we read already, most commonly the one of
+         * the question. In that case, reuse the key we made for it, instead of decompressing and allocating the same
+         * name again for each RR. */
+        offset = dns_packet_peek_name_offset(p);
+        if (offset < p->rindex)
+                cached = hashmap_get(p->read_keys, SIZE_TO_PTR(offset));
+
+        if (cached)
+                r = dns_packet_read(p, 2, NULL, NULL);
+        else
+                r = dns_packet_read_name(p, &name, true, NULL);
         if (r < 0)
                 return r;
 
@@ -1591,11 +1635,34 @@ int dns_packet_read_key(DnsPacket *p, DnsResourceKey **ret, bool *ret_cache_flus
                 }
         }
 
-        key = dns_resource_key_new_consume(class, type, name);
-        if (!key)
-                return -ENOMEM;
+        if (cached && cached->class == class && cached->type == type)
+                key = dns_resource_key_ref(cached);
+        else {
+                if (cached) {
+                        name = strdup(dns_resource_key_name(cached));
+                        if (!name)
+                                return -ENOMEM;
+                }
+
+                key = dns_resource_key_new_consume(class, type, name);
+                if (!key)
+                        return -ENOMEM;
+
+                name = NULL;
+
+                /* Remember the first key read for each name */
+                if (!cached) {
+                        r = hashmap_ensure_allocated(&p->read_keys, NULL);
+                        if (r < 0) {
+                                dns_resource_key_unref(key);
+                                return r;
+                        }
+
+                        if (hashmap_put(p->read_keys, SIZE_TO_PTR(offset), key) > 0)
+                                dns_resource_key_ref(key);
+                }
+        }
 
-        name = NULL;
         *ret = key;
 
         if (ret_cache_flush)
@@ -76,6 +76,7 @@ struct DnsPacket {
         size_t size, allocated, rindex;
         void *_data; /* don't access directly, use DNS_PACKET_DATA()! */
         Hashmap *names; /* For name compression */
+        Hashmap *read_keys; /* Keys read so far, by the offset of their name, so that RRs may share them */
         size_t opt_start, opt_size;
 
         /* Parsed data */
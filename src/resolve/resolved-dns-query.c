@@ -839,6 +839,10 @@ static void dns_query_accept(DnsQuery *q, DnsQueryCandidate *c) {
                         q->answer_rcode = t->answer_rcode;
                         q->answer_errno = 0;
 
+                        if (t->answer_source != DNS_TRANSACTION_CACHE &&
+                            (t->answer_source != DNS_TRANSACTION_NETWORK || !t->received || !DNS_PACKET_SHALL_CACHE(t->received)))
+                                q->answer_uncacheable = true;
+
                         if (t->answer_authenticated) {
                                 has_authenticated = true;
                                 dnssec_result_authenticated = t->answer_dnssec_result;
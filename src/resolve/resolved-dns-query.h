@@ -74,6 +74,10 @@ struct DnsQuery {
         /* If true, the RR TTLs of the answer will be clamped by their current left validity in the cache */
         bool clamp_ttl;
 
+        /* If true, some part of the answer did not come from, and would not have been put into, the cache. This is
+         * sticky across CNAME redirects. */
+        bool answer_uncacheable;
+
         DnsTransactionState state;
         unsigned n_cname_redirects;
 
@@ -27,6 +27,7 @@
 #include "missing.h"
 #include "random-util.h"
 #include "resolved-dns-scope.h"
+#include "resolved-dns-stub.h"
 #include "resolved-llmnr.h"
 #include "resolved-mdns.h"
 #include "socket-util.h"
@@ -54,6 +55,7 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
         s->protocol = protocol;
         s->family = family;
         s->resend_timeout = MULTICAST_RESEND_TIMEOUT_MIN_USEC;
+        s->cache.size_max = m->cache_size_max;
 
         if (protocol == DNS_PROTOCOL_DNS) {
                 /* Copy DNSSEC mode from the link if it is set there,
@@ -128,6 +130,7 @@ DnsScope* dns_scope_free(DnsScope *s) {
 
         dns_cache_flush(&s->cache);
         dns_zone_flush(&s->zone);
+        manager_dns_stub_flush_replies(s->manager);
 
         LIST_REMOVE(scopes, s->manager->dns_scopes, s);
         return mfree(s);
@@ -138,6 +138,8 @@ DnsServer* dns_server_unref(DnsServer *s)  {
         if (s->n_ref > 0)
                 return NULL;
 
+        dns_server_unref_stream(s);
+
         free(s->server_string);
         return mfree(s);
 }
@@ -183,9 +185,28 @@ void dns_server_unlink(DnsServer *s) {
         if (s->manager->current_dns_server == s)
                 manager_set_dns_server(s->manager, NULL);
 
+        /* Transactions still waiting for replies keep the connection open, but no new ones shall use it */
+        dns_server_unref_stream(s);
+
         dns_server_unref(s);
 }
 
+void dns_server_unref_stream(DnsServer *s) {
+        DnsStream *prev;
+
+        assert(s);
+
+        /* Detaches the pooled TCP stream from the server, so that later transactions open a new one */
+
+        prev = s->stream;
+        if (!prev)
+                return;
+
+        s->stream = NULL;
+        prev->server = NULL;
+        dns_stream_unref(prev);
+}
+
 void dns_server_move_back_and_unmark(DnsServer *s) {
         DnsServer *tail;
 
@@ -728,6 +749,7 @@ DnsServer *manager_set_dns_server(Manager *m, DnsServer *s) {
 
         if (m->unicast_scope)
                 dns_cache_flush(&m->unicast_scope->cache);
+        manager_dns_stub_flush_replies(m);
 
         return s;
 }
@@ -826,6 +848,7 @@ void dns_server_flush_cache(DnsServer *s) {
                 return;
 
         dns_cache_flush(&scope->cache);
+        manager_dns_stub_flush_replies(s->manager);
 }
 
 static const char* const dns_server_type_table[_DNS_SERVER_TYPE_MAX] = {
@@ -84,6 +84,9 @@ struct DnsServer {
         usec_t verified_usec;
         usec_t features_grace_period_usec;
 
+        /* The TCP connection to the server shared by all transactions using it, if there is one */
+        DnsStream *stream;
+
         /* Whether we already warned about downgrading to non-DNSSEC mode for this server */
         bool warned_downgrade:1;
 
@@ -108,6 +111,7 @@ DnsServer* dns_server_ref(DnsServer *s);
 DnsServer* dns_server_unref(DnsServer *s);
 
 void dns_server_unlink(DnsServer *s);
+void dns_server_unref_stream(DnsServer *s);
 void dns_server_move_back_and_unmark(DnsServer *s);
 
 void dns_server_packet_received(DnsServer *s, int protocol, DnsServerFeatureLevel level, usec_t rtt, size_t size);
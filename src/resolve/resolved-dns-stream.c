@@ -28,6 +28,8 @@
 #define DNS_STREAM_TIMEOUT_USEC (10 * USEC_PER_SEC)
 #define DNS_STREAMS_MAX 128
 
+DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStream*, dns_stream_unref);
+
 static void dns_stream_stop(DnsStream *s) {
         assert(s);
 
@@ -49,6 +51,17 @@ static int dns_stream_update_io(DnsStream *s) {
         return sd_event_source_set_io_events(s->io_event_source, f);
 }
 
+static void dns_stream_reset_timeout(DnsStream *s) {
+        assert(s);
+
+        /* Persistent streams are closed only after they have been idle for a while */
+
+        if (!s->timeout_event_source)
+                return;
+
+        (void) sd_event_source_set_time(s->timeout_event_source, now(clock_boottime_or_monotonic()) + DNS_STREAM_TIMEOUT_USEC);
+}
+
 static int dns_stream_complete(DnsStream *s, int error) {
         assert(s);
 
@@ -196,7 +209,7 @@ static int on_stream_timeout(sd_event_source *es, usec_t usec, void *userdata) {
 }
 
 static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
-        DnsStream *s = userdata;
+        _cleanup_(dns_stream_unrefp) DnsStream *s = dns_stream_ref(userdata); /* Protect stream while we process it */
         int r;
 
         assert(s);
@@ -226,8 +239,18 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                 } else
                         s->n_written += ss;
 
-                /* Are we done? If so, disable the event source for EPOLLOUT */
+                /* Are we done? If so, continue with the next queued packet, or disable the event source for
+                 * EPOLLOUT */
                 if (s->n_written >= sizeof(s->write_size) + s->write_packet->size) {
+                        if (s->persistent) {
+                                dns_packet_unref(s->write_packet);
+                                s->write_packet = ordered_set_steal_first(s->write_queue);
+                                if (s->write_packet) {
+                                        s->write_size = htobe16(s->write_packet->size);
+                                        s->n_written = 0;
+                                }
+                        }
+
                         r = dns_stream_update_io(s);
                         if (r < 0)
                                 return dns_stream_complete(s, -r);
@@ -307,6 +330,30 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                                 if (r < 0)
                                         return dns_stream_complete(s, -r);
 
+                                if (s->persistent) {
+                                        /* Hand the packet to the handler, and then get ready for the next one */
+                                        if (s->on_packet) {
+                                                r = s->on_packet(s);
+                                                if (r < 0)
+                                                        return r;
+                                        }
+
+                                        s->read_packet = dns_packet_unref(s->read_packet);
+                                        s->n_read = 0;
+
+                                        /* The handler might have stopped us */
+                                        if (s->fd < 0)
+                                                return 0;
+
+                                        dns_stream_reset_timeout(s);
+
+                                        r = dns_stream_update_io(s);
+                                        if (r < 0)
+                                                return dns_stream_complete(s, -r);
+
+                                        return 0;
+                                }
+
                                 /* If there's a packet handler
                                  * installed, call that. Note that
                                  * this is optional... */
@@ -316,7 +363,8 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                 }
         }
 
-        if ((s->write_packet && s->n_written >= sizeof(s->write_size) + s->write_packet->size) &&
+        if (!s->persistent &&
+            (s->write_packet && s->n_written >= sizeof(s->write_size) + s->write_packet->size) &&
             (s->read_packet && s->n_read >= sizeof(s->read_size) + s->read_packet->size))
                 return dns_stream_complete(s, 0);
 
@@ -324,6 +372,8 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
 }
 
 DnsStream *dns_stream_unref(DnsStream *s) {
+        DnsPacket *p;
+
         if (!s)
                 return NULL;
 
@@ -340,14 +390,18 @@ DnsStream *dns_stream_unref(DnsStream *s) {
                 s->manager->n_dns_streams--;
         }
 
+        assert(!s->transactions);
+
         dns_packet_unref(s->write_packet);
         dns_packet_unref(s->read_packet);
 
+        while ((p = ordered_set_steal_first(s->write_queue)))
+                dns_packet_unref(p);
+        ordered_set_free(s->write_queue);
+
         return mfree(s);
 }
 
-DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStream*, dns_stream_unref);
-
 DnsStream *dns_stream_ref(DnsStream *s) {
         if (!s)
                 return NULL;
@@ -405,10 +459,34 @@ int dns_stream_new(Manager *m, DnsStream **ret, DnsProtocol protocol, int fd) {
 }
 
 int dns_stream_write_packet(DnsStream *s, DnsPacket *p) {
+        int r;
+
         assert(s);
+        assert(p);
 
-        if (s->write_packet)
-                return -EBUSY;
+        /* Only replies show that the peer is still alive, hence a query restarts the idle timeout only if
+         * nobody was waiting for a reply before. Otherwise a server that stopped replying would be kept
+         * around forever, as long as new queries keep coming in. */
+        if (s->persistent && !s->transactions)
+                dns_stream_reset_timeout(s);
+
+        if (s->write_packet) {
+                if (!s->persistent)
+                        return -EBUSY;
+
+                /* Another packet is being written, queue this one behind it */
+                r = ordered_set_ensure_allocated(&s->write_queue, NULL);
+                if (r < 0)
+                        return r;
+
+                r = ordered_set_put(s->write_queue, p);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        dns_packet_ref(p);
+
+                return 0;
+        }
 
         s->write_packet = dns_packet_ref(p);
         s->write_size = htobe16(p->size);
@@ -416,3 +494,23 @@ int dns_stream_write_packet(DnsStream *s, DnsPacket *p) {
 
         return dns_stream_update_io(s);
 }
+
+DnsPacket *dns_stream_take_read_packet(DnsStream *s) {
+        DnsPacket *p;
+
+        assert(s);
+
+        /* Returns the packet just read completely, and passes ownership of it to the caller */
+
+        if (!s->read_packet)
+                return NULL;
+
+        if (s->n_read < sizeof(s->read_size) + be16toh(s->read_size))
+                return NULL;
+
+        p = s->read_packet;
+        s->read_packet = NULL;
+        s->n_read = 0;
+
+        return p;
+}
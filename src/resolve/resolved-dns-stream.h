@@ -19,6 +19,7 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "ordered-set.h"
 #include "socket-util.h"
 
 typedef struct DnsStream DnsStream;
@@ -32,6 +33,10 @@ typedef struct DnsStream DnsStream;
  *   1. The normal transaction logic when doing a DNS or LLMNR lookup via TCP
  *   2. The LLMNR logic when accepting a TCP-based lookup
  *   3. The DNS stub logic when accepting a TCP-based lookup
+ *
+ * The streams of the transaction logic are persistent: they may carry any number of queries and replies, and are
+ * shared by all transactions talking to the same DNS server, which match the replies by their ID. The others are
+ * closed after a single query and its reply.
  */
 
 struct DnsStream {
@@ -52,14 +57,21 @@ struct DnsStream {
         sd_event_source *io_event_source;
         sd_event_source *timeout_event_source;
 
+        bool persistent;
+
         be16_t write_size, read_size;
         DnsPacket *write_packet, *read_packet;
         size_t n_written, n_read;
+        OrderedSet *write_queue; /* packets waiting for write_packet to be written, only for persistent streams */
 
         int (*on_packet)(DnsStream *s);
         int (*complete)(DnsStream *s, int error);
 
-        DnsTransaction *transaction; /* when used by the transaction logic */
+        /* when used by the transaction logic */
+        DnsServer *server;           /* the server this stream is pooled for, if any */
+        bool replied;                /* whether the peer sent at least one reply on this stream yet */
+        LIST_HEAD(DnsTransaction, transactions);
+
         DnsQuery *query;             /* when used by the DNS stub logic */
 
         LIST_FIELDS(DnsStream, streams);
@@ -70,6 +82,7 @@ DnsStream *dns_stream_unref(DnsStream *s);
 DnsStream *dns_stream_ref(DnsStream *s);
 
 int dns_stream_write_packet(DnsStream *s, DnsPacket *p);
+DnsPacket *dns_stream_take_read_packet(DnsStream *s);
 
 static inline bool DNS_STREAM_QUEUED(DnsStream *s) {
         assert(s);
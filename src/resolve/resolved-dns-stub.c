@@ -17,17 +17,320 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "alloc-util.h"
 #include "fd-util.h"
 #include "resolved-dns-stub.h"
+#include "resolved-etc-hosts.h"
+#include "siphash24.h"
 #include "socket-util.h"
+#include "string-util.h"
+#include "unaligned.h"
 
 /* The MTU of the loopback device is 64K on Linux, advertise that as maximum datagram size, but subtract the Ethernet,
  * IP and UDP header sizes */
 #define ADVERTISE_DATAGRAM_SIZE_MAX (65536U-14U-20U-8U)
 
+/* Successful replies are kept around in wire format for a short while, so that repeated lookups can be answered
+ * without going through a DnsQuery again. The time is short, since routing changes do not flush any caches. */
+#define DNS_STUB_REPLY_TTL_MAX_USEC (5 * USEC_PER_SEC)
+#define DNS_STUB_REPLY_SIZE_MAX 4096U
+#define DNS_STUB_REPLIES_MAX 1024U
+
+/* How many UDP queries to process per wakeup at most, so that a flood of queries doesn't starve the rest of the event
+ * loop, and how much the kernel shall queue for us in the meantime */
+#define DNS_STUB_UDP_BATCH_MAX 64U
+#define DNS_STUB_UDP_RCVBUF (1U*1024U*1024U)
+
+typedef struct DnsStubReply {
+        DnsResourceKey *key;
+        bool add_opt;
+        bool edns0_do;
+
+        usec_t timestamp;
+        usec_t until;
+        usec_t etc_hosts_mtime;
+
+        /* Offsets and original values of the TTL fields in the answer section */
+        size_t *ttl_offsets;
+        uint32_t *ttls;
+        unsigned n_ttls;
+
+        size_t size;
+        uint8_t data[];
+} DnsStubReply;
+
 static int manager_dns_stub_udp_fd(Manager *m);
 static int manager_dns_stub_tcp_fd(Manager *m);
 
+static DnsStubReply* dns_stub_reply_free(DnsStubReply *r) {
+        if (!r)
+                return NULL;
+
+        dns_resource_key_unref(r->key);
+        free(r->ttl_offsets);
+        free(r->ttls);
+        return mfree(r);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStubReply*, dns_stub_reply_free);
+
+static void dns_stub_reply_hash_func(const void *p, struct siphash *state) {
+        const DnsStubReply *r = p;
+
+        dns_resource_key_hash_ops.hash(r->key, state);
+        siphash24_compress(&r->add_opt, sizeof(r->add_opt), state);
+        siphash24_compress(&r->edns0_do, sizeof(r->edns0_do), state);
+}
+
+static int dns_stub_reply_compare_func(const void *a, const void *b) {
+        const DnsStubReply *x = a, *y = b;
+
+        if (x->add_opt != y->add_opt)
+                return x->add_opt < y->add_opt ? -1 : 1;
+        if (x->edns0_do != y->edns0_do)
+                return x->edns0_do < y->edns0_do ? -1 : 1;
+
+        if (x->key->type != y->key->type)
+                return x->key->type < y->key->type ? -1 : 1;
+        if (x->key->class != y->key->class)
+                return x->key->class < y->key->class ? -1 : 1;
+
+        /* The question is echoed back verbatim, hence compare the name case-sensitively, so that clients randomizing
+         * the case of their queries get their own spelling back. */
+        return strcmp(dns_resource_key_name(x->key), dns_resource_key_name(y->key));
+}
+
+static const struct hash_ops dns_stub_reply_hash_ops = {
+        .hash = dns_stub_reply_hash_func,
+        .compare = dns_stub_reply_compare_func,
+};
+
+void manager_dns_stub_flush_replies(Manager *m) {
+        DnsStubReply *r;
+
+        assert(m);
+
+        while ((r = set_steal_first(m->dns_stub_replies)))
+                dns_stub_reply_free(r);
+}
+
+static void dns_stub_make_room(Manager *m, usec_t t) {
+        DnsStubReply *r;
+        Iterator i;
+
+        assert(m);
+
+        if (set_size(m->dns_stub_replies) < DNS_STUB_REPLIES_MAX)
+                return;
+
+        SET_FOREACH(r, m->dns_stub_replies, i)
+                if (r->until <= t) {
+                        set_remove(m->dns_stub_replies, r);
+                        dns_stub_reply_free(r);
+                }
+
+        while (set_size(m->dns_stub_replies) >= DNS_STUB_REPLIES_MAX)
+                dns_stub_reply_free(set_steal_first(m->dns_stub_replies));
+}
+
+static int dns_stub_reply_find_ttls(DnsStubReply *r, DnsPacket *reply, uint32_t *ret_min_ttl) {
+        uint32_t min_ttl = UINT32_MAX;
+        unsigned n, ancount;
+        int k;
+
+        assert(r);
+        assert(reply);
+        assert(ret_min_ttl);
+
+        /* Walks over the finished reply packet, and records where the TTLs of the answer RRs are. The OPT RR in the
+         * additional section uses the TTL field for flags, and is left alone. */
+
+        ancount = DNS_PACKET_ANCOUNT(reply);
+        if (ancount == 0)
+                return -ENODATA;
+
+        r->ttl_offsets = new(size_t, ancount);
+        r->ttls = new(uint32_t, ancount);
+        if (!r->ttl_offsets || !r->ttls)
+                return -ENOMEM;
+
+        dns_packet_rewind(reply, DNS_PACKET_HEADER_SIZE);
+
+        for (n = 0; n < DNS_PACKET_QDCOUNT(reply); n++) {
+                _cleanup_free_ char *name = NULL;
+
+                k = dns_packet_read_name(reply, &name, true, NULL);
+                if (k < 0)
+                        return k;
+
+                k = dns_packet_read(reply, 4, NULL, NULL);
+                if (k < 0)
+                        return k;
+        }
+
+        for (n = 0; n < ancount; n++) {
+                _cleanup_free_ char *name = NULL;
+                uint16_t rdlength;
+
+                k = dns_packet_read_name(reply, &name, true, NULL);
+                if (k < 0)
+                        return k;
+
+                k = dns_packet_read(reply, 4, NULL, NULL);
+                if (k < 0)
+                        return k;
+
+                k = dns_packet_read_uint32(reply, &r->ttls[n], &r->ttl_offsets[n]);
+                if (k < 0)
+                        return k;
+
+                k = dns_packet_read_uint16(reply, &rdlength, NULL);
+                if (k < 0)
+                        return k;
+
+                k = dns_packet_read(reply, rdlength, NULL, NULL);
+                if (k < 0)
+                        return k;
+
+                min_ttl = MIN(min_ttl, r->ttls[n]);
+        }
+
+        r->n_ttls = ancount;
+        *ret_min_ttl = min_ttl;
+
+        return 0;
+}
+
+void manager_dns_stub_cache_reply(Manager *m, DnsPacket *request, DnsPacket *reply) {
+        _cleanup_(dns_stub_reply_freep) DnsStubReply *r = NULL;
+        DnsStubReply *old;
+        uint32_t min_ttl;
+        int k;
+
+        assert(m);
+        assert(request);
+        assert(reply);
+
+        /* Keeps a successful reply to the request, if it answers a single question and isn't too large */
+
+        if (!m->enable_cache)
+                return;
+        if (dns_question_size(request->question) != 1)
+                return;
+        if (reply->size > DNS_STUB_REPLY_SIZE_MAX)
+                return;
+
+        r = malloc0(offsetof(DnsStubReply, data) + reply->size);
+        if (!r)
+                return;
+
+        r->key = dns_resource_key_ref(request->question->keys[0]);
+        r->add_opt = !!request->opt;
+        r->edns0_do = DNS_PACKET_DO(request);
+        r->size = reply->size;
+        memcpy(r->data, DNS_PACKET_DATA(reply), reply->size);
+
+        k = dns_stub_reply_find_ttls(r, reply, &min_ttl);
+        if (k < 0 || min_ttl == 0)
+                return;
+
+        r->timestamp = now(clock_boottime_or_monotonic());
+        r->until = r->timestamp + MIN((usec_t) min_ttl * USEC_PER_SEC, DNS_STUB_REPLY_TTL_MAX_USEC);
+        r->etc_hosts_mtime = m->etc_hosts_mtime;
+
+        old = set_remove(m->dns_stub_replies, r);
+        dns_stub_reply_free(old);
+
+        dns_stub_make_room(m, r->timestamp);
+
+        if (set_ensure_allocated(&m->dns_stub_replies, &dns_stub_reply_hash_ops) < 0)
+                return;
+
+        if (set_put(m->dns_stub_replies, r) < 0)
+                return;
+
+        r = NULL;
+}
+
+static void dns_stub_cache_reply(DnsQuery *q) {
+        assert(q);
+        assert(q->request_dns_packet);
+        assert(q->reply_dns_packet);
+
+        /* Only keep what the cache would have kept too: synthesized replies and /etc/hosts data carry no TTL, replies
+         * from a DNS server on the local host are never cached, and LLMNR/mDNS answers depend on the state of the
+         * links. */
+        if (q->answer_uncacheable)
+                return;
+        if (q->answer_protocol != DNS_PROTOCOL_DNS)
+                return;
+        if (q->answer_rcode != DNS_RCODE_SUCCESS)
+                return;
+
+        manager_dns_stub_cache_reply(q->manager, q->request_dns_packet, q->reply_dns_packet);
+}
+
+int manager_dns_stub_make_cached_reply(Manager *m, DnsPacket *p, DnsPacket **ret) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
+        DnsStubReply *r, lookup;
+        uint32_t elapsed;
+        unsigned n;
+        usec_t t;
+        int k;
+
+        assert(m);
+        assert(p);
+        assert(ret);
+
+        if (set_isempty(m->dns_stub_replies))
+                return 0;
+
+        if (dns_question_size(p->question) != 1)
+                return 0;
+
+        lookup = (DnsStubReply) {
+                .key = p->question->keys[0],
+                .add_opt = !!p->opt,
+                .edns0_do = DNS_PACKET_DO(p),
+        };
+
+        r = set_get(m->dns_stub_replies, &lookup);
+        if (!r)
+                return 0;
+
+        /* /etc/hosts takes precedence over anything from the network, hence drop the entry if it changed since */
+        (void) manager_etc_hosts_read(m);
+
+        t = now(clock_boottime_or_monotonic());
+        if (t >= r->until || r->etc_hosts_mtime != m->etc_hosts_mtime) {
+                set_remove(m->dns_stub_replies, r);
+                dns_stub_reply_free(r);
+                return 0;
+        }
+
+        k = dns_packet_new(&reply, DNS_PROTOCOL_DNS, r->size);
+        if (k < 0)
+                return k;
+
+        memcpy(DNS_PACKET_DATA(reply), r->data, DNS_PACKET_HEADER_SIZE);
+        k = dns_packet_append_blob(reply, r->data + DNS_PACKET_HEADER_SIZE, r->size - DNS_PACKET_HEADER_SIZE, NULL);
+        if (k < 0)
+                return k;
+
+        DNS_PACKET_HEADER(reply)->id = DNS_PACKET_ID(p);
+
+        /* Age the TTLs like the cache would have done */
+        elapsed = (uint32_t) ((t - r->timestamp) / USEC_PER_SEC);
+        for (n = 0; n < r->n_ttls; n++)
+                unaligned_write_be32(DNS_PACKET_DATA(reply) + r->ttl_offsets[n],
+                                     r->ttls[n] > elapsed ? r->ttls[n] - elapsed : 0);
+
+        *ret = reply;
+        reply = NULL;
+
+        return 1;
+}
+
 static int dns_stub_make_reply_packet(
                 DnsPacket **p,
                 DnsQuestion *q,
@@ -229,6 +532,8 @@ static void dns_stub_query_complete(DnsQuery *q) {
                         break;
                 }
 
+                dns_stub_cache_reply(q);
+
                 (void) dns_stub_send(q->manager, q->request_dns_stream, q->request_dns_packet, q->reply_dns_packet);
                 break;
 
@@ -288,6 +593,7 @@ static int dns_stub_stream_complete(DnsStream *s, int error) {
 }
 
 static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
         DnsQuery *q = NULL;
         int r;
 
@@ -342,6 +648,22 @@ static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
                 goto fail;
         }
 
+        r = manager_dns_stub_make_cached_reply(m, p, &reply);
+        if (r < 0)
+                log_debug_errno(r, "Failed to build reply from cached packet, ignoring: %m");
+        else if (r > 0) {
+                log_debug("Answering query from cached reply packet.");
+                (void) dns_stub_send(m, s, p, reply);
+
+                /* Keep the stream around until the reply is written out, like dns_stub_query_complete() does. The
+                 * default completion action of the stream drops this reference again. */
+                if (s && DNS_STREAM_QUEUED(s)) {
+                        dns_stub_detach_stream(s);
+                        dns_stream_ref(s);
+                }
+                return;
+        }
+
         r = dns_query_new(m, &q, p->question, p->question, 0, SD_RESOLVED_PROTOCOLS_ALL|SD_RESOLVED_NO_SEARCH);
         if (r < 0) {
                 log_error_errno(r, "Failed to generate query object: %m");
@@ -380,20 +702,29 @@ fail:
 }
 
 static int on_dns_stub_packet(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
         Manager *m = userdata;
+        unsigned n;
         int r;
 
-        r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
-        if (r <= 0)
-                return r;
+        /* Under load many queries are queued by the time we get here, hence don't go back to the event loop for each
+         * of them, but process a batch of them right away. */
 
-        if (dns_packet_validate_query(p) > 0) {
-                log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+        for (n = 0; n < DNS_STUB_UDP_BATCH_MAX; n++) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
 
-                dns_stub_process_query(m, NULL, p);
-        } else
-                log_debug("Invalid DNS stub UDP packet, ignoring.");
+                r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
+                if (IN_SET(r, -EAGAIN, -EINTR))
+                        break;
+                if (r <= 0)
+                        return r;
+
+                if (dns_packet_validate_query(p) > 0) {
+                        log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+
+                        dns_stub_process_query(m, NULL, p);
+                } else
+                        log_debug("Invalid DNS stub UDP packet, ignoring.");
+        }
 
         return 0;
 }
@@ -424,6 +755,8 @@ static int manager_dns_stub_udp_fd(Manager *m) {
         if (setsockopt(fd, IPPROTO_IP, IP_RECVTTL, &one, sizeof one) < 0)
                 return -errno;
 
+        (void) fd_inc_rcvbuf(fd, DNS_STUB_UDP_RCVBUF);
+
         /* Make sure no traffic from outside the local host can leak to onto this socket */
         if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, "lo", 3) < 0)
                 return -errno;
@@ -579,6 +912,9 @@ int manager_dns_stub_start(Manager *m) {
 void manager_dns_stub_stop(Manager *m) {
         assert(m);
 
+        manager_dns_stub_flush_replies(m);
+        m->dns_stub_replies = set_free(m->dns_stub_replies);
+
         m->dns_stub_udp_event_source = sd_event_source_unref(m->dns_stub_udp_event_source);
         m->dns_stub_tcp_event_source = sd_event_source_unref(m->dns_stub_tcp_event_source);
 
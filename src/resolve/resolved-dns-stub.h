@@ -24,5 +24,9 @@
 /* 127.0.0.53 in native endian */
 #define INADDR_DNS_STUB ((in_addr_t) 0x7f000035U)
 
+void manager_dns_stub_cache_reply(Manager *m, DnsPacket *request, DnsPacket *reply);
+int manager_dns_stub_make_cached_reply(Manager *m, DnsPacket *p, DnsPacket **ret);
+void manager_dns_stub_flush_replies(Manager *m);
+
 void manager_dns_stub_stop(Manager *m);
 int manager_dns_stub_start(Manager *m);
@@ -62,10 +62,8 @@ static void dns_transaction_close_connection(DnsTransaction *t) {
         assert(t);
 
         if (t->stream) {
-                /* Let's detach the stream from our transaction, in case something else keeps a reference to it. */
-                t->stream->complete = NULL;
-                t->stream->on_packet = NULL;
-                t->stream->transaction = NULL;
+                /* Let's detach our transaction from the stream, which might be shared with other transactions. */
+                LIST_REMOVE(transactions_by_stream, t->stream->transactions, t);
                 t->stream = dns_stream_unref(t->stream);
         }
 
@@ -146,6 +144,10 @@ bool dns_transaction_gc(DnsTransaction *t) {
         if (t->block_gc > 0)
                 return true;
 
+        /* Nobody is interested in a prefetch, hence keep it until it completed, its answer ends up in the cache */
+        if (t->prefetch && DNS_TRANSACTION_IS_LIVE(t->state))
+                return true;
+
         if (set_isempty(t->notify_query_candidates) &&
             set_isempty(t->notify_query_candidates_done) &&
             set_isempty(t->notify_zone_items) &&
@@ -459,43 +461,26 @@ static int dns_transaction_maybe_restart(DnsTransaction *t) {
         return 1;
 }
 
-static int on_stream_complete(DnsStream *s, int error) {
+static int on_stream_packet(DnsStream *s) {
         _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
         DnsTransaction *t;
 
         assert(s);
-        assert(s->transaction);
-
-        /* Copy the data we care about out of the stream before we
-         * destroy it. */
-        t = s->transaction;
-        p = dns_packet_ref(s->read_packet);
-
-        dns_transaction_close_connection(t);
-
-        if (ERRNO_IS_DISCONNECT(error)) {
-                usec_t usec;
-
-                if (t->scope->protocol == DNS_PROTOCOL_LLMNR) {
-                        /* If the LLMNR/TCP connection failed, the host doesn't support LLMNR, and we cannot answer the
-                         * question on this scope. */
-                        dns_transaction_complete(t, DNS_TRANSACTION_NOT_FOUND);
-                        return 0;
-                }
 
-                log_debug_errno(error, "Connection failure for DNS TCP stream: %m");
-                assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &usec) >= 0);
-                dns_server_packet_lost(t->server, IPPROTO_TCP, t->current_feature_level, usec - t->start_usec);
+        p = dns_stream_take_read_packet(s);
+        assert(p);
 
-                dns_transaction_retry(t, true);
-                return 0;
-        }
-        if (error != 0) {
-                t->answer_errno = error;
-                dns_transaction_complete(t, DNS_TRANSACTION_ERRNO);
+        /* The stream might carry the replies for multiple transactions, hence find the right one by its ID */
+        t = hashmap_get(s->manager->dns_transactions, UINT_TO_PTR(DNS_PACKET_ID(p)));
+        if (!t || t->stream != s) {
+                log_debug("Received unexpected TCP reply packet with id %" PRIu16 ", ignoring.", DNS_PACKET_ID(p));
                 return 0;
         }
 
+        s->replied = true;
+
+        dns_transaction_close_connection(t);
+
         if (dns_packet_validate_reply(p) <= 0) {
                 log_debug("Invalid TCP reply packet.");
                 dns_transaction_complete(t, DNS_TRANSACTION_INVALID_REPLY);
@@ -519,8 +504,61 @@ static int on_stream_complete(DnsStream *s, int error) {
         return 0;
 }
 
+static int on_stream_complete(DnsStream *s, int error) {
+        DnsTransaction *t;
+        bool replied;
+
+        assert(s);
+
+        /* The stream failed or timed out. Make sure no new transactions are attached to it, and deal with the ones still
+         * waiting for their replies on it. */
+
+        dns_stream_ref(s);
+
+        if (s->server)
+                dns_server_unref_stream(s->server);
+
+        /* If the peer replied on this stream before, it most likely just closed the connection after it was idle for a
+         * while. Don't hold that against the server then, and try again with it. */
+        replied = s->replied;
+
+        if (ERRNO_IS_DISCONNECT(error) && s->protocol == DNS_PROTOCOL_DNS && s->transactions) {
+                usec_t usec;
+
+                log_debug_errno(error, "Connection failure for DNS TCP stream: %m");
+
+                if (!replied) {
+                        t = s->transactions;
+                        assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &usec) >= 0);
+                        dns_server_packet_lost(t->server, IPPROTO_TCP, t->current_feature_level, usec - t->start_usec);
+                }
+        }
+
+        while ((t = s->transactions)) {
+                dns_transaction_close_connection(t);
+
+                if (ERRNO_IS_DISCONNECT(error)) {
+                        if (t->scope->protocol == DNS_PROTOCOL_LLMNR)
+                                /* If the LLMNR/TCP connection failed, the host doesn't support LLMNR, and we cannot
+                                 * answer the question on this scope. */
+                                dns_transaction_complete(t, DNS_TRANSACTION_NOT_FOUND);
+                        else
+                                dns_transaction_retry(t, !replied);
+                } else if (error != 0) {
+                        t->answer_errno = error;
+                        dns_transaction_complete(t, DNS_TRANSACTION_ERRNO);
+                } else
+                        /* The stream was closed while we are still waiting for the reply */
+                        dns_transaction_complete(t, DNS_TRANSACTION_INVALID_REPLY);
+        }
+
+        dns_stream_unref(s);
+        return 0;
+}
+
 static int dns_transaction_open_tcp(DnsTransaction *t) {
         _cleanup_close_ int fd = -1;
+        DnsStream *s = NULL;
         int r;
 
         assert(t);
@@ -541,6 +579,12 @@ static int dns_transaction_open_tcp(DnsTransaction *t) {
                 if (r < 0)
                         return r;
 
+                /* Reuse the connection to the server if there's one already */
+                if (t->server->stream) {
+                        s = dns_stream_ref(t->server->stream);
+                        break;
+                }
+
                 fd = dns_scope_socket_tcp(t->scope, AF_UNSPEC, NULL, t->server, 53);
                 break;
 
@@ -573,27 +617,39 @@ static int dns_transaction_open_tcp(DnsTransaction *t) {
                 return -EAFNOSUPPORT;
         }
 
-        if (fd < 0)
-                return fd;
+        if (!s) {
+                if (fd < 0)
+                        return fd;
 
-        r = dns_stream_new(t->scope->manager, &t->stream, t->scope->protocol, fd);
-        if (r < 0)
-                return r;
-        fd = -1;
+                r = dns_stream_new(t->scope->manager, &s, t->scope->protocol, fd);
+                if (r < 0)
+                        return r;
+                fd = -1;
+
+                s->persistent = true;
+                s->on_packet = on_stream_packet;
+                s->complete = on_stream_complete;
+
+                /* The interface index is difficult to determine if we are
+                 * connecting to the local host, hence fill this in right away
+                 * instead of determining it from the socket */
+                s->ifindex = dns_scope_ifindex(t->scope);
+
+                /* Only connections to unicast DNS servers are shared, LLMNR ones are specific to the peer */
+                if (t->server) {
+                        s->server = t->server;
+                        t->server->stream = dns_stream_ref(s);
+                }
+        }
 
-        r = dns_stream_write_packet(t->stream, t->sent);
+        r = dns_stream_write_packet(s, t->sent);
         if (r < 0) {
-                t->stream = dns_stream_unref(t->stream);
+                dns_stream_unref(s);
                 return r;
         }
 
-        t->stream->complete = on_stream_complete;
-        t->stream->transaction = t;
-
-        /* The interface index is difficult to determine if we are
-         * connecting to the local host, hence fill this in right away
-         * instead of determining it from the socket */
-        t->stream->ifindex = dns_scope_ifindex(t->scope);
+        LIST_PREPEND(transactions_by_stream, s->transactions, t);
+        t->stream = s;
 
         dns_transaction_reset_answer(t);
 
@@ -1246,6 +1302,42 @@ static usec_t transaction_get_resend_timeout(DnsTransaction *t) {
         }
 }
 
+static void dns_transaction_prefetch(DnsTransaction *t) {
+        char key_str[DNS_RESOURCE_KEY_STRING_MAX];
+        DnsTransaction *other, *p;
+        int r;
+
+        assert(t);
+
+        /* The cached answer for this transaction is popular and about to expire, hence refresh it in the background
+         * already. The refreshing transaction is not registered by its key, so that lookups done in the meantime don't
+         * end up waiting for it but keep being answered from the cache. */
+
+        other = hashmap_get(t->scope->transactions_by_key, t->key);
+
+        r = dns_transaction_new(&p, t->scope, t->key);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to allocate prefetch transaction, ignoring: %m");
+                return;
+        }
+
+        if (other)
+                assert_se(hashmap_replace(t->scope->transactions_by_key, other->key, other) >= 0);
+        else
+                hashmap_remove_value(t->scope->transactions_by_key, p->key, p);
+
+        p->prefetch = true;
+
+        log_debug("Prefetching %s in transaction %" PRIu16 ".",
+                  dns_resource_key_to_string(p->key, key_str, sizeof key_str), p->id);
+
+        r = dns_transaction_go(p);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to start prefetch transaction, ignoring: %m");
+                dns_transaction_free(p);
+        }
+}
+
 static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         int r;
 
@@ -1344,8 +1436,10 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         }
 
         /* Check the cache, but only if this transaction is not used
-         * for probing or verifying a zone item. */
-        if (set_isempty(t->notify_zone_items)) {
+         * for probing or verifying a zone item, or for refreshing the
+         * cache. */
+        if (set_isempty(t->notify_zone_items) && !t->prefetch) {
+                bool prefetch;
 
                 /* Before trying the cache, let's make sure we figured out a
                  * server to use. Should this cause a change of server this
@@ -1355,10 +1449,13 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                 /* Let's then prune all outdated entries */
                 dns_cache_prune(&t->scope->cache);
 
-                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated);
+                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated, &prefetch);
                 if (r < 0)
                         return r;
                 if (r > 0) {
+                        if (prefetch && t->scope->protocol == DNS_PROTOCOL_DNS)
+                                dns_transaction_prefetch(t);
+
                         t->answer_source = DNS_TRANSACTION_CACHE;
                         if (t->answer_rcode == DNS_RCODE_SUCCESS)
                                 dns_transaction_complete(t, DNS_TRANSACTION_SUCCESS);
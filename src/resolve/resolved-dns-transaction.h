@@ -80,6 +80,9 @@ struct DnsTransaction {
 
         bool probing:1;
 
+        /* Refreshes a cache entry in the background, nobody waits for it */
+        bool prefetch:1;
+
         DnsPacket *sent, *received;
 
         DnsAnswer *answer;
@@ -146,6 +149,7 @@ struct DnsTransaction {
         unsigned block_gc;
 
         LIST_FIELDS(DnsTransaction, transactions_by_scope);
+        LIST_FIELDS(DnsTransaction, transactions_by_stream);
 };
 
 int dns_transaction_new(DnsTransaction **ret, DnsScope *s, DnsResourceKey *key);
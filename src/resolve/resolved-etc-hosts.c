@@ -17,8 +17,11 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <sys/inotify.h>
+
 #include "fd-util.h"
 #include "fileio.h"
+#include "fs-util.h"
 #include "hostname-util.h"
 #include "resolved-etc-hosts.h"
 #include "resolved-dns-synthesize.h"
@@ -101,6 +104,7 @@ static int add_item(Manager *m, int family, const union in_addr_union *address,
                 .family = family,
                 .address = *address,
         };
+        _cleanup_strv_free_ char **names_unused = names;
         EtcHostsItem *item;
         char **n;
         int r;
@@ -108,6 +112,8 @@ static int add_item(Manager *m, int family, const union in_addr_union *address,
         assert(m);
         assert(address);
 
+        /* Takes possession of the names strv in any case. Unless it ends up in a new item, it is freed in the end. */
+
         r = in_addr_is_null(family, address);
         if (r < 0)
                 return r;
@@ -142,6 +148,8 @@ static int add_item(Manager *m, int family, const union in_addr_union *address,
                                 free(item);
                                 return log_oom();
                         }
+
+                        names_unused = NULL;
                 }
         }
 
@@ -240,12 +248,10 @@ static int parse_line(Manager *m, unsigned nr, const char *line) {
                 return -EINVAL;
         }
 
-        /* Takes possession of the names strv */
+        /* Takes possession of the names strv, even on failure */
         r = add_item(m, family, &in, names);
-        if (r < 0)
-                return r;
-
         names = NULL;
+
         return r;
 }
 
@@ -259,6 +265,10 @@ int manager_etc_hosts_read(Manager *m) {
 
         assert_se(sd_event_now(m->event, clock_boottime_or_monotonic(), &ts) >= 0);
 
+        /* If we are notified about changes, there's no need to check the file again until then */
+        if (m->etc_hosts_event_source && m->etc_hosts_last != USEC_INFINITY)
+                return 0;
+
         /* See if we checked /etc/hosts recently already */
         if (m->etc_hosts_last != USEC_INFINITY && m->etc_hosts_last + ETC_HOSTS_RECHECK_USEC > ts)
                 return 0;
@@ -324,6 +334,79 @@ clear:
         return r;
 }
 
+static int on_etc_hosts_inotify(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        union inotify_event_buffer buffer;
+        struct inotify_event *e;
+        Manager *m = userdata;
+        bool changed = false;
+        ssize_t l;
+
+        assert(m);
+
+        l = read(fd, &buffer, sizeof(buffer));
+        if (l < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
+
+                log_warning_errno(errno, "Failed to read /etc inotify events, ignoring: %m");
+                return 0;
+        }
+
+        FOREACH_INOTIFY_EVENT(e, buffer, l)
+                if ((e->mask & IN_Q_OVERFLOW) || (e->len > 0 && streq(e->name, "hosts")))
+                        changed = true;
+
+        if (!changed)
+                return 0;
+
+        /* If nobody looked at the file so far, wait until somebody does */
+        if (m->etc_hosts_last == USEC_INFINITY)
+                return 0;
+
+        /* Re-read the file right-away, so that this isn't done when the next lookup comes in */
+        m->etc_hosts_last = m->etc_hosts_mtime = USEC_INFINITY;
+        (void) manager_etc_hosts_read(m);
+
+        return 0;
+}
+
+int manager_etc_hosts_watch(Manager *m) {
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+        int r;
+
+        assert(m);
+
+        /* Watch /etc for changes to /etc/hosts, instead of checking its mtime on lookups. Editors usually replace
+         * the file, hence watch the directory. If /etc/hosts is a symlink, we wouldn't notice changes to its
+         * target, and fall back to the checks on lookups. */
+
+        if (lstat("/etc/hosts", &st) >= 0 && S_ISLNK(st.st_mode))
+                return 0;
+
+        fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        if (fd < 0) {
+                log_debug_errno(errno, "Failed to allocate inotify fd, not watching /etc/hosts: %m");
+                return 0;
+        }
+
+        if (inotify_add_watch(fd, "/etc", IN_CLOSE_WRITE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ONLYDIR) < 0) {
+                log_debug_errno(errno, "Failed to watch /etc, not watching /etc/hosts: %m");
+                return 0;
+        }
+
+        r = sd_event_add_io(m->event, &m->etc_hosts_event_source, fd, EPOLLIN, on_etc_hosts_inotify, m);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add /etc/hosts event source: %m");
+
+        (void) sd_event_source_set_description(m->etc_hosts_event_source, "etc-hosts");
+
+        m->etc_hosts_inotify_fd = fd;
+        fd = -1;
+
+        return 0;
+}
+
 int manager_etc_hosts_lookup(Manager *m, DnsQuestion* q, DnsAnswer **answer) {
         bool found_a = false, found_aaaa = false;
         EtcHostsItemByName *bn;
@@ -25,4 +25,5 @@
 
 void manager_etc_hosts_flush(Manager *m);
 int manager_etc_hosts_read(Manager *m);
+int manager_etc_hosts_watch(Manager *m);
 int manager_etc_hosts_lookup(Manager *m, DnsQuestion* q, DnsAnswer **answer);
@@ -27,6 +27,7 @@
 #include "missing.h"
 #include "mkdir.h"
 #include "parse-util.h"
+#include "resolved-dns-stub.h"
 #include "resolved-link.h"
 #include "resolved-llmnr.h"
 #include "resolved-mdns.h"
@@ -330,6 +331,7 @@ void link_set_dnssec_mode(Link *l, DnssecMode mode) {
                  * allow-downgrade mode to full DNSSEC mode, flush it too. */
                 if (l->unicast_scope)
                         dns_cache_flush(&l->unicast_scope->cache);
+                manager_dns_stub_flush_replies(l->manager);
         }
 
         l->dnssec_mode = mode;
@@ -621,6 +623,7 @@ DnsServer* link_set_dns_server(Link *l, DnsServer *s) {
 
         if (l->unicast_scope)
                 dns_cache_flush(&l->unicast_scope->cache);
+        manager_dns_stub_flush_replies(l->manager);
 
         return s;
 }
@@ -27,9 +27,12 @@
 
 #include "af-list.h"
 #include "alloc-util.h"
+#include "def.h"
 #include "dirent-util.h"
 #include "dns-domain.h"
+#include "extract-word.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fileio-label.h"
 #include "hostname-util.h"
 #include "io-util.h"
@@ -567,11 +570,13 @@ int manager_new(Manager **ret) {
         m->mdns_ipv4_fd = m->mdns_ipv6_fd = -1;
         m->dns_stub_udp_fd = m->dns_stub_tcp_fd = -1;
         m->hostname_fd = -1;
+        m->etc_hosts_inotify_fd = -1;
 
         m->llmnr_support = RESOLVE_SUPPORT_YES;
         m->mdns_support = RESOLVE_SUPPORT_YES;
         m->dnssec_mode = DEFAULT_DNSSEC_MODE;
         m->enable_cache = true;
+        m->cache_size_max = CACHE_SIZE_MAX_DEFAULT;
         m->dns_stub_listener_mode = DNS_STUB_LISTENER_UDP;
         m->read_resolv_conf = true;
         m->need_builtin_fallbacks = true;
@@ -598,6 +603,10 @@ int manager_new(Manager **ret) {
         if (r < 0)
                 return r;
 
+        r = manager_etc_hosts_watch(m);
+        if (r < 0)
+                return r;
+
         r = dns_scope_new(m, &m->unicast_scope, NULL, DNS_PROTOCOL_DNS, AF_UNSPEC);
         if (r < 0)
                 return r;
@@ -690,6 +699,9 @@ Manager *manager_free(Manager *m) {
         sd_event_source_unref(m->hostname_event_source);
         safe_close(m->hostname_fd);
 
+        sd_event_source_unref(m->etc_hosts_event_source);
+        safe_close(m->etc_hosts_inotify_fd);
+
         free(m->full_hostname);
         free(m->llmnr_hostname);
         free(m->mdns_hostname);
@@ -1392,6 +1404,7 @@ void manager_flush_caches(Manager *m) {
 
         LIST_FOREACH(scopes, scope, m->dns_scopes)
                 dns_cache_flush(&scope->cache);
+        manager_dns_stub_flush_replies(m);
 
         log_info("Flushed all caches.");
 }
@@ -1450,3 +1463,175 @@ void manager_cleanup_saved_user(Manager *m) {
                 (void) unlink(p);
         }
 }
+
+static DnsServer *manager_cache_snapshot_scope(Manager *m, const char *line, DnsScope **ret) {
+        _cleanup_free_ char *ifname = NULL, *mode = NULL, *server = NULL;
+        DnsScope *scope = NULL;
+        DnsServer *s;
+        int r;
+
+        assert(m);
+        assert(line);
+        assert(ret);
+
+        /* Finds the scope a snapshot section was written for. Cached data is only used if it came from the same DNS
+         * server and was validated in the same DNSSEC mode, everything else is skipped. */
+
+        r = extract_many_words(&line, NULL, 0, &ifname, &mode, &server, NULL);
+        if (r != 3)
+                return NULL;
+
+        if (streq(ifname, "*"))
+                scope = m->unicast_scope;
+        else {
+                Iterator i;
+                Link *l;
+
+                HASHMAP_FOREACH(l, m->links, i)
+                        if (streq(l->name, ifname)) {
+                                scope = l->unicast_scope;
+                                break;
+                        }
+        }
+        if (!scope)
+                return NULL;
+
+        if (dnssec_mode_from_string(mode) != scope->dnssec_mode)
+                return NULL;
+
+        s = dns_scope_get_dns_server(scope);
+        if (!s || !streq(dns_server_string(s), server))
+                return NULL;
+
+        *ret = scope;
+        return s;
+}
+
+int manager_load_cache(Manager *m) {
+        _cleanup_fclose_ FILE *f = NULL;
+        DnsServer *server = NULL;
+        DnsScope *scope = NULL;
+        unsigned n = 0;
+        int r;
+
+        assert(m);
+
+        if (!m->persistent_cache || !m->enable_cache)
+                return 0;
+
+        f = fopen(CACHE_SNAPSHOT_PATH, "re");
+        if (!f) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return log_warning_errno(errno, "Failed to open cache snapshot: %m");
+        }
+
+        /* The snapshot is only good for the instance right after the one that wrote it */
+        (void) unlink(CACHE_SNAPSHOT_PATH);
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                const char *w;
+                char *l;
+
+                /* DNSKEY or TXT records might be large, hence don't use a fixed size buffer */
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return log_warning_errno(r, "Failed to read cache snapshot: %m");
+                if (r == 0)
+                        break;
+
+                l = strstrip(line);
+                if (IN_SET(*l, '#', 0))
+                        continue;
+
+                w = startswith(l, "scope ");
+                if (w) {
+                        scope = NULL;
+                        server = manager_cache_snapshot_scope(m, w, &scope);
+                        continue;
+                }
+
+                w = startswith(l, "rr ");
+                if (w) {
+                        if (!server)
+                                continue;
+
+                        r = dns_cache_load_item(&scope->cache, w, dns_scope_ifindex(scope), server->family, &server->address);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to load cache snapshot entry, ignoring: %m");
+                        else if (r > 0)
+                                n++;
+
+                        continue;
+                }
+
+                log_debug("Unknown line in cache snapshot, ignoring: %s", l);
+        }
+
+        log_debug("Loaded %u cache entries from snapshot.", n);
+        return 0;
+}
+
+int manager_save_cache(Manager *m) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        DnsScope *scope;
+        int r;
+
+        assert(m);
+
+        if (!m->persistent_cache || !m->enable_cache)
+                return 0;
+
+        r = fopen_temporary(CACHE_SNAPSHOT_PATH, &f, &temp_path);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to open cache snapshot for writing: %m");
+
+        (void) fchmod(fileno(f), 0600);
+
+        fputs("# This file is managed by systemd-resolved(8). Do not edit.\n", f);
+
+        LIST_FOREACH(scopes, scope, m->dns_scopes) {
+                DnsServer *server;
+
+                if (scope->protocol != DNS_PROTOCOL_DNS)
+                        continue;
+
+                if (dns_cache_is_empty(&scope->cache))
+                        continue;
+
+                server = scope->link ? scope->link->current_dns_server : m->current_dns_server;
+                if (!server)
+                        continue;
+
+                fprintf(f, "scope %s %s %s\n",
+                        scope->link ? scope->link->name : "*",
+                        dnssec_mode_to_string(scope->dnssec_mode),
+                        dns_server_string(server));
+
+                r = dns_cache_save(&scope->cache, f);
+                if (r < 0) {
+                        log_warning_errno(r, "Failed to write cache snapshot: %m");
+                        goto fail;
+                }
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to write cache snapshot: %m");
+                goto fail;
+        }
+
+        if (rename(temp_path, CACHE_SNAPSHOT_PATH) < 0) {
+                r = log_warning_errno(errno, "Failed to move cache snapshot into place: %m");
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(temp_path);
+        return r;
+}
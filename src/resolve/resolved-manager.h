@@ -41,6 +41,8 @@ typedef struct Manager Manager;
 #define MANAGER_SEARCH_DOMAINS_MAX 32
 #define MANAGER_DNS_SERVERS_MAX 32
 
+#define CACHE_SNAPSHOT_PATH "/var/lib/systemd/resolve/cache"
+
 struct Manager {
         sd_event *event;
 
@@ -48,6 +50,8 @@ struct Manager {
         ResolveSupport mdns_support;
         DnssecMode dnssec_mode;
         bool enable_cache;
+        size_t cache_size_max;
+        bool persistent_cache;
         DnsStubListenerMode dns_stub_listener_mode;
 
         /* Network */
@@ -134,6 +138,8 @@ struct Manager {
         Set* etc_hosts_by_address;
         Hashmap* etc_hosts_by_name;
         usec_t etc_hosts_last, etc_hosts_mtime;
+        int etc_hosts_inotify_fd;
+        sd_event_source *etc_hosts_event_source;
 
         /* Local DNS stub on 127.0.0.53:53 */
         int dns_stub_udp_fd;
@@ -141,6 +147,9 @@ struct Manager {
 
         sd_event_source *dns_stub_udp_event_source;
         sd_event_source *dns_stub_tcp_event_source;
+
+        /* Replies recently sent by the stub, kept in wire format */
+        Set *dns_stub_replies;
 };
 
 /* Manager */
@@ -186,3 +195,6 @@ bool manager_routable(Manager *m, int family);
 void manager_flush_caches(Manager *m);
 
 void manager_cleanup_saved_user(Manager *m);
+
+int manager_load_cache(Manager *m);
+int manager_save_cache(Manager *m);
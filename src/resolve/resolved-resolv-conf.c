@@ -26,6 +26,7 @@
 #include "fileio.h"
 #include "ordered-set.h"
 #include "resolved-conf.h"
+#include "resolved-dns-stub.h"
 #include "resolved-resolv-conf.h"
 #include "string-util.h"
 #include "strv.h"
@@ -135,6 +136,7 @@ int manager_read_resolv_conf(Manager *m) {
          * enough to flush the global unicast DNS cache. */
         if (m->unicast_scope)
                 dns_cache_flush(&m->unicast_scope->cache);
+        manager_dns_stub_flush_replies(m);
 
         return 0;
 
@@ -97,6 +97,9 @@ int main(int argc, char *argv[]) {
         /* Write finish default resolv.conf to avoid a dangling symlink */
         (void) manager_write_resolv_conf(m);
 
+        /* Pick up what the previous instance had cached */
+        (void) manager_load_cache(m);
+
         /* Let's drop the remaining caps now */
         r = capability_bounding_set_drop(0, true);
         if (r < 0) {
@@ -116,6 +119,8 @@ int main(int argc, char *argv[]) {
 
         sd_event_get_exit_code(m->event, &r);
 
+        (void) manager_save_cache(m);
+
 finish:
         /* systemd-nspawn checks for private resolv.conf to decide whether
            or not to mount it into the container. So just delete it. */
@@ -200,6 +200,20 @@ static void test_dnssec_verify_rrset(void) {
         /* Validate the RR as it if was 2015-12-2 today */
         assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
         assert_se(result == DNSSEC_VALIDATED);
+
+        /* Again, now that the signature is known to be good */
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_VALIDATED);
+
+        /* A tampered signature must not be taken for the verified one */
+        ((uint8_t*) rrsig->rrsig.signature)[7] ^= 0x01;
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_INVALID);
+        ((uint8_t*) rrsig->rrsig.signature)[7] ^= 0x01;
+
+        /* Neither must an expired one */
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1452000000*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_SIGNATURE_EXPIRED);
 }
 
 static void test_dnssec_verify_rrset2(void) {
@@ -0,0 +1,704 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "in-addr-util.h"
+#include "log.h"
+#include "parse-util.h"
+#include "process-util.h"
+#include "random-util.h"
+#include "resolved-dns-packet.h"
+#include "resolved-dns-rr.h"
+#include "resolved-dns-stub.h"
+#include "socket-util.h"
+#include "string-util.h"
+#include "time-util.h"
+#include "util.h"
+
+/* Drives the DNS stub listener or the ResolveHostname() bus call of a running systemd-resolved with A lookups at a fixed
+ * rate, and reports the latency distribution and the CPU time resolved spent per lookup. Before the measurement, a set
+ * of names is looked up once, and the given share of the lookups then goes to those, which hence should be answered
+ * from the cache. All others are for names nobody looked up before.
+ *
+ * With --upstream=ADDRESS a minimal DNS server answering all lookups is forked off, listening on ADDRESS port 53.
+ * Configure resolved to use it (e.g. DNS=127.0.0.2 in resolved.conf) to make cache misses cheap and predictable. */
+
+#define BENCH_DOMAIN "bench.test"
+#define BENCH_TIMEOUT_USEC (5 * USEC_PER_SEC)
+
+static unsigned arg_queries = 10000;
+static unsigned arg_qps = 1000;
+static unsigned arg_names = 100;
+static unsigned arg_hit_percent = 90;
+static bool arg_bus = false;
+static const char *arg_upstream = NULL;
+
+typedef struct Bench Bench;
+
+typedef struct BenchQuery {
+        Bench *bench;
+        sd_bus_slot *slot;
+        usec_t sent;
+        usec_t latency;
+        bool done:1;
+        bool failed:1;
+} BenchQuery;
+
+struct Bench {
+        sd_event *event;
+        sd_bus *bus;
+        int fd;
+
+        sd_event_source *io_event_source;
+        sd_event_source *send_event_source;
+        sd_event_source *timeout_event_source;
+
+        /* The current run */
+        bool warm_up;
+        bool finished;
+        BenchQuery *queries;
+        unsigned n_queries, n_sent, n_done, n_failed;
+        unsigned by_id[UINT16_MAX + 1]; /* query index + 1, by DNS packet ID */
+        usec_t start;
+};
+
+static void bench_free_queries(Bench *b) {
+        unsigned i;
+
+        assert(b);
+
+        for (i = 0; i < b->n_queries; i++)
+                sd_bus_slot_unref(b->queries[i].slot);
+
+        b->queries = mfree(b->queries);
+        b->n_queries = 0;
+}
+
+static void pick_name(Bench *b, unsigned i, char *buf, size_t size) {
+        assert(b);
+        assert(buf);
+
+        if (b->warm_up)
+                (void) snprintf(buf, size, "name%u." BENCH_DOMAIN, i);
+        else if (random_u64() % 100 < arg_hit_percent)
+                (void) snprintf(buf, size, "name%u." BENCH_DOMAIN, (unsigned) (random_u64() % arg_names));
+        else
+                (void) snprintf(buf, size, "miss%u-%" PRIx64 "." BENCH_DOMAIN, i, random_u64());
+}
+
+static void bench_query_done(Bench *b, BenchQuery *q, bool success) {
+        assert(b);
+        assert(q);
+
+        if (q->done)
+                return;
+
+        q->done = true;
+        q->failed = !success;
+        q->latency = now(CLOCK_MONOTONIC) - q->sent;
+        q->slot = sd_bus_slot_unref(q->slot);
+
+        b->n_done++;
+        if (!success)
+                b->n_failed++;
+
+        if (b->n_done >= b->n_queries)
+                b->finished = true;
+}
+
+static int on_stub_reply(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        uint8_t buf[DNS_PACKET_SIZE_MAX];
+        Bench *b = userdata;
+
+        assert(b);
+
+        for (;;) {
+                DnsPacketHeader *h;
+                unsigned i;
+                ssize_t l;
+
+                l = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (l < 0) {
+                        if (IN_SET(errno, EAGAIN, EINTR))
+                                return 0;
+
+                        return log_error_errno(errno, "Failed to receive reply: %m");
+                }
+                if ((size_t) l < sizeof(DnsPacketHeader))
+                        continue;
+
+                h = (DnsPacketHeader*) buf;
+                i = b->by_id[be16toh(h->id)];
+                if (i == 0 || i > b->n_queries)
+                        continue;
+
+                bench_query_done(b, b->queries + i - 1,
+                                 (be16toh(h->flags) & 15) == DNS_RCODE_SUCCESS && h->ancount != 0);
+        }
+}
+
+static int send_stub_query(Bench *b, unsigned i, const char *name) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        uint16_t id;
+        int r;
+
+        assert(b);
+        assert(name);
+
+        r = dns_packet_new_query(&p, DNS_PROTOCOL_DNS, 0, false);
+        if (r < 0)
+                return r;
+
+        key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, name);
+        if (!key)
+                return -ENOMEM;
+
+        r = dns_packet_append_key(p, key, 0, NULL);
+        if (r < 0)
+                return r;
+
+        /* IDs repeat after 64K queries, which are long answered or lost by then */
+        id = i & UINT16_MAX;
+        DNS_PACKET_HEADER(p)->id = htobe16(id);
+        DNS_PACKET_HEADER(p)->qdcount = htobe16(1);
+        b->by_id[id] = i + 1;
+
+        if (send(b->fd, DNS_PACKET_DATA(p), p->size, MSG_DONTWAIT) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static int on_bus_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        BenchQuery *q = userdata;
+
+        assert(q);
+
+        bench_query_done(q->bench, q, !sd_bus_message_is_method_error(m, NULL));
+        return 0;
+}
+
+static int send_bus_query(Bench *b, BenchQuery *q, const char *name) {
+        assert(b);
+        assert(q);
+        assert(name);
+
+        return sd_bus_call_method_async(
+                        b->bus,
+                        &q->slot,
+                        "org.freedesktop.resolve1",
+                        "/org/freedesktop/resolve1",
+                        "org.freedesktop.resolve1.Manager",
+                        "ResolveHostname",
+                        on_bus_reply,
+                        q,
+                        "isit", 0, name, AF_INET, UINT64_C(0));
+}
+
+static void send_query(Bench *b) {
+        char name[DNS_HOSTNAME_MAX + 1];
+        BenchQuery *q;
+        int r;
+
+        assert(b);
+        assert(b->n_sent < b->n_queries);
+
+        q = b->queries + b->n_sent;
+        q->bench = b;
+        q->sent = now(CLOCK_MONOTONIC);
+
+        pick_name(b, b->n_sent, name, sizeof(name));
+
+        if (arg_bus)
+                r = send_bus_query(b, q, name);
+        else
+                r = send_stub_query(b, b->n_sent, name);
+
+        b->n_sent++;
+
+        if (r < 0) {
+                log_debug_errno(r, "Failed to send query for %s: %m", name);
+                bench_query_done(b, q, false);
+        }
+}
+
+static int on_timeout(sd_event_source *s, usec_t usec, void *userdata) {
+        Bench *b = userdata;
+
+        assert(b);
+
+        log_info("Timed out waiting for %u replies.", b->n_sent - b->n_done);
+        b->finished = true;
+
+        return 0;
+}
+
+static int on_send_timer(sd_event_source *s, usec_t usec, void *userdata) {
+        Bench *b = userdata;
+        uint64_t due;
+        int r;
+
+        assert(b);
+
+        /* Send everything that is due by now, so that we keep up the rate even if we are woken up late */
+        due = MIN((uint64_t) b->n_queries, (now(CLOCK_MONOTONIC) - b->start) * arg_qps / USEC_PER_SEC + 1);
+        while (b->n_sent < due)
+                send_query(b);
+
+        if (b->n_sent < b->n_queries) {
+                r = sd_event_source_set_time(s, b->start + (uint64_t) b->n_sent * USEC_PER_SEC / arg_qps);
+                if (r < 0)
+                        return r;
+
+                return sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
+        }
+
+        /* Everything was sent, give the stragglers some time */
+        return sd_event_add_time(b->event, &b->timeout_event_source, CLOCK_MONOTONIC,
+                                 now(CLOCK_MONOTONIC) + BENCH_TIMEOUT_USEC, 0, on_timeout, b);
+}
+
+static int bench_run(Bench *b, unsigned n_queries, bool warm_up) {
+        int r;
+
+        assert(b);
+
+        bench_free_queries(b);
+
+        b->queries = new0(BenchQuery, n_queries);
+        if (!b->queries)
+                return log_oom();
+
+        b->n_queries = n_queries;
+        b->n_sent = b->n_done = b->n_failed = 0;
+        b->warm_up = warm_up;
+        b->finished = n_queries == 0;
+        memzero(b->by_id, sizeof(b->by_id));
+
+        b->start = now(CLOCK_MONOTONIC);
+
+        r = sd_event_add_time(b->event, &b->send_event_source, CLOCK_MONOTONIC, b->start, 1, on_send_timer, b);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add send timer: %m");
+
+        while (!b->finished) {
+                r = sd_event_run(b->event, (uint64_t) -1);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to run event loop: %m");
+                        break;
+                }
+        }
+
+        b->send_event_source = sd_event_source_unref(b->send_event_source);
+        b->timeout_event_source = sd_event_source_unref(b->timeout_event_source);
+
+        return r < 0 ? r : 0;
+}
+
+static int get_cpu_usec(pid_t pid, usec_t *ret) {
+        _cleanup_free_ char *line = NULL;
+        unsigned long utime, stime;
+        const char *p;
+        long ticks;
+        int r;
+
+        assert(pid > 0);
+        assert(ret);
+
+        p = procfs_file_alloca(pid, "stat");
+        r = read_one_line_file(p, &line);
+        if (r < 0)
+                return r;
+
+        /* Skip over the command name, which might contain spaces, then pick fields 14 and 15 */
+        p = strrchr(line, ')');
+        if (!p)
+                return -EIO;
+
+        if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+                return -EIO;
+
+        ticks = sysconf(_SC_CLK_TCK);
+        if (ticks <= 0)
+                return -EIO;
+
+        *ret = (usec_t) (utime + stime) * USEC_PER_SEC / (usec_t) ticks;
+        return 0;
+}
+
+static int compare_usec(const void *a, const void *b) {
+        const usec_t *x = a, *y = b;
+
+        return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+static void report(Bench *b, usec_t elapsed, usec_t cpu) {
+        char p50[FORMAT_TIMESPAN_MAX], p99[FORMAT_TIMESPAN_MAX], max[FORMAT_TIMESPAN_MAX];
+        _cleanup_free_ usec_t *latencies = NULL;
+        unsigned i, n = 0;
+
+        assert(b);
+
+        latencies = new(usec_t, b->n_queries);
+        assert_se(latencies);
+
+        for (i = 0; i < b->n_queries; i++)
+                if (b->queries[i].done && !b->queries[i].failed)
+                        latencies[n++] = b->queries[i].latency;
+
+        log_info("%u queries via %s at %u/s, %u%% to %u cached names: %u answered, %u failed, %u lost, %.0f/s",
+                 b->n_queries, arg_bus ? "bus" : "stub", arg_qps, arg_hit_percent, arg_names,
+                 n, b->n_failed, b->n_queries - b->n_done,
+                 elapsed > 0 ? (double) n * USEC_PER_SEC / elapsed : 0.0);
+
+        if (n > 0) {
+                qsort(latencies, n, sizeof(usec_t), compare_usec);
+
+                log_info("latency p50 %s, p99 %s, max %s",
+                         format_timespan(p50, sizeof(p50), latencies[n / 2], 1),
+                         format_timespan(p99, sizeof(p99), latencies[MIN(n - 1, n * 99 / 100)], 1),
+                         format_timespan(max, sizeof(max), latencies[n - 1], 1));
+        }
+
+        if (cpu != USEC_INFINITY && b->n_done > 0)
+                log_info("resolved CPU time %.1fus per query", (double) cpu / b->n_done);
+}
+
+static ssize_t make_reply(uint8_t *buf, size_t n, size_t size) {
+        /* The answer, pointing to the name in the question, and the OPT RR in case the query had one */
+        static const uint8_t answer[] = { 0xc0, 0x0c, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, 0, 0, 0x0e, 0x10, 0, 4, 192, 0, 2, 1 };
+        static const uint8_t opt[] = { 0, 0, DNS_TYPE_OPT, 0x10, 0, 0, 0, 0, 0, 0, 0 };
+        DnsPacketHeader *h = (DnsPacketHeader*) buf;
+        size_t i = sizeof(DnsPacketHeader);
+        bool edns;
+
+        if (n < i || be16toh(h->qdcount) != 1)
+                return -EBADMSG;
+
+        /* Skip over the name, the type and the class of the question */
+        while (i < n && buf[i] != 0) {
+                if (buf[i] > 63)
+                        return -EBADMSG;
+
+                i += buf[i] + 1;
+        }
+        i += 1 + 4;
+        if (i > n)
+                return -EBADMSG;
+
+        if (i + sizeof(answer) + sizeof(opt) > size)
+                return -ENOBUFS;
+
+        edns = h->arcount != 0;
+
+        memcpy(buf + i, answer, sizeof(answer));
+        i += sizeof(answer);
+
+        if (edns) {
+                memcpy(buf + i, opt, sizeof(opt));
+                i += sizeof(opt);
+        }
+
+        h->flags = htobe16(DNS_PACKET_MAKE_FLAGS(1, 0, 0, 0, 1, 1, 0, 0, DNS_RCODE_SUCCESS));
+        h->ancount = htobe16(1);
+        h->nscount = 0;
+        h->arcount = htobe16(edns);
+
+        return (ssize_t) i;
+}
+
+noreturn static void run_responder(int fd) {
+        uint8_t buf[DNS_PACKET_UNICAST_SIZE_MAX];
+
+        for (;;) {
+                union sockaddr_union sa;
+                socklen_t salen = sizeof(sa);
+                ssize_t n;
+
+                n = recvfrom(fd, buf, sizeof(buf), 0, &sa.sa, &salen);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        log_error_errno(errno, "Failed to receive query: %m");
+                        _exit(EXIT_FAILURE);
+                }
+
+                n = make_reply(buf, n, sizeof(buf));
+                if (n < 0)
+                        continue;
+
+                (void) sendto(fd, buf, n, 0, &sa.sa, salen);
+        }
+}
+
+static int start_responder(const char *address, pid_t *ret) {
+        union sockaddr_union sa = {};
+        union in_addr_union a;
+        _cleanup_close_ int fd = -1;
+        int family, r;
+        pid_t pid;
+
+        assert(address);
+        assert(ret);
+
+        r = in_addr_from_string_auto(address, &family, &a);
+        if (r < 0)
+                return log_error_errno(r, "Failed to parse upstream address %s: %m", address);
+
+        sa.sa.sa_family = family;
+        if (family == AF_INET) {
+                sa.in.sin_addr = a.in;
+                sa.in.sin_port = htobe16(53);
+        } else {
+                sa.in6.sin6_addr = a.in6;
+                sa.in6.sin6_port = htobe16(53);
+        }
+
+        fd = socket(family, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return log_error_errno(errno, "Failed to allocate upstream socket: %m");
+
+        (void) fd_inc_rcvbuf(fd, 4 * 1024 * 1024);
+
+        if (bind(fd, &sa.sa, family == AF_INET ? sizeof(sa.in) : sizeof(sa.in6)) < 0)
+                return log_error_errno(errno, "Failed to bind upstream socket to %s: %m", address);
+
+        pid = fork();
+        if (pid < 0)
+                return log_error_errno(errno, "Failed to fork upstream: %m");
+        if (pid == 0)
+                run_responder(fd);
+
+        *ret = pid;
+        return 0;
+}
+
+static void help(void) {
+        printf("%s [OPTIONS...]\n\n"
+               "Measure lookup latency and CPU usage of systemd-resolved.\n\n"
+               "  -h --help               Show this help\n"
+               "     --queries=N          Number of queries to measure (default: %u)\n"
+               "     --qps=N              Queries sent per second (default: %u)\n"
+               "     --names=N            Number of names warmed up in the cache (default: %u)\n"
+               "     --hit-percent=N      Percentage of queries for warmed up names (default: %u)\n"
+               "     --bus                Use ResolveHostname() instead of the DNS stub\n"
+               "     --upstream=ADDRESS   Run a DNS server answering all queries on ADDRESS\n",
+               program_invocation_short_name,
+               arg_queries, arg_qps, arg_names, arg_hit_percent);
+}
+
+static int parse_argv(int argc, char *argv[]) {
+
+        enum {
+                ARG_QUERIES = 0x100,
+                ARG_QPS,
+                ARG_NAMES,
+                ARG_HIT_PERCENT,
+                ARG_BUS,
+                ARG_UPSTREAM,
+        };
+
+        static const struct option options[] = {
+                { "help",        no_argument,       NULL, 'h'             },
+                { "queries",     required_argument, NULL, ARG_QUERIES     },
+                { "qps",         required_argument, NULL, ARG_QPS         },
+                { "names",       required_argument, NULL, ARG_NAMES       },
+                { "hit-percent", required_argument, NULL, ARG_HIT_PERCENT },
+                { "bus",         no_argument,       NULL, ARG_BUS         },
+                { "upstream",    required_argument, NULL, ARG_UPSTREAM    },
+                {}
+        };
+
+        int c, r;
+
+        assert(argc >= 0);
+        assert(argv);
+
+        while ((c = getopt_long(argc, argv, "h", options, NULL)) >= 0)
+
+                switch (c) {
+
+                case 'h':
+                        help();
+                        return 0;
+
+                case ARG_QUERIES:
+                        r = safe_atou(optarg, &arg_queries);
+                        if (r < 0 || arg_queries == 0)
+                                return log_error_errno(r < 0 ? r : -EINVAL, "Invalid number of queries: %s", optarg);
+                        break;
+
+                case ARG_QPS:
+                        r = safe_atou(optarg, &arg_qps);
+                        if (r < 0 || arg_qps == 0)
+                                return log_error_errno(r < 0 ? r : -EINVAL, "Invalid query rate: %s", optarg);
+                        break;
+
+                case ARG_NAMES:
+                        r = safe_atou(optarg, &arg_names);
+                        if (r < 0 || arg_names == 0)
+                                return log_error_errno(r < 0 ? r : -EINVAL, "Invalid number of names: %s", optarg);
+                        break;
+
+                case ARG_HIT_PERCENT:
+                        r = safe_atou(optarg, &arg_hit_percent);
+                        if (r < 0 || arg_hit_percent > 100)
+                                return log_error_errno(r < 0 ? r : -EINVAL, "Invalid percentage: %s", optarg);
+                        break;
+
+                case ARG_BUS:
+                        arg_bus = true;
+                        break;
+
+                case ARG_UPSTREAM:
+                        arg_upstream = optarg;
+                        break;
+
+                case '?':
+                        return -EINVAL;
+
+                default:
+                        assert_not_reached("Unhandled option");
+                }
+
+        return 1;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
+        usec_t start, elapsed, cpu_before, cpu_after, cpu = USEC_INFINITY;
+        pid_t pid = 0, upstream = 0;
+        _cleanup_free_ Bench *b = NULL;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        r = parse_argv(argc, argv);
+        if (r <= 0)
+                return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+
+        b = new0(Bench, 1);
+        assert_se(b);
+        b->fd = -1;
+
+        if (arg_upstream) {
+                r = start_responder(arg_upstream, &upstream);
+                if (r < 0)
+                        return EXIT_FAILURE;
+        }
+
+        assert_se(sd_event_default(&b->event) >= 0);
+
+        /* The bus is also used to find out which process resolved is, in order to measure its CPU time */
+        r = sd_bus_open_system(&b->bus);
+        if (r < 0) {
+                if (arg_bus) {
+                        log_notice_errno(r, "Skipping test: failed to connect to system bus: %m");
+                        r = EXIT_TEST_SKIP;
+                        goto finish;
+                }
+
+                log_notice_errno(r, "Failed to connect to system bus, not measuring CPU time: %m");
+        } else {
+                assert_se(sd_bus_attach_event(b->bus, b->event, 0) >= 0);
+
+                if (sd_bus_get_name_creds(b->bus, "org.freedesktop.resolve1", SD_BUS_CREDS_PID, &creds) >= 0)
+                        (void) sd_bus_creds_get_pid(creds, &pid);
+                else if (arg_bus) {
+                        log_notice("Skipping test: systemd-resolved is not running.");
+                        r = EXIT_TEST_SKIP;
+                        goto finish;
+                }
+        }
+
+        if (!arg_bus) {
+                union sockaddr_union sa = {
+                        .in.sin_family = AF_INET,
+                        .in.sin_port = htobe16(53),
+                        .in.sin_addr.s_addr = htobe32(INADDR_DNS_STUB),
+                };
+
+                b->fd = socket(AF_INET, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+                assert_se(b->fd >= 0);
+
+                (void) fd_inc_rcvbuf(b->fd, 4 * 1024 * 1024);
+
+                if (connect(b->fd, &sa.sa, sizeof(sa.in)) < 0) {
+                        log_notice_errno(errno, "Skipping test: failed to connect to the DNS stub: %m");
+                        r = EXIT_TEST_SKIP;
+                        goto finish;
+                }
+
+                assert_se(sd_event_add_io(b->event, &b->io_event_source, b->fd, EPOLLIN, on_stub_reply, b) >= 0);
+        }
+
+        r = bench_run(b, arg_names, true);
+        if (r < 0)
+                goto fail;
+        if (b->n_done - b->n_failed < b->n_queries) {
+                log_notice("Skipping test: only %u of %u names could be resolved.", b->n_done - b->n_failed, b->n_queries);
+                r = EXIT_TEST_SKIP;
+                goto finish;
+        }
+
+        if (pid > 0 && get_cpu_usec(pid, &cpu_before) < 0)
+                pid = 0;
+
+        start = now(CLOCK_MONOTONIC);
+        r = bench_run(b, arg_queries, false);
+        if (r < 0)
+                goto fail;
+        elapsed = now(CLOCK_MONOTONIC) - start;
+
+        if (pid > 0 && get_cpu_usec(pid, &cpu_after) >= 0)
+                cpu = cpu_after - cpu_before;
+
+        report(b, elapsed, cpu);
+        r = EXIT_SUCCESS;
+        goto finish;
+
+fail:
+        r = EXIT_FAILURE;
+
+finish:
+        if (upstream > 0) {
+                (void) kill(upstream, SIGTERM);
+                (void) wait_for_terminate(upstream, NULL);
+        }
+
+        bench_free_queries(b);
+        sd_event_source_unref(b->io_event_source);
+        safe_close(b->fd);
+        sd_bus_flush_close_unref(b->bus);
+        sd_event_unref(b->event);
+
+        return r;
+}
@@ -0,0 +1,237 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <netinet/in.h>
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "log.h"
+#include "resolved-dns-cache.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+
+static void put_a(DnsCache *c, const char *name, uint32_t ttl, usec_t timestamp) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        union in_addr_union owner = {
+                .in.s_addr = htobe32(0xc0000201), /* 192.0.2.1 */
+        };
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, name));
+        assert_se(rr = dns_resource_record_new(key));
+        rr->ttl = ttl;
+        rr->a.in_addr.s_addr = htobe32(0x7f000001);
+
+        assert_se(answer = dns_answer_new(1));
+        assert_se(dns_answer_add(answer, rr, 1, DNS_ANSWER_CACHEABLE) >= 0);
+
+        assert_se(dns_cache_put(c, key, DNS_RCODE_SUCCESS, answer, false, 0, timestamp, AF_INET, &owner) >= 0);
+}
+
+static int lookup_a(DnsCache *c, const char *name) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        bool authenticated, prefetch;
+        int r, rcode;
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, name));
+
+        r = dns_cache_lookup(c, key, false, &rcode, &answer, &authenticated, &prefetch);
+        assert_se(r >= 0);
+        if (r > 0) {
+                assert_se(rcode == DNS_RCODE_SUCCESS);
+                assert_se(dns_answer_size(answer) == 1);
+                assert_se(dns_answer_match_key(answer, key, NULL) > 0);
+        }
+
+        return r;
+}
+
+static void test_cache_lookup(void) {
+        DnsCache c = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        };
+
+        put_a(&c, "www.example.com", 60, 0);
+        assert_se(dns_cache_size(&c) == 1);
+        assert_se(c.size > 0);
+
+        assert_se(lookup_a(&c, "www.example.com") == 1);
+        assert_se(lookup_a(&c, "WWW.Example.COM") == 1);
+        assert_se(lookup_a(&c, "foo.example.com") == 0);
+        assert_se(c.n_hit == 2);
+        assert_se(c.n_miss == 1);
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_expiry(void) {
+        DnsCache c = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        };
+        usec_t t;
+
+        t = now(clock_boottime_or_monotonic());
+
+        /* One answer that is still valid, and one that ran out a second ago */
+        put_a(&c, "new.example.com", 60, t);
+        put_a(&c, "old.example.com", 60, t - 61 * USEC_PER_SEC);
+        assert_se(dns_cache_size(&c) == 2);
+
+        dns_cache_prune(&c);
+        assert_se(dns_cache_size(&c) == 1);
+        assert_se(lookup_a(&c, "new.example.com") == 1);
+        assert_se(lookup_a(&c, "old.example.com") == 0);
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_flush(void) {
+        DnsCache c = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        };
+
+        put_a(&c, "a.example.com", 60, 0);
+        put_a(&c, "b.example.com", 60, 0);
+        assert_se(dns_cache_size(&c) == 2);
+
+        dns_cache_flush(&c);
+        assert_se(dns_cache_is_empty(&c));
+        assert_se(c.size == 0);
+        assert_se(!c.by_lru && !c.lru_tail);
+        assert_se(lookup_a(&c, "a.example.com") == 0);
+
+        /* The cache may be used again after flushing */
+        put_a(&c, "a.example.com", 60, 0);
+        assert_se(lookup_a(&c, "a.example.com") == 1);
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_evict(void) {
+        DnsCache c = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        };
+        char name[sizeof("host-.example.com") + DECIMAL_STR_MAX(unsigned)];
+        unsigned i;
+
+        /* All names are of the same length, hence all items are estimated the same */
+        put_a(&c, "host-0.example.com", 60, 0);
+        c.size_max = 4 * c.size;
+
+        put_a(&c, "host-1.example.com", 60, 0);
+
+        /* A lookup makes host-0 the most recently used key, hence host-1 goes first */
+        assert_se(lookup_a(&c, "host-0.example.com") == 1);
+
+        put_a(&c, "host-2.example.com", 60, 0);
+        put_a(&c, "host-3.example.com", 60, 0);
+        assert_se(c.n_evicted == 1);
+        assert_se(c.size <= c.size_max);
+
+        assert_se(lookup_a(&c, "host-1.example.com") == 0);
+        assert_se(lookup_a(&c, "host-0.example.com") == 1);
+        assert_se(lookup_a(&c, "host-2.example.com") == 1);
+        assert_se(lookup_a(&c, "host-3.example.com") == 1);
+
+        /* However many answers are added, the budget is kept */
+        for (i = 4; i < 100; i++) {
+                xsprintf(name, "host-%u.example.com", i % 10);
+                put_a(&c, name, 60, 0);
+                assert_se(c.size <= c.size_max);
+                assert_se(lookup_a(&c, name) == 1);
+        }
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_save_load(void) {
+        DnsCache c = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        }, d = {
+                .size_max = CACHE_SIZE_MAX_DEFAULT,
+        };
+        union in_addr_union owner = {
+                .in.s_addr = htobe32(0xc0000201),
+        };
+        _cleanup_free_ char *dump = NULL, *line = NULL;
+        _cleanup_strv_free_ char **lines = NULL;
+        usec_t t;
+        size_t size;
+        char **l;
+        FILE *f;
+
+        t = now(clock_boottime_or_monotonic());
+
+        put_a(&c, "a.example.com", 60, 0);
+        put_a(&c, "b.example.com", 60, 0);
+        put_a(&c, "old.example.com", 60, t - 61 * USEC_PER_SEC);
+
+        f = open_memstream(&dump, &size);
+        assert_se(f);
+        assert_se(dns_cache_save(&c, f) >= 0);
+        assert_se(fflush_and_check(f) >= 0);
+        fclose(f);
+
+        /* What ran out already isn't written */
+        assert_se(lines = strv_split_newlines(dump));
+        assert_se(strv_length(lines) == 2);
+
+        STRV_FOREACH(l, lines) {
+                const char *w;
+
+                assert_se(w = startswith(*l, "rr "));
+                assert_se(dns_cache_load_item(&d, w, 1, AF_INET, &owner) == 1);
+        }
+
+        assert_se(dns_cache_size(&d) == 2);
+        assert_se(lookup_a(&d, "a.example.com") == 1);
+        assert_se(lookup_a(&d, "b.example.com") == 1);
+        assert_se(lookup_a(&d, "old.example.com") == 0);
+
+        /* Entries that are about to run out are dropped on loading */
+        dns_cache_flush(&d);
+        assert_se(asprintf(&line, USEC_FMT " 0 %s", now(CLOCK_REALTIME), strrchr(lines[0], ' ') + 1) >= 0);
+        assert_se(dns_cache_load_item(&d, line, 1, AF_INET, &owner) == 0);
+        assert_se(dns_cache_is_empty(&d));
+
+        /* And garbage is refused */
+        assert_se(dns_cache_load_item(&d, "", 1, AF_INET, &owner) == -EINVAL);
+        assert_se(dns_cache_load_item(&d, "foo 0 AAAA", 1, AF_INET, &owner) < 0);
+        assert_se(dns_cache_load_item(&d, "1 0 !!!!", 1, AF_INET, &owner) < 0);
+        assert_se(dns_cache_is_empty(&d));
+
+        dns_cache_flush(&c);
+        dns_cache_flush(&d);
+}
+
+int main(int argc, char *argv[]) {
+
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        test_cache_lookup();
+        test_cache_expiry();
+        test_cache_flush();
+        test_cache_evict();
+        test_cache_save_load();
+
+        return 0;
+}
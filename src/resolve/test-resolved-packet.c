@@ -17,8 +17,12 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "dns-domain.h"
 #include "log.h"
+#include "resolved-dns-answer.h"
 #include "resolved-dns-packet.h"
+#include "resolved-dns-question.h"
+#include "resolved-dns-rr.h"
 
 static void test_dns_packet_new(void) {
         size_t i;
@@ -39,6 +43,47 @@ static void test_dns_packet_new(void) {
         assert_se(dns_packet_new(&p2, DNS_PROTOCOL_DNS, DNS_PACKET_SIZE_MAX + 1) == -EFBIG);
 }
 
+static void test_dns_packet_shared_keys(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        DnsResourceRecord *rr;
+        unsigned i;
+
+        assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, 0) >= 0);
+        DNS_PACKET_HEADER(p)->flags = htobe16(DNS_PACKET_MAKE_FLAGS(1, 0, 0, 0, 1, 1, 0, 0, 0));
+        DNS_PACKET_HEADER(p)->qdcount = htobe16(1);
+        DNS_PACKET_HEADER(p)->ancount = htobe16(4);
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, "www.example.com"));
+        assert_se(dns_packet_append_key(p, key, 0, NULL) >= 0);
+
+        for (i = 0; i < 4; i++) {
+                _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *a = NULL;
+
+                assert_se(a = dns_resource_record_new_full(DNS_CLASS_IN, i < 3 ? DNS_TYPE_A : DNS_TYPE_AAAA, "www.example.com"));
+                a->ttl = 60;
+                if (i < 3)
+                        a->a.in_addr.s_addr = htobe32(0x7f000001 + i);
+                else
+                        a->aaaa.in6_addr = in6addr_loopback;
+
+                assert_se(dns_packet_append_rr(p, a, 0, NULL, NULL) >= 0);
+        }
+
+        assert_se(dns_packet_extract(p) >= 0);
+        assert_se(p->question->n_keys == 1);
+        assert_se(p->answer->n_rrs == 4);
+
+        /* The A RRs share the key of the question, the AAAA RR gets its own */
+        for (i = 0; i < 3; i++)
+                assert_se(p->answer->items[i].rr->key == p->question->keys[0]);
+
+        rr = p->answer->items[3].rr;
+        assert_se(rr->key != p->question->keys[0]);
+        assert_se(rr->key->type == DNS_TYPE_AAAA);
+        assert_se(dns_name_equal(dns_resource_key_name(rr->key), "www.example.com") > 0);
+}
+
 int main(int argc, char **argv) {
 
         log_set_max_level(LOG_DEBUG);
@@ -46,6 +91,7 @@ int main(int argc, char **argv) {
         log_open();
 
         test_dns_packet_new();
+        test_dns_packet_shared_keys();
 
         return 0;
 }
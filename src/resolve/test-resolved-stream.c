@@ -0,0 +1,126 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "sd-event.h"
+
+#include "fd-util.h"
+#include "log.h"
+#include "resolved-dns-packet.h"
+#include "resolved-dns-stream.h"
+#include "resolved-manager.h"
+#include "socket-util.h"
+
+static unsigned n_received = 0;
+
+static int on_packet(DnsStream *s) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+
+        p = dns_stream_take_read_packet(s);
+        assert_se(p);
+
+        n_received++;
+        return 0;
+}
+
+static usec_t stream_timeout(DnsStream *s) {
+        usec_t t;
+
+        assert_se(sd_event_source_get_time(s->timeout_event_source, &t) >= 0);
+        return t;
+}
+
+static void test_stream_idle_timeout(void) {
+        union sockaddr_union sa = {
+                .in.sin_family = AF_INET,
+                .in.sin_addr.s_addr = htobe32(INADDR_LOOPBACK),
+        };
+        socklen_t salen = sizeof(sa.in);
+        _cleanup_close_ int listen_fd = -1, peer_fd = -1;
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        DnsTransaction waiting = {};
+        Manager m = {};
+        DnsStream *s;
+        usec_t t;
+        int fd;
+        struct {
+                be16_t size;
+                DnsPacketHeader header;
+        } _packed_ reply = {
+                .size = htobe16(DNS_PACKET_HEADER_SIZE),
+                .header.flags = htobe16(DNS_PACKET_MAKE_FLAGS(1, 0, 0, 0, 1, 1, 0, 0, 0)),
+        };
+
+        assert_se(sd_event_new(&m.event) >= 0);
+
+        /* A TCP connection over the loopback device, as the stream wants to know its addresses */
+        assert_se((listen_fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0)) >= 0);
+        assert_se(bind(listen_fd, &sa.sa, salen) >= 0);
+        assert_se(listen(listen_fd, 1) >= 0);
+        assert_se(getsockname(listen_fd, &sa.sa, &salen) >= 0);
+
+        assert_se((fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0)) >= 0);
+        assert_se(connect(fd, &sa.sa, salen) >= 0 || errno == EINPROGRESS);
+        assert_se((peer_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0);
+
+        assert_se(dns_stream_new(&m, &s, DNS_PROTOCOL_DNS, fd) >= 0);
+        s->persistent = true;
+        s->on_packet = on_packet;
+
+        assert_se(dns_packet_new_query(&p, DNS_PROTOCOL_DNS, 0, false) >= 0);
+
+        /* A query on an idle stream restarts the idle timeout */
+        t = stream_timeout(s);
+        usleep(10 * USEC_PER_MSEC);
+        assert_se(dns_stream_write_packet(s, p) >= 0);
+        assert_se(stream_timeout(s) > t);
+
+        /* But not if somebody is still waiting for a reply: a peer that stopped replying must not be kept
+         * alive by further queries. */
+        LIST_PREPEND(transactions_by_stream, s->transactions, &waiting);
+
+        t = stream_timeout(s);
+        usleep(10 * USEC_PER_MSEC);
+        assert_se(dns_stream_write_packet(s, p) >= 0);
+        assert_se(stream_timeout(s) == t);
+
+        /* A reply does */
+        assert_se(write(peer_fd, &reply, sizeof(reply)) == sizeof(reply));
+        while (n_received == 0)
+                assert_se(sd_event_run(m.event, USEC_PER_SEC) >= 0);
+        assert_se(stream_timeout(s) > t);
+
+        LIST_REMOVE(transactions_by_stream, s->transactions, &waiting);
+
+        dns_stream_unref(s);
+        assert_se(m.n_dns_streams == 0);
+
+        sd_event_unref(m.event);
+}
+
+int main(int argc, char *argv[]) {
+
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        test_stream_idle_timeout();
+
+        return 0;
+}
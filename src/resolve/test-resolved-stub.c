@@ -0,0 +1,175 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "sd-event.h"
+
+#include "log.h"
+#include "resolved-dns-packet.h"
+#include "resolved-dns-stub.h"
+#include "resolved-etc-hosts.h"
+#include "resolved-manager.h"
+#include "set.h"
+
+static void manager_init_for_test(Manager *m) {
+        *m = (Manager) {
+                .enable_cache = true,
+                .etc_hosts_inotify_fd = -1,
+                .etc_hosts_last = USEC_INFINITY,
+                .etc_hosts_mtime = USEC_INFINITY,
+        };
+
+        assert_se(sd_event_new(&m->event) >= 0);
+
+        /* Read /etc/hosts right away, so that the cached replies don't look outdated on the first lookup */
+        (void) manager_etc_hosts_read(m);
+}
+
+static void manager_done_for_test(Manager *m) {
+        manager_dns_stub_flush_replies(m);
+        m->dns_stub_replies = set_free(m->dns_stub_replies);
+        manager_etc_hosts_flush(m);
+        m->event = sd_event_unref(m->event);
+}
+
+static DnsPacket *make_request(uint16_t id, const char *name, uint16_t type) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        DnsPacket *p;
+
+        assert_se(dns_packet_new_query(&p, DNS_PROTOCOL_DNS, 0, false) >= 0);
+        DNS_PACKET_HEADER(p)->id = htobe16(id);
+        DNS_PACKET_HEADER(p)->qdcount = htobe16(1);
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, type, name));
+        assert_se(dns_packet_append_key(p, key, 0, NULL) >= 0);
+        assert_se(dns_packet_extract(p) >= 0);
+
+        return p;
+}
+
+static DnsPacket *make_reply(uint16_t id, const char *name, uint32_t ttl) {
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        DnsPacket *p;
+
+        assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, 0) >= 0);
+        DNS_PACKET_HEADER(p)->id = htobe16(id);
+        DNS_PACKET_HEADER(p)->flags = htobe16(DNS_PACKET_MAKE_FLAGS(1, 0, 0, 0, 1, 1, 0, 0, 0));
+        DNS_PACKET_HEADER(p)->qdcount = htobe16(1);
+        DNS_PACKET_HEADER(p)->ancount = htobe16(1);
+
+        assert_se(rr = dns_resource_record_new_full(DNS_CLASS_IN, DNS_TYPE_A, name));
+        rr->ttl = ttl;
+        rr->a.in_addr.s_addr = htobe32(0x7f000001);
+
+        assert_se(dns_packet_append_key(p, rr->key, 0, NULL) >= 0);
+        assert_se(dns_packet_append_rr(p, rr, 0, NULL, NULL) >= 0);
+
+        return p;
+}
+
+static void test_stub_cache_lookup(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *request = NULL, *reply = NULL, *cached = NULL, *other = NULL;
+        Manager m;
+
+        manager_init_for_test(&m);
+
+        request = make_request(1, "www.example.com", DNS_TYPE_A);
+        reply = make_reply(1, "www.example.com", 60);
+
+        assert_se(manager_dns_stub_make_cached_reply(&m, request, &cached) == 0);
+        manager_dns_stub_cache_reply(&m, request, reply);
+        assert_se(set_size(m.dns_stub_replies) == 1);
+
+        /* The same question with another ID gets the cached reply, with the ID of the question */
+        other = make_request(4711, "www.example.com", DNS_TYPE_A);
+        assert_se(manager_dns_stub_make_cached_reply(&m, other, &cached) == 1);
+        assert_se(DNS_PACKET_ID(cached) == htobe16(4711));
+        assert_se(dns_packet_extract(cached) >= 0);
+        assert_se(dns_answer_size(cached->answer) == 1);
+        assert_se(cached->answer->items[0].rr->ttl == 60);
+        assert_se(cached->answer->items[0].rr->a.in_addr.s_addr == htobe32(0x7f000001));
+        cached = dns_packet_unref(cached);
+
+        /* The question is echoed back verbatim, hence a name spelled differently doesn't match */
+        other = dns_packet_unref(other);
+        other = make_request(1, "WWW.example.com", DNS_TYPE_A);
+        assert_se(manager_dns_stub_make_cached_reply(&m, other, &cached) == 0);
+
+        other = dns_packet_unref(other);
+        other = make_request(1, "www.example.com", DNS_TYPE_AAAA);
+        assert_se(manager_dns_stub_make_cached_reply(&m, other, &cached) == 0);
+
+        /* Nothing is kept if the cache is turned off */
+        manager_dns_stub_flush_replies(&m);
+        m.enable_cache = false;
+        manager_dns_stub_cache_reply(&m, request, reply);
+        assert_se(set_isempty(m.dns_stub_replies));
+
+        manager_done_for_test(&m);
+}
+
+static void test_stub_cache_expiry(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *request = NULL, *reply = NULL, *cached = NULL;
+        Manager m;
+
+        manager_init_for_test(&m);
+
+        request = make_request(1, "www.example.com", DNS_TYPE_A);
+        reply = make_reply(1, "www.example.com", 1);
+
+        manager_dns_stub_cache_reply(&m, request, reply);
+        assert_se(manager_dns_stub_make_cached_reply(&m, request, &cached) == 1);
+        cached = dns_packet_unref(cached);
+
+        /* An entry is dropped once the shortest TTL in the reply ran out */
+        usleep(USEC_PER_SEC + 100 * USEC_PER_MSEC);
+        assert_se(manager_dns_stub_make_cached_reply(&m, request, &cached) == 0);
+        assert_se(set_isempty(m.dns_stub_replies));
+
+        manager_done_for_test(&m);
+}
+
+static void test_stub_cache_flush(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *request = NULL, *reply = NULL, *cached = NULL;
+        Manager m;
+
+        manager_init_for_test(&m);
+
+        request = make_request(1, "www.example.com", DNS_TYPE_A);
+        reply = make_reply(1, "www.example.com", 60);
+
+        manager_dns_stub_cache_reply(&m, request, reply);
+        assert_se(set_size(m.dns_stub_replies) == 1);
+
+        manager_dns_stub_flush_replies(&m);
+        assert_se(set_isempty(m.dns_stub_replies));
+        assert_se(manager_dns_stub_make_cached_reply(&m, request, &cached) == 0);
+
+        manager_done_for_test(&m);
+}
+
+int main(int argc, char *argv[]) {
+
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        test_stub_cache_lookup();
+        test_stub_cache_expiry();
+        test_stub_cache_flush();
+
+        return 0;
+}
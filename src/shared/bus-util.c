@@ -1254,6 +1254,93 @@ int bus_map_all_properties(
         return bus_message_map_all_properties(m, map, error, userdata);
 }
 
+/* dbus-daemon limits the number of replies a connection may wait for at the same time (128 by default
+ * on the system bus), hence keep the number of calls in flight well below that */
+#define BUS_CALL_ALL_PENDING_MAX 64U
+
+typedef struct BusCallAllItem {
+        sd_bus_slot *slot;
+        sd_bus_message **reply;
+        size_t *n_pending;
+} BusCallAllItem;
+
+static int call_all_reply(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        BusCallAllItem *i = userdata;
+
+        assert(m);
+        assert(i);
+        assert(*i->n_pending > 0);
+
+        *i->reply = sd_bus_message_ref(m);
+        (*i->n_pending)--;
+
+        return 1;
+}
+
+int bus_call_all(sd_bus *bus, sd_bus_message **calls, size_t n, uint64_t usec, sd_bus_message **ret_replies) {
+        _cleanup_free_ BusCallAllItem *items = NULL;
+        size_t i, n_sent = 0, n_pending = 0;
+        int r;
+
+        /* Issues all the method calls without waiting for the replies in between, and returns the replies
+         * in the order of the calls. Each reply is either a method return or a method error, the latter
+         * also for calls that timed out. Note that other incoming messages are dispatched while waiting,
+         * unlike with sd_bus_call(). */
+
+        assert(bus);
+        assert(calls || n == 0);
+        assert(ret_replies || n == 0);
+
+        if (n == 0)
+                return 0;
+
+        items = new0(BusCallAllItem, n);
+        if (!items)
+                return -ENOMEM;
+
+        for (i = 0; i < n; i++)
+                ret_replies[i] = NULL;
+
+        for (;;) {
+                while (n_sent < n && n_pending < BUS_CALL_ALL_PENDING_MAX) {
+                        items[n_sent].reply = ret_replies + n_sent;
+                        items[n_sent].n_pending = &n_pending;
+
+                        r = sd_bus_call_async(bus, &items[n_sent].slot, calls[n_sent], call_all_reply, items + n_sent, usec);
+                        if (r < 0)
+                                goto finish;
+
+                        n_sent++;
+                        n_pending++;
+                }
+
+                if (n_pending == 0)
+                        break;
+
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        goto finish;
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, (uint64_t) -1);
+                if (r < 0 && r != -EINTR)
+                        goto finish;
+        }
+
+        r = 0;
+
+finish:
+        for (i = 0; i < n_sent; i++)
+                sd_bus_slot_unref(items[i].slot);
+
+        if (r < 0)
+                for (i = 0; i < n; i++)
+                        ret_replies[i] = sd_bus_message_unref(ret_replies[i]);
+
+        return r;
+}
+
 int bus_connect_transport(BusTransport transport, const char *host, bool user, sd_bus **ret) {
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
         int r;
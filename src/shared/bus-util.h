@@ -54,6 +54,8 @@ int bus_message_map_all_properties(sd_bus_message *m, const struct bus_propertie
 int bus_message_map_properties_changed(sd_bus_message *m, const struct bus_properties_map *map, sd_bus_error *error, void *userdata);
 int bus_map_all_properties(sd_bus *bus, const char *destination, const char *path, const struct bus_properties_map *map, sd_bus_error *error, void *userdata);
 
+int bus_call_all(sd_bus *bus, sd_bus_message **calls, size_t n, uint64_t usec, sd_bus_message **ret_replies);
+
 int bus_async_unregister_and_exit(sd_event *e, sd_bus *bus, const char *name);
 
 typedef bool (*check_idle_t)(void *userdata);
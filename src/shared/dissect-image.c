@@ -742,6 +742,7 @@ typedef struct DecryptedPartition {
         struct crypt_device *device;
         char *name;
         bool relinquished;
+        bool shared;
 } DecryptedPartition;
 
 struct DecryptedImage {
@@ -762,7 +763,7 @@ DecryptedImage* decrypted_image_unref(DecryptedImage* d) {
         for (i = 0; i < d->n_decrypted; i++) {
                 DecryptedPartition *p = d->decrypted + i;
 
-                if (p->device && p->name && !p->relinquished) {
+                if (p->device && p->name && !p->relinquished && !p->shared) {
                         r = crypt_deactivate(p->device, p->name);
                         if (r < 0)
                                 log_debug_errno(r, "Failed to deactivate encrypted partition %s", p->name);
@@ -877,6 +878,94 @@ fail:
         return r;
 }
 
+static int verity_can_reuse(
+                struct crypt_device *cd,
+                const char *name,
+                const void *root_hash,
+                size_t root_hash_size,
+                struct crypt_device **ret) {
+
+        struct crypt_params_verity our_params = {}, their_params = {};
+        _cleanup_free_ void *their_root_hash = NULL;
+        struct crypt_device *existing = NULL;
+        size_t their_root_hash_size;
+        int r;
+
+        assert(cd);
+        assert(name);
+        assert(root_hash);
+        assert(ret);
+
+        /* A device by our name exists already. Before we use it, make sure it actually is a verity device set up
+         * with the same root hash and the same hash tree geometry as ours. Only then all reads from it are
+         * verified against the same data we'd set up ourselves. */
+
+        r = crypt_init_by_name(&existing, name);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to open existing verity device %s: %m", name);
+
+        if (!streq_ptr(crypt_get_type(existing), CRYPT_VERITY)) {
+                log_debug("Device %s exists already, but is not a verity device, refusing.", name);
+                r = -EEXIST;
+                goto fail;
+        }
+
+        r = crypt_get_verity_info(cd, &our_params);
+        if (r < 0)
+                goto fail;
+
+        r = crypt_get_verity_info(existing, &their_params);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to query parameters of existing verity device %s: %m", name);
+                goto fail;
+        }
+
+        if (our_params.hash_type != their_params.hash_type ||
+            our_params.data_block_size != their_params.data_block_size ||
+            our_params.hash_block_size != their_params.hash_block_size ||
+            our_params.data_size != their_params.data_size ||
+            our_params.salt_size != their_params.salt_size ||
+            (our_params.salt_size > 0 && memcmp(our_params.salt, their_params.salt, our_params.salt_size) != 0) ||
+            !streq_ptr(our_params.hash_name, their_params.hash_name)) {
+                log_debug("Device %s exists already, but its verity parameters differ from ours, refusing.", name);
+                r = -EEXIST;
+                goto fail;
+        }
+
+        /* For verity devices the volume key is the root hash */
+        their_root_hash_size = crypt_get_volume_key_size(existing);
+        if (their_root_hash_size != root_hash_size) {
+                log_debug("Device %s exists already, but uses a root hash of different size, refusing.", name);
+                r = -EEXIST;
+                goto fail;
+        }
+
+        their_root_hash = malloc(their_root_hash_size);
+        if (!their_root_hash) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        r = crypt_volume_key_get(existing, CRYPT_ANY_SLOT, their_root_hash, &their_root_hash_size, NULL, 0);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to read root hash of existing verity device %s: %m", name);
+                goto fail;
+        }
+
+        if (their_root_hash_size != root_hash_size || memcmp(their_root_hash, root_hash, root_hash_size) != 0) {
+                log_debug("Device %s exists already, but uses a different root hash, refusing.", name);
+                r = -EEXIST;
+                goto fail;
+        }
+
+        *ret = existing;
+        return 0;
+
+fail:
+        crypt_free(existing);
+        return r;
+}
+
 static int verity_partition(
                 DissectedPartition *m,
                 DissectedPartition *v,
@@ -885,8 +974,9 @@ static int verity_partition(
                 DissectImageFlags flags,
                 DecryptedImage *d) {
 
-        _cleanup_free_ char *node = NULL, *name = NULL;
+        _cleanup_free_ char *node = NULL, *name = NULL, *hash = NULL;
         struct crypt_device *cd;
+        bool shareable = false, shared = false;
         int r;
 
         assert(m);
@@ -903,9 +993,30 @@ static int verity_partition(
         if (!streq(v->fstype, "DM_verity_hash"))
                 return 0;
 
-        r = make_dm_name_and_node(m->node, "-verity", &name, &node);
-        if (r < 0)
-                return r;
+        /* Name the device after the root hash rather than after the loop device the image is attached to, so that
+         * multiple concurrent users of the same image (think a bunch of portable services or nspawn --image
+         * instances started in parallel) share a single verity device instead of setting up one each. Since the
+         * root hash covers the whole data, any device by that name exposes exactly the data we'd set up
+         * ourselves. If the hash is too long for a DM name, fall back to the per-loop device name. */
+        hash = hexmem(root_hash, root_hash_size);
+        if (!hash)
+                return -ENOMEM;
+
+        if (strlen(hash) + strlen("-verity") < DM_NAME_LEN) {
+                name = strjoin(hash, "-verity");
+                if (!name)
+                        return -ENOMEM;
+
+                node = strjoin(crypt_get_dir(), "/", name);
+                if (!node)
+                        return -ENOMEM;
+
+                shareable = true;
+        } else {
+                r = make_dm_name_and_node(m->node, "-verity", &name, &node);
+                if (r < 0)
+                        return r;
+        }
 
         if (!GREEDY_REALLOC0(d->decrypted, d->n_allocated, d->n_decrypted + 1))
                 return -ENOMEM;
@@ -923,6 +1034,34 @@ static int verity_partition(
                 goto fail;
 
         r = crypt_activate_by_volume_key(cd, name, root_hash, root_hash_size, CRYPT_ACTIVATE_READONLY);
+        if (shareable && IN_SET(r, -EEXIST, -EBUSY)) {
+                struct crypt_device *existing;
+
+                /* Somebody else activated this image with this root hash already, let's reuse their device, if it
+                 * really is the same. */
+                if (r == -EEXIST && verity_can_reuse(cd, name, root_hash, root_hash_size, &existing) >= 0) {
+                        log_debug("Reusing existing verity device %s.", name);
+
+                        crypt_free(cd);
+                        cd = existing;
+                        shared = true;
+                        r = 0;
+                } else {
+                        /* The device is not what we'd set up ourselves, or it is just going away, for example
+                         * because its last user released it while it was marked for deferred removal. Don't wait
+                         * for it, but set up a device of our own, named after the loop device. */
+                        log_debug_errno(r, "Cannot reuse verity device %s, setting up a private one: %m", name);
+
+                        name = mfree(name);
+                        node = mfree(node);
+
+                        r = make_dm_name_and_node(m->node, "-verity", &name, &node);
+                        if (r < 0)
+                                goto fail;
+
+                        r = crypt_activate_by_volume_key(cd, name, root_hash, root_hash_size, CRYPT_ACTIVATE_READONLY);
+                }
+        }
         if (r < 0)
                 goto fail;
 
@@ -930,6 +1069,7 @@ static int verity_partition(
         name = NULL;
 
         d->decrypted[d->n_decrypted].device = cd;
+        d->decrypted[d->n_decrypted].shared = shared;
         d->n_decrypted++;
 
         m->decrypted_node = node;
@@ -40,6 +40,7 @@
 #include "hashmap.h"
 #include "install-printf.h"
 #include "install.h"
+#include "list.h"
 #include "locale-util.h"
 #include "log.h"
 #include "macro.h"
@@ -62,9 +63,12 @@ typedef enum SearchFlags {
         SEARCH_FOLLOW_CONFIG_SYMLINKS = 2,
 } SearchFlags;
 
+typedef struct SymlinkIndex SymlinkIndex;
+
 typedef struct {
         OrderedHashmap *will_process;
         OrderedHashmap *have_processed;
+        const SymlinkIndex *index;
 } InstallContext;
 
 typedef enum {
@@ -110,8 +114,6 @@ static inline void presets_freep(Presets *p) {
         p->n_rules = 0;
 }
 
-static int unit_file_lookup_state(UnitFileScope scope, const LookupPaths *paths, const char *name, UnitFileState *ret);
-
 bool unit_type_may_alias(UnitType type) {
         return IN_SET(type,
                       UNIT_SERVICE,
@@ -724,24 +726,84 @@ static bool is_symlink_with_known_name(const UnitFileInstallInfo *i, const char
         return false;
 }
 
-static int find_symlinks_fd(
-                const char *root_dir,
+static int find_symlinks_match(
                 UnitFileInstallInfo *i,
                 bool match_aliases,
-                int fd,
                 const char *path,
+                const char *dest,
                 const char *config_path,
                 bool *same_name_link) {
 
+        bool found_path, found_dest, b = false;
+        int q;
+
+        assert(i);
+        assert(path);
+        assert(dest);
+        assert(config_path);
+        assert(same_name_link);
+
+        /* Check if the symlink itself matches what we
+         * are looking for */
+        if (path_is_absolute(i->name))
+                found_path = path_equal(path, i->name);
+        else
+                found_path = streq(basename(path), i->name);
+
+        /* Check if what the symlink points to
+         * matches what we are looking for */
+        if (path_is_absolute(i->name))
+                found_dest = path_equal(dest, i->name);
+        else
+                found_dest = streq(basename(dest), i->name);
+
+        if (found_path && found_dest) {
+                _cleanup_free_ char *t = NULL;
+
+                /* Filter out same name links in the main
+                 * config path */
+                t = path_make_absolute(i->name, config_path);
+                if (!t)
+                        return -ENOMEM;
+
+                b = path_equal(t, path);
+        }
+
+        if (b)
+                *same_name_link = true;
+        else if (found_path || found_dest) {
+                if (!match_aliases)
+                        return 1;
+
+                /* Check if symlink name is in the set of names used by [Install] */
+                q = is_symlink_with_known_name(i, basename(path));
+                if (q < 0)
+                        return q;
+                if (q > 0)
+                        return 1;
+        }
+
+        return 0;
+}
+
+typedef int (*symlink_callback_t)(const char *path, char **dest, const char *config_path, void *userdata);
+
+static int for_each_symlink_fd(
+                const char *root_dir,
+                int fd,
+                const char *path,
+                const char *config_path,
+                symlink_callback_t cb,
+                void *userdata) {
+
         _cleanup_closedir_ DIR *d = NULL;
         struct dirent *de;
         int r = 0;
 
-        assert(i);
         assert(fd >= 0);
         assert(path);
         assert(config_path);
-        assert(same_name_link);
+        assert(cb);
 
         d = fdopendir(fd);
         if (!d) {
@@ -774,8 +836,7 @@ static int find_symlinks_fd(
                         }
 
                         /* This will close nfd, regardless whether it succeeds or not */
-                        q = find_symlinks_fd(root_dir, i, match_aliases, nfd,
-                                             p, config_path, same_name_link);
+                        q = for_each_symlink_fd(root_dir, nfd, p, config_path, cb, userdata);
                         if (q > 0)
                                 return 1;
                         if (r == 0)
@@ -783,7 +844,6 @@ static int find_symlinks_fd(
 
                 } else if (de->d_type == DT_LNK) {
                         _cleanup_free_ char *p = NULL, *dest = NULL;
-                        bool found_path, found_dest, b = false;
                         int q;
 
                         /* Acquire symlink name */
@@ -813,79 +873,292 @@ static int find_symlinks_fd(
                                 dest = x;
                         }
 
-                        /* Check if the symlink itself matches what we
-                         * are looking for */
-                        if (path_is_absolute(i->name))
-                                found_path = path_equal(p, i->name);
-                        else
-                                found_path = streq(de->d_name, i->name);
+                        /* The callback may take possession of dest, in which case it resets it to NULL */
+                        q = cb(p, &dest, config_path, userdata);
+                        if (q != 0)
+                                return q;
+                }
+        }
 
-                        /* Check if what the symlink points to
-                         * matches what we are looking for */
-                        if (path_is_absolute(i->name))
-                                found_dest = path_equal(dest, i->name);
-                        else
-                                found_dest = streq(basename(dest), i->name);
+        return r;
+}
 
-                        if (found_path && found_dest) {
-                                _cleanup_free_ char *t = NULL;
+static int for_each_symlink(
+                const char *root_dir,
+                const char *config_path,
+                symlink_callback_t cb,
+                void *userdata) {
 
-                                /* Filter out same name links in the main
-                                 * config path */
-                                t = path_make_absolute(i->name, config_path);
-                                if (!t)
-                                        return -ENOMEM;
+        int fd;
 
-                                b = path_equal(t, p);
-                        }
+        assert(config_path);
+        assert(cb);
 
-                        if (b)
-                                *same_name_link = true;
-                        else if (found_path || found_dest) {
-                                if (!match_aliases)
-                                        return 1;
-
-                                /* Check if symlink name is in the set of names used by [Install] */
-                                q = is_symlink_with_known_name(i, de->d_name);
-                                if (q < 0)
-                                        return q;
-                                if (q > 0)
-                                        return 1;
-                        }
+        fd = open(config_path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC);
+        if (fd < 0) {
+                if (IN_SET(errno, ENOENT, ENOTDIR, EACCES))
+                        return 0;
+                return -errno;
+        }
+
+        /* This takes possession of fd and closes it */
+        return for_each_symlink_fd(root_dir, fd, config_path, config_path, cb, userdata);
+}
+
+typedef struct SymlinkIndexEntry SymlinkIndexEntry;
+
+struct SymlinkIndexEntry {
+        const char *config_path;
+        char *path;
+        char *dest;
+
+        LIST_FIELDS(SymlinkIndexEntry, by_name);
+        LIST_FIELDS(SymlinkIndexEntry, by_dest);
+};
+
+/* All symlinks below the search path, collected in one go, for callers which look up the state of many unit
+ * files at once */
+struct SymlinkIndex {
+        Hashmap *by_name; /* symlink name → SymlinkIndexEntry list */
+        Hashmap *by_dest; /* file name of the symlink destination → SymlinkIndexEntry list */
+        Hashmap *errors;  /* config path → first error encountered while indexing it */
+        Hashmap *entries; /* search path directory → Set of file names directly in it */
+};
+
+static void symlink_index_done(SymlinkIndex *index) {
+        SymlinkIndexEntry *head, *e, *n;
+        Set *s;
+        Iterator j;
+
+        assert(index);
+
+        HASHMAP_FOREACH(head, index->by_name, j)
+                LIST_FOREACH_SAFE(by_name, e, n, head) {
+                        free(e->path);
+                        free(e->dest);
+                        free(e);
                 }
+
+        index->by_name = hashmap_free(index->by_name);
+        index->by_dest = hashmap_free(index->by_dest);
+        index->errors = hashmap_free(index->errors);
+
+        while ((s = hashmap_steal_first(index->entries)))
+                set_free_free(s);
+        index->entries = hashmap_free(index->entries);
+}
+
+static int symlink_index_add(const char *path, char **dest, const char *config_path, void *userdata) {
+        SymlinkIndex *index = userdata;
+        SymlinkIndexEntry *e, *head;
+        int r;
+
+        assert(path);
+        assert(dest);
+        assert(config_path);
+        assert(index);
+
+        e = new0(SymlinkIndexEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->path = strdup(path);
+        if (!e->path) {
+                free(e);
+                return -ENOMEM;
         }
 
-        return r;
+        e->config_path = config_path;
+        e->dest = *dest;
+        *dest = NULL;
+
+        /* Once linked into by_name the entry is owned by the index */
+        head = hashmap_get(index->by_name, basename(e->path));
+        LIST_PREPEND(by_name, head, e);
+        r = hashmap_replace(index->by_name, basename(e->path), head);
+        if (r < 0) {
+                LIST_REMOVE(by_name, head, e);
+                free(e->path);
+                free(e->dest);
+                free(e);
+                return r;
+        }
+
+        head = hashmap_get(index->by_dest, basename(e->dest));
+        LIST_PREPEND(by_dest, head, e);
+        r = hashmap_replace(index->by_dest, basename(e->dest), head);
+        if (r < 0)
+                return r;
+
+        return 0;
+}
+
+static int symlink_index_list_directory(SymlinkIndex *index, const char *path) {
+        _cleanup_set_free_free_ Set *s = NULL;
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        int r;
+
+        assert(index);
+        assert(path);
+
+        s = set_new(&string_hash_ops);
+        if (!s)
+                return -ENOMEM;
+
+        /* A missing directory is remembered as empty, so that lookups don't have to try it again. On any other
+         * error we store nothing and lookups fall back to checking the file system directly. */
+        d = opendir(path);
+        if (!d && errno != ENOENT)
+                return 0;
+
+        if (d)
+                FOREACH_DIRENT(de, d, return 0) {
+                        r = set_put_strdup(s, de->d_name);
+                        if (r < 0)
+                                return r;
+                }
+
+        r = hashmap_put(index->entries, path, s);
+        if (r < 0)
+                return r;
+
+        s = NULL;
+        return 0;
+}
+
+static bool symlink_index_may_contain(const SymlinkIndex *index, const char *path, const char *name) {
+        Set *s;
+
+        assert(path);
+        assert(name);
+
+        if (!index)
+                return true;
+
+        s = hashmap_get(index->entries, path);
+        if (!s)
+                return true;
+
+        return set_contains(s, name);
+}
+
+static int symlink_index_build(SymlinkIndex *index, const LookupPaths *paths) {
+        char **p;
+        int r;
+
+        assert(index);
+        assert(paths);
+
+        index->by_name = hashmap_new(&string_hash_ops);
+        index->by_dest = hashmap_new(&string_hash_ops);
+        index->errors = hashmap_new(&string_hash_ops);
+        index->entries = hashmap_new(&string_hash_ops);
+        if (!index->by_name || !index->by_dest || !index->errors || !index->entries)
+                return -ENOMEM;
+
+        STRV_FOREACH(p, paths->search_path) {
+                r = symlink_index_list_directory(index, *p);
+                if (r < 0)
+                        return r;
+
+                r = for_each_symlink(paths->root_dir, *p, symlink_index_add, index);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0) {
+                        /* Remember the error, so that lookups report it just like a direct scan would */
+                        r = hashmap_put(index->errors, *p, INT_TO_PTR(r));
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static int symlink_index_find(
+                const SymlinkIndex *index,
+                UnitFileInstallInfo *i,
+                bool match_aliases,
+                const char *config_path,
+                bool *same_name_link) {
+
+        SymlinkIndexEntry *e;
+        int r;
+
+        assert(index);
+        assert(i);
+        assert(!path_is_absolute(i->name));
+        assert(config_path);
+        assert(same_name_link);
+
+        LIST_FOREACH(by_name, e, hashmap_get(index->by_name, i->name)) {
+                if (!streq(e->config_path, config_path))
+                        continue;
+
+                r = find_symlinks_match(i, match_aliases, e->path, e->dest, config_path, same_name_link);
+                if (r != 0)
+                        return r;
+        }
+
+        LIST_FOREACH(by_dest, e, hashmap_get(index->by_dest, i->name)) {
+                if (!streq(e->config_path, config_path))
+                        continue;
+
+                /* Already covered above */
+                if (streq(basename(e->path), i->name))
+                        continue;
+
+                r = find_symlinks_match(i, match_aliases, e->path, e->dest, config_path, same_name_link);
+                if (r != 0)
+                        return r;
+        }
+
+        return PTR_TO_INT(hashmap_get(index->errors, config_path));
+}
+
+typedef struct FindSymlinksData {
+        UnitFileInstallInfo *info;
+        bool match_aliases;
+        bool *same_name_link;
+} FindSymlinksData;
+
+static int find_symlinks_one(const char *path, char **dest, const char *config_path, void *userdata) {
+        FindSymlinksData *data = userdata;
+
+        assert(data);
+
+        return find_symlinks_match(data->info, data->match_aliases, path, *dest, config_path, data->same_name_link);
 }
 
 static int find_symlinks(
                 const char *root_dir,
+                const SymlinkIndex *index,
                 UnitFileInstallInfo *i,
                 bool match_name,
                 const char *config_path,
                 bool *same_name_link) {
 
-        int fd;
+        FindSymlinksData data = {
+                .info = i,
+                .match_aliases = match_name,
+                .same_name_link = same_name_link,
+        };
 
         assert(i);
         assert(config_path);
         assert(same_name_link);
 
-        fd = open(config_path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC);
-        if (fd < 0) {
-                if (IN_SET(errno, ENOENT, ENOTDIR, EACCES))
-                        return 0;
-                return -errno;
-        }
+        if (index && !path_is_absolute(i->name))
+                return symlink_index_find(index, i, match_name, config_path, same_name_link);
 
-        /* This takes possession of fd and closes it */
-        return find_symlinks_fd(root_dir, i, match_name, fd,
-                                config_path, config_path, same_name_link);
+        return for_each_symlink(root_dir, config_path, find_symlinks_one, &data);
 }
 
 static int find_symlinks_in_scope(
                 UnitFileScope scope,
                 const LookupPaths *paths,
+                const SymlinkIndex *index,
                 UnitFileInstallInfo *i,
                 bool match_name,
                 UnitFileState *state) {
@@ -901,7 +1174,7 @@ static int find_symlinks_in_scope(
         STRV_FOREACH(p, paths->search_path)  {
                 bool same_name_link = false;
 
-                r = find_symlinks(paths->root_dir, i, match_name, *p, &same_name_link);
+                r = find_symlinks(paths->root_dir, index, i, match_name, *p, &same_name_link);
                 if (r < 0)
                         return r;
                 if (r > 0) {
@@ -1416,6 +1689,9 @@ static int unit_file_search(
         STRV_FOREACH(p, paths->search_path) {
                 _cleanup_free_ char *path = NULL;
 
+                if (!symlink_index_may_contain(c ? c->index : NULL, *p, info->name))
+                        continue;
+
                 path = strjoin(*p, "/", info->name);
                 if (!path)
                         return -ENOMEM;
@@ -1441,6 +1717,9 @@ static int unit_file_search(
                 STRV_FOREACH(p, paths->search_path) {
                         _cleanup_free_ char *path = NULL;
 
+                        if (!symlink_index_may_contain(c ? c->index : NULL, *p, template))
+                                continue;
+
                         path = strjoin(*p, "/", template);
                         if (!path)
                                 return -ENOMEM;
@@ -2599,10 +2878,13 @@ int unit_file_get_default(
 static int unit_file_lookup_state(
                 UnitFileScope scope,
                 const LookupPaths *paths,
+                const SymlinkIndex *index,
                 const char *name,
                 UnitFileState *ret) {
 
-        _cleanup_(install_context_done) InstallContext c = {};
+        _cleanup_(install_context_done) InstallContext c = {
+                .index = index,
+        };
         UnitFileInstallInfo *i;
         UnitFileState state;
         int r;
@@ -2652,7 +2934,7 @@ static int unit_file_lookup_state(
                 /* Check if any of the Alias= symlinks have been created.
                  * We ignore other aliases, and only check those that would
                  * be created by systemctl enable for this unit. */
-                r = find_symlinks_in_scope(scope, paths, i, true, &state);
+                r = find_symlinks_in_scope(scope, paths, index, i, true, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2660,7 +2942,7 @@ static int unit_file_lookup_state(
 
                 /* Check if the file is known under other names. If it is,
                  * it might be in use. Report that as UNIT_FILE_INDIRECT. */
-                r = find_symlinks_in_scope(scope, paths, i, false, &state);
+                r = find_symlinks_in_scope(scope, paths, index, i, false, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2701,7 +2983,7 @@ int unit_file_get_state(
         if (r < 0)
                 return r;
 
-        return unit_file_lookup_state(scope, &paths, name, ret);
+        return unit_file_lookup_state(scope, &paths, NULL, name, ret);
 }
 
 int unit_file_exists(UnitFileScope scope, const LookupPaths *paths, const char *name) {
@@ -3098,6 +3380,7 @@ int unit_file_get_list(
                 char **patterns) {
 
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
+        _cleanup_(symlink_index_done) SymlinkIndex index = {};
         char **i;
         int r;
 
@@ -3109,6 +3392,12 @@ int unit_file_get_list(
         if (r < 0)
                 return r;
 
+        /* Determining the state of a unit file means scanning the search path for symlinks to it. Do that once
+         * for all of them, instead of once per listed unit file. */
+        r = symlink_index_build(&index, &paths);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, paths.search_path) {
                 _cleanup_closedir_ DIR *d = NULL;
                 struct dirent *de;
@@ -3150,7 +3439,7 @@ int unit_file_get_list(
                         if (!f->path)
                                 return -ENOMEM;
 
-                        r = unit_file_lookup_state(scope, &paths, de->d_name, &f->state);
+                        r = unit_file_lookup_state(scope, &paths, &index, de->d_name, &f->state);
                         if (r < 0)
                                 f->state = UNIT_FILE_BAD;
 
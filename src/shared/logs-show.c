@@ -322,6 +322,19 @@ static int output_timestamp_realtime(FILE *f, sd_journal *j, OutputMode mode, Ou
         return (int) strlen(buf);
 }
 
+static const char* const short_fields[] = {
+        "PRIORITY",
+        "_HOSTNAME",
+        "SYSLOG_IDENTIFIER",
+        "_COMM",
+        "_PID",
+        "SYSLOG_PID",
+        "_SOURCE_REALTIME_TIMESTAMP",
+        "_SOURCE_MONOTONIC_TIMESTAMP",
+        "MESSAGE",
+        NULL
+};
+
 static int output_short(
                 FILE *f,
                 sd_journal *j,
@@ -349,6 +362,12 @@ static int output_short(
          */
         sd_journal_set_data_threshold(j, flags & (OUTPUT_SHOW_ALL|OUTPUT_FULL_WIDTH) ? 0 : PRINT_CHAR_THRESHOLD + 1);
 
+        /* Only enumerate the fields we are going to look at below, so that the rest of the entry is
+         * neither mapped in full nor decompressed */
+        r = sd_journal_set_data_fields(j, (char**) short_fields);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set data fields: %m");
+
         JOURNAL_FOREACH_DATA_RETVAL(j, data, length, r) {
 
                 r = parse_field(data, length, "PRIORITY=", &priority, &priority_len);
@@ -491,6 +510,7 @@ static int output_verbose(
         assert(j);
 
         sd_journal_set_data_threshold(j, 0);
+        (void) sd_journal_set_data_fields(j, NULL);
 
         r = sd_journal_get_data(j, "_SOURCE_REALTIME_TIMESTAMP", &data, &length);
         if (r == -ENOENT)
@@ -588,6 +608,7 @@ static int output_export(
         assert(j);
 
         sd_journal_set_data_threshold(j, 0);
+        (void) sd_journal_set_data_fields(j, NULL);
 
         r = sd_journal_get_realtime_usec(j, &realtime);
         if (r < 0)
@@ -649,19 +670,59 @@ static int output_export(
         return 0;
 }
 
+/* Bytes that are not plain printable ASCII or that need escaping in JSON strings */
+static const bool json_special[256] = {
+        [0x00 ... 0x1f] = true,
+        ['"'] = true,
+        ['\\'] = true,
+        [0x7f ... 0xff] = true,
+};
+
+static size_t json_plain_span(const char *p, size_t l) {
+        const uint8_t *s = (const uint8_t*) p;
+        size_t i = 0;
+
+        /* Returns the length of the prefix of p that can be copied verbatim. Checks four bytes per
+         * iteration, field data is mostly long runs of plain text. */
+
+        while (i + 4 <= l) {
+                if (json_special[s[i]] | json_special[s[i+1]] |
+                    json_special[s[i+2]] | json_special[s[i+3]])
+                        break;
+                i += 4;
+        }
+
+        while (i < l && !json_special[s[i]])
+                i++;
+
+        return i;
+}
+
 void json_escape(
                 FILE *f,
                 const char* p,
                 size_t l,
                 OutputFlags flags) {
 
+        size_t n;
+
         assert(f);
         assert(p);
 
-        if (!(flags & OUTPUT_SHOW_ALL) && l >= JSON_THRESHOLD)
+        if (!(flags & OUTPUT_SHOW_ALL) && l >= JSON_THRESHOLD) {
                 fputs("null", f);
+                return;
+        }
+
+        n = json_plain_span(p, l);
+        if (n == l) {
+                /* The common case: plain ASCII, which is printable and needs no escaping, hence skip the
+                 * UTF-8 validation and copy it in one go */
+                fputc('\"', f);
+                fwrite(p, 1, l, f);
+                fputc('\"', f);
 
-        else if (!(flags & OUTPUT_SHOW_ALL) && !utf8_is_printable(p, l)) {
+        } else if (!(flags & OUTPUT_SHOW_ALL) && !utf8_is_printable(p, l)) {
                 bool not_first = false;
 
                 fputs("[ ", f);
@@ -682,7 +743,16 @@ void json_escape(
         } else {
                 fputc('\"', f);
 
-                while (l > 0) {
+                for (;;) {
+                        /* Write out runs of characters that need no escaping in one go, straight from
+                         * the source buffer, rather than pushing them through stdio one by one */
+                        fwrite(p, 1, n, f);
+                        p += n;
+                        l -= n;
+
+                        if (l == 0)
+                                break;
+
                         if (*p == '"' || *p == '\\') {
                                 fputc('\\', f);
                                 fputc(*p, f);
@@ -695,6 +765,8 @@ void json_escape(
 
                         p++;
                         l--;
+
+                        n = json_plain_span(p, l);
                 }
 
                 fputc('\"', f);
@@ -721,6 +793,7 @@ static int output_json(
         assert(j);
 
         sd_journal_set_data_threshold(j, flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+        (void) sd_journal_set_data_fields(j, NULL);
 
         r = sd_journal_get_realtime_usec(j, &realtime);
         if (r < 0)
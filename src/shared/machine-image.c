@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <linux/fs.h>
@@ -395,6 +396,35 @@ int image_discover(Hashmap *h) {
         return 0;
 }
 
+int image_discover_watch(int fd) {
+        const char *path;
+
+        assert(fd >= 0);
+
+        /* Adds inotify watches to the specified inotify fd, so that it becomes readable whenever the result of
+         * image_discover() might have changed. For search path directories that don't exist yet, the parent
+         * directory is watched instead, so that we notice when they are created. Note that changes inside of
+         * images are not covered, hence the usage and limit fields might still change without notification. */
+
+        NULSTR_FOREACH(path, image_search_path) {
+                _cleanup_free_ char *parent = NULL;
+
+                if (inotify_add_watch(fd, path, IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR) >= 0)
+                        continue;
+                if (errno != ENOENT)
+                        return -errno;
+
+                parent = dirname_malloc(path);
+                if (!parent)
+                        return -ENOMEM;
+
+                if (inotify_add_watch(fd, parent, IN_CREATE|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR) < 0)
+                        return -errno;
+        }
+
+        return 0;
+}
+
 void image_hashmap_free(Hashmap *map) {
         Image *i;
 
@@ -656,7 +686,7 @@ int image_clone(Image *i, const char *new_name, bool read_only) {
         case IMAGE_RAW:
                 new_path = strjoina("/var/lib/machines/", new_name, ".raw");
 
-                r = copy_file_atomic(i->path, new_path, read_only ? 0444 : 0644, FS_NOCOW_FL, COPY_REFLINK);
+                r = copy_file_atomic(i->path, new_path, read_only ? 0444 : 0644, FS_NOCOW_FL, COPY_REFLINK|COPY_HOLES);
                 break;
 
         default:
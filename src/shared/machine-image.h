@@ -62,6 +62,7 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(Hashmap*, image_hashmap_free);
 
 int image_find(const char *name, Image **ret);
 int image_discover(Hashmap *map);
+int image_discover_watch(int fd);
 
 int image_remove(Image *i);
 int image_rename(Image *i, const char *new_name);
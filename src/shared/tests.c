@@ -23,8 +23,14 @@
 #include <stdlib.h>
 #include <util.h>
 
-#include "tests.h"
+#include "env-util.h"
+#include "log.h"
+#include "parse-util.h"
 #include "path-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+#define BENCHMARK_REPETITIONS_DEFAULT 5U
 
 char* setup_fake_runtime_dir(void) {
         char t[] = "/tmp/fake-xdg-runtime-XXXXXX", *p;
@@ -71,3 +77,84 @@ const char* get_testdata_dir(const char *suffix) {
         strncpy(testdir + strlen(testdir), suffix, sizeof(testdir) - strlen(testdir) - 1);
         return testdir;
 }
+
+unsigned benchmark_get_iterations(int argc, char *argv[], unsigned fast, unsigned slow) {
+        unsigned n;
+        int r;
+
+        /* An explicit number of operations on the command line wins, otherwise pick a larger
+         * one for $SYSTEMD_SLOW_TESTS, which makes for more stable numbers. */
+
+        if (argc >= 2) {
+                assert_se(safe_atou(argv[1], &n) >= 0 && n > 0);
+                return n;
+        }
+
+        r = getenv_bool("SYSTEMD_SLOW_TESTS");
+        if (r < 0)
+                r = SYSTEMD_SLOW_TESTS_DEFAULT;
+
+        return r ? slow : fast;
+}
+
+static unsigned benchmark_get_repetitions(void) {
+        const char *e;
+        unsigned n;
+
+        e = getenv("SYSTEMD_BENCHMARK_REPETITIONS");
+        if (e && safe_atou(e, &n) >= 0 && n > 0)
+                return n;
+
+        return BENCHMARK_REPETITIONS_DEFAULT;
+}
+
+static int nsec_compare(const void *a, const void *b) {
+        const nsec_t *x = a, *y = b;
+
+        if (*x < *y)
+                return -1;
+        if (*x > *y)
+                return 1;
+        return 0;
+}
+
+void benchmark_run(const char *suite, const char *name, unsigned n, benchmark_func_t func, void *userdata) {
+        _cleanup_free_ nsec_t *samples = NULL;
+        unsigned repetitions, i;
+        double best, median;
+
+        assert(suite);
+        assert(name);
+        assert(n > 0);
+        assert(func);
+
+        /* The names end up in the JSON output verbatim */
+        assert(!strpbrk(suite, "\"\\"));
+        assert(!strpbrk(name, "\"\\"));
+
+        repetitions = benchmark_get_repetitions();
+        samples = new(nsec_t, repetitions);
+        assert_se(samples);
+
+        /* The first run is not accounted for, it faults in memory and warms up caches */
+        (void) func(n, userdata);
+
+        for (i = 0; i < repetitions; i++)
+                samples[i] = func(n, userdata);
+
+        qsort_safe(samples, repetitions, sizeof(nsec_t), nsec_compare);
+
+        best = (double) samples[0] / n;
+        median = (double) samples[repetitions / 2] / n;
+
+        log_info("%-16s %-24s %10.1fns/op (median %.1fns/op, %u runs of %u)",
+                 suite, name, best, median, repetitions, n);
+
+        /* Machine readable results go to stdout, one JSON object per line, for comparing against a baseline */
+        if (getenv_bool("SYSTEMD_BENCHMARK_JSON") > 0) {
+                printf("{\"suite\":\"%s\",\"name\":\"%s\",\"operations\":%u,\"repetitions\":%u,"
+                       "\"ns_per_op\":%.1f,\"ns_per_op_median\":%.1f}\n",
+                       suite, name, n, repetitions, best, median);
+                fflush(stdout);
+        }
+}
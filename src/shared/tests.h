@@ -19,5 +19,14 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include "time-util.h"
+
 char* setup_fake_runtime_dir(void);
 const char* get_testdata_dir(const char *suffix);
+
+/* A benchmark function performs n operations and returns how long the measured part of them took, so that it can
+ * set up and tear down whatever it needs around it without that being accounted for. */
+typedef nsec_t (*benchmark_func_t)(unsigned n, void *userdata);
+
+unsigned benchmark_get_iterations(int argc, char *argv[], unsigned fast, unsigned slow);
+void benchmark_run(const char *suite, const char *name, unsigned n, benchmark_func_t func, void *userdata);
@@ -40,19 +40,35 @@
 #include "socket-util.h"
 #include "string-util.h"
 #include "parse-util.h"
+#include "time-util.h"
 #include "util.h"
 
 #define BUFFER_SIZE (256 * 1024)
+
+/* How many drained pipes to keep around for reuse by later connections */
+#define PIPE_POOL_MAX 64U
+
 static unsigned arg_connections_max = 256;
 
 static const char *arg_remote_host = NULL;
 
+typedef struct Pipe {
+        int fds[2];
+        size_t size;
+} Pipe;
+
 typedef struct Context {
         sd_event *event;
         sd_resolve *resolve;
 
         Set *listen;
         Set *connections;
+
+        /* Set while we stopped accepting because the connection limit is reached */
+        bool listen_paused;
+
+        Pipe pipe_pool[PIPE_POOL_MAX];
+        unsigned n_pipe_pool;
 } Context;
 
 typedef struct Connection {
@@ -68,13 +84,60 @@ typedef struct Connection {
         sd_event_source *server_event_source, *client_event_source;
 
         sd_resolve_query *resolve_query;
+
+        usec_t start_usec;
+        uint64_t server_to_client_bytes, client_to_server_bytes;
 } Connection;
 
+static int context_set_listen(Context *context, bool b) {
+        sd_event_source *es;
+        Iterator i;
+        int r;
+
+        assert(context);
+
+        /* Instead of refusing connections beyond the limit we stop accepting them, so that they queue up
+         * in the listen backlog until one of the established connections is closed. */
+
+        SET_FOREACH(es, context->listen, i) {
+                r = sd_event_source_set_enabled(es, b ? SD_EVENT_ONESHOT : SD_EVENT_OFF);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to %s listening socket: %m", b ? "enable" : "disable");
+        }
+
+        context->listen_paused = !b;
+        return 0;
+}
+
+static void context_release_pipe(Context *context, int buffer[2], size_t full, size_t sz) {
+        assert(buffer);
+
+        /* Drained pipes are kept for reuse by later connections, which saves two syscalls for creating and
+         * resizing each of them. Pipes that still contain data are closed. */
+
+        if (context && buffer[0] >= 0 && full == 0 && context->n_pipe_pool < PIPE_POOL_MAX) {
+                Pipe *p = context->pipe_pool + context->n_pipe_pool++;
+
+                p->fds[0] = buffer[0];
+                p->fds[1] = buffer[1];
+                p->size = sz;
+                buffer[0] = buffer[1] = -1;
+                return;
+        }
+
+        safe_close_pair(buffer);
+}
+
 static void connection_free(Connection *c) {
         assert(c);
 
-        if (c->context)
-                set_remove(c->context->connections, c);
+        if (c->start_usec > 0) {
+                char ts[FORMAT_TIMESPAN_MAX];
+
+                log_debug("Closing connection after %s, %" PRIu64 " bytes sent to client, %" PRIu64 " bytes sent to server.",
+                          format_timespan(ts, sizeof(ts), now(CLOCK_MONOTONIC) - c->start_usec, USEC_PER_MSEC),
+                          c->server_to_client_bytes, c->client_to_server_bytes);
+        }
 
         sd_event_source_unref(c->server_event_source);
         sd_event_source_unref(c->client_event_source);
@@ -82,11 +145,18 @@ static void connection_free(Connection *c) {
         safe_close(c->server_fd);
         safe_close(c->client_fd);
 
-        safe_close_pair(c->server_to_client_buffer);
-        safe_close_pair(c->client_to_server_buffer);
+        context_release_pipe(c->context, c->server_to_client_buffer, c->server_to_client_buffer_full, c->server_to_client_buffer_size);
+        context_release_pipe(c->context, c->client_to_server_buffer, c->client_to_server_buffer_full, c->client_to_server_buffer_size);
 
         sd_resolve_query_unref(c->resolve_query);
 
+        if (c->context) {
+                set_remove(c->context->connections, c);
+
+                if (c->context->listen_paused && set_size(c->context->connections) < arg_connections_max)
+                        (void) context_set_listen(c->context, true);
+        }
+
         free(c);
 }
 
@@ -102,6 +172,9 @@ static void context_free(Context *context) {
         while ((c = set_first(context->connections)))
                 connection_free(c);
 
+        while (context->n_pipe_pool > 0)
+                safe_close_pair(context->pipe_pool[--context->n_pipe_pool].fds);
+
         set_free(context->listen);
         set_free(context->connections);
 
@@ -119,6 +192,15 @@ static int connection_create_pipes(Connection *c, int buffer[2], size_t *sz) {
         if (buffer[0] >= 0)
                 return 0;
 
+        if (c->context->n_pipe_pool > 0) {
+                Pipe *p = c->context->pipe_pool + --c->context->n_pipe_pool;
+
+                buffer[0] = p->fds[0];
+                buffer[1] = p->fds[1];
+                *sz = p->size;
+                return 0;
+        }
+
         r = pipe2(buffer, O_CLOEXEC|O_NONBLOCK);
         if (r < 0)
                 return log_error_errno(errno, "Failed to allocate pipe buffer: %m");
@@ -138,7 +220,7 @@ static int connection_create_pipes(Connection *c, int buffer[2], size_t *sz) {
 static int connection_shovel(
                 Connection *c,
                 int *from, int buffer[2], int *to,
-                size_t *full, size_t *sz,
+                size_t *full, size_t *sz, uint64_t *total,
                 sd_event_source **from_source, sd_event_source **to_source) {
 
         bool shoveled;
@@ -151,6 +233,7 @@ static int connection_shovel(
         assert(to);
         assert(full);
         assert(sz);
+        assert(total);
         assert(from_source);
         assert(to_source);
 
@@ -175,6 +258,7 @@ static int connection_shovel(
                         z = splice(buffer[0], NULL, *to, NULL, *full, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
                         if (z > 0) {
                                 *full -= z;
+                                *total += z;
                                 shoveled = true;
                         } else if (z == 0 || errno == EPIPE || errno == ECONNRESET) {
                                 *to_source = sd_event_source_unref(*to_source);
@@ -200,6 +284,7 @@ static int traffic_cb(sd_event_source *s, int fd, uint32_t revents, void *userda
         r = connection_shovel(c,
                               &c->server_fd, c->server_to_client_buffer, &c->client_fd,
                               &c->server_to_client_buffer_full, &c->server_to_client_buffer_size,
+                              &c->server_to_client_bytes,
                               &c->server_event_source, &c->client_event_source);
         if (r < 0)
                 goto quit;
@@ -207,6 +292,7 @@ static int traffic_cb(sd_event_source *s, int fd, uint32_t revents, void *userda
         r = connection_shovel(c,
                               &c->client_fd, c->client_to_server_buffer, &c->server_fd,
                               &c->client_to_server_buffer_full, &c->client_to_server_buffer_size,
+                              &c->client_to_server_bytes,
                               &c->client_event_source, &c->server_event_source);
         if (r < 0)
                 goto quit;
@@ -446,12 +532,6 @@ static int add_connection_socket(Context *context, int fd) {
         assert(context);
         assert(fd >= 0);
 
-        if (set_size(context->connections) > arg_connections_max) {
-                log_warning("Hit connection limit, refusing connection.");
-                safe_close(fd);
-                return 0;
-        }
-
         r = set_ensure_allocated(&context->connections, NULL);
         if (r < 0) {
                 log_oom();
@@ -465,6 +545,7 @@ static int add_connection_socket(Context *context, int fd) {
         }
 
         c->context = context;
+        c->start_usec = now(CLOCK_MONOTONIC);
         c->server_fd = fd;
         c->client_fd = -1;
         c->server_to_client_buffer[0] = c->server_to_client_buffer[1] = -1;
@@ -477,6 +558,11 @@ static int add_connection_socket(Context *context, int fd) {
                 return 0;
         }
 
+        if (set_size(context->connections) >= arg_connections_max) {
+                log_warning("Hit connection limit, not accepting further connections until one is closed.");
+                (void) context_set_listen(context, false);
+        }
+
         return resolve_remote(c);
 }
 
@@ -505,6 +591,9 @@ static int accept_cb(sd_event_source *s, int fd, uint32_t revents, void *userdat
                 }
         }
 
+        if (context->listen_paused)
+                return 1;
+
         r = sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
         if (r < 0) {
                 log_error_errno(r, "Error while re-enabling listener with ONESHOT: %m");
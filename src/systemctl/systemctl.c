@@ -1647,27 +1647,167 @@ static int list_dependencies_print(const char *name, int level, unsigned int bra
         return 0;
 }
 
-static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps) {
-
-        static const char *dependencies[_DEPENDENCY_MAX] = {
-                [DEPENDENCY_FORWARD] = "Requires\0"
-                                       "Requisite\0"
-                                       "Wants\0"
-                                       "ConsistsOf\0"
-                                       "BindsTo\0",
-                [DEPENDENCY_REVERSE] = "RequiredBy\0"
-                                       "RequisiteOf\0"
-                                       "WantedBy\0"
-                                       "PartOf\0"
-                                       "BoundBy\0",
-                [DEPENDENCY_AFTER]   = "After\0",
-                [DEPENDENCY_BEFORE]  = "Before\0",
-        };
+static const char *dependencies[_DEPENDENCY_MAX] = {
+        [DEPENDENCY_FORWARD] = "Requires\0"
+                               "Requisite\0"
+                               "Wants\0"
+                               "ConsistsOf\0"
+                               "BindsTo\0",
+        [DEPENDENCY_REVERSE] = "RequiredBy\0"
+                               "RequisiteOf\0"
+                               "WantedBy\0"
+                               "PartOf\0"
+                               "BoundBy\0",
+        [DEPENDENCY_AFTER]   = "After\0",
+        [DEPENDENCY_BEFORE]  = "Before\0",
+};
+
+typedef struct DependencyNode {
+        char *name;
+        UnitActiveState active_state;
+        char **dependencies;
+} DependencyNode;
+
+static void dependency_graph_free(Hashmap *graph) {
+        DependencyNode *n;
+        Iterator i;
+
+        HASHMAP_FOREACH(n, graph, i) {
+                free(n->name);
+                strv_free(n->dependencies);
+                free(n);
+        }
+
+        hashmap_free(graph);
+}
 
+DEFINE_TRIVIAL_CLEANUP_FUNC(Hashmap*, dependency_graph_free);
+
+static int list_dependencies_get_graph(sd_bus *bus, const char *name, Hashmap **ret) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        _cleanup_(dependency_graph_freep) Hashmap *graph = NULL;
+        _cleanup_strv_free_ char **types = NULL;
+        const char *from, *type, *to, *state;
+        DependencyNode *n;
+        Iterator i;
+        int r;
+
+        assert(bus);
+        assert(name);
+        assert(ret);
+
+        /* Fetches the whole dependency tree in one go. Returns 0 if the manager is too old to support this, in which
+         * case the caller should query each unit separately. */
+
+        types = strv_split_nulstr(dependencies[arg_dependency]);
+        if (!types)
+                return log_oom();
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "ListUnitDependencies");
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append(m, "s", name);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append_strv(m, types);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append(m, "ub", 0, arg_all);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (r < 0) {
+                if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD) ||
+                    sd_bus_error_has_name(&error, SD_BUS_ERROR_ACCESS_DENIED)) {
+                        log_debug_errno(r, "Failed to get dependency graph: %s Falling back to querying units individually.", bus_error_message(&error, r));
+                        *ret = NULL;
+                        return 0;
+                }
+
+                return log_error_errno(r, "Failed to get dependencies of %s: %s", name, bus_error_message(&error, r));
+        }
+
+        graph = hashmap_new(&string_hash_ops);
+        if (!graph)
+                return log_oom();
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ss)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(ss)", &to, &state)) > 0) {
+                n = new0(DependencyNode, 1);
+                if (!n)
+                        return log_oom();
+
+                n->name = strdup(to);
+                if (!n->name) {
+                        free(n);
+                        return log_oom();
+                }
+
+                n->active_state = unit_active_state_from_string(state);
+
+                r = hashmap_put(graph, n->name, n);
+                if (r < 0) {
+                        free(n->name);
+                        free(n);
+                        return log_error_errno(r, "Failed to add %s to dependency graph: %m", to);
+                }
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sss)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(sss)", &from, &type, &to)) > 0) {
+                n = hashmap_get(graph, from);
+                if (!n)
+                        continue;
+
+                r = strv_extend(&n->dependencies, to);
+                if (r < 0)
+                        return log_oom();
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        HASHMAP_FOREACH(n, graph, i)
+                strv_uniq(n->dependencies);
+
+        *ret = graph;
+        graph = NULL;
+
+        return 1;
+}
+
+static int list_dependencies_get_dependencies(sd_bus *bus, Hashmap *graph, const char *name, char ***deps) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_strv_free_ char **ret = NULL;
         _cleanup_free_ char *path = NULL;
+        DependencyNode *n;
         int r;
 
         assert(bus);
@@ -1675,6 +1815,18 @@ static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, cha
         assert(deps);
         assert_cc(ELEMENTSOF(dependencies) == _DEPENDENCY_MAX);
 
+        n = hashmap_get(graph, name);
+        if (n) {
+                ret = strv_copy(n->dependencies);
+                if (!ret)
+                        return log_oom();
+
+                *deps = ret;
+                ret = NULL;
+
+                return 0;
+        }
+
         path = unit_dbus_path_from_name(name);
         if (!path)
                 return log_oom();
@@ -1752,6 +1904,7 @@ static int list_dependencies_compare(const void *_a, const void *_b) {
 
 static int list_dependencies_one(
                 sd_bus *bus,
+                Hashmap *graph,
                 const char *name,
                 int level,
                 char ***units,
@@ -1769,7 +1922,7 @@ static int list_dependencies_one(
         if (r < 0)
                 return log_oom();
 
-        r = list_dependencies_get_dependencies(bus, name, &deps);
+        r = list_dependencies_get_dependencies(bus, graph, name, &deps);
         if (r < 0)
                 return r;
 
@@ -1790,9 +1943,14 @@ static int list_dependencies_one(
                         printf("  ");
                 else {
                         UnitActiveState active_state = _UNIT_ACTIVE_STATE_INVALID;
+                        DependencyNode *n;
                         const char *on;
 
-                        (void) get_state_one_unit(bus, *c, &active_state);
+                        n = hashmap_get(graph, *c);
+                        if (n)
+                                active_state = n->active_state;
+                        else
+                                (void) get_state_one_unit(bus, *c, &active_state);
 
                         switch (active_state) {
                         case UNIT_ACTIVE:
@@ -1819,7 +1977,7 @@ static int list_dependencies_one(
                         return r;
 
                 if (arg_all || unit_name_to_type(*c) == UNIT_TARGET) {
-                       r = list_dependencies_one(bus, *c, level + 1, units, (branches << 1) | (c[1] == NULL ? 0 : 1));
+                       r = list_dependencies_one(bus, graph, *c, level + 1, units, (branches << 1) | (c[1] == NULL ? 0 : 1));
                        if (r < 0)
                                return r;
                 }
@@ -1832,6 +1990,7 @@ static int list_dependencies_one(
 }
 
 static int list_dependencies(int argc, char *argv[], void *userdata) {
+        _cleanup_(dependency_graph_freep) Hashmap *graph = NULL;
         _cleanup_strv_free_ char **units = NULL;
         _cleanup_free_ char *unit = NULL;
         const char *u;
@@ -1851,11 +2010,15 @@ static int list_dependencies(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return r;
 
+        r = list_dependencies_get_graph(bus, u, &graph);
+        if (r < 0)
+                return r;
+
         pager_open(arg_no_pager, false);
 
         puts(u);
 
-        return list_dependencies_one(bus, u, 0, &units, 0);
+        return list_dependencies_one(bus, graph, u, 0, &units, 0);
 }
 
 struct machine_info {
@@ -2706,6 +2869,150 @@ static int get_state_one_unit(sd_bus *bus, const char *name, UnitActiveState *ac
         return 0;
 }
 
+static void message_array_free(sd_bus_message **m, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                sd_bus_message_unref(m[i]);
+
+        free(m);
+}
+
+static int get_state_units(sd_bus *bus, char **names, UnitActiveState *ret_states) {
+        sd_bus_message **calls = NULL, **replies = NULL, **state_calls = NULL, **state_replies = NULL;
+        _cleanup_free_ size_t *state_index = NULL;
+        size_t i, n, n_state = 0;
+        const char *path;
+        int r;
+
+        assert(ret_states);
+
+        /* Like get_state_one_unit() for each unit, but pipelines the requests for all units, first the
+         * GetUnit() calls, then the property reads for the units that are loaded. */
+
+        n = strv_length(names);
+        if (n == 0)
+                return 0;
+
+        calls = new0(sd_bus_message*, n);
+        replies = new0(sd_bus_message*, n);
+        state_calls = new0(sd_bus_message*, n);
+        state_replies = new0(sd_bus_message*, n);
+        state_index = new(size_t, n);
+        if (!calls || !replies || !state_calls || !state_replies || !state_index) {
+                r = log_oom();
+                goto finish;
+        }
+
+        for (i = 0; i < n; i++) {
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                calls + i,
+                                "org.freedesktop.systemd1",
+                                "/org/freedesktop/systemd1",
+                                "org.freedesktop.systemd1.Manager",
+                                "GetUnit");
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+
+                r = sd_bus_message_append(calls[i], "s", names[i]);
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+        }
+
+        r = bus_call_all(bus, calls, n, 0, replies);
+        if (r < 0) {
+                log_error_errno(r, "Failed to retrieve units: %m");
+                goto finish;
+        }
+
+        for (i = 0; i < n; i++) {
+                const sd_bus_error *e;
+
+                e = sd_bus_message_get_error(replies[i]);
+                if (e) {
+                        if (!sd_bus_error_has_name(e, BUS_ERROR_NO_SUCH_UNIT)) {
+                                r = log_error_errno(sd_bus_error_get_errno(e), "Failed to retrieve unit: %s", bus_error_message(e, -EIO));
+                                goto finish;
+                        }
+
+                        /* Not loaded, hence "inactive", see get_state_one_unit() */
+                        ret_states[i] = UNIT_INACTIVE;
+                        continue;
+                }
+
+                r = sd_bus_message_read(replies[i], "o", &path);
+                if (r < 0) {
+                        bus_log_parse_error(r);
+                        goto finish;
+                }
+
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                state_calls + n_state,
+                                "org.freedesktop.systemd1",
+                                path,
+                                "org.freedesktop.DBus.Properties",
+                                "Get");
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+
+                r = sd_bus_message_append(state_calls[n_state], "ss", "org.freedesktop.systemd1.Unit", "ActiveState");
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+
+                state_index[n_state++] = i;
+        }
+
+        r = bus_call_all(bus, state_calls, n_state, 0, state_replies);
+        if (r < 0) {
+                log_error_errno(r, "Failed to retrieve unit states: %m");
+                goto finish;
+        }
+
+        for (i = 0; i < n_state; i++) {
+                const char *name = names[state_index[i]], *state;
+                const sd_bus_error *e;
+
+                e = sd_bus_message_get_error(state_replies[i]);
+                if (e) {
+                        r = log_error_errno(sd_bus_error_get_errno(e), "Failed to retrieve unit state: %s", bus_error_message(e, -EIO));
+                        goto finish;
+                }
+
+                r = sd_bus_message_read(state_replies[i], "v", "s", &state);
+                if (r < 0) {
+                        bus_log_parse_error(r);
+                        goto finish;
+                }
+
+                ret_states[state_index[i]] = unit_active_state_from_string(state);
+                if (ret_states[state_index[i]] == _UNIT_ACTIVE_STATE_INVALID) {
+                        log_error("Invalid unit state '%s' for: %s", state, name);
+                        r = -EINVAL;
+                        goto finish;
+                }
+        }
+
+        r = 0;
+
+finish:
+        message_array_free(calls, calls ? n : 0);
+        message_array_free(replies, replies ? n : 0);
+        message_array_free(state_calls, state_calls ? n : 0);
+        message_array_free(state_replies, state_replies ? n : 0);
+
+        return r;
+}
+
 static int check_triggering_units(
                 sd_bus *bus,
                 const char *name) {
@@ -3606,9 +3913,9 @@ static int start_system_special(int argc, char *argv[], void *userdata) {
 
 static int check_unit_generic(int code, const UnitActiveState good_states[], int nb_states, char **args) {
         _cleanup_strv_free_ char **names = NULL;
-        UnitActiveState active_state;
+        _cleanup_free_ UnitActiveState *active_states = NULL;
         sd_bus *bus;
-        char **name;
+        size_t j, n;
         int r, i;
         bool found = false;
 
@@ -3620,16 +3927,21 @@ static int check_unit_generic(int code, const UnitActiveState good_states[], int
         if (r < 0)
                 return log_error_errno(r, "Failed to expand names: %m");
 
-        STRV_FOREACH(name, names) {
-                r = get_state_one_unit(bus, *name, &active_state);
-                if (r < 0)
-                        return r;
+        n = strv_length(names);
+        active_states = new(UnitActiveState, n);
+        if (!active_states && n > 0)
+                return log_oom();
+
+        r = get_state_units(bus, names, active_states);
+        if (r < 0)
+                return r;
 
+        for (j = 0; j < n; j++) {
                 if (!arg_quiet)
-                        puts(unit_active_state_to_string(active_state));
+                        puts(unit_active_state_to_string(active_states[j]));
 
                 for (i = 0; i < nb_states; ++i)
-                        if (good_states[i] == active_state)
+                        if (good_states[i] == active_states[j])
                                 found = true;
         }
 
@@ -4986,11 +5298,12 @@ static int print_property(const char *name, sd_bus_message *m, const char *conte
         return 0;
 }
 
-static int show_one(
+static int show_one_reply(
                 const char *verb,
                 sd_bus *bus,
                 const char *path,
                 const char *unit,
+                sd_bus_message *reply,
                 bool show_properties,
                 bool *new_line,
                 bool *ellipsized) {
@@ -5001,7 +5314,6 @@ static int show_one(
                 {}
         };
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_set_free_ Set *found_properties = NULL;
         _cleanup_(unit_status_info_free) UnitStatusInfo info = {
@@ -5019,22 +5331,11 @@ static int show_one(
         int r;
 
         assert(path);
+        assert(reply);
         assert(new_line);
 
         log_debug("Showing one %s", path);
 
-        r = sd_bus_call_method(
-                        bus,
-                        "org.freedesktop.systemd1",
-                        path,
-                        "org.freedesktop.DBus.Properties",
-                        "GetAll",
-                        &error,
-                        &reply,
-                        "s", "");
-        if (r < 0)
-                return log_error_errno(r, "Failed to get properties: %s", bus_error_message(&error, r));
-
         if (unit) {
                 r = bus_message_map_all_properties(reply, property_map, &error, &info);
                 if (r < 0)
@@ -5132,6 +5433,126 @@ static int show_one(
         return r;
 }
 
+static int show_one(
+                const char *verb,
+                sd_bus *bus,
+                const char *path,
+                const char *unit,
+                bool show_properties,
+                bool *new_line,
+                bool *ellipsized) {
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        int r;
+
+        assert(path);
+
+        r = sd_bus_call_method(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        path,
+                        "org.freedesktop.DBus.Properties",
+                        "GetAll",
+                        &error,
+                        &reply,
+                        "s", "");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get properties: %s", bus_error_message(&error, r));
+
+        return show_one_reply(verb, bus, path, unit, reply, show_properties, new_line, ellipsized);
+}
+
+/* How many units we request the properties of before we show them */
+#define SHOW_UNITS_BATCH 256U
+
+static int show_units(
+                const char *verb,
+                sd_bus *bus,
+                char **names,
+                bool show_properties,
+                bool *new_line,
+                bool *ellipsized) {
+
+        sd_bus_message *calls[SHOW_UNITS_BATCH] = {}, *replies[SHOW_UNITS_BATCH] = {};
+        char *paths[SHOW_UNITS_BATCH] = {};
+        size_t i, n = 0;
+        int r = 0, ret = 0;
+
+        /* Like show_one() for each unit, but without waiting for each reply before sending the next
+         * request. This avoids a round trip to PID 1 per unit. */
+
+        while (!strv_isempty(names)) {
+
+                for (n = 0; n < SHOW_UNITS_BATCH && names[n]; n++) {
+                        paths[n] = unit_dbus_path_from_name(names[n]);
+                        if (!paths[n]) {
+                                r = log_oom();
+                                goto finish;
+                        }
+
+                        r = sd_bus_message_new_method_call(
+                                        bus,
+                                        calls + n,
+                                        "org.freedesktop.systemd1",
+                                        paths[n],
+                                        "org.freedesktop.DBus.Properties",
+                                        "GetAll");
+                        if (r < 0) {
+                                bus_log_create_error(r);
+                                goto finish;
+                        }
+
+                        r = sd_bus_message_append(calls[n], "s", "");
+                        if (r < 0) {
+                                bus_log_create_error(r);
+                                goto finish;
+                        }
+                }
+
+                r = bus_call_all(bus, calls, n, 0, replies);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to get properties: %m");
+                        goto finish;
+                }
+
+                for (i = 0; i < n; i++) {
+                        const sd_bus_error *e;
+
+                        e = sd_bus_message_get_error(replies[i]);
+                        if (e) {
+                                r = log_error_errno(sd_bus_error_get_errno(e), "Failed to get properties: %s", bus_error_message(e, -EIO));
+                                goto finish;
+                        }
+
+                        r = show_one_reply(verb, bus, paths[i], names[i], replies[i], show_properties, new_line, ellipsized);
+                        if (r < 0)
+                                goto finish;
+                        if (r > 0 && ret == 0)
+                                ret = r;
+                }
+
+                for (i = 0; i < n; i++) {
+                        paths[i] = mfree(paths[i]);
+                        calls[i] = sd_bus_message_unref(calls[i]);
+                        replies[i] = sd_bus_message_unref(replies[i]);
+                }
+
+                names += n;
+        }
+
+        r = ret;
+
+finish:
+        for (i = 0; i < SHOW_UNITS_BATCH; i++) {
+                free(paths[i]);
+                sd_bus_message_unref(calls[i]);
+                sd_bus_message_unref(replies[i]);
+        }
+
+        return r;
+}
+
 static int get_unit_dbus_path_by_pid(
                 sd_bus *bus,
                 uint32_t pid,
@@ -5175,9 +5596,9 @@ static int show_all(
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_free_ UnitInfo *unit_infos = NULL;
-        const UnitInfo *u;
-        unsigned c;
-        int r, ret = 0;
+        _cleanup_free_ char **names = NULL;
+        unsigned c, i;
+        int r;
 
         r = get_unit_list(bus, NULL, NULL, &unit_infos, 0, &reply);
         if (r < 0)
@@ -5189,21 +5610,15 @@ static int show_all(
 
         qsort_safe(unit_infos, c, sizeof(UnitInfo), compare_unit_info);
 
-        for (u = unit_infos; u < unit_infos + c; u++) {
-                _cleanup_free_ char *p = NULL;
-
-                p = unit_dbus_path_from_name(u->id);
-                if (!p)
-                        return log_oom();
+        names = new(char*, c + 1);
+        if (!names)
+                return log_oom();
 
-                r = show_one(verb, bus, p, u->id, show_properties, new_line, ellipsized);
-                if (r < 0)
-                        return r;
-                else if (r > 0 && ret == 0)
-                        ret = r;
-        }
+        for (i = 0; i < c; i++)
+                names[i] = (char*) unit_infos[i].id;
+        names[c] = NULL;
 
-        return ret;
+        return show_units(verb, bus, names, show_properties, new_line, ellipsized);
 }
 
 static int show_system_status(sd_bus *bus) {
@@ -5347,19 +5762,11 @@ static int show(int argc, char *argv[], void *userdata) {
                         if (r < 0)
                                 return log_error_errno(r, "Failed to expand names: %m");
 
-                        STRV_FOREACH(name, names) {
-                                _cleanup_free_ char *path;
-
-                                path = unit_dbus_path_from_name(*name);
-                                if (!path)
-                                        return log_oom();
-
-                                r = show_one(argv[0], bus, path, *name, show_properties, &new_line, &ellipsized);
-                                if (r < 0)
-                                        return r;
-                                if (r > 0 && ret == 0)
-                                        ret = r;
-                        }
+                        r = show_units(argv[0], bus, names, show_properties, &new_line, &ellipsized);
+                        if (r < 0)
+                                return r;
+                        if (r > 0 && ret == 0)
+                                ret = r;
                 }
         }
 
@@ -149,6 +149,10 @@ int sd_bus_set_allow_interactive_authorization(sd_bus *bus, int b);
 int sd_bus_get_allow_interactive_authorization(sd_bus *bus);
 int sd_bus_set_exit_on_disconnect(sd_bus *bus, int b);
 int sd_bus_get_exit_on_disconnect(sd_bus *bus);
+int sd_bus_set_cork(sd_bus *bus, int b);
+int sd_bus_get_cork(sd_bus *bus);
+int sd_bus_set_method_stats(sd_bus *bus, int b);
+int sd_bus_get_method_stats(sd_bus *bus);
 
 int sd_bus_start(sd_bus *ret);
 
@@ -72,6 +72,7 @@ enum {
         SD_JOURNAL_SYSTEM       = 1 << 2,
         SD_JOURNAL_CURRENT_USER = 1 << 3,
         SD_JOURNAL_OS_ROOT      = 1 << 4,
+        SD_JOURNAL_SEQUENTIAL   = 1 << 5,
 
         SD_JOURNAL_SYSTEM_ONLY = SD_JOURNAL_SYSTEM /* deprecated name */
 };
@@ -102,6 +103,7 @@ int sd_journal_get_monotonic_usec(sd_journal *j, uint64_t *ret, sd_id128_t *ret_
 
 int sd_journal_set_data_threshold(sd_journal *j, size_t sz);
 int sd_journal_get_data_threshold(sd_journal *j, size_t *sz);
+int sd_journal_set_data_fields(sd_journal *j, char **fields);
 
 int sd_journal_get_data(sd_journal *j, const char *field, const void **data, size_t *l);
 int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *l);
@@ -38,6 +38,7 @@ typedef struct sd_netlink_message sd_netlink_message;
 /* callback */
 
 typedef int (*sd_netlink_message_handler_t)(sd_netlink *nl, sd_netlink_message *m, void *userdata);
+typedef int (*sd_netlink_overflow_handler_t)(sd_netlink *nl, void *userdata);
 
 /* bus */
 int sd_netlink_new_from_netlink(sd_netlink **nl, int fd);
@@ -63,6 +64,7 @@ int sd_netlink_wait(sd_netlink *nl, uint64_t timeout);
 
 int sd_netlink_add_match(sd_netlink *nl, uint16_t match, sd_netlink_message_handler_t c, void *userdata);
 int sd_netlink_remove_match(sd_netlink *nl, uint16_t match, sd_netlink_message_handler_t c, void *userdata);
+int sd_netlink_set_overflow_handler(sd_netlink *nl, sd_netlink_overflow_handler_t c, void *userdata);
 
 int sd_netlink_attach_event(sd_netlink *nl, sd_event *e, int64_t priority);
 int sd_netlink_detach_event(sd_netlink *nl);
@@ -84,6 +84,29 @@ static uid_t search_uid = UID_INVALID;
 static UidRange *uid_range = NULL;
 static unsigned n_uid_range = 0;
 
+/* Roughly the size of a line in /etc/passwd and /etc/group, used to size the hash tables before loading the files,
+ * so that huge databases (think directory-synced users) aren't rehashed over and over again while loading. */
+#define DATABASE_LINE_SIZE_ESTIMATE 64U
+
+static int reserve_database(FILE *f, Hashmap *by_name, Hashmap *by_id) {
+        struct stat st;
+        unsigned n;
+        int r;
+
+        assert(f);
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        n = (unsigned) MIN((uint64_t) st.st_size / DATABASE_LINE_SIZE_ESTIMATE, (uint64_t) UINT_MAX / 2);
+
+        r = hashmap_reserve(by_name, n);
+        if (r < 0)
+                return r;
+
+        return hashmap_reserve(by_id, n);
+}
+
 static int load_user_database(void) {
         _cleanup_fclose_ FILE *f = NULL;
         const char *passwd_path;
@@ -103,6 +126,9 @@ static int load_user_database(void) {
         if (r < 0)
                 return r;
 
+        /* This is merely an optimization, hence ignore failures */
+        (void) reserve_database(f, database_user, database_uid);
+
         errno = 0;
         while ((pw = fgetpwent(f))) {
                 char *n;
@@ -155,6 +181,9 @@ static int load_group_database(void) {
         if (r < 0)
                 return r;
 
+        /* This is merely an optimization, hence ignore failures */
+        (void) reserve_database(f, database_group, database_gid);
+
         errno = 0;
         while ((gr = fgetgrent(f))) {
                 char *n;
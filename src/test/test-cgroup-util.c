@@ -24,6 +24,7 @@
 #include "fd-util.h"
 #include "format-util.h"
 #include "parse-util.h"
+#include "path-util.h"
 #include "proc-cmdline.h"
 #include "process-util.h"
 #include "stat-util.h"
@@ -371,6 +372,57 @@ static void test_is_wanted(void) {
         test_is_wanted_print(false);
 }
 
+static void test_kill_kernel_sigkill(void) {
+        _cleanup_free_ char *own = NULL, *path = NULL;
+        siginfo_t si;
+        pid_t pid;
+        int r;
+
+        log_info("-- %s --", __func__);
+
+        if (cg_all_unified() <= 0 || geteuid() != 0) {
+                log_info("Skipping %s, needs root on the unified hierarchy.", __func__);
+                return;
+        }
+
+        assert_se(cg_pid_get_path(SYSTEMD_CGROUP_CONTROLLER, 0, &own) >= 0);
+        path = strjoin(own, "/test-cgroup-kill");
+        assert_se(path);
+        path_kill_slashes(path);
+
+        assert_se(cg_create(SYSTEMD_CGROUP_CONTROLLER, path) >= 0);
+
+        /* Nothing to kill */
+        r = cg_kill_kernel_sigkill(SYSTEMD_CGROUP_CONTROLLER, path, 0);
+        if (r == -EOPNOTSUPP) {
+                log_info("Skipping %s, cgroup.kill is not supported.", __func__);
+                assert_se(cg_rmdir(SYSTEMD_CGROUP_CONTROLLER, path) >= 0);
+                return;
+        }
+        assert_se(r == 0);
+
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                pause();
+                _exit(EXIT_FAILURE);
+        }
+
+        assert_se(cg_attach(SYSTEMD_CGROUP_CONTROLLER, path, pid) >= 0);
+
+        /* We are not part of that cgroup, so sparing ourselves doesn't get in the way */
+        assert_se(cg_kill_kernel_sigkill(SYSTEMD_CGROUP_CONTROLLER, path, CGROUP_IGNORE_SELF) > 0);
+
+        assert_se(wait_for_terminate(pid, &si) >= 0);
+        assert_se(si.si_code == CLD_KILLED);
+        assert_se(si.si_status == SIGKILL);
+
+        /* Once the kernel noticed that the cgroup went empty, cg_kill_recursive() has nothing left to do */
+        assert_se(cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, path, SIGKILL, 0, NULL, NULL, NULL) >= 0);
+
+        assert_se(cg_rmdir(SYSTEMD_CGROUP_CONTROLLER, path) >= 0);
+}
+
 int main(void) {
         log_set_max_level(LOG_DEBUG);
         log_parse_environment();
@@ -395,6 +447,7 @@ int main(void) {
         test_is_wanted_print(true);
         test_is_wanted_print(false); /* run twice to test caching */
         test_is_wanted();
+        test_kill_kernel_sigkill();
 
         return 0;
 }
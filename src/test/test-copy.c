@@ -244,6 +244,53 @@ static void test_copy_bytes_regular_file(const char *src, bool try_reflink, uint
         unlink(fn3);
 }
 
+static void test_copy_holes(void) {
+        char fn[] = "/tmp/test-copy-hole-fd-XXXXXX";
+        char fn_copy[] = "/tmp/test-copy-hole-fd-XXXXXX";
+        _cleanup_close_ int fd = -1, fd_copy = -1;
+        char buf[4096], buf_copy[sizeof(buf)];
+        struct stat st, st_copy;
+        off_t blksz;
+
+        log_info("%s", __func__);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        fd_copy = mkostemp_safe(fn_copy);
+        assert_se(fd_copy >= 0);
+
+        assert_se(fstat(fd, &st) >= 0);
+        blksz = MAX(st.st_blksize, (blksize_t) sizeof(buf));
+
+        /* A hole, a block of data, another hole and a block of data, followed by a trailing hole */
+        memset(buf, 'x', sizeof(buf));
+        assert_se(pwrite(fd, buf, sizeof(buf), 2 * blksz) == sizeof(buf));
+        assert_se(pwrite(fd, buf, sizeof(buf), 8 * blksz) == sizeof(buf));
+        assert_se(ftruncate(fd, 16 * blksz) >= 0);
+
+        assert_se(copy_bytes(fd, fd_copy, (uint64_t) -1, COPY_HOLES) == 0);
+
+        assert_se(fstat(fd, &st) >= 0);
+        assert_se(fstat(fd_copy, &st_copy) >= 0);
+        assert_se(st_copy.st_size == st.st_size);
+
+        /* On file systems that don't support holes the numbers of blocks are still equal */
+        assert_se(st_copy.st_blocks <= st.st_blocks);
+
+        assert_se(pread(fd_copy, buf_copy, sizeof(buf_copy), 2 * blksz) == sizeof(buf_copy));
+        assert_se(memcmp(buf, buf_copy, sizeof(buf)) == 0);
+        assert_se(pread(fd_copy, buf_copy, sizeof(buf_copy), 8 * blksz) == sizeof(buf_copy));
+        assert_se(memcmp(buf, buf_copy, sizeof(buf)) == 0);
+
+        assert_se(pread(fd_copy, buf_copy, sizeof(buf_copy), 12 * blksz) == sizeof(buf_copy));
+        memzero(buf, sizeof(buf));
+        assert_se(memcmp(buf, buf_copy, sizeof(buf)) == 0);
+
+        unlink(fn);
+        unlink(fn_copy);
+}
+
 int main(int argc, char *argv[]) {
         test_copy_file();
         test_copy_file_fd();
@@ -255,6 +302,7 @@ int main(int argc, char *argv[]) {
         test_copy_bytes_regular_file(argv[0], true, 1000);
         test_copy_bytes_regular_file(argv[0], false, 32000); /* larger than copy buffer size */
         test_copy_bytes_regular_file(argv[0], true, 32000);
+        test_copy_holes();
 
         return 0;
 }
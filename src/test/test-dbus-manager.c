@@ -0,0 +1,181 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "bus-util.h"
+#include "dbus-manager.h"
+#include "manager.h"
+#include "rm-rf.h"
+#include "strv.h"
+#include "test-helper.h"
+#include "tests.h"
+
+typedef struct Call {
+        sd_bus *client;
+        uint64_t since;
+
+        char **units;
+        uint64_t generation;
+
+        volatile bool done;
+} Call;
+
+static void *call_thread(void *userdata) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        Call *c = userdata;
+        const char *id;
+
+        assert_se(sd_bus_call_method(
+                                  c->client,
+                                  "org.freedesktop.systemd1",
+                                  "/org/freedesktop/systemd1",
+                                  "org.freedesktop.systemd1.Manager",
+                                  "ListUnitsChangedSince",
+                                  &error,
+                                  &reply,
+                                  "tasas", c->since, 0, 0) >= 0);
+
+        assert_se(sd_bus_message_enter_container(reply, 'a', "(ssssssouso)") >= 0);
+        while (sd_bus_message_read(reply, "(ssssssouso)", &id, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL) > 0)
+                assert_se(strv_extend(&c->units, id) >= 0);
+        assert_se(sd_bus_message_exit_container(reply) >= 0);
+
+        assert_se(sd_bus_message_read(reply, "t", &c->generation) >= 0);
+
+        c->done = true;
+        return NULL;
+}
+
+static void list_units_changed_since(sd_bus *server, sd_bus *client, uint64_t since, char ***units, uint64_t *generation) {
+        Call c = {
+                .client = client,
+                .since = since,
+        };
+        pthread_t t;
+
+        /* The manager isn't thread-safe, hence dispatch the call here while the client waits for the reply
+         * in a thread of its own */
+        assert_se(pthread_create(&t, NULL, call_thread, &c) == 0);
+
+        while (!c.done) {
+                int r;
+
+                r = sd_bus_process(server, NULL);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(server, 100 * USEC_PER_MSEC) >= 0);
+        }
+
+        assert_se(pthread_join(t, NULL) == 0);
+
+        strv_sort(c.units);
+        strv_free(*units);
+        *units = c.units;
+        *generation = c.generation;
+}
+
+static void test_list_units_changed_since(Manager *m) {
+        _cleanup_(sd_bus_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_strv_free_ char **units = NULL;
+        uint64_t g1, g2, g3;
+        sd_id128_t id;
+        int fds[2];
+        Unit *a, *b;
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, fds) >= 0);
+
+        assert_se(sd_id128_randomize(&id) >= 0);
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, fds[0], fds[0]) >= 0);
+        assert_se(sd_bus_set_server(server, 1, id) >= 0);
+        assert_se(sd_bus_add_object_vtable(server, NULL, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", bus_manager_vtable, m) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, fds[1], fds[1]) >= 0);
+        assert_se(sd_bus_start(client) >= 0);
+
+        assert_se(manager_load_unit(m, "a.service", NULL, NULL, &a) >= 0);
+        assert_se(manager_load_unit(m, "b.service", NULL, NULL, &b) >= 0);
+
+        /* The first call gets everything */
+        list_units_changed_since(server, client, 0, &units, &g1);
+        assert_se(strv_contains(units, "a.service"));
+        assert_se(strv_contains(units, "b.service"));
+        assert_se(g1 == m->unit_change_generation);
+
+        /* Nothing changed since */
+        list_units_changed_since(server, client, g1, &units, &g2);
+        assert_se(strv_isempty(units));
+        assert_se(g2 == g1);
+
+        /* Only what changed since is returned, and the generation moves on */
+        unit_add_to_dbus_queue(b);
+        list_units_changed_since(server, client, g1, &units, &g2);
+        assert_se(strv_equal(units, STRV_MAKE("b.service")));
+        assert_se(g2 > g1);
+
+        unit_add_to_dbus_queue(a);
+        unit_add_to_dbus_queue(b);
+        list_units_changed_since(server, client, g1, &units, &g3);
+        assert_se(strv_equal(units, STRV_MAKE("a.service", "b.service")));
+        assert_se(g3 > g2);
+
+        list_units_changed_since(server, client, g3, &units, &g3);
+        assert_se(strv_isempty(units));
+
+        /* Newly loaded units count as changed */
+        assert_se(manager_load_unit(m, "hello.service", NULL, NULL, NULL) >= 0);
+        list_units_changed_since(server, client, g3, &units, &g1);
+        assert_se(strv_contains(units, "hello.service"));
+        assert_se(!strv_contains(units, "a.service"));
+        assert_se(!strv_contains(units, "b.service"));
+        assert_se(g1 > g3);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
+        Manager *m = NULL;
+        int r;
+
+        log_set_max_level(LOG_DEBUG);
+        log_parse_environment();
+        log_open();
+
+        enter_cgroup_subroot();
+
+        assert_se(set_unit_path(get_testdata_dir("")) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (MANAGER_SKIP_TEST(r)) {
+                log_notice_errno(r, "Skipping test: manager_new: %m");
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        test_list_units_changed_since(m);
+
+        manager_free(m);
+
+        return 0;
+}
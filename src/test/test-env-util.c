@@ -114,6 +114,75 @@ static void test_strv_env_merge(void) {
         assert_se(strv_length(r) == 5);
 }
 
+static void test_strv_env_merge_many(void) {
+        _cleanup_strv_free_ char **a = NULL, **b = NULL, **r = NULL;
+        unsigned i;
+
+        /* Same as above, but with enough entries to go through the hash table */
+
+        for (i = 0; i < 100; i++)
+                assert_se(strv_extendf(&a, "PAD%u=%u", i, i) >= 0);
+
+        assert_se(strv_extend_strv(&a, STRV_MAKE("FOO=BAR", "WALDO=WALDO", "WALDO=", "PIEP", "SCHLUMPF=SMURF"), false) >= 0);
+        assert_se(strv_extend_strv(&b, STRV_MAKE("FOO=KKK", "FOO=", "PIEP=", "SCHLUMPF=SMURFF", "NANANANA=YES", "PAD7=seven"), false) >= 0);
+
+        r = strv_env_merge(2, a, b);
+        assert_se(r);
+        assert_se(streq(r[7], "PAD7=seven"));
+        assert_se(streq(r[99], "PAD99=99"));
+        assert_se(streq(r[100], "FOO="));
+        assert_se(streq(r[101], "WALDO="));
+        assert_se(streq(r[102], "PIEP"));
+        assert_se(streq(r[103], "SCHLUMPF=SMURFF"));
+        assert_se(streq(r[104], "PIEP="));
+        assert_se(streq(r[105], "NANANANA=YES"));
+        assert_se(strv_length(r) == 106);
+
+        assert_se(strv_env_clean(r) == r);
+        assert_se(streq(r[7], "PAD7=seven"));
+        assert_se(streq(r[100], "FOO="));
+        assert_se(streq(r[101], "WALDO="));
+        assert_se(streq(r[102], "SCHLUMPF=SMURFF"));
+        assert_se(streq(r[103], "PIEP="));
+        assert_se(streq(r[104], "NANANANA=YES"));
+        assert_se(strv_length(r) == 105);
+
+        /* Duplicates within the same list are dropped by strv_env_clean(), keeping the last one */
+        assert_se(strv_extend_strv(&a, STRV_MAKE("PAD3=again", "WALDO=last"), false) >= 0);
+        assert_se(strv_env_clean(a) == a);
+        assert_se(streq(a[2], "PAD2=2"));
+        assert_se(streq(a[3], "PAD4=4"));
+        assert_se(streq(strv_env_get(a, "PAD3"), "again"));
+        assert_se(streq(strv_env_get(a, "WALDO"), "last"));
+        assert_se(strv_length(a) == 103);
+}
+
+static void test_strv_env_merge_many_unset_one(unsigned n_pad) {
+        _cleanup_strv_free_ char **a = NULL, **b = NULL, **c = NULL, **r = NULL;
+        unsigned i;
+
+        for (i = 0; i < n_pad; i++)
+                assert_se(strv_extendf(&a, "PAD%u=%u", i, i) >= 0);
+
+        /* A name without "=" replaces the existing assignment in place, a later assignment of the same name
+         * then gets a new entry: the same with and without the hash table */
+        assert_se(strv_extend_strv(&a, STRV_MAKE("KEY=1", "OTHER=1"), false) >= 0);
+        assert_se(strv_extend_strv(&b, STRV_MAKE("KEY", "OTHER=2"), false) >= 0);
+        assert_se(strv_extend_strv(&c, STRV_MAKE("KEY=2", "KEY=3", "OTHER"), false) >= 0);
+
+        r = strv_env_merge(3, a, b, c);
+        assert_se(r);
+        assert_se(strv_length(r) == n_pad + 3);
+        assert_se(streq(r[n_pad], "KEY"));
+        assert_se(streq(r[n_pad + 1], "OTHER"));
+        assert_se(streq(r[n_pad + 2], "KEY=3"));
+}
+
+static void test_strv_env_merge_many_unset(void) {
+        test_strv_env_merge_many_unset_one(0);
+        test_strv_env_merge_many_unset_one(100);
+}
+
 static void test_env_strv_get_n(void) {
         const char *_env[] = {
                 "FOO=NO NO NO",
@@ -373,6 +442,8 @@ int main(int argc, char *argv[]) {
         test_strv_env_unset();
         test_strv_env_set();
         test_strv_env_merge();
+        test_strv_env_merge_many();
+        test_strv_env_merge_many_unset();
         test_env_strv_get_n();
         test_replace_env(false);
         test_replace_env(true);
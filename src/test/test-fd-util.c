@@ -18,12 +18,14 @@
 ***/
 
 #include <fcntl.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "macro.h"
+#include "process-util.h"
 
 static void test_close_many(void) {
         int fds[3];
@@ -103,9 +105,43 @@ static void test_open_serialization_fd(void) {
         write(fd, "test\n", 5);
 }
 
+static void test_close_all_fds(void) {
+        pid_t pid;
+
+        pid = fork();
+        assert_se(pid >= 0);
+
+        if (pid == 0) {
+                int fds[100], keep[4];
+                unsigned i;
+
+                for (i = 0; i < ELEMENTSOF(fds); i++)
+                        assert_se((fds[i] = open("/dev/null", O_RDONLY|O_CLOEXEC)) >= 0);
+
+                /* Deliberately unsorted, and with a duplicate */
+                keep[0] = fds[50];
+                keep[1] = fds[7];
+                keep[2] = fds[99];
+                keep[3] = fds[7];
+
+                assert_se(close_all_fds(keep, ELEMENTSOF(keep)) >= 0);
+
+                for (i = 0; i < ELEMENTSOF(fds); i++)
+                        assert_se((fcntl(fds[i], F_GETFD) >= 0) == IN_SET(i, 7, 50, 99));
+
+                assert_se(close_all_fds(NULL, 0) >= 0);
+                assert_se(fcntl(fds[50], F_GETFD) < 0);
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(wait_for_terminate_and_warn("test-close-all-fds", pid, true) == EXIT_SUCCESS);
+}
+
 int main(int argc, char *argv[]) {
         test_close_many();
         test_close_nointr();
+        test_close_all_fds();
         test_same_fd();
         test_open_serialization_fd();
 
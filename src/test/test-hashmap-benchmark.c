@@ -0,0 +1,322 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "alloc-util.h"
+#include "hashmap.h"
+#include "log.h"
+#include "set.h"
+#include "strv.h"
+#include "tests.h"
+#include "util.h"
+
+/* Measures puts, lookups of present and missing keys and removals on the hashmap types, with keys
+ * resembling the lookups PID 1 does a lot: unit names, and PIDs stored as pointers. */
+
+static char **arg_names = NULL, **arg_missing = NULL;
+
+static char **make_names(const char *prefix, unsigned n) {
+        char **l;
+        unsigned i;
+
+        l = new0(char*, n + 1);
+        assert_se(l);
+
+        for (i = 0; i < n; i++)
+                assert_se(asprintf(&l[i], "%s-%u.service", prefix, i) >= 0);
+
+        return l;
+}
+
+static Hashmap *hashmap_fill(unsigned n) {
+        Hashmap *h;
+        unsigned i;
+
+        assert_se(h = hashmap_new(&string_hash_ops));
+
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_put(h, arg_names[i], arg_names[i]) == 1);
+
+        return h;
+}
+
+static nsec_t bench_hashmap_put(unsigned n, void *userdata) {
+        Hashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        assert_se(h = hashmap_new(&string_hash_ops));
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_put(h, arg_names[i], arg_names[i]) == 1);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_hashmap_get(unsigned n, void *userdata) {
+        Hashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_get(h, arg_names[i]) == arg_names[i]);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_hashmap_miss(unsigned n, void *userdata) {
+        Hashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(!hashmap_get(h, arg_missing[i]));
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_hashmap_remove(unsigned n, void *userdata) {
+        Hashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_remove(h, arg_names[i]) == arg_names[i]);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        hashmap_free(h);
+        return t;
+}
+
+static OrderedHashmap *ordered_hashmap_fill(unsigned n) {
+        OrderedHashmap *h;
+        unsigned i;
+
+        assert_se(h = ordered_hashmap_new(&string_hash_ops));
+
+        for (i = 0; i < n; i++)
+                assert_se(ordered_hashmap_put(h, arg_names[i], arg_names[i]) == 1);
+
+        return h;
+}
+
+static nsec_t bench_ordered_hashmap_put(unsigned n, void *userdata) {
+        OrderedHashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        assert_se(h = ordered_hashmap_new(&string_hash_ops));
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(ordered_hashmap_put(h, arg_names[i], arg_names[i]) == 1);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        ordered_hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_ordered_hashmap_get(unsigned n, void *userdata) {
+        OrderedHashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = ordered_hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(ordered_hashmap_get(h, arg_names[i]) == arg_names[i]);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        ordered_hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_ordered_hashmap_miss(unsigned n, void *userdata) {
+        OrderedHashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = ordered_hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(!ordered_hashmap_get(h, arg_missing[i]));
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        ordered_hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_ordered_hashmap_iterate(unsigned n, void *userdata) {
+        OrderedHashmap *h;
+        Iterator it;
+        unsigned i = 0;
+        nsec_t t;
+        char *p;
+
+        h = ordered_hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        ORDERED_HASHMAP_FOREACH(p, h, it)
+                assert_se(p == arg_names[i++]);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        ordered_hashmap_free(h);
+        return t;
+}
+
+static nsec_t bench_ordered_hashmap_remove(unsigned n, void *userdata) {
+        OrderedHashmap *h;
+        unsigned i;
+        nsec_t t;
+
+        h = ordered_hashmap_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(ordered_hashmap_remove(h, arg_names[i]) == arg_names[i]);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        ordered_hashmap_free(h);
+        return t;
+}
+
+static Set *set_fill(unsigned n) {
+        Set *s;
+        unsigned i;
+
+        assert_se(s = set_new(NULL));
+
+        for (i = 1; i <= n; i++)
+                assert_se(set_put(s, UINT_TO_PTR(i)) == 1);
+
+        return s;
+}
+
+static nsec_t bench_set_put(unsigned n, void *userdata) {
+        Set *s;
+        unsigned i;
+        nsec_t t;
+
+        assert_se(s = set_new(NULL));
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 1; i <= n; i++)
+                assert_se(set_put(s, UINT_TO_PTR(i)) == 1);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        set_free(s);
+        return t;
+}
+
+static nsec_t bench_set_get(unsigned n, void *userdata) {
+        Set *s;
+        unsigned i;
+        nsec_t t;
+
+        s = set_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 1; i <= n; i++)
+                assert_se(set_contains(s, UINT_TO_PTR(i)));
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        set_free(s);
+        return t;
+}
+
+static nsec_t bench_set_miss(unsigned n, void *userdata) {
+        Set *s;
+        unsigned i;
+        nsec_t t;
+
+        s = set_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = n + 1; i <= 2 * n; i++)
+                assert_se(!set_contains(s, UINT_TO_PTR(i)));
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        set_free(s);
+        return t;
+}
+
+static nsec_t bench_set_remove(unsigned n, void *userdata) {
+        Set *s;
+        unsigned i;
+        nsec_t t;
+
+        s = set_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 1; i <= n; i++)
+                assert_se(set_remove(s, UINT_TO_PTR(i)) == UINT_TO_PTR(i));
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        set_free(s);
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        unsigned n;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        n = benchmark_get_iterations(argc, argv, 20000, 1000000);
+
+        arg_names = make_names("unit", n);
+        arg_missing = make_names("missing", n);
+
+        benchmark_run("hashmap", "Hashmap/put", n, bench_hashmap_put, NULL);
+        benchmark_run("hashmap", "Hashmap/get", n, bench_hashmap_get, NULL);
+        benchmark_run("hashmap", "Hashmap/miss", n, bench_hashmap_miss, NULL);
+        benchmark_run("hashmap", "Hashmap/remove", n, bench_hashmap_remove, NULL);
+
+        benchmark_run("hashmap", "OrderedHashmap/put", n, bench_ordered_hashmap_put, NULL);
+        benchmark_run("hashmap", "OrderedHashmap/get", n, bench_ordered_hashmap_get, NULL);
+        benchmark_run("hashmap", "OrderedHashmap/miss", n, bench_ordered_hashmap_miss, NULL);
+        benchmark_run("hashmap", "OrderedHashmap/iterate", n, bench_ordered_hashmap_iterate, NULL);
+        benchmark_run("hashmap", "OrderedHashmap/remove", n, bench_ordered_hashmap_remove, NULL);
+
+        benchmark_run("hashmap", "Set/put", n, bench_set_put, NULL);
+        benchmark_run("hashmap", "Set/get", n, bench_set_get, NULL);
+        benchmark_run("hashmap", "Set/miss", n, bench_set_miss, NULL);
+        benchmark_run("hashmap", "Set/remove", n, bench_set_remove, NULL);
+
+        arg_names = strv_free(arg_names);
+        arg_missing = strv_free(arg_missing);
+
+        return 0;
+}
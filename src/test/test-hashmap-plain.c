@@ -902,6 +902,26 @@ static void test_hashmap_reserve(void) {
         assert_se(hashmap_reserve(m, UINT_MAX - 1) == -ENOMEM);
 }
 
+static void test_hashmap_memory_usage(void) {
+        _cleanup_hashmap_free_ Hashmap *m = NULL;
+        size_t empty;
+
+        log_info("%s", __func__);
+
+        assert_se(hashmap_memory_usage(NULL) == 0);
+
+        m = hashmap_new(&string_hash_ops);
+        empty = hashmap_memory_usage(m);
+        assert_se(empty > 0);
+
+        /* A single entry fits into the head */
+        assert_se(hashmap_put(m, "key 1", (void*) "val 1") == 1);
+        assert_se(hashmap_memory_usage(m) == empty);
+
+        assert_se(hashmap_reserve(m, 1000) == 0);
+        assert_se(hashmap_memory_usage(m) > empty + 1000 * 2 * sizeof(void*));
+}
+
 void test_hashmap_funcs(void) {
         int r;
 
@@ -939,4 +959,5 @@ void test_hashmap_funcs(void) {
         test_hashmap_steal_first();
         test_hashmap_clear_free_free();
         test_hashmap_reserve();
+        test_hashmap_memory_usage();
 }
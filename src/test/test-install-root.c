@@ -766,6 +766,30 @@ static void test_static_instance(const char *root) {
         assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "static-instance@foo.service", &state) >= 0 && state == UNIT_FILE_STATIC);
 }
 
+static void test_list_states(const char *root) {
+        UnitFileList *fl;
+        UnitFileState state;
+        Hashmap *h;
+        Iterator j;
+
+        /* unit_file_get_list() indexes the symlinks once, which must give the same result as the
+         * individual lookups */
+
+        assert_se(h = hashmap_new(&string_hash_ops));
+        assert_se(unit_file_get_list(UNIT_FILE_SYSTEM, root, h, NULL, NULL) >= 0);
+        assert_se(!hashmap_isempty(h));
+
+        HASHMAP_FOREACH(fl, h, j) {
+                if (unit_file_get_state(UNIT_FILE_SYSTEM, root, basename(fl->path), &state) < 0)
+                        state = UNIT_FILE_BAD;
+
+                log_debug("%s: %s", fl->path, unit_file_state_to_string(fl->state));
+                assert_se(fl->state == state);
+        }
+
+        unit_file_list_free(h);
+}
+
 int main(int argc, char *argv[]) {
         char root[] = "/tmp/rootXXXXXX";
         const char *p;
@@ -797,6 +821,7 @@ int main(int argc, char *argv[]) {
         test_preset_order(root);
         test_revert(root);
         test_static_instance(root);
+        test_list_states(root);
 
         assert_se(rm_rf(root, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
 
@@ -17,11 +17,24 @@
   along with systemd; If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
 #include <stddef.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
+#include "fd-util.h"
 #include "format-util.h"
+#include "io-util.h"
 #include "log.h"
+#include "mkdir.h"
+#include "process-util.h"
+#include "socket-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
 #include "util.h"
 
 assert_cc(LOG_REALM_REMOVE_LEVEL(LOG_REALM_PLUS_LEVEL(LOG_REALM_SYSTEMD, LOG_FTP | LOG_DEBUG))
@@ -33,6 +46,109 @@ assert_cc((LOG_REALM_PLUS_LEVEL(LOG_REALM_SYSTEMD, LOG_LOCAL3 | LOG_DEBUG) & LOG
 assert_cc((LOG_REALM_PLUS_LEVEL(LOG_REALM_UDEV, LOG_USER | LOG_INFO) & LOG_PRIMASK)
           == LOG_INFO);
 
+static void test_async_order_child(void) {
+        static const union sockaddr_union sa = {
+                .un.sun_family = AF_UNIX,
+                .un.sun_path = "/run/systemd/journal/socket",
+        };
+        _cleanup_close_pair_ int pipe_fds[2] = { -1, -1 };
+        _cleanup_close_ int fd = -1, probe = -1;
+        char payload[200];
+        unsigned n, i;
+        pid_t pid;
+
+        /* Put our own journal socket in place, so that we can see which messages arrive in which order */
+        if (unshare(CLONE_NEWNS) < 0) {
+                log_notice_errno(errno, "Can't create mount namespace, skipping asynchronous logging test: %m");
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(mount(NULL, "/", NULL, MS_SLAVE|MS_REC, NULL) >= 0);
+        assert_se(mount("tmpfs", "/run", "tmpfs", 0, "mode=0755") >= 0);
+        assert_se(mkdir_p("/run/systemd/journal", 0755) >= 0);
+
+        fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        assert_se(fd >= 0);
+        assert_se(bind(fd, &sa.sa, SOCKADDR_UN_LEN(sa.un)) >= 0);
+
+        /* Find out how many datagrams about the size of ours the socket takes before the sender has to
+         * wait. That depends on the buffer sizes as well as on max_dgram_qlen. Then send enough on top of
+         * that for the in-process queue to be used, but well below the 256 messages it holds at most, see
+         * LOG_QUEUE_MAX in log.c. */
+        probe = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        assert_se(probe >= 0);
+        assert_se(connect(probe, &sa.sa, SOCKADDR_UN_LEN(sa.un)) >= 0);
+
+        memset(payload, 'x', sizeof(payload));
+        for (n = 0; send(probe, payload, sizeof(payload), MSG_DONTWAIT) >= 0; n++)
+                ;
+        assert_se(errno == EAGAIN);
+        probe = safe_close(probe);
+
+        while (recv(fd, payload, sizeof(payload), MSG_DONTWAIT) >= 0)
+                ;
+        assert_se(errno == EAGAIN);
+
+        n += 100;
+
+        assert_se(pipe2(pipe_fds, O_CLOEXEC) >= 0);
+
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                char buf[2 * LINE_MAX], expected[sizeof("MESSAGE=async \n") + DECIMAL_STR_MAX(unsigned)];
+                char c;
+
+                /* Only start reading once everything was logged, so that the socket fills up */
+                assert_se(read(pipe_fds[0], &c, 1) == 1);
+
+                for (i = 0; i < n; i++) {
+                        ssize_t l;
+
+                        assert_se(fd_wait_for_event(fd, POLLIN, 10 * USEC_PER_SEC) > 0);
+
+                        l = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+                        assert_se(l > 0);
+                        buf[l] = 0;
+
+                        xsprintf(expected, "MESSAGE=async %u\n", i);
+                        assert_se(strstr(buf, expected));
+                }
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        log_set_target(LOG_TARGET_JOURNAL);
+        log_open();
+        log_set_async(true);
+
+        for (i = 0; i < n; i++)
+                log_info("async %u", i);
+
+        /* Let the reader drain the socket. log_close() has to send out the rest of the queue, in order. */
+        assert_se(write(pipe_fds[1], "x", 1) == 1);
+        log_close();
+        log_set_async(false);
+
+        log_set_target(LOG_TARGET_CONSOLE);
+        log_open();
+
+        assert_se(wait_for_terminate_and_warn("reader", pid, true) == EXIT_SUCCESS);
+
+        _exit(EXIT_SUCCESS);
+}
+
+static void test_async_order(void) {
+        pid_t pid;
+
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0)
+                test_async_order_child();
+
+        assert_se(wait_for_terminate_and_warn("test-async-order", pid, true) == EXIT_SUCCESS);
+}
+
 int main(int argc, char* argv[]) {
 
         log_set_target(LOG_TARGET_CONSOLE);
@@ -58,5 +174,18 @@ int main(int argc, char* argv[]) {
                    "SUFFIX=GOT IT",
                    NULL);
 
+        log_set_async(true);
+
+        log_struct(LOG_INFO,
+                   "MESSAGE=Foobar PID="PID_FMT" async", getpid_cached(),
+                   "SERVICE=foobar",
+                   NULL);
+        log_info("Foobar PID="PID_FMT" async", getpid_cached());
+
+        (void) log_flush_async();
+        log_set_async(false);
+
+        test_async_order();
+
         return 0;
 }
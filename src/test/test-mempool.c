@@ -0,0 +1,86 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "macro.h"
+#include "mempool.h"
+
+struct tile {
+        unsigned i;
+        char payload[60];
+};
+
+DEFINE_MEMPOOL(test_pool, struct tile, 8);
+
+#define N_TILES 2000U
+
+static void test_mempool_trim(void) {
+        struct tile *t[N_TILES];
+        unsigned i, n_tiles, n_tiles_after;
+        size_t sz;
+
+        for (i = 0; i < N_TILES; i++) {
+                assert_se(t[i] = mempool_alloc0_tile(&test_pool));
+                t[i]->i = i;
+        }
+        assert_se(test_pool.n_used == N_TILES);
+
+        sz = mempool_allocated(&test_pool, &n_tiles);
+        assert_se(n_tiles >= N_TILES);
+        assert_se(sz >= N_TILES * sizeof(struct tile));
+
+        /* Nothing can be released while every pool has some tile in use */
+        for (i = 0; i < N_TILES; i += 2)
+                mempool_free_tile(&test_pool, t[i]);
+        assert_se(test_pool.n_freed == N_TILES / 2);
+        mempool_trim(&test_pool);
+        assert_se(test_pool.n_freed == 0);
+        assert_se(mempool_allocated(&test_pool, &n_tiles_after) == sz);
+        assert_se(n_tiles_after == n_tiles);
+
+        for (i = 1; i < N_TILES; i += 2)
+                assert_se(t[i]->i == i);
+
+        /* Keep only the most recently allocated half, the older pools can be released then */
+        for (i = 1; i < N_TILES / 2; i += 2)
+                mempool_free_tile(&test_pool, t[i]);
+        mempool_trim(&test_pool);
+        assert_se(mempool_allocated(&test_pool, &n_tiles_after) < sz);
+        assert_se(n_tiles_after < n_tiles);
+        assert_se(test_pool.n_used == N_TILES / 4);
+
+        for (i = N_TILES / 2 + 1; i < N_TILES; i += 2)
+                assert_se(t[i]->i == i);
+
+        /* The free list must only point into pools still around */
+        for (i = 0; i < N_TILES / 2; i++)
+                assert_se(t[i] = mempool_alloc_tile(&test_pool));
+        for (i = 0; i < N_TILES / 2; i++)
+                mempool_free_tile(&test_pool, t[i]);
+
+        for (i = N_TILES / 2 + 1; i < N_TILES; i += 2)
+                mempool_free_tile(&test_pool, t[i]);
+        assert_se(test_pool.n_used == 0);
+
+        mempool_trim(&test_pool);
+        assert_se(mempool_allocated(&test_pool, NULL) == 0);
+}
+
+int main(int argc, const char *argv[]) {
+        test_mempool_trim();
+
+        return 0;
+}
@@ -0,0 +1,167 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "alloc-util.h"
+#include "log.h"
+#include "prioq.h"
+#include "tests.h"
+#include "util.h"
+
+/* Measures the priority queue operations sd-event does for each of its time event sources: queueing, popping the
+ * earliest entry, moving an entry after its deadline changed, and removing it again. */
+
+typedef struct Item {
+        uint64_t prio;
+        unsigned idx;
+} Item;
+
+static Item *arg_items = NULL;
+
+static int item_compare(const void *a, const void *b) {
+        const Item *x = a, *y = b;
+
+        if (x->prio < y->prio)
+                return -1;
+        if (x->prio > y->prio)
+                return 1;
+        return 0;
+}
+
+static void items_reset(unsigned n) {
+        unsigned i;
+
+        /* Some fixed permutation, so that the queue needs to do actual work */
+        for (i = 0; i < n; i++)
+                arg_items[i] = (Item) {
+                        .prio = (i * UINT64_C(2654435761)) % n,
+                        .idx = PRIOQ_IDX_NULL,
+                };
+}
+
+static Prioq *prioq_fill(unsigned n) {
+        Prioq *q;
+        unsigned i;
+
+        items_reset(n);
+
+        assert_se(q = prioq_new(item_compare));
+
+        for (i = 0; i < n; i++)
+                assert_se(prioq_put(q, arg_items + i, &arg_items[i].idx) >= 0);
+
+        return q;
+}
+
+static nsec_t bench_put(unsigned n, void *userdata) {
+        Prioq *q;
+        unsigned i;
+        nsec_t t;
+
+        items_reset(n);
+
+        assert_se(q = prioq_new(item_compare));
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(prioq_put(q, arg_items + i, &arg_items[i].idx) >= 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        prioq_free(q);
+        return t;
+}
+
+static nsec_t bench_pop(unsigned n, void *userdata) {
+        uint64_t last = 0;
+        unsigned i;
+        Prioq *q;
+        nsec_t t;
+        Item *p;
+
+        q = prioq_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                assert_se(p = prioq_pop(q));
+                assert_se(p->prio >= last);
+                last = p->prio;
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        assert_se(prioq_isempty(q));
+
+        prioq_free(q);
+        return t;
+}
+
+static nsec_t bench_reshuffle(unsigned n, void *userdata) {
+        unsigned i;
+        Prioq *q;
+        nsec_t t;
+
+        q = prioq_fill(n);
+
+        /* Push each entry back by a varying amount, like rescheduled timers */
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                arg_items[i].prio += n / 2 + i % 64;
+                assert_se(prioq_reshuffle(q, arg_items + i, &arg_items[i].idx) >= 0);
+        }
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        prioq_free(q);
+        return t;
+}
+
+static nsec_t bench_remove(unsigned n, void *userdata) {
+        unsigned i;
+        Prioq *q;
+        nsec_t t;
+
+        q = prioq_fill(n);
+
+        t = now_nsec(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(prioq_remove(q, arg_items + i, &arg_items[i].idx) > 0);
+        t = now_nsec(CLOCK_MONOTONIC) - t;
+
+        assert_se(prioq_isempty(q));
+
+        prioq_free(q);
+        return t;
+}
+
+int main(int argc, char *argv[]) {
+        unsigned n;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        n = benchmark_get_iterations(argc, argv, 20000, 1000000);
+
+        arg_items = new(Item, n);
+        assert_se(arg_items);
+
+        benchmark_run("prioq", "put", n, bench_put, NULL);
+        benchmark_run("prioq", "pop", n, bench_pop, NULL);
+        benchmark_run("prioq", "reshuffle", n, bench_reshuffle, NULL);
+        benchmark_run("prioq", "remove", n, bench_remove, NULL);
+
+        arg_items = mfree(arg_items);
+
+        return 0;
+}
@@ -475,6 +475,45 @@ static void test_getpid_cached(void) {
         assert_se(si.si_code == CLD_EXITED);
 }
 
+static void test_pid_trylock(void) {
+        static pid_t owner = 0;
+        siginfo_t si;
+        pid_t child;
+
+        assert_se(pid_trylock(&owner) == 0);
+        assert_se(owner == getpid_cached());
+
+        /* Never taken twice, not even by the same thread */
+        assert_se(pid_trylock(&owner) == -EBUSY);
+
+        child = fork();
+        assert_se(child >= 0);
+
+        if (child == 0) {
+                /* The lock was held by our parent at the time of fork(), hence we take it over */
+                assert_se(pid_trylock(&owner) > 0);
+                assert_se(owner == getpid_cached());
+                assert_se(pid_trylock(&owner) == -EBUSY);
+
+                pid_unlock(&owner);
+                assert_se(owner == 0);
+                _exit(0);
+        }
+
+        assert_se(wait_for_terminate(child, &si) >= 0);
+        assert_se(si.si_code == CLD_EXITED);
+        assert_se(si.si_status == 0);
+
+        /* What the child did doesn't affect us */
+        assert_se(owner == getpid_cached());
+
+        pid_unlock(&owner);
+        assert_se(owner == 0);
+
+        assert_se(pid_trylock(&owner) == 0);
+        pid_unlock(&owner);
+}
+
 #define MEASURE_ITERATIONS (10000000LLU)
 
 static void test_getpid_measure(void) {
@@ -521,6 +560,7 @@ int main(int argc, char *argv[]) {
         test_get_process_cmdline_harder();
         test_rename_process();
         test_getpid_cached();
+        test_pid_trylock();
         test_getpid_measure();
 
         return 0;
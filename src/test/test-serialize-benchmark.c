@@ -0,0 +1,161 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "env-util.h"
+#include "fd-util.h"
+#include "fdset.h"
+#include "fileio.h"
+#include "manager.h"
+#include "parse-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "test-helper.h"
+#include "tests.h"
+
+/* Measures the state (de)serialization done on daemon-reload and daemon-reexec, with a unit count
+ * resembling a big host */
+
+static unsigned arg_units;
+static unsigned arg_iterations;
+
+static void make_units(const char *directory) {
+        unsigned i;
+
+        for (i = 0; i < arg_units; i++) {
+                char name[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)], contents[LINE_MAX];
+                const char *p;
+
+                xsprintf(name, "bench-%u.service", i);
+                xsprintf(contents,
+                         "[Unit]\n"
+                         "Description=Benchmark unit %u\n"
+                         "[Service]\n"
+                         "ExecStart=/bin/true %u\n"
+                         "ExecStartPre=/bin/true pre\n",
+                         i, i);
+
+                p = strjoina(directory, "/", name);
+                assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+        }
+}
+
+static void test_serialize(Manager *m) {
+        usec_t n, t_serialize = 0, t_deserialize = 0;
+        off_t size = 0;
+        unsigned i;
+
+        for (i = 0; i < arg_iterations; i++) {
+                _cleanup_fdset_free_ FDSet *fds = NULL;
+                _cleanup_fclose_ FILE *f = NULL;
+
+                assert_se(fds = fdset_new());
+                assert_se(manager_open_serialization(m, &f) >= 0);
+
+                n = now(CLOCK_MONOTONIC);
+                assert_se(manager_serialize(m, f, fds, false) >= 0);
+                assert_se(fflush_and_check(f) >= 0);
+                t_serialize += now(CLOCK_MONOTONIC) - n;
+
+                size = ftello(f);
+                assert_se(fseeko(f, 0, SEEK_SET) >= 0);
+
+                /* All units are loaded already, hence this only applies the state onto them again */
+                n = now(CLOCK_MONOTONIC);
+                assert_se(manager_deserialize(m, f, fds) >= 0);
+                t_deserialize += now(CLOCK_MONOTONIC) - n;
+        }
+
+        log_info("%u units, %"PRIu64" bytes: serialize %.2fms, deserialize %.2fms",
+                 arg_units, (uint64_t) size,
+                 t_serialize / 1e3 / arg_iterations, t_deserialize / 1e3 / arg_iterations);
+}
+
+static void test_reload(Manager *m) {
+        usec_t n, t = 0;
+        unsigned i;
+
+        for (i = 0; i < arg_iterations; i++) {
+                n = now(CLOCK_MONOTONIC);
+                assert_se(manager_reload(m) >= 0);
+                t += now(CLOCK_MONOTONIC) - n;
+        }
+
+        log_info("%u units: reload %.2fms", arg_units, t / 1e3 / arg_iterations);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
+        char unit_dir[] = "/tmp/test-serialize-benchmark.XXXXXX";
+        Manager *m = NULL;
+        unsigned i;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        if (argc >= 2)
+                assert_se(safe_atou(argv[1], &arg_units) >= 0);
+        else {
+                bool slow;
+
+                r = getenv_bool("SYSTEMD_SLOW_TESTS");
+                slow = r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT;
+
+                arg_units = slow ? 10000 : 200;
+        }
+
+        arg_iterations = 5;
+        if (argc >= 3)
+                assert_se(safe_atou(argv[2], &arg_iterations) >= 0 && arg_iterations > 0);
+
+        enter_cgroup_subroot();
+
+        assert_se(mkdtemp(unit_dir));
+        make_units(unit_dir);
+
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (MANAGER_SKIP_TEST(r)) {
+                log_notice_errno(r, "Skipping test: manager_new: %m");
+                (void) rm_rf(unit_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        for (i = 0; i < arg_units; i++) {
+                char name[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(name, "bench-%u.service", i);
+                assert_se(manager_load_unit(m, name, NULL, NULL, NULL) >= 0);
+        }
+
+        test_serialize(m);
+        test_reload(m);
+
+        manager_free(m);
+        assert_se(rm_rf(unit_dir, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
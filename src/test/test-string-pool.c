@@ -0,0 +1,95 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "alloc-util.h"
+#include "string-pool.h"
+#include "string-util.h"
+
+static void test_string_pool_ref(void) {
+        _cleanup_(string_pool_freep) StringPool *p = NULL;
+        _cleanup_free_ char *copy = NULL;
+        const char *a, *b, *c;
+
+        assert_se(p = string_pool_new());
+        assert_se(copy = strdup("foo.service"));
+
+        assert_se(!string_pool_ref(p, NULL));
+
+        assert_se(a = string_pool_ref(p, "foo.service"));
+        assert_se(a != copy);
+        assert_se(streq(a, "foo.service"));
+        assert_se(b = string_pool_ref(p, copy));
+        assert_se(a == b);
+        assert_se(c = string_pool_ref(p, "bar.service"));
+        assert_se(c != a);
+        assert_se(string_pool_size(p) == 2);
+
+        assert_se(string_pool_ref_interned(a) == a);
+
+        assert_se(!string_pool_unref(p, a));
+        assert_se(!string_pool_unref(p, b));
+        assert_se(string_pool_size(p) == 2);
+        assert_se(streq(a, "foo.service"));
+        assert_se(!string_pool_unref(p, a));
+        assert_se(string_pool_size(p) == 1);
+
+        assert_se(!string_pool_unref(p, c));
+        assert_se(string_pool_size(p) == 0);
+
+        assert_se(!string_pool_unref(p, NULL));
+}
+
+static void test_string_pool_set(void) {
+        _cleanup_(string_pool_freep) StringPool *p = NULL;
+        const char *x = NULL, *y = NULL, *old;
+
+        assert_se(p = string_pool_new());
+
+        assert_se(string_pool_set(p, &x, "a.slice") == 1);
+        assert_se(streq(x, "a.slice"));
+        old = x;
+        assert_se(string_pool_set(p, &x, "a.slice") == 0);
+        assert_se(x == old);
+        assert_se(string_pool_size(p) == 1);
+
+        assert_se(string_pool_set_interned(p, &y, x) == 1);
+        assert_se(x == y);
+        assert_se(string_pool_set_interned(p, &y, x) == 0);
+
+        assert_se(string_pool_set(p, &x, "b.slice") == 1);
+        assert_se(streq(x, "b.slice"));
+        assert_se(streq(y, "a.slice"));
+        assert_se(string_pool_size(p) == 2);
+
+        assert_se(string_pool_set_interned(p, &y, x) == 1);
+        assert_se(x == y);
+        assert_se(string_pool_size(p) == 1);
+
+        assert_se(string_pool_set(p, &x, NULL) == 1);
+        assert_se(!x);
+        assert_se(string_pool_set_interned(p, &y, NULL) == 1);
+        assert_se(!y);
+        assert_se(string_pool_size(p) == 0);
+        assert_se(string_pool_set(p, &x, NULL) == 0);
+}
+
+int main(int argc, const char *argv[]) {
+        test_string_pool_ref();
+        test_string_pool_set();
+
+        return 0;
+}
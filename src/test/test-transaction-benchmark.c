@@ -0,0 +1,157 @@
+/***
+  This file is part of systemd.
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "env-util.h"
+#include "fileio.h"
+#include "manager.h"
+#include "mkdir.h"
+#include "parse-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "test-helper.h"
+#include "tests.h"
+
+/* Measures building and activating a transaction for a target that pulls in lots of units, shaped
+ * like per-tenant slices: every unit is wanted by the target, ordered after its predecessor, and
+ * requires one of a few shared units. */
+
+#define N_SHARED 16U
+
+static unsigned arg_units;
+
+static void make_units(const char *directory) {
+        const char *wants;
+        unsigned i;
+
+        assert_se(write_string_file(strjoina(directory, "/bench.target"),
+                                    "[Unit]\n"
+                                    "Description=Benchmark target\n"
+                                    "DefaultDependencies=no\n",
+                                    WRITE_STRING_FILE_CREATE) >= 0);
+
+        wants = strjoina(directory, "/bench.target.wants");
+        assert_se(mkdir_p(wants, 0755) >= 0);
+
+        for (i = 0; i < N_SHARED; i++) {
+                char name[sizeof("shared-.service") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(name, "shared-%u.service", i);
+                assert_se(write_string_file(strjoina(directory, "/", name),
+                                            "[Unit]\n"
+                                            "DefaultDependencies=no\n"
+                                            "[Service]\n"
+                                            "ExecStart=/bin/true\n",
+                                            WRITE_STRING_FILE_CREATE) >= 0);
+        }
+
+        for (i = 0; i < arg_units; i++) {
+                char name[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)], contents[LINE_MAX];
+                char prev[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+                const char *p;
+
+                xsprintf(name, "bench-%u.service", i);
+                xsprintf(prev, "bench-%u.service", i - 1);
+                xsprintf(contents,
+                         "[Unit]\n"
+                         "DefaultDependencies=no\n"
+                         "Requires=shared-%u.service\n"
+                         "After=shared-%u.service %s\n"
+                         "[Service]\n"
+                         "ExecStart=/bin/true\n",
+                         i % N_SHARED, i % N_SHARED, i > 0 ? prev : "");
+
+                p = strjoina(directory, "/", name);
+                assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+
+                p = strjoina(wants, "/", name);
+                assert_se(symlink(strjoina("../", name), p) >= 0);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
+        char unit_dir[] = "/tmp/test-transaction-benchmark.XXXXXX";
+        usec_t n, t_load, t_start, t_again;
+        Manager *m = NULL;
+        Unit *target;
+        Job *j;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+        log_parse_environment();
+        log_open();
+
+        if (argc >= 2)
+                assert_se(safe_atou(argv[1], &arg_units) >= 0);
+        else {
+                bool slow;
+
+                r = getenv_bool("SYSTEMD_SLOW_TESTS");
+                slow = r >= 0 ? r : SYSTEMD_SLOW_TESTS_DEFAULT;
+
+                arg_units = slow ? 10000 : 500;
+        }
+
+        enter_cgroup_subroot();
+
+        assert_se(mkdtemp(unit_dir));
+        make_units(unit_dir);
+
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (MANAGER_SKIP_TEST(r)) {
+                log_notice_errno(r, "Skipping test: manager_new: %m");
+                (void) rm_rf(unit_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_load_unit(m, "bench.target", NULL, NULL, &target) >= 0);
+        t_load = now(CLOCK_MONOTONIC) - n;
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_add_job(m, JOB_START, target, JOB_REPLACE, NULL, &j) >= 0);
+        t_start = now(CLOCK_MONOTONIC) - n;
+
+        /* All units, the target and the shared ones got a job */
+        assert_se(hashmap_size(m->jobs) == arg_units + N_SHARED + 1);
+
+        /* The same transaction again, this time all of it has to be merged into the installed jobs */
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_add_job(m, JOB_START, target, JOB_REPLACE, NULL, &j) >= 0);
+        t_again = now(CLOCK_MONOTONIC) - n;
+
+        assert_se(hashmap_size(m->jobs) == arg_units + N_SHARED + 1);
+
+        log_info("%u units: load %.2fms, start transaction %.2fms, repeated %.2fms",
+                 arg_units, t_load / 1e3, t_start / 1e3, t_again / 1e3);
+
+        manager_clear_jobs(m);
+        manager_free(m);
+        assert_se(rm_rf(unit_dir, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
@@ -29,6 +29,35 @@ static void test_utf8_is_printable(void) {
         assert_se(utf8_is_printable("ąę", 4));
 }
 
+static void test_utf8_is_printable_long(void) {
+        char buf[64 + 1] = {};
+        size_t i;
+
+        /* Make sure the word-at-a-time fast path catches non-printable characters at every offset */
+        memset(buf, 'a', sizeof(buf) - 1);
+        assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+
+        for (i = 0; i < sizeof(buf) - 1; i++) {
+                buf[i] = '\001';
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+                buf[i] = 0x7f;
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+                buf[i] = '\t';
+                assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+                buf[i] = '~';
+                assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+                buf[i] = ' ';
+                assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+                buf[i] = '\342';
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+                assert_se(!utf8_is_valid(buf));
+                buf[i] = 'a';
+        }
+
+        assert_se(utf8_is_printable("0123456\342\204\242789abcdef", 19));
+        assert_se(utf8_is_valid("0123456\342\204\242789abcdef"));
+}
+
 static void test_utf8_is_valid(void) {
         assert_se(utf8_is_valid("ascii is valid unicode"));
         assert_se(utf8_is_valid("\342\204\242"));
@@ -108,6 +137,7 @@ static void test_utf16_to_utf8(void) {
 int main(int argc, char *argv[]) {
         test_utf8_is_valid();
         test_utf8_is_printable();
+        test_utf8_is_printable_long();
         test_ascii_is_valid();
         test_utf8_encoded_valid_unichar();
         test_utf8_escaping();
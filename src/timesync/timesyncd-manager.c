@@ -28,6 +28,8 @@
 #include <sys/timex.h>
 #include <sys/types.h>
 #include <time.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 
 #include "sd-daemon.h"
 
@@ -188,6 +190,7 @@ static int manager_send_request(Manager *m) {
          */
         assert_se(clock_gettime(clock_boottime_or_monotonic(), &m->trans_time_mon) >= 0);
         assert_se(clock_gettime(CLOCK_REALTIME, &m->trans_time) >= 0);
+        m->trans_time_kernel_valid = false;
         ntpmsg.trans_time.sec = htobe32(m->trans_time.tv_sec + OFFSET_1900_1970);
         ntpmsg.trans_time.frac = htobe32(m->trans_time.tv_nsec);
 
@@ -472,6 +475,55 @@ static void manager_adjust_poll(Manager *m, double offset, bool spike) {
         }
 }
 
+static int manager_receive_tx_timestamp(Manager *m, int fd) {
+        int n = 0;
+
+        assert(m);
+
+        /* Fetch the kernel transmit timestamps of our requests from the error queue, and return how many there
+         * were. Anything else found there is left to the caller to treat as a socket error. */
+
+        for (;;) {
+                union {
+                        struct cmsghdr cmsghdr;
+                        /* The error is followed by the address of the offender, see SO_EE_OFFENDER() */
+                        uint8_t buf[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+                                    CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+                } control;
+                struct msghdr msghdr = {
+                        .msg_control = &control,
+                        .msg_controllen = sizeof(control),
+                };
+                struct cmsghdr *cmsg;
+                double d;
+
+                if (recvmsg(fd, &msghdr, MSG_ERRQUEUE|MSG_DONTWAIT) < 0) {
+                        if (errno == EAGAIN)
+                                return n;
+
+                        return -errno;
+                }
+
+                CMSG_FOREACH(cmsg, &msghdr) {
+                        struct scm_timestamping *ts;
+
+                        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING)
+                                continue;
+
+                        n++;
+
+                        /* Only take the software timestamp, and only if it comes from sending the current
+                         * request, i.e. was taken shortly after the time we put into it. */
+                        ts = (struct scm_timestamping *) CMSG_DATA(cmsg);
+                        d = ts_to_d(&ts->ts[0]) - ts_to_d(&m->trans_time);
+                        if (m->pending && d >= 0 && d < 1.0) {
+                                m->trans_time_kernel = ts->ts[0];
+                                m->trans_time_kernel_valid = true;
+                        }
+                }
+        }
+}
+
 static int manager_receive_response(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
         Manager *m = userdata;
         struct ntp_msg ntpmsg;
@@ -482,7 +534,8 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         };
         union {
                 struct cmsghdr cmsghdr;
-                uint8_t buf[CMSG_SPACE(sizeof(struct timeval))];
+                uint8_t buf[CMSG_SPACE(sizeof(struct timespec)) +
+                            CMSG_SPACE(sizeof(struct scm_timestamping))];
         } control;
         union sockaddr_union server_addr;
         struct msghdr msghdr = {
@@ -506,6 +559,10 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         assert(source);
         assert(m);
 
+        /* Transmit timestamps are queued on the error queue, hence signal EPOLLERR, too */
+        if ((revents & EPOLLERR) && !(revents & EPOLLHUP) && manager_receive_tx_timestamp(m, fd) > 0)
+                revents &= ~EPOLLERR;
+
         if (revents & (EPOLLHUP|EPOLLERR)) {
                 log_warning("Server connection returned error.");
                 return manager_connect(m);
@@ -619,7 +676,7 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
          *  The round-trip delay, d, and system clock offset, t, are defined as:
          *  d = (T4 - T1) - (T3 - T2)     t = ((T2 - T1) + (T3 - T4)) / 2"
          */
-        origin = ts_to_d(&m->trans_time) + OFFSET_1900_1970;
+        origin = ts_to_d(m->trans_time_kernel_valid ? &m->trans_time_kernel : &m->trans_time) + OFFSET_1900_1970;
         receive = ntp_ts_to_d(&ntpmsg.recv_time);
         trans = ntp_ts_to_d(&ntpmsg.trans_time);
         dest = ts_to_d(recv_time) + OFFSET_1900_1970;
@@ -696,6 +753,7 @@ static int manager_listen_setup(Manager *m) {
         union sockaddr_union addr = {};
         static const int tos = IPTOS_LOWDELAY;
         static const int on = 1;
+        static const int tx_timestamping = SOF_TIMESTAMPING_TX_SOFTWARE|SOF_TIMESTAMPING_SOFTWARE|SOF_TIMESTAMPING_OPT_TSONLY;
         int r;
 
         assert(m);
@@ -720,6 +778,11 @@ static int manager_listen_setup(Manager *m) {
         if (r < 0)
                 return -errno;
 
+        /* Let the kernel timestamp our requests as they are handed to the device, too, which excludes the
+         * scheduling and network stack latencies from the origin timestamp. Older kernels don't support this,
+         * in which case we stick to the time taken right before sending. */
+        (void) setsockopt(m->server_socket, SOL_SOCKET, SO_TIMESTAMPING, &tx_timestamping, sizeof(tx_timestamping));
+
         (void) setsockopt(m->server_socket, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
 
         return sd_event_add_io(m->event, &m->event_receive, m->server_socket, EPOLLIN, manager_receive_response, m);
@@ -61,8 +61,10 @@ struct Manager {
         /* last sent packet */
         struct timespec trans_time_mon;
         struct timespec trans_time;
+        struct timespec trans_time_kernel;
         usec_t retry_interval;
         bool pending;
+        bool trans_time_kernel_valid;
 
         /* poll timer */
         sd_event_source *event_timer;
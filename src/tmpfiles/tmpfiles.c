@@ -232,6 +232,54 @@ static struct Item* find_glob(OrderedHashmap *h, const char *match) {
         return NULL;
 }
 
+static bool path_below(const char *path, const char *p, size_t k) {
+        /* Checks whether path refers to something strictly below the first k characters of p */
+
+        return strlen(path) > k && strneq(path, p, k) && path[k] == '/';
+}
+
+static bool glob_prefix_compatible(const char *glob, const char *p, size_t k) {
+        size_t n;
+
+        /* Checks whether the literal prefix of glob, i.e. the part before the first wildcard or escape
+         * character, is compatible with a path below the first k characters of p, i.e. with the string
+         * "p/" followed by anything. */
+
+        n = strcspn(glob, GLOB_CHARS "\\");
+        if (n <= k)
+                return strneq(glob, p, n);
+
+        return strneq(glob, p, k) && glob[k] == '/';
+}
+
+static bool items_below_path(const char *p) {
+        ItemArray *j;
+        Iterator i;
+        const char *key;
+        size_t k;
+
+        /* Returns true if any configured path or glob might refer to something below p. Directory
+         * trees that are cleaned up usually contain no such paths at all, which lets dir_cleanup()
+         * skip the per-entry lookups, in particular the fnmatch() calls for every glob. Literal paths
+         * need to be below p, globs can only match strings that begin with their literal prefix. */
+
+        /* Drop a trailing slash, most importantly the one of the root directory, or nothing would be
+         * found below "/", as the checks want another slash after it */
+        k = strlen(p);
+        if (k > 0 && p[k-1] == '/')
+                k--;
+
+        ORDERED_HASHMAP_FOREACH_KEY(j, key, items, i)
+                if (path_below(key, p, k))
+                        return true;
+
+        ORDERED_HASHMAP_FOREACH_KEY(j, key, globs, i)
+                if (glob_prefix_compatible(key, p, k))
+                        return true;
+
+        return false;
+}
+
 static void load_unix_sockets(void) {
         _cleanup_fclose_ FILE *f = NULL;
         char line[LINE_MAX];
@@ -308,15 +356,21 @@ static bool unix_socket_alive(const char *fn) {
         return true;
 }
 
-static int dir_is_mount_point(DIR *d, const char *subdir) {
+static int dir_is_mount_point(DIR *d, int *parent_r, int *parent_mount_id, const char *subdir) {
 
         union file_handle_union h = FILE_HANDLE_INIT;
-        int mount_id_parent, mount_id;
+        int mount_id;
         int r_p, r;
 
-        r_p = name_to_handle_at(dirfd(d), ".", &h.handle, &mount_id_parent, 0);
-        if (r_p < 0)
-                r_p = -errno;
+        /* The handle of the directory itself is the same for all of its entries, hence it is only
+         * queried once and cached by the caller in *parent_r and *parent_mount_id. A positive
+         * *parent_r means it hasn't been queried yet. */
+        if (*parent_r > 0) {
+                *parent_r = name_to_handle_at(dirfd(d), ".", &h.handle, parent_mount_id, 0);
+                if (*parent_r < 0)
+                        *parent_r = -errno;
+        }
+        r_p = *parent_r;
 
         h.handle.handle_bytes = MAX_HANDLE_SZ;
         r = name_to_handle_at(dirfd(d), subdir, &h.handle, &mount_id, 0);
@@ -329,7 +383,7 @@ static int dir_is_mount_point(DIR *d, const char *subdir) {
 
         /* got both handles; if they differ, it is a mount point */
         if (r_p >= 0 && r >= 0)
-                return mount_id_parent != mount_id;
+                return *parent_mount_id != mount_id;
 
         /* got only one handle; assume different mount points if one
          * of both queries was not supported by the filesystem */
@@ -377,8 +431,12 @@ static int dir_cleanup(
 
         struct dirent *dent;
         struct timespec times[2];
-        bool deleted = false;
-        int r = 0;
+        bool deleted = false, check_items;
+        int r = 0, parent_r = 1, parent_mount_id = 0;
+
+        check_items = items_below_path(p);
+        if (!check_items)
+                log_debug("No entries configured below \"%s\", skipping lookups.", p);
 
         FOREACH_DIRENT_ALL(dent, d, break) {
                 struct stat s;
@@ -410,7 +468,7 @@ static int dir_cleanup(
                 /* Try to detect bind mounts of the same filesystem instance; they
                  * do not differ in device major/minors. This type of query is not
                  * supported on all kernels or filesystem types though. */
-                if (S_ISDIR(s.st_mode) && dir_is_mount_point(d, dent->d_name) > 0) {
+                if (S_ISDIR(s.st_mode) && dir_is_mount_point(d, &parent_r, &parent_mount_id, dent->d_name) > 0) {
                         log_debug("Ignoring \"%s/%s\": different mount of the same filesystem.",
                                   p, dent->d_name);
                         continue;
@@ -429,12 +487,12 @@ static int dir_cleanup(
                 }
 
                 /* Is there an item configured for this path? */
-                if (ordered_hashmap_get(items, sub_path)) {
+                if (check_items && ordered_hashmap_get(items, sub_path)) {
                         log_debug("Ignoring \"%s\": a separate entry exists.", sub_path);
                         continue;
                 }
 
-                if (find_glob(globs, sub_path)) {
+                if (check_items && find_glob(globs, sub_path)) {
                         log_debug("Ignoring \"%s\": a separate glob exists.", sub_path);
                         continue;
                 }
@@ -24,9 +24,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "sd-device.h"
+
 #include "dirent-util.h"
 #include "format-util.h"
 #include "fs-util.h"
+#include "parse-util.h"
 #include "selinux-util.h"
 #include "smack-util.h"
 #include "stdio-util.h"
@@ -125,6 +128,59 @@ exit:
         return err;
 }
 
+/* Every device claiming a devlink leaves an entry in the link's stack directory, named after its id
+ * filename. The entry is a symlink to "PRIORITY:DEVNODE", so that the link target can be picked without
+ * reading the database of every claimant. Plain files left behind by older versions are still looked
+ * up in the database. */
+static int stack_entry_read(struct udev *udev, DIR *dir, struct dirent *dent, int *ret_priority, char **ret_devnode) {
+        _cleanup_free_ char *value = NULL;
+        struct udev_device *dev_db;
+        const char *devnode;
+        char *colon;
+        int r;
+
+        r = readlinkat_malloc(dirfd(dir), dent->d_name, &value);
+        if (r >= 0) {
+                sd_device *claimant;
+
+                /* The entry of a device that went away without its remove event being processed stays
+                 * behind, don't let it keep the link pointing to a device node that is gone */
+                r = sd_device_new_from_device_id(&claimant, dent->d_name);
+                if (r < 0)
+                        return r;
+                sd_device_unref(claimant);
+
+                colon = strchr(value, ':');
+                if (!colon)
+                        return -EBADMSG;
+
+                *colon = '\0';
+                r = safe_atoi(value, ret_priority);
+                if (r < 0)
+                        return r;
+
+                *ret_devnode = strdup(colon + 1);
+                return *ret_devnode ? 0 : -ENOMEM;
+        }
+        if (r != -EINVAL)
+                return r;
+
+        dev_db = udev_device_new_from_device_id(udev, dent->d_name);
+        if (!dev_db)
+                return -ENODEV;
+
+        devnode = udev_device_get_devnode(dev_db);
+        if (devnode) {
+                *ret_priority = udev_device_get_devlink_priority(dev_db);
+                *ret_devnode = strdup(devnode);
+                r = *ret_devnode ? 0 : -ENOMEM;
+        } else
+                r = -ENODEV;
+
+        udev_device_unref(dev_db);
+        return r;
+}
+
 /* find device node of device with highest priority */
 static const char *link_find_prioritized(struct udev_device *dev, bool add, const char *stackdir, char *buf, size_t bufsize) {
         struct udev *udev = udev_device_get_udev(dev);
@@ -143,7 +199,8 @@ static const char *link_find_prioritized(struct udev_device *dev, bool add, cons
         if (dir == NULL)
                 return target;
         FOREACH_DIRENT_ALL(dent, dir, break) {
-                struct udev_device *dev_db;
+                _cleanup_free_ char *devnode = NULL;
+                int prio;
 
                 if (dent->d_name[0] == '\0')
                         break;
@@ -156,21 +213,14 @@ static const char *link_find_prioritized(struct udev_device *dev, bool add, cons
                 if (streq(dent->d_name, udev_device_get_id_filename(dev)))
                         continue;
 
-                dev_db = udev_device_new_from_device_id(udev, dent->d_name);
-                if (dev_db != NULL) {
-                        const char *devnode;
-
-                        devnode = udev_device_get_devnode(dev_db);
-                        if (devnode != NULL) {
-                                if (target == NULL || udev_device_get_devlink_priority(dev_db) > priority) {
-                                        log_debug("'%s' claims priority %i for '%s'",
-                                                  udev_device_get_syspath(dev_db), udev_device_get_devlink_priority(dev_db), stackdir);
-                                        priority = udev_device_get_devlink_priority(dev_db);
-                                        strscpy(buf, bufsize, devnode);
-                                        target = buf;
-                                }
-                        }
-                        udev_device_unref(dev_db);
+                if (stack_entry_read(udev, dir, dent, &prio, &devnode) < 0)
+                        continue;
+
+                if (target == NULL || prio > priority) {
+                        log_debug("'%s' claims priority %i for '%s'", dent->d_name, prio, stackdir);
+                        priority = prio;
+                        strscpy(buf, bufsize, devnode);
+                        target = buf;
                 }
         }
         closedir(dir);
@@ -203,19 +253,16 @@ static void link_update(struct udev_device *dev, const char *slink, bool add) {
         }
 
         if (add) {
+                char value[DECIMAL_STR_MAX(int) + 1 + UTIL_PATH_SIZE];
                 int err;
 
-                do {
-                        int fd;
+                xsprintf(value, "%i:%s", udev_device_get_devlink_priority(dev), udev_device_get_devnode(dev));
 
+                do {
                         err = mkdir_parents(filename, 0755);
                         if (err != 0 && err != -ENOENT)
                                 break;
-                        fd = open(filename, O_WRONLY|O_CREAT|O_CLOEXEC|O_TRUNC|O_NOFOLLOW, 0444);
-                        if (fd >= 0)
-                                close(fd);
-                        else
-                                err = -errno;
+                        err = symlink_atomic(value, filename);
                 } while (err == -ENOENT);
         }
 }
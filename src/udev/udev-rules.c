@@ -25,6 +25,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -33,16 +35,21 @@
 #include "dirent-util.h"
 #include "escape.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "glob-util.h"
+#include "hashmap.h"
 #include "path-util.h"
 #include "proc-cmdline.h"
+#include "siphash24.h"
 #include "stat-util.h"
 #include "stdio-util.h"
 #include "strbuf.h"
+#include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
 #include "sysctl-util.h"
+#include "time-util.h"
 #include "udev.h"
 #include "user-util.h"
 #include "util.h"
@@ -84,6 +91,13 @@ struct udev_rules {
         struct uid_gid *gids;
         unsigned int gids_cur;
         unsigned int gids_max;
+
+        /* rules requiring a specific SUBSYSTEM are indexed by it, all others are checked for every event */
+        Hashmap *subsystem_rules;
+        struct rule_refs *generic_rules;
+
+        /* time spent in every rule, indexed like tokens, if profiling is enabled */
+        nsec_t *profile_nsec;
 };
 
 static char *rules_str(struct udev_rules *rules, unsigned int off) {
@@ -115,6 +129,7 @@ enum string_glob_type {
         GL_SPLIT,                       /* multi-value A|B */
         GL_SPLIT_GLOB,                  /* multi-value with glob A*|B* */
         GL_SOMETHING,                   /* commonly used "?*" */
+        GL_PREFIX,                      /* glob with a single trailing '*' only, commonly used "sd*" */
 };
 
 enum string_subst_type {
@@ -230,6 +245,70 @@ struct rule_tmp {
         unsigned int token_cur;
 };
 
+/* After parsing, the token array and the string buffer are written to this file as they are in memory,
+ * and loaded instead of parsing the rules files again as long as the fingerprint of the inputs matches.
+ * The cache is only ever used on the machine it was written on. */
+#define RULES_CACHE_PATH "/run/udev/rules.bin"
+#define RULES_CACHE_SIG { 'U', 'D', 'E', 'V', 'R', 'U', 'L', 'E' }
+
+struct rules_cache_header {
+        uint8_t signature[8];
+        uint64_t header_size;
+        uint64_t token_size;
+        uint64_t fingerprint;
+        uint64_t n_tokens;
+        uint64_t strings_len;
+};
+
+/* the actions the kernel sends, anything else is folded into RULE_ACTION_OTHER */
+enum rule_action {
+        RULE_ACTION_ADD,
+        RULE_ACTION_REMOVE,
+        RULE_ACTION_CHANGE,
+        RULE_ACTION_MOVE,
+        RULE_ACTION_ONLINE,
+        RULE_ACTION_OFFLINE,
+        RULE_ACTION_BIND,
+        RULE_ACTION_UNBIND,
+        RULE_ACTION_OTHER,
+        _RULE_ACTION_MAX,
+        _RULE_ACTION_INVALID = -1,
+};
+
+#define RULE_ACTIONS_ALL ((1U << _RULE_ACTION_MAX) - 1)
+
+static const char* const rule_action_table[_RULE_ACTION_MAX] = {
+        [RULE_ACTION_ADD] = "add",
+        [RULE_ACTION_REMOVE] = "remove",
+        [RULE_ACTION_CHANGE] = "change",
+        [RULE_ACTION_MOVE] = "move",
+        [RULE_ACTION_ONLINE] = "online",
+        [RULE_ACTION_OFFLINE] = "offline",
+        [RULE_ACTION_BIND] = "bind",
+        [RULE_ACTION_UNBIND] = "unbind",
+};
+
+DEFINE_PRIVATE_STRING_TABLE_LOOKUP_FROM_STRING(rule_action, enum rule_action);
+
+struct rule_ref {
+        unsigned int token;             /* index of the TK_RULE token */
+        unsigned int actions;           /* mask of the actions the rule can match */
+};
+
+/* rule references in token order */
+struct rule_refs {
+        struct rule_ref *refs;
+        size_t n_refs;
+        size_t n_allocated;
+};
+
+/* walks the generic rules and the ones of the event's subsystem in parallel */
+struct rule_cursor {
+        const struct rule_ref *generic, *generic_end;
+        const struct rule_ref *subsystem, *subsystem_end;
+        unsigned int action;
+};
+
 #ifdef DEBUG
 static const char *operation_str(enum operation_type type) {
         static const char *operation_strs[] = {
@@ -255,6 +334,7 @@ static const char *string_glob_str(enum string_glob_type type) {
                 [GL_SPLIT] =            "split",
                 [GL_SPLIT_GLOB] =       "split-glob",
                 [GL_SOMETHING] =        "split-glob",
+                [GL_PREFIX] =           "prefix",
         };
 
         return string_glob_strs[type];
@@ -940,8 +1020,13 @@ static void rule_add_key(struct rule_tmp *rule_tmp, enum token_type type,
                 } else if (has_split) {
                         glob = GL_SPLIT;
                 } else if (has_glob) {
+                        size_t len = strlen(value);
+
                         if (streq(value, "?*"))
                                 glob = GL_SOMETHING;
+                        else if (value[len-1] == '*' &&
+                                 !strpbrk(strndupa(value, len-1), GLOB_CHARS "\\"))
+                                glob = GL_PREFIX;
                         else
                                 glob = GL_GLOB;
                 } else {
@@ -1520,38 +1605,373 @@ static int parse_file(struct udev_rules *rules, const char *filename) {
         return 0;
 }
 
-struct udev_rules *udev_rules_new(struct udev *udev, int resolve_names) {
-        struct udev_rules *rules;
-        struct udev_list file_list;
-        struct token end_token;
-        char **files, **f;
-        int r;
+static unsigned int action_mask_from_token(struct udev_rules *rules, struct token *token) {
+        const char *value = rules_str(rules, token->key.value_off);
+        unsigned int mask = 0;
+        const char *p;
+
+        /* Returns the actions of events the ACTION key may match, globs are not looked into */
+        if (!IN_SET(token->key.glob, GL_PLAIN, GL_SPLIT))
+                return RULE_ACTIONS_ALL;
+
+        for (p = value;;) {
+                _cleanup_free_ char *word = NULL;
+                enum rule_action a;
+                size_t n;
+
+                n = strcspn(p, "|");
+                word = strndup(p, n);
+                if (!word)
+                        return RULE_ACTIONS_ALL;
+
+                a = rule_action_from_string(word);
+                if (a >= 0)
+                        mask |= 1U << a;
+                else if (token->key.op == OP_MATCH)
+                        mask |= 1U << RULE_ACTION_OTHER;
+
+                if (p[n] == '\0')
+                        break;
+                p += n + 1;
+        }
 
-        rules = new0(struct udev_rules, 1);
-        if (rules == NULL)
+        return token->key.op == OP_NOMATCH ? RULE_ACTIONS_ALL & ~mask : mask;
+}
+
+static int rule_refs_add(struct rule_refs *refs, unsigned int token, unsigned int actions) {
+        assert(refs);
+
+        /* a rule may list the same subsystem more than once */
+        if (refs->n_refs > 0 && refs->refs[refs->n_refs-1].token == token)
+                return 0;
+
+        if (!GREEDY_REALLOC(refs->refs, refs->n_allocated, refs->n_refs + 1))
+                return -ENOMEM;
+
+        refs->refs[refs->n_refs++] = (struct rule_ref) {
+                .token = token,
+                .actions = actions,
+        };
+        return 0;
+}
+
+static struct rule_refs *rule_refs_free(struct rule_refs *refs) {
+        if (!refs)
                 return NULL;
-        rules->udev = udev;
-        rules->resolve_names = resolve_names;
-        udev_list_init(udev, &file_list, true);
 
-        /* init token array and string buffer */
-        rules->tokens = malloc(PREALLOC_TOKEN * sizeof(struct token));
-        if (rules->tokens == NULL)
-                return udev_rules_unref(rules);
-        rules->token_max = PREALLOC_TOKEN;
+        free(refs->refs);
+        return mfree(refs);
+}
 
-        rules->strbuf = strbuf_new();
-        if (!rules->strbuf)
-                return udev_rules_unref(rules);
+static int add_subsystem_rule(struct udev_rules *rules, const char *subsystem, size_t len,
+                              unsigned int token, unsigned int actions) {
+        _cleanup_free_ char *key = NULL;
+        struct rule_refs *refs;
+        int r;
 
-        udev_rules_check_timestamp(rules);
+        key = strndup(subsystem, len);
+        if (!key)
+                return -ENOMEM;
 
-        r = conf_files_list_strv(&files, ".rules", NULL, 0, rules_dirs);
-        if (r < 0) {
-                log_error_errno(r, "failed to enumerate rules files: %m");
-                return udev_rules_unref(rules);
+        refs = hashmap_get(rules->subsystem_rules, key);
+        if (!refs) {
+                refs = new0(struct rule_refs, 1);
+                if (!refs)
+                        return -ENOMEM;
+
+                r = hashmap_put(rules->subsystem_rules, key, refs);
+                if (r < 0) {
+                        rule_refs_free(refs);
+                        return r;
+                }
+                key = NULL;
         }
 
+        return rule_refs_add(refs, token, actions);
+}
+
+static int index_rules(struct udev_rules *rules) {
+        unsigned int i;
+        int r;
+
+        /* Sorts every rule into the list of the subsystem its SUBSYSTEM=="a|b" key requires, or the
+         * generic list, and records the actions its ACTION keys permit. All keys compared before those
+         * are plain matches without side effects, so skipping a rule which would fail on them is the
+         * same as evaluating it. */
+
+        rules->subsystem_rules = hashmap_new(&string_hash_ops);
+        if (!rules->subsystem_rules)
+                return -ENOMEM;
+
+        rules->generic_rules = new0(struct rule_refs, 1);
+        if (!rules->generic_rules)
+                return -ENOMEM;
+
+        for (i = 0; i < rules->token_cur; i++) {
+                struct token *rule = &rules->tokens[i], *subsystem = NULL;
+                unsigned int actions = RULE_ACTIONS_ALL, j;
+                const char *p;
+
+                if (rule->type != TK_RULE)
+                        continue;
+
+                for (j = 1; j < rule->rule.token_count; j++) {
+                        struct token *key = rule + j;
+
+                        if (key->type == TK_M_ACTION)
+                                actions &= action_mask_from_token(rules, key);
+                        else if (key->type == TK_M_SUBSYSTEM && !subsystem &&
+                                 key->key.op == OP_MATCH && IN_SET(key->key.glob, GL_PLAIN, GL_SPLIT))
+                                subsystem = key;
+                        else if (key->type > TK_M_SUBSYSTEM)
+                                break;
+                }
+
+                /* can never match */
+                if (actions == 0)
+                        continue;
+
+                if (!subsystem) {
+                        r = rule_refs_add(rules->generic_rules, i, actions);
+                        if (r < 0)
+                                return r;
+                        continue;
+                }
+
+                for (p = rules_str(rules, subsystem->key.value_off);;) {
+                        size_t n;
+
+                        n = strcspn(p, "|");
+                        r = add_subsystem_rule(rules, p, n, i, actions);
+                        if (r < 0)
+                                return r;
+
+                        if (p[n] == '\0')
+                                break;
+                        p += n + 1;
+                }
+        }
+
+        log_debug("rules indexed by %u subsystems, %zu generic rules",
+                  hashmap_size(rules->subsystem_rules), rules->generic_rules->n_refs);
+        return 0;
+}
+
+static void rule_cursor_init(struct udev_rules *rules, struct rule_cursor *c, struct udev_device *dev) {
+        const struct rule_refs *refs;
+        const char *subsystem;
+        enum rule_action a;
+
+        assert(rules);
+        assert(c);
+        assert(dev);
+
+        a = rule_action_from_string(strempty(udev_device_get_action(dev)));
+        c->action = 1U << (a >= 0 ? a : RULE_ACTION_OTHER);
+
+        c->generic = rules->generic_rules->refs;
+        c->generic_end = c->generic + rules->generic_rules->n_refs;
+
+        subsystem = strempty(udev_device_get_subsystem(dev));
+        refs = hashmap_get(rules->subsystem_rules, subsystem);
+        if (refs) {
+                c->subsystem = refs->refs;
+                c->subsystem_end = c->subsystem + refs->n_refs;
+        } else
+                c->subsystem = c->subsystem_end = NULL;
+}
+
+/* Returns the first rule at or after the token index which may match the event, or the final TK_END
+ * token. Rules are only ever looked at in ascending order, GOTOs jump forward too. */
+static unsigned int rule_cursor_next(struct udev_rules *rules, struct rule_cursor *c, unsigned int token) {
+        while (c->generic < c->generic_end &&
+               (c->generic->token < token || !(c->generic->actions & c->action)))
+                c->generic++;
+        while (c->subsystem < c->subsystem_end &&
+               (c->subsystem->token < token || !(c->subsystem->actions & c->action)))
+                c->subsystem++;
+
+        if (c->generic < c->generic_end) {
+                if (c->subsystem < c->subsystem_end)
+                        return MIN(c->generic->token, c->subsystem->token);
+                return c->generic->token;
+        }
+        if (c->subsystem < c->subsystem_end)
+                return c->subsystem->token;
+
+        return rules->token_cur - 1;
+}
+
+static void rules_cache_fingerprint_file(struct siphash *state, const char *path) {
+        struct stat st;
+
+        siphash24_compress(path, strlen(path) + 1, state);
+
+        if (stat(path, &st) < 0) {
+                siphash24_compress(&errno, sizeof(errno), state);
+                return;
+        }
+
+        siphash24_compress(&st.st_dev, sizeof(st.st_dev), state);
+        siphash24_compress(&st.st_ino, sizeof(st.st_ino), state);
+        siphash24_compress(&st.st_size, sizeof(st.st_size), state);
+        siphash24_compress(&st.st_mtim, sizeof(st.st_mtim), state);
+}
+
+static uint64_t rules_cache_fingerprint(char **files, int resolve_names) {
+        static const uint8_t key[16] = {
+                0x5c, 0x3e, 0x1b, 0x86, 0x0d, 0x2f, 0x4a, 0x91,
+                0xa7, 0x62, 0xe4, 0x38, 0xf0, 0x19, 0xc5, 0x7d,
+        };
+        struct siphash state;
+        char **f;
+
+        /* Everything the compiled rules depend on: the version of the compiler, the rules files, and
+         * the user database if names are resolved while parsing */
+        siphash24_init(&state, key);
+        siphash24_compress(PACKAGE_VERSION, strlen(PACKAGE_VERSION) + 1, &state);
+        siphash24_compress(&resolve_names, sizeof(resolve_names), &state);
+
+        STRV_FOREACH(f, files)
+                rules_cache_fingerprint_file(&state, *f);
+
+        if (resolve_names > 0) {
+                rules_cache_fingerprint_file(&state, "/etc/passwd");
+                rules_cache_fingerprint_file(&state, "/etc/group");
+        }
+
+        return siphash24_finalize(&state);
+}
+
+static int rules_cache_load(struct udev_rules *rules, uint64_t fingerprint) {
+        static const char sig[] = RULES_CACHE_SIG;
+        _cleanup_close_ int fd = -1;
+        const struct rules_cache_header *h;
+        struct token *tokens;
+        const char *strings;
+        char *buf;
+        struct stat st;
+        void *p;
+        int r = 0;
+
+        fd = open(RULES_CACHE_PATH, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        /* only trust what privileged udev wrote itself */
+        if (!S_ISREG(st.st_mode) || st.st_uid != 0 || (st.st_mode & 0022) != 0)
+                return -EPERM;
+
+        if ((size_t) st.st_size < sizeof(struct rules_cache_header))
+                return -EBADMSG;
+
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        h = p;
+        if (memcmp(h->signature, sig, sizeof(h->signature)) != 0 ||
+            h->header_size != sizeof(struct rules_cache_header) ||
+            h->token_size != sizeof(struct token)) {
+                r = -EBADMSG;
+                goto finish;
+        }
+
+        if (h->fingerprint != fingerprint) {
+                r = -ESTALE;
+                goto finish;
+        }
+
+        if (h->n_tokens == 0 || h->n_tokens > UINT_MAX ||
+            h->strings_len == 0 || h->strings_len > (uint64_t) st.st_size ||
+            h->n_tokens > ((uint64_t) st.st_size - sizeof(struct rules_cache_header)) / sizeof(struct token) ||
+            sizeof(struct rules_cache_header) + h->n_tokens * sizeof(struct token) + h->strings_len != (uint64_t) st.st_size) {
+                r = -EBADMSG;
+                goto finish;
+        }
+
+        tokens = (struct token*) ((const uint8_t*) p + sizeof(struct rules_cache_header));
+        strings = (const char*) (tokens + h->n_tokens);
+        if (tokens[h->n_tokens - 1].type != TK_END || strings[h->strings_len - 1] != '\0') {
+                r = -EBADMSG;
+                goto finish;
+        }
+
+        tokens = newdup(struct token, tokens, h->n_tokens);
+        if (!tokens) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        buf = memdup(strings, h->strings_len);
+        if (!buf) {
+                free(tokens);
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        free(rules->tokens);
+        rules->tokens = tokens;
+        rules->token_cur = rules->token_max = h->n_tokens;
+
+        strbuf_complete(rules->strbuf);
+        free(rules->strbuf->buf);
+        rules->strbuf->buf = buf;
+        rules->strbuf->len = h->strings_len;
+
+finish:
+        (void) munmap(p, st.st_size);
+        return r;
+}
+
+static int rules_cache_save(struct udev_rules *rules, uint64_t fingerprint) {
+        static const char sig[] = RULES_CACHE_SIG;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *temp_path = NULL;
+        struct rules_cache_header h = {
+                .header_size = sizeof(struct rules_cache_header),
+                .token_size = sizeof(struct token),
+                .fingerprint = fingerprint,
+                .n_tokens = rules->token_cur,
+                .strings_len = rules->strbuf->len,
+        };
+        int r;
+
+        memcpy(h.signature, sig, sizeof(h.signature));
+
+        r = fopen_temporary(RULES_CACHE_PATH, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0644);
+
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(rules->tokens, sizeof(struct token), rules->token_cur, f);
+        fwrite(rules->strbuf->buf, 1, rules->strbuf->len, f);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, RULES_CACHE_PATH) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(temp_path);
+        return r;
+}
+
+static int rules_parse_files(struct udev_rules *rules, char **files) {
+        struct token end_token;
+        char **f;
+
         /*
          * The offset value in the rules strct is limited; add all
          * rules file names to the beginning of the string buffer.
@@ -1562,11 +1982,10 @@ struct udev_rules *udev_rules_new(struct udev *udev, int resolve_names) {
         STRV_FOREACH(f, files)
                 parse_file(rules, *f);
 
-        strv_free(files);
-
         memzero(&end_token, sizeof(struct token));
         end_token.type = TK_END;
-        add_token(rules, &end_token);
+        if (add_token(rules, &end_token) != 0)
+                return log_oom();
         log_debug("rules contain %zu bytes tokens (%u * %zu bytes), %zu bytes strings",
                   rules->token_max * sizeof(struct token), rules->token_max, sizeof(struct token), rules->strbuf->len);
 
@@ -1584,17 +2003,84 @@ struct udev_rules *udev_rules_new(struct udev *udev, int resolve_names) {
         rules->gids_cur = 0;
         rules->gids_max = 0;
 
+        return 0;
+}
+
+struct udev_rules *udev_rules_new(struct udev *udev, int resolve_names) {
+        struct udev_rules *rules;
+        struct udev_list file_list;
+        _cleanup_strv_free_ char **files = NULL;
+        uint64_t fingerprint;
+        int r;
+
+        rules = new0(struct udev_rules, 1);
+        if (rules == NULL)
+                return NULL;
+        rules->udev = udev;
+        rules->resolve_names = resolve_names;
+        udev_list_init(udev, &file_list, true);
+
+        /* init token array and string buffer */
+        rules->tokens = malloc(PREALLOC_TOKEN * sizeof(struct token));
+        if (rules->tokens == NULL)
+                return udev_rules_unref(rules);
+        rules->token_max = PREALLOC_TOKEN;
+
+        rules->strbuf = strbuf_new();
+        if (!rules->strbuf)
+                return udev_rules_unref(rules);
+
+        udev_rules_check_timestamp(rules);
+
+        r = conf_files_list_strv(&files, ".rules", NULL, 0, rules_dirs);
+        if (r < 0) {
+                log_error_errno(r, "failed to enumerate rules files: %m");
+                return udev_rules_unref(rules);
+        }
+
+        fingerprint = rules_cache_fingerprint(files, resolve_names);
+
+        r = rules_cache_load(rules, fingerprint);
+        if (r >= 0)
+                log_debug("loaded %u compiled rules tokens from " RULES_CACHE_PATH, rules->token_cur);
+        else {
+                if (r != -ENOENT)
+                        log_debug_errno(r, "not using " RULES_CACHE_PATH ": %m");
+
+                if (rules_parse_files(rules, files) < 0)
+                        return udev_rules_unref(rules);
+
+                r = rules_cache_save(rules, fingerprint);
+                if (r < 0)
+                        log_debug_errno(r, "failed to write " RULES_CACHE_PATH ", ignoring: %m");
+        }
+
+        r = index_rules(rules);
+        if (r < 0) {
+                log_error_errno(r, "failed to index rules: %m");
+                return udev_rules_unref(rules);
+        }
+
         dump_rules(rules);
         return rules;
 }
 
 struct udev_rules *udev_rules_unref(struct udev_rules *rules) {
+        char *key;
+
         if (rules == NULL)
                 return NULL;
         free(rules->tokens);
         strbuf_cleanup(rules->strbuf);
         free(rules->uids);
         free(rules->gids);
+        while ((key = hashmap_first_key(rules->subsystem_rules))) {
+                rule_refs_free(hashmap_remove(rules->subsystem_rules, key));
+                free(key);
+        }
+        hashmap_free(rules->subsystem_rules);
+        rule_refs_free(rules->generic_rules);
+        free(rules->profile_nsec);
         return mfree(rules);
 }
 
@@ -1667,6 +2153,9 @@ static int match_key(struct udev_rules *rules, struct token *token, const char *
         case GL_SOMETHING:
                 match = (val[0] != '\0');
                 break;
+        case GL_PREFIX:
+                match = strneq(key_value, val, strlen(key_value) - 1);
+                break;
         case GL_UNSET:
                 return -1;
         }
@@ -1739,7 +2228,10 @@ void udev_rules_apply_to_event(struct udev_rules *rules,
                                struct udev_list *properties_list) {
         struct token *cur;
         struct token *rule;
+        struct rule_cursor cursor;
         enum escape_type esc = ESCAPE_UNSET;
+        unsigned int profile_rule = UINT_MAX;
+        nsec_t profile_ts = 0;
         bool can_set_name;
         int r;
 
@@ -1750,10 +2242,29 @@ void udev_rules_apply_to_event(struct udev_rules *rules,
                         (major(udev_device_get_devnum(event->dev)) > 0 ||
                          udev_device_get_ifindex(event->dev) > 0));
 
+        rule_cursor_init(rules, &cursor, event->dev);
+
         /* loop through token list, match, run actions or forward to next rule */
         cur = &rules->tokens[0];
         rule = cur;
         for (;;) {
+                if (IN_SET(cur->type, TK_RULE, TK_END)) {
+                        unsigned int next;
+
+                        /* skip all rules which cannot match the event's subsystem and action */
+                        next = rule_cursor_next(rules, &cursor, cur - rules->tokens);
+                        cur = &rules->tokens[next];
+
+                        if (rules->profile_nsec) {
+                                nsec_t ts = now_nsec(CLOCK_MONOTONIC);
+
+                                if (profile_rule != UINT_MAX)
+                                        rules->profile_nsec[profile_rule] += ts - profile_ts;
+                                profile_rule = next;
+                                profile_ts = ts;
+                        }
+                }
+
                 dump_token(rules, cur);
                 switch (cur->type) {
                 case TK_RULE:
@@ -2430,6 +2941,78 @@ void udev_rules_apply_to_event(struct udev_rules *rules,
         }
 }
 
+int udev_rules_set_profile(struct udev_rules *rules, bool b) {
+        assert(rules);
+
+        if (!b) {
+                rules->profile_nsec = mfree(rules->profile_nsec);
+                return 0;
+        }
+
+        if (rules->profile_nsec)
+                return 0;
+
+        rules->profile_nsec = new0(nsec_t, rules->token_cur);
+        if (!rules->profile_nsec)
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int profile_compare(const void *a, const void *b, void *userdata) {
+        const nsec_t *p = userdata;
+        unsigned int x = *(const unsigned int*) a, y = *(const unsigned int*) b;
+
+        if (p[x] > p[y])
+                return -1;
+        if (p[x] < p[y])
+                return 1;
+        return x < y ? -1 : x > y;
+}
+
+void udev_rules_dump_profile(struct udev_rules *rules, FILE *f) {
+        _cleanup_free_ unsigned int *visited = NULL;
+        unsigned int i, n = 0, n_rules = 0;
+        nsec_t total = 0;
+
+        assert(rules);
+
+        if (!f)
+                f = stdout;
+
+        if (!rules->profile_nsec)
+                return;
+
+        visited = new(unsigned int, rules->token_cur);
+        if (!visited) {
+                log_oom();
+                return;
+        }
+
+        for (i = 0; i < rules->token_cur; i++) {
+                if (rules->tokens[i].type != TK_RULE)
+                        continue;
+
+                n_rules++;
+                if (rules->profile_nsec[i] == 0)
+                        continue;
+
+                visited[n++] = i;
+                total += rules->profile_nsec[i];
+        }
+
+        qsort_r(visited, n, sizeof(unsigned int), profile_compare, rules->profile_nsec);
+
+        fprintf(f, "%u of %u rules evaluated in %"PRIu64"ns:\n", n, n_rules, total);
+        for (i = 0; i < n; i++) {
+                struct token *rule = &rules->tokens[visited[i]];
+
+                fprintf(f, "%10"PRIu64"ns %s:%u\n",
+                        rules->profile_nsec[visited[i]],
+                        rules_str(rules, rule->rule.filename_off), rule->rule.filename_line);
+        }
+}
+
 int udev_rules_apply_static_dev_perms(struct udev_rules *rules) {
         struct token *cur;
         struct token *rule;
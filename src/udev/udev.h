@@ -76,6 +76,8 @@ void udev_rules_apply_to_event(struct udev_rules *rules, struct udev_event *even
                                usec_t timeout_usec, usec_t timeout_warn_usec,
                                struct udev_list *properties_list);
 int udev_rules_apply_static_dev_perms(struct udev_rules *rules);
+int udev_rules_set_profile(struct udev_rules *rules, bool b);
+void udev_rules_dump_profile(struct udev_rules *rules, FILE *f);
 
 /* udev-event.c */
 struct udev_event *udev_event_new(struct udev_device *dev);
@@ -90,18 +90,21 @@ static int trie_children_cmp(const void *v1, const void *v2) {
 
 static int node_add_child(struct trie *trie, struct trie_node *node, struct trie_node *node_child, uint8_t c) {
         struct trie_child_entry *child;
+        size_t i;
 
-        /* extend array, add new entry, sort for bisection */
+        /* extend array, insert new entry at its sorted position, for bisection */
         child = realloc(node->children, (node->children_count + 1) * sizeof(struct trie_child_entry));
         if (!child)
                 return -ENOMEM;
 
         node->children = child;
-        trie->children_count++;
-        node->children[node->children_count].c = c;
-        node->children[node->children_count].child = node_child;
+        for (i = node->children_count; i > 0 && node->children[i-1].c > c; i--)
+                ;
+        memmove(node->children + i + 1, node->children + i, (node->children_count - i) * sizeof(struct trie_child_entry));
+        node->children[i].c = c;
+        node->children[i].child = node_child;
         node->children_count++;
-        qsort(node->children, node->children_count, sizeof(struct trie_child_entry), trie_children_cmp);
+        trie->children_count++;
         trie->nodes_count++;
 
         return 0;
@@ -128,19 +131,27 @@ static void trie_node_cleanup(struct trie_node *node) {
         free(node);
 }
 
-static int trie_values_cmp(const void *v1, const void *v2, void *arg) {
-        const struct trie_value_entry *val1 = v1;
-        const struct trie_value_entry *val2 = v2;
-        struct trie *trie = arg;
+static size_t node_find_value(struct trie *trie, const struct trie_node *node, const char *key) {
+        size_t lo = 0, hi = node->values_count;
+
+        /* returns the index of the first entry whose key is not smaller than the specified one */
+        while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+
+                if (strcmp(trie->strings->buf + node->values[mid].key_off, key) < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
 
-        return strcmp(trie->strings->buf + val1->key_off,
-                      trie->strings->buf + val2->key_off);
+        return lo;
 }
 
 static int trie_node_add_value(struct trie *trie, struct trie_node *node,
                           const char *key, const char *value) {
         ssize_t k, v;
         struct trie_value_entry *val;
+        size_t i;
 
         k = strbuf_add_string(trie->strings, key, strlen(key));
         if (k < 0)
@@ -149,30 +160,24 @@ static int trie_node_add_value(struct trie *trie, struct trie_node *node,
         if (v < 0)
                 return v;
 
-        if (node->values_count) {
-                struct trie_value_entry search = {
-                        .key_off = k,
-                        .value_off = v,
-                };
-
-                val = xbsearch_r(&search, node->values, node->values_count, sizeof(struct trie_value_entry), trie_values_cmp, trie);
-                if (val) {
-                        /* replace existing earlier key with new value */
-                        val->value_off = v;
-                        return 0;
-                }
+        /* find the entry for this key, or the position to insert it at, keeping the array sorted for bisection */
+        i = node_find_value(trie, node, key);
+        if (i < node->values_count && streq(trie->strings->buf + node->values[i].key_off, key)) {
+                /* replace existing earlier key with new value */
+                node->values[i].value_off = v;
+                return 0;
         }
 
-        /* extend array, add new entry, sort for bisection */
+        /* extend array, insert new entry */
         val = realloc(node->values, (node->values_count + 1) * sizeof(struct trie_value_entry));
         if (!val)
                 return -ENOMEM;
         trie->values_count++;
         node->values = val;
-        node->values[node->values_count].key_off = k;
-        node->values[node->values_count].value_off = v;
+        memmove(node->values + i + 1, node->values + i, (node->values_count - i) * sizeof(struct trie_value_entry));
+        node->values[i].key_off = k;
+        node->values[i].value_off = v;
         node->values_count++;
-        qsort_r(node->values, node->values_count, sizeof(struct trie_value_entry), trie_values_cmp, trie);
         return 0;
 }
 
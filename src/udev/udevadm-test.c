@@ -37,11 +37,13 @@ static void help(void) {
                "     --version                         Show package version\n"
                "  -a --action=ACTION                   Set action string\n"
                "  -N --resolve-names=early|late|never  When to resolve names\n"
+               "     --profile                         Show the time spent in each rule\n"
                , program_invocation_short_name);
 }
 
 static int adm_test(struct udev *udev, int argc, char *argv[]) {
         int resolve_names = 1;
+        bool profile = false;
         char filename[UTIL_PATH_SIZE];
         const char *action = "add";
         const char *syspath = NULL;
@@ -52,9 +54,14 @@ static int adm_test(struct udev *udev, int argc, char *argv[]) {
         sigset_t mask, sigmask_orig;
         int rc = 0, c;
 
+        enum {
+                ARG_PROFILE = 0x100,
+        };
+
         static const struct option options[] = {
                 { "action", required_argument, NULL, 'a' },
                 { "resolve-names", required_argument, NULL, 'N' },
+                { "profile", no_argument, NULL, ARG_PROFILE },
                 { "help", no_argument, NULL, 'h' },
                 {}
         };
@@ -79,6 +86,9 @@ static int adm_test(struct udev *udev, int argc, char *argv[]) {
                                 exit(EXIT_FAILURE);
                         }
                         break;
+                case ARG_PROFILE:
+                        profile = true;
+                        break;
                 case 'h':
                         help();
                         exit(EXIT_SUCCESS);
@@ -111,6 +121,12 @@ static int adm_test(struct udev *udev, int argc, char *argv[]) {
                 goto out;
         }
 
+        if (profile && udev_rules_set_profile(rules, true) < 0) {
+                fprintf(stderr, "error enabling rules profiling\n");
+                rc = 3;
+                goto out;
+        }
+
         /* add /sys if needed */
         if (!startswith(syspath, "/sys"))
                 strscpyl(filename, sizeof(filename), "/sys", syspath, NULL);
@@ -147,6 +163,11 @@ static int adm_test(struct udev *udev, int argc, char *argv[]) {
                 udev_event_apply_format(event, udev_list_entry_get_name(entry), program, sizeof(program), false);
                 printf("run: '%s'\n", program);
         }
+
+        if (profile) {
+                printf("\n");
+                udev_rules_dump_profile(rules, stdout);
+        }
 out:
         udev_builtin_exit(udev);
         return rc;
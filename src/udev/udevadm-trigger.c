@@ -18,11 +18,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <poll.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "parse-util.h"
+#include "set.h"
 #include "string-util.h"
 #include "udev-util.h"
 #include "udev.h"
@@ -32,8 +35,9 @@
 static int verbose;
 static int dry_run;
 
-static void exec_list(struct udev_enumerate *udev_enumerate, const char *action) {
+static int exec_list(struct udev_enumerate *udev_enumerate, const char *action, Set *settle_set) {
         struct udev_list_entry *entry;
+        int r;
 
         udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(udev_enumerate)) {
                 char filename[UTIL_PATH_SIZE];
@@ -47,10 +51,104 @@ static void exec_list(struct udev_enumerate *udev_enumerate, const char *action)
                 fd = open(filename, O_WRONLY|O_CLOEXEC);
                 if (fd < 0)
                         continue;
-                if (write(fd, action, strlen(action)) < 0)
+                if (write(fd, action, strlen(action)) < 0) {
                         log_debug_errno(errno, "error writing '%s' to '%s': %m", action, filename);
+                        close(fd);
+                        continue;
+                }
                 close(fd);
+
+                if (settle_set) {
+                        r = set_put_strdup(settle_set, udev_list_entry_get_name(entry));
+                        if (r < 0)
+                                return log_oom();
+                }
         }
+
+        return 0;
+}
+
+static int wait_for_queue(struct udev *udev, usec_t deadline) {
+        _cleanup_udev_queue_unref_ struct udev_queue *queue = NULL;
+        struct pollfd pfd = {
+                .events = POLLIN,
+        };
+
+        /* Like "udevadm settle": wait until udevd's queue is empty */
+
+        queue = udev_queue_new(udev);
+        if (!queue)
+                return log_error_errno(errno, "unable to get udev queue: %m");
+
+        pfd.fd = udev_queue_get_fd(queue);
+        if (pfd.fd < 0)
+                return 0;
+
+        for (;;) {
+                if (udev_queue_get_queue_is_empty(queue))
+                        return 0;
+
+                if (now(CLOCK_MONOTONIC) >= deadline) {
+                        log_error("timeout waiting for the udev queue to become empty");
+                        return -ETIMEDOUT;
+                }
+
+                if (poll(&pfd, 1, MSEC_PER_SEC) > 0 && pfd.revents & POLLIN)
+                        udev_queue_flush(queue);
+        }
+}
+
+static int wait_for_settle(struct udev *udev, struct udev_monitor *monitor, Set *settle_set, const char *action, usec_t deadline) {
+        struct pollfd pfd = {
+                .fd = udev_monitor_get_fd(monitor),
+                .events = POLLIN,
+        };
+
+        /* Wait until udevd has processed the event of every device we triggered */
+        while (!set_isempty(settle_set)) {
+                _cleanup_udev_device_unref_ struct udev_device *device = NULL;
+                const char *syspath;
+                usec_t n;
+                int r;
+
+                n = now(CLOCK_MONOTONIC);
+                if (n >= deadline) {
+                        log_error("timeout waiting for %u triggered events to complete", set_size(settle_set));
+                        return -ETIMEDOUT;
+                }
+
+                r = poll(&pfd, 1, DIV_ROUND_UP(deadline - n, USEC_PER_MSEC));
+                if (r < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return log_error_errno(errno, "failed to wait for events: %m");
+                }
+                if (r == 0)
+                        continue;
+
+                errno = 0;
+                device = udev_monitor_receive_device(monitor);
+                if (!device) {
+                        /* Events were dropped, and we cannot tell which. Fall back to waiting for all of them. */
+                        if (errno == ENOBUFS) {
+                                log_debug("udev event receive buffer overrun, waiting for the whole queue instead");
+                                return wait_for_queue(udev, deadline);
+                        }
+
+                        continue;
+                }
+
+                /* Only our own event counts, not some other one for the same device that happened in between */
+                if (!streq_ptr(udev_device_get_action(device), action))
+                        continue;
+
+                syspath = udev_device_get_syspath(device);
+                if (verbose)
+                        printf("settle %s\n", syspath);
+                free(set_remove(settle_set, syspath));
+        }
+
+        return 0;
 }
 
 static const char *keyval(const char *str, const char **val, char *buf, size_t size) {
@@ -86,29 +184,34 @@ static void help(void) {
                "  -y --sysname-match=NAME           Trigger devices with this /sys path\n"
                "     --name-match=NAME              Trigger devices with this /dev name\n"
                "  -b --parent-match=NAME            Trigger devices with that parent device\n"
+               "  -w --settle                       Wait for the triggered events to complete\n"
+               "     --timeout=SECONDS              Maximum time to wait for events with --settle\n"
                , program_invocation_short_name);
 }
 
 static int adm_trigger(struct udev *udev, int argc, char *argv[]) {
         enum {
                 ARG_NAME = 0x100,
+                ARG_TIMEOUT,
         };
 
         static const struct option options[] = {
-                { "verbose",           no_argument,       NULL, 'v'      },
-                { "dry-run",           no_argument,       NULL, 'n'      },
-                { "type",              required_argument, NULL, 't'      },
-                { "action",            required_argument, NULL, 'c'      },
-                { "subsystem-match",   required_argument, NULL, 's'      },
-                { "subsystem-nomatch", required_argument, NULL, 'S'      },
-                { "attr-match",        required_argument, NULL, 'a'      },
-                { "attr-nomatch",      required_argument, NULL, 'A'      },
-                { "property-match",    required_argument, NULL, 'p'      },
-                { "tag-match",         required_argument, NULL, 'g'      },
-                { "sysname-match",     required_argument, NULL, 'y'      },
-                { "name-match",        required_argument, NULL, ARG_NAME },
-                { "parent-match",      required_argument, NULL, 'b'      },
-                { "help",              no_argument,       NULL, 'h'      },
+                { "verbose",           no_argument,       NULL, 'v'         },
+                { "dry-run",           no_argument,       NULL, 'n'         },
+                { "type",              required_argument, NULL, 't'         },
+                { "action",            required_argument, NULL, 'c'         },
+                { "subsystem-match",   required_argument, NULL, 's'         },
+                { "subsystem-nomatch", required_argument, NULL, 'S'         },
+                { "attr-match",        required_argument, NULL, 'a'         },
+                { "attr-nomatch",      required_argument, NULL, 'A'         },
+                { "property-match",    required_argument, NULL, 'p'         },
+                { "tag-match",         required_argument, NULL, 'g'         },
+                { "sysname-match",     required_argument, NULL, 'y'         },
+                { "name-match",        required_argument, NULL, ARG_NAME    },
+                { "parent-match",      required_argument, NULL, 'b'         },
+                { "settle",            no_argument,       NULL, 'w'         },
+                { "timeout",           required_argument, NULL, ARG_TIMEOUT },
+                { "help",              no_argument,       NULL, 'h'         },
                 {}
         };
         enum {
@@ -117,13 +220,17 @@ static int adm_trigger(struct udev *udev, int argc, char *argv[]) {
         } device_type = TYPE_DEVICES;
         const char *action = "change";
         _cleanup_udev_enumerate_unref_ struct udev_enumerate *udev_enumerate = NULL;
+        _cleanup_udev_monitor_unref_ struct udev_monitor *udev_monitor = NULL;
+        _cleanup_set_free_free_ Set *settle_set = NULL;
+        bool settle = false;
+        unsigned timeout = 120;
         int c, r;
 
         udev_enumerate = udev_enumerate_new(udev);
         if (udev_enumerate == NULL)
                 return 1;
 
-        while ((c = getopt_long(argc, argv, "vno:t:c:s:S:a:A:p:g:y:b:h", options, NULL)) >= 0) {
+        while ((c = getopt_long(argc, argv, "vno:t:c:s:S:a:A:p:g:y:b:wh", options, NULL)) >= 0) {
                 const char *key;
                 const char *val;
                 char buf[UTIL_PATH_SIZE];
@@ -239,6 +346,18 @@ static int adm_trigger(struct udev *udev, int argc, char *argv[]) {
                         break;
                 }
 
+                case 'w':
+                        settle = true;
+                        break;
+
+                case ARG_TIMEOUT:
+                        r = safe_atou(optarg, &timeout);
+                        if (r < 0) {
+                                log_error_errno(r, "invalid timeout value '%s': %m", optarg);
+                                return 2;
+                        }
+                        break;
+
                 case 'h':
                         help();
                         return 0;
@@ -265,18 +384,48 @@ static int adm_trigger(struct udev *udev, int argc, char *argv[]) {
                 }
         }
 
+        if (settle && !dry_run) {
+                settle_set = set_new(&string_hash_ops);
+                if (!settle_set)
+                        return log_oom();
+
+                /* listen before triggering, so that no event can be missed */
+                udev_monitor = udev_monitor_new_from_netlink(udev, "udev");
+                if (!udev_monitor) {
+                        log_error("error: unable to create netlink socket");
+                        return 3;
+                }
+
+                /* a coldplug may produce a lot of events at once */
+                (void) udev_monitor_set_receive_buffer_size(udev_monitor, 128*1024*1024);
+
+                r = udev_monitor_enable_receiving(udev_monitor);
+                if (r < 0) {
+                        log_error_errno(r, "error: unable to subscribe to udev events: %m");
+                        return 3;
+                }
+        }
+
         switch (device_type) {
         case TYPE_SUBSYSTEMS:
                 udev_enumerate_scan_subsystems(udev_enumerate);
-                exec_list(udev_enumerate, action);
-                return 0;
+                break;
         case TYPE_DEVICES:
                 udev_enumerate_scan_devices(udev_enumerate);
-                exec_list(udev_enumerate, action);
-                return 0;
+                break;
         default:
                 assert_not_reached("device_type");
         }
+
+        r = exec_list(udev_enumerate, action, settle_set);
+        if (r < 0)
+                return 1;
+
+        if (udev_monitor &&
+            wait_for_settle(udev, udev_monitor, settle_set, action, now(CLOCK_MONOTONIC) + timeout * USEC_PER_SEC) < 0)
+                return 1;
+
+        return 0;
 }
 
 const struct udevadm_cmd udevadm_trigger = {
@@ -53,6 +53,7 @@
 #include "fs-util.h"
 #include "hashmap.h"
 #include "io-util.h"
+#include "list.h"
 #include "netlink-util.h"
 #include "parse-util.h"
 #include "proc-cmdline.h"
@@ -74,6 +75,9 @@ static int arg_exec_delay;
 static usec_t arg_event_timeout_usec = 180 * USEC_PER_SEC;
 static usec_t arg_event_timeout_warn_usec = 180 * USEC_PER_SEC / 3;
 
+#define WORKER_IDLE_TIMEOUT_USEC (3 * USEC_PER_SEC)
+#define UEVENT_BATCH_MAX 64
+
 typedef struct Manager {
         struct udev *udev;
         sd_event *event;
@@ -94,6 +98,12 @@ typedef struct Manager {
         sd_event_source *ctrl_event;
         sd_event_source *uevent_event;
         sd_event_source *inotify_event;
+        sd_event_source *kill_workers_event;
+
+        /* Indexes of the queued and running events, for finding the ones an event has to wait for */
+        Hashmap *devpath_index;
+        Hashmap *devnum_index;
+        Hashmap *ifindex_index;
 
         usec_t last_usec;
 
@@ -107,6 +117,29 @@ enum event_state {
         EVENT_RUNNING,
 };
 
+/* Links an event into the list of an index entry. The lists are ordered by seqnum, since events are
+ * queued in that order, hence the head is always the earliest event. */
+struct event_link {
+        struct event *event;
+        struct event_index_entry *entry;
+        bool child;
+        LIST_FIELDS(struct event_link, links);
+};
+
+struct event_index_entry {
+        Hashmap *index;
+
+        /* The key: the devpath in the devpath index, the number otherwise */
+        char *devpath;
+        uint64_t number;
+
+        /* The events of exactly this device, and in the devpath index also those of devices below */
+        LIST_HEAD(struct event_link, events);
+        struct event_link *events_tail;
+        LIST_HEAD(struct event_link, children);
+        struct event_link *children_tail;
+};
+
 struct event {
         struct udev_list_node node;
         Manager *manager;
@@ -115,7 +148,6 @@ struct event {
         struct udev_device *dev_kernel;
         struct worker *worker;
         enum event_state state;
-        unsigned long long int delaying_seqnum;
         unsigned long long int seqnum;
         const char *devpath;
         size_t devpath_len;
@@ -123,6 +155,8 @@ struct event {
         dev_t devnum;
         int ifindex;
         bool is_block;
+        struct event_link *links;
+        size_t n_links;
         sd_event_source *timeout_warning;
         sd_event_source *timeout;
 };
@@ -132,6 +166,7 @@ static inline struct event *node_to_event(struct udev_list_node *node) {
 }
 
 static void event_queue_cleanup(Manager *manager, enum event_state type);
+static void event_index_remove(struct event *event);
 
 enum worker_state {
         WORKER_UNDEF,
@@ -161,6 +196,7 @@ static void event_free(struct event *event) {
                 return;
 
         udev_list_node_remove(&event->node);
+        event_index_remove(event);
         udev_device_unref(event->dev);
         udev_device_unref(event->dev_kernel);
 
@@ -302,6 +338,7 @@ static void manager_free(Manager *manager) {
         sd_event_source_unref(manager->ctrl_event);
         sd_event_source_unref(manager->uevent_event);
         sd_event_source_unref(manager->inotify_event);
+        sd_event_source_unref(manager->kill_workers_event);
 
         udev_unref(manager->udev);
         sd_event_unref(manager->event);
@@ -312,6 +349,10 @@ static void manager_free(Manager *manager) {
         udev_ctrl_unref(manager->ctrl);
         udev_ctrl_connection_unref(manager->ctrl_conn_blocking);
 
+        hashmap_free(manager->devpath_index);
+        hashmap_free(manager->devnum_index);
+        hashmap_free(manager->ifindex_index);
+
         udev_list_cleanup(&manager->properties);
         udev_rules_unref(manager->rules);
 
@@ -373,6 +414,7 @@ static void worker_spawn(Manager *manager, struct event *event) {
                 manager->ctrl_event = sd_event_source_unref(manager->ctrl_event);
                 manager->uevent_event = sd_event_source_unref(manager->uevent_event);
                 manager->inotify_event = sd_event_source_unref(manager->inotify_event);
+                manager->kill_workers_event = sd_event_source_unref(manager->kill_workers_event);
 
                 manager->event = sd_event_unref(manager->event);
 
@@ -549,7 +591,7 @@ out:
         }
 }
 
-static void event_run(Manager *manager, struct event *event) {
+static bool event_run(Manager *manager, struct event *event) {
         struct worker *worker;
         Iterator i;
 
@@ -571,17 +613,191 @@ static void event_run(Manager *manager, struct event *event) {
                         continue;
                 }
                 worker_attach_event(worker, event);
-                return;
+                return true;
         }
 
         if (hashmap_size(manager->workers) >= arg_children_max) {
                 if (arg_children_max > 1)
                         log_debug("maximum number (%i) of children reached", hashmap_size(manager->workers));
-                return;
+                return false;
         }
 
         /* start new worker and pass initial device */
         worker_spawn(manager, event);
+        return true;
+}
+
+static uint64_t event_devnum_key(struct event *event) {
+        return ((uint64_t) event->devnum << 1) | event->is_block;
+}
+
+static struct event_index_entry *event_index_entry_free(struct event_index_entry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->devpath);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct event_index_entry*, event_index_entry_free);
+
+static int event_index_link(
+                Hashmap **index,
+                const struct hash_ops *hash_ops,
+                const char *devpath,
+                uint64_t number,
+                bool child,
+                struct event_link *link) {
+
+        _cleanup_(event_index_entry_freep) struct event_index_entry *n = NULL;
+        struct event_index_entry *e;
+        int r;
+
+        assert(index);
+        assert(link);
+        assert(link->event);
+
+        e = hashmap_get(*index, devpath ?: (const void*) &number);
+        if (!e) {
+                r = hashmap_ensure_allocated(index, hash_ops);
+                if (r < 0)
+                        return r;
+
+                n = new0(struct event_index_entry, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                n->index = *index;
+                n->number = number;
+                if (devpath) {
+                        n->devpath = strdup(devpath);
+                        if (!n->devpath)
+                                return -ENOMEM;
+                }
+
+                r = hashmap_put(*index, n->devpath ?: (const void*) &n->number, n);
+                if (r < 0)
+                        return r;
+
+                e = n;
+                n = NULL;
+        }
+
+        link->entry = e;
+        link->child = child;
+
+        if (child) {
+                LIST_INSERT_AFTER(links, e->children, e->children_tail, link);
+                e->children_tail = link;
+        } else {
+                LIST_INSERT_AFTER(links, e->events, e->events_tail, link);
+                e->events_tail = link;
+        }
+
+        return 0;
+}
+
+static void event_index_unlink(struct event_link *link) {
+        struct event_index_entry *e;
+
+        assert(link);
+
+        e = link->entry;
+        if (!e)
+                return;
+
+        if (link->child) {
+                if (e->children_tail == link)
+                        e->children_tail = link->links_prev;
+                LIST_REMOVE(links, e->children, link);
+        } else {
+                if (e->events_tail == link)
+                        e->events_tail = link->links_prev;
+                LIST_REMOVE(links, e->events, link);
+        }
+
+        link->entry = NULL;
+
+        if (!e->events && !e->children) {
+                hashmap_remove(e->index, e->devpath ?: (const void*) &e->number);
+                event_index_entry_free(e);
+        }
+}
+
+static void event_index_remove(struct event *event) {
+        size_t i;
+
+        assert(event);
+
+        for (i = 0; i < event->n_links; i++)
+                event_index_unlink(event->links + i);
+
+        event->links = mfree(event->links);
+        event->n_links = 0;
+}
+
+static int event_index_add(Manager *manager, struct event *event) {
+        char path[event->devpath_len + 1];
+        size_t n = 1, i, l = 0;
+        int r;
+
+        assert(manager);
+        assert(event);
+
+        /* Every event is linked into the entry of its devpath, of each of its parent devpaths, and of its
+         * device number and interface index, if it has those */
+
+        for (i = 1; i < event->devpath_len; i++)
+                if (event->devpath[i] == '/')
+                        n++;
+        if (major(event->devnum) != 0)
+                n++;
+        if (event->ifindex != 0)
+                n++;
+
+        event->links = new0(struct event_link, n);
+        if (!event->links)
+                return -ENOMEM;
+        event->n_links = n;
+
+        for (i = 0; i < n; i++)
+                event->links[i].event = event;
+
+        r = event_index_link(&manager->devpath_index, &string_hash_ops, event->devpath, 0, false, event->links + l++);
+        if (r < 0)
+                goto fail;
+
+        memcpy(path, event->devpath, event->devpath_len + 1);
+        for (i = 1; i < event->devpath_len; i++) {
+                if (path[i] != '/')
+                        continue;
+
+                path[i] = 0;
+                r = event_index_link(&manager->devpath_index, &string_hash_ops, path, 0, true, event->links + l++);
+                path[i] = '/';
+                if (r < 0)
+                        goto fail;
+        }
+
+        if (major(event->devnum) != 0) {
+                r = event_index_link(&manager->devnum_index, &uint64_hash_ops, NULL, event_devnum_key(event), false, event->links + l++);
+                if (r < 0)
+                        goto fail;
+        }
+
+        if (event->ifindex != 0) {
+                r = event_index_link(&manager->ifindex_index, &uint64_hash_ops, NULL, (uint64_t) event->ifindex, false, event->links + l++);
+                if (r < 0)
+                        goto fail;
+        }
+
+        assert(l == n);
+
+        return 0;
+
+fail:
+        event_index_remove(event);
+        return r;
 }
 
 static int event_queue_insert(Manager *manager, struct udev_device *dev) {
@@ -614,6 +830,13 @@ static int event_queue_insert(Manager *manager, struct udev_device *dev) {
         event->is_block = streq("block", udev_device_get_subsystem(dev));
         event->ifindex = udev_device_get_ifindex(dev);
 
+        r = event_index_add(manager, event);
+        if (r < 0) {
+                udev_device_unref(event->dev_kernel);
+                free(event);
+                return r;
+        }
+
         log_debug("seq %llu queued, '%s' '%s'", udev_device_get_seqnum(dev),
              udev_device_get_action(dev), udev_device_get_subsystem(dev));
 
@@ -627,6 +850,10 @@ static int event_queue_insert(Manager *manager, struct udev_device *dev) {
 
         udev_list_node_append(&event->node, &manager->events);
 
+        /* the idle workers are needed again */
+        if (manager->kill_workers_event)
+                (void) sd_event_source_set_enabled(manager->kill_workers_event, SD_EVENT_OFF);
+
         return 0;
 }
 
@@ -645,73 +872,77 @@ static void manager_kill_workers(Manager *manager) {
         }
 }
 
-/* lookup event for identical, parent, child device */
-static bool is_devpath_busy(Manager *manager, struct event *event) {
-        struct udev_list_node *loop;
-        size_t common;
-
-        /* check if queue contains events we depend on */
-        udev_list_node_foreach(loop, &manager->events) {
-                struct event *loop_event = node_to_event(loop);
-
-                /* we already found a later event, earlier can not block us, no need to check again */
-                if (loop_event->seqnum < event->delaying_seqnum)
-                        continue;
-
-                /* event we checked earlier still exists, no need to check again */
-                if (loop_event->seqnum == event->delaying_seqnum)
-                        return true;
-
-                /* found ourself, no later event can block us */
-                if (loop_event->seqnum >= event->seqnum)
-                        break;
+static bool event_link_is_earlier(struct event_link *head, struct event *event) {
+        /* The lists are ordered, hence checking the head suffices */
+        return head && head->event->seqnum < event->seqnum;
+}
 
-                /* check major/minor */
-                if (major(event->devnum) != 0 && event->devnum == loop_event->devnum && event->is_block == loop_event->is_block)
+/* lookup earlier event for identical, parent, child device */
+static bool is_devpath_busy(Manager *manager, struct event *event) {
+        char path[event->devpath_len + 1];
+        struct event_index_entry *e;
+        struct event_link *link;
+        uint64_t key;
+        size_t i;
+
+        /* check major/minor */
+        if (major(event->devnum) != 0) {
+                key = event_devnum_key(event);
+                e = hashmap_get(manager->devnum_index, &key);
+                if (e && event_link_is_earlier(e->events, event))
                         return true;
+        }
 
-                /* check network device ifindex */
-                if (event->ifindex != 0 && event->ifindex == loop_event->ifindex)
+        /* check network device ifindex */
+        if (event->ifindex != 0) {
+                key = (uint64_t) event->ifindex;
+                e = hashmap_get(manager->ifindex_index, &key);
+                if (e && event_link_is_earlier(e->events, event))
                         return true;
+        }
 
-                /* check our old name */
-                if (event->devpath_old != NULL && streq(loop_event->devpath, event->devpath_old)) {
-                        event->delaying_seqnum = loop_event->seqnum;
+        /* check our old name */
+        if (event->devpath_old) {
+                e = hashmap_get(manager->devpath_index, event->devpath_old);
+                if (e && event_link_is_earlier(e->events, event))
                         return true;
-                }
+        }
 
-                /* compare devpath */
-                common = MIN(loop_event->devpath_len, event->devpath_len);
+        e = hashmap_get(manager->devpath_index, event->devpath);
+        if (e) {
+                /* identical device event found */
+                LIST_FOREACH(links, link, e->events) {
+                        struct event *loop_event = link->event;
 
-                /* one devpath is contained in the other? */
-                if (memcmp(loop_event->devpath, event->devpath, common) != 0)
-                        continue;
+                        if (loop_event->seqnum >= event->seqnum)
+                                break;
 
-                /* identical device event found */
-                if (loop_event->devpath_len == event->devpath_len) {
                         /* devices names might have changed/swapped in the meantime */
                         if (major(event->devnum) != 0 && (event->devnum != loop_event->devnum || event->is_block != loop_event->is_block))
                                 continue;
                         if (event->ifindex != 0 && event->ifindex != loop_event->ifindex)
                                 continue;
-                        event->delaying_seqnum = loop_event->seqnum;
-                        return true;
-                }
 
-                /* parent device event found */
-                if (event->devpath[common] == '/') {
-                        event->delaying_seqnum = loop_event->seqnum;
                         return true;
                 }
 
                 /* child device event found */
-                if (loop_event->devpath[common] == '/') {
-                        event->delaying_seqnum = loop_event->seqnum;
+                if (event_link_is_earlier(e->children, event))
                         return true;
-                }
+        }
+
+        /* parent device event found */
+        memcpy(path, event->devpath, event->devpath_len + 1);
+        for (i = 1; i < event->devpath_len; i++) {
+                if (path[i] != '/')
+                        continue;
 
-                /* no matching device */
-                continue;
+                path[i] = 0;
+                e = hashmap_get(manager->devpath_index, path);
+                path[i] = '/';
+
+                if (e && event_link_is_earlier(e->events, event))
+                        return true;
         }
 
         return false;
@@ -820,7 +1051,9 @@ static void event_queue_start(Manager *manager) {
                 if (is_devpath_busy(manager, event))
                         continue;
 
-                event_run(manager, event);
+                /* no worker left to run it, hence no need to look at the rest of the queue */
+                if (!event_run(manager, event))
+                        break;
         }
 }
 
@@ -911,22 +1144,34 @@ static int on_worker(sd_event_source *s, int fd, uint32_t revents, void *userdat
 
 static int on_uevent(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         Manager *manager = userdata;
-        struct udev_device *dev;
+        bool queued = false;
+        unsigned i;
         int r;
 
         assert(manager);
 
-        dev = udev_monitor_receive_device(manager->monitor);
-        if (dev) {
+        /* Take a batch of uevents off the socket before scheduling, so that a burst of them is not
+         * followed by a queue scan for every single one. The receive stops at the first message that
+         * is not a device, the rest is left for the next iteration. */
+        for (i = 0; i < UEVENT_BATCH_MAX; i++) {
+                struct udev_device *dev;
+
+                dev = udev_monitor_receive_device(manager->monitor);
+                if (!dev)
+                        break;
+
                 udev_device_ensure_usec_initialized(dev, NULL);
                 r = event_queue_insert(manager, dev);
                 if (r < 0)
                         udev_device_unref(dev);
                 else
-                        /* we have fresh events, try to schedule them */
-                        event_queue_start(manager);
+                        queued = true;
         }
 
+        /* we have fresh events, try to schedule them */
+        if (queued)
+                event_queue_start(manager);
+
         return 1;
 }
 
@@ -1240,6 +1485,51 @@ static int on_sigchld(sd_event_source *s, const struct signalfd_siginfo *si, voi
         return 1;
 }
 
+static int on_kill_workers_event(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *manager = userdata;
+
+        assert(manager);
+
+        /* new events arrived in the meantime */
+        if (!udev_list_node_is_empty(&manager->events))
+                return 1;
+
+        log_debug("cleanup idle workers");
+        manager_kill_workers(manager);
+
+        return 1;
+}
+
+static void manager_schedule_kill_workers(Manager *manager) {
+        int enabled = SD_EVENT_OFF, r;
+        usec_t usec;
+
+        assert(manager);
+
+        /* Keep idle workers around for a bit, so that a burst of events arriving in short succession
+         * does not fork and kill a whole set of workers each time the queue runs empty. */
+
+        if (manager->kill_workers_event &&
+            sd_event_source_get_enabled(manager->kill_workers_event, &enabled) >= 0 &&
+            enabled != SD_EVENT_OFF)
+                return;
+
+        assert_se(sd_event_now(manager->event, CLOCK_MONOTONIC, &usec) >= 0);
+        usec += WORKER_IDLE_TIMEOUT_USEC;
+
+        if (manager->kill_workers_event) {
+                r = sd_event_source_set_time(manager->kill_workers_event, usec);
+                if (r >= 0)
+                        r = sd_event_source_set_enabled(manager->kill_workers_event, SD_EVENT_ONESHOT);
+        } else
+                r = sd_event_add_time(manager->event, &manager->kill_workers_event, CLOCK_MONOTONIC,
+                                      usec, USEC_PER_SEC, on_kill_workers_event, manager);
+        if (r < 0) {
+                log_debug_errno(r, "failed to schedule cleanup of idle workers, killing them now: %m");
+                manager_kill_workers(manager);
+        }
+}
+
 static int on_post(sd_event_source *s, void *userdata) {
         Manager *manager = userdata;
         int r;
@@ -1250,8 +1540,10 @@ static int on_post(sd_event_source *s, void *userdata) {
                 /* no pending events */
                 if (!hashmap_isempty(manager->workers)) {
                         /* there are idle workers */
-                        log_debug("cleanup idle workers");
-                        manager_kill_workers(manager);
+                        if (manager->exit)
+                                manager_kill_workers(manager);
+                        else
+                                manager_schedule_kill_workers(manager);
                 } else {
                         /* we are idle */
                         if (manager->exit) {
@@ -1544,6 +1836,11 @@ static int manager_new(Manager **ret, int fd_ctrl, int fd_uevent, const char *cg
         if (!manager->monitor)
                 return log_error_errno(EINVAL, "error taking over netlink socket");
 
+        /* uevents are received in batches until the socket runs dry, an inherited socket might be blocking */
+        r = fd_nonblock(fd_uevent, true);
+        if (r < 0)
+                return log_error_errno(r, "could not make netlink socket non-blocking: %m");
+
         /* unnamed socket from workers to the main daemon */
         r = socketpair(AF_LOCAL, SOCK_DGRAM|SOCK_CLOEXEC, 0, manager->worker_watch);
         if (r < 0)
@@ -77,4 +77,37 @@ END_SEC=$(date -u '+%s')
 ELAPSED=$(($END_SEC-$START_SEC))
 [[ "$ELAPSED" -ge 5 ]] && [[ "$ELAPSED" -le 7 ]] || exit 1
 
+# Test starting several transient units in one go. Either all of them are
+# created and started, or none of them is.
+start_transient_units() {
+    busctl call org.freedesktop.systemd1 /org/freedesktop/systemd1 \
+        org.freedesktop.systemd1.Manager StartTransientUnits \
+        'sa(sa(sv)a(sa(sv)))' fail "$@"
+}
+
+oneshot() {
+    echo "$1 3 Type s oneshot RemainAfterExit b true ExecStart a(sasb) 1 /bin/touch 2 /bin/touch /tmp/$1 false 0"
+}
+
+start_transient_units 2 $(oneshot batch1.service) $(oneshot batch2.service)
+while ! systemctl is-active batch1.service batch2.service; do
+    sleep 0.1
+done
+[[ -f /tmp/batch1.service ]] && [[ -f /tmp/batch2.service ]] || exit 1
+
+# Duplicate names
+! start_transient_units 2 $(oneshot batch3.service) $(oneshot batch3.service) || exit 1
+[[ "$(systemctl show -p LoadState batch3.service)" = "LoadState=not-found" ]] || exit 1
+
+# A unit that exists already
+! start_transient_units 2 $(oneshot batch4.service) $(oneshot batch1.service) || exit 1
+[[ "$(systemctl show -p LoadState batch4.service)" = "LoadState=not-found" ]] || exit 1
+
+# A unit that can't be created, after another one was already
+! start_transient_units 2 $(oneshot batch5.service) batch6.service 1 NoSuchProperty s foo 0 || exit 1
+[[ "$(systemctl show -p LoadState batch5.service)" = "LoadState=not-found" ]] || exit 1
+[[ ! -f /tmp/batch5.service ]] || exit 1
+
+systemctl stop batch1.service batch2.service
+
 touch /testok
@@ -0,0 +1,69 @@
+#!/bin/sh
+# run the built systemd-tmpfiles --clean on a small tree and check that the
+# lookups of configured entries are only done where entries may be found
+#
+# systemd is free software; you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation; either version 2.1 of the License, or
+# (at your option) any later version.
+
+# systemd is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with systemd; If not, see <http://www.gnu.org/licenses/>.
+
+set -e
+
+SYSTEMD_TMPFILES=${SYSTEMD_TMPFILES:-./systemd-tmpfiles}
+
+if [ ! -x "$SYSTEMD_TMPFILES" ]; then
+    echo "$SYSTEMD_TMPFILES does not exist, please build first"
+    exit 1
+fi
+
+D=$(mktemp --directory)
+trap "rm -rf '$D'" EXIT INT QUIT PIPE
+mkdir -p "$D/clean/sub"
+touch "$D/clean/a" "$D/clean/sub/b" "$D/clean/sub/keep"
+
+clean() {
+    SYSTEMD_LOG_LEVEL=debug SYSTEMD_LOG_TARGET=console "$SYSTEMD_TMPFILES" --clean "$D/test.conf" 2>&1
+}
+
+# The cleaned directory itself and an entry outside of it: no lookups at all
+cat >"$D/test.conf" <<EOT
+d $D/clean - - - 10d
+f $D/outside
+EOT
+out=$(clean)
+echo "$out" | grep -qF "No entries configured below \"$D/clean\", skipping lookups."
+echo "$out" | grep -qF "No entries configured below \"$D/clean/sub\", skipping lookups."
+
+# An entry below the cleaned directory: lookups in the directories leading to it
+cat >"$D/test.conf" <<EOT
+d $D/clean - - - 10d
+f $D/clean/sub/keep
+EOT
+out=$(clean)
+if echo "$out" | grep -qF "No entries configured below \"$D/clean"; then
+    echo "Lookups skipped although an entry is configured below $D/clean"
+    exit 1
+fi
+echo "$out" | grep -qF "Ignoring \"$D/clean/sub/keep\": a separate entry exists."
+
+# A glob that may match below the cleaned directory
+cat >"$D/test.conf" <<EOT
+d $D/clean - - - 10d
+z $D/clean/s*/b
+EOT
+out=$(clean)
+if echo "$out" | grep -qF "No entries configured below \"$D/clean"; then
+    echo "Lookups skipped although a glob is configured below $D/clean"
+    exit 1
+fi
+echo "$out" | grep -qF "Ignoring \"$D/clean/sub/b\": a separate glob exists."
+
+exit 0